@@ -7,7 +7,7 @@ load("@bazel_tools//tools/build_defs/repo:http.bzl", "http_archive")
 load("@bazel_tools//tools/build_defs/repo:utils.bzl", "maybe")
 
 def openexr_deps():
-    """Fetches dependencies (zlib and Imath) of OpenEXR."""
+    """Fetches dependencies (zlib, libdeflate and Imath) of OpenEXR."""
 
     maybe(
         http_archive,
@@ -21,6 +21,20 @@ def openexr_deps():
         ],
     )
 
+    # Only fetched when building with --define openexr_use_libdeflate=1.
+    # The sha256 of the archive can be checked using:
+    # curl -sL https://github.com/ebiggers/libdeflate/archive/refs/tags/v1.10.tar.gz --output libdeflate-1.10.tar.gz
+    # sha256sum libdeflate-1.10.tar.gz
+    # If the hash is incorrect Bazel will report an error and show the actual hash of the file.
+    maybe(
+        http_archive,
+        name = "libdeflate",
+        build_file = "@openexr//:bazel/third_party/libdeflate.BUILD",
+        strip_prefix = "libdeflate-1.10",
+        sha256 = "5c1f75c285cd87202226f4de49985dcb75732f527eefba2b3ddd70a8865f2533",
+        urls = ["https://github.com/ebiggers/libdeflate/archive/refs/tags/v1.10.tar.gz"],
+    )
+
     # sha256 was determined using:
     # curl -sL https://github.com/AcademySoftwareFoundation/Imath/archive/refs/tags/v3.1.4.tar.gz --output Imath-3.1.4.tar.gz
     # sha256sum Imath-3.1.4.tar.gz
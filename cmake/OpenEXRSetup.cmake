@@ -243,6 +243,38 @@ if(OPENEXR_FORCE_INTERNAL_ZLIB OR NOT TARGET ZLIB::ZLIB)
   endif()
 endif()
 
+option(OPENEXR_USE_LIBDEFLATE "Use libdeflate for the deflate step of zip based compression (zlib is still used when not selected at runtime)" OFF)
+if(OPENEXR_USE_LIBDEFLATE)
+  if(NOT TARGET libdeflate::libdeflate_shared AND NOT TARGET libdeflate::libdeflate_static)
+    find_package(libdeflate CONFIG QUIET)
+  endif()
+  set(OPENEXR_LIBDEFLATE_CONFIG ON)
+  if(TARGET libdeflate::libdeflate_shared AND BUILD_SHARED_LIBS)
+    set(OPENEXR_LIBDEFLATE_TARGET libdeflate::libdeflate_shared)
+  elseif(TARGET libdeflate::libdeflate_static)
+    set(OPENEXR_LIBDEFLATE_TARGET libdeflate::libdeflate_static)
+  elseif(TARGET libdeflate::libdeflate_shared)
+    set(OPENEXR_LIBDEFLATE_TARGET libdeflate::libdeflate_shared)
+  else()
+    # older releases do not provide a cmake config
+    set(OPENEXR_LIBDEFLATE_CONFIG OFF)
+    find_path(LIBDEFLATE_INCLUDE_DIR libdeflate.h)
+    find_library(LIBDEFLATE_LIBRARY NAMES deflate libdeflate)
+    if(NOT LIBDEFLATE_INCLUDE_DIR OR NOT LIBDEFLATE_LIBRARY)
+      message(FATAL_ERROR "Unable to find libdeflate, disable with OPENEXR_USE_LIBDEFLATE=OFF")
+    endif()
+    add_library(openexr_libdeflate UNKNOWN IMPORTED GLOBAL)
+    set_target_properties(openexr_libdeflate PROPERTIES
+      IMPORTED_LOCATION "${LIBDEFLATE_LIBRARY}"
+      INTERFACE_INCLUDE_DIRECTORIES "${LIBDEFLATE_INCLUDE_DIR}"
+      )
+    # not exported, static consumers need to link libdeflate themselves
+    set(OPENEXR_LIBDEFLATE_TARGET $<BUILD_INTERFACE:openexr_libdeflate>)
+  endif()
+  message(STATUS "Using libdeflate for zip based compression")
+  set(OPENEXR_HAVE_LIBDEFLATE ON)
+endif()
+
 #######################################
 # Find or install Imath
 #######################################
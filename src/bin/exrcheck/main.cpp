@@ -1,11 +1,15 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) Contributors to the OpenEXR Project.
 
+#include <IlmThreadPool.h>
 #include <ImathConfig.h>
 #include <ImfCheckFile.h>
 
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdlib.h>
 #include <string.h>
 #if defined _WIN32 || defined _WIN64
 #    include <io.h>
@@ -15,6 +19,9 @@
 #include <vector>
 
 using namespace OPENEXR_IMF_NAMESPACE;
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
 using std::cerr;
 using std::cout;
 using std::endl;
@@ -33,63 +40,203 @@ usageMessage (const char argv0[])
         << "  -t : avoid spending excessive time (some files will not be fully checked)\n";
     cerr << "  -s : use stream API instead of file API\n";
     cerr << "  -c : add core library checks\n";
+    cerr
+        << "  -q : only check the file structure (headers, offset tables and\n"
+           "       chunk headers) with the core library, without reading\n"
+           "       any pixels\n";
+    cerr
+        << "  -j n : check up to n files at a time; each file is read into\n"
+           "         memory once, and all checks read from there (see -s)\n";
     cerr << "  -v : print OpenEXR and Imath software libary version info\n";
 }
 
+//
+// Read a whole file into memory
+//
+
+bool
+readFile (const char* filename, vector<char>& data)
+{
+    //
+    // open file as stream, check size
+    //
+    ifstream instream (filename, ifstream::binary);
+
+    if (!instream)
+    {
+        cerr << "internal error: bad file '" << filename
+             << "' for in-memory stream" << endl;
+        return false;
+    }
+
+    instream.seekg (0, instream.end);
+    streampos length = instream.tellg ();
+    instream.seekg (0, instream.beg);
+
+    const uintptr_t kMaxSize = uintptr_t (-1) / 4;
+    if (length < 0 || length > (streampos) kMaxSize)
+    {
+        cerr << "internal error: bad file length " << length
+             << " for in-memory stream" << endl;
+        return false;
+    }
+
+    //
+    // read into memory
+    //
+    data.resize (length);
+    instream.read (data.data (), length);
+    if (instream.gcount () != length)
+    {
+        cerr << "internal error: failed to read file " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
 bool
 exrCheck (
     const char* filename,
     bool        reduceMemory,
     bool        reduceTime,
     bool        useStream,
-    bool        enableCoreCheck)
+    bool        enableCoreCheck,
+    bool        structureOnly)
 {
     if (useStream)
     {
-        //
-        // open file as stream, check size
-        //
-        ifstream instream (filename, ifstream::binary);
+        vector<char> data;
+        if (!readFile (filename, data)) return true;
 
-        if (!instream)
-        {
-            cerr << "internal error: bad file '" << filename
-                 << "' for in-memory stream" << endl;
-            return true;
-        }
+        if (structureOnly)
+            return checkOpenEXRFileStructure (data.data (), data.size ());
 
-        instream.seekg (0, instream.end);
-        streampos length = instream.tellg ();
-        instream.seekg (0, instream.beg);
-
-        const uintptr_t kMaxSize = uintptr_t (-1) / 4;
-        if (length < 0 || length > (streampos) kMaxSize)
-        {
-            cerr << "internal error: bad file length " << length
-                 << " for in-memory stream" << endl;
-            return true;
-        }
-
-        //
-        // read into memory
-        //
-        vector<char> data (length);
-        instream.read (data.data (), length);
-        if (instream.gcount () != length)
-        {
-            cerr << "internal error: failed to read file " << filename << endl;
-            return true;
-        }
         return checkOpenEXRFile (
-            data.data (), length, reduceMemory, reduceTime, enableCoreCheck);
+            data.data (),
+            data.size (),
+            reduceMemory,
+            reduceTime,
+            enableCoreCheck);
     }
     else
     {
+        if (structureOnly) return checkOpenEXRFileStructure (filename);
+
         return checkOpenEXRFile (
             filename, reduceMemory, reduceTime, enableCoreCheck);
     }
 }
 
+//
+// Files checked in parallel, whose results are printed in the
+// order of the command line as soon as they are available
+//
+
+class CheckQueue
+{
+public:
+    CheckQueue () : _nextToPrint (0), _badFileFound (false) {}
+
+    size_t add (const char* filename);
+    void   setResult (size_t i, bool hasError);
+    bool   badFileFound ();
+
+private:
+    std::mutex          _mutex;
+    vector<const char*> _files;
+    vector<int>         _results; // 0: pending, 1: OK, 2: bad
+    size_t              _nextToPrint;
+    bool                _badFileFound;
+};
+
+size_t
+CheckQueue::add (const char* filename)
+{
+    std::lock_guard<std::mutex> lock (_mutex);
+    _files.push_back (filename);
+    _results.push_back (0);
+    return _files.size () - 1;
+}
+
+void
+CheckQueue::setResult (size_t i, bool hasError)
+{
+    std::lock_guard<std::mutex> lock (_mutex);
+    _results[i] = hasError ? 2 : 1;
+
+    while (_nextToPrint < _files.size () && _results[_nextToPrint] != 0)
+    {
+        bool bad = _results[_nextToPrint] == 2;
+        cout << " file " << _files[_nextToPrint] << ' '
+             << (bad ? "bad\n" : "OK\n");
+        cout.flush ();
+
+        _badFileFound = _badFileFound || bad;
+        ++_nextToPrint;
+    }
+}
+
+bool
+CheckQueue::badFileFound ()
+{
+    std::lock_guard<std::mutex> lock (_mutex);
+    return _badFileFound;
+}
+
+class CheckTask : public Task
+{
+public:
+    CheckTask (
+        TaskGroup*  group,
+        CheckQueue& queue,
+        const char* filename,
+        bool        reduceMemory,
+        bool        reduceTime,
+        bool        useStream,
+        bool        enableCoreCheck,
+        bool        structureOnly)
+        : Task (group)
+        , _queue (queue)
+        , _index (queue.add (filename))
+        , _filename (filename)
+        , _reduceMemory (reduceMemory)
+        , _reduceTime (reduceTime)
+        , _useStream (useStream)
+        , _enableCoreCheck (enableCoreCheck)
+        , _structureOnly (structureOnly)
+    {}
+
+    virtual void execute ()
+    {
+        bool hasError = true;
+
+        try
+        {
+            hasError = exrCheck (
+                _filename,
+                _reduceMemory,
+                _reduceTime,
+                _useStream,
+                _enableCoreCheck,
+                _structureOnly);
+        }
+        catch (...)
+        {}
+
+        _queue.setResult (_index, hasError);
+    }
+
+private:
+    CheckQueue& _queue;
+    size_t      _index;
+    const char* _filename;
+    bool        _reduceMemory;
+    bool        _reduceTime;
+    bool        _useStream;
+    bool        _enableCoreCheck;
+    bool        _structureOnly;
+};
+
 int
 main (int argc, char** argv)
 {
@@ -99,11 +246,41 @@ main (int argc, char** argv)
         return 1;
     }
 
+    //
+    // The number of files to check at a time applies to all files,
+    // wherever it appears on the command line
+    //
+
+    int numJobs = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp (argv[i], "-j"))
+        {
+            if (i + 1 >= argc || (numJobs = atoi (argv[i + 1])) < 1)
+            {
+                usageMessage (argv[0]);
+                return 1;
+            }
+            ++i;
+        }
+    }
+
+    CheckQueue                  queue;
+    std::unique_ptr<ThreadPool> pool;
+    std::unique_ptr<TaskGroup>  taskGroup;
+
+    if (numJobs > 1)
+    {
+        pool.reset (new ThreadPool (numJobs));
+        taskGroup.reset (new TaskGroup);
+    }
+
     bool reduceMemory    = false;
     bool reduceTime      = false;
     bool enableCoreCheck = false;
     bool badFileFound    = false;
     bool useStream       = false;
+    bool structureOnly   = false;
     for (int i = 1; i < argc; ++i)
     {
         if (!strcmp (argv[i], "-h"))
@@ -127,6 +304,14 @@ main (int argc, char** argv)
         {
             enableCoreCheck = true;
         }
+        else if (!strcmp (argv[i], "-q"))
+        {
+            structureOnly = true;
+        }
+        else if (!strcmp (argv[i], "-j"))
+        {
+            ++i; // already handled
+        }
         else if (!strcmp (argv[i], "-v"))
         {
             std::cout << OPENEXR_PACKAGE_STRING
@@ -147,15 +332,46 @@ main (int argc, char** argv)
             if (access (argv[i], R_OK) != 0)
 #endif
             {
+                //
+                // Finish and report the files before this one first
+                //
+                taskGroup.reset ();
+
                 cerr << "No such file: " << argv[i] << endl;
                 exit (-1);
             }
 
+            if (pool)
+            {
+                //
+                // Full checks read the file through several APIs, so
+                // read it into memory once, unless only the structure,
+                // a small part of the file, is checked
+                //
+
+                pool->addTask (new CheckTask (
+                    taskGroup.get (),
+                    queue,
+                    argv[i],
+                    reduceMemory,
+                    reduceTime,
+                    useStream || !structureOnly,
+                    enableCoreCheck,
+                    structureOnly));
+
+                continue;
+            }
+
             cout << " file " << argv[i] << ' ';
             cout.flush ();
 
             bool hasError = exrCheck (
-                argv[i], reduceMemory, reduceTime, useStream, enableCoreCheck);
+                argv[i],
+                reduceMemory,
+                reduceTime,
+                useStream,
+                enableCoreCheck,
+                structureOnly);
             if (hasError)
             {
                 cout << "bad\n";
@@ -168,5 +384,11 @@ main (int argc, char** argv)
         }
     }
 
-    return badFileFound;
+    //
+    // Wait for the files that are checked in parallel
+    //
+
+    taskGroup.reset ();
+
+    return badFileFound || queue.badFileFound ();
 }
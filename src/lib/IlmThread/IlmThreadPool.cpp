@@ -15,6 +15,10 @@
 #include "IlmThreadSemaphore.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -28,27 +32,22 @@ ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_ENTER
 #    define ENABLE_THREADING
 #endif
 
-#if defined(__GNU_LIBRARY__) &&                                                \
-    (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 21))
-#    define ENABLE_SEM_DTOR_WORKAROUND
-#endif
-
 #ifdef ENABLE_THREADING
 
 struct TaskGroup::Data
 {
-    Data ();
+    Data (TaskGroup* owner);
     ~Data ();
 
     void             addTask ();
     void             removeTask ();
     std::atomic<int> numPending;
-    Semaphore        isEmpty; // used to signal that the taskgroup is empty
-#    if defined(ENABLE_SEM_DTOR_WORKAROUND)
-    // this mutex is also used to lock numPending in the legacy c++ mode...
-    std::mutex dtorMutex; // used to work around the glibc bug:
-        // http://sources.redhat.com/bugzilla/show_bug.cgi?id=12674
-#    endif
+    // number of threads in the middle of removeTask, so the
+    // destructor knows when it is safe to destroy the mutex
+    std::atomic<int>        numRemoving;
+    std::mutex              emptyMutex;
+    std::condition_variable isEmpty; // signaled when the last task is removed
+    TaskGroup*              owner;   // the group whose tasks are counted
 };
 
 struct ThreadPool::Data
@@ -375,13 +374,535 @@ class NullThreadPoolProvider : public ThreadPoolProvider
     virtual void finish () {}
 };
 
+
+//
+// Work stealing thread pool provider
+//
+// Each worker owns a deque of tasks (a Chase-Lev deque, see "Dynamic
+// Circular Work-Stealing Deque", Chase & Lev 2005, using the C11
+// memory orderings from "Correct and Efficient Work-Stealing for
+// Weak Memory Models", Le et al. 2013). The owning worker pushes and
+// pops at the bottom without locks, other workers steal from the top.
+//
+// Tasks added from threads outside the pool are spread round-robin
+// over per-worker inboxes, so submitting threads and workers do not
+// all contend on a single lock.
+//
+// When a deque grows, thieves may still be reading the array it
+// replaces. Thieves are counted while they steal, and the owner frees
+// the retired arrays once the deque drains with no thief counted.
+//
+
+class TaskDeque
+{
+public:
+    TaskDeque ()
+        : _top (0), _bottom (0), _array (new Array (64)), _thieves (0)
+    {}
+    ~TaskDeque ()
+    {
+        delete _array.load (std::memory_order_relaxed);
+        for (Array* a: _retired)
+            delete a;
+    }
+    TaskDeque (const TaskDeque&) = delete;
+    TaskDeque& operator= (const TaskDeque&) = delete;
+    TaskDeque (TaskDeque&&)                 = delete;
+    TaskDeque& operator= (TaskDeque&&) = delete;
+
+    // only called by the owning thread
+    void push (Task* task)
+    {
+        int64_t b = _bottom.load (std::memory_order_relaxed);
+        int64_t t = _top.load (std::memory_order_acquire);
+        Array*  a = _array.load (std::memory_order_relaxed);
+
+        if (b - t > a->capacity - 1)
+        {
+            Array* bigger = a->grow (t, b);
+            // thieves may still be reading the old array, so keep it
+            // around until reclaim() finds none of them left
+            _retired.push_back (a);
+            _array.store (bigger, std::memory_order_seq_cst);
+            a = bigger;
+        }
+        a->put (b, task);
+        std::atomic_thread_fence (std::memory_order_release);
+        _bottom.store (b + 1, std::memory_order_relaxed);
+    }
+
+    // only called by the owning thread
+    Task* pop ()
+    {
+        int64_t b = _bottom.load (std::memory_order_relaxed) - 1;
+        Array*  a = _array.load (std::memory_order_relaxed);
+        _bottom.store (b, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        int64_t t = _top.load (std::memory_order_relaxed);
+
+        Task* task = nullptr;
+        if (t <= b)
+        {
+            task = a->get (b);
+            if (t == b)
+            {
+                // last item, race against the thieves for it
+                if (!_top.compare_exchange_strong (
+                        t,
+                        t + 1,
+                        std::memory_order_seq_cst,
+                        std::memory_order_relaxed))
+                    task = nullptr;
+                _bottom.store (b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+            _bottom.store (b + 1, std::memory_order_relaxed);
+
+        if (!task && !_retired.empty ()) reclaim ();
+        return task;
+    }
+
+    // called by any thread
+    Task* steal ()
+    {
+        Task* task = nullptr;
+
+        _thieves.fetch_add (1, std::memory_order_seq_cst);
+        int64_t t = _top.load (std::memory_order_acquire);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        int64_t b = _bottom.load (std::memory_order_acquire);
+
+        if (t < b)
+        {
+            Array* a = _array.load (std::memory_order_seq_cst);
+            task     = a->get (t);
+            if (!_top.compare_exchange_strong (
+                    t,
+                    t + 1,
+                    std::memory_order_seq_cst,
+                    std::memory_order_relaxed))
+                task = nullptr;
+        }
+        _thieves.fetch_sub (1, std::memory_order_release);
+        return task;
+    }
+
+    bool empty () const
+    {
+        int64_t b = _bottom.load (std::memory_order_relaxed);
+        int64_t t = _top.load (std::memory_order_relaxed);
+        return b <= t;
+    }
+
+private:
+    //
+    // Only called by the owning thread. A thief counts itself before
+    // it loads the array, and the array was replaced before the count
+    // is read here, so a thief which is not counted can only see the
+    // current array, never a retired one
+    //
+    void reclaim ()
+    {
+        if (_thieves.load (std::memory_order_seq_cst) != 0) return;
+        for (Array* a: _retired)
+            delete a;
+        _retired.clear ();
+    }
+
+    struct Array
+    {
+        explicit Array (int64_t cap)
+            : capacity (cap), buffer (new std::atomic<Task*>[cap])
+        {}
+        ~Array () { delete[] buffer; }
+        Array (const Array&) = delete;
+        Array& operator= (const Array&) = delete;
+        Array (Array&&)                 = delete;
+        Array& operator= (Array&&) = delete;
+
+        Task* get (int64_t i) const
+        {
+            return buffer[i & (capacity - 1)].load (std::memory_order_relaxed);
+        }
+        void put (int64_t i, Task* t)
+        {
+            buffer[i & (capacity - 1)].store (t, std::memory_order_relaxed);
+        }
+        Array* grow (int64_t t, int64_t b) const
+        {
+            Array* a = new Array (capacity * 2);
+            for (int64_t i = t; i != b; ++i)
+                a->put (i, get (i));
+            return a;
+        }
+
+        int64_t             capacity;
+        std::atomic<Task*>* buffer;
+    };
+
+    std::atomic<int64_t> _top;
+    std::atomic<int64_t> _bottom;
+    std::atomic<Array*>  _array;
+    std::atomic<int>     _thieves;
+    std::vector<Array*>  _retired;
+};
+
+struct StealingWorkData;
+
+struct StealingWorker
+{
+    StealingWorker () : inboxSize (0) {}
+
+    TaskDeque          tasks;     // tasks spawned by this worker
+    std::mutex         inboxMutex;
+    std::deque<Task*>  inbox;     // tasks added from outside the pool
+    std::atomic<int>   inboxSize; // allows skipping the lock when empty
+    std::thread        thread;
+};
+
+struct StealingWorkData
+{
+    StealingWorkData ()
+        : numWorkers (0)
+        , stopping (false)
+        , sleepers (0)
+        , epoch (0)
+        , nextInbox (0)
+    {}
+
+    //
+    // The workers only change while no worker is running, and with
+    // threadMutex held. It is recursive because finish() runs any
+    // leftover tasks with the lock held, and they may add tasks
+    //
+
+    std::vector<std::unique_ptr<StealingWorker>> workers;
+    std::atomic<int>                             numWorkers;
+    mutable std::recursive_mutex                 threadMutex;
+
+    std::atomic<bool>     stopping;
+    std::atomic<int>      sleepers;
+    std::atomic<uint64_t> epoch; // bumped each time work is added
+    std::mutex            sleepMutex;
+    std::condition_variable wakeup;
+
+    std::atomic<unsigned> nextInbox;
+
+    Task* findTask (int self);
+    void  notifyWork ();
+    void  run (int self);
+};
+
+// worker state for the current thread, used to push tasks spawned
+// by a worker onto its own queue, and to let a worker waiting on a
+// task group help run the pending tasks
+thread_local StealingWorkData* tlStealingData  = nullptr;
+thread_local int               tlStealingIndex = -1;
+
+//
+// A per-thread xorshift generator, seeded from the thread id, to pick
+// the worker where a search for work starts
+//
+inline int
+randomWorker (int n)
+{
+    thread_local uint32_t state = 0;
+
+    if (state == 0)
+    {
+        size_t id = std::hash<std::thread::id> () (std::this_thread::get_id ());
+        state     = static_cast<uint32_t> (id) | 1;
+    }
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<int> (state % static_cast<uint32_t> (n));
+}
+
+inline void
+runTask (Task* task)
+{
+    TaskGroup* taskGroup = task->group ();
+    task->execute ();
+    delete task;
+    taskGroup->finishOneTask ();
+}
+
+Task*
+StealingWorkData::findTask (int self)
+{
+    int   n = static_cast<int> (workers.size ());
+    Task* task;
+
+    if (self >= 0)
+    {
+        StealingWorker& me = *workers[self];
+
+        task = me.tasks.pop ();
+        if (task) return task;
+
+        if (me.inboxSize.load (std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lk (me.inboxMutex);
+            if (!me.inbox.empty ())
+            {
+                task = me.inbox.front ();
+                me.inbox.pop_front ();
+                me.inboxSize.fetch_sub (1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+    }
+
+    // start the search at a random worker so the thieves don't all
+    // converge on the same queue
+    int start = randomWorker (n);
+    for (int i = 0; i < n; ++i)
+    {
+        int v = (start + i) % n;
+        if (v == self) continue;
+
+        StealingWorker& victim = *workers[v];
+
+        task = victim.tasks.steal ();
+        if (task) return task;
+
+        if (victim.inboxSize.load (std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lk (victim.inboxMutex);
+            if (!victim.inbox.empty ())
+            {
+                task = victim.inbox.front ();
+                victim.inbox.pop_front ();
+                victim.inboxSize.fetch_sub (1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void
+StealingWorkData::notifyWork ()
+{
+    epoch.fetch_add (1);
+    if (sleepers.load () > 0)
+    {
+        std::lock_guard<std::mutex> lk (sleepMutex);
+        wakeup.notify_one ();
+    }
+}
+
+void
+StealingWorkData::run (int self)
+{
+    tlStealingData  = this;
+    tlStealingIndex = self;
+
+    while (true)
+    {
+        uint64_t curEpoch = epoch.load ();
+        Task*    task     = findTask (self);
+
+        if (task)
+        {
+            runTask (task);
+            continue;
+        }
+
+        if (stopping.load ()) break;
+
+        //
+        // Nothing to do, sleep until more work is added. If work was
+        // added since we started looking, the epoch will have changed
+        // and we go around again instead of sleeping
+        //
+
+        std::unique_lock<std::mutex> lk (sleepMutex);
+        sleepers.fetch_add (1);
+        while (epoch.load () == curEpoch && !stopping.load ())
+            wakeup.wait (lk);
+        sleepers.fetch_sub (1);
+    }
+
+    tlStealingData  = nullptr;
+    tlStealingIndex = -1;
+}
+
+//
+// Run one pending task of a task group on behalf of a worker thread
+// which is waiting for that group to finish, so nested task groups
+// do not leave the worker idle (or deadlock the pool). Only tasks of
+// the group are run, unrelated tasks could need locks the waiting
+// thread holds. The worker's own queue is where tasks it spawned for
+// the group are, any that are not there are running elsewhere or
+// will be stolen. They were pushed last, so the bottom task is
+// usually one of them, and the rest of the queue is only searched
+// when it is not. Returns false if the current thread is not a
+// worker, or there is nothing of the group to run.
+//
+bool
+helpRunPendingTask (const TaskGroup* group)
+{
+    StealingWorkData* data = tlStealingData;
+    if (!data) return false;
+
+    TaskDeque& tasks = data->workers[tlStealingIndex]->tasks;
+    Task*      task  = tasks.pop ();
+
+    if (!task) return false;
+
+    if (task->group () != group)
+    {
+        std::vector<Task*> others (1, task);
+
+        while ((task = tasks.pop ()) && task->group () != group)
+            others.push_back (task);
+
+        // put back what was skipped, in the same order
+        for (auto i = others.rbegin (); i != others.rend (); ++i)
+            tasks.push (*i);
+
+        if (!task) return false;
+    }
+
+    runTask (task);
+    return true;
+}
+
+class WorkStealingThreadPoolProvider : public ThreadPoolProvider
+{
+public:
+    WorkStealingThreadPoolProvider (int count);
+    virtual ~WorkStealingThreadPoolProvider ();
+
+    virtual int  numThreads () const;
+    virtual void setNumThreads (int count);
+    virtual void addTask (Task* task);
+
+    virtual void finish ();
+
+private:
+    StealingWorkData _data;
+};
+
+WorkStealingThreadPoolProvider::WorkStealingThreadPoolProvider (int count)
+{
+    setNumThreads (count);
+}
+
+WorkStealingThreadPoolProvider::~WorkStealingThreadPoolProvider ()
+{
+    finish ();
+}
+
+int
+WorkStealingThreadPoolProvider::numThreads () const
+{
+    return _data.numWorkers.load ();
+}
+
+void
+WorkStealingThreadPoolProvider::setNumThreads (int count)
+{
+    std::lock_guard<std::recursive_mutex> lock (_data.threadMutex);
+
+    if (static_cast<size_t> (count) == _data.workers.size ()) return;
+
+    //
+    // The queues are indexed by worker, so stop and restart all the
+    // threads rather than trying to resize under running workers
+    //
+
+    finish ();
+
+    for (int i = 0; i < count; ++i)
+        _data.workers.emplace_back (new StealingWorker);
+    for (int i = 0; i < count; ++i)
+        _data.workers[i]->thread =
+            std::thread (&StealingWorkData::run, &_data, i);
+    _data.numWorkers = count;
+}
+
+void
+WorkStealingThreadPoolProvider::addTask (Task* task)
+{
+    if (tlStealingData == &_data)
+    {
+        //
+        // Spawned from one of our workers, no lock needed
+        //
+        _data.workers[tlStealingIndex]->tasks.push (task);
+    }
+    else
+    {
+        //
+        // The workers can not change while we hold the lock; a task
+        // run here for lack of workers must not hold it, as it may
+        // add more tasks
+        //
+
+        std::unique_lock<std::recursive_mutex> lock (_data.threadMutex);
+        size_t                                 n = _data.workers.size ();
+
+        if (n == 0)
+        {
+            lock.unlock ();
+            runTask (task);
+            return;
+        }
+
+        StealingWorker& w = *_data.workers
+                                 [_data.nextInbox.fetch_add (
+                                      1, std::memory_order_relaxed) %
+                                  n];
+        {
+            std::lock_guard<std::mutex> lk (w.inboxMutex);
+            w.inbox.push_back (task);
+            w.inboxSize.fetch_add (1, std::memory_order_release);
+        }
+    }
+
+    _data.notifyWork ();
+}
+
+void
+WorkStealingThreadPoolProvider::finish ()
+{
+    std::lock_guard<std::recursive_mutex> lock (_data.threadMutex);
+
+    _data.stopping = true;
+    {
+        std::lock_guard<std::mutex> lk (_data.sleepMutex);
+        _data.wakeup.notify_all ();
+    }
+
+    for (auto& w: _data.workers)
+    {
+        if (w->thread.joinable ()) w->thread.join ();
+    }
+
+    //
+    // Workers only stop once they can't find any work, but run
+    // anything that is left so no task group waits forever
+    //
+    Task* task;
+    while (!_data.workers.empty () && (task = _data.findTask (-1)))
+        runTask (task);
+
+    _data.workers.clear ();
+    _data.numWorkers = 0;
+    _data.stopping   = false;
+}
 } //namespace
 
 //
 // struct TaskGroup::Data
 //
 
-TaskGroup::Data::Data () : numPending (0), isEmpty (1)
+TaskGroup::Data::Data (TaskGroup* o)
+    : numPending (0), numRemoving (0), owner (o)
 {
     // empty
 }
@@ -389,69 +910,52 @@ TaskGroup::Data::Data () : numPending (0), isEmpty (1)
 TaskGroup::Data::~Data ()
 {
     //
-    // A TaskGroup acts like an "inverted" semaphore: if the count
-    // is above 0 then waiting on the taskgroup will block.  This
-    // destructor waits until the taskgroup is empty before returning.
+    // Wait until the taskgroup is empty before returning. A worker
+    // thread of a work stealing pool runs the pending tasks while
+    // waiting, instead of blocking.
     //
 
-    isEmpty.wait ();
+    while (numPending.load () != 0 && helpRunPendingTask (owner))
+        ;
+
+    if (numPending.load () != 0)
+    {
+        std::unique_lock<std::mutex> lk (emptyMutex);
+        while (numPending.load () != 0)
+            isEmpty.wait (lk);
+    }
 
-#    ifdef ENABLE_SEM_DTOR_WORKAROUND
-    // Update: this was fixed in v. 2.2.21, so this ifdef checks for that
     //
-    // Alas, given the current bug in glibc we need a secondary
-    // syncronisation primitive here to account for the fact that
-    // destructing the isEmpty Semaphore in this thread can cause
-    // an error for a separate thread that is issuing the post() call.
-    // We are entitled to destruct the semaphore at this point, however,
-    // that post() call attempts to access data out of the associated
-    // memory *after* it has woken the waiting threads, including this one,
-    // potentially leading to invalid memory reads.
-    // http://sources.redhat.com/bugzilla/show_bug.cgi?id=12674
+    // The thread removing the last task may still be about to signal
+    // us, don't destroy the mutex out from under it
+    //
 
-    std::lock_guard<std::mutex> lock (dtorMutex);
-#    endif
+    while (numRemoving.load () != 0)
+        std::this_thread::yield ();
 }
 
 void
 TaskGroup::Data::addTask ()
 {
-    //
-    // in c++11, we use an atomic to protect numPending to avoid the
-    // extra lock but for c++98, to add the ability for custom thread
-    // pool we add the lock here
-    //
-    if (numPending++ == 0) isEmpty.wait ();
+    ++numPending;
 }
 
 void
 TaskGroup::Data::removeTask ()
 {
-    // Alas, given the current bug in glibc we need a secondary
-    // syncronisation primitive here to account for the fact that
-    // destructing the isEmpty Semaphore in a separate thread can
-    // cause an error. Issuing the post call here the current libc
-    // implementation attempts to access memory *after* it has woken
-    // waiting threads.
-    // Since other threads are entitled to delete the semaphore the
-    // access to the memory location can be invalid.
-    // http://sources.redhat.com/bugzilla/show_bug.cgi?id=12674
-    // Update: this bug has been fixed, but how do we know which
-    // glibc version we're in?
-
-    // Further update:
     //
-    // we could remove this if it is a new enough glibc, however
-    // we've changed the API to enable a custom override of a
-    // thread pool. In order to provide safe access to the numPending,
-    // we need the lock anyway, except for c++11 or newer
+    // Only the last task needs to take the lock, to signal any thread
+    // waiting in the destructor. numRemoving is raised before the
+    // count is dropped, so the destructor can not observe an empty
+    // group and return while we still need the mutex
+    //
+    ++numRemoving;
     if (--numPending == 0)
     {
-#    ifdef ENABLE_SEM_DTOR_WORKAROUND
-        std::lock_guard<std::mutex> lk (dtorMutex);
-#    endif
-        isEmpty.post ();
+        std::lock_guard<std::mutex> lk (emptyMutex);
+        isEmpty.notify_all ();
     }
+    --numRemoving;
 }
 
 //
@@ -568,7 +1072,7 @@ Task::group ()
 TaskGroup::TaskGroup ()
     :
 #ifdef ENABLE_THREADING
-    _data (new Data ())
+    _data (new Data (this))
 #else
     _data (nullptr)
 #endif
@@ -716,6 +1220,21 @@ ThreadPool::globalThreadPool ()
     return gThreadPool;
 }
 
+ThreadPoolProvider*
+ThreadPool::createWorkStealingProvider (int numThreads)
+{
+#ifdef ENABLE_THREADING
+    if (numThreads < 0)
+        throw IEX_INTERNAL_NAMESPACE::ArgExc (
+            "Attempt to create a thread provider with a negative "
+            "number of threads.");
+    return new WorkStealingThreadPoolProvider (numThreads);
+#else
+    (void) numThreads;
+    return nullptr;
+#endif
+}
+
 void
 ThreadPool::addGlobalTask (Task* task)
 {
@@ -130,6 +130,26 @@ public:
     //--------------------------------------------------------
     ILMTHREAD_EXPORT void setThreadProvider (ThreadPoolProvider* provider);
 
+    //--------------------------------------------------------
+    // Create a thread provider where each worker thread has its
+    // own task queue, instead of all threads sharing a single
+    // locked queue. Tasks added from a worker thread go on that
+    // worker's queue without taking a lock, and idle workers
+    // steal tasks from the other queues. This scales better
+    // when there are many threads and many small tasks, at the
+    // cost of tasks no longer being started in FIFO order.
+    //
+    // The result is meant to be passed to setThreadProvider,
+    // which then owns it, e.g.
+    //
+    //   pool.setThreadProvider (
+    //       ThreadPool::createWorkStealingProvider (n));
+    //
+    // Returns nullptr if threading is disabled.
+    //--------------------------------------------------------
+    ILMTHREAD_EXPORT
+    static ThreadPoolProvider* createWorkStealingProvider (int numThreads);
+
     //------------------------------------------------------------
     // Add a task for processing.  The ThreadPool can handle any
     // number of tasks regardless of the number of worker threads.
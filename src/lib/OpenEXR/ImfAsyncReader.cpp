@@ -0,0 +1,770 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//	class AsyncReader
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfAsyncReader.h"
+
+#include "Iex.h"
+#include "IlmThreadConfig.h"
+#include "ImfHeader.h"
+#include "ImfIO.h"
+#include "ImfInputPart.h"
+#include "ImfMMapIO.h"
+#include "ImfMisc.h"
+#include "ImfMultiPartInputFile.h"
+#include "ImfPartType.h"
+#include "ImfStdIO.h"
+#include "ImfThreading.h"
+#include "ImfVersion.h"
+#include "ImfXdr.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string.h>
+#include <vector>
+#if ILMTHREAD_THREADING_ENABLED
+#    include <condition_variable>
+#    include <mutex>
+#    include <thread>
+#endif
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+using std::deque;
+using std::exception_ptr;
+using std::future;
+using std::promise;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace
+{
+
+//
+// The parts of a file that are needed to read one of its parts:
+// the headers and chunk offset tables, and the part's chunks.  A
+// file that can be memory-mapped is not copied; the mapping is kept
+// alive for as long as the file is in use, and covers the whole file.
+//
+
+struct LoadedFile
+{
+    struct Range
+    {
+        uint64_t    pos;  // position in the file
+        uint64_t    size; // number of bytes
+        const char* data; // the bytes
+    };
+
+    uint64_t                 fileSize;
+    vector<Range>            ranges;      // sorted by position
+    vector<vector<char>>     bytes;       // the ranges' bytes, if read
+    shared_ptr<MMapIFStream> mapping;     // the file, if mapped
+    size_t                   loadedBytes; // bytes needed for the part
+
+    LoadedFile () : fileSize (0), loadedBytes (0) {}
+};
+
+bool
+startsAfter (uint64_t pos, const LoadedFile::Range& range)
+{
+    return pos < range.pos;
+}
+
+//
+// An IStream over a file that has been loaded into memory.
+// It behaves like a memory-mapped stream, so the file readers
+// use the loaded bytes without copying them.
+//
+
+class MemoryIStream : public IStream
+{
+public:
+    MemoryIStream (const char fileName[], shared_ptr<const LoadedFile> file)
+        : IStream (fileName), _file (file), _range (0), _pos (0)
+    {}
+
+    virtual bool isMemoryMapped () const { return true; }
+
+    virtual bool read (char c[/*n*/], int n)
+    {
+        memcpy (c, readMemoryMapped (n), n);
+        return _pos < _file->fileSize;
+    }
+
+    virtual char* readMemoryMapped (int n)
+    {
+        if (n < 0 || _pos > _file->fileSize ||
+            _file->fileSize - _pos < uint64_t (n))
+            throw IEX_NAMESPACE::InputExc ("Unexpected end of file.");
+
+        //
+        // The file readers read each chunk front to back, so the
+        // range of the previous read usually holds the next one.
+        //
+
+        const vector<LoadedFile::Range>& ranges = _file->ranges;
+
+        if (_range >= ranges.size () || _pos < ranges[_range].pos ||
+            _pos - ranges[_range].pos >= ranges[_range].size)
+        {
+            _range = std::upper_bound (
+                         ranges.begin (), ranges.end (), _pos, startsAfter) -
+                     ranges.begin () - 1;
+        }
+
+        if (_range >= ranges.size () ||
+            ranges[_range].size - (_pos - ranges[_range].pos) < uint64_t (n))
+        {
+            THROW (
+                IEX_NAMESPACE::InputExc,
+                "Cannot read " << n << " bytes at position " << _pos
+                               << " of file \"" << fileName ()
+                               << "\", which lie outside of the part "
+                                  "that was loaded.");
+        }
+
+        const char* p = ranges[_range].data + (_pos - ranges[_range].pos);
+        _pos += n;
+        return const_cast<char*> (p);
+    }
+
+    virtual uint64_t tellg () { return _pos; }
+
+    virtual void seekg (uint64_t pos) { _pos = pos; }
+
+private:
+    shared_ptr<const LoadedFile> _file;
+    size_t                       _range;
+    uint64_t                     _pos;
+};
+
+//
+// Find the byte ranges of a file that InputPart reads for part
+// partNumber: the headers and chunk offset tables at the start of
+// the file, and the part's chunks.  Each chunk ends where the next
+// chunk in the file, of any part, begins.  If the file cannot be
+// parsed, or if it has chunk offsets that the file readers would
+// have to reconstruct by scanning the whole file, the whole file
+// is one range.
+//
+
+typedef vector<std::pair<uint64_t, uint64_t>> ByteRanges; // (begin, end)
+
+ByteRanges
+partRanges (IStream& is, uint64_t fileSize, int partNumber)
+{
+    ByteRanges wholeFile (1, std::make_pair (uint64_t (0), fileSize));
+
+    try
+    {
+        int magic, version;
+        Xdr::read<StreamIO> (is, magic);
+        Xdr::read<StreamIO> (is, version);
+
+        if (magic != MAGIC) return wholeFile;
+
+        vector<Header> headers;
+
+        while (true)
+        {
+            Header header;
+            header.readFrom (is, version);
+
+            if (header.readsNothing ()) break;
+
+            //
+            // Single-part files get their type the way
+            // MultiPartInputFile gives it to them
+            //
+
+            if (!isMultiPart (version) &&
+                (!header.hasType () || !isNonImage (version)))
+            {
+                header.setType (isTiled (version) ? TILEDIMAGE : SCANLINEIMAGE);
+            }
+
+            headers.push_back (header);
+
+            if (!isMultiPart (version)) break;
+        }
+
+        if (partNumber < 0 || partNumber >= int (headers.size ()))
+            return wholeFile;
+
+        vector<vector<uint64_t>> offsets (headers.size ());
+        vector<uint64_t>         starts;
+
+        for (size_t i = 0; i < headers.size (); ++i)
+        {
+            int n = getChunkOffsetTableSize (headers[i]);
+
+            if (n < 0 || uint64_t (n) > (fileSize - is.tellg ()) / 8)
+                return wholeFile;
+
+            offsets[i].resize (n);
+
+            for (int j = 0; j < n; ++j)
+                Xdr::read<StreamIO> (is, offsets[i][j]);
+
+            starts.insert (
+                starts.end (), offsets[i].begin (), offsets[i].end ());
+        }
+
+        uint64_t tablesEnd = is.tellg ();
+
+        std::sort (starts.begin (), starts.end ());
+
+        if (starts.empty () || starts.front () < tablesEnd ||
+            starts.back () >= fileSize)
+        {
+            return wholeFile;
+        }
+
+        vector<uint64_t>& chunks = offsets[partNumber];
+        std::sort (chunks.begin (), chunks.end ());
+
+        ByteRanges ranges (1, std::make_pair (uint64_t (0), tablesEnd));
+
+        for (size_t j = 0; j < chunks.size (); ++j)
+        {
+            vector<uint64_t>::const_iterator next =
+                std::upper_bound (starts.begin (), starts.end (), chunks[j]);
+
+            uint64_t end = next == starts.end () ? fileSize : *next;
+
+            if (chunks[j] <= ranges.back ().second)
+                ranges.back ().second = std::max (ranges.back ().second, end);
+            else
+                ranges.push_back (std::make_pair (chunks[j], end));
+        }
+
+        return ranges;
+    }
+    catch (...)
+    {
+        return wholeFile;
+    }
+}
+
+//
+// Touch every page of a memory-mapped byte range, so that the
+// operating system reads it in now rather than during decoding
+//
+
+void
+pageIn (const char* p, uint64_t n)
+{
+    char sum = 0;
+
+    for (uint64_t i = 0; i < n; i += 4096)
+        sum ^= p[i];
+
+    volatile char keep = sum;
+    (void) keep;
+}
+
+//
+// Load the parts of a file that are needed to read part partNumber
+//
+
+shared_ptr<const LoadedFile>
+loadFile (const string& fileName, int partNumber)
+{
+    shared_ptr<LoadedFile> file (new LoadedFile);
+
+    //
+    // Map the file only if the file readers would, see
+    // setMemoryMappedFileInput()
+    //
+
+    if (memoryMappedFileInput () && MMapIFStream::isSupported ())
+    {
+        try
+        {
+            file->mapping.reset (new MMapIFStream (fileName.c_str ()));
+        }
+        catch (...)
+        {
+            //
+            // Not something we can map, read it below
+            //
+        }
+    }
+
+    if (file->mapping)
+    {
+        MMapIFStream& is = *file->mapping;
+        file->fileSize   = is.size ();
+
+        LoadedFile::Range range = {0, is.size (), is.data ()};
+        file->ranges.push_back (range);
+
+        ByteRanges ranges = partRanges (is, is.size (), partNumber);
+
+        for (size_t i = 0; i < ranges.size (); ++i)
+        {
+            uint64_t n = ranges[i].second - ranges[i].first;
+            is.prefetch (ranges[i].first, n);
+            pageIn (is.data () + ranges[i].first, n);
+            file->loadedBytes += n;
+        }
+
+        return file;
+    }
+
+    std::ifstream is (fileName.c_str (), std::ios_base::binary);
+
+    if (!is)
+    {
+        THROW (
+            IEX_NAMESPACE::InputExc,
+            "Cannot open image file \"" << fileName << "\".");
+    }
+
+    is.seekg (0, std::ios_base::end);
+    file->fileSize = is.tellg ();
+    is.seekg (0);
+
+    ByteRanges ranges;
+
+    {
+        StdIFStream sis (is, fileName.c_str ());
+        ranges = partRanges (sis, file->fileSize, partNumber);
+    }
+
+    is.clear ();
+    file->bytes.resize (ranges.size ());
+
+    for (size_t i = 0; i < ranges.size (); ++i)
+    {
+        vector<char>& bytes = file->bytes[i];
+        bytes.resize (ranges[i].second - ranges[i].first);
+
+        is.seekg (ranges[i].first);
+        is.read (bytes.data (), bytes.size ());
+
+        if (!is)
+        {
+            THROW (
+                IEX_NAMESPACE::InputExc,
+                "Cannot read image file \"" << fileName << "\".");
+        }
+
+        LoadedFile::Range range = {
+            ranges[i].first, bytes.size (), bytes.data ()};
+        file->ranges.push_back (range);
+        file->loadedBytes += bytes.size ();
+    }
+
+    return file;
+}
+
+struct Job
+{
+    AsyncReader::Request         request;
+    promise<void>                result;
+    shared_ptr<const LoadedFile> file;      // the file, once loaded
+    exception_ptr                loadError; // why the file could not be loaded
+
+    size_t loadedBytes () const { return file ? file->loadedBytes : 0; }
+};
+
+//
+// Read the pixels of a loaded file into the request's frame buffer
+//
+
+void
+decode (Job& job)
+{
+    if (job.loadError) std::rethrow_exception (job.loadError);
+
+    MemoryIStream      is (job.request.fileName.c_str (), job.file);
+    MultiPartInputFile file (is, globalThreadCount ());
+
+    if (job.request.partNumber < 0 ||
+        job.request.partNumber >= file.parts ())
+    {
+        THROW (
+            IEX_NAMESPACE::ArgExc,
+            "Cannot read part " << job.request.partNumber << " of image file \""
+                                << job.request.fileName << "\", which has "
+                                << file.parts () << " parts.");
+    }
+
+    InputPart part (file, job.request.partNumber);
+
+    if (job.request.prepare)
+        job.request.prepare (part.header (), job.request.frameBuffer);
+
+    const IMATH_NAMESPACE::Box2i& dw = part.header ().dataWindow ();
+
+    part.setFrameBuffer (job.request.frameBuffer);
+    part.readPixels (dw.min.y, dw.max.y);
+}
+
+//
+// Complete a request: the done function is called first, so that
+// it has returned by the time the future becomes ready.
+//
+
+void
+finish (Job& job, exception_ptr error)
+{
+    try
+    {
+        if (job.request.done) job.request.done (error);
+    }
+    catch (...)
+    {
+        if (!error) error = std::current_exception ();
+    }
+
+    if (error)
+        job.result.set_exception (error);
+    else
+        job.result.set_value ();
+}
+
+void
+finish (Job& job)
+{
+    exception_ptr error;
+
+    try
+    {
+        decode (job);
+    }
+    catch (...)
+    {
+        error = std::current_exception ();
+    }
+
+    finish (job, error);
+}
+
+exception_ptr
+cancelled ()
+{
+    return std::make_exception_ptr (
+        IEX_NAMESPACE::BaseExc ("Image read request was cancelled."));
+}
+
+} // namespace
+
+#if ILMTHREAD_THREADING_ENABLED
+
+struct AsyncReader::Data
+{
+    int    maxFramesAhead;
+    size_t maxBytesAhead;
+
+    std::mutex              mutex;
+    std::condition_variable changed;
+
+    deque<shared_ptr<Job>> queued;  // waiting to be loaded
+    deque<shared_ptr<Job>> loaded;  // loaded, waiting to be decoded
+    int                    loading; // files being loaded (0 or 1)
+    int                    active;  // requests being decoded (0 or 1)
+    size_t                 bytesAhead;
+    bool                   stop;
+
+    std::thread loader;
+    std::thread decoder;
+
+    Data (int maxFramesAhead, size_t maxBytesAhead);
+
+    void runLoader ();
+    void runDecoder ();
+
+    int  pending () const;
+    void cancelAll (std::unique_lock<std::mutex>& lock);
+};
+
+AsyncReader::Data::Data (int frames, size_t bytes)
+    : maxFramesAhead (std::max (1, frames))
+    , maxBytesAhead (bytes)
+    , loading (0)
+    , active (0)
+    , bytesAhead (0)
+    , stop (false)
+{}
+
+int
+AsyncReader::Data::pending () const
+{
+    return int (queued.size () + loaded.size ()) + loading + active;
+}
+
+void
+AsyncReader::Data::runLoader ()
+{
+    std::unique_lock<std::mutex> lock (mutex);
+
+    while (true)
+    {
+        //
+        // Load the next file when there is room ahead of the decoder;
+        // a single file is always allowed, however large it is.
+        //
+
+        while (!stop &&
+               (queued.empty () ||
+                int (loaded.size ()) >= maxFramesAhead ||
+                (!loaded.empty () && bytesAhead >= maxBytesAhead)))
+        {
+            changed.wait (lock);
+        }
+
+        if (stop) return;
+
+        shared_ptr<Job> job = queued.front ();
+        queued.pop_front ();
+        loading = 1;
+
+        lock.unlock ();
+
+        try
+        {
+            job->file =
+                loadFile (job->request.fileName, job->request.partNumber);
+        }
+        catch (...)
+        {
+            job->loadError = std::current_exception ();
+        }
+
+        lock.lock ();
+
+        loading = 0;
+        bytesAhead += job->loadedBytes ();
+        loaded.push_back (job);
+        changed.notify_all ();
+    }
+}
+
+void
+AsyncReader::Data::runDecoder ()
+{
+    std::unique_lock<std::mutex> lock (mutex);
+
+    while (true)
+    {
+        while (!stop && loaded.empty ())
+            changed.wait (lock);
+
+        if (stop) return;
+
+        shared_ptr<Job> job = loaded.front ();
+        loaded.pop_front ();
+        active = 1;
+
+        lock.unlock ();
+
+        finish (*job);
+
+        lock.lock ();
+
+        bytesAhead -= job->loadedBytes ();
+        active = 0;
+        job.reset ();
+        changed.notify_all ();
+    }
+}
+
+void
+AsyncReader::Data::cancelAll (std::unique_lock<std::mutex>& lock)
+{
+    //
+    // Requests that are waiting to be loaded or decoded are
+    // taken out of the queues and failed; a file that is already
+    // being loaded is still decoded.
+    //
+
+    deque<shared_ptr<Job>> jobs;
+    jobs.swap (queued);
+
+    for (size_t i = 0; i < loaded.size (); ++i)
+    {
+        bytesAhead -= loaded[i]->loadedBytes ();
+        loaded[i]->loadError = cancelled ();
+        jobs.push_back (loaded[i]);
+    }
+
+    loaded.clear ();
+
+    //
+    // Complete the requests without holding the lock, so that
+    // their done functions may queue new requests.
+    //
+
+    lock.unlock ();
+
+    for (size_t i = 0; i < jobs.size (); ++i)
+        finish (*jobs[i], cancelled ());
+
+    lock.lock ();
+    changed.notify_all ();
+}
+
+AsyncReader::AsyncReader (int maxFramesAhead, size_t maxBytesAhead)
+    : _data (new Data (maxFramesAhead, maxBytesAhead))
+{
+    try
+    {
+        _data->loader  = std::thread (&Data::runLoader, _data);
+        _data->decoder = std::thread (&Data::runDecoder, _data);
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock (_data->mutex);
+            _data->stop = true;
+        }
+        _data->changed.notify_all ();
+
+        if (_data->loader.joinable ()) _data->loader.join ();
+        delete _data;
+        throw;
+    }
+}
+
+AsyncReader::~AsyncReader ()
+{
+    {
+        std::lock_guard<std::mutex> lock (_data->mutex);
+        _data->stop = true;
+    }
+
+    //
+    // The threads finish the file they are loading or decoding,
+    // if any; whatever is left in the queues is then cancelled.
+    //
+
+    _data->changed.notify_all ();
+    _data->loader.join ();
+    _data->decoder.join ();
+
+    {
+        std::unique_lock<std::mutex> lock (_data->mutex);
+        _data->cancelAll (lock);
+    }
+
+    delete _data;
+}
+
+future<void>
+AsyncReader::read (const Request& request)
+{
+    shared_ptr<Job> job (new Job);
+    job->request = request;
+
+    future<void> f = job->result.get_future ();
+
+    {
+        std::lock_guard<std::mutex> lock (_data->mutex);
+        _data->queued.push_back (job);
+    }
+
+    _data->changed.notify_all ();
+    return f;
+}
+
+void
+AsyncReader::cancel ()
+{
+    std::unique_lock<std::mutex> lock (_data->mutex);
+    _data->cancelAll (lock);
+}
+
+void
+AsyncReader::wait ()
+{
+    std::unique_lock<std::mutex> lock (_data->mutex);
+
+    while (_data->pending () > 0)
+        _data->changed.wait (lock);
+}
+
+int
+AsyncReader::pending () const
+{
+    std::lock_guard<std::mutex> lock (_data->mutex);
+    return _data->pending ();
+}
+
+#else
+
+//
+// Without threads, requests are completed as soon as they are made
+//
+
+struct AsyncReader::Data
+{};
+
+AsyncReader::AsyncReader (int, size_t) : _data (new Data)
+{}
+
+AsyncReader::~AsyncReader ()
+{
+    delete _data;
+}
+
+future<void>
+AsyncReader::read (const Request& request)
+{
+    Job job;
+    job.request = request;
+
+    try
+    {
+        job.file = loadFile (job.request.fileName, job.request.partNumber);
+    }
+    catch (...)
+    {
+        job.loadError = std::current_exception ();
+    }
+
+    future<void> f = job.result.get_future ();
+    finish (job);
+    return f;
+}
+
+void
+AsyncReader::cancel ()
+{}
+
+void
+AsyncReader::wait ()
+{}
+
+int
+AsyncReader::pending () const
+{
+    return 0;
+}
+
+#endif
+
+future<void>
+AsyncReader::read (
+    const string& fileName, const FrameBuffer& frameBuffer, int partNumber)
+{
+    Request request;
+    request.fileName    = fileName;
+    request.partNumber  = partNumber;
+    request.frameBuffer = frameBuffer;
+    return read (request);
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,142 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_ASYNC_READER_H
+#define INCLUDED_IMF_ASYNC_READER_H
+
+//-----------------------------------------------------------------------------
+//
+//	class AsyncReader -- reads images in the background, for instance
+//	the frames of an image sequence during playback.
+//
+//	Each request names a file, a part in the file and a frame buffer;
+//	the reader reads the whole data window of the part into the frame
+//	buffer.  Requests are completed in the order they were made.
+//
+//	A reader thread loads the files of upcoming requests into memory
+//	ahead of time, up to a limit on the number of frames and bytes
+//	held, while a decoder thread reads the pixels of the oldest loaded
+//	request from memory.  Only the headers, the chunk offset tables
+//	and the chunks of the requested part are loaded.  If memory-mapped
+//	file input is turned on (see setMemoryMappedFileInput()), files
+//	are mapped and paged in instead of being copied.  The decoder uncompresses and converts the
+//	pixels with the global thread pool, like InputPart::readPixels(),
+//	so loading the next frames overlaps with decoding the current one.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+
+#include "ImfFrameBuffer.h"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <stddef.h>
+#include <string>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+class IMF_EXPORT_TYPE AsyncReader
+{
+public:
+    //-------------------------------------------------------------
+    // A request to read part partNumber of file fileName into
+    // frameBuffer.
+    //
+    // If prepare is set, it is called with the header of the part
+    // before any pixels are read, and may change the frame buffer,
+    // for example to allocate memory to fit the data window.
+    //
+    // If done is set, it is called once the request is complete,
+    // with a null exception_ptr if the pixels were read, or the
+    // exception that made the request fail.
+    //
+    // Both functions are called on the reader's decoder thread,
+    // except that done is called by cancel() and by the destructor
+    // for the requests they cancel.
+    //-------------------------------------------------------------
+
+    struct Request
+    {
+        std::string fileName;
+        int         partNumber = 0;
+        FrameBuffer frameBuffer;
+
+        std::function<void (const Header&, FrameBuffer&)> prepare;
+        std::function<void (std::exception_ptr)>          done;
+    };
+
+    //-------------------------------------------------------------
+    // Constructor -- at most maxFramesAhead files are held in
+    // memory, loaded but not yet decoded, and no new file is
+    // loaded while they hold more than maxBytesAhead bytes.
+    //-------------------------------------------------------------
+
+    IMF_EXPORT
+    AsyncReader (int maxFramesAhead = 4, size_t maxBytesAhead = 1 << 30);
+
+    //-------------------------------------------------------------
+    // Destructor -- waits for the file being loaded and the one
+    // being decoded, if any, then cancels the requests that have
+    // not been decoded.
+    //-------------------------------------------------------------
+
+    IMF_EXPORT
+    ~AsyncReader ();
+
+    AsyncReader (const AsyncReader& other) = delete;
+    AsyncReader& operator= (const AsyncReader& other) = delete;
+    AsyncReader (AsyncReader&& other)                 = delete;
+    AsyncReader& operator= (AsyncReader&& other) = delete;
+
+    //-------------------------------------------------------------
+    // Queue a request.  The returned future becomes ready when the
+    // request is complete; get() throws the exception that made
+    // it fail, if any.  The frame buffer's memory must stay valid
+    // until then.
+    //-------------------------------------------------------------
+
+    IMF_EXPORT
+    std::future<void> read (const Request& request);
+
+    IMF_EXPORT
+    std::future<void> read (
+        const std::string& fileName,
+        const FrameBuffer& frameBuffer,
+        int                partNumber = 0);
+
+    //-------------------------------------------------------------
+    // Cancel all requests that have not started decoding: they
+    // fail with an IEX_NAMESPACE::BaseExc.  Useful when playback
+    // jumps to another frame.
+    //-------------------------------------------------------------
+
+    IMF_EXPORT
+    void cancel ();
+
+    //-------------------------------------------------------------
+    // Wait until all queued requests are complete.
+    //-------------------------------------------------------------
+
+    IMF_EXPORT
+    void wait ();
+
+    //-------------------------------------------------------------
+    // Number of requests that are not complete yet
+    //-------------------------------------------------------------
+
+    IMF_EXPORT
+    int pending () const;
+
+private:
+    struct IMF_HIDDEN Data;
+
+    Data* _data;
+};
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
@@ -855,13 +855,38 @@ B44Compressor::uncompress (
 
             if (inSize < n) notEnoughData ();
 
-            memcpy (cd.start, inPtr, n);
+            if (decodesChannel (i)) memcpy (cd.start, inPtr, n);
             inPtr += n;
             inSize -= n;
 
             continue;
         }
 
+        if (!decodesChannel (i))
+        {
+            //
+            // HALF channel that is not needed: skip its blocks
+            // without unpacking them.
+            //
+
+            int numBlocks = ((cd.nx + 3) / 4) * ((cd.ny + 3) / 4);
+
+            for (int b = 0; b < numBlocks; ++b)
+            {
+                if (inSize < 3) notEnoughData ();
+
+                int blockSize =
+                    (((const unsigned char*) inPtr)[2] >= (13 << 2)) ? 3 : 14;
+
+                if (inSize < blockSize) notEnoughData ();
+
+                inPtr += blockSize;
+                inSize -= blockSize;
+            }
+
+            continue;
+        }
+
         //
         // HALF channel
         //
@@ -938,7 +963,13 @@ B44Compressor::uncompress (
 
                 if (modp (y, cd.ys) != 0) continue;
 
-                if (cd.type == HALF)
+                if (!decodesChannel (i))
+                {
+                    int n = cd.nx * cd.size;
+                    outEnd += n * sizeof (unsigned short);
+                    cd.end += n;
+                }
+                else if (cd.type == HALF)
                 {
                     for (int x = cd.nx; x > 0; --x)
                     {
@@ -971,7 +1002,8 @@ B44Compressor::uncompress (
                 if (modp (y, cd.ys) != 0) continue;
 
                 int n = cd.nx * cd.size;
-                memcpy (outEnd, cd.end, n * sizeof (unsigned short));
+                if (decodesChannel (i))
+                    memcpy (outEnd, cd.end, n * sizeof (unsigned short));
                 outEnd += n * sizeof (unsigned short);
                 cd.end += n;
             }
@@ -0,0 +1,247 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//	class ChunkOffsetCache
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfChunkOffsetCache.h"
+
+#include "IlmThreadConfig.h"
+#include "ImfIO.h"
+#include "ImfMMapIO.h"
+#include <atomic>
+#include <list>
+#include <string>
+#include <unordered_map>
+#if ILMTHREAD_THREADING_ENABLED
+#    include <mutex>
+#endif
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+using std::list;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace
+{
+
+template <class T>
+void
+appendBytes (string& s, const T& value)
+{
+    s.append (reinterpret_cast<const char*> (&value), sizeof (value));
+}
+
+//
+// Append the part number to the key of a file to get the key
+// of the part's table.
+//
+
+string
+partKey (const string& key, int part)
+{
+    string k (key);
+    appendBytes (k, part);
+    return k;
+}
+
+struct Entry
+{
+    string           key;
+    vector<uint64_t> offsets;
+    bool             complete;
+};
+
+} // namespace
+
+//
+// The list holds the tables from most to least recently used.
+//
+
+struct ChunkOffsetCache::Data
+{
+#if ILMTHREAD_THREADING_ENABLED
+    mutable std::mutex mutex;
+#endif
+    std::atomic<size_t>                          maxTables;
+    list<Entry>                                  lru;
+    unordered_map<string, list<Entry>::iterator> index;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> insertions;
+    std::atomic<uint64_t> evictions;
+
+    Data (size_t maxTables);
+
+    void trim ();
+};
+
+ChunkOffsetCache::Data::Data (size_t n)
+    : maxTables (n), hits (0), misses (0), insertions (0), evictions (0)
+{}
+
+//
+// Evict least recently used tables until the cache fits in its
+// size.  Called with the cache locked.
+//
+
+void
+ChunkOffsetCache::Data::trim ()
+{
+    while (lru.size () > maxTables)
+    {
+        index.erase (lru.back ().key);
+        lru.pop_back ();
+        ++evictions;
+    }
+}
+
+ChunkOffsetCache::ChunkOffsetCache (size_t maxTables)
+    : _data (new Data (maxTables))
+{}
+
+ChunkOffsetCache::~ChunkOffsetCache ()
+{
+    delete _data;
+}
+
+ChunkOffsetCache&
+ChunkOffsetCache::globalCache ()
+{
+    static ChunkOffsetCache cache (0);
+    return cache;
+}
+
+void
+ChunkOffsetCache::setMaxTables (size_t maxTables)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (_data->mutex);
+#endif
+    _data->maxTables = maxTables;
+    _data->trim ();
+}
+
+size_t
+ChunkOffsetCache::maxTables () const
+{
+    return _data->maxTables;
+}
+
+void
+ChunkOffsetCache::clear ()
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (_data->mutex);
+#endif
+    _data->index.clear ();
+    _data->lru.clear ();
+}
+
+ChunkOffsetCache::Statistics
+ChunkOffsetCache::statistics () const
+{
+    Statistics s;
+    s.hits       = _data->hits;
+    s.misses     = _data->misses;
+    s.insertions = _data->insertions;
+    s.evictions  = _data->evictions;
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (_data->mutex);
+#endif
+    s.tables = _data->index.size ();
+    return s;
+}
+
+void
+ChunkOffsetCache::resetStatistics ()
+{
+    _data->hits       = 0;
+    _data->misses     = 0;
+    _data->insertions = 0;
+    _data->evictions  = 0;
+}
+
+bool
+ChunkOffsetCache::makeKey (
+    OPENEXR_IMF_INTERNAL_NAMESPACE::IStream& is, string& key) const
+{
+    return _data->maxTables > 0 && fileIdentity (is, key);
+}
+
+bool
+ChunkOffsetCache::find (
+    const string&                            key,
+    int                                      part,
+    OPENEXR_IMF_INTERNAL_NAMESPACE::IStream& is,
+    vector<uint64_t>&                        offsets,
+    bool&                                    complete)
+{
+    string k = partKey (key, part);
+
+    {
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (_data->mutex);
+#endif
+        auto i = _data->index.find (k);
+
+        if (i == _data->index.end () ||
+            i->second->offsets.size () != offsets.size ())
+        {
+            ++_data->misses;
+            return false;
+        }
+
+        ++_data->hits;
+        _data->lru.splice (_data->lru.begin (), _data->lru, i->second);
+
+        offsets  = i->second->offsets;
+        complete = i->second->complete;
+    }
+
+    is.seekg (is.tellg () + sizeof (uint64_t) * offsets.size ());
+    return true;
+}
+
+void
+ChunkOffsetCache::insert (
+    const string&           key,
+    int                     part,
+    const vector<uint64_t>& offsets,
+    bool                    complete)
+{
+    string k = partKey (key, part);
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (_data->mutex);
+#endif
+    if (_data->maxTables == 0) return;
+
+    auto i = _data->index.find (k);
+
+    if (i != _data->index.end ())
+    {
+        _data->lru.erase (i->second);
+        _data->index.erase (i);
+    }
+
+    _data->lru.push_front (Entry ());
+    _data->lru.front ().key      = k;
+    _data->lru.front ().offsets  = offsets;
+    _data->lru.front ().complete = complete;
+    _data->index[k]              = _data->lru.begin ();
+    ++_data->insertions;
+
+    _data->trim ();
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,156 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_CHUNK_OFFSET_CACHE_H
+#define INCLUDED_IMF_CHUNK_OFFSET_CACHE_H
+
+//-----------------------------------------------------------------------------
+//
+//	class ChunkOffsetCache -- a least recently used cache of the
+//	chunk offset tables of files, limited to a number of tables.
+//
+//	A process that opens the same files over and over, for example
+//	to verify them, reads each file's chunk offset tables and checks
+//	them for missing entries only once.  For incomplete files, this
+//	also avoids scanning the whole file again to reconstruct the
+//	tables.
+//
+//	Tables are keyed by the name of the file that the input stream
+//	reports, together with the file's size, modification time,
+//	device and inode numbers, so a file that has been rewritten or
+//	is still being written gets a new entry.  For a MMapIFStream
+//	these come from the descriptor the file was mapped through.
+//	Streams whose name is not that of a file on disk are never
+//	cached.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+class IMF_EXPORT_TYPE ChunkOffsetCache
+{
+public:
+    //---------------------------------------------------------------
+    // Constructor -- maxTables is the number of chunk offset tables,
+    // one per part of a file, that the cache will hold.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    ChunkOffsetCache (size_t maxTables);
+
+    IMF_EXPORT
+    ~ChunkOffsetCache ();
+
+    ChunkOffsetCache (const ChunkOffsetCache& other) = delete;
+    ChunkOffsetCache& operator= (const ChunkOffsetCache& other) = delete;
+    ChunkOffsetCache (ChunkOffsetCache&& other)                 = delete;
+    ChunkOffsetCache& operator= (ChunkOffsetCache&& other) = delete;
+
+    //---------------------------------------------------------------
+    // The process-wide cache, which the file classes use.  Its size
+    // is initially zero, which means it holds nothing until
+    // setMaxTables() is called.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    static ChunkOffsetCache& globalCache ();
+
+    //---------------------------------------------------------------
+    // Change the size of the cache.  If the cache holds more than
+    // maxTables tables, the least recently used ones are evicted.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void setMaxTables (size_t maxTables);
+
+    IMF_EXPORT
+    size_t maxTables () const;
+
+    //---------------------------------------------------------------
+    // Remove all tables from the cache.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void clear ();
+
+    //---------------------------------------------------------------
+    // Counters for lookups and evictions since the cache was created
+    // or resetStatistics() was called, and the current contents.
+    //---------------------------------------------------------------
+
+    struct Statistics
+    {
+        uint64_t hits;       // lookups that found a table
+        uint64_t misses;     // lookups that did not
+        uint64_t insertions; // tables added to the cache
+        uint64_t evictions;  // tables removed to stay within the size
+        size_t   tables;     // number of tables held now
+    };
+
+    IMF_EXPORT
+    Statistics statistics () const;
+
+    IMF_EXPORT
+    void resetStatistics ();
+
+    //---------------------------------------------------------------
+    // Cache entries, as used by the file classes:
+    //
+    // makeKey() computes the key under which the tables of the file
+    // that is read through stream is are stored.  The file classes
+    // call it once, before they read the tables, and pass the key to
+    // find() and insert(), so that a file that changes while its
+    // tables are being read is not cached under its new identity.
+    // makeKey() returns false if the cache is empty or if the
+    // stream's name is not that of a file on disk; the file classes
+    // then skip the cache.
+    //
+    // find() looks up the chunk offset table of part number part
+    // of the file with the given key.  If the cache holds a table
+    // with offsets.size() entries, find() copies it into offsets,
+    // sets complete to false if the table had to be reconstructed,
+    // moves the read position of stream is past the table in the
+    // file, and returns true.  Otherwise find() returns false and
+    // leaves its arguments alone.
+    //
+    // insert() adds the chunk offset table of a part, after it has
+    // been read and, if necessary, reconstructed, to the cache.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    bool makeKey (
+        OPENEXR_IMF_INTERNAL_NAMESPACE::IStream& is, std::string& key) const;
+
+    IMF_EXPORT
+    bool find (
+        const std::string&                       key,
+        int                                      part,
+        OPENEXR_IMF_INTERNAL_NAMESPACE::IStream& is,
+        std::vector<uint64_t>&                   offsets,
+        bool&                                    complete);
+
+    IMF_EXPORT
+    void insert (
+        const std::string&           key,
+        int                          part,
+        const std::vector<uint64_t>& offsets,
+        bool                         complete);
+
+private:
+    struct IMF_HIDDEN Data;
+
+    Data* _data;
+};
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
@@ -14,6 +14,7 @@
 #include "ImfPixelType.h"
 
 #include <Iex.h>
+#include <algorithm>
 #include <stddef.h>
 #include <vector>
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
@@ -297,132 +298,104 @@ CompositeDeepScanLine::setFrameBuffer (const FrameBuffer& fr)
 namespace
 {
 
-class LineCompositeTask : public Task
+//
+// composites the rows y0 to y1 (inclusive) of the samples read by
+// readPixels: inputs point to the first sample of the block in each
+// channel, and sample_counts to the per-source counts of its first pixel
+//
+
+class BlockCompositeTask : public Task
 {
 public:
-    LineCompositeTask (
-        TaskGroup*                      group,
-        CompositeDeepScanLine::Data*    data,
-        int                             y,
-        int                             start,
-        vector<const char*>*            names,
-        vector<vector<vector<float*>>>* pointers,
-        vector<unsigned int>*           total_sizes,
-        vector<unsigned int>*           num_sources)
+    BlockCompositeTask (
+        TaskGroup*                   group,
+        CompositeDeepScanLine::Data* data,
+        int                          y0,
+        int                          y1,
+        int                          sources,
+        vector<const char*>*         names,
+        vector<const float*>         inputs,
+        const unsigned int*          sample_counts)
         : Task (group)
         , _Data (data)
-        , _y (y)
-        , _start (start)
+        , _y0 (y0)
+        , _y1 (y1)
+        , _sources (sources)
         , _names (names)
-        , _pointers (pointers)
-        , _total_sizes (total_sizes)
-        , _num_sources (num_sources)
+        , _inputs (inputs)
+        , _sample_counts (sample_counts)
     {}
 
-    virtual ~LineCompositeTask () {}
+    virtual ~BlockCompositeTask () {}
 
-    virtual void                    execute ();
-    CompositeDeepScanLine::Data*    _Data;
-    int                             _y;
-    int                             _start;
-    vector<const char*>*            _names;
-    vector<vector<vector<float*>>>* _pointers;
-    vector<unsigned int>*           _total_sizes;
-    vector<unsigned int>*           _num_sources;
+    virtual void                 execute ();
+    CompositeDeepScanLine::Data* _Data;
+    int                          _y0;
+    int                          _y1;
+    int                          _sources;
+    vector<const char*>*         _names;
+    vector<const float*>         _inputs;
+    const unsigned int*          _sample_counts;
 };
 
 void
-composite_line (
-    int                                   y,
-    int                                   start,
-    CompositeDeepScanLine::Data*          _Data,
-    vector<const char*>&                  names,
-    const vector<vector<vector<float*>>>& pointers,
-    const vector<unsigned int>&           total_sizes,
-    const vector<unsigned int>&           num_sources)
+BlockCompositeTask::execute ()
 {
-    vector<float> output_pixel (names.size ()); //the pixel we'll output to
-    vector<const float*> inputs (names.size ());
-    DeepCompositing      d; // fallback compositing engine
-    DeepCompositing*     comp = _Data->_comp ? _Data->_comp : &d;
+    int    minx   = _Data->_dataWindow.min.x;
+    int    width  = _Data->_dataWindow.max.x + 1 - minx;
+    int    pixels = width * (_y1 - _y0 + 1);
+    size_t nchan  = _names->size ();
+
+    DeepCompositing  d; // fallback compositing engine
+    DeepCompositing* comp = _Data->_comp ? _Data->_comp : &d;
+
+    // composited values, one row of pixels per channel
+    vector<float>  output (nchan * pixels);
+    vector<float*> outputs (nchan);
+    for (size_t c = 0; c < nchan; c++)
+        outputs[c] = &output[c * pixels];
+
+    comp->composite_pixels (
+        &outputs[0],
+        &_inputs[0],
+        &(*_names)[0],
+        static_cast<int> (nchan),
+        pixels,
+        _sources,
+        _sample_counts);
 
-    int pixel =
-        (y - start) * (_Data->_dataWindow.max.x + 1 - _Data->_dataWindow.min.x);
+    //
+    // write out composited values into the frame buffer, converting
+    // to half if necessary
+    //
 
-    for (int x = _Data->_dataWindow.min.x; x <= _Data->_dataWindow.max.x; x++)
+    size_t channel_number = 0;
+    for (FrameBuffer::Iterator it = _Data->_outputFrameBuffer.begin ();
+         it != _Data->_outputFrameBuffer.end ();
+         it++, channel_number++)
     {
-        // set inputs[] to point to the first sample of the first part of each channel
-        // if there's a zback, set all channel independently...
-
-        if (_Data->_zback)
-        {
-
-            for (size_t channel = 0; channel < names.size (); channel++)
-            {
-                inputs[channel] = pointers[0][channel][pixel];
-            }
-        }
-        else
-        {
-
-            // otherwise, set 0 and 1 to point to Z
-
-            inputs[0] = pointers[0][0][pixel];
-            inputs[1] = pointers[0][0][pixel];
-            for (size_t channel = 2; channel < names.size (); channel++)
-            {
-                inputs[channel] = pointers[0][channel][pixel];
-            }
-        }
-        comp->composite_pixel (
-            &output_pixel[0],
-            &inputs[0],
-            &names[0],
-            static_cast<int> (names.size ()),
-            total_sizes[pixel],
-            num_sources[pixel]);
-
-        size_t channel_number = 0;
+        const Slice&  slice = it.slice ();
+        const float*  src   = outputs[_Data->_bufferMap[channel_number]];
+        intptr_t      base  = reinterpret_cast<intptr_t> (slice.base);
 
-        //
-        // write out composited value into internal frame buffer
-        //
-        for (FrameBuffer::Iterator it = _Data->_outputFrameBuffer.begin ();
-             it != _Data->_outputFrameBuffer.end ();
-             it++)
+        for (int y = _y0; y <= _y1; y++, src += width)
         {
+            intptr_t row = base + y * slice.yStride + minx * slice.xStride;
 
-            float value = output_pixel
-                [_Data->_bufferMap[channel_number]]; // value to write
-            intptr_t base = reinterpret_cast<intptr_t> (it.slice ().base);
-
-            // cast to half float if necessary
-            if (it.slice ().type == OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT)
+            if (slice.type == OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT)
             {
-                float* ptr = reinterpret_cast<float*> (
-                    base + y * it.slice ().yStride + x * it.slice ().xStride);
-                *ptr = value;
+                for (int x = 0; x < width; x++)
+                    *reinterpret_cast<float*> (row + x * slice.xStride) =
+                        src[x];
             }
-            else if (it.slice ().type == HALF)
+            else if (slice.type == HALF)
             {
-                half* ptr = reinterpret_cast<half*> (
-                    base + y * it.slice ().yStride + x * it.slice ().xStride);
-                *ptr = half (value);
+                for (int x = 0; x < width; x++)
+                    *reinterpret_cast<half*> (row + x * slice.xStride) =
+                        half (src[x]);
             }
-
-            channel_number++;
         }
-
-        pixel++;
-
-    } // next pixel on row
-}
-
-void
-LineCompositeTask::execute ()
-{
-    composite_line (
-        _y, _start, _Data, *_names, *_pointers, *_total_sizes, *_num_sources);
+    }
 }
 
 } // namespace
@@ -486,9 +459,10 @@ CompositeDeepScanLine::readPixels (int start, int end)
 
     size_t               total_width  = _Data->_dataWindow.size ().x + 1;
     size_t               total_pixels = total_width * (end - start + 1);
-    vector<unsigned int> total_sizes (total_pixels);
-    vector<unsigned int> num_sources (
-        total_pixels); //number of parts with non-zero sample count
+    vector<unsigned int> sample_counts (
+        total_pixels * parts); // per-part counts, for each pixel in turn
+    vector<size_t> row_offsets (
+        end - start + 2); // index of the first sample of each row
 
     size_t overall_sample_count =
         0; // sum of all samples in all images between start and end
@@ -498,15 +472,15 @@ CompositeDeepScanLine::readPixels (int start, int end)
     //
     for (size_t ptr = 0; ptr < total_pixels; ptr++)
     {
-        total_sizes[ptr] = 0;
-        num_sources[ptr] = 0;
+        if (ptr % total_width == 0)
+            row_offsets[ptr / total_width] = overall_sample_count;
         for (size_t j = 0; j < parts; j++)
         {
-            total_sizes[ptr] += counts[j][ptr];
-            if (counts[j][ptr] > 0) num_sources[ptr]++;
+            sample_counts[ptr * parts + j] = counts[j][ptr];
+            overall_sample_count += counts[j][ptr];
         }
-        overall_sample_count += total_sizes[ptr];
     }
+    row_offsets[end - start + 1] = overall_sample_count;
 
     //
     // allocate arrays for pixel data
@@ -578,19 +552,42 @@ CompositeDeepScanLine::readPixels (int start, int end)
     if (!_Data->_zback)
         names[1] = names[0]; // no zback channel, so make it point to z
 
+    //
+    // composite blocks of rows in parallel: roughly 16k pixels at a
+    // time, but at least a few blocks per thread when there are enough
+    // rows
+    //
+
+    int rows           = end - start + 1;
+    int rows_per_block = std::max (1, int (16384 / total_width));
+    int threads        = ThreadPool::globalThreadPool ().numThreads ();
+    if (threads > 0)
+        rows_per_block =
+            std::max (1, std::min (rows_per_block, rows / (4 * threads)));
+
     TaskGroup g;
-    for (int y = start; y <= end; y++)
+    for (int y = start; y <= end; y += rows_per_block)
     {
-        ThreadPool::addGlobalTask (new LineCompositeTask (
+        int                  y1 = std::min (end, y + rows_per_block - 1);
+        vector<const float*> inputs (names.size ());
+
+        for (size_t channel = 0; channel < names.size (); channel++)
+        {
+            const vector<float>& data =
+                samples[channel == 1 && !_Data->_zback ? 0 : channel];
+            inputs[channel] = data.data () + row_offsets[y - start];
+        }
+
+        ThreadPool::addGlobalTask (new BlockCompositeTask (
             &g,
             _Data,
             y,
-            start,
+            y1,
+            static_cast<int> (parts),
             &names,
-            &pointers,
-            &total_sizes,
-            &num_sources));
-    } //next row
+            inputs,
+            sample_counts.data () + (y - start) * total_width * parts));
+    } //next block
 }
 
 const FrameBuffer&
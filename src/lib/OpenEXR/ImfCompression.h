@@ -55,6 +55,25 @@ IMF_EXPORT void setDefaultZipCompressionLevel (int level);
 /// Controls the default quality level for the DWA lossy compression
 IMF_EXPORT void setDefaultDwaCompressionLevel (float level);
 
+/// Library used for the deflate step of the zip based compression
+/// methods (ZIP, ZIPS, PXR24 and parts of DWAA / DWAB). Both write
+/// standard zlib streams, so either can read files written by the
+/// other, although the compressed bytes differ.
+enum IMF_EXPORT_ENUM DeflateBackend
+{
+    ZLIB_DEFLATE_BACKEND = 0,
+
+    LIBDEFLATE_DEFLATE_BACKEND = 1 // only if built with OPENEXR_USE_LIBDEFLATE
+};
+
+/// Controls the library used to deflate and inflate zip data. When
+/// the library is built with libdeflate it is the default, otherwise
+/// requests for it are ignored and zlib is used.
+IMF_EXPORT void setDefaultDeflateBackend (DeflateBackend backend);
+
+/// Returns the library used to deflate and inflate zip data
+IMF_EXPORT DeflateBackend defaultDeflateBackend ();
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
 
 #endif
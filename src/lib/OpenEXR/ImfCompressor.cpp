@@ -49,6 +49,12 @@ Compressor::uncompressTile (
     return uncompress (inPtr, inSize, range.min.y, outPtr);
 }
 
+void
+Compressor::setDecodedChannels (const std::vector<bool>& decoded)
+{
+    _decodedChannels = decoded;
+}
+
 bool
 isValidCompression (Compression c)
 {
@@ -19,6 +19,7 @@
 #include <ImathBox.h>
 
 #include <stdlib.h>
+#include <vector>
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
@@ -159,8 +160,32 @@ public:
         IMATH_NAMESPACE::Box2i range,
         const char*&           outPtr);
 
+    //-------------------------------------------------------------------------
+    // Restrict uncompress() and uncompressTile() to some of the channels:
+    // decoded[i] tells whether the i-th channel in header().channels() is
+    // needed.  Compressors that can skip the work for the other channels
+    // do so, and leave the bytes of those channels in the output buffer
+    // undefined; the others uncompress all channels.  An empty vector,
+    // the default, selects all channels.
+    //-------------------------------------------------------------------------
+
+    IMF_EXPORT
+    void setDecodedChannels (const std::vector<bool>& decoded);
+
+    const std::vector<bool>& decodedChannels () const
+    {
+        return _decodedChannels;
+    }
+
+protected:
+    bool decodesChannel (size_t i) const
+    {
+        return i >= _decodedChannels.size () || _decodedChannels[i];
+    }
+
 private:
-    const Header& _header;
+    const Header&     _header;
+    std::vector<bool> _decodedChannels;
 };
 
 //--------------------------------------
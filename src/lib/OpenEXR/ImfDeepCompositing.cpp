@@ -6,7 +6,12 @@
 #include "ImfDeepCompositing.h"
 
 #include "ImfNamespace.h"
+#include "ImfSimd.h"
 #include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+#include <typeinfo>
 #include <vector>
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
@@ -87,4 +92,380 @@ DeepCompositing::sort (
     std::sort (order + 0, order + num_samples, sort_helper (inputs));
 }
 
+namespace
+{
+
+//
+// The block compositor below gives exactly the same results as
+// composite_pixel(): samples are taken in the order sort() gives
+// (by Z, then ZBack, then position), and accumulated with the same
+// arithmetic, one channel at a time.
+//
+
+inline bool
+sampleLess (const float* z, const float* zback, int a, int b)
+{
+    if (z[a] < z[b]) return true;
+    if (z[a] > z[b]) return false;
+    if (zback[a] < zback[b]) return true;
+    if (zback[a] > zback[b]) return false;
+    return a < b;
+}
+
+// key that orders floats (other than NaN) as unsigned integers
+inline uint32_t
+floatKey (float f)
+{
+    uint32_t u;
+    if (f == 0.0f) f = 0.0f; // -0 sorts with +0
+    memcpy (&u, &f, sizeof (u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+//
+// Scratch space for one block, sized for its largest pixel
+//
+
+struct BlockScratch
+{
+    std::vector<int>      order;   // sample order, as far as it is needed
+    std::vector<float>    weight;  // 1 - alpha in front of each sample
+    std::vector<int>      heads;   // merge heap: next sample of each source
+    std::vector<int>      ends;    // end of each source, by heap position
+    std::vector<uint64_t> keys;    // radix sort keys and their swap space
+    std::vector<uint64_t> keys2;
+    std::vector<int>      order2;
+};
+
+//
+// LSD radix sort of the samples by (Z, ZBack). Being stable, samples with
+// equal depths stay in position order. Bytes that are the same for all
+// samples (the upper half when there is no ZBack) are skipped.
+//
+
+void
+radixSortSamples (
+    const float* z, const float* zback, int n, BlockScratch& scratch)
+{
+    uint64_t* keys  = scratch.keys.data ();
+    uint64_t* keys2 = scratch.keys2.data ();
+    int*      ord   = scratch.order.data ();
+    int*      ord2  = scratch.order2.data ();
+    size_t    hist[8][256];
+
+    memset (hist, 0, sizeof (hist));
+    for (int i = 0; i < n; ++i)
+    {
+        uint64_t k = (z == zback)
+                         ? uint64_t (floatKey (z[i]))
+                         : (uint64_t (floatKey (z[i])) << 32) |
+                               floatKey (zback[i]);
+        keys[i] = k;
+        ord[i]  = i;
+        for (int b = 0; b < 8; ++b)
+            ++hist[b][(k >> (8 * b)) & 0xff];
+    }
+
+    for (int b = 0; b < 8; ++b)
+    {
+        size_t* h = hist[b];
+        size_t  sum = 0;
+
+        if (h[(keys[0] >> (8 * b)) & 0xff] == size_t (n)) continue;
+
+        for (int v = 0; v < 256; ++v)
+        {
+            size_t c = h[v];
+            h[v]     = sum;
+            sum += c;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            size_t d = h[(keys[i] >> (8 * b)) & 0xff]++;
+            keys2[d] = keys[i];
+            ord2[d]  = ord[i];
+        }
+        std::swap (keys, keys2);
+        std::swap (ord, ord2);
+    }
+
+    if (ord != scratch.order.data ())
+        memcpy (scratch.order.data (), ord, sizeof (int) * size_t (n));
+}
+
+//
+// accumulate the first n samples of the order, each channel scaled by
+// the weight of the sample
+//
+
+void
+accumulate (
+    float*             out,
+    const float* const in[],
+    int                num_channels,
+    const int*         order,
+    const float*       weight,
+    int                n)
+{
+    int c = 0;
+#ifdef IMF_HAVE_SSE2
+    for (; c + 4 <= num_channels; c += 4)
+    {
+        const float* c0  = in[c];
+        const float* c1  = in[c + 1];
+        const float* c2  = in[c + 2];
+        const float* c3  = in[c + 3];
+        __m128       acc = _mm_setzero_ps ();
+        for (int i = 0; i < n; ++i)
+        {
+            int s = order[i];
+            acc   = _mm_add_ps (
+                acc,
+                _mm_mul_ps (
+                    _mm_set1_ps (weight[i]),
+                    _mm_setr_ps (c0[s], c1[s], c2[s], c3[s])));
+        }
+        _mm_storeu_ps (out + c, acc);
+    }
+#endif
+    for (; c < num_channels; ++c)
+    {
+        const float* ch  = in[c];
+        float        acc = 0.0f;
+        for (int i = 0; i < n; ++i)
+            acc += weight[i] * ch[order[i]];
+        out[c] = acc;
+    }
+}
+
+//
+// composite one pixel: n samples (starting at in[c][0]) from the given
+// sources, src_counts giving the sample count of each
+//
+
+void
+compositePixel (
+    float*              out,
+    const float* const  in[],
+    int                 num_channels,
+    int                 n,
+    int                 sources,
+    const unsigned int* src_counts,
+    BlockScratch&       scratch)
+{
+    const float* z      = in[0];
+    const float* zback  = in[1];
+    const float* alpha  = in[2];
+    int*         order  = scratch.order.data ();
+    float*       weight = scratch.weight.data ();
+    int          used   = 0;
+    int          active = 0;
+    bool         sorted = true;
+    bool         nan    = false;
+    float        a      = 0.0f;
+
+    for (int c = 0; c < num_channels; ++c)
+        out[c] = 0.0f;
+    if (n == 0) return;
+
+    //
+    // find the sources that have samples here, and whether each is
+    // already in depth order. Depths that are NaN have no consistent
+    // order, those pixels are sorted just as sort() does, to give
+    // the same result
+    //
+
+    for (int i = 0; i < n && !nan; ++i)
+        nan = std::isnan (z[i]) || std::isnan (zback[i]);
+
+    {
+        int first = 0;
+        for (int s = 0; s < sources; ++s)
+        {
+            int cnt = int (src_counts[s]);
+            if (cnt == 0) continue;
+            for (int i = first + 1; sorted && i < first + cnt; ++i)
+                sorted = !sampleLess (z, zback, i, i - 1);
+            scratch.heads[active] = first;
+            scratch.ends[active]  = first + cnt;
+            ++active;
+            first += cnt;
+        }
+    }
+
+    //
+    // weight[i] = 1 - alpha in front of the sample; stops (as
+    // composite_pixel() does) once alpha is at least 1
+    //
+
+    if (active <= 1)
+    {
+        // a single source is composited in the order it is stored
+        for (; used < n && !(a >= 1.0f); ++used)
+        {
+            order[used]  = used;
+            weight[used] = 1.0f - a;
+            a += weight[used] * alpha[used];
+        }
+    }
+    else if (sorted && !nan)
+    {
+        //
+        // merge the sources, using a heap of the next sample of each
+        // one, until the samples in front are opaque
+        //
+
+        int* heads = scratch.heads.data ();
+        int* ends  = scratch.ends.data ();
+        int  nh    = active;
+
+        auto siftDown = [&] (int i) {
+            int h = heads[i];
+            int e = ends[i];
+            for (;;)
+            {
+                int child = 2 * i + 1;
+                if (child >= nh) break;
+                if (child + 1 < nh &&
+                    sampleLess (z, zback, heads[child + 1], heads[child]))
+                    ++child;
+                if (!sampleLess (z, zback, heads[child], h)) break;
+                heads[i] = heads[child];
+                ends[i]  = ends[child];
+                i        = child;
+            }
+            heads[i] = h;
+            ends[i]  = e;
+        };
+
+        for (int i = nh / 2; i > 0; --i)
+            siftDown (i - 1);
+
+        while (nh > 0 && !(a >= 1.0f))
+        {
+            int s = heads[0]++;
+            if (heads[0] == ends[0])
+            {
+                --nh;
+                heads[0] = heads[nh];
+                ends[0]  = ends[nh];
+            }
+            if (nh > 1) siftDown (0);
+
+            order[used]  = s;
+            weight[used] = 1.0f - a;
+            a += weight[used] * alpha[s];
+            ++used;
+        }
+    }
+    else
+    {
+        if (n >= 64 && !nan)
+            radixSortSamples (z, zback, n, scratch);
+        else
+        {
+            for (int i = 0; i < n; ++i)
+                order[i] = i;
+            std::sort (order, order + n, [z, zback] (int l, int r) {
+                return sampleLess (z, zback, l, r);
+            });
+        }
+
+        for (; used < n && !(a >= 1.0f); ++used)
+        {
+            weight[used] = 1.0f - a;
+            a += weight[used] * alpha[order[used]];
+        }
+    }
+
+    accumulate (out, in, num_channels, order, weight, used);
+}
+
+} // namespace
+
+void
+DeepCompositing::composite_pixels (
+    float*             outputs[],
+    const float*       inputs[],
+    const char*        channel_names[],
+    int                num_channels,
+    int                num_pixels,
+    int                sources,
+    const unsigned int sample_counts[])
+{
+    vector<const float*> in (num_channels);
+    vector<float>        out (num_channels);
+    size_t               offset = 0;
+
+    if (typeid (*this) != typeid (DeepCompositing))
+    {
+        //
+        // per pixel calls to the (possibly overridden) virtual functions
+        //
+
+        for (int p = 0; p < num_pixels; ++p)
+        {
+            const unsigned int* counts = sample_counts + size_t (p) * sources;
+            int                 total = 0, active = 0;
+
+            for (int s = 0; s < sources; ++s)
+            {
+                total += counts[s];
+                if (counts[s] > 0) ++active;
+            }
+            for (int c = 0; c < num_channels; ++c)
+                in[c] = inputs[c] + offset;
+
+            composite_pixel (
+                &out[0], &in[0], channel_names, num_channels, total, active);
+
+            for (int c = 0; c < num_channels; ++c)
+                outputs[c][p] = out[c];
+            offset += total;
+        }
+        return;
+    }
+
+    BlockScratch scratch;
+    int          maxSamples = 0;
+    {
+        const unsigned int* counts = sample_counts;
+        for (int p = 0; p < num_pixels; ++p)
+        {
+            int total = 0;
+            for (int s = 0; s < sources; ++s)
+                total += *counts++;
+            maxSamples = std::max (maxSamples, total);
+        }
+    }
+    scratch.order.resize (maxSamples);
+    scratch.weight.resize (maxSamples);
+    scratch.heads.resize (sources);
+    scratch.ends.resize (sources);
+    if (maxSamples >= 64)
+    {
+        scratch.keys.resize (maxSamples);
+        scratch.keys2.resize (maxSamples);
+        scratch.order2.resize (maxSamples);
+    }
+
+    for (int p = 0; p < num_pixels; ++p)
+    {
+        const unsigned int* counts = sample_counts + size_t (p) * sources;
+        int                 total  = 0;
+
+        for (int s = 0; s < sources; ++s)
+            total += counts[s];
+        for (int c = 0; c < num_channels; ++c)
+            in[c] = inputs[c] + offset;
+
+        compositePixel (
+            &out[0], &in[0], num_channels, total, sources, counts, scratch);
+
+        for (int c = 0; c < num_channels; ++c)
+            outputs[c][p] = out[c];
+        offset += total;
+    }
+}
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
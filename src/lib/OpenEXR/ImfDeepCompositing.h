@@ -13,6 +13,10 @@
 //      and CompositeDeepTile combine samples together - pass an instance of your derived
 //      class to the compositing engine
 //
+//      The engine composites blocks of pixels through composite_pixels(),
+//      which calls derived classes once per pixel through composite_pixel()
+//      and sort()
+//
 //-----------------------------------------------------------------------------
 
 #include "ImfForward.h"
@@ -96,6 +100,43 @@ public:
         int          num_channels,
         int          num_samples,
         int          sources);
+
+    //////////////////////////////////////////////
+    ///
+    /// composite together a block of pixels
+    ///
+    ///  @param outputs       - one array of num_pixels values per channel
+    ///  @param inputs        - one array per channel, holding the samples of all pixels in the block
+    ///  @param channel_names - array of channel names for corresponding channels
+    ///  @param num_channels  - number of active channels (3 or greater)
+    ///  @param num_pixels    - number of pixels in the block
+    ///  @param sources       - number of different sources
+    ///  @param sample_counts - num_pixels*sources entries: sample_counts[p*sources+s] is
+    ///                         the number of samples source s has in pixel p
+    ///
+    /// the samples of a pixel follow those of the previous pixel in the input arrays,
+    /// and within a pixel the samples of each source follow those of the previous source.
+    /// outputs[n][p] should be the composited value of channel n for pixel p.
+    /// The channel layout is identical to composite_pixel()
+    ///
+    /// The result is the same as calling composite_pixel() for each pixel, with
+    /// the sources that have samples in it. For an instance of this class the block
+    /// is composited directly: sources that are already in depth order are merged
+    /// rather than sorted, and samples are only put in order until alpha reaches 1.
+    /// For derived classes, composite_pixel() is called once per pixel.
+    ///
+    /// note - multiple threads may call composite_pixels simultaneously for different blocks
+    ///
+    //////////////////////////////////////////////
+    IMF_EXPORT
+    void composite_pixels (
+        float*             outputs[],
+        const float*       inputs[],
+        const char*        channel_names[],
+        int                num_channels,
+        int                num_pixels,
+        int                sources,
+        const unsigned int sample_counts[]);
 };
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
@@ -0,0 +1,187 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//      class DeepSampleArena
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfDeepSampleArena.h"
+#include "ImfMisc.h"
+#include "Iex.h"
+
+#include "ImfNamespace.h"
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+using IMATH_NAMESPACE::Box2i;
+using std::string;
+
+DeepSampleArena::DeepSampleArena ()
+{
+    // empty
+}
+
+DeepSampleArena::~DeepSampleArena ()
+{
+    // empty
+}
+
+DeepSampleArena::DeepSampleArena (DeepSampleArena&& other) = default;
+
+DeepSampleArena&
+DeepSampleArena::operator= (DeepSampleArena&& other) = default;
+
+void
+DeepSampleArena::allocate (Channel& channel)
+{
+    uint64_t size = totalSamples () * pixelTypeSize (channel.type);
+
+    if (size > 0)
+        channel.samples.reset (new char[size]);
+    else
+        channel.samples.reset ();
+}
+
+void
+DeepSampleArena::insert (const string& name, PixelType type)
+{
+    if (name.empty ())
+    {
+        THROW (
+            IEX_NAMESPACE::ArgExc,
+            "Deep sample arena channel name cannot be an empty string.");
+    }
+
+    int c = findChannel (name);
+
+    if (c < 0)
+    {
+        _channels.push_back (Channel ());
+        c = int (_channels.size ()) - 1;
+    }
+
+    _channels[c].name = name;
+    _channels[c].type = type;
+    allocate (_channels[c]);
+}
+
+void
+DeepSampleArena::erase (const string& name)
+{
+    int c = findChannel (name);
+    if (c >= 0) _channels.erase (_channels.begin () + c);
+}
+
+int
+DeepSampleArena::numChannels () const
+{
+    return int (_channels.size ());
+}
+
+const string&
+DeepSampleArena::channelName (int c) const
+{
+    return _channels.at (c).name;
+}
+
+PixelType
+DeepSampleArena::channelType (int c) const
+{
+    return _channels.at (c).type;
+}
+
+int
+DeepSampleArena::findChannel (const string& name) const
+{
+    for (size_t c = 0; c < _channels.size (); ++c)
+        if (_channels[c].name == name) return int (c);
+
+    return -1;
+}
+
+void
+DeepSampleArena::resize (const Box2i& window, const unsigned int sampleCounts[])
+{
+    _window = window;
+    _offsets.clear ();
+
+    if (!window.isEmpty ())
+    {
+        size_t numPixels = size_t (window.max.x - window.min.x + 1) *
+                           size_t (window.max.y - window.min.y + 1);
+
+        _offsets.resize (numPixels + 1);
+        _offsets[0] = 0;
+
+        for (size_t i = 0; i < numPixels; ++i)
+            _offsets[i + 1] = _offsets[i] + sampleCounts[i];
+    }
+
+    for (size_t c = 0; c < _channels.size (); ++c)
+        allocate (_channels[c]);
+}
+
+void
+DeepSampleArena::clear ()
+{
+    _window = Box2i ();
+    _offsets.clear ();
+
+    for (size_t c = 0; c < _channels.size (); ++c)
+        _channels[c].samples.reset ();
+}
+
+const Box2i&
+DeepSampleArena::window () const
+{
+    return _window;
+}
+
+uint64_t
+DeepSampleArena::totalSamples () const
+{
+    return _offsets.empty () ? 0 : _offsets.back ();
+}
+
+const uint64_t*
+DeepSampleArena::sampleOffsets () const
+{
+    return _offsets.data ();
+}
+
+uint64_t
+DeepSampleArena::sampleOffset (int x, int y) const
+{
+    return _offsets
+        [size_t (y - _window.min.y) *
+             size_t (_window.max.x - _window.min.x + 1) +
+         size_t (x - _window.min.x)];
+}
+
+unsigned int
+DeepSampleArena::sampleCount (int x, int y) const
+{
+    size_t i = size_t (y - _window.min.y) *
+                   size_t (_window.max.x - _window.min.x + 1) +
+               size_t (x - _window.min.x);
+
+    return static_cast<unsigned int> (_offsets[i + 1] - _offsets[i]);
+}
+
+char*
+DeepSampleArena::samples (int c)
+{
+    return _channels.at (c).samples.get ();
+}
+
+const char*
+DeepSampleArena::samples (int c) const
+{
+    return _channels.at (c).samples.get ();
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,185 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_DEEP_SAMPLE_ARENA_H
+#define INCLUDED_IMF_DEEP_SAMPLE_ARENA_H
+
+//-----------------------------------------------------------------------------
+//
+//      class DeepSampleArena
+//
+//      Contiguous storage for the samples of a rectangle of deep
+//      pixels.  Instead of one allocation per pixel and channel,
+//      the samples of each channel are stored in a single flat
+//      array, pixel after pixel in scan line order, and a table of
+//      offsets locates the samples of each pixel:
+//
+//          the samples of pixel (x, y) are the elements
+//          [offset (x, y), offset (x, y) + sampleCount (x, y))
+//          of the array of each channel, where
+//
+//          i = (y - window.min.y) * width + (x - window.min.x)
+//          offset (x, y) = sampleOffsets()[i]
+//          sampleCount (x, y) = sampleOffsets()[i + 1] -
+//                               sampleOffsets()[i]
+//
+//      DeepScanLineInputFile::readPixels (arena, s1, s2) allocates
+//      and fills an arena in one call.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+
+#include "ImfPixelType.h"
+
+#include <ImathBox.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+class IMF_EXPORT_TYPE DeepSampleArena
+{
+public:
+    //------------------------------------------------------------
+    // Constructor, destructor, move.  An arena owns its samples,
+    // and cannot be copied.
+    //------------------------------------------------------------
+
+    IMF_EXPORT
+    DeepSampleArena ();
+    IMF_EXPORT
+    ~DeepSampleArena ();
+
+    IMF_EXPORT
+    DeepSampleArena (DeepSampleArena&& other);
+    IMF_EXPORT
+    DeepSampleArena& operator= (DeepSampleArena&& other);
+
+    DeepSampleArena (const DeepSampleArena& other) = delete;
+    DeepSampleArena& operator= (const DeepSampleArena& other) = delete;
+
+    //------------------------------------------------------------
+    // Channels
+    //
+    // insert(n,t)      Adds a channel with name n and type t, or
+    //                  changes the type of channel n if it exists.
+    //                  The samples of the channel are allocated
+    //                  but not initialized.
+    //
+    // erase(n)         Removes the channel with name n, if it exists.
+    //                  The indices of the channels inserted after it
+    //                  decrease by one.
+    //
+    // findChannel(n)   Returns the index of the channel with name
+    //                  n, or -1 if there is no such channel.
+    //
+    // Channels are numbered in the order in which they were
+    // inserted.
+    //------------------------------------------------------------
+
+    IMF_EXPORT
+    void insert (const std::string& name, PixelType type);
+
+    IMF_EXPORT
+    void erase (const std::string& name);
+
+    IMF_EXPORT
+    int numChannels () const;
+    IMF_EXPORT
+    const std::string& channelName (int c) const;
+    IMF_EXPORT
+    PixelType channelType (int c) const;
+    IMF_EXPORT
+    int findChannel (const std::string& name) const;
+
+    //------------------------------------------------------------
+    // Layout
+    //
+    // resize(w,c)      Sets the window of the arena to w, and the
+    //                  number of samples of each pixel to the
+    //                  elements of c, which holds one count per
+    //                  pixel in w, in scan line order.  The samples
+    //                  of all channels are reallocated, and their
+    //                  values are undefined.
+    //
+    // clear()          Sets the window to an empty box, and frees
+    //                  all samples.  The channels are kept.
+    //------------------------------------------------------------
+
+    IMF_EXPORT
+    void resize (
+        const IMATH_NAMESPACE::Box2i& window,
+        const unsigned int            sampleCounts[]);
+
+    IMF_EXPORT
+    void clear ();
+
+    IMF_EXPORT
+    const IMATH_NAMESPACE::Box2i& window () const;
+
+    IMF_EXPORT
+    uint64_t totalSamples () const;
+
+    //
+    // One entry per pixel in the window, plus one for the end of
+    // the last pixel.  Empty if the window is empty.
+    //
+
+    IMF_EXPORT
+    const uint64_t* sampleOffsets () const;
+
+    IMF_EXPORT
+    uint64_t sampleOffset (int x, int y) const;
+    IMF_EXPORT
+    unsigned int sampleCount (int x, int y) const;
+
+    //------------------------------------------------------------
+    // The samples of channel c: totalSamples() values of type
+    // channelType(c), in native byte order.
+    //------------------------------------------------------------
+
+    IMF_EXPORT
+    char* samples (int c);
+    IMF_EXPORT
+    const char* samples (int c) const;
+
+    template <class T> T*       typedSamples (int c);
+    template <class T> const T* typedSamples (int c) const;
+
+private:
+    struct Channel
+    {
+        std::string             name;
+        PixelType               type;
+        std::unique_ptr<char[]> samples;
+    };
+
+    void allocate (Channel& channel);
+
+    IMATH_NAMESPACE::Box2i _window;
+    std::vector<uint64_t>  _offsets;
+    std::vector<Channel>   _channels;
+};
+
+template <class T>
+inline T*
+DeepSampleArena::typedSamples (int c)
+{
+    return reinterpret_cast<T*> (samples (c));
+}
+
+template <class T>
+inline const T*
+DeepSampleArena::typedSamples (int c) const
+{
+    return reinterpret_cast<const T*> (samples (c));
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
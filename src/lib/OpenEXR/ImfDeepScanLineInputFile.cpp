@@ -10,16 +10,19 @@
 //-----------------------------------------------------------------------------
 
 #include "ImfDeepFrameBuffer.h"
+#include "ImfDeepSampleArena.h"
 #include "ImfInputPartData.h"
 #include "ImfInputStreamMutex.h"
 #include "ImfMultiPartInputFile.h"
 #include <ImfChannelList.h>
+#include <ImfChunkOffsetCache.h>
 #include <ImfCompressor.h>
 #include <ImfConvert.h>
 #include <ImfDeepScanLineInputFile.h>
+#include <ImfMMapIO.h>
 #include <ImfMisc.h>
 #include <ImfPartType.h>
-#include <ImfStdIO.h>
+#include <ImfSystemSpecific.h>
 #include <ImfThreading.h>
 #include <ImfVersion.h>
 #include <ImfXdr.h>
@@ -34,7 +37,10 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <exception>
 #include <limits>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -46,6 +52,7 @@ using ILMTHREAD_NAMESPACE::Task;
 using ILMTHREAD_NAMESPACE::TaskGroup;
 using ILMTHREAD_NAMESPACE::ThreadPool;
 using IMATH_NAMESPACE::Box2i;
+using IMATH_NAMESPACE::V2i;
 using IMATH_NAMESPACE::divp;
 using IMATH_NAMESPACE::modp;
 using std::max;
@@ -351,6 +358,17 @@ readLineOffsets (
     vector<uint64_t>&                        lineOffsets,
     bool&                                    complete)
 {
+    //
+    // A single part file is part 0, whether it is read through
+    // this class or through a MultiPartInputFile.
+    //
+
+    ChunkOffsetCache& cache = ChunkOffsetCache::globalCache ();
+    std::string       key;
+    bool              cached = cache.makeKey (is, key);
+
+    if (cached && cache.find (key, 0, is, lineOffsets, complete)) return;
+
     for (unsigned int i = 0; i < lineOffsets.size (); i++)
     {
         OPENEXR_IMF_INTERNAL_NAMESPACE::Xdr::read<
@@ -381,6 +399,8 @@ readLineOffsets (
             break;
         }
     }
+
+    if (cached) cache.insert (key, 0, lineOffsets, complete);
 }
 
 void
@@ -1265,7 +1285,7 @@ DeepScanLineInputFile::DeepScanLineInputFile (
 
     try
     {
-        is = new StdIFStream (fileName);
+        is = openInputFileStream (fileName);
         readMagicNumberAndVersionField (*is, _data->version);
         //
         // Backward compatibility to read multpart file.
@@ -2321,6 +2341,648 @@ DeepScanLineInputFile::readPixelSampleCounts (int scanline)
     readPixelSampleCounts (scanline, scanline);
 }
 
+namespace
+{
+
+//
+// Read the headers and sample count tables of line blocks firstBlock
+// to lastBlock, and, if packedData is not null, their packed sample
+// data.  The sample counts of the pixels in window are to be stored.
+// The stream position is restored before returning.
+//
+
+void
+readDeepChunks (
+    DeepScanLineInputFile::Data*  data,
+    int                           firstBlock,
+    int                           lastBlock,
+    const Box2i&                  window,
+    vector<DeepSampleCountTable>& tables,
+    vector<vector<char>>*         packedData)
+{
+    tables.resize (lastBlock - firstBlock + 1);
+    if (packedData) packedData->resize (tables.size ());
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*data->_streamData);
+#endif
+    IStream* is           = data->_streamData->is;
+    uint64_t savedFilePos = is->tellg ();
+
+    try
+    {
+        for (int b = firstBlock; b <= lastBlock; ++b)
+        {
+            DeepSampleCountTable& table = tables[b - firstBlock];
+
+            is->seekg (data->lineOffsets[b]);
+
+            if (isMultiPart (data->version))
+            {
+                int partNumber;
+                Xdr::read<StreamIO> (*is, partNumber);
+
+                if (partNumber != data->partNumber)
+                    throw IEX_NAMESPACE::ArgExc ("Unexpected part number.");
+            }
+
+            int minY;
+            Xdr::read<StreamIO> (*is, minY);
+
+            if (minY != data->minY + b * data->linesInBuffer)
+                throw IEX_NAMESPACE::ArgExc (
+                    "Unexpected data block y coordinate.");
+
+            uint64_t tableSize, packedDataSize;
+            Xdr::read<StreamIO> (*is, tableSize);
+            Xdr::read<StreamIO> (*is, packedDataSize);
+            Xdr::read<StreamIO> (*is, table.unpackedDataSize);
+
+            if (tableSize > uint64_t (data->maxSampleCountTableSize))
+            {
+                THROW (
+                    IEX_NAMESPACE::ArgExc,
+                    "Bad sampleCountTableDataSize read from chunk "
+                        << b << ": expected "
+                        << data->maxSampleCountTableSize << " or less, got "
+                        << tableSize);
+            }
+
+            int compressorMaxDataSize = std::numeric_limits<int>::max ();
+            if (packedData &&
+                (packedDataSize > uint64_t (compressorMaxDataSize) ||
+                 table.unpackedDataSize > uint64_t (compressorMaxDataSize)))
+            {
+                THROW (
+                    IEX_NAMESPACE::ArgExc,
+                    "This version of the library does not support "
+                        << "the allocation of data with size  > "
+                        << compressorMaxDataSize << " file unpacked size :"
+                        << table.unpackedDataSize << " file packed size   :"
+                        << packedDataSize << ".\n");
+            }
+
+            table.pixels = Box2i (
+                V2i (data->minX, minY),
+                V2i (
+                    data->maxX,
+                    min (minY + data->linesInBuffer - 1, data->maxY)));
+            table.window = window;
+
+            std::stringstream location;
+            location << "chunk " << b;
+            table.location = location.str ();
+
+            table.packed.resize (tableSize);
+            if (tableSize > 0) is->read (table.packed.data (), int (tableSize));
+
+            if (packedData)
+            {
+                vector<char>& packed = (*packedData)[b - firstBlock];
+                packed.resize (packedDataSize);
+
+                if (packedDataSize > 0)
+                    is->read (packed.data (), int (packedDataSize));
+            }
+        }
+    }
+    catch (...)
+    {
+        is->seekg (savedFilePos);
+        throw;
+    }
+
+    is->seekg (savedFilePos);
+}
+
+} // namespace
+
+void
+DeepScanLineInputFile::readPixelSampleCounts (
+    const Slice& sampleCounts, int scanLine1, int scanLine2)
+{
+    if (sampleCounts.type != UINT)
+    {
+        throw IEX_NAMESPACE::ArgExc (
+            "The sample count slice must have type UINT.");
+    }
+
+    int scanLineMin = min (scanLine1, scanLine2);
+    int scanLineMax = max (scanLine1, scanLine2);
+
+    if (scanLineMin < _data->minY || scanLineMax > _data->maxY)
+    {
+        throw IEX_NAMESPACE::ArgExc (
+            "Tried to read scan line sample counts outside "
+            "the image file's data window.");
+    }
+
+    int firstBlock = (scanLineMin - _data->minY) / _data->linesInBuffer;
+    int lastBlock  = (scanLineMax - _data->minY) / _data->linesInBuffer;
+
+    vector<DeepSampleCountTable> tables;
+
+    try
+    {
+        readDeepChunks (
+            _data,
+            firstBlock,
+            lastBlock,
+            Box2i (
+                V2i (_data->minX, scanLineMin),
+                V2i (_data->maxX, scanLineMax)),
+            tables,
+            nullptr);
+
+        uncompressSampleCountTables (
+            _data->header,
+            tables,
+            _data->maxSampleCountTableSize,
+            _data->combinedSampleSize,
+            sampleCounts.base,
+            int (sampleCounts.xStride),
+            int (sampleCounts.yStride),
+            sampleCounts.xTileCoords,
+            sampleCounts.yTileCoords);
+    }
+    catch (IEX_NAMESPACE::BaseExc& e)
+    {
+        REPLACE_EXC (
+            e,
+            "Error reading sample count data from image "
+            "file \""
+                << fileName () << "\". " << e.what ());
+        throw;
+    }
+}
+
+namespace
+{
+
+//
+// Conversion of deep samples from the type in the file to the type
+// in a DeepSampleArena
+//
+
+template <class T>
+inline T
+readSample (const char*& readPtr, Compressor::Format format)
+{
+    T value;
+
+    if (format == Compressor::XDR)
+        Xdr::read<CharPtrIO> (readPtr, value);
+    else
+    {
+        memcpy (&value, readPtr, sizeof (T));
+        readPtr += sizeof (T);
+    }
+
+    return value;
+}
+
+inline unsigned int
+toUint (unsigned int v)
+{
+    return v;
+}
+
+inline unsigned int
+toUint (half v)
+{
+    return halfToUint (v);
+}
+
+inline unsigned int
+toUint (float v)
+{
+    return floatToUint (v);
+}
+
+inline half
+toHalf (unsigned int v)
+{
+    return uintToHalf (v);
+}
+
+inline half
+toHalf (half v)
+{
+    return v;
+}
+
+inline half
+toHalf (float v)
+{
+    return floatToHalf (v);
+}
+
+inline float
+toFloat (unsigned int v)
+{
+    return float (v);
+}
+
+inline float
+toFloat (half v)
+{
+    return float (v);
+}
+
+inline float
+toFloat (float v)
+{
+    return v;
+}
+
+template <class In>
+void
+convertSamples (
+    const char*        readPtr,
+    Compressor::Format format,
+    char*              writePtr,
+    PixelType          typeInArena,
+    uint64_t           numSamples)
+{
+    switch (typeInArena)
+    {
+        case UINT: {
+            unsigned int* out = reinterpret_cast<unsigned int*> (writePtr);
+            for (uint64_t i = 0; i < numSamples; ++i)
+                out[i] = toUint (readSample<In> (readPtr, format));
+            break;
+        }
+        case HALF: {
+            half* out = reinterpret_cast<half*> (writePtr);
+            for (uint64_t i = 0; i < numSamples; ++i)
+                out[i] = toHalf (readSample<In> (readPtr, format));
+            break;
+        }
+        case FLOAT: {
+            float* out = reinterpret_cast<float*> (writePtr);
+            for (uint64_t i = 0; i < numSamples; ++i)
+                out[i] = toFloat (readSample<In> (readPtr, format));
+            break;
+        }
+        default:
+            throw IEX_NAMESPACE::ArgExc ("Unknown pixel data type.");
+    }
+}
+
+void
+copyIntoArena (
+    const char*        readPtr,
+    Compressor::Format format,
+    PixelType          typeInFile,
+    char*              writePtr,
+    PixelType          typeInArena,
+    uint64_t           numSamples)
+{
+    //
+    // Samples of the same type are stored contiguously in the line
+    // buffer and in the arena, so unless bytes must be swapped, a
+    // line of a channel is copied at once.
+    //
+
+    if (typeInFile == typeInArena &&
+        (format == Compressor::NATIVE || GLOBAL_SYSTEM_LITTLE_ENDIAN))
+    {
+        memcpy (writePtr, readPtr, numSamples * pixelTypeSize (typeInFile));
+        return;
+    }
+
+    switch (typeInFile)
+    {
+        case UINT:
+            convertSamples<unsigned int> (
+                readPtr, format, writePtr, typeInArena, numSamples);
+            break;
+        case HALF:
+            convertSamples<half> (
+                readPtr, format, writePtr, typeInArena, numSamples);
+            break;
+        case FLOAT:
+            convertSamples<float> (
+                readPtr, format, writePtr, typeInArena, numSamples);
+            break;
+        default:
+            throw IEX_NAMESPACE::ArgExc ("Unknown pixel data type.");
+    }
+}
+
+//
+// An ArenaTask uncompresses a contiguous range of line blocks, and
+// copies the samples of the lines in the arena's window into the
+// arena.  The sample counts of all lines of the blocks, starting at
+// line countsMinY, are in counts.
+//
+
+class ArenaTask : public Task
+{
+public:
+    ArenaTask (
+        TaskGroup*                          group,
+        const DeepScanLineInputFile::Data*  data,
+        const vector<DeepSampleCountTable>& tables,
+        const vector<vector<char>>&         packedData,
+        size_t                              first,
+        size_t                              last,
+        const vector<unsigned int>&         counts,
+        int                                 countsMinY,
+        const vector<int>&                  arenaChannels,
+        DeepSampleArena&                    arena,
+        std::exception_ptr&                 error)
+        : Task (group)
+        , _data (data)
+        , _tables (tables)
+        , _packedData (packedData)
+        , _first (first)
+        , _last (last)
+        , _counts (counts)
+        , _countsMinY (countsMinY)
+        , _arenaChannels (arenaChannels)
+        , _arena (arena)
+        , _error (error)
+    {}
+
+    virtual void execute ();
+
+private:
+    void readBlock (size_t i, Compressor* compressor);
+
+    const DeepScanLineInputFile::Data*  _data;
+    const vector<DeepSampleCountTable>& _tables;
+    const vector<vector<char>>&         _packedData;
+    size_t                              _first;
+    size_t                              _last;
+    const vector<unsigned int>&         _counts;
+    int                                 _countsMinY;
+    const vector<int>&                  _arenaChannels;
+    DeepSampleArena&                    _arena;
+    std::exception_ptr&                 _error;
+};
+
+void
+ArenaTask::execute ()
+{
+    try
+    {
+        //
+        // One compressor, large enough for the biggest block
+        //
+
+        uint64_t maxUnpackedSize = 0;
+
+        for (size_t i = _first; i < _last; ++i)
+        {
+            maxUnpackedSize =
+                max (maxUnpackedSize, _tables[i].unpackedDataSize);
+        }
+
+        std::unique_ptr<Compressor> compressor (newCompressor (
+            _data->header.compression (),
+            static_cast<size_t> (maxUnpackedSize),
+            _data->header));
+
+        for (size_t i = _first; i < _last; ++i)
+            readBlock (i, compressor.get ());
+    }
+    catch (...)
+    {
+        _error = std::current_exception ();
+    }
+}
+
+void
+ArenaTask::readBlock (size_t i, Compressor* compressor)
+{
+    const DeepSampleCountTable& table  = _tables[i];
+    const vector<char>&         packed = _packedData[i];
+
+    const char*        readPtr;
+    Compressor::Format format = Compressor::XDR;
+
+    if (packed.size () < table.unpackedDataSize)
+    {
+        if (!compressor)
+        {
+            THROW (
+                IEX_NAMESPACE::ArgExc,
+                "Deep data corrupt at " << table.location
+                                        << " (packedDataSize error)");
+        }
+
+        int size = compressor->uncompress (
+            packed.data (),
+            static_cast<int> (packed.size ()),
+            table.pixels.min.y,
+            readPtr);
+
+        if (size < 0 || uint64_t (size) != table.unpackedDataSize)
+        {
+            THROW (
+                IEX_NAMESPACE::ArgExc,
+                "Incorrect size for uncompressed data at "
+                    << table.location << ". Expected "
+                    << table.unpackedDataSize << ", got " << size << ".");
+        }
+
+        format = compressor->format ();
+    }
+    else
+    {
+        //
+        // If the block is uncompressed, it's in XDR format,
+        // regardless of the compressor's output format.
+        //
+
+        readPtr = packed.data ();
+    }
+
+    //
+    // The sample count tables have been checked to fit in the
+    // unpacked data.
+    //
+
+    const ChannelList& channels = _data->header.channels ();
+    const Box2i&       window   = _arena.window ();
+    int                width    = _data->maxX - _data->minX + 1;
+
+    for (int y = table.pixels.min.y; y <= table.pixels.max.y; ++y)
+    {
+        const unsigned int* lineCounts =
+            &_counts[size_t (y - _countsMinY) * width];
+
+        uint64_t lineSampleCount = 0;
+
+        for (int x = 0; x < width; ++x)
+            lineSampleCount += lineCounts[x];
+
+        bool store = y >= window.min.y && y <= window.max.y;
+        int  f     = 0;
+
+        for (ChannelList::ConstIterator j = channels.begin ();
+             j != channels.end ();
+             ++j, ++f)
+        {
+            PixelType typeInFile = j.channel ().type;
+            int       c          = _arenaChannels[f];
+
+            if (store && c >= 0)
+            {
+                copyIntoArena (
+                    readPtr,
+                    format,
+                    typeInFile,
+                    _arena.samples (c) +
+                        _arena.sampleOffset (_data->minX, y) *
+                            pixelTypeSize (_arena.channelType (c)),
+                    _arena.channelType (c),
+                    lineSampleCount);
+            }
+
+            readPtr += lineSampleCount * pixelTypeSize (typeInFile);
+        }
+    }
+}
+
+} // namespace
+
+void
+DeepScanLineInputFile::readPixels (
+    DeepSampleArena& arena, int scanLine1, int scanLine2)
+{
+    int scanLineMin = min (scanLine1, scanLine2);
+    int scanLineMax = max (scanLine1, scanLine2);
+
+    if (scanLineMin < _data->minY || scanLineMax > _data->maxY)
+    {
+        throw IEX_NAMESPACE::ArgExc (
+            "Tried to read scan line outside "
+            "the image file's data window.");
+    }
+
+    int firstBlock = (scanLineMin - _data->minY) / _data->linesInBuffer;
+    int lastBlock  = (scanLineMax - _data->minY) / _data->linesInBuffer;
+    int countsMinY = _data->minY + firstBlock * _data->linesInBuffer;
+    int countsMaxY =
+        min (_data->minY + (lastBlock + 1) * _data->linesInBuffer - 1,
+             _data->maxY);
+    int width = _data->maxX - _data->minX + 1;
+
+    vector<DeepSampleCountTable> tables;
+    vector<vector<char>>         packedData;
+
+    try
+    {
+        //
+        // Read the blocks, then the sample counts of all their lines,
+        // which are needed to find the lines in the blocks.
+        //
+
+        readDeepChunks (
+            _data,
+            firstBlock,
+            lastBlock,
+            Box2i (
+                V2i (_data->minX, countsMinY),
+                V2i (_data->maxX, countsMaxY)),
+            tables,
+            &packedData);
+
+        vector<unsigned int> counts (
+            size_t (countsMaxY - countsMinY + 1) * width);
+
+        uncompressSampleCountTables (
+            _data->header,
+            tables,
+            _data->maxSampleCountTableSize,
+            _data->combinedSampleSize,
+            reinterpret_cast<char*> (counts.data ()) -
+                (ptrdiff_t (countsMinY) * width + _data->minX) *
+                    sizeof (unsigned int),
+            int (sizeof (unsigned int)),
+            int (sizeof (unsigned int) * width),
+            false,
+            false);
+
+        arena.resize (
+            Box2i (
+                V2i (_data->minX, scanLineMin),
+                V2i (_data->maxX, scanLineMax)),
+            &counts[size_t (scanLineMin - countsMinY) * width]);
+
+        //
+        // Channels of the arena that are not in the file are zero
+        //
+
+        const ChannelList& channels = _data->header.channels ();
+        vector<int>        arenaChannels;
+
+        for (ChannelList::ConstIterator j = channels.begin ();
+             j != channels.end ();
+             ++j)
+        {
+            arenaChannels.push_back (arena.findChannel (j.name ()));
+        }
+
+        for (int c = 0; c < arena.numChannels (); ++c)
+        {
+            if (!channels.findChannel (arena.channelName (c)) &&
+                arena.totalSamples () > 0)
+            {
+                memset (
+                    arena.samples (c),
+                    0,
+                    arena.totalSamples () *
+                        pixelTypeSize (arena.channelType (c)));
+            }
+        }
+
+        //
+        // Uncompress and copy the blocks in parallel.  As for the
+        // sample counts, the error of the lowest range is rethrown.
+        //
+
+        size_t numTasks = min<size_t> (
+            tables.size (), 2 * size_t (max (1, globalThreadCount ())));
+
+        vector<std::exception_ptr> errors (numTasks);
+
+        {
+            TaskGroup taskGroup;
+
+            for (size_t t = 0; t < numTasks; ++t)
+            {
+                ThreadPool::addGlobalTask (new ArenaTask (
+                    &taskGroup,
+                    _data,
+                    tables,
+                    packedData,
+                    tables.size () * t / numTasks,
+                    tables.size () * (t + 1) / numTasks,
+                    counts,
+                    countsMinY,
+                    arenaChannels,
+                    arena,
+                    errors[t]));
+            }
+        }
+
+        for (size_t t = 0; t < numTasks; ++t)
+            if (errors[t]) std::rethrow_exception (errors[t]);
+    }
+    catch (IEX_NAMESPACE::BaseExc& e)
+    {
+        REPLACE_EXC (
+            e,
+            "Error reading pixel data from image "
+            "file \""
+                << fileName () << "\". " << e.what ());
+        throw;
+    }
+}
+
 int
 DeepScanLineInputFile::firstScanLineInChunk (int y) const
 {
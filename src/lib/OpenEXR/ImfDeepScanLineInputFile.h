@@ -138,6 +138,25 @@ public:
     IMF_EXPORT
     void readPixels (int scanLine);
 
+    //-----------------------------------------------------------
+    // Read pixel data into a DeepSampleArena
+    //
+    // readPixels(arena,s1,s2) reads the sample counts and the
+    // samples of all scan lines with y coordinates in the interval
+    // [min (s1, s2), max (s1, s2)].  The window of the arena is set
+    // to those lines, full width, and the samples of each channel
+    // of the arena are allocated in one block and converted to the
+    // channel's type.  Channels of the arena that are not in the
+    // file are filled with zeroes; channels of the file that are
+    // not in the arena are not read.
+    //
+    // The frame buffer is not used.  Line blocks are uncompressed
+    // in parallel, using the global thread pool.
+    //-----------------------------------------------------------
+
+    IMF_EXPORT
+    void readPixels (DeepSampleArena& arena, int scanLine1, int scanLine2);
+
     //---------------------------------------------------------------
     // Extract pixel data from pre-read block
     //
@@ -239,6 +258,26 @@ public:
         int                    scanLine1,
         int                    scanLine2) const;
 
+    //-----------------------------------------------------------
+    // Read pixel sample counts into a slice that is not part of
+    // the frame buffer.
+    //
+    // readPixelSampleCounts(slice, s1, s2) stores the number of
+    // samples of each pixel with y coordinates in the interval
+    // [min (s1, s2), max (s1, s2)] in slice, which must be a UINT
+    // slice, indexed like the sample count slice of a frame buffer.
+    //
+    // Only the sample count tables are read from the file, not the
+    // sample data, and the tables of different chunks are
+    // uncompressed in parallel, using the global thread pool.  The
+    // frame buffer is not used, so this can be called before
+    // setFrameBuffer(), for example to allocate the samples.
+    //-----------------------------------------------------------
+
+    IMF_EXPORT
+    void readPixelSampleCounts (
+        const Slice& sampleCounts, int scanLine1, int scanLine2);
+
     struct IMF_HIDDEN Data;
 
 private:
@@ -65,6 +65,13 @@ DeepScanLineInputPart::readPixels (int scanLine)
     file->readPixels (scanLine);
 }
 
+void
+DeepScanLineInputPart::readPixels (
+    DeepSampleArena& arena, int scanLine1, int scanLine2)
+{
+    file->readPixels (arena, scanLine1, scanLine2);
+}
+
 void
 DeepScanLineInputPart::rawPixelData (
     int firstScanLine, char* pixelData, uint64_t& pixelDataSize)
@@ -116,4 +123,11 @@ DeepScanLineInputPart::readPixelSampleCounts (
         rawdata, frameBuffer, scanLine1, scanLine2);
 }
 
+void
+DeepScanLineInputPart::readPixelSampleCounts (
+    const Slice& sampleCounts, int scanLine1, int scanLine2)
+{
+    file->readPixelSampleCounts (sampleCounts, scanLine1, scanLine2);
+}
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -14,8 +14,8 @@
 #include "ImfChannelList.h"
 #include "ImfCompressor.h"
 #include "ImfDeepFrameBuffer.h"
+#include "ImfMMapIO.h"
 #include "ImfMisc.h"
-#include "ImfStdIO.h"
 #include "ImfTileDescriptionAttribute.h"
 #include "ImfTiledMisc.h"
 
@@ -36,6 +36,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <limits>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -794,7 +795,7 @@ DeepTiledInputFile::DeepTiledInputFile (const char fileName[], int numThreads)
     IStream* is = 0;
     try
     {
-        is = new StdIFStream (fileName);
+        is = openInputFileStream (fileName);
         readMagicNumberAndVersionField (*is, _data->version);
 
         //
@@ -805,6 +806,7 @@ DeepTiledInputFile::DeepTiledInputFile (const char fileName[], int numThreads)
         {
             _data->_streamData     = new InputStreamMutex ();
             _data->_streamData->is = is;
+            _data->memoryMapped    = is->isMemoryMapped ();
             _data->header.readFrom (*_data->_streamData->is, _data->version);
             initialize ();
             _data->tileOffsets.readFrom (
@@ -2035,6 +2037,177 @@ DeepTiledInputFile::readPixelSampleCounts (
     readPixelSampleCounts (dx1, dx2, dy1, dy2, l, l);
 }
 
+void
+DeepTiledInputFile::readPixelSampleCounts (
+    const Slice& sampleCounts,
+    int          dx1,
+    int          dx2,
+    int          dy1,
+    int          dy2,
+    int          lx,
+    int          ly)
+{
+    if (sampleCounts.type != UINT)
+    {
+        throw IEX_NAMESPACE::ArgExc (
+            "The sample count slice must have type UINT.");
+    }
+
+    if (!isValidLevel (lx, ly))
+    {
+        THROW (
+            IEX_NAMESPACE::ArgExc,
+            "Level coordinate "
+            "(" << lx << ", " << ly << ") is invalid.");
+    }
+
+    if (dx1 > dx2) std::swap (dx1, dx2);
+
+    if (dy1 > dy2) std::swap (dy1, dy2);
+
+    //
+    // Read the tables in the order they are stored in the file
+    //
+
+    vector<std::pair<uint64_t, V2i>> tiles;
+
+    for (int dy = dy1; dy <= dy2; ++dy)
+    {
+        for (int dx = dx1; dx <= dx2; ++dx)
+        {
+            if (!isValidTile (dx, dy, lx, ly))
+            {
+                THROW (
+                    IEX_NAMESPACE::ArgExc,
+                    "Tile (" << dx << ", " << dy << ", " << lx << "," << ly
+                             << ") is not a valid tile.");
+            }
+
+            tiles.push_back (std::make_pair (
+                _data->tileOffsets (dx, dy, lx, ly), V2i (dx, dy)));
+        }
+    }
+
+    std::sort (
+        tiles.begin (),
+        tiles.end (),
+        [] (const std::pair<uint64_t, V2i>& a,
+            const std::pair<uint64_t, V2i>& b) { return a.first < b.first; });
+
+    vector<DeepSampleCountTable> tables (tiles.size ());
+    uint64_t                     savedFilePos = 0;
+
+    try
+    {
+        {
+#if ILMTHREAD_THREADING_ENABLED
+            std::lock_guard<std::mutex> lock (*_data->_streamData);
+#endif
+            IStream* is  = _data->_streamData->is;
+            savedFilePos = is->tellg ();
+
+            try
+            {
+                for (size_t i = 0; i < tiles.size (); ++i)
+                {
+                    DeepSampleCountTable& table = tables[i];
+                    int                   dx    = tiles[i].second.x;
+                    int                   dy    = tiles[i].second.y;
+
+                    is->seekg (tiles[i].first);
+
+                    if (isMultiPart (_data->version))
+                    {
+                        int partNumber;
+                        Xdr::read<StreamIO> (*is, partNumber);
+
+                        if (partNumber != _data->partNumber)
+                            throw IEX_NAMESPACE::InputExc (
+                                "Unexpected part number.");
+                    }
+
+                    int xInFile, yInFile, lxInFile, lyInFile;
+                    Xdr::read<StreamIO> (*is, xInFile);
+                    Xdr::read<StreamIO> (*is, yInFile);
+                    Xdr::read<StreamIO> (*is, lxInFile);
+                    Xdr::read<StreamIO> (*is, lyInFile);
+
+                    if (xInFile != dx || yInFile != dy || lxInFile != lx ||
+                        lyInFile != ly)
+                    {
+                        throw IEX_NAMESPACE::InputExc (
+                            "Unexpected tile coordinates.");
+                    }
+
+                    uint64_t tableSize, dataSize;
+                    Xdr::read<StreamIO> (*is, tableSize);
+                    Xdr::read<StreamIO> (*is, dataSize);
+                    Xdr::read<StreamIO> (*is, table.unpackedDataSize);
+
+                    std::stringstream location;
+                    location << "tile " << dx << ',' << dy << ',' << lx << ','
+                             << ly;
+                    table.location = location.str ();
+
+                    if (tableSize > _data->maxSampleCountTableSize)
+                    {
+                        THROW (
+                            IEX_NAMESPACE::ArgExc,
+                            "Bad sampleCountTableDataSize read from "
+                                << table.location << ": expected "
+                                << _data->maxSampleCountTableSize
+                                << " or less, got " << tableSize);
+                    }
+
+                    table.pixels =
+                        OPENEXR_IMF_INTERNAL_NAMESPACE::dataWindowForTile (
+                            _data->tileDesc,
+                            _data->minX,
+                            _data->maxX,
+                            _data->minY,
+                            _data->maxY,
+                            dx,
+                            dy,
+                            lx,
+                            ly);
+                    table.window = table.pixels;
+
+                    table.packed.resize (tableSize);
+                    if (tableSize > 0)
+                        is->read (table.packed.data (), int (tableSize));
+                }
+            }
+            catch (...)
+            {
+                is->seekg (savedFilePos);
+                throw;
+            }
+
+            is->seekg (savedFilePos);
+        }
+
+        uncompressSampleCountTables (
+            _data->header,
+            tables,
+            _data->maxSampleCountTableSize,
+            _data->combinedSampleSize,
+            sampleCounts.base,
+            int (sampleCounts.xStride),
+            int (sampleCounts.yStride),
+            sampleCounts.xTileCoords,
+            sampleCounts.yTileCoords);
+    }
+    catch (IEX_NAMESPACE::BaseExc& e)
+    {
+        REPLACE_EXC (
+            e,
+            "Error reading sample count data from image "
+            "file \""
+                << fileName () << "\". " << e.what ());
+        throw;
+    }
+}
+
 size_t
 DeepTiledInputFile::totalTiles () const
 {
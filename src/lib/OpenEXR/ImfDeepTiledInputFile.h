@@ -377,6 +377,33 @@ public:
     IMF_EXPORT
     void readPixelSampleCounts (int dx1, int dx2, int dy1, int dy2, int l = 0);
 
+    //------------------------------------------------------------------
+    // Read pixel sample counts into a slice that is not part of the
+    // frame buffer.
+    //
+    // readPixelSampleCounts(slice, dx1, dx2, dy1, dy2, lx, ly) stores
+    // the number of samples of each pixel of the tiles within range
+    // [(min(dx1, dx2), min(dy1, dy2))...(max(dx1, dx2), max(dy1, dy2)],
+    // on level (lx, ly), in slice, which must be a UINT slice, indexed
+    // like the sample count slice of a frame buffer.
+    //
+    // Only the sample count tables are read from the file, not the
+    // sample data, and the tables of different tiles are uncompressed
+    // in parallel, using the global thread pool.  The frame buffer is
+    // not used, so this can be called before setFrameBuffer(), for
+    // example to allocate the samples.
+    //------------------------------------------------------------------
+
+    IMF_EXPORT
+    void readPixelSampleCounts (
+        const Slice& sampleCounts,
+        int          dx1,
+        int          dx2,
+        int          dy1,
+        int          dy2,
+        int          lx,
+        int          ly);
+
     struct Data;
 
 private:
@@ -207,4 +207,17 @@ DeepTiledInputPart::readPixelSampleCounts (
     file->readPixelSampleCounts (dx1, dx2, dy1, dy2, l);
 }
 
+void
+DeepTiledInputPart::readPixelSampleCounts (
+    const Slice& sampleCounts,
+    int          dx1,
+    int          dx2,
+    int          dy1,
+    int          dy2,
+    int          lx,
+    int          ly)
+{
+    file->readPixelSampleCounts (sampleCounts, dx1, dx2, dy1, dy2, lx, ly);
+}
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,185 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#include "ImfDeflate.h"
+#include "ImfCompression.h"
+#include "OpenEXRConfigInternal.h"
+
+#include <atomic>
+#include <zlib.h>
+
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+#    include <libdeflate.h>
+#endif
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+namespace
+{
+
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+std::atomic<int> s_DefaultDeflateBackend (LIBDEFLATE_DEFLATE_BACKEND);
+
+//
+// libdeflate (de)compressors are not thread safe, but are cheap to
+// keep around, so hold on to one of each per thread.
+//
+
+struct LibdeflateCache
+{
+    libdeflate_compressor*   comp      = nullptr;
+    int                      compLevel = -1;
+    libdeflate_decompressor* decomp    = nullptr;
+
+    ~LibdeflateCache ()
+    {
+        if (comp) libdeflate_free_compressor (comp);
+        if (decomp) libdeflate_free_decompressor (decomp);
+    }
+
+    libdeflate_compressor* compressor (int level)
+    {
+        if (comp && compLevel != level)
+        {
+            libdeflate_free_compressor (comp);
+            comp = nullptr;
+        }
+        if (!comp)
+        {
+            comp      = libdeflate_alloc_compressor (level);
+            compLevel = level;
+        }
+        return comp;
+    }
+
+    libdeflate_decompressor* decompressor ()
+    {
+        if (!decomp) decomp = libdeflate_alloc_decompressor ();
+        return decomp;
+    }
+};
+
+thread_local LibdeflateCache t_libdeflate;
+#else
+std::atomic<int> s_DefaultDeflateBackend (ZLIB_DEFLATE_BACKEND);
+#endif
+
+} // namespace
+
+void
+setDefaultDeflateBackend (DeflateBackend backend)
+{
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    s_DefaultDeflateBackend = (backend == LIBDEFLATE_DEFLATE_BACKEND)
+                                  ? LIBDEFLATE_DEFLATE_BACKEND
+                                  : ZLIB_DEFLATE_BACKEND;
+#else
+    (void) backend;
+#endif
+}
+
+DeflateBackend
+defaultDeflateBackend ()
+{
+    return static_cast<DeflateBackend> (s_DefaultDeflateBackend.load ());
+}
+
+size_t
+zipDeflateBound (size_t rawSize)
+{
+    size_t bound = compressBound (static_cast<uLong> (rawSize));
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    //
+    // libdeflate needs a few bytes per (at least 10000 byte) block,
+    // plus some padding, before it guarantees the output fits
+    //
+    size_t ldBound = rawSize + 5 * (rawSize / 10000 + 1) + 8 + 1 + 6;
+    if (ldBound > bound) bound = ldBound;
+#endif
+    return bound;
+}
+
+bool
+zipDeflate (
+    char* out, size_t& outSize, const char* in, size_t inSize, int level)
+{
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    if (defaultDeflateBackend () == LIBDEFLATE_DEFLATE_BACKEND)
+    {
+        // same meaning as zlib for 1 - 9, but goes up to 12
+        if (level < 0) level = 6;
+        if (level > 12) level = 12;
+
+        libdeflate_compressor* comp = t_libdeflate.compressor (level);
+        if (!comp) return false;
+
+        size_t n = libdeflate_zlib_compress (comp, in, inSize, out, outSize);
+
+        //
+        // 0 means it did not fit, zlib has a slightly smaller worst
+        // case, so let it try in the space given
+        //
+
+        if (n > 0)
+        {
+            outSize = n;
+            return true;
+        }
+    }
+#endif
+
+    uLongf zSize = static_cast<uLongf> (outSize);
+
+    if (Z_OK != ::compress2 (
+                    reinterpret_cast<Bytef*> (out),
+                    &zSize,
+                    reinterpret_cast<const Bytef*> (in),
+                    static_cast<uLong> (inSize),
+                    level))
+    {
+        return false;
+    }
+
+    outSize = zSize;
+    return true;
+}
+
+bool
+zipInflate (char* out, size_t& outSize, const char* in, size_t inSize)
+{
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    if (defaultDeflateBackend () == LIBDEFLATE_DEFLATE_BACKEND)
+    {
+        libdeflate_decompressor* decomp = t_libdeflate.decompressor ();
+        if (!decomp) return false;
+
+        size_t n = 0;
+        if (LIBDEFLATE_SUCCESS !=
+            libdeflate_zlib_decompress (decomp, in, inSize, out, outSize, &n))
+        {
+            return false;
+        }
+
+        outSize = n;
+        return true;
+    }
+#endif
+
+    uLongf zSize = static_cast<uLongf> (outSize);
+
+    if (Z_OK != ::uncompress (
+                    reinterpret_cast<Bytef*> (out),
+                    &zSize,
+                    reinterpret_cast<const Bytef*> (in),
+                    static_cast<uLong> (inSize)))
+    {
+        return false;
+    }
+
+    outSize = zSize;
+    return true;
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,49 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_DEFLATE_H
+#define INCLUDED_IMF_DEFLATE_H
+
+//-----------------------------------------------------------------------------
+//
+//	The deflate step shared by the zip, pxr24 and dwa compressors
+//	and the id manifest. The data is always a standard zlib stream;
+//	it is produced by either zlib or libdeflate, depending on
+//	defaultDeflateBackend().
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfNamespace.h"
+
+#include <cstddef>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+//
+// Worst case size of deflating rawSize bytes, for either backend.
+//
+
+size_t zipDeflateBound (size_t rawSize);
+
+//
+// Deflates inSize bytes from in. On entry, outSize is the space
+// available at out, on success it is the compressed size. A level
+// of -1 is the backend's default level. Returns false on failure.
+//
+
+bool zipDeflate (
+    char* out, size_t& outSize, const char* in, size_t inSize, int level);
+
+//
+// Inflates inSize bytes from in. On entry, outSize is the space
+// available at out, on success it is the uncompressed size. Returns
+// false if the data is corrupt or does not fit.
+//
+
+bool zipInflate (char* out, size_t& outSize, const char* in, size_t inSize);
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
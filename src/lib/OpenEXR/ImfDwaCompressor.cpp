@@ -102,6 +102,7 @@
 #include "ImfDwaCompressorSimd.h"
 
 #include "ImfChannelList.h"
+#include "ImfDeflate.h"
 #include "ImfHeader.h"
 #include "ImfHuf.h"
 #include "ImfIO.h"
@@ -132,15 +133,6 @@
 
 #include <cstdint>
 
-// Windows specific addition to prevent the indirect import of the redefined min/max macros
-#if defined _WIN32 || defined _WIN64
-#    ifdef NOMINMAX
-#        undef NOMINMAX
-#    endif
-#    define NOMINMAX
-#endif
-#include <zlib.h>
-
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
 #include "dwaLookups.h"
@@ -339,6 +331,13 @@ public:
 
     void execute ();
 
+    //
+    // Count the AC and DC values of the channels, like
+    // execute(), without decoding them
+    //
+
+    void skip ();
+
     //
     // These return number of items, not bytes. Each item
     // is an unsigned short
@@ -1134,6 +1133,57 @@ DwaCompressor::LossyDctDecoderBase::execute ()
     delete[] rowBlockHandle;
 }
 
+//
+// Advance past the packed DC and AC values of the
+// channels without decoding them.
+//
+
+void
+DwaCompressor::LossyDctDecoderBase::skip ()
+{
+    size_t numComp    = _rowPtrs.size ();
+    int    numBlocksX = (int) ceil ((float) _width / 8.0f);
+    int    numBlocksY = (int) ceil ((float) _height / 8.0f);
+
+    unsigned short* currAcComp = reinterpret_cast<unsigned short*> (_packedAc);
+    unsigned short* acCompEnd =
+        reinterpret_cast<unsigned short*> (_packedAcEnd);
+
+    for (int block = 0; block < numBlocksX * numBlocksY; ++block)
+    {
+        for (size_t comp = 0; comp < numComp; ++comp)
+        {
+            _packedDcCount++;
+
+            //
+            // Walk the RLE'd AC values of the block, as unRleAc() does
+            //
+
+            int dctComp = 1;
+
+            while (dctComp < 64)
+            {
+                if (currAcComp >= acCompEnd)
+                {
+                    throw IEX_NAMESPACE::InputExc (
+                        "Error uncompressing DWA data"
+                        " (packed AC buffer too small).");
+                }
+
+                if (*currAcComp == 0xff00)
+                    dctComp = 64;
+                else if ((*currAcComp) >> 8 == 0xff)
+                    dctComp += (*currAcComp) & 0xff;
+                else
+                    dctComp++;
+
+                _packedAcCount++;
+                currAcComp++;
+            }
+        }
+    }
+}
+
 //
 // Un-RLE the packed AC components into
 // a half buffer. The half block should
@@ -2074,15 +2124,11 @@ DwaCompressor::compress (
 
     if (*unknownUncompressedSize > 0)
     {
-        uLongf inSize  = (uLongf) (*unknownUncompressedSize);
-        uLongf outSize = compressBound (inSize);
+        size_t inSize  = (size_t) (*unknownUncompressedSize);
+        size_t outSize = zipDeflateBound (inSize);
 
-        if (Z_OK != ::compress2 (
-                        (Bytef*) outDataPtr,
-                        &outSize,
-                        (const Bytef*) _planarUncBuffer[UNKNOWN],
-                        inSize,
-                        9))
+        if (!zipDeflate (
+                outDataPtr, outSize, _planarUncBuffer[UNKNOWN], inSize, 9))
         {
             throw IEX_NAMESPACE::BaseExc ("Data compression (zlib) failed.");
         }
@@ -2114,16 +2160,12 @@ DwaCompressor::compress (
             case DEFLATE:
 
             {
-                uLongf destLen = compressBound (
-                    (*totalAcUncompressedCount) * sizeof (unsigned short));
-
-                if (Z_OK !=
-                    ::compress2 (
-                        (Bytef*) outDataPtr,
-                        &destLen,
-                        (Bytef*) _packedAcBuffer,
-                        (uLong) (*totalAcUncompressedCount * sizeof (unsigned short)),
-                        9))
+                size_t srcLen =
+                    (*totalAcUncompressedCount) * sizeof (unsigned short);
+                size_t destLen = zipDeflateBound (srcLen);
+
+                if (!zipDeflate (
+                        outDataPtr, destLen, _packedAcBuffer, srcLen, 9))
                 {
                     throw IEX_NAMESPACE::InputExc (
                         "Data compression (zlib) failed.");
@@ -2166,14 +2208,14 @@ DwaCompressor::compress (
             _planarUncBuffer[RLE],
             (signed char*) _rleBuffer);
 
-        uLongf dstLen = compressBound ((uLongf) *rleUncompressedSize);
+        size_t dstLen = zipDeflateBound ((size_t) *rleUncompressedSize);
 
-        if (Z_OK != ::compress2 (
-                        (Bytef*) outDataPtr,
-                        &dstLen,
-                        (Bytef*) _rleBuffer,
-                        (uLong) (*rleUncompressedSize),
-                        9))
+        if (!zipDeflate (
+                outDataPtr,
+                dstLen,
+                _rleBuffer,
+                (size_t) (*rleUncompressedSize),
+                9))
         {
             throw IEX_NAMESPACE::BaseExc ("Error compressing RLE'd data.");
         }
@@ -2390,11 +2432,27 @@ DwaCompressor::uncompress (
 
     setupChannelData (minX, minY, maxX, maxY);
 
+    //
+    // Only the sub-streams that hold channels which are needed
+    // have to be uncompressed.
+    //
+
+    bool decodeScheme[NUM_COMPRESSOR_SCHEMES];
+
+    for (int i = 0; i < NUM_COMPRESSOR_SCHEMES; ++i)
+        decodeScheme[i] = false;
+
+    for (unsigned int chan = 0; chan < _channelData.size (); ++chan)
+    {
+        if (decodesChannel (chan))
+            decodeScheme[_channelData[chan].compression] = true;
+    }
+
     //
     // Uncompress the UNKNOWN data into _planarUncBuffer[UNKNOWN]
     //
 
-    if (unknownCompressedSize > 0)
+    if (unknownCompressedSize > 0 && decodeScheme[UNKNOWN])
     {
         if (unknownUncompressedSize > _planarUncBufferSize[UNKNOWN])
         {
@@ -2402,13 +2460,13 @@ DwaCompressor::uncompress (
                                            "(corrupt header).");
         }
 
-        uLongf outSize = (uLongf) unknownUncompressedSize;
+        size_t outSize = (size_t) unknownUncompressedSize;
 
-        if (Z_OK != ::uncompress (
-                        (Bytef*) _planarUncBuffer[UNKNOWN],
-                        &outSize,
-                        (Bytef*) compressedUnknownBuf,
-                        (uLong) unknownCompressedSize))
+        if (!zipInflate (
+                _planarUncBuffer[UNKNOWN],
+                outSize,
+                compressedUnknownBuf,
+                (size_t) unknownCompressedSize))
         {
             throw IEX_NAMESPACE::BaseExc ("Error uncompressing UNKNOWN data.");
         }
@@ -2418,7 +2476,7 @@ DwaCompressor::uncompress (
     // Uncompress the AC data into _packedAcBuffer
     //
 
-    if (acCompressedSize > 0)
+    if (acCompressedSize > 0 && decodeScheme[LOSSY_DCT])
     {
         if (!_packedAcBuffer ||
             totalAcUncompressedCount * sizeof (unsigned short) >
@@ -2445,14 +2503,14 @@ DwaCompressor::uncompress (
                 break;
 
             case DEFLATE: {
-                uLongf destLen =
+                size_t destLen =
                     (int) (totalAcUncompressedCount) * sizeof (unsigned short);
 
-                if (Z_OK != ::uncompress (
-                                (Bytef*) _packedAcBuffer,
-                                &destLen,
-                                (Bytef*) compressedAcBuf,
-                                (uLong) acCompressedSize))
+                if (!zipInflate (
+                        _packedAcBuffer,
+                        destLen,
+                        compressedAcBuf,
+                        (size_t) acCompressedSize))
                 {
                     throw IEX_NAMESPACE::InputExc (
                         "Data decompression (zlib) failed.");
@@ -2477,7 +2535,13 @@ DwaCompressor::uncompress (
     // Uncompress the DC data into _packedDcBuffer
     //
 
-    if (dcCompressedSize > 0)
+    if (!decodeScheme[LOSSY_DCT])
+    {
+        //
+        // No LOSSY_DCT channels are needed, skip the DC data
+        //
+    }
+    else if (dcCompressedSize > 0)
     {
         if (totalDcUncompressedCount * sizeof (unsigned short) >
             _packedDcBufferSize)
@@ -2507,7 +2571,7 @@ DwaCompressor::uncompress (
     // into _planarUncBuffer[RLE]
     //
 
-    if (rleRawSize > 0)
+    if (rleRawSize > 0 && decodeScheme[RLE])
     {
         if (rleUncompressedSize > _rleBufferSize ||
             rleRawSize > _planarUncBufferSize[RLE])
@@ -2516,13 +2580,10 @@ DwaCompressor::uncompress (
                                            "(corrupt header).");
         }
 
-        uLongf dstLen = (uLongf) rleUncompressedSize;
+        size_t dstLen = (size_t) rleUncompressedSize;
 
-        if (Z_OK != ::uncompress (
-                        (Bytef*) _rleBuffer,
-                        &dstLen,
-                        (Bytef*) compressedRleBuf,
-                        (uLong) rleCompressedSize))
+        if (!zipInflate (
+                _rleBuffer, dstLen, compressedRleBuf, (size_t) rleCompressedSize))
         {
             throw IEX_NAMESPACE::BaseExc ("Error uncompressing RLE data.");
         }
@@ -2584,6 +2645,12 @@ DwaCompressor::uncompress (
             throw IEX_NAMESPACE::BaseExc ("Bad DWA compression type detected");
         }
 
+        decodedChannels[rChan] = true;
+        decodedChannels[gChan] = true;
+        decodedChannels[bChan] = true;
+
+        if (!decodeScheme[LOSSY_DCT]) continue;
+
         LossyDctDecoderCsc decoder (
             rowPtrs[rChan],
             rowPtrs[gChan],
@@ -2599,17 +2666,21 @@ DwaCompressor::uncompress (
             _channelData[gChan].type,
             _channelData[bChan].type);
 
-        decoder.execute ();
+        //
+        // The three channels are decoded together, or not at all
+        //
+
+        if (decodesChannel (rChan) || decodesChannel (gChan) ||
+            decodesChannel (bChan))
+            decoder.execute ();
+        else
+            decoder.skip ();
 
         packedAcBufferEnd +=
             decoder.numAcValuesEncoded () * sizeof (unsigned short);
 
         packedDcBufferEnd +=
             decoder.numDcValuesEncoded () * sizeof (unsigned short);
-
-        decodedChannels[rChan] = true;
-        decodedChannels[gChan] = true;
-        decodedChannels[bChan] = true;
     }
 
     //
@@ -2623,6 +2694,20 @@ DwaCompressor::uncompress (
         ChannelData* cd = &_channelData[chan];
         int pixelSize   = OPENEXR_IMF_NAMESPACE::pixelTypeSize (cd->type);
 
+        //
+        // A LOSSY_DCT channel that is not needed still has to be
+        // stepped over in the AC and DC data, if other LOSSY_DCT
+        // channels are needed.  The other schemes keep each
+        // channel's data separate.
+        //
+
+        if (!decodesChannel (chan) &&
+            (cd->compression != LOSSY_DCT || !decodeScheme[LOSSY_DCT]))
+        {
+            decodedChannels[chan] = true;
+            continue;
+        }
+
         switch (cd->compression)
         {
             case LOSSY_DCT:
@@ -2648,7 +2733,10 @@ DwaCompressor::uncompress (
                         cd->height,
                         cd->type);
 
-                    decoder.execute ();
+                    if (decodesChannel (chan))
+                        decoder.execute ();
+                    else
+                        decoder.skip ();
 
                     packedAcBufferEnd +=
                         decoder.numAcValuesEncoded () * sizeof (unsigned short);
@@ -2870,7 +2958,7 @@ DwaCompressor::initializeBuffers (size_t& outBufferSize)
 
                 maxOutBufferSize += std::max (
                     2lu * maxLossyDctAcSize + 65536lu,
-                    static_cast<uint64_t> (compressBound (maxLossyDctAcSize)));
+                    static_cast<uint64_t> (zipDeflateBound (maxLossyDctAcSize)));
                 numLossyDctChans++;
                 break;
 
@@ -2910,14 +2998,14 @@ DwaCompressor::initializeBuffers (size_t& outBufferSize)
     // which could take slightly more space
     //
 
-    maxOutBufferSize += static_cast<uint64_t> (compressBound (rleBufferSize));
+    maxOutBufferSize += static_cast<uint64_t> (zipDeflateBound (rleBufferSize));
 
     //
     // And the same goes for the UNKNOWN data
     //
 
     maxOutBufferSize +=
-        static_cast<uint64_t> (compressBound (unknownBufferSize));
+        static_cast<uint64_t> (zipDeflateBound (unknownBufferSize));
 
     //
     // Allocate a zip/deflate compressor big enought to hold the DC data
@@ -3036,7 +3124,7 @@ DwaCompressor::initializeBuffers (size_t& outBufferSize)
     if (planarUncBufferSize[UNKNOWN] > 0)
     {
         planarUncBufferSize[UNKNOWN] = static_cast<uint64_t> (
-            compressBound (planarUncBufferSize[UNKNOWN]));
+            zipDeflateBound (planarUncBufferSize[UNKNOWN]));
     }
 
     for (int i = 0; i < NUM_COMPRESSOR_SCHEMES; ++i)
@@ -41,9 +41,12 @@ class IMF_EXPORT_TYPE DeepTiledInputFile;
 class IMF_EXPORT_TYPE DeepTiledOutputFile;
 class IMF_EXPORT_TYPE AcesInputFile;
 class IMF_EXPORT_TYPE AcesOutputFile;
+class IMF_EXPORT_TYPE AsyncReader;
 class IMF_EXPORT_TYPE TiledInputPart;
 class IMF_EXPORT_TYPE TiledInputFile;
 class IMF_EXPORT_TYPE TileOffsets;
+class IMF_EXPORT_TYPE TileCache;
+class IMF_EXPORT_TYPE ChunkOffsetCache;
 
 // multipart file handling
 class IMF_EXPORT_TYPE GenericInputFile;
@@ -71,8 +74,10 @@ struct InputStreamMutex;
 // frame buffers
 
 class IMF_EXPORT_TYPE  FrameBuffer;
+struct IMF_EXPORT_TYPE Slice;
 class IMF_EXPORT_TYPE  DeepFrameBuffer;
 struct IMF_EXPORT_TYPE DeepSlice;
+class IMF_EXPORT_TYPE  DeepSampleArena;
 
 // compositing
 class IMF_EXPORT_TYPE DeepCompositing;
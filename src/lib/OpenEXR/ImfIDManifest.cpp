@@ -7,11 +7,11 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "ImfDeflate.h"
 #include "ImfIO.h"
 #include "ImfXdr.h"
 #include <Iex.h>
 #include <ImfIDManifest.h>
-#include <zlib.h>
 
 #include <algorithm>
 #include <stdint.h>
@@ -536,13 +536,13 @@ IDManifest::IDManifest (const CompressedIDManifest& compressed)
     // decompress the compressed manifest
     //
 
-    vector<Bytef> uncomp (compressed._uncompressedDataSize);
-    uLongf        outSize = compressed._uncompressedDataSize;
-    if (Z_OK != ::uncompress (
-                    &uncomp[0],
-                    &outSize,
-                    (const Bytef*) compressed._data,
-                    compressed._compressedDataSize))
+    vector<char> uncomp (compressed._uncompressedDataSize);
+    size_t       outSize = compressed._uncompressedDataSize;
+    if (!zipInflate (
+            &uncomp[0],
+            outSize,
+            (const char*) compressed._data,
+            compressed._compressedDataSize))
     {
         throw IEX_NAMESPACE::InputExc (
             "IDManifest decompression (zlib) failed.");
@@ -1061,16 +1061,15 @@ CompressedIDManifest::CompressedIDManifest (const IDManifest& manifest)
 
     manifest.serialize (serial);
 
-    uLong outputSize = serial.size ();
+    size_t outputSize = serial.size ();
 
     //
     // allocate a buffer which is guaranteed to be big enough for compression
     //
-    uLongf compressedDataSize = compressBound (outputSize);
+    size_t compressedDataSize = zipDeflateBound (outputSize);
     _data                     = (unsigned char*) malloc (compressedDataSize);
-    if (Z_OK !=
-        ::compress (
-            _data, &compressedDataSize, (Bytef*) &serial[0], outputSize))
+    if (!zipDeflate (
+            (char*) _data, compressedDataSize, &serial[0], outputSize, -1))
     {
         throw IEX_NAMESPACE::InputExc ("ID manifest compression failed");
     }
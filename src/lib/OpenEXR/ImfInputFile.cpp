@@ -16,11 +16,11 @@
 #include "ImfChannelList.h"
 #include "ImfInputPartData.h"
 #include "ImfInputStreamMutex.h"
+#include "ImfMMapIO.h"
 #include "ImfMisc.h"
 #include "ImfMultiPartInputFile.h"
 #include "ImfPartType.h"
 #include "ImfScanLineInputFile.h"
-#include "ImfStdIO.h"
 #include "ImfTiledInputFile.h"
 #include "ImfVersion.h"
 
@@ -66,8 +66,22 @@ struct InputFile::Data
     FrameBuffer*           cachedBuffer;
     CompositeDeepScanLine* compositor; // for loading deep files
 
-    int cachedTileY;
-    int offset;
+    //
+    // For tiled files, cachedBuffer holds the channels that are read
+    // from the file, for a block of tiles (cachedMinDx to cachedMaxDx,
+    // cachedMinDy to cachedMaxDy), whose top left pixel is at cachedX,
+    // cachedY and which is cachedWidth pixels wide.  Each slice of
+    // cachedBuffer has room for cachedPixels pixels.
+    //
+
+    size_t cachedPixels;
+    int    cachedMinDx;
+    int    cachedMaxDx;
+    int    cachedMinDy;
+    int    cachedMaxDy;
+    int    cachedX;
+    int    cachedY;
+    int    cachedWidth;
 
     int numThreads;
 
@@ -88,6 +102,8 @@ struct InputFile::Data
     Data& operator= (Data&& other) = delete;
 
     void deleteCachedBuffer ();
+    void allocateCachedBuffer (size_t pixels);
+    void invalidateCachedTiles ();
 };
 
 InputFile::Data::Data (int numThreads)
@@ -97,7 +113,14 @@ InputFile::Data::Data (int numThreads)
     , dsFile (0)
     , cachedBuffer (0)
     , compositor (0)
-    , cachedTileY (-1)
+    , cachedPixels (0)
+    , cachedMinDx (0)
+    , cachedMaxDx (-1)
+    , cachedMinDy (0)
+    , cachedMaxDy (-1)
+    , cachedX (0)
+    , cachedY (0)
+    , cachedWidth (0)
     , numThreads (numThreads)
     , partNumber (-1)
     , part (NULL)
@@ -132,53 +155,156 @@ InputFile::Data::deleteCachedBuffer ()
 
     if (cachedBuffer)
     {
-        for (FrameBuffer::Iterator k = cachedBuffer->begin ();
-             k != cachedBuffer->end ();
-             ++k)
+        allocateCachedBuffer (0);
+
+        //
+        // delete the cached frame buffer
+        //
+
+        delete cachedBuffer;
+        cachedBuffer = 0;
+    }
+
+    invalidateCachedTiles ();
+}
+
+void
+InputFile::Data::allocateCachedBuffer (size_t pixels)
+{
+    //
+    // Replace the memory of each slice in the cached frame buffer
+    // with room for the given number of pixels.  The slices'
+    // base pointers point to the start of their memory.
+    //
+
+    cachedPixels = 0;
+    invalidateCachedTiles ();
+
+    for (FrameBuffer::Iterator k = cachedBuffer->begin ();
+         k != cachedBuffer->end ();
+         ++k)
+    {
+        Slice& s = k.slice ();
+
+        switch (s.type)
         {
-            Slice& s = k.slice ();
+            case OPENEXR_IMF_INTERNAL_NAMESPACE::UINT:
 
-            switch (s.type)
-            {
-                case OPENEXR_IMF_INTERNAL_NAMESPACE::UINT:
+                delete[]((unsigned int*) s.base);
+                s.base = 0;
+                if (pixels) s.base = (char*) new unsigned int[pixels];
+                break;
 
-                    delete[](((unsigned int*) s.base) + offset);
-                    break;
+            case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:
 
-                case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:
+                delete[]((half*) s.base);
+                s.base = 0;
+                if (pixels) s.base = (char*) new half[pixels];
+                break;
 
-                    delete[]((half*) s.base + offset);
-                    break;
+            case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT:
 
-                case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT:
+                delete[]((float*) s.base);
+                s.base = 0;
+                if (pixels) s.base = (char*) new float[pixels];
+                break;
 
-                    delete[](((float*) s.base) + offset);
-                    break;
-                case NUM_PIXELTYPES:
-                    throw (IEX_NAMESPACE::ArgExc ("Invalid pixel type"));
-            }
+            case NUM_PIXELTYPES:
+                throw (IEX_NAMESPACE::ArgExc ("Invalid pixel type"));
         }
+    }
 
-        //
-        // delete the cached frame buffer
-        //
+    cachedPixels = pixels;
+}
 
-        delete cachedBuffer;
-        cachedBuffer = 0;
-    }
+void
+InputFile::Data::invalidateCachedTiles ()
+{
+    cachedMinDx = 0;
+    cachedMaxDx = -1;
+    cachedMinDy = 0;
+    cachedMaxDy = -1;
 }
 
 namespace
 {
 
 void
-bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
+readTileBlock (
+    InputFile::Data* ifd, int minDx, int maxDx, int minDy, int maxDy)
+{
+    //
+    // Read a block of tiles from level 0 of the file
+    // into our temporary framebuffer.
+    //
+
+    Box2i first = ifd->tFile->dataWindowForTile (minDx, minDy, 0);
+    Box2i last  = ifd->tFile->dataWindowForTile (maxDx, maxDy, 0);
+
+    int    width  = last.max.x - first.min.x + 1;
+    int    height = last.max.y - first.min.y + 1;
+    size_t pixels = size_t (width) * size_t (height);
+
+    ifd->invalidateCachedTiles ();
+
+    if (pixels > ifd->cachedPixels) ifd->allocateCachedBuffer (pixels);
+
+    //
+    // Point the slices of the tiled file's frame buffer at the
+    // cached memory, so that the top left pixel of the block
+    // lands at the start of the memory.
+    //
+
+    FrameBuffer fb;
+
+    for (FrameBuffer::ConstIterator k = ifd->cachedBuffer->begin ();
+         k != ifd->cachedBuffer->end ();
+         ++k)
+    {
+        const Slice& c    = k.slice ();
+        size_t       size = pixelTypeSize (c.type);
+        intptr_t     base = reinterpret_cast<intptr_t> (c.base);
+
+        fb.insert (
+            k.name (),
+            Slice (
+                c.type,
+                reinterpret_cast<char*> (
+                    base - (first.min.x + intptr_t (first.min.y) * width) *
+                               intptr_t (size)),
+                size,
+                size * width,
+                1,
+                1,
+                c.fillValue));
+    }
+
+    ifd->tFile->setFrameBuffer (fb);
+    ifd->tFile->readTiles (minDx, maxDx, minDy, maxDy);
+
+    ifd->cachedMinDx = minDx;
+    ifd->cachedMaxDx = maxDx;
+    ifd->cachedMinDy = minDy;
+    ifd->cachedMaxDy = maxDy;
+    ifd->cachedX     = first.min.x;
+    ifd->cachedY     = first.min.y;
+    ifd->cachedWidth = width;
+}
+
+void
+bufferedReadPixels (
+    InputFile::Data* ifd, int scanLine1, int scanLine2, int minX, int maxX)
 {
     //
-    // bufferedReadPixels reads each row of tiles that intersect the
-    // scan-line range (scanLine1 to scanLine2). The previous row of
-    // tiles is cached in order to prevent redundent tile reads when
-    // accessing scanlines sequentially.
+    // bufferedReadPixels reads the tiles that intersect the scan-line
+    // range (scanLine1 to scanLine2) and the pixel range (minX to maxX)
+    // one row of tiles at a time. The last block of tiles is cached in
+    // order to prevent redundent tile reads when accessing scanlines
+    // sequentially.
+    //
+    // When there are threads to keep busy and a row has few tiles in
+    // the pixel range, several rows of tiles are read at once, including
+    // rows beyond the scan-line range, in the order of the file.
     //
 
     int minY = std::min (scanLine1, scanLine2);
@@ -191,10 +317,29 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
     }
 
     //
-    // The minimum and maximum y tile coordinates that intersect this
-    // scanline range
+    // the pixels in a row of tiles
+    //
+
+    Box2i levelRange = ifd->tFile->dataWindowForLevel (0);
+
+    if (minX > maxX) std::swap (minX, maxX);
+
+    minX = std::max (minX, levelRange.min.x);
+    maxX = std::min (maxX, levelRange.max.x);
+
+    if (minX > maxX)
+    {
+        throw IEX_NAMESPACE::ArgExc ("Tried to read pixels outside "
+                                     "the image file's data window.");
+    }
+
+    //
+    // The minimum and maximum tile coordinates that intersect
+    // this range
     //
 
+    int minDx = (minX - levelRange.min.x) / ifd->tFile->tileXSize ();
+    int maxDx = (maxX - levelRange.min.x) / ifd->tFile->tileXSize ();
     int minDy = (minY - ifd->minY) / ifd->tFile->tileYSize ();
     int maxDy = (maxY - ifd->minY) / ifd->tFile->tileYSize ();
 
@@ -218,16 +363,28 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
     }
 
     //
-    // the number of pixels in a row of tiles
+    // The number of rows of tiles to read at once: enough
+    // to give each thread a couple of tiles to work on.
     //
 
-    Box2i levelRange = ifd->tFile->dataWindowForLevel (0);
+    int rowsPerBlock = 1;
+
+    if (ifd->numThreads > 0)
+    {
+        int tilesPerRow = maxDx - minDx + 1;
+        rowsPerBlock    = std::min (
+            16, (2 * ifd->numThreads + tilesPerRow - 1) / tilesPerRow);
+        rowsPerBlock    = std::max (1, rowsPerBlock);
+    }
 
     //
     // Read the tiles into our temporary framebuffer and copy them into
     // the user's buffer
     //
 
+    bool haveChannels = ifd->cachedBuffer &&
+                        ifd->cachedBuffer->begin () != ifd->cachedBuffer->end ();
+
     for (int j = yStart; j != yEnd; j += yStep)
     {
         Box2i tileRange = ifd->tFile->dataWindowForTile (0, j, 0);
@@ -235,21 +392,26 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
         int minYThisRow = std::max (minY, tileRange.min.y);
         int maxYThisRow = std::min (maxY, tileRange.max.y);
 
-        if (j != ifd->cachedTileY)
+        //
+        // If no channels are being read that are present in the file,
+        // cachedBuffer will be empty, and there is nothing to read.
+        //
+
+        if (haveChannels &&
+            (j < ifd->cachedMinDy || j > ifd->cachedMaxDy ||
+             minDx < ifd->cachedMinDx || maxDx > ifd->cachedMaxDx))
         {
             //
             // We don't have any valid buffered info, so we need to read in
             // from the file.
-            // if no channels are being read that are present in file, cachedBuffer will be empty
             //
 
-            if (ifd->cachedBuffer &&
-                ifd->cachedBuffer->begin () != ifd->cachedBuffer->end ())
-            {
-                ifd->tFile->readTiles (0, ifd->tFile->numXTiles (0) - 1, j, j);
-            }
+            int lastDy = j + yStep * (rowsPerBlock - 1);
+            lastDy     = std::max (0, lastDy);
+            lastDy     = std::min (ifd->tFile->numYTiles (0) - 1, lastDy);
 
-            ifd->cachedTileY = j;
+            readTileBlock (
+                ifd, minDx, maxDx, std::min (j, lastDy), std::max (j, lastDy));
         }
 
         //
@@ -265,7 +427,7 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
             Slice toSlice = k.slice (); // slice to read from
             char* toPtr;
 
-            int xStart = levelRange.min.x;
+            int xStart = minX;
             int yStart = minYThisRow;
 
             while (modp (xStart, toSlice.xSampling) != 0)
@@ -292,12 +454,14 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
                 {
                     //
                     // Set the pointers to the start of the y scanline in
-                    // this row of tiles
+                    // the cached block of tiles
                     //
 
                     fromPtr = reinterpret_cast<char*> (
-                        fromBase + (y - tileRange.min.y) * fromSlice.yStride +
-                        xStart * fromSlice.xStride);
+                        fromBase + ((intptr_t (y - ifd->cachedY) *
+                                         ifd->cachedWidth +
+                                     (xStart - ifd->cachedX)) *
+                                    size));
 
                     toPtr = reinterpret_cast<char*> (
                         toBase + divp (y, toSlice.ySampling) * toSlice.yStride +
@@ -307,13 +471,12 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
                     // Copy all pixels for the scanline in this row of tiles
                     //
 
-                    for (int x = xStart; x <= levelRange.max.x;
-                         x += toSlice.xSampling)
+                    for (int x = xStart; x <= maxX; x += toSlice.xSampling)
                     {
                         for (int i = 0; i < size; ++i)
                             toPtr[i] = fromPtr[i];
 
-                        fromPtr += fromSlice.xStride * toSlice.xSampling;
+                        fromPtr += size * toSlice.xSampling;
                         toPtr += toSlice.xStride;
                     }
                 }
@@ -339,7 +502,7 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
                     {
                         case UINT: {
                             unsigned int fill = toSlice.fillValue;
-                            for (int x = xStart; x <= levelRange.max.x;
+                            for (int x = xStart; x <= maxX;
                                  x += toSlice.xSampling)
                             {
                                 *reinterpret_cast<unsigned int*> (toPtr) = fill;
@@ -349,7 +512,7 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
                         }
                         case HALF: {
                             half fill = toSlice.fillValue;
-                            for (int x = xStart; x <= levelRange.max.x;
+                            for (int x = xStart; x <= maxX;
                                  x += toSlice.xSampling)
                             {
                                 *reinterpret_cast<half*> (toPtr) = fill;
@@ -359,7 +522,7 @@ bufferedReadPixels (InputFile::Data* ifd, int scanLine1, int scanLine2)
                         }
                         case FLOAT: {
                             float fill = toSlice.fillValue;
-                            for (int x = xStart; x <= levelRange.max.x;
+                            for (int x = xStart; x <= maxX;
                                  x += toSlice.xSampling)
                             {
                                 *reinterpret_cast<float*> (toPtr) = fill;
@@ -388,7 +551,7 @@ InputFile::InputFile (const char fileName[], int numThreads)
     OPENEXR_IMF_INTERNAL_NAMESPACE::IStream* is = 0;
     try
     {
-        is = new StdIFStream (fileName);
+        is = openInputFileStream (fileName);
         readMagicNumberAndVersionField (*is, _data->version);
 
         //
@@ -737,22 +900,15 @@ InputFile::setFrameBuffer (const FrameBuffer& frameBuffer)
             //
 
             _data->deleteCachedBuffer ();
-            _data->cachedTileY = -1;
 
             //
-            // Create new a cached frame buffer.  It can hold a single
-            // row of tiles.  The cached buffer can be reused for each
-            // row of tiles because we set the yTileCoords parameter of
-            // each Slice to true.
+            // Create new a cached frame buffer, with one slice for each
+            // channel that is present in the file.  Memory for the slices
+            // is allocated when tiles are read; the cached buffer then
+            // holds a block of one or more rows of tiles.
             //
 
-            const Box2i& dataWindow = _data->header.dataWindow ();
-            _data->cachedBuffer     = new FrameBuffer ();
-            _data->offset           = dataWindow.min.x;
-
-            unsigned int tileRowSize = uiMult (
-                dataWindow.max.x - dataWindow.min.x + 1U,
-                _data->tFile->tileYSize ());
+            _data->cachedBuffer = new FrameBuffer ();
 
             for (FrameBuffer::ConstIterator k = frameBuffer.begin ();
                  k != frameBuffer.end ();
@@ -769,52 +925,19 @@ InputFile::setFrameBuffer (const FrameBuffer& frameBuffer)
                     switch (s.type)
                     {
                         case OPENEXR_IMF_INTERNAL_NAMESPACE::UINT:
-
-                            _data->cachedBuffer->insert
-                            (k.name(),
-                            Slice (UINT,
-                                    (char *)(new unsigned int[tileRowSize] -
-                                            _data->offset),
-                                    sizeof (unsigned int),
-                                    sizeof (unsigned int) *
-                                        _data->tFile->levelWidth(0),
-                                    1, 1,
-                                    s.fillValue,
-                                    false, true));
-                            break;
-
                         case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:
-
-                            _data->cachedBuffer->insert (
-                                k.name (),
-                                Slice (
-                                    HALF,
-                                    (char*) (new half[tileRowSize] - _data->offset),
-                                    sizeof (half),
-                                    sizeof (half) *
-                                        _data->tFile->levelWidth (0),
-                                    1,
-                                    1,
-                                    s.fillValue,
-                                    false,
-                                    true));
-                            break;
-
                         case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT:
 
                             _data->cachedBuffer->insert (
                                 k.name (),
                                 Slice (
-                                    OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT,
-                                    (char*) (new float[tileRowSize] - _data->offset),
-                                    sizeof (float),
-                                    sizeof (float) *
-                                        _data->tFile->levelWidth (0),
+                                    s.type,
+                                    0,
+                                    pixelTypeSize (s.type),
+                                    0,
                                     1,
                                     1,
-                                    s.fillValue,
-                                    false,
-                                    true));
+                                    s.fillValue));
                             break;
 
                         default:
@@ -824,8 +947,6 @@ InputFile::setFrameBuffer (const FrameBuffer& frameBuffer)
                     }
                 }
             }
-
-            _data->tFile->setFrameBuffer (*_data->cachedBuffer);
         }
 
         _data->tFileBuffer = frameBuffer;
@@ -869,6 +990,18 @@ InputFile::isComplete () const
         return _data->sFile->isComplete ();
 }
 
+void
+InputFile::setTileCache (TileCache* cache)
+{
+    if (_data->tFile) _data->tFile->setTileCache (cache);
+}
+
+TileCache*
+InputFile::tileCache () const
+{
+    return _data->tFile ? _data->tFile->tileCache () : 0;
+}
+
 bool
 InputFile::isOptimizationEnabled () const
 {
@@ -891,7 +1024,12 @@ InputFile::readPixels (int scanLine1, int scanLine2)
 #if ILMTHREAD_THREADING_ENABLED
         std::lock_guard<std::mutex> lock (*_data);
 #endif
-        bufferedReadPixels (_data, scanLine1, scanLine2);
+        bufferedReadPixels (
+            _data,
+            scanLine1,
+            scanLine2,
+            _data->header.dataWindow ().min.x,
+            _data->header.dataWindow ().max.x);
     }
     else
     {
@@ -905,6 +1043,23 @@ InputFile::readPixels (int scanLine)
     readPixels (scanLine, scanLine);
 }
 
+void
+InputFile::readPixels (const Box2i& window)
+{
+    if (_data->isTiled && !_data->compositor)
+    {
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (*_data);
+#endif
+        bufferedReadPixels (
+            _data, window.min.y, window.max.y, window.min.x, window.max.x);
+    }
+    else
+    {
+        readPixels (window.min.y, window.max.y);
+    }
+}
+
 void
 InputFile::rawPixelData (
     int firstScanLine, const char*& pixelData, int& pixelDataSize)
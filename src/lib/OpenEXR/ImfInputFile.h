@@ -18,6 +18,8 @@
 #include "ImfGenericInputFile.h"
 #include "ImfThreading.h"
 
+#include <ImathBox.h>
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
 class IMF_EXPORT_TYPE InputFile : public GenericInputFile
@@ -109,6 +111,20 @@ public:
     IMF_EXPORT
     bool isComplete () const;
 
+    //---------------------------------------------------------------
+    // Share decoded tiles with other files through a TileCache:
+    //
+    // For tiled files, readPixels() looks for tiles in the cache
+    // before reading them from the file (see TiledInputFile).
+    // For other files, the cache is not used.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void setTileCache (TileCache* cache);
+
+    IMF_EXPORT
+    TileCache* tileCache () const;
+
     //---------------------------------------------------------------
     // Check if SSE optimization is enabled
     //
@@ -154,6 +170,24 @@ public:
     IMF_EXPORT
     void readPixels (int scanLine);
 
+    //---------------------------------------------------------------
+    // Read pixel data for a region of the data window:
+    //
+    // readPixels(window) reads the scan lines from window.min.y to
+    // window.max.y, like readPixels(s1,s2), but only the pixels
+    // from window.min.x to window.max.x of each scan line.  The
+    // window may extend past the data window in x.
+    //
+    // For tiled files, only the tiles that intersect the window
+    // are read and uncompressed, and pixels outside the window
+    // are not written to the frame buffer.  Other files always
+    // read and store whole scan lines.
+    //
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void readPixels (const IMATH_NAMESPACE::Box2i& window);
+
     //----------------------------------------------
     // Read a block of raw pixel data from the file,
     // without uncompressing it (this function is
@@ -70,6 +70,12 @@ InputPart::readPixels (int scanLine)
     file->readPixels (scanLine);
 }
 
+void
+InputPart::readPixels (const IMATH_NAMESPACE::Box2i& window)
+{
+    file->readPixels (window);
+}
+
 void
 InputPart::rawPixelData (
     int firstScanLine, const char*& pixelData, int& pixelDataSize)
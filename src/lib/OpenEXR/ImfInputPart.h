@@ -8,6 +8,8 @@
 
 #include "ImfForward.h"
 
+#include <ImathBox.h>
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
 //-------------------------------------------------------------------
@@ -41,6 +43,8 @@ public:
     IMF_EXPORT
     void readPixels (int scanLine);
     IMF_EXPORT
+    void readPixels (const IMATH_NAMESPACE::Box2i& window);
+    IMF_EXPORT
     void rawPixelData (
         int firstScanLine, const char*& pixelData, int& pixelDataSize);
 
@@ -0,0 +1,418 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//	Low-level file input for OpenEXR based on memory-mapped files.
+//
+//-----------------------------------------------------------------------------
+
+#include "Iex.h"
+#include <ImfMMapIO.h>
+#include <ImfStdIO.h>
+#include <atomic>
+#include <errno.h>
+#include <string.h>
+
+#ifdef _WIN32
+#    define VC_EXTRALEAN
+#    include <string>
+#    include <sys/stat.h>
+#    include <sys/types.h>
+#    include <windows.h>
+#    define IMF_HAVE_MMAP 1
+#elif defined(__unix__) || defined(__APPLE__)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <sys/types.h>
+#    include <unistd.h>
+#    define IMF_HAVE_MMAP 1
+#else
+#    include <sys/stat.h>
+#    include <sys/types.h>
+#endif
+
+using namespace std;
+#include "ImfNamespace.h"
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+namespace
+{
+
+std::atomic<bool> sMemoryMappedFileInput (false);
+
+#ifdef _WIN32
+wstring
+WidenFilename (const char* filename)
+{
+    wstring ret;
+    int     fnlen = static_cast<int> (strlen (filename));
+    int     len   = MultiByteToWideChar (CP_UTF8, 0, filename, fnlen, NULL, 0);
+    if (len > 0)
+    {
+        ret.resize (len);
+        MultiByteToWideChar (CP_UTF8, 0, filename, fnlen, &ret[0], len);
+    }
+    return ret;
+}
+#endif
+
+template <class T>
+void
+appendBytes (string& s, const T& value)
+{
+    s.append (reinterpret_cast<const char*> (&value), sizeof (value));
+}
+
+#if defined(IMF_HAVE_MMAP) && !defined(_WIN32)
+uint64_t
+pageSize ()
+{
+    static const long sz = sysconf (_SC_PAGESIZE);
+    return sz > 0 ? static_cast<uint64_t> (sz) : 4096;
+}
+#endif
+
+} // namespace
+
+MMapIFStream::MMapIFStream (const char fileName[])
+    : OPENEXR_IMF_INTERNAL_NAMESPACE::IStream (fileName)
+    , _base (nullptr)
+    , _length (0)
+    , _pos (0)
+    , _handle (nullptr)
+    , _device (0)
+    , _inode (0)
+    , _mtime (0)
+    , _mtimeNsec (0)
+{
+#if defined(_WIN32)
+    wstring wfn  = WidenFilename (fileName);
+    HANDLE  file = CreateFileW (
+        wfn.c_str (),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+        NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        THROW (IEX_NAMESPACE::InputExc, "Unable to open input file.");
+
+    LARGE_INTEGER lsize;
+    if (!GetFileSizeEx (file, &lsize) || lsize.QuadPart <= 0 ||
+        static_cast<uint64_t> (lsize.QuadPart) > SIZE_MAX)
+    {
+        CloseHandle (file);
+        THROW (IEX_NAMESPACE::InputExc, "Unable to map empty or huge file.");
+    }
+
+    BY_HANDLE_FILE_INFORMATION info;
+    if (GetFileInformationByHandle (file, &info))
+    {
+        _device = info.dwVolumeSerialNumber;
+        _inode  = (uint64_t (info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        _mtime  = int64_t (
+            (uint64_t (info.ftLastWriteTime.dwHighDateTime) << 32) |
+            info.ftLastWriteTime.dwLowDateTime);
+    }
+
+    HANDLE mapping =
+        CreateFileMappingW (file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle (file);
+    if (!mapping)
+        THROW (IEX_NAMESPACE::InputExc, "Unable to create file mapping.");
+
+    void* base = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base)
+    {
+        CloseHandle (mapping);
+        THROW (IEX_NAMESPACE::InputExc, "Unable to map file into memory.");
+    }
+
+    _base   = static_cast<char*> (base);
+    _length = static_cast<uint64_t> (lsize.QuadPart);
+    _handle = mapping;
+#elif defined(IMF_HAVE_MMAP)
+    int fd;
+    do
+    {
+        fd = open (fileName, O_RDONLY | O_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+
+    if (fd < 0) IEX_NAMESPACE::throwErrnoExc ();
+
+    struct stat st;
+    if (fstat (fd, &st) != 0)
+    {
+        int err = errno;
+        close (fd);
+        IEX_NAMESPACE::throwErrnoExc ("%T.", err);
+    }
+
+    if (!S_ISREG (st.st_mode) || st.st_size <= 0 ||
+        static_cast<uint64_t> (st.st_size) > SIZE_MAX)
+    {
+        close (fd);
+        THROW (
+            IEX_NAMESPACE::InputExc,
+            "Unable to map file, it is not a regular, non-empty file.");
+    }
+
+    _device = static_cast<uint64_t> (st.st_dev);
+    _inode  = static_cast<uint64_t> (st.st_ino);
+    _mtime  = static_cast<int64_t> (st.st_mtime);
+#    if defined(__APPLE__)
+    _mtimeNsec = st.st_mtimespec.tv_nsec;
+#    elif defined(__linux__)
+    _mtimeNsec = st.st_mtim.tv_nsec;
+#    endif
+
+    void* base = mmap (
+        nullptr,
+        static_cast<size_t> (st.st_size),
+        PROT_READ,
+        MAP_SHARED,
+        fd,
+        0);
+    int err = errno;
+    close (fd);
+
+    if (base == MAP_FAILED) IEX_NAMESPACE::throwErrnoExc ("%T.", err);
+
+    _base   = static_cast<char*> (base);
+    _length = static_cast<uint64_t> (st.st_size);
+#else
+    THROW (
+        IEX_NAMESPACE::NoImplExc,
+        "Memory-mapped files are not supported on this platform.");
+#endif
+}
+
+MMapIFStream::~MMapIFStream ()
+{
+#if defined(_WIN32)
+    if (_base) UnmapViewOfFile (_base);
+    if (_handle) CloseHandle (static_cast<HANDLE> (_handle));
+#elif defined(IMF_HAVE_MMAP)
+    if (_base) munmap (_base, static_cast<size_t> (_length));
+#endif
+}
+
+bool
+MMapIFStream::isMemoryMapped () const
+{
+    return true;
+}
+
+bool
+MMapIFStream::read (char c[/*n*/], int n)
+{
+    if (_pos >= _length && n != 0)
+        throw IEX_NAMESPACE::InputExc ("Unexpected end of file.");
+
+    uint64_t n2 = static_cast<uint64_t> (n);
+
+    if (n < 0 || _length - _pos < n2)
+    {
+        THROW (
+            IEX_NAMESPACE::InputExc,
+            "Early end of file: read " << (_length - _pos) << " out of " << n
+                                       << " requested bytes.");
+    }
+
+    memcpy (c, _base + _pos, n2);
+    _pos += n2;
+    return _pos < _length;
+}
+
+char*
+MMapIFStream::readMemoryMapped (int n)
+{
+    //
+    // Empty chunks are valid, even at the very end of the file
+    //
+
+    if (n < 0 || _pos > _length ||
+        _length - _pos < static_cast<uint64_t> (n))
+    {
+        if (_pos >= _length)
+            throw IEX_NAMESPACE::InputExc ("Unexpected end of file.");
+        throw IEX_NAMESPACE::InputExc ("Reading past end of file.");
+    }
+
+    //
+    // The caller is about to decompress or copy this chunk, get
+    // the kernel reading all of it now rather than faulting the
+    // pages in one at a time
+    //
+
+    prefetch (_pos, static_cast<uint64_t> (n));
+
+    char* retVal = _base + _pos;
+    _pos += static_cast<uint64_t> (n);
+    return retVal;
+}
+
+uint64_t
+MMapIFStream::tellg ()
+{
+    return _pos;
+}
+
+void
+MMapIFStream::seekg (uint64_t pos)
+{
+    _pos = pos;
+}
+
+uint64_t
+MMapIFStream::size () const
+{
+    return _length;
+}
+
+const char*
+MMapIFStream::data () const
+{
+    return _base;
+}
+
+void
+MMapIFStream::fileIdentity (
+    uint64_t& device, uint64_t& inode, int64_t& mtime, int64_t& mtimeNsec) const
+{
+    device    = _device;
+    inode     = _inode;
+    mtime     = _mtime;
+    mtimeNsec = _mtimeNsec;
+}
+
+void
+MMapIFStream::prefetch (uint64_t pos, uint64_t n) const
+{
+#if defined(IMF_HAVE_MMAP) && !defined(_WIN32) && defined(MADV_WILLNEED)
+    if (pos >= _length || n == 0) return;
+    if (n > _length - pos) n = _length - pos;
+
+    //
+    // Small chunks are served by the readahead the kernel does
+    // anyway, don't pay for a system call
+    //
+
+    uint64_t page = pageSize ();
+    if (n < 2 * page) return;
+
+    uint64_t start = pos & ~(page - 1);
+    madvise (
+        _base + start, static_cast<size_t> (pos + n - start), MADV_WILLNEED);
+#else
+    (void) pos;
+    (void) n;
+#endif
+}
+
+bool
+MMapIFStream::isSupported ()
+{
+#ifdef IMF_HAVE_MMAP
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+setMemoryMappedFileInput (bool enable)
+{
+    sMemoryMappedFileInput = enable;
+}
+
+bool
+memoryMappedFileInput ()
+{
+    return sMemoryMappedFileInput;
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE::IStream*
+openInputFileStream (const char fileName[])
+{
+    if (sMemoryMappedFileInput && MMapIFStream::isSupported ())
+    {
+        try
+        {
+            return new MMapIFStream (fileName);
+        }
+        catch (...)
+        {
+            //
+            // Not something we can map (a pipe, an empty file, ...),
+            // fall back to regular reads, which also produce the
+            // expected error if the file can't be opened at all
+            //
+        }
+    }
+
+    return new StdIFStream (fileName);
+}
+
+bool
+fileIdentity (OPENEXR_IMF_INTERNAL_NAMESPACE::IStream& is, string& identity)
+{
+    const char* fileName = is.fileName ();
+
+    if (fileName == 0 || fileName[0] == 0) return false;
+
+    int64_t  size, mtime, nsec;
+    uint64_t device, inode;
+
+    if (MMapIFStream* ms = dynamic_cast<MMapIFStream*> (&is))
+    {
+        ms->fileIdentity (device, inode, mtime, nsec);
+        size = int64_t (ms->size ());
+    }
+    else
+    {
+#ifdef _WIN32
+        struct _stat64 st;
+        if (_wstat64 (WidenFilename (fileName).c_str (), &st) != 0)
+            return false;
+
+        nsec = 0;
+#else
+        struct stat st;
+        if (stat (fileName, &st) != 0) return false;
+
+#    if defined(__APPLE__)
+        nsec = st.st_mtimespec.tv_nsec;
+#    elif defined(__linux__)
+        nsec = st.st_mtim.tv_nsec;
+#    else
+        nsec = 0;
+#    endif
+#endif
+
+        if ((st.st_mode & S_IFMT) != S_IFREG) return false;
+
+        size   = int64_t (st.st_size);
+        mtime  = int64_t (st.st_mtime);
+        device = uint64_t (st.st_dev);
+        inode  = uint64_t (st.st_ino);
+    }
+
+    identity.assign (fileName);
+    identity.push_back ('\0');
+    appendBytes (identity, size);
+    appendBytes (identity, mtime);
+    appendBytes (identity, nsec);
+    appendBytes (identity, device);
+    appendBytes (identity, inode);
+    return true;
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
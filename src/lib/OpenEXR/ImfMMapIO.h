@@ -0,0 +1,158 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_MMAP_IO_H
+#define INCLUDED_IMF_MMAP_IO_H
+
+//-----------------------------------------------------------------------------
+//
+//	Low-level file input for OpenEXR based on memory-mapped files.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfExport.h"
+#include "ImfNamespace.h"
+
+#include "ImfIO.h"
+
+#include <string>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+//-------------------------------------------
+// class MMapIFStream -- an implementation of
+// class OPENEXR_IMF_INTERNAL_NAMESPACE::IStream that maps the
+// whole file into memory.
+//
+// readMemoryMapped() returns pointers straight into the mapping,
+// so the file readers skip both the read() system call and the
+// copy into their own buffers; uncompressed chunks are not copied
+// at all before being converted into the frame buffer.
+//
+// The mapping is read-only.  If the file is truncated while it is
+// mapped, for instance because it is still being written, reading
+// the missing part raises SIGBUS (or an access violation) instead
+// of throwing an exception, which is why the file readers only use
+// a MMapIFStream if asked to, see setMemoryMappedFileInput().
+//-------------------------------------------
+
+class IMF_EXPORT_TYPE MMapIFStream
+    : public OPENEXR_IMF_INTERNAL_NAMESPACE::IStream
+{
+public:
+    //-------------------------------------------------------
+    // A constructor that opens and maps the file with the
+    // given name.  Throws an exception if the file cannot be
+    // opened or mapped (for instance if it is not a regular
+    // file, or is empty).  The destructor unmaps the file.
+    //-------------------------------------------------------
+
+    IMF_EXPORT MMapIFStream (const char fileName[]);
+
+    IMF_EXPORT virtual ~MMapIFStream ();
+
+    MMapIFStream (const MMapIFStream&) = delete;
+    MMapIFStream (MMapIFStream&&)      = delete;
+    MMapIFStream& operator= (const MMapIFStream&) = delete;
+    MMapIFStream& operator= (MMapIFStream&&) = delete;
+
+    IMF_EXPORT virtual bool     isMemoryMapped () const;
+    IMF_EXPORT virtual bool     read (char c[/*n*/], int n);
+    IMF_EXPORT virtual char*    readMemoryMapped (int n);
+    IMF_EXPORT virtual uint64_t tellg ();
+    IMF_EXPORT virtual void     seekg (uint64_t pos);
+
+    //------------------------------------------------------
+    // Size of the file in bytes
+    //------------------------------------------------------
+
+    IMF_EXPORT uint64_t size () const;
+
+    //------------------------------------------------------
+    // The mapped contents of the file, size() bytes long
+    //------------------------------------------------------
+
+    IMF_EXPORT const char* data () const;
+
+    //------------------------------------------------------
+    // Identity of the mapped file, taken from the descriptor
+    // it was mapped through: device and inode numbers (volume
+    // serial number and file index on Windows) and the
+    // modification time when the file was opened.
+    //------------------------------------------------------
+
+    IMF_EXPORT void fileIdentity (
+        uint64_t& device,
+        uint64_t& inode,
+        int64_t&  mtime,
+        int64_t&  mtimeNsec) const;
+
+    //------------------------------------------------------
+    // Hint that the given byte range will be read soon, so
+    // the operating system can start paging it in.  This is
+    // done automatically for each readMemoryMapped() call.
+    //------------------------------------------------------
+
+    IMF_EXPORT void prefetch (uint64_t pos, uint64_t n) const;
+
+    //------------------------------------------------------
+    // Does this platform support memory-mapped file input?
+    //------------------------------------------------------
+
+    IMF_EXPORT static bool isSupported ();
+
+private:
+    char*    _base;
+    uint64_t _length;
+    uint64_t _pos;
+    void*    _handle;
+    uint64_t _device;
+    uint64_t _inode;
+    int64_t  _mtime;
+    int64_t  _mtimeNsec;
+};
+
+//-------------------------------------------------------------
+// Controls whether the file readers memory-map the files they
+// are given by name.  This is off by default; turn it on only if
+// the files can not be truncated while they are read.
+//-------------------------------------------------------------
+
+IMF_EXPORT
+void setMemoryMappedFileInput (bool enable);
+
+IMF_EXPORT
+bool memoryMappedFileInput ();
+
+//-------------------------------------------------------------
+// Open a local file for reading.  This is what the file readers
+// use when they are given a file name.  It returns a MMapIFStream
+// if memory-mapped file input is turned on and the file can be
+// mapped, and a StdIFStream otherwise.  The caller owns the
+// returned stream.
+//-------------------------------------------------------------
+
+IMF_EXPORT
+OPENEXR_IMF_INTERNAL_NAMESPACE::IStream*
+openInputFileStream (const char fileName[]);
+
+//-------------------------------------------------------------
+// Identify the file that is read through stream is, for caches
+// that must not mix up different files, or the old and new
+// contents of a file that has been rewritten.  The identity is
+// made of the file's name, size, modification time, and device
+// and inode numbers.  For a MMapIFStream these are taken from the
+// descriptor the file was mapped through; other streams do not
+// expose a descriptor, so the file is looked up by name.  Returns
+// false if the stream's name is not that of a regular file.
+//-------------------------------------------------------------
+
+IMF_EXPORT
+bool fileIdentity (
+    OPENEXR_IMF_INTERNAL_NAMESPACE::IStream& is, std::string& identity);
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
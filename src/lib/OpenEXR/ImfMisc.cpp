@@ -16,19 +16,30 @@
 #include <ImfChannelList.h>
 #include <ImfCompressor.h>
 #include <ImfConvert.h>
+#include <ImfFrameBuffer.h>
 #include <ImfHeader.h>
 #include <ImfMisc.h>
 #include <ImfPartType.h>
 #include <ImfStdIO.h>
 #include <ImfTileDescription.h>
+#include <ImfThreading.h>
 #include <ImfXdr.h>
 
+#include "IlmThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
 using IMATH_NAMESPACE::Box2i;
 using IMATH_NAMESPACE::divp;
 using IMATH_NAMESPACE::modp;
 using std::vector;
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
 
 int
 pixelTypeSize (PixelType type)
@@ -1460,6 +1471,26 @@ skipChannel (const char*& readPtr, PixelType typeInFile, size_t xSize)
     }
 }
 
+std::vector<bool>
+decodedChannels (const ChannelList& channels, const FrameBuffer& frameBuffer)
+{
+    std::vector<bool> decoded;
+    bool              all = true;
+
+    for (ChannelList::ConstIterator i = channels.begin (); i != channels.end ();
+         ++i)
+    {
+        bool inFrameBuffer = frameBuffer.findSlice (i.name ()) != 0;
+
+        decoded.push_back (inFrameBuffer);
+        all = all && inFrameBuffer;
+    }
+
+    if (all) decoded.clear ();
+
+    return decoded;
+}
+
 namespace
 {
 //
@@ -1981,4 +2012,228 @@ getChunkOffsetTableSize (const Header& header)
         return getTiledChunkOffsetTableSize (header);
 }
 
+namespace
+{
+
+struct SampleCountSlice
+{
+    char* base;
+    int   xStride;
+    int   yStride;
+    bool  xTileCoords;
+    bool  yTileCoords;
+};
+
+void
+uncompressSampleCountTable (
+    DeepSampleCountTable&   table,
+    Compressor*             compressor,
+    uint64_t                maxTableSize,
+    int                     combinedSampleSize,
+    const SampleCountSlice& slice)
+{
+    const Box2i& pixels = table.pixels;
+    const char*  readPtr;
+
+    if (table.packed.size () < maxTableSize)
+    {
+        if (!compressor)
+        {
+            THROW (
+                IEX_NAMESPACE::ArgExc,
+                "Deep data corrupt at " << table.location
+                                        << " (sampleCountTableDataSize error)");
+        }
+
+        int outSize = compressor->uncompress (
+            table.packed.data (),
+            static_cast<int> (table.packed.size ()),
+            pixels.min.y,
+            readPtr);
+
+        uint64_t tableSize = uint64_t (pixels.max.x - pixels.min.x + 1) *
+                             uint64_t (pixels.max.y - pixels.min.y + 1) *
+                             Xdr::size<int> ();
+
+        if (outSize < 0 || uint64_t (outSize) < tableSize)
+        {
+            THROW (
+                IEX_NAMESPACE::ArgExc,
+                "Deep sampleCount data corrupt at "
+                    << table.location << " (table too small)");
+        }
+    }
+    else
+        readPtr = table.packed.data ();
+
+    int xOffset = slice.xTileCoords ? pixels.min.x : 0;
+    int yOffset = slice.yTileCoords ? pixels.min.y : 0;
+
+    uint64_t totalSamples = 0;
+
+    for (int y = pixels.min.y; y <= pixels.max.y; ++y)
+    {
+        bool store = y >= table.window.min.y && y <= table.window.max.y;
+        int  lastAccumulatedCount = 0;
+
+        for (int x = pixels.min.x; x <= pixels.max.x; ++x)
+        {
+            int accumulatedCount;
+            Xdr::read<CharPtrIO> (readPtr, accumulatedCount);
+
+            if (accumulatedCount < lastAccumulatedCount)
+            {
+                THROW (
+                    IEX_NAMESPACE::ArgExc,
+                    "Deep sampleCount data corrupt at "
+                        << table.location
+                        << " (negative sample count detected)");
+            }
+
+            if (store && x >= table.window.min.x && x <= table.window.max.x)
+            {
+                sampleCount (
+                    slice.base,
+                    slice.xStride,
+                    slice.yStride,
+                    x - xOffset,
+                    y - yOffset) = accumulatedCount - lastAccumulatedCount;
+            }
+
+            lastAccumulatedCount = accumulatedCount;
+        }
+
+        totalSamples += lastAccumulatedCount;
+    }
+
+    if (totalSamples * combinedSampleSize > table.unpackedDataSize)
+    {
+        THROW (
+            IEX_NAMESPACE::ArgExc,
+            "Deep sampleCount data corrupt at "
+                << table.location << ": pixel data only contains "
+                << table.unpackedDataSize
+                << " bytes of data but table references at least "
+                << totalSamples * combinedSampleSize
+                << " bytes of sample data");
+    }
+}
+
+//
+// A SampleCountTask uncompresses a contiguous range of tables, with
+// a compressor of its own.
+//
+
+class SampleCountTask : public Task
+{
+public:
+    SampleCountTask (
+        TaskGroup*                         group,
+        const Header&                      header,
+        std::vector<DeepSampleCountTable>& tables,
+        size_t                             first,
+        size_t                             last,
+        uint64_t                           maxTableSize,
+        int                                combinedSampleSize,
+        const SampleCountSlice&            slice,
+        std::exception_ptr&                error)
+        : Task (group)
+        , _header (header)
+        , _tables (tables)
+        , _first (first)
+        , _last (last)
+        , _maxTableSize (maxTableSize)
+        , _combinedSampleSize (combinedSampleSize)
+        , _slice (slice)
+        , _error (error)
+    {}
+
+    virtual void execute ();
+
+private:
+    const Header&                      _header;
+    std::vector<DeepSampleCountTable>& _tables;
+    size_t                             _first;
+    size_t                             _last;
+    uint64_t                           _maxTableSize;
+    int                                _combinedSampleSize;
+    SampleCountSlice                   _slice;
+    std::exception_ptr&                _error;
+};
+
+void
+SampleCountTask::execute ()
+{
+    try
+    {
+        std::unique_ptr<Compressor> compressor (newCompressor (
+            _header.compression (),
+            static_cast<size_t> (_maxTableSize),
+            _header));
+
+        for (size_t i = _first; i < _last; ++i)
+        {
+            uncompressSampleCountTable (
+                _tables[i],
+                compressor.get (),
+                _maxTableSize,
+                _combinedSampleSize,
+                _slice);
+        }
+    }
+    catch (...)
+    {
+        _error = std::current_exception ();
+    }
+}
+
+} // namespace
+
+void
+uncompressSampleCountTables (
+    const Header&                      header,
+    std::vector<DeepSampleCountTable>& tables,
+    uint64_t                           maxTableSize,
+    int                                combinedSampleSize,
+    char*                              base,
+    int                                xStride,
+    int                                yStride,
+    bool                               xTileCoords,
+    bool                               yTileCoords)
+{
+    SampleCountSlice slice = {base, xStride, yStride, xTileCoords, yTileCoords};
+
+    //
+    // Each task gets an equal share of the tables, and reports its
+    // first error; the error of the lowest range is rethrown, so
+    // the exception does not depend on the number of threads.
+    //
+
+    size_t numTasks = std::min<size_t> (
+        tables.size (), std::max (1, globalThreadCount ()));
+
+    vector<std::exception_ptr> errors (numTasks);
+
+    {
+        TaskGroup taskGroup;
+
+        for (size_t t = 0; t < numTasks; ++t)
+        {
+            ThreadPool::addGlobalTask (new SampleCountTask (
+                &taskGroup,
+                header,
+                tables,
+                tables.size () * t / numTasks,
+                tables.size () * (t + 1) / numTasks,
+                maxTableSize,
+                combinedSampleSize,
+                slice,
+                errors[t]));
+        }
+    }
+
+    for (size_t t = 0; t < numTasks; ++t)
+        if (errors[t]) std::rethrow_exception (errors[t]);
+}
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
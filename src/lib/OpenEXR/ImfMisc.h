@@ -18,7 +18,10 @@
 #include "ImfCompressor.h"
 #include "ImfPixelType.h"
 
+#include "ImathBox.h"
+
 #include <cstddef>
+#include <string>
 #include <vector>
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
@@ -272,6 +275,18 @@ void copyIntoDeepFrameBuffer (
 IMF_EXPORT
 void skipChannel (const char*& readPtr, PixelType typeInFile, size_t xSize);
 
+//
+// Return which of the channels in a file's channel list are
+// needed to read pixels into a frame buffer, in the form taken by
+// Compressor::setDecodedChannels(): an empty vector if all channels
+// are needed, otherwise one entry per channel, true if the frame
+// buffer has a slice for the channel.
+//
+
+IMF_EXPORT
+std::vector<bool>
+decodedChannels (const ChannelList& channels, const FrameBuffer& frameBuffer);
+
 //
 // Convert an array of pixel data from the machine's native
 // representation to XDR format.
@@ -434,6 +449,46 @@ bool usesLongNames (const Header& header);
 IMF_EXPORT
 int getChunkOffsetTableSize (const Header& header);
 
+//
+// The pixel sample count table of a chunk of a deep part, as stored
+// in the file, along with the pixels the chunk covers, the pixels
+// whose sample counts are wanted, and the size of the chunk's sample
+// data once uncompressed.  location names the chunk in error messages.
+//
+
+struct DeepSampleCountTable
+{
+    std::vector<char>      packed;
+    IMATH_NAMESPACE::Box2i pixels;
+    IMATH_NAMESPACE::Box2i window;
+    uint64_t               unpackedDataSize;
+    std::string            location;
+};
+
+//
+// Uncompress a set of sample count tables, in parallel using the
+// global thread pool, and store the number of samples of the pixels
+// in the window of each table in the sample count slice described by
+// base, xStride and yStride.  If xTileCoords or yTileCoords is set,
+// the slice is indexed relative to the first pixel of each table.
+// Tables of maxTableSize bytes or more are not compressed.
+//
+// Throws an IEX_NAMESPACE::ArgExc if a table holds negative counts
+// or counts that add up to more samples than the chunk's sample data.
+//
+
+IMF_EXPORT
+void uncompressSampleCountTables (
+    const Header&                      header,
+    std::vector<DeepSampleCountTable>& tables,
+    uint64_t                           maxTableSize,
+    int                                combinedSampleSize,
+    char*                              base,
+    int                                xStride,
+    int                                yStride,
+    bool                               xTileCoords,
+    bool                               yTileCoords);
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
 
 #endif
@@ -6,6 +6,7 @@
 #include "ImfMultiPartInputFile.h"
 
 #include "ImfBoxAttribute.h"
+#include "ImfChunkOffsetCache.h"
 #include "ImfChromaticitiesAttribute.h"
 #include "ImfDeepScanLineInputFile.h"
 #include "ImfDeepTiledInputFile.h"
@@ -13,10 +14,10 @@
 #include "ImfInputFile.h"
 #include "ImfInputPartData.h"
 #include "ImfInputStreamMutex.h"
+#include "ImfMMapIO.h"
 #include "ImfMisc.h"
 #include "ImfPartType.h"
 #include "ImfScanLineInputFile.h"
-#include "ImfStdIO.h"
 #include "ImfTileOffsets.h"
 #include "ImfTiledInputFile.h"
 #include "ImfTiledMisc.h"
@@ -100,7 +101,7 @@ MultiPartInputFile::MultiPartInputFile (
 {
     try
     {
-        _data->is = new StdIFStream (fileName);
+        _data->is = openInputFileStream (fileName);
         initialize ();
     }
     catch (IEX_NAMESPACE::BaseExc& e)
@@ -799,6 +800,42 @@ MultiPartInputFile::Data::readChunkOffsetTables (
 {
     bool brokenPartsExist = false;
 
+    //
+    // Use cached tables only if the cache holds the tables of all
+    // parts, because reconstruction, if it is needed, fills in the
+    // tables of all parts at once.
+    //
+
+    ChunkOffsetCache& cache = ChunkOffsetCache::globalCache ();
+    std::string       key;
+    bool              cached = cache.makeKey (*is, key);
+
+    if (reconstructChunkOffsetTable && cached)
+    {
+        uint64_t position = is->tellg ();
+        size_t   numFound = 0;
+
+        while (numFound < parts.size ())
+        {
+            InputPartData* part = parts[numFound];
+            int            size = getChunkOffsetTableSize (part->header);
+
+            if (size > gLargeChunkTableSize) break;
+
+            part->chunkOffsets.resize (size);
+
+            if (!cache.find (
+                    key, numFound, *is, part->chunkOffsets, part->completed))
+                break;
+
+            ++numFound;
+        }
+
+        if (numFound == parts.size ()) return;
+
+        is->seekg (position);
+    }
+
     for (size_t i = 0; i < parts.size (); i++)
     {
         int chunkOffsetTableSize = getChunkOffsetTableSize (parts[i]->header);
@@ -845,6 +882,15 @@ MultiPartInputFile::Data::readChunkOffsetTables (
 
     if (brokenPartsExist && reconstructChunkOffsetTable)
         chunkOffsetReconstruction (*is, parts);
+
+    if (cached && (!brokenPartsExist || reconstructChunkOffsetTable))
+    {
+        for (size_t i = 0; i < parts.size (); i++)
+        {
+            cache.insert (
+                key, i, parts[i]->chunkOffsets, parts[i]->completed);
+        }
+    }
 }
 
 int
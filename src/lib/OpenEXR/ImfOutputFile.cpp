@@ -107,6 +107,7 @@ struct LineBuffer
     ~LineBuffer ();
 
     void wait () { _sem.wait (); }
+    bool tryWait () { return _sem.tryWait (); }
     void post () { _sem.post (); }
 
 private:
@@ -161,6 +162,18 @@ struct OutputFile::Data
     int                 linesInBuffer; // number of scanlines each
                                        // buffer holds
     size_t lineBufferSize;             // size of the line buffer
+    size_t maxBytesPerLine;            // size of the largest scanline
+
+    int        numThreads;      // number of threads to keep busy
+    int        pipelineDepth;   // see setWritePipelineDepth()
+    int        nextWriteBuffer; // next line buffer to be stored
+                                // in the file
+    Semaphore  linesCopied;     // posted by every LineBufferTask
+                                // once it has read the frame buffer
+    TaskGroup* taskGroup;       // all LineBufferTasks in flight
+    bool       hasException;    // error message of the first
+    string     exception;       // line buffer that failed to
+                                // compress, if any
 
     int                partNumber; // the output part number
     OutputStreamMutex* _streamData;
@@ -176,10 +189,18 @@ struct OutputFile::Data
     inline LineBuffer* getLineBuffer (int number); // hash function from line
                                                    // buffer indices into our
                                                    // vector of line buffers
+
+    void createLineBuffers (size_t numLineBuffers);
 };
 
 OutputFile::Data::Data (int numThreads)
     : lineOffsetsPosition (0)
+    , numThreads (numThreads)
+    , pipelineDepth (0)
+    , nextWriteBuffer (0)
+    , linesCopied (0)
+    , taskGroup (new TaskGroup)
+    , hasException (false)
     , partNumber (-1)
     , _streamData (0)
     , _deleteStream (false)
@@ -194,6 +215,13 @@ OutputFile::Data::Data (int numThreads)
 
 OutputFile::Data::~Data ()
 {
+    //
+    // Wait for the tasks that may still be running before
+    // their line buffers are deleted.
+    //
+
+    delete taskGroup;
+
     for (size_t i = 0; i < lineBuffers.size (); i++)
         delete lineBuffers[i];
 }
@@ -204,6 +232,24 @@ OutputFile::Data::getLineBuffer (int number)
     return lineBuffers[number % lineBuffers.size ()];
 }
 
+void
+OutputFile::Data::createLineBuffers (size_t numLineBuffers)
+{
+    for (size_t i = 0; i < lineBuffers.size (); i++)
+    {
+        delete lineBuffers[i];
+        lineBuffers[i] = 0;
+    }
+
+    lineBuffers.resize (numLineBuffers, 0);
+
+    for (size_t i = 0; i < lineBuffers.size (); i++)
+    {
+        lineBuffers[i] = new LineBuffer (
+            newCompressor (header.compression (), maxBytesPerLine, header));
+    }
+}
+
 namespace
 {
 
@@ -244,8 +290,8 @@ writePixelData (
     if (currentPosition == 0) currentPosition = filedata->os->tellp ();
 
     partdata->lineOffsets
-        [(partdata->currentScanLine - partdata->minY) /
-         partdata->linesInBuffer] = currentPosition;
+        [(lineBufferMinY - partdata->minY) / partdata->linesInBuffer] =
+        currentPosition;
 
 #ifdef DEBUG
 
@@ -325,10 +371,17 @@ convertToXdr (
         const char* readPtr = writePtr;
 
         //
-        // Iterate over all slices in the file.
+        // Iterate over all channels in the file.  (The channel
+        // list has the same order, types and sampling rates as
+        // the slice table, but unlike the slice table, it does
+        // not change while line buffers are being compressed.)
         //
 
-        for (unsigned int i = 0; i < ofd->slices.size (); ++i)
+        const ChannelList& channels = ofd->header.channels ();
+
+        for (ChannelList::ConstIterator i = channels.begin ();
+             i != channels.end ();
+             ++i)
         {
             //
             // Test if scan line y of this channel is
@@ -336,24 +389,25 @@ convertToXdr (
             // data only if y % ySampling == 0).
             //
 
-            const OutSliceInfo& slice = ofd->slices[i];
+            const Channel& channel = i.channel ();
 
-            if (modp (y, slice.ySampling) != 0) continue;
+            if (modp (y, channel.ySampling) != 0) continue;
 
             //
             // Find the number of sampled pixels, dMaxX-dMinX+1, for
-            // slice i in scan line y (i.e. pixels within the data window
-            // for which x % xSampling == 0).
+            // channel i in scan line y (i.e. pixels within the data
+            // window for which x % xSampling == 0).
             //
 
-            int dMinX = divp (ofd->minX, slice.xSampling);
-            int dMaxX = divp (ofd->maxX, slice.xSampling);
+            int dMinX = divp (ofd->minX, channel.xSampling);
+            int dMaxX = divp (ofd->maxX, channel.xSampling);
 
             //
             // Convert the samples in place.
             //
 
-            convertInPlace (writePtr, readPtr, slice.type, dMaxX - dMinX + 1);
+            convertInPlace (
+                writePtr, readPtr, channel.type, dMaxX - dMinX + 1);
         }
     }
 }
@@ -429,6 +483,8 @@ LineBufferTask::~LineBufferTask ()
 void
 LineBufferTask::execute ()
 {
+    bool copied = false;
+
     try
     {
         //
@@ -542,6 +598,14 @@ LineBufferTask::execute ()
 #endif
         }
 
+        //
+        // The frame buffer is not needed anymore; writePixels()
+        // can return while the line buffer is being compressed.
+        //
+
+        _ofd->linesCopied.post ();
+        copied = true;
+
         //
         // If the next scanline isn't past the bounds of the lineBuffer
         // then we are done, otherwise compress the linebuffer
@@ -611,6 +675,92 @@ LineBufferTask::execute ()
             _lineBuffer->hasException = true;
         }
     }
+
+    if (!copied) _ofd->linesCopied.post ();
+}
+
+//
+// Store line buffer ofd->nextWriteBuffer, which must have been filled
+// completely, in the file.  If wait is false, and the line buffer is
+// still being compressed, return false instead of waiting.  The error
+// message of a line buffer that failed to compress is saved in ofd
+// instead of storing the line buffer.
+//
+
+bool
+writeNextLineBuffer (OutputFile::Data* ofd, bool wait)
+{
+    LineBuffer* lineBuffer = ofd->getLineBuffer (ofd->nextWriteBuffer);
+
+    if (wait)
+        lineBuffer->wait ();
+    else if (!lineBuffer->tryWait ())
+        return false;
+
+    try
+    {
+        if (lineBuffer->hasException)
+        {
+            if (!ofd->hasException)
+            {
+                ofd->exception    = lineBuffer->exception;
+                ofd->hasException = true;
+            }
+
+            lineBuffer->hasException  = false;
+            lineBuffer->partiallyFull = false;
+        }
+        else
+        {
+            writePixelData (ofd->_streamData, ofd, lineBuffer);
+        }
+    }
+    catch (...)
+    {
+        lineBuffer->post ();
+        throw;
+    }
+
+    lineBuffer->post ();
+
+    ofd->nextWriteBuffer += (ofd->lineOrder == INCREASING_Y) ? 1 : -1;
+    return true;
+}
+
+//
+// Store all line buffers that have been filled completely, in file
+// order, waiting for them to be compressed if wait is true, or
+// stopping at the first one that is not ready yet otherwise.
+//
+
+void
+writeCompleteLineBuffers (OutputFile::Data* ofd, bool wait)
+{
+    int stop;
+
+    if (ofd->missingScanLines > 0)
+        stop = (ofd->currentScanLine - ofd->minY) / ofd->linesInBuffer;
+    else if (ofd->lineOrder == INCREASING_Y)
+        stop = ofd->lineOffsets.size ();
+    else
+        stop = -1;
+
+    while (ofd->nextWriteBuffer != stop && writeNextLineBuffer (ofd, wait))
+        ;
+}
+
+//
+// Rethrow the first compression error that has been saved in ofd.
+//
+
+void
+throwSavedException (OutputFile::Data* ofd)
+{
+    if (ofd->hasException)
+    {
+        ofd->hasException = false;
+        throw IEX_NAMESPACE::IoExc (ofd->exception);
+    }
 }
 
 } // namespace
@@ -787,19 +937,15 @@ OutputFile::initialize (const Header& header)
     _data->minY             = dataWindow.min.y;
     _data->maxY             = dataWindow.max.y;
 
-    size_t maxBytesPerLine =
+    _data->maxBytesPerLine =
         bytesPerLineTable (_data->header, _data->bytesPerLine);
 
-    for (size_t i = 0; i < _data->lineBuffers.size (); ++i)
-    {
-        _data->lineBuffers[i] = new LineBuffer (newCompressor (
-            _data->header.compression (), maxBytesPerLine, _data->header));
-    }
+    _data->createLineBuffers (_data->lineBuffers.size ());
 
     LineBuffer* lineBuffer = _data->lineBuffers[0];
     _data->format          = defaultFormat (lineBuffer->compressor);
     _data->linesInBuffer   = numLinesInBuffer (lineBuffer->compressor);
-    _data->lineBufferSize  = maxBytesPerLine * _data->linesInBuffer;
+    _data->lineBufferSize  = _data->maxBytesPerLine * _data->linesInBuffer;
 
     for (size_t i = 0; i < _data->lineBuffers.size (); i++)
         _data->lineBuffers[i]->buffer.resizeErase (_data->lineBufferSize);
@@ -810,6 +956,9 @@ OutputFile::initialize (const Header& header)
 
     _data->lineOffsets.resize (lineOffsetSize);
 
+    _data->nextWriteBuffer =
+        (_data->lineOrder == INCREASING_Y) ? 0 : lineOffsetSize - 1;
+
     offsetInLineBufferTable (
         _data->bytesPerLine, _data->linesInBuffer, _data->offsetInLineBuffer);
 }
@@ -822,6 +971,18 @@ OutputFile::~OutputFile ()
 #if ILMTHREAD_THREADING_ENABLED
             std::lock_guard<std::mutex> lock (*_data->_streamData);
 #endif
+            try
+            {
+                writeCompleteLineBuffers (_data, true);
+            }
+            catch (
+                ...) //NOSONAR - suppress vulnerability reports from SonarCloud.
+            {
+                //
+                // We cannot safely throw any exceptions from here.
+                //
+            }
+
             uint64_t originalPosition = _data->_streamData->os->tellp ();
 
             if (_data->lineOffsetsPosition > 0)
@@ -995,220 +1156,173 @@ OutputFile::writePixels (int numScanLines)
             throw IEX_NAMESPACE::ArgExc (
                 "No frame buffer specified as pixel data source.");
 
+        if (_data->missingScanLines <= 0 ||
+            numScanLines > _data->missingScanLines)
+        {
+            throw IEX_NAMESPACE::ArgExc (
+                "Tried to write more scan lines "
+                "than specified by the data window.");
+        }
+
         //
-        // Maintain two iterators:
-        //     nextWriteBuffer: next linebuffer to be written to the file
-        //     nextCompressBuffer: next linebuffer to compress
+        // Determine the range of line buffers that intersect the
+        // scan line range.
         //
 
-        int first =
-            (_data->currentScanLine - _data->minY) / _data->linesInBuffer;
-
-        int nextWriteBuffer = first;
-        int nextCompressBuffer;
-        int stop;
         int step;
         int scanLineMin;
         int scanLineMax;
+        int last;
 
+        if (_data->lineOrder == INCREASING_Y)
         {
-            //
-            // Create a task group for all line buffer tasks. When the
-            // taskgroup goes out of scope, the destructor waits until
-            // all tasks are complete.
-            //
-
-            TaskGroup taskGroup;
-
-            //
-            // Determine the range of lineBuffers that intersect the scan
-            // line range.  Then add the initial compression tasks to the
-            // thread pool.  We always add in at least one task but the
-            // individual task might not do anything if numScanLines == 0.
-            //
-
-            if (_data->lineOrder == INCREASING_Y)
-            {
-                int last = (_data->currentScanLine + (numScanLines - 1) -
-                            _data->minY) /
-                           _data->linesInBuffer;
-
-                scanLineMin = _data->currentScanLine;
-                scanLineMax = _data->currentScanLine + numScanLines - 1;
-
-                int numTasks = max (
-                    min ((int) _data->lineBuffers.size (), last - first + 1),
-                    1);
-
-                for (int i = 0; i < numTasks; i++)
-                {
-                    ThreadPool::addGlobalTask (new LineBufferTask (
-                        &taskGroup,
-                        _data,
-                        first + i,
-                        scanLineMin,
-                        scanLineMax));
-                }
-
-                nextCompressBuffer = first + numTasks;
-                stop               = last + 1;
-                step               = 1;
-            }
-            else
-            {
-                int last = (_data->currentScanLine - (numScanLines - 1) -
-                            _data->minY) /
-                           _data->linesInBuffer;
-
-                scanLineMax = _data->currentScanLine;
-                scanLineMin = _data->currentScanLine - numScanLines + 1;
-
-                int numTasks = max (
-                    min ((int) _data->lineBuffers.size (), first - last + 1),
-                    1);
+            step        = 1;
+            scanLineMin = _data->currentScanLine;
+            scanLineMax = _data->currentScanLine + numScanLines - 1;
+            last        = (scanLineMax - _data->minY) / _data->linesInBuffer;
+        }
+        else
+        {
+            step        = -1;
+            scanLineMax = _data->currentScanLine;
+            scanLineMin = _data->currentScanLine - numScanLines + 1;
+            last        = (scanLineMin - _data->minY) / _data->linesInBuffer;
+        }
 
-                for (int i = 0; i < numTasks; i++)
-                {
-                    ThreadPool::addGlobalTask (new LineBufferTask (
-                        &taskGroup,
-                        _data,
-                        first - i,
-                        scanLineMin,
-                        scanLineMax));
-                }
+        int first =
+            (_data->currentScanLine - _data->minY) / _data->linesInBuffer;
 
-                nextCompressBuffer = first - numTasks;
-                stop               = last - 1;
-                step               = -1;
-            }
+        int numLineBuffers = _data->lineBuffers.size ();
+        int numTasks       = 0;
 
-            while (true)
+        try
+        {
+            for (int number = first;
+                 numScanLines > 0 && number != last + step;
+                 number += step)
             {
-                if (_data->missingScanLines <= 0)
-                {
-                    throw IEX_NAMESPACE::ArgExc (
-                        "Tried to write more scan lines "
-                        "than specified by the data window.");
-                }
-
-                //
-                // Wait until the next line buffer is ready to be written
                 //
-
-                LineBuffer* writeBuffer =
-                    _data->getLineBuffer (nextWriteBuffer);
-
-                writeBuffer->wait ();
-
-                int numLines =
-                    writeBuffer->scanLineMax - writeBuffer->scanLineMin + 1;
-
-                _data->missingScanLines -= numLines;
-
-                //
-                // If the line buffer is only partially full, then it is
-                // not complete and we cannot write it to disk yet.
+                // Line buffer number shares its LineBuffer object with
+                // line buffer number - step * numLineBuffers; store
+                // that one first.
                 //
 
-                if (writeBuffer->partiallyFull)
+                while ((number - _data->nextWriteBuffer) * step >=
+                       numLineBuffers)
                 {
-                    _data->currentScanLine =
-                        _data->currentScanLine + step * numLines;
-                    writeBuffer->post ();
-
-                    return;
+                    writeNextLineBuffer (_data, true);
                 }
 
                 //
-                // Write the line buffer
-                //
-
-                writePixelData (_data->_streamData, _data, writeBuffer);
-                nextWriteBuffer += step;
-
-                _data->currentScanLine =
-                    _data->currentScanLine + step * numLines;
-
-#ifdef DEBUG
-
-                assert (
-                    _data->currentScanLine ==
-                    ((_data->lineOrder == INCREASING_Y)
-                         ? writeBuffer->scanLineMax + 1
-                         : writeBuffer->scanLineMin - 1));
-
-#endif
-
-                //
-                // Release the lock on the line buffer
-                //
-
-                writeBuffer->post ();
-
-                //
-                // If this was the last line buffer in the scanline range
-                //
-
-                if (nextWriteBuffer == stop) break;
-
-                //
-                // If there are no more line buffers to compress,
-                // then only continue to write out remaining lineBuffers
-                //
-
-                if (nextCompressBuffer == stop) continue;
-
-                //
-                // Add nextCompressBuffer as a compression task
+                // Add a task to copy the scan lines from the frame
+                // buffer into the line buffer, and to compress the
+                // line buffer once it is full.
                 //
 
                 ThreadPool::addGlobalTask (new LineBufferTask (
-                    &taskGroup,
+                    _data->taskGroup,
                     _data,
-                    nextCompressBuffer,
+                    number,
                     scanLineMin,
                     scanLineMax));
 
-                //
-                // Update the next line buffer we need to compress
-                //
-
-                nextCompressBuffer += step;
+                ++numTasks;
             }
-
+        }
+        catch (...)
+        {
             //
-            // Finish all tasks
+            // The caller's frame buffer must not be read
+            // after writePixels() has returned.
             //
+
+            for (int i = 0; i < numTasks; ++i)
+                _data->linesCopied.wait ();
+
+            throw;
         }
 
         //
-        // Exeption handling:
-        //
-        // LineBufferTask::execute() may have encountered exceptions, but
-        // those exceptions occurred in another thread, not in the thread
-        // that is executing this call to OutputFile::writePixels().
-        // LineBufferTask::execute() has caught all exceptions and stored
-        // the exceptions' what() strings in the line buffers.
-        // Now we check if any line buffer contains a stored exception; if
-        // this is the case then we re-throw the exception in this thread.
-        // (It is possible that multiple line buffers contain stored
-        // exceptions.  We re-throw the first exception we find and
-        // ignore all others.)
+        // Wait until all scan lines have been read from the frame
+        // buffer.  After that, the caller may change the frame buffer.
         //
 
-        const string* exception = 0;
+        for (int i = 0; i < numTasks; ++i)
+            _data->linesCopied.wait ();
+
+        _data->currentScanLine += step * numScanLines;
+        _data->missingScanLines -= numScanLines;
+
+        //
+        // Store the line buffers that have been filled.  Without a
+        // pipeline, wait for all of them; with a pipeline, store only
+        // those that have been compressed already, and leave the rest
+        // to later calls to writePixels().
+        //
 
-        for (size_t i = 0; i < _data->lineBuffers.size (); ++i)
+        if (_data->pipelineDepth > 0)
         {
-            LineBuffer* lineBuffer = _data->lineBuffers[i];
+            writeCompleteLineBuffers (_data, false);
+        }
+        else
+        {
+            writeCompleteLineBuffers (_data, true);
 
-            if (lineBuffer->hasException && !exception)
-                exception = &lineBuffer->exception;
+            //
+            // Exeption handling:
+            //
+            // LineBufferTask::execute() may have encountered exceptions,
+            // but those exceptions occurred in another thread, not in
+            // the thread that is executing this call to
+            // OutputFile::writePixels().  LineBufferTask::execute() has
+            // caught all exceptions and stored the exceptions' what()
+            // strings in the line buffers.  Now we check if any line
+            // buffer contains a stored exception; if this is the case
+            // then we re-throw the exception in this thread.  (It is
+            // possible that multiple line buffers contain stored
+            // exceptions.  We re-throw the first exception we find and
+            // ignore all others.)
+            //
 
-            lineBuffer->hasException = false;
+            for (int i = 0; i < numLineBuffers; ++i)
+            {
+                LineBuffer* lineBuffer = _data->lineBuffers[i];
+                lineBuffer->wait ();
+
+                if (lineBuffer->hasException && !_data->hasException)
+                {
+                    _data->exception    = lineBuffer->exception;
+                    _data->hasException = true;
+                }
+
+                lineBuffer->hasException = false;
+                lineBuffer->post ();
+            }
         }
 
-        if (exception) throw IEX_NAMESPACE::IoExc (*exception);
+        throwSavedException (_data);
+    }
+    catch (IEX_NAMESPACE::BaseExc& e)
+    {
+        REPLACE_EXC (
+            e,
+            "Failed to write pixel data to image "
+            "file \""
+                << fileName () << "\". " << e.what ());
+        throw;
+    }
+}
+
+void
+OutputFile::flush ()
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data->_streamData);
+#endif
+    try
+    {
+        writeCompleteLineBuffers (_data, true);
+        throwSavedException (_data);
     }
     catch (IEX_NAMESPACE::BaseExc& e)
     {
@@ -1221,6 +1335,54 @@ OutputFile::writePixels (int numScanLines)
     }
 }
 
+void
+OutputFile::setWritePipelineDepth (int numLineBuffers)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data->_streamData);
+#endif
+    if (numLineBuffers < 0)
+        THROW (
+            IEX_NAMESPACE::ArgExc,
+            "Invalid write pipeline depth " << numLineBuffers
+                                            << " for image file \""
+                                            << fileName () << "\".");
+
+    const Box2i& dataWindow = _data->header.dataWindow ();
+
+    if (_data->missingScanLines != dataWindow.max.y - dataWindow.min.y + 1)
+        THROW (
+            IEX_NAMESPACE::LogicExc,
+            "Cannot change the write pipeline depth of image "
+            "file \""
+                << fileName ()
+                << "\". "
+                   "Pixel data have been written to the file already.");
+
+    size_t numBuffers = numLineBuffers > 0
+                            ? numLineBuffers
+                            : max (1, 2 * _data->numThreads);
+
+    if (numBuffers != _data->lineBuffers.size ())
+    {
+        _data->createLineBuffers (numBuffers);
+
+        for (size_t i = 0; i < _data->lineBuffers.size (); i++)
+            _data->lineBuffers[i]->buffer.resizeErase (_data->lineBufferSize);
+    }
+
+    _data->pipelineDepth = numLineBuffers;
+}
+
+int
+OutputFile::writePipelineDepth () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data->_streamData);
+#endif
+    return _data->pipelineDepth;
+}
+
 int
 OutputFile::currentScanLine () const
 {
@@ -1350,6 +1512,7 @@ OutputFile::copyPixels (InputFile& in)
                                       ? _data->linesInBuffer
                                       : -_data->linesInBuffer;
 
+        _data->nextWriteBuffer += (_data->lineOrder == INCREASING_Y) ? 1 : -1;
         _data->missingScanLines -= _data->linesInBuffer;
     }
 }
@@ -1420,6 +1583,8 @@ OutputFile::breakScanLine (int y, int offset, int length, char c)
 #if ILMTHREAD_THREADING_ENABLED
     std::lock_guard<std::mutex> lock (*_data->_streamData);
 #endif
+    writeCompleteLineBuffers (_data, true);
+
     uint64_t position =
         _data->lineOffsets[(y - _data->minY) / _data->linesInBuffer];
 
@@ -119,6 +119,43 @@ public:
     IMF_EXPORT
     void writePixels (int numScanLines = 1);
 
+    //-------------------------------------------------------------------
+    // Pipelined writing:
+    //
+    // By default, writePixels() returns only after the scan lines have
+    // been compressed and stored in the file.  Files that are written a
+    // few scan lines at a time then gain little from multi-threading,
+    // because each line buffer is compressed while the caller waits.
+    //
+    // setWritePipelineDepth(n), with n > 0, lets writePixels() return
+    // as soon as it has copied the scan lines out of the frame buffer;
+    // up to n line buffers are then compressed in the background while
+    // the caller produces the next scan lines.  Compressed line buffers
+    // are stored in the file by later calls to writePixels(), by
+    // flush(), and by the destructor.  The frame buffer may still be
+    // changed after each call to writePixels().
+    //
+    // setWritePipelineDepth(0) restores the default.  The pipeline
+    // depth can only be changed before the first call to writePixels();
+    // otherwise, setWritePipelineDepth() throws an Iex::LogicExc.
+    //
+    // flush() waits until all line buffers that have been filled are
+    // compressed, and stores them in the file.  Compression errors are
+    // reported by writePixels() or flush(), possibly by a later call
+    // than the one that supplied the pixels; errors that are reported
+    // only once the OutputFile is destroyed are ignored, so call
+    // flush() after writing the last scan line to see them.
+    //-------------------------------------------------------------------
+
+    IMF_EXPORT
+    void setWritePipelineDepth (int numLineBuffers);
+
+    IMF_EXPORT
+    int writePipelineDepth () const;
+
+    IMF_EXPORT
+    void flush ();
+
     //------------------------------------------------------------------
     // Access to the current scan line:
     //
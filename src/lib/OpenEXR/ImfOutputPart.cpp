@@ -45,6 +45,24 @@ OutputPart::writePixels (int numScanLines)
     file->writePixels (numScanLines);
 }
 
+void
+OutputPart::setWritePipelineDepth (int numLineBuffers)
+{
+    file->setWritePipelineDepth (numLineBuffers);
+}
+
+int
+OutputPart::writePipelineDepth () const
+{
+    return file->writePipelineDepth ();
+}
+
+void
+OutputPart::flush ()
+{
+    file->flush ();
+}
+
 int
 OutputPart::currentScanLine () const
 {
@@ -33,6 +33,12 @@ public:
     IMF_EXPORT
     void writePixels (int numScanLines = 1);
     IMF_EXPORT
+    void setWritePipelineDepth (int numLineBuffers);
+    IMF_EXPORT
+    int writePipelineDepth () const;
+    IMF_EXPORT
+    void flush ();
+    IMF_EXPORT
     int currentScanLine () const;
     IMF_EXPORT
     void copyPixels (InputFile& in);
@@ -15,6 +15,9 @@ OutputPartData::OutputPartData (
     int                numThreads,
     bool               multipart)
     : header (header)
+    , chunkOffsetTablePosition (0)
+    , previewPosition (0)
+    , headerPosition (0)
     , numThreads (numThreads)
     , partNumber (partNumber)
     , multipart (multipart)
@@ -539,25 +539,24 @@ PizCompressor::uncompress (
     hufUncompress (inPtr, length, _tmpBuffer, tmpBufferEnd - _tmpBuffer);
 
     //
-    // Wavelet decoding
+    // Wavelet decoding, and expansion of the pixel data to their
+    // original range, for the channels that are needed
     //
 
     for (int i = 0; i < _numChans; ++i)
     {
         ChannelData& cd = _channelData[i];
 
+        if (!decodesChannel (i)) continue;
+
         for (int j = 0; j < cd.size; ++j)
         {
             wav2Decode (
                 cd.start + j, cd.nx, cd.size, cd.ny, cd.nx * cd.size, maxValue);
         }
-    }
-
-    //
-    // Expand the pixel data to their original range
-    //
 
-    applyLut (lut, _tmpBuffer, tmpBufferEnd - _tmpBuffer);
+        applyLut (lut, cd.start, cd.nx * cd.ny * cd.size);
+    }
 
     //
     // Rearrange the pixel data into the format expected by the caller.
@@ -579,6 +578,14 @@ PizCompressor::uncompress (
 
                 if (modp (y, cd.ys) != 0) continue;
 
+                if (!decodesChannel (i))
+                {
+                    int n = cd.nx * cd.size;
+                    outEnd += n * sizeof (unsigned short);
+                    cd.end += n;
+                    continue;
+                }
+
                 for (int x = cd.nx * cd.size; x > 0; --x)
                 {
                     Xdr::write<CharPtrIO> (outEnd, *cd.end);
@@ -602,7 +609,8 @@ PizCompressor::uncompress (
                 if (modp (y, cd.ys) != 0) continue;
 
                 int n = cd.nx * cd.size;
-                memcpy (outEnd, cd.end, n * sizeof (unsigned short));
+                if (decodesChannel (i))
+                    memcpy (outEnd, cd.end, n * sizeof (unsigned short));
                 outEnd += n * sizeof (unsigned short);
                 cd.end += n;
             }
@@ -38,6 +38,7 @@
 #include "ImfPxr24Compressor.h"
 #include "ImfChannelList.h"
 #include "ImfCheckedArithmetic.h"
+#include "ImfDeflate.h"
 #include "ImfHeader.h"
 #include "ImfMisc.h"
 #include "ImfNamespace.h"
@@ -48,7 +49,6 @@
 #include <algorithm>
 #include <assert.h>
 #include <half.h>
-#include <zlib.h>
 
 using namespace std;
 using namespace IMATH_NAMESPACE;
@@ -341,13 +341,14 @@ Pxr24Compressor::compress (
         }
     }
 
-    uLongf outSize = int (ceil ((tmpBufferEnd - _tmpBuffer) * 1.01)) + 100;
+    size_t outSize = int (ceil ((tmpBufferEnd - _tmpBuffer) * 1.01)) + 100;
 
-    if (Z_OK != ::compress (
-                    (Bytef*) _outBuffer,
-                    &outSize,
-                    (const Bytef*) _tmpBuffer,
-                    tmpBufferEnd - _tmpBuffer))
+    if (!zipDeflate (
+            _outBuffer,
+            outSize,
+            (const char*) _tmpBuffer,
+            tmpBufferEnd - _tmpBuffer,
+            -1))
     {
         throw IEX_NAMESPACE::BaseExc ("Data compression (zlib) failed.");
     }
@@ -366,11 +367,9 @@ Pxr24Compressor::uncompress (
         return 0;
     }
 
-    uLongf tmpSize = _maxScanLineSize * _numScanLines;
+    size_t tmpSize = _maxScanLineSize * _numScanLines;
 
-    if (Z_OK !=
-        ::uncompress (
-            (Bytef*) _tmpBuffer, &tmpSize, (const Bytef*) inPtr, inSize))
+    if (!zipInflate ((char*) _tmpBuffer, tmpSize, inPtr, inSize))
     {
         throw IEX_NAMESPACE::InputExc ("Data decompression (zlib) failed.");
     }
@@ -408,7 +407,7 @@ Pxr24Compressor::uncompress (
                     ptr[3]       = ptr[2] + n;
                     tmpBufferEnd = ptr[3] + n;
 
-                    if ((uLongf) (tmpBufferEnd - _tmpBuffer) > tmpSize)
+                    if ((size_t) (tmpBufferEnd - _tmpBuffer) > tmpSize)
                         notEnoughData ();
 
                     for (int j = 0; j < n; ++j)
@@ -433,7 +432,7 @@ Pxr24Compressor::uncompress (
                     ptr[1]       = ptr[0] + n;
                     tmpBufferEnd = ptr[1] + n;
 
-                    if ((uLongf) (tmpBufferEnd - _tmpBuffer) > tmpSize)
+                    if ((size_t) (tmpBufferEnd - _tmpBuffer) > tmpSize)
                         notEnoughData ();
 
                     for (int j = 0; j < n; ++j)
@@ -456,7 +455,7 @@ Pxr24Compressor::uncompress (
                     ptr[2]       = ptr[1] + n;
                     tmpBufferEnd = ptr[2] + n;
 
-                    if ((uLongf) (tmpBufferEnd - _tmpBuffer) > tmpSize)
+                    if ((size_t) (tmpBufferEnd - _tmpBuffer) > tmpSize)
                         notEnoughData ();
 
                     for (int j = 0; j < n; ++j)
@@ -479,7 +478,7 @@ Pxr24Compressor::uncompress (
         }
     }
 
-    if ((uLongf) (tmpBufferEnd - _tmpBuffer) < tmpSize) tooMuchData ();
+    if ((size_t) (tmpBufferEnd - _tmpBuffer) < tmpSize) tooMuchData ();
 
     outPtr = _outBuffer;
     return writePtr - _outBuffer;
@@ -10,8 +10,10 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <IlmThreadPool.h>
 #include <Iex.h>
 #include <ImathFun.h>
+#include <ImfArray.h>
 #include <ImfChannelList.h>
 #include <ImfInputPart.h>
 #include <ImfMultiPartInputFile.h>
@@ -19,6 +21,7 @@
 #include <ImfRgbaFile.h>
 #include <ImfRgbaYca.h>
 #include <ImfStandardAttributes.h>
+#include <ImfThreading.h>
 #include <algorithm>
 #include <mutex>
 #include <string.h>
@@ -30,6 +33,9 @@ OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 using namespace std;
 using namespace IMATH_NAMESPACE;
 using namespace RgbaYca;
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
 
 namespace
 {
@@ -138,6 +144,133 @@ cachePadding (ptrdiff_t size)
     return 0;
 }
 
+//
+// Number of scan lines that are converted between RGBA and YCA
+// at a time.  The scan lines of a strip are processed in parallel
+// on the global thread pool, and they are passed to or from the
+// file with a single call to writePixels() or readPixels().
+//
+
+const int STRIP_HEIGHT = 32;
+
+//
+// Append N2 copies of the first and last pixel of a scan line
+// with N2 extra pixels on both ends to the beginning and end
+// of the scan line.
+//
+
+void
+padLine (int width, Rgba buf[/*width+N-1*/])
+{
+    for (int i = 0; i < N2; ++i)
+    {
+        buf[i]              = buf[N2];
+        buf[width + N2 + i] = buf[width + N2 - 2];
+    }
+}
+
+//
+// A task that processes lines i1 through i2 of a job
+//
+
+template <class Job> class LineRangeTask : public Task
+{
+public:
+    LineRangeTask (TaskGroup* group, const Job& job, int i1, int i2)
+        : Task (group), _job (job), _i1 (i1), _i2 (i2)
+    {}
+
+    virtual void execute () { _job.processLines (_i1, _i2); }
+
+private:
+    const Job& _job;
+    int        _i1;
+    int        _i2;
+};
+
+//
+// Split lines i1 through i2 of a job into one range per thread,
+// and process the ranges in parallel.
+//
+
+template <class Job>
+void
+processLines (const Job& job, int i1, int i2)
+{
+    int numLines = i2 - i1 + 1;
+    int numTasks = min (numLines, max (1, globalThreadCount ()));
+
+    if (numTasks <= 1)
+    {
+        if (numLines > 0) job.processLines (i1, i2);
+
+        return;
+    }
+
+    TaskGroup taskGroup;
+
+    for (int t = 0; t < numTasks; ++t)
+    {
+        ThreadPool::addGlobalTask (new LineRangeTask<Job> (
+            &taskGroup,
+            job,
+            i1 + numLines * t / numTasks,
+            i1 + numLines * (t + 1) / numTasks - 1));
+    }
+}
+
+//
+// Copies scan lines from the caller's frame buffer, converts them
+// from RGBA to YCA, and, if filter is set, filters and subsamples
+// the chroma channels horizontally.  Line i of the job is scan line
+// firstY + i * dy of the frame buffer; the result is stored in out[i].
+//
+
+struct RgbaToYcaJob
+{
+    const Rgba*  fbBase;
+    size_t       fbXStride;
+    size_t       fbYStride;
+    int          xMin;
+    int          width;
+    V3f          yw;
+    bool         writeA;
+    bool         filter;
+    int          firstY;
+    int          dy;
+    Rgba* const* out;
+
+    void processLines (int i1, int i2) const;
+};
+
+void
+RgbaToYcaJob::processLines (int i1, int i2) const
+{
+    Array<Rgba> tmpBuf (width + N - 1);
+    intptr_t    base = reinterpret_cast<intptr_t> (fbBase);
+
+    for (int i = i1; i <= i2; ++i)
+    {
+        int   y    = firstY + i * dy;
+        Rgba* line = filter ? tmpBuf + N2 : out[i];
+
+        for (int j = 0; j < width; ++j)
+        {
+            line[j] = *reinterpret_cast<const Rgba*> (
+                base +
+                sizeof (Rgba) * (fbYStride * y + fbXStride * (j + xMin)));
+        }
+
+        RGBAtoYCA (yw, width, writeA, line, line);
+
+        if (filter)
+        {
+            padLine (width, tmpBuf);
+            decimateChromaHoriz (width, tmpBuf, out[i]);
+        }
+    }
+}
+
 } // namespace
 
 class RgbaOutputFile::ToYca : public std::mutex
@@ -159,11 +292,13 @@ public:
     int  currentScanLine () const;
 
 private:
-    void padTmpBuf ();
-    void rotateBuffers ();
-    void duplicateLastBuffer ();
-    void duplicateSecondToLastBuffer ();
-    void decimateChromaVertAndWriteScanLine ();
+    void  convertScanLines (int numScanLines, Rgba* const out[]);
+    void  rotateBuffers ();
+    void  duplicateLastBuffer ();
+    void  duplicateSecondToLastBuffer ();
+    void  decimateChromaVertAndWriteScanLine ();
+    Rgba* stripLine (int i);
+    void  writeStrip ();
 
     OutputFile& _outputFile;
     bool        _writeY;
@@ -178,7 +313,12 @@ private:
     V3f         _yw;
     Rgba*       _bufBase;
     Rgba*       _buf[N];
-    Rgba*       _tmpBuf;
+    Rgba*       _convertedBase;
+    Rgba*       _converted[STRIP_HEIGHT];
+    Rgba*       _stripBase;
+    ptrdiff_t   _stripXSize;
+    int         _stripLines;
+    int         _stripY;
     const Rgba* _fbBase;
     size_t      _fbXStride;
     size_t      _fbYStride;
@@ -216,7 +356,21 @@ RgbaOutputFile::ToYca::ToYca (OutputFile& outputFile, RgbaChannels rgbaChannels)
     for (int i = 0; i < N; ++i)
         _buf[i] = _bufBase + (i * (_width + pad));
 
-    _tmpBuf = new Rgba[_width + N - 1];
+    //
+    // Scan lines that have been converted to YCA, but not yet
+    // filtered vertically, and a strip of scan lines that are
+    // ready to be stored in the file.
+    //
+
+    _convertedBase = new Rgba[(_width + pad) * STRIP_HEIGHT];
+
+    for (int i = 0; i < STRIP_HEIGHT; ++i)
+        _converted[i] = _convertedBase + (i * (_width + pad));
+
+    _stripXSize = _width + pad;
+    _stripBase  = new Rgba[_stripXSize * STRIP_HEIGHT];
+    _stripLines = 0;
+    _stripY     = _currentScanLine;
 
     _fbBase    = 0;
     _fbXStride = 0;
@@ -229,7 +383,8 @@ RgbaOutputFile::ToYca::ToYca (OutputFile& outputFile, RgbaChannels rgbaChannels)
 RgbaOutputFile::ToYca::~ToYca ()
 {
     delete[] _bufBase;
-    delete[] _tmpBuf;
+    delete[] _convertedBase;
+    delete[] _stripBase;
 }
 
 void
@@ -243,62 +398,6 @@ void
 RgbaOutputFile::ToYca::setFrameBuffer (
     const Rgba* base, size_t xStride, size_t yStride)
 {
-    if (_fbBase == 0)
-    {
-        FrameBuffer fb;
-
-        if (_writeY)
-        {
-            fb.insert (
-                "Y",
-                Slice (
-                    HALF,                       // type
-                    (char*) &_tmpBuf[-_xMin].g, // base
-                    sizeof (Rgba),              // xStride
-                    0,                          // yStride
-                    1,                          // xSampling
-                    1));                        // ySampling
-        }
-
-        if (_writeC)
-        {
-            fb.insert (
-                "RY",
-                Slice (
-                    HALF,                       // type
-                    (char*) &_tmpBuf[-_xMin].r, // base
-                    sizeof (Rgba) * 2,          // xStride
-                    0,                          // yStride
-                    2,                          // xSampling
-                    2));                        // ySampling
-
-            fb.insert (
-                "BY",
-                Slice (
-                    HALF,                       // type
-                    (char*) &_tmpBuf[-_xMin].b, // base
-                    sizeof (Rgba) * 2,          // xStride
-                    0,                          // yStride
-                    2,                          // xSampling
-                    2));                        // ySampling
-        }
-
-        if (_writeA)
-        {
-            fb.insert (
-                "A",
-                Slice (
-                    HALF,                       // type
-                    (char*) &_tmpBuf[-_xMin].a, // base
-                    sizeof (Rgba),              // xStride
-                    0,                          // yStride
-                    1,                          // xSampling
-                    1));                        // ySampling
-        }
-
-        _outputFile.setFrameBuffer (fb);
-    }
-
     _fbBase    = base;
     _fbXStride = xStride;
     _fbYStride = yStride;
@@ -317,87 +416,54 @@ RgbaOutputFile::ToYca::writePixels (int numScanLines)
                  << "\".");
     }
 
-    intptr_t base = reinterpret_cast<intptr_t> (_fbBase);
-    if (_writeY && !_writeC)
+    int dy = (_lineOrder == INCREASING_Y) ? 1 : -1;
+
+    while (numScanLines > 0)
     {
-        //
-        // We are writing only luminance; filtering
-        // and subsampling are not necessary.
-        //
+        int n = min (numScanLines, STRIP_HEIGHT);
+        numScanLines -= n;
 
-        for (int i = 0; i < numScanLines; ++i)
+        if (_writeY && !_writeC)
         {
             //
-            // Copy the next scan line from the caller's
-            // frame buffer into _tmpBuf.
+            // We are writing only luminance; filtering and
+            // subsampling are not necessary.  Convert the next
+            // n scan lines from RGB to luminance/chroma, directly
+            // into the strip, and store them in the output file.
             //
 
-            for (int j = 0; j < _width; ++j)
-            {
-                _tmpBuf[j] = *reinterpret_cast<Rgba*> (
-                    base + sizeof (Rgba) * (_fbYStride * _currentScanLine +
-                                            _fbXStride * (j + _xMin)));
-            }
+            Rgba* lines[STRIP_HEIGHT];
 
-            //
-            // Convert the scan line from RGB to luminance/chroma,
-            // and store the result in the output file.
-            //
+            for (int i = 0; i < n; ++i)
+                lines[i] = stripLine (i);
 
-            RGBAtoYCA (_yw, _width, _writeA, _tmpBuf, _tmpBuf);
-            _outputFile.writePixels (1);
+            convertScanLines (n, lines);
 
-            ++_linesConverted;
+            _stripLines = n;
+            _linesConverted += n;
+            _currentScanLine += n * dy;
 
-            if (_lineOrder == INCREASING_Y)
-                ++_currentScanLine;
-            else
-                --_currentScanLine;
+            writeStrip ();
+            continue;
         }
-    }
-    else
-    {
+
         //
-        // We are writing chroma; the pixels must be filtered and subsampled.
+        // We are writing chroma; the pixels must be filtered and
+        // subsampled.  Convert the next n scan lines from RGB to
+        // luminance/chroma, and filter and subsample their chroma
+        // channels horizontally.
         //
 
-        for (int i = 0; i < numScanLines; ++i)
-        {
-            //
-            // Copy the next scan line from the caller's
-            // frame buffer into _tmpBuf.
-            //
-
-            intptr_t base = reinterpret_cast<intptr_t> (_fbBase);
-
-            for (int j = 0; j < _width; ++j)
-            {
-                const Rgba* ptr = reinterpret_cast<const Rgba*> (
-                    base + sizeof (Rgba) * (_fbYStride * _currentScanLine +
-                                            _fbXStride * (j + _xMin)));
-                _tmpBuf[j + N2] = *ptr;
-            }
-
-            //
-            // Convert the scan line from RGB to luminance/chroma.
-            //
-
-            RGBAtoYCA (_yw, _width, _writeA, _tmpBuf + N2, _tmpBuf + N2);
-
-            //
-            // Append N2 copies of the first and last pixel to the
-            // beginning and end of the scan line.
-            //
-
-            padTmpBuf ();
+        convertScanLines (n, _converted);
 
+        for (int i = 0; i < n; ++i)
+        {
             //
-            // Filter and subsample the scan line's chroma channels
-            // horizontally; store the result in _buf.
+            // Store the converted scan line in _buf.
             //
 
             rotateBuffers ();
-            decimateChromaHoriz (_width, _tmpBuf, _buf[N - 1]);
+            swap (_buf[N - 1], _converted[i]);
 
             //
             // If this is the first scan line in the image,
@@ -444,12 +510,11 @@ RgbaOutputFile::ToYca::writePixels (int numScanLines)
                 }
             }
 
-            if (_lineOrder == INCREASING_Y)
-                ++_currentScanLine;
-            else
-                --_currentScanLine;
+            _currentScanLine += dy;
         }
     }
+
+    writeStrip ();
 }
 
 int
@@ -459,13 +524,23 @@ RgbaOutputFile::ToYca::currentScanLine () const
 }
 
 void
-RgbaOutputFile::ToYca::padTmpBuf ()
+RgbaOutputFile::ToYca::convertScanLines (int numScanLines, Rgba* const out[])
 {
-    for (int i = 0; i < N2; ++i)
-    {
-        _tmpBuf[i]               = _tmpBuf[N2];
-        _tmpBuf[_width + N2 + i] = _tmpBuf[_width + N2 - 2];
-    }
+    RgbaToYcaJob job;
+
+    job.fbBase    = _fbBase;
+    job.fbXStride = _fbXStride;
+    job.fbYStride = _fbYStride;
+    job.xMin      = _xMin;
+    job.width     = _width;
+    job.yw        = _yw;
+    job.writeA    = _writeA;
+    job.filter    = _writeC || !_writeY;
+    job.firstY    = _currentScanLine;
+    job.dy        = (_lineOrder == INCREASING_Y) ? 1 : -1;
+    job.out       = out;
+
+    processLines (job, 0, numScanLines - 1);
 }
 
 void
@@ -496,15 +571,118 @@ RgbaOutputFile::ToYca::duplicateSecondToLastBuffer ()
 void
 RgbaOutputFile::ToYca::decimateChromaVertAndWriteScanLine ()
 {
+    Rgba* line = stripLine (_stripLines);
+
     if (_linesConverted & 1)
-        memcpy (_tmpBuf, _buf[N2], _width * sizeof (Rgba));
+        memcpy (line, _buf[N2], _width * sizeof (Rgba));
+    else
+        decimateChromaVert (_width, _buf, line);
+
+    if (_writeY && _writeC) roundYCA (_width, _roundY, _roundC, line, line);
+
+    if (++_stripLines == STRIP_HEIGHT) writeStrip ();
+}
+
+Rgba*
+RgbaOutputFile::ToYca::stripLine (int i)
+{
+    //
+    // The scan lines in the strip are in order of increasing y,
+    // regardless of the file's line order.
+    //
+
+    if (_lineOrder == INCREASING_Y)
+        return _stripBase + i * _stripXSize;
     else
-        decimateChromaVert (_width, _buf, _tmpBuf);
+        return _stripBase + (STRIP_HEIGHT - 1 - i) * _stripXSize;
+}
+
+void
+RgbaOutputFile::ToYca::writeStrip ()
+{
+    if (_stripLines == 0) return;
 
-    if (_writeY && _writeC)
-        roundYCA (_width, _roundY, _roundC, _tmpBuf, _tmpBuf);
+    int   numLines = _stripLines;
+    int   yLow;
+    Rgba* lineLow;
 
-    _outputFile.writePixels (1);
+    if (_lineOrder == INCREASING_Y)
+    {
+        yLow    = _stripY;
+        lineLow = stripLine (0);
+        _stripY += numLines;
+    }
+    else
+    {
+        yLow    = _stripY - numLines + 1;
+        lineLow = stripLine (numLines - 1);
+        _stripY -= numLines;
+    }
+
+    _stripLines = 0;
+
+    //
+    // Store the strip's scan lines in the output file.  Chroma
+    // is stored only for every other scan line, whose pixels are
+    // two lines apart in the strip.
+    //
+
+    size_t    yStride = sizeof (Rgba) * _stripXSize;
+    ptrdiff_t yOffset = ptrdiff_t (yStride) * yLow;
+
+    FrameBuffer fb;
+
+    if (_writeY)
+    {
+        fb.insert (
+            "Y",
+            Slice (
+                HALF,                                  // type
+                (char*) &lineLow[-_xMin].g - yOffset, // base
+                sizeof (Rgba),                         // xStride
+                yStride,                               // yStride
+                1,                                     // xSampling
+                1));                                   // ySampling
+    }
+
+    if (_writeC)
+    {
+        fb.insert (
+            "RY",
+            Slice (
+                HALF,                                  // type
+                (char*) &lineLow[-_xMin].r - yOffset, // base
+                sizeof (Rgba) * 2,                     // xStride
+                yStride * 2,                           // yStride
+                2,                                     // xSampling
+                2));                                   // ySampling
+
+        fb.insert (
+            "BY",
+            Slice (
+                HALF,                                  // type
+                (char*) &lineLow[-_xMin].b - yOffset, // base
+                sizeof (Rgba) * 2,                     // xStride
+                yStride * 2,                           // yStride
+                2,                                     // xSampling
+                2));                                   // ySampling
+    }
+
+    if (_writeA)
+    {
+        fb.insert (
+            "A",
+            Slice (
+                HALF,                                  // type
+                (char*) &lineLow[-_xMin].a - yOffset, // base
+                sizeof (Rgba),                         // xStride
+                yStride,                               // yStride
+                1,                                     // xSampling
+                1));                                   // ySampling
+    }
+
+    _outputFile.setFrameBuffer (fb);
+    _outputFile.writePixels (numLines);
 }
 
 RgbaOutputFile::RgbaOutputFile (
@@ -736,6 +914,155 @@ RgbaOutputFile::breakScanLine (int y, int offset, int length, char c)
     _outputFile->breakScanLine (y, offset, length, c);
 }
 
+namespace
+{
+
+//
+// Jobs for reading strips of YCA scan lines, see
+// RgbaInputFile::FromYca::readStrips(), below.
+//
+// YcaHorizJob reconstructs the missing chroma samples of scan lines
+// firstY + i, stored in in[i], with N2 extra pixels at both ends,
+// and stores the result in out[i].
+//
+
+struct YcaHorizJob
+{
+    Rgba* const* in;
+    Rgba* const* out;
+    int          firstY;
+    int          width;
+    bool         readC;
+
+    void processLines (int i1, int i2) const;
+};
+
+void
+YcaHorizJob::processLines (int i1, int i2) const
+{
+    for (int i = i1; i <= i2; ++i)
+    {
+        if (!readC)
+        {
+            for (int j = 0; j < width; ++j)
+            {
+                in[i][j + N2].r = 0;
+                in[i][j + N2].b = 0;
+            }
+        }
+
+        if ((firstY + i) & 1)
+            memcpy (out[i], in[i] + N2, width * sizeof (Rgba));
+        else
+        {
+            padLine (width, in[i]);
+            reconstructChromaHoriz (width, in[i], out[i]);
+        }
+    }
+}
+
+//
+// YcaToRgbaJob converts scan lines firstY + i to RGBA, reconstructing
+// chroma vertically for odd-numbered scan lines, and stores the result
+// in out[i].  The YCA scan lines are in[y - inY]; scan lines outside
+// the data window are clamped the same way as in readYCAScanLine().
+//
+
+struct YcaToRgbaJob
+{
+    Rgba* const* in;
+    int          inY;
+    int          yMin;
+    int          yMax;
+    Rgba* const* out;
+    int          firstY;
+    int          width;
+    V3f          yw;
+
+    const Rgba* ycaLine (int y) const
+    {
+        if (y < yMin)
+            y = yMin;
+        else if (y > yMax)
+            y = yMax - 1;
+
+        return in[y - inY];
+    }
+
+    void processLines (int i1, int i2) const;
+};
+
+void
+YcaToRgbaJob::processLines (int i1, int i2) const
+{
+    for (int i = i1; i <= i2; ++i)
+    {
+        int y = firstY + i;
+
+        if ((y & 1) == 0)
+        {
+            YCAtoRGBA (yw, width, ycaLine (y), out[i]);
+        }
+        else
+        {
+            const Rgba* lines[N];
+
+            for (int k = 0; k < N; ++k)
+                lines[k] = ycaLine (y - N2 + k);
+
+            reconstructChromaVert (width, lines, out[i]);
+            YCAtoRGBA (yw, width, out[i], out[i]);
+        }
+    }
+}
+
+//
+// FixSaturationJob eliminates super-saturated pixels from scan lines
+// firstY + i, whose RGBA pixels, and those of their neighbors, are
+// in[y - inY], and stores the result in the caller's frame buffer.
+//
+
+struct FixSaturationJob
+{
+    Rgba* const* in;
+    int          inY;
+    int          firstY;
+    int          xMin;
+    int          width;
+    V3f          yw;
+    Rgba*        fbBase;
+    size_t       fbXStride;
+    size_t       fbYStride;
+
+    void processLines (int i1, int i2) const;
+};
+
+void
+FixSaturationJob::processLines (int i1, int i2) const
+{
+    Array<Rgba> tmpBuf (width);
+    intptr_t    base = reinterpret_cast<intptr_t> (fbBase);
+
+    for (int i = i1; i <= i2; ++i)
+    {
+        int         y        = firstY + i;
+        const Rgba* lines[3] = {
+            in[y - 1 - inY], in[y - inY], in[y + 1 - inY]};
+
+        fixSaturation (yw, width, lines, tmpBuf);
+
+        for (int j = 0; j < width; ++j)
+        {
+            Rgba* ptr = reinterpret_cast<Rgba*> (
+                base +
+                sizeof (Rgba) * (fbYStride * y + fbXStride * (j + xMin)));
+            *ptr = tmpBuf[j];
+        }
+    }
+}
+
+} // namespace
+
 class RgbaInputFile::FromYca : public std::mutex
 {
 public:
@@ -757,10 +1084,11 @@ public:
 
 private:
     void readPixels (int scanLine);
+    void readStrips (int minY, int maxY);
     void rotateBuf1 (int d);
     void rotateBuf2 (int d);
     void readYCAScanLine (int y, Rgba buf[]);
-    void padTmpBuf ();
+    void setPartFrameBuffer (Rgba buf[], int y, size_t yStride);
 
     InputPart& _inputPart;
     bool       _readC;
@@ -779,6 +1107,7 @@ private:
     Rgba*      _fbBase;
     size_t     _fbXStride;
     size_t     _fbYStride;
+    string     _channelNamePrefix;
 };
 
 RgbaInputFile::FromYca::FromYca (
@@ -827,69 +1156,114 @@ RgbaInputFile::FromYca::setFrameBuffer (
 {
     if (_fbBase == 0)
     {
-        FrameBuffer fb;
+        _channelNamePrefix = channelNamePrefix;
+        setPartFrameBuffer (_tmpBuf, 0, 0);
+    }
 
+    _fbBase    = base;
+    _fbXStride = xStride;
+    _fbYStride = yStride;
+}
+
+void
+RgbaInputFile::FromYca::setPartFrameBuffer (Rgba buf[], int y, size_t yStride)
+{
+    //
+    // Set up the input part's frame buffer so that pixel (x, y)
+    // is read into buf[N2 + x - _xMin], and pixel (x, y + i) into
+    // the pixel that is yStride bytes after pixel (x, y + i - 1).
+    //
+
+    ptrdiff_t yOffset = ptrdiff_t (yStride) * y;
+
+    FrameBuffer fb;
+
+    fb.insert (
+        _channelNamePrefix + "Y",
+        Slice (
+            HALF,                                     // type
+            (char*) &buf[N2 - _xMin].g - yOffset,     // base
+            sizeof (Rgba),                            // xStride
+            yStride,                                  // yStride
+            1,                                        // xSampling
+            1,                                        // ySampling
+            0.5));                                    // fillValue
+
+    if (_readC)
+    {
         fb.insert (
-            channelNamePrefix + "Y",
+            _channelNamePrefix + "RY",
             Slice (
-                HALF,                           // type
-                (char*) &_tmpBuf[N2 - _xMin].g, // base
-                sizeof (Rgba),                  // xStride
-                0,                              // yStride
-                1,                              // xSampling
-                1,                              // ySampling
-                0.5));                          // fillValue
-
-        if (_readC)
-        {
-            fb.insert (
-                channelNamePrefix + "RY",
-                Slice (
-                    HALF,                           // type
-                    (char*) &_tmpBuf[N2 - _xMin].r, // base
-                    sizeof (Rgba) * 2,              // xStride
-                    0,                              // yStride
-                    2,                              // xSampling
-                    2,                              // ySampling
-                    0.0));                          // fillValue
-
-            fb.insert (
-                channelNamePrefix + "BY",
-                Slice (
-                    HALF,                           // type
-                    (char*) &_tmpBuf[N2 - _xMin].b, // base
-                    sizeof (Rgba) * 2,              // xStride
-                    0,                              // yStride
-                    2,                              // xSampling
-                    2,                              // ySampling
-                    0.0));                          // fillValue
-        }
+                HALF,                                 // type
+                (char*) &buf[N2 - _xMin].r - yOffset, // base
+                sizeof (Rgba) * 2,                    // xStride
+                yStride * 2,                          // yStride
+                2,                                    // xSampling
+                2,                                    // ySampling
+                0.0));                                // fillValue
 
         fb.insert (
-            channelNamePrefix + "A",
+            _channelNamePrefix + "BY",
             Slice (
-                HALF,                           // type
-                (char*) &_tmpBuf[N2 - _xMin].a, // base
-                sizeof (Rgba),                  // xStride
-                0,                              // yStride
-                1,                              // xSampling
-                1,                              // ySampling
-                1.0));                          // fillValue
-
-        _inputPart.setFrameBuffer (fb);
+                HALF,                                 // type
+                (char*) &buf[N2 - _xMin].b - yOffset, // base
+                sizeof (Rgba) * 2,                    // xStride
+                yStride * 2,                          // yStride
+                2,                                    // xSampling
+                2,                                    // ySampling
+                0.0));                                // fillValue
     }
 
-    _fbBase    = base;
-    _fbXStride = xStride;
-    _fbYStride = yStride;
+    fb.insert (
+        _channelNamePrefix + "A",
+        Slice (
+            HALF,                                     // type
+            (char*) &buf[N2 - _xMin].a - yOffset,     // base
+            sizeof (Rgba),                            // xStride
+            yStride,                                  // yStride
+            1,                                        // xSampling
+            1,                                        // ySampling
+            1.0));                                    // fillValue
+
+    _inputPart.setFrameBuffer (fb);
 }
 
 void
 RgbaInputFile::FromYca::readPixels (int scanLine1, int scanLine2)
 {
+    if (_fbBase == 0)
+    {
+        THROW (
+            IEX_NAMESPACE::ArgExc,
+            "No frame buffer was specified as the "
+            "pixel data destination for image file "
+            "\"" << _inputPart.fileName ()
+                 << "\".");
+    }
+
     int minY = min (scanLine1, scanLine2);
     int maxY = max (scanLine1, scanLine2);
 
+    //
+    // Large ranges of scan lines inside the data window are read
+    // in strips.  readStrips() produces the same pixels as reading
+    // one scan line at a time, except if the clamped scan lines at
+    // the top or bottom of the data window lack chroma (see
+    // readYCAScanLine(), below).  This cannot happen if chroma is
+    // not read, or if the first scan line in the data window is
+    // even, and the last one is odd.
+    //
+
+    bool stripsOk = _readC ? ((_yMin & 1) == 0 && (_yMax & 1) != 0)
+                           : (_yMin < _yMax);
+
+    if (stripsOk && minY >= _yMin && maxY <= _yMax &&
+        maxY - minY >= STRIP_HEIGHT)
+    {
+        readStrips (minY, maxY);
+        return;
+    }
+
     if (_lineOrder == INCREASING_Y)
     {
         for (int y = minY; y <= maxY; ++y)
@@ -903,18 +1277,153 @@ RgbaInputFile::FromYca::readPixels (int scanLine1, int scanLine2)
 }
 
 void
-RgbaInputFile::FromYca::readPixels (int scanLine)
+RgbaInputFile::FromYca::readStrips (int minY, int maxY)
 {
-    if (_fbBase == 0)
+    //
+    // Read scan lines minY through maxY in strips of STRIP_HEIGHT
+    // scan lines.  Converting a strip to RGBA requires the YCA data
+    // of N2 + 1 additional scan lines above and below the strip.
+    // The YCA scan lines are kept in a window, ycaLines, from one
+    // strip to the next, so that every scan line is read only once.
+    //
+    // The scan lines of each strip are read from the file with a
+    // single call to readPixels(), and converted to RGBA in parallel.
+    //
+
+    const int maxLines = STRIP_HEIGHT + N + 1;
+    const int xSize    = _width + N - 1;
+
+    Array<Rgba> rawBuf (maxLines * xSize);
+    Array<Rgba> ycaBuf (maxLines * xSize);
+    Array<Rgba> rgbaBuf ((STRIP_HEIGHT + 2) * xSize);
+
+    memset (rawBuf, 0, maxLines * xSize * sizeof (Rgba));
+
+    vector<Rgba*> rawLines (maxLines);
+    vector<Rgba*> ycaLines (maxLines);
+    vector<Rgba*> rgbaLines (STRIP_HEIGHT + 2);
+
+    for (int i = 0; i < maxLines; ++i)
     {
-        THROW (
-            IEX_NAMESPACE::ArgExc,
-            "No frame buffer was specified as the "
-            "pixel data destination for image file "
-            "\"" << _inputPart.fileName ()
-                 << "\".");
+        rawLines[i] = rawBuf + i * xSize;
+        ycaLines[i] = ycaBuf + i * xSize;
     }
 
+    for (int i = 0; i < STRIP_HEIGHT + 2; ++i)
+        rgbaLines[i] = rgbaBuf + i * xSize;
+
+    //
+    // The window holds YCA scan lines ycaY through ycaY + numYca - 1.
+    //
+
+    int ycaY   = _yMin;
+    int numYca = 0;
+
+    try
+    {
+        for (int y1 = minY; y1 <= maxY; y1 += STRIP_HEIGHT)
+        {
+            int y2 = min (maxY, y1 + STRIP_HEIGHT - 1);
+            int lo = max (_yMin, y1 - N2 - 1);
+            int hi = min (_yMax, y2 + N2 + 1);
+
+            //
+            // Drop the scan lines that are no longer needed
+            // from the window.
+            //
+
+            if (lo < ycaY + numYca)
+            {
+                rotate (
+                    ycaLines.begin (),
+                    ycaLines.begin () + (lo - ycaY),
+                    ycaLines.end ());
+
+                numYca -= lo - ycaY;
+            }
+            else
+            {
+                numYca = 0;
+            }
+
+            ycaY = lo;
+
+            //
+            // Read the missing scan lines, and reconstruct
+            // their chroma horizontally.
+            //
+
+            int first = ycaY + numYca;
+
+            if (first <= hi)
+            {
+                setPartFrameBuffer (
+                    rawLines[0], first, xSize * sizeof (Rgba));
+
+                _inputPart.readPixels (first, hi);
+
+                YcaHorizJob job;
+                job.in     = &rawLines[0];
+                job.out    = &ycaLines[numYca];
+                job.firstY = first;
+                job.width  = _width;
+                job.readC  = _readC;
+
+                processLines (job, 0, hi - first);
+                numYca += hi - first + 1;
+            }
+
+            //
+            // Convert the strip and its two neighboring scan lines
+            // to RGBA, and eliminate super-saturated pixels.
+            //
+
+            YcaToRgbaJob rgbaJob;
+            rgbaJob.in     = &ycaLines[0];
+            rgbaJob.inY    = ycaY;
+            rgbaJob.yMin   = _yMin;
+            rgbaJob.yMax   = _yMax;
+            rgbaJob.out    = &rgbaLines[0];
+            rgbaJob.firstY = y1 - 1;
+            rgbaJob.width  = _width;
+            rgbaJob.yw     = _yw;
+
+            processLines (rgbaJob, 0, y2 - y1 + 2);
+
+            FixSaturationJob fixJob;
+            fixJob.in        = &rgbaLines[0];
+            fixJob.inY       = y1 - 1;
+            fixJob.firstY    = y1;
+            fixJob.xMin      = _xMin;
+            fixJob.width     = _width;
+            fixJob.yw        = _yw;
+            fixJob.fbBase    = _fbBase;
+            fixJob.fbXStride = _fbXStride;
+            fixJob.fbYStride = _fbYStride;
+
+            processLines (fixJob, 0, y2 - y1);
+        }
+    }
+    catch (...)
+    {
+        setPartFrameBuffer (_tmpBuf, 0, 0);
+        _currentScanLine = _yMin - N - 2;
+        throw;
+    }
+
+    //
+    // Restore the frame buffer for reading single scan lines.
+    // _buf1 and _buf2 no longer match _currentScanLine; start
+    // over with the next call to readPixels().
+    //
+
+    setPartFrameBuffer (_tmpBuf, 0, 0);
+    _currentScanLine = _yMin - N - 2;
+}
+
+void
+RgbaInputFile::FromYca::readPixels (int scanLine)
+{
     //
     // In order to convert one scan line to RGB format, we need that
     // scan line plus N2+1 extra scan lines above and N2+1 scan lines
@@ -1081,21 +1590,11 @@ RgbaInputFile::FromYca::readYCAScanLine (int y, Rgba* buf)
     if (y & 1) { memcpy (buf, _tmpBuf + N2, _width * sizeof (Rgba)); }
     else
     {
-        padTmpBuf ();
+        padLine (_width, _tmpBuf);
         reconstructChromaHoriz (_width, _tmpBuf, buf);
     }
 }
 
-void
-RgbaInputFile::FromYca::padTmpBuf ()
-{
-    for (int i = 0; i < N2; ++i)
-    {
-        _tmpBuf[i]               = _tmpBuf[N2];
-        _tmpBuf[_width + N2 + i] = _tmpBuf[_width + N2 - 2];
-    }
-}
-
 RgbaInputFile::RgbaInputFile (const char name[], int numThreads)
     : RgbaInputFile (0, name, numThreads)
 {}
@@ -9,6 +9,7 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "ImfSimd.h"
 #include <ImfRgbaYca.h>
 #include <algorithm>
 #include <assert.h>
@@ -29,68 +30,800 @@ computeYw (const Chromaticities& cr)
     return V3f (m[0][1], m[1][1], m[2][1]) / (m[0][1] + m[1][1] + m[2][1]);
 }
 
-void
-RGBAtoYCA (
-    const V3f& yw,
-    int        n,
-    bool       aIsValid,
-    const Rgba rgbaIn[/*n*/],
-    Rgba       ycaOut[/*n*/])
+namespace
 {
-    for (int i = 0; i < n; ++i)
+
+//
+// Taps of the chroma subsampling and reconstruction filters.
+// Tap k multiplies input pixel (or scan line) offset[k], where
+// offset N2 is the center of the filter.  Both filters use every
+// other input pixel; the subsampling filter also uses the center.
+//
+
+const int numDecimateTaps = 15;
+
+const int decimateOffset[numDecimateTaps] = {
+    0, 2, 4, 6, 8, 10, 12, 13, 14, 16, 18, 20, 22, 24, 26};
+
+const float decimateTap[numDecimateTaps] = {
+    0.001064f,
+    -0.003771f,
+    0.009801f,
+    -0.021586f,
+    0.043978f,
+    -0.093067f,
+    0.313659f,
+    0.499846f,
+    0.313659f,
+    -0.093067f,
+    0.043978f,
+    -0.021586f,
+    0.009801f,
+    -0.003771f,
+    0.001064f};
+
+const int numReconstructTaps = 14;
+
+const int reconstructOffset[numReconstructTaps] = {
+    0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26};
+
+const float reconstructTap[numReconstructTaps] = {
+    0.002128f,
+    -0.007540f,
+    0.019597f,
+    -0.043159f,
+    0.087929f,
+    -0.186077f,
+    0.627123f,
+    0.627123f,
+    -0.186077f,
+    0.087929f,
+    -0.043159f,
+    0.019597f,
+    -0.007540f,
+    0.002128f};
+
+//
+// Scalar filters for a single pixel.  The taps are summed from
+// left to right in float; the vectorized filters below sum in the
+// same order, so that both produce the same results.
+//
+
+inline void
+filterHoriz (
+    int         numTaps,
+    const int   offset[],
+    const float tap[],
+    const Rgba  in[],
+    Rgba&       out)
+{
+    float r = in[offset[0]].r * tap[0];
+    float b = in[offset[0]].b * tap[0];
+
+    for (int k = 1; k < numTaps; ++k)
+    {
+        r += in[offset[k]].r * tap[k];
+        b += in[offset[k]].b * tap[k];
+    }
+
+    out.r = r;
+    out.b = b;
+}
+
+inline void
+filterVert (
+    int               numTaps,
+    const int         offset[],
+    const float       tap[],
+    const Rgba* const in[],
+    int               i,
+    Rgba&             out)
+{
+    float r = in[offset[0]][i].r * tap[0];
+    float b = in[offset[0]][i].b * tap[0];
+
+    for (int k = 1; k < numTaps; ++k)
+    {
+        r += in[offset[k]][i].r * tap[k];
+        b += in[offset[k]][i].b * tap[k];
+    }
+
+    out.r = r;
+    out.b = b;
+}
+
+inline void
+RGBAtoYCA (const V3f& yw, bool aIsValid, Rgba in, Rgba& out)
+{
+    //
+    // Conversion to YCA and subsequent chroma subsampling
+    // work only if R, G and B are finite and non-negative.
+    //
+
+    if (!in.r.isFinite () || in.r < 0) in.r = 0;
+
+    if (!in.g.isFinite () || in.g < 0) in.g = 0;
+
+    if (!in.b.isFinite () || in.b < 0) in.b = 0;
+
+    if (in.r == in.g && in.g == in.b)
+    {
+        //
+        // Special case -- R, G and B are equal. To avoid rounding
+        // errors, we explicitly set the output luminance channel
+        // to G, and the chroma channels to 0.
+        //
+        // The special cases here and in YCAtoRGBA() ensure that
+        // converting black-and white images from RGBA to YCA and
+        // back is lossless.
+        //
+
+        out.r = 0;
+        out.g = in.g;
+        out.b = 0;
+    }
+    else
     {
-        Rgba  in  = rgbaIn[i];
-        Rgba& out = ycaOut[i];
+        out.g = in.r * yw.x + in.g * yw.y + in.b * yw.z;
 
+        float Y = out.g;
+
+        if (abs (in.r - Y) < HALF_MAX * Y)
+            out.r = (in.r - Y) / Y;
+        else
+            out.r = 0;
+
+        if (abs (in.b - Y) < HALF_MAX * Y)
+            out.b = (in.b - Y) / Y;
+        else
+            out.b = 0;
+    }
+
+    if (aIsValid)
+        out.a = in.a;
+    else
+        out.a = 1;
+}
+
+inline void
+YCAtoRGBA (const V3f& yw, const Rgba& in, Rgba& out)
+{
+    if (in.r == 0 && in.b == 0)
+    {
+        //
+        // Special case -- both chroma channels are 0.  To avoid
+        // rounding errors, we explicitly set the output R, G and B
+        // channels equal to the input luminance.
         //
-        // Conversion to YCA and subsequent chroma subsampling
-        // work only if R, G and B are finite and non-negative.
+        // The special cases here and in RGBAtoYCA() ensure that
+        // converting black-and white images from RGBA to YCA and
+        // back is lossless.
         //
 
-        if (!in.r.isFinite () || in.r < 0) in.r = 0;
+        out.r = in.g;
+        out.g = in.g;
+        out.b = in.g;
+        out.a = in.a;
+    }
+    else
+    {
+        float Y = in.g;
+        float r = (in.r + 1) * Y;
+        float b = (in.b + 1) * Y;
+        float g = (Y - r * yw.x - b * yw.z) / yw.y;
+
+        out.r = r;
+        out.g = g;
+        out.b = b;
+        out.a = in.a;
+    }
+}
+
+#ifdef IMF_HAVE_SSE2
+
+//
+// Vectorized versions of the conversions and filters, for SSE2.
+// They process four pixels at a time, and return bit-for-bit the
+// same results as the scalar code, which handles the remaining
+// pixels at the end of each scan line.
+//
+
+//
+// Conversion between halfs, stored in the low 16 bits of 32-bit
+// integers, and floats, four at a time.  The results are the same
+// as those of the half class's conversions, including rounding,
+// denormals, infinities and NaNs.
+//
+
+inline __m128
+halfToFloat4 (__m128i h)
+{
+    const __m128i expMant = _mm_and_si128 (h, _mm_set1_epi32 (0x7fff));
+    const __m128i sign    = _mm_slli_epi32 (_mm_xor_si128 (h, expMant), 16);
+
+    //
+    // Shift the exponent and significand into place, and correct the
+    // exponent bias, with integer arithmetic.  Infinities and NaNs need
+    // their exponent set to all ones.
+    //
+
+    const __m128i infNan = _mm_cmpgt_epi32 (expMant, _mm_set1_epi32 (0x7bff));
+
+    const __m128i normal = _mm_add_epi32 (
+        _mm_slli_epi32 (expMant, 13),
+        _mm_add_epi32 (
+            _mm_set1_epi32 (0x38000000),
+            _mm_and_si128 (infNan, _mm_set1_epi32 (0x38000000))));
+
+    //
+    // Zeroes and denormals are their significand times 2^-24.  The
+    // integer to float conversion and the multiplication are exact,
+    // and never produce a float denormal, so the result does not
+    // depend on the DAZ and FTZ modes of the floating-point unit.
+    //
+
+    const __m128i denormal = _mm_castps_si128 (_mm_mul_ps (
+        _mm_cvtepi32_ps (expMant), _mm_set1_ps (5.9604644775390625e-8f)));
+
+    const __m128i isDenormal =
+        _mm_cmplt_epi32 (expMant, _mm_set1_epi32 (0x0400));
+
+    return _mm_castsi128_ps (_mm_or_si128 (
+        sign,
+        _mm_or_si128 (
+            _mm_and_si128 (isDenormal, denormal),
+            _mm_andnot_si128 (isDenormal, normal))));
+}
+
+inline __m128i
+select4 (__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128 (_mm_and_si128 (mask, a), _mm_andnot_si128 (mask, b));
+}
+
+inline __m128i
+floatToHalf4 (__m128 f)
+{
+    const __m128i bits = _mm_castps_si128 (f);
+    const __m128i ui   = _mm_and_si128 (bits, _mm_set1_epi32 (0x7fffffff));
+
+    const __m128i sign =
+        _mm_and_si128 (_mm_srli_epi32 (bits, 16), _mm_set1_epi32 (0x8000));
+
+    //
+    // Normalized results: rebias the exponent, and round the
+    // significand to the nearest even value.
+    //
+
+    __m128i normal = _mm_sub_epi32 (ui, _mm_set1_epi32 (0x38000000));
+
+    normal = _mm_add_epi32 (
+        _mm_add_epi32 (normal, _mm_set1_epi32 (0xfff)),
+        _mm_and_si128 (_mm_srli_epi32 (ui, 13), _mm_set1_epi32 (1)));
+
+    normal = _mm_srli_epi32 (normal, 13);
+
+    //
+    // Denormalized results: adding 0.5 shifts the significand so
+    // that its last bit is the half's least significant bit, and
+    // lets the floating-point unit round to the nearest even value.
+    //
 
-        if (!in.g.isFinite () || in.g < 0) in.g = 0;
+    const __m128i denormal = _mm_sub_epi32 (
+        _mm_castps_si128 (
+            _mm_add_ps (_mm_castsi128_ps (ui), _mm_set1_ps (0.5f))),
+        _mm_set1_epi32 (0x3f000000));
 
-        if (!in.b.isFinite () || in.b < 0) in.b = 0;
+    //
+    // NaNs keep the upper bits of their significand, and remain NaNs.
+    //
 
-        if (in.r == in.g && in.g == in.b)
+    const __m128i nanMant =
+        _mm_srli_epi32 (_mm_and_si128 (ui, _mm_set1_epi32 (0x7fffff)), 13);
+
+    const __m128i nan = _mm_or_si128 (
+        _mm_or_si128 (nanMant, _mm_set1_epi32 (0x7c00)),
+        _mm_and_si128 (
+            _mm_cmpeq_epi32 (nanMant, _mm_setzero_si128 ()),
+            _mm_set1_epi32 (1)));
+
+    __m128i h = select4 (
+        _mm_cmpgt_epi32 (ui, _mm_set1_epi32 (0x387fffff)), normal, denormal);
+
+    h = select4 (
+        _mm_cmpgt_epi32 (ui, _mm_set1_epi32 (0x477fefff)),
+        _mm_set1_epi32 (0x7c00),
+        h);
+
+    h = select4 (_mm_cmpgt_epi32 (ui, _mm_set1_epi32 (0x7f800000)), nan, h);
+
+    return _mm_or_si128 (h, sign);
+}
+
+//
+// splitRgba4() separates the channels of four pixels, p0 p1 in
+// vector p01 and p2 p3 in vector p23, into one vector per channel.
+// mergeRgba4() does the opposite.
+//
+
+inline void
+splitRgba4 (
+    __m128i  p01,
+    __m128i  p23,
+    __m128i& r,
+    __m128i& g,
+    __m128i& b,
+    __m128i& a)
+{
+    const __m128i t0   = _mm_unpacklo_epi16 (p01, p23); // r0 r2 g0 g2 ...
+    const __m128i t1   = _mm_unpackhi_epi16 (p01, p23); // r1 r3 g1 g3 ...
+    const __m128i rg   = _mm_unpacklo_epi16 (t0, t1);   // r0 r1 r2 r3 g0 ...
+    const __m128i ba   = _mm_unpackhi_epi16 (t0, t1);   // b0 b1 b2 b3 a0 ...
+    const __m128i zero = _mm_setzero_si128 ();
+
+    r = _mm_unpacklo_epi16 (rg, zero);
+    g = _mm_unpackhi_epi16 (rg, zero);
+    b = _mm_unpacklo_epi16 (ba, zero);
+    a = _mm_unpackhi_epi16 (ba, zero);
+}
+
+inline __m128i
+pack4 (__m128i lo, __m128i hi)
+{
+    //
+    // Sign-extend the 16-bit values, so that packing does not saturate
+    //
+
+    return _mm_packs_epi32 (
+        _mm_srai_epi32 (_mm_slli_epi32 (lo, 16), 16),
+        _mm_srai_epi32 (_mm_slli_epi32 (hi, 16), 16));
+}
+
+inline void
+mergeRgba4 (
+    __m128i  r,
+    __m128i  g,
+    __m128i  b,
+    __m128i  a,
+    __m128i& p01,
+    __m128i& p23)
+{
+    const __m128i rg = pack4 (r, g);
+    const __m128i ba = pack4 (b, a);
+    const __m128i t0 = _mm_unpacklo_epi16 (rg, ba); // r0 b0 r1 b1 ...
+    const __m128i t1 = _mm_unpackhi_epi16 (rg, ba); // g0 a0 g1 a1 ...
+
+    p01 = _mm_unpacklo_epi16 (t0, t1);
+    p23 = _mm_unpackhi_epi16 (t0, t1);
+}
+
+inline void
+loadRgba4 (
+    const Rgba* p, __m128i& r, __m128i& g, __m128i& b, __m128i& a)
+{
+    splitRgba4 (
+        _mm_loadu_si128 ((const __m128i*) p),
+        _mm_loadu_si128 ((const __m128i*) (p + 2)),
+        r,
+        g,
+        b,
+        a);
+}
+
+inline void
+storeRgba4 (Rgba* p, __m128i r, __m128i g, __m128i b, __m128i a)
+{
+    __m128i p01, p23;
+    mergeRgba4 (r, g, b, a, p01, p23);
+    _mm_storeu_si128 ((__m128i*) p, p01);
+    _mm_storeu_si128 ((__m128i*) (p + 2), p23);
+}
+
+//
+// Load the even-numbered pixels, p[0], p[2], p[4] and p[6],
+// and the odd-numbered pixels, p[1], p[3], p[5] and p[7].
+//
+
+inline void
+loadEvenOdd8 (
+    const Rgba* p,
+    __m128i&    evenR,
+    __m128i&    evenB,
+    __m128i&    oddR,
+    __m128i&    oddB)
+{
+    const __m128i p01 = _mm_loadu_si128 ((const __m128i*) p);
+    const __m128i p23 = _mm_loadu_si128 ((const __m128i*) (p + 2));
+    const __m128i p45 = _mm_loadu_si128 ((const __m128i*) (p + 4));
+    const __m128i p67 = _mm_loadu_si128 ((const __m128i*) (p + 6));
+
+    __m128i g, a;
+
+    splitRgba4 (
+        _mm_unpacklo_epi64 (p01, p23),
+        _mm_unpacklo_epi64 (p45, p67),
+        evenR,
+        g,
+        evenB,
+        a);
+
+    splitRgba4 (
+        _mm_unpackhi_epi64 (p01, p23),
+        _mm_unpackhi_epi64 (p45, p67),
+        oddR,
+        g,
+        oddB,
+        a);
+}
+
+inline __m128
+positiveFinite4 (__m128 x)
+{
+    const __m128 inf = _mm_castsi128_ps (_mm_set1_epi32 (0x7f800000));
+
+    const __m128 mask =
+        _mm_and_ps (_mm_cmpge_ps (x, _mm_setzero_ps ()), _mm_cmplt_ps (x, inf));
+
+    return _mm_and_ps (x, mask);
+}
+
+inline __m128
+abs4 (__m128 x)
+{
+    return _mm_and_ps (x, _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff)));
+}
+
+int
+RGBAtoYCA4 (
+    const V3f& yw, int n, bool aIsValid, const Rgba rgbaIn[], Rgba ycaOut[])
+{
+    const __m128  ywx     = _mm_set1_ps (yw.x);
+    const __m128  ywy     = _mm_set1_ps (yw.y);
+    const __m128  ywz     = _mm_set1_ps (yw.z);
+    const __m128  halfMax = _mm_set1_ps (HALF_MAX);
+    const __m128i one     = _mm_set1_epi32 (0x3c00);
+
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i hr, hg, hb, ha;
+        loadRgba4 (rgbaIn + i, hr, hg, hb, ha);
+
+        const __m128 r = positiveFinite4 (halfToFloat4 (hr));
+        const __m128 g = positiveFinite4 (halfToFloat4 (hg));
+        const __m128 b = positiveFinite4 (halfToFloat4 (hb));
+
+        const __m128i gray = _mm_castps_si128 (
+            _mm_and_ps (_mm_cmpeq_ps (r, g), _mm_cmpeq_ps (g, b)));
+
+        const __m128i hy = floatToHalf4 (_mm_add_ps (
+            _mm_add_ps (_mm_mul_ps (r, ywx), _mm_mul_ps (g, ywy)),
+            _mm_mul_ps (b, ywz)));
+
+        const __m128 Y     = halfToFloat4 (hy);
+        const __m128 limit = _mm_mul_ps (halfMax, Y);
+        const __m128 ry    = _mm_sub_ps (r, Y);
+        const __m128 by    = _mm_sub_ps (b, Y);
+
+        const __m128i cr = _mm_and_si128 (
+            floatToHalf4 (_mm_div_ps (ry, Y)),
+            _mm_castps_si128 (_mm_cmplt_ps (abs4 (ry), limit)));
+
+        const __m128i cb = _mm_and_si128 (
+            floatToHalf4 (_mm_div_ps (by, Y)),
+            _mm_castps_si128 (_mm_cmplt_ps (abs4 (by), limit)));
+
+        storeRgba4 (
+            ycaOut + i,
+            _mm_andnot_si128 (gray, cr),
+            select4 (gray, floatToHalf4 (g), hy),
+            _mm_andnot_si128 (gray, cb),
+            aIsValid ? ha : one);
+    }
+
+    return i;
+}
+
+int
+YCAtoRGBA4 (const V3f& yw, int n, const Rgba ycaIn[], Rgba rgbaOut[])
+{
+    const __m128 ywx = _mm_set1_ps (yw.x);
+    const __m128 ywy = _mm_set1_ps (yw.y);
+    const __m128 ywz = _mm_set1_ps (yw.z);
+    const __m128 one = _mm_set1_ps (1);
+
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i hcr, hy, hcb, ha;
+        loadRgba4 (ycaIn + i, hcr, hy, hcb, ha);
+
+        const __m128 cr = halfToFloat4 (hcr);
+        const __m128 cb = halfToFloat4 (hcb);
+        const __m128 Y  = halfToFloat4 (hy);
+
+        const __m128i gray = _mm_castps_si128 (_mm_and_ps (
+            _mm_cmpeq_ps (cr, _mm_setzero_ps ()),
+            _mm_cmpeq_ps (cb, _mm_setzero_ps ())));
+
+        const __m128 r = _mm_mul_ps (_mm_add_ps (cr, one), Y);
+        const __m128 b = _mm_mul_ps (_mm_add_ps (cb, one), Y);
+
+        const __m128 g = _mm_div_ps (
+            _mm_sub_ps (
+                _mm_sub_ps (Y, _mm_mul_ps (r, ywx)), _mm_mul_ps (b, ywz)),
+            ywy);
+
+        storeRgba4 (
+            rgbaOut + i,
+            select4 (gray, hy, floatToHalf4 (r)),
+            select4 (gray, hy, floatToHalf4 (g)),
+            select4 (gray, hy, floatToHalf4 (b)),
+            ha);
+    }
+
+    return i;
+}
+
+//
+// Horizontal filtering works on chunks of a scan line, whose chroma
+// values are converted to float once, split into even and odd pixels,
+// so that four consecutive outputs of the filter, which all have the
+// same parity, read four consecutive floats for each tap.
+//
+
+const int chunkSize = 256;
+
+struct ChromaChunk
+{
+    float r[2][(chunkSize + N) / 2 + 4];
+    float b[2][(chunkSize + N) / 2 + 4];
+
+    //
+    // Convert the chroma of pixels in[0] ... in[n-1]
+    //
+
+    void load (int n, const Rgba in[])
+    {
+        int k = 0;
+
+        for (; 2 * k + 8 <= n; k += 4)
         {
-            //
-            // Special case -- R, G and B are equal. To avoid rounding
-            // errors, we explicitly set the output luminance channel
-            // to G, and the chroma channels to 0.
-            //
-            // The special cases here and in YCAtoRGBA() ensure that
-            // converting black-and white images from RGBA to YCA and
-            // back is lossless.
-            //
+            __m128i evenR, evenB, oddR, oddB;
+            loadEvenOdd8 (in + 2 * k, evenR, evenB, oddR, oddB);
 
-            out.r = 0;
-            out.g = in.g;
-            out.b = 0;
+            _mm_storeu_ps (r[0] + k, halfToFloat4 (evenR));
+            _mm_storeu_ps (b[0] + k, halfToFloat4 (evenB));
+            _mm_storeu_ps (r[1] + k, halfToFloat4 (oddR));
+            _mm_storeu_ps (b[1] + k, halfToFloat4 (oddB));
         }
-        else
+
+        for (int i = 2 * k; i < n; ++i)
         {
-            out.g = in.r * yw.x + in.g * yw.y + in.b * yw.z;
+            r[i & 1][i / 2] = in[i].r;
+            b[i & 1][i / 2] = in[i].b;
+        }
+    }
 
-            float Y = out.g;
+    //
+    // Filter the chroma of pixels 2*q + parity ... 2*(q+3) + parity,
+    // and store the results in out[0], out[2], out[4] and out[6].
+    //
 
-            if (abs (in.r - Y) < HALF_MAX * Y)
-                out.r = (in.r - Y) / Y;
-            else
-                out.r = 0;
+    void filter (
+        int         numTaps,
+        const int   offset[],
+        const float tap[],
+        int         q,
+        int         parity,
+        Rgba        out[]) const
+    {
+        __m128 fr = _mm_setzero_ps ();
+        __m128 fb = _mm_setzero_ps ();
 
-            if (abs (in.b - Y) < HALF_MAX * Y)
-                out.b = (in.b - Y) / Y;
-            else
-                out.b = 0;
+        for (int k = 0; k < numTaps; ++k)
+        {
+            const int    p = parity + offset[k];
+            const __m128 t = _mm_set1_ps (tap[k]);
+
+            const __m128 tr =
+                _mm_mul_ps (_mm_loadu_ps (r[p & 1] + q + p / 2), t);
+
+            const __m128 tb =
+                _mm_mul_ps (_mm_loadu_ps (b[p & 1] + q + p / 2), t);
+
+            fr = k ? _mm_add_ps (fr, tr) : tr;
+            fb = k ? _mm_add_ps (fb, tb) : tb;
         }
 
-        if (aIsValid)
-            out.a = in.a;
-        else
-            out.a = 1;
+        storeChroma4 (floatToHalf4 (fr), floatToHalf4 (fb), out);
     }
+
+    static void storeChroma4 (__m128i hr, __m128i hb, Rgba out[])
+    {
+        int rBits[4], bBits[4];
+        _mm_storeu_si128 ((__m128i*) rBits, hr);
+        _mm_storeu_si128 ((__m128i*) bBits, hb);
+
+        for (int l = 0; l < 4; ++l)
+        {
+            out[2 * l].r.setBits (rBits[l]);
+            out[2 * l].b.setBits (bBits[l]);
+        }
+    }
+};
+
+//
+// decimateChromaHoriz4() and reconstructChromaHoriz4() process
+// the first pixels of the scan line, in multiples of eight, and
+// return the number of pixels they processed.
+//
+
+int
+decimateChromaHoriz4 (int n, const Rgba ycaIn[], Rgba ycaOut[])
+{
+    ChromaChunk chunk;
+    int         j0 = 0;
+
+    while (j0 < n)
+    {
+        const int m = min (chunkSize, (n - j0) & ~7);
+
+        if (m == 0) break;
+
+        chunk.load (m + N - 1, ycaIn + j0);
+
+        for (int q = 0; q < m / 2; q += 4)
+        {
+            chunk.filter (
+                numDecimateTaps,
+                decimateOffset,
+                decimateTap,
+                q,
+                0,
+                ycaOut + j0 + 2 * q);
+        }
+
+        for (int j = j0; j < j0 + m; ++j)
+        {
+            ycaOut[j].g = ycaIn[j + N2].g;
+            ycaOut[j].a = ycaIn[j + N2].a;
+        }
+
+        j0 += m;
+    }
+
+    return j0;
+}
+
+int
+reconstructChromaHoriz4 (int n, const Rgba ycaIn[], Rgba ycaOut[])
+{
+    ChromaChunk chunk;
+    int         j0 = 0;
+
+    while (j0 < n)
+    {
+        const int m = min (chunkSize, (n - j0) & ~7);
+
+        if (m == 0) break;
+
+        chunk.load (m + N - 1, ycaIn + j0);
+
+        for (int j = j0; j < j0 + m; j += 2)
+        {
+            ycaOut[j]       = ycaIn[j + N2];
+            ycaOut[j + 1].g = ycaIn[j + 1 + N2].g;
+            ycaOut[j + 1].a = ycaIn[j + 1 + N2].a;
+        }
+
+        for (int q = 0; q < m / 2; q += 4)
+        {
+            chunk.filter (
+                numReconstructTaps,
+                reconstructOffset,
+                reconstructTap,
+                q,
+                1,
+                ycaOut + j0 + 2 * q + 1);
+        }
+
+        j0 += m;
+    }
+
+    return j0;
+}
+
+int
+decimateChromaVert4 (int n, const Rgba* const ycaIn[N], Rgba ycaOut[])
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128 fr = _mm_setzero_ps ();
+        __m128 fb = _mm_setzero_ps ();
+
+        for (int k = 0; k < numDecimateTaps; ++k)
+        {
+            __m128i evenR, evenB, oddR, oddB;
+            loadEvenOdd8 (
+                ycaIn[decimateOffset[k]] + i, evenR, evenB, oddR, oddB);
+
+            const __m128 t  = _mm_set1_ps (decimateTap[k]);
+            const __m128 tr = _mm_mul_ps (halfToFloat4 (evenR), t);
+            const __m128 tb = _mm_mul_ps (halfToFloat4 (evenB), t);
+
+            fr = k ? _mm_add_ps (fr, tr) : tr;
+            fb = k ? _mm_add_ps (fb, tb) : tb;
+        }
+
+        ChromaChunk::storeChroma4 (
+            floatToHalf4 (fr), floatToHalf4 (fb), ycaOut + i);
+
+        for (int j = i; j < i + 8; ++j)
+        {
+            ycaOut[j].g = ycaIn[N2][j].g;
+            ycaOut[j].a = ycaIn[N2][j].a;
+        }
+    }
+
+    return i;
+}
+
+int
+reconstructChromaVert4 (int n, const Rgba* const ycaIn[N], Rgba ycaOut[])
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 fr = _mm_setzero_ps ();
+        __m128 fb = _mm_setzero_ps ();
+
+        for (int k = 0; k < numReconstructTaps; ++k)
+        {
+            __m128i hr, hg, hb, ha;
+            loadRgba4 (ycaIn[reconstructOffset[k]] + i, hr, hg, hb, ha);
+
+            const __m128 t  = _mm_set1_ps (reconstructTap[k]);
+            const __m128 tr = _mm_mul_ps (halfToFloat4 (hr), t);
+            const __m128 tb = _mm_mul_ps (halfToFloat4 (hb), t);
+
+            fr = k ? _mm_add_ps (fr, tr) : tr;
+            fb = k ? _mm_add_ps (fb, tb) : tb;
+        }
+
+        __m128i hr, hg, hb, ha;
+        loadRgba4 (ycaIn[N2] + i, hr, hg, hb, ha);
+        storeRgba4 (ycaOut + i, floatToHalf4 (fr), hg, floatToHalf4 (fb), ha);
+    }
+
+    return i;
+}
+
+#endif
+
+} // namespace
+
+void
+RGBAtoYCA (
+    const V3f& yw,
+    int        n,
+    bool       aIsValid,
+    const Rgba rgbaIn[/*n*/],
+    Rgba       ycaOut[/*n*/])
+{
+    int i = 0;
+
+#ifdef IMF_HAVE_SSE2
+    i = RGBAtoYCA4 (yw, n, aIsValid, rgbaIn, ycaOut);
+#endif
+
+    for (; i < n; ++i)
+        RGBAtoYCA (yw, aIsValid, rgbaIn[i], ycaOut[i]);
 }
 
 void
@@ -100,69 +833,53 @@ decimateChromaHoriz (int n, const Rgba ycaIn[/*n+N-1*/], Rgba ycaOut[/*n*/])
     assert (ycaIn != ycaOut);
 #endif
 
-    int begin = N2;
-    int end   = begin + n;
+    int j = 0;
+
+#ifdef IMF_HAVE_SSE2
+    j = decimateChromaHoriz4 (n, ycaIn, ycaOut);
+#endif
 
-    for (int i = begin, j = 0; i < end; ++i, ++j)
+    for (; j < n; ++j)
     {
         if ((j & 1) == 0)
         {
-            ycaOut[j].r =
-                ycaIn[i - 13].r * 0.001064f + ycaIn[i - 11].r * -0.003771f +
-                ycaIn[i - 9].r * 0.009801f + ycaIn[i - 7].r * -0.021586f +
-                ycaIn[i - 5].r * 0.043978f + ycaIn[i - 3].r * -0.093067f +
-                ycaIn[i - 1].r * 0.313659f + ycaIn[i].r * 0.499846f +
-                ycaIn[i + 1].r * 0.313659f + ycaIn[i + 3].r * -0.093067f +
-                ycaIn[i + 5].r * 0.043978f + ycaIn[i + 7].r * -0.021586f +
-                ycaIn[i + 9].r * 0.009801f + ycaIn[i + 11].r * -0.003771f +
-                ycaIn[i + 13].r * 0.001064f;
-
-            ycaOut[j].b =
-                ycaIn[i - 13].b * 0.001064f + ycaIn[i - 11].b * -0.003771f +
-                ycaIn[i - 9].b * 0.009801f + ycaIn[i - 7].b * -0.021586f +
-                ycaIn[i - 5].b * 0.043978f + ycaIn[i - 3].b * -0.093067f +
-                ycaIn[i - 1].b * 0.313659f + ycaIn[i].b * 0.499846f +
-                ycaIn[i + 1].b * 0.313659f + ycaIn[i + 3].b * -0.093067f +
-                ycaIn[i + 5].b * 0.043978f + ycaIn[i + 7].b * -0.021586f +
-                ycaIn[i + 9].b * 0.009801f + ycaIn[i + 11].b * -0.003771f +
-                ycaIn[i + 13].b * 0.001064f;
+            filterHoriz (
+                numDecimateTaps,
+                decimateOffset,
+                decimateTap,
+                ycaIn + j,
+                ycaOut[j]);
         }
 
-        ycaOut[j].g = ycaIn[i].g;
-        ycaOut[j].a = ycaIn[i].a;
+        ycaOut[j].g = ycaIn[j + N2].g;
+        ycaOut[j].a = ycaIn[j + N2].a;
     }
 }
 
 void
 decimateChromaVert (int n, const Rgba* const ycaIn[N], Rgba ycaOut[/*n*/])
 {
-    for (int i = 0; i < n; ++i)
+    int i = 0;
+
+#ifdef IMF_HAVE_SSE2
+    i = decimateChromaVert4 (n, ycaIn, ycaOut);
+#endif
+
+    for (; i < n; ++i)
     {
         if ((i & 1) == 0)
         {
-            ycaOut[i].r =
-                ycaIn[0][i].r * 0.001064f + ycaIn[2][i].r * -0.003771f +
-                ycaIn[4][i].r * 0.009801f + ycaIn[6][i].r * -0.021586f +
-                ycaIn[8][i].r * 0.043978f + ycaIn[10][i].r * -0.093067f +
-                ycaIn[12][i].r * 0.313659f + ycaIn[13][i].r * 0.499846f +
-                ycaIn[14][i].r * 0.313659f + ycaIn[16][i].r * -0.093067f +
-                ycaIn[18][i].r * 0.043978f + ycaIn[20][i].r * -0.021586f +
-                ycaIn[22][i].r * 0.009801f + ycaIn[24][i].r * -0.003771f +
-                ycaIn[26][i].r * 0.001064f;
-
-            ycaOut[i].b =
-                ycaIn[0][i].b * 0.001064f + ycaIn[2][i].b * -0.003771f +
-                ycaIn[4][i].b * 0.009801f + ycaIn[6][i].b * -0.021586f +
-                ycaIn[8][i].b * 0.043978f + ycaIn[10][i].b * -0.093067f +
-                ycaIn[12][i].b * 0.313659f + ycaIn[13][i].b * 0.499846f +
-                ycaIn[14][i].b * 0.313659f + ycaIn[16][i].b * -0.093067f +
-                ycaIn[18][i].b * 0.043978f + ycaIn[20][i].b * -0.021586f +
-                ycaIn[22][i].b * 0.009801f + ycaIn[24][i].b * -0.003771f +
-                ycaIn[26][i].b * 0.001064f;
+            filterVert (
+                numDecimateTaps,
+                decimateOffset,
+                decimateTap,
+                ycaIn,
+                i,
+                ycaOut[i]);
         }
 
-        ycaOut[i].g = ycaIn[13][i].g;
-        ycaOut[i].a = ycaIn[13][i].a;
+        ycaOut[i].g = ycaIn[N2][i].g;
+        ycaOut[i].a = ycaIn[N2][i].a;
     }
 }
 
@@ -194,65 +911,55 @@ reconstructChromaHoriz (int n, const Rgba ycaIn[/*n+N-1*/], Rgba ycaOut[/*n*/])
     assert (ycaIn != ycaOut);
 #endif
 
-    int begin = N2;
-    int end   = begin + n;
+    int j = 0;
+
+#ifdef IMF_HAVE_SSE2
+    j = reconstructChromaHoriz4 (n, ycaIn, ycaOut);
+#endif
 
-    for (int i = begin, j = 0; i < end; ++i, ++j)
+    for (; j < n; ++j)
     {
         if (j & 1)
         {
-            ycaOut[j].r =
-                ycaIn[i - 13].r * 0.002128f + ycaIn[i - 11].r * -0.007540f +
-                ycaIn[i - 9].r * 0.019597f + ycaIn[i - 7].r * -0.043159f +
-                ycaIn[i - 5].r * 0.087929f + ycaIn[i - 3].r * -0.186077f +
-                ycaIn[i - 1].r * 0.627123f + ycaIn[i + 1].r * 0.627123f +
-                ycaIn[i + 3].r * -0.186077f + ycaIn[i + 5].r * 0.087929f +
-                ycaIn[i + 7].r * -0.043159f + ycaIn[i + 9].r * 0.019597f +
-                ycaIn[i + 11].r * -0.007540f + ycaIn[i + 13].r * 0.002128f;
-
-            ycaOut[j].b =
-                ycaIn[i - 13].b * 0.002128f + ycaIn[i - 11].b * -0.007540f +
-                ycaIn[i - 9].b * 0.019597f + ycaIn[i - 7].b * -0.043159f +
-                ycaIn[i - 5].b * 0.087929f + ycaIn[i - 3].b * -0.186077f +
-                ycaIn[i - 1].b * 0.627123f + ycaIn[i + 1].b * 0.627123f +
-                ycaIn[i + 3].b * -0.186077f + ycaIn[i + 5].b * 0.087929f +
-                ycaIn[i + 7].b * -0.043159f + ycaIn[i + 9].b * 0.019597f +
-                ycaIn[i + 11].b * -0.007540f + ycaIn[i + 13].b * 0.002128f;
+            filterHoriz (
+                numReconstructTaps,
+                reconstructOffset,
+                reconstructTap,
+                ycaIn + j,
+                ycaOut[j]);
         }
         else
         {
-            ycaOut[j].r = ycaIn[i].r;
-            ycaOut[j].b = ycaIn[i].b;
+            ycaOut[j].r = ycaIn[j + N2].r;
+            ycaOut[j].b = ycaIn[j + N2].b;
         }
 
-        ycaOut[j].g = ycaIn[i].g;
-        ycaOut[j].a = ycaIn[i].a;
+        ycaOut[j].g = ycaIn[j + N2].g;
+        ycaOut[j].a = ycaIn[j + N2].a;
     }
 }
 
 void
 reconstructChromaVert (int n, const Rgba* const ycaIn[N], Rgba ycaOut[/*n*/])
 {
-    for (int i = 0; i < n; ++i)
+    int i = 0;
+
+#ifdef IMF_HAVE_SSE2
+    i = reconstructChromaVert4 (n, ycaIn, ycaOut);
+#endif
+
+    for (; i < n; ++i)
     {
-        ycaOut[i].r = ycaIn[0][i].r * 0.002128f + ycaIn[2][i].r * -0.007540f +
-                      ycaIn[4][i].r * 0.019597f + ycaIn[6][i].r * -0.043159f +
-                      ycaIn[8][i].r * 0.087929f + ycaIn[10][i].r * -0.186077f +
-                      ycaIn[12][i].r * 0.627123f + ycaIn[14][i].r * 0.627123f +
-                      ycaIn[16][i].r * -0.186077f + ycaIn[18][i].r * 0.087929f +
-                      ycaIn[20][i].r * -0.043159f + ycaIn[22][i].r * 0.019597f +
-                      ycaIn[24][i].r * -0.007540f + ycaIn[26][i].r * 0.002128f;
-
-        ycaOut[i].b = ycaIn[0][i].b * 0.002128f + ycaIn[2][i].b * -0.007540f +
-                      ycaIn[4][i].b * 0.019597f + ycaIn[6][i].b * -0.043159f +
-                      ycaIn[8][i].b * 0.087929f + ycaIn[10][i].b * -0.186077f +
-                      ycaIn[12][i].b * 0.627123f + ycaIn[14][i].b * 0.627123f +
-                      ycaIn[16][i].b * -0.186077f + ycaIn[18][i].b * 0.087929f +
-                      ycaIn[20][i].b * -0.043159f + ycaIn[22][i].b * 0.019597f +
-                      ycaIn[24][i].b * -0.007540f + ycaIn[26][i].b * 0.002128f;
-
-        ycaOut[i].g = ycaIn[13][i].g;
-        ycaOut[i].a = ycaIn[13][i].a;
+        filterVert (
+            numReconstructTaps,
+            reconstructOffset,
+            reconstructTap,
+            ycaIn,
+            i,
+            ycaOut[i]);
+
+        ycaOut[i].g = ycaIn[N2][i].g;
+        ycaOut[i].a = ycaIn[N2][i].a;
     }
 }
 
@@ -263,41 +970,14 @@ YCAtoRGBA (
     const Rgba                  ycaIn[/*n*/],
     Rgba                        rgbaOut[/*n*/])
 {
-    for (int i = 0; i < n; ++i)
-    {
-        const Rgba& in  = ycaIn[i];
-        Rgba&       out = rgbaOut[i];
+    int i = 0;
 
-        if (in.r == 0 && in.b == 0)
-        {
-            //
-            // Special case -- both chroma channels are 0.  To avoid
-            // rounding errors, we explicitly set the output R, G and B
-            // channels equal to the input luminance.
-            //
-            // The special cases here and in RGBAtoYCA() ensure that
-            // converting black-and white images from RGBA to YCA and
-            // back is lossless.
-            //
-
-            out.r = in.g;
-            out.g = in.g;
-            out.b = in.g;
-            out.a = in.a;
-        }
-        else
-        {
-            float Y = in.g;
-            float r = (in.r + 1) * Y;
-            float b = (in.b + 1) * Y;
-            float g = (Y - r * yw.x - b * yw.z) / yw.y;
-
-            out.r = r;
-            out.g = g;
-            out.b = b;
-            out.a = in.a;
-        }
-    }
+#ifdef IMF_HAVE_SSE2
+    i = YCAtoRGBA4 (yw, n, ycaIn, rgbaOut);
+#endif
+
+    for (; i < n; ++i)
+        YCAtoRGBA (yw, ycaIn[i], rgbaOut[i]);
 }
 
 namespace
@@ -336,22 +1016,26 @@ desaturate (const Rgba& in, float f, const V3f& yw, Rgba& out)
     }
 }
 
-} // namespace
+//
+// Fix the saturation of pixels i1 through i2-1 of a scan line.
+//
 
 void
 fixSaturation (
-    const IMATH_NAMESPACE::V3f& yw,
-    int                         n,
-    const Rgba* const           rgbaIn[3],
-    Rgba                        rgbaOut[/*n*/])
+    const V3f&        yw,
+    int               n,
+    const Rgba* const rgbaIn[3],
+    int               i1,
+    int               i2,
+    Rgba              rgbaOut[])
 {
-    float neighborA2 = saturation (rgbaIn[0][0]);
-    float neighborA1 = neighborA2;
+    float neighborA2 = saturation (rgbaIn[0][i1]);
+    float neighborA1 = saturation (rgbaIn[0][max (i1 - 1, 0)]);
 
-    float neighborB2 = saturation (rgbaIn[2][0]);
-    float neighborB1 = neighborB2;
+    float neighborB2 = saturation (rgbaIn[2][i1]);
+    float neighborB1 = saturation (rgbaIn[2][max (i1 - 1, 0)]);
 
-    for (int i = 0; i < n; ++i)
+    for (int i = i1; i < i2; ++i)
     {
         float neighborA0 = neighborA1;
         neighborA1       = neighborA2;
@@ -394,5 +1078,180 @@ fixSaturation (
     }
 }
 
+#ifdef IMF_HAVE_SSE2
+
+//
+// std::max (a, b) and std::min (a, b), four at a time, with the
+// same results as std::max() and std::min() for NaNs and zeroes.
+//
+
+inline __m128
+select4 (__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+}
+
+inline __m128
+max4 (__m128 a, __m128 b)
+{
+    return select4 (_mm_cmplt_ps (a, b), b, a);
+}
+
+inline __m128
+min4 (__m128 a, __m128 b)
+{
+    return select4 (_mm_cmplt_ps (b, a), b, a);
+}
+
+inline __m128
+saturation4 (__m128 r, __m128 g, __m128 b, __m128& rgbMax)
+{
+    rgbMax              = max4 (r, max4 (g, b));
+    const __m128 rgbMin = min4 (r, min4 (g, b));
+
+    return _mm_and_ps (
+        _mm_sub_ps (_mm_set1_ps (1), _mm_div_ps (rgbMin, rgbMax)),
+        _mm_cmpgt_ps (rgbMax, _mm_setzero_ps ()));
+}
+
+inline __m128
+saturation4 (const Rgba* p)
+{
+    __m128i hr, hg, hb, ha;
+    loadRgba4 (p, hr, hg, hb, ha);
+
+    __m128 rgbMax;
+
+    return saturation4 (
+        halfToFloat4 (hr), halfToFloat4 (hg), halfToFloat4 (hb), rgbMax);
+}
+
+//
+// Fix the saturation of the pixels of a scan line that have
+// neighbors on both sides, four at a time, starting with pixel 1.
+// Returns the index of the first pixel that was not processed.
+//
+
+int
+fixSaturation4 (
+    const V3f& yw, int n, const Rgba* const rgbaIn[3], Rgba rgbaOut[])
+{
+    const __m128 ywx     = _mm_set1_ps (yw.x);
+    const __m128 ywy     = _mm_set1_ps (yw.y);
+    const __m128 ywz     = _mm_set1_ps (yw.z);
+    const __m128 one     = _mm_set1_ps (1);
+    const __m128 quarter = _mm_set1_ps (0.25f);
+    const __m128 zero    = _mm_setzero_ps ();
+
+    int i = 1;
+
+    for (; i + 4 < n; i += 4)
+    {
+        const __m128 sMean = min4 (
+            one,
+            _mm_mul_ps (
+                quarter,
+                _mm_add_ps (
+                    _mm_add_ps (
+                        _mm_add_ps (
+                            saturation4 (rgbaIn[0] + i - 1),
+                            saturation4 (rgbaIn[0] + i + 1)),
+                        saturation4 (rgbaIn[2] + i - 1)),
+                    saturation4 (rgbaIn[2] + i + 1))));
+
+        __m128i hr, hg, hb, ha;
+        loadRgba4 (rgbaIn[1] + i, hr, hg, hb, ha);
+
+        const __m128 r = halfToFloat4 (hr);
+        const __m128 g = halfToFloat4 (hg);
+        const __m128 b = halfToFloat4 (hb);
+
+        __m128       rgbMax;
+        const __m128 s = saturation4 (r, g, b, rgbMax);
+
+        const __m128 sMax = min4 (
+            one,
+            _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (one, sMean), quarter)));
+
+        const __m128 fix =
+            _mm_and_ps (_mm_cmpgt_ps (s, sMean), _mm_cmpgt_ps (s, sMax));
+
+        if (_mm_movemask_ps (fix) == 0)
+        {
+            storeRgba4 (rgbaOut + i, hr, hg, hb, ha);
+            continue;
+        }
+
+        //
+        // Desaturate the pixels that need it
+        //
+
+        const __m128 f = _mm_div_ps (sMax, s);
+
+        __m128i dr = floatToHalf4 (max4 (
+            _mm_sub_ps (rgbMax, _mm_mul_ps (_mm_sub_ps (rgbMax, r), f)), zero));
+
+        __m128i dg = floatToHalf4 (max4 (
+            _mm_sub_ps (rgbMax, _mm_mul_ps (_mm_sub_ps (rgbMax, g), f)), zero));
+
+        __m128i db = floatToHalf4 (max4 (
+            _mm_sub_ps (rgbMax, _mm_mul_ps (_mm_sub_ps (rgbMax, b), f)), zero));
+
+        const __m128 fr = halfToFloat4 (dr);
+        const __m128 fg = halfToFloat4 (dg);
+        const __m128 fb = halfToFloat4 (db);
+
+        const __m128 Yin = _mm_add_ps (
+            _mm_add_ps (_mm_mul_ps (r, ywx), _mm_mul_ps (g, ywy)),
+            _mm_mul_ps (b, ywz));
+
+        const __m128 Yout = _mm_add_ps (
+            _mm_add_ps (_mm_mul_ps (fr, ywx), _mm_mul_ps (fg, ywy)),
+            _mm_mul_ps (fb, ywz));
+
+        const __m128  scale  = _mm_div_ps (Yin, Yout);
+        const __m128i scaled = _mm_castps_si128 (_mm_cmpgt_ps (Yout, zero));
+
+        dr = select4 (scaled, floatToHalf4 (_mm_mul_ps (fr, scale)), dr);
+        dg = select4 (scaled, floatToHalf4 (_mm_mul_ps (fg, scale)), dg);
+        db = select4 (scaled, floatToHalf4 (_mm_mul_ps (fb, scale)), db);
+
+        const __m128i fixi = _mm_castps_si128 (fix);
+
+        storeRgba4 (
+            rgbaOut + i,
+            select4 (fixi, dr, hr),
+            select4 (fixi, dg, hg),
+            select4 (fixi, db, hb),
+            ha);
+    }
+
+    return i;
+}
+
+#endif
+
+} // namespace
+
+void
+fixSaturation (
+    const IMATH_NAMESPACE::V3f& yw,
+    int                         n,
+    const Rgba* const           rgbaIn[3],
+    Rgba                        rgbaOut[/*n*/])
+{
+    int i = 0;
+
+#ifdef IMF_HAVE_SSE2
+    if (n > 5)
+    {
+        fixSaturation (yw, n, rgbaIn, 0, 1, rgbaOut);
+        i = fixSaturation4 (yw, n, rgbaIn, rgbaOut);
+    }
+#endif
+
+    fixSaturation (yw, n, rgbaIn, i, n, rgbaOut);
+}
+
 } // namespace RgbaYca
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -14,6 +14,7 @@
 #include "IlmThreadPool.h"
 #include "IlmThreadSemaphore.h"
 #include "ImfChannelList.h"
+#include "ImfChunkOffsetCache.h"
 #include "ImfCompressor.h"
 #include "ImfConvert.h"
 #include "ImfInputPartData.h"
@@ -210,7 +211,8 @@ struct ScanLineInputFile::Data
     bool             memoryMapped;     // if the stream is memory mapped
     OptimizationMode optimizationMode; // optimizibility of the input file
     vector<sliceOptimizationData>
-        optimizationData; ///< channel ordering for optimized reading
+                 optimizationData; ///< channel ordering for optimized reading
+    vector<bool> selectedChannels; // channels the compressors decode
 
     Data (int numThreads);
     ~Data ();
@@ -307,6 +309,17 @@ readLineOffsets (
     vector<uint64_t>&                        lineOffsets,
     bool&                                    complete)
 {
+    //
+    // A single part file is part 0, whether it is read through
+    // this class or through a MultiPartInputFile.
+    //
+
+    ChunkOffsetCache& cache = ChunkOffsetCache::globalCache ();
+    std::string       key;
+    bool              cached = cache.makeKey (is, key);
+
+    if (cached && cache.find (key, 0, is, lineOffsets, complete)) return;
+
     for (unsigned int i = 0; i < lineOffsets.size (); i++)
     {
         OPENEXR_IMF_INTERNAL_NAMESPACE::Xdr::read<
@@ -337,6 +350,8 @@ readLineOffsets (
             break;
         }
     }
+
+    if (cached) cache.insert (key, 0, lineOffsets, complete);
 }
 
 void
@@ -1594,6 +1609,30 @@ ScanLineInputFile::setFrameBuffer (const FrameBuffer& frameBuffer)
         _data->optimizationMode._optimizable = false;
     }
 
+    //
+    // Let the compressors skip the channels that are not in the
+    // frame buffer.  Line buffers that were uncompressed for another
+    // set of channels must be read again.
+    //
+
+    vector<bool> selected = decodedChannels (channels, frameBuffer);
+
+    if (selected != _data->selectedChannels)
+    {
+        for (size_t i = 0; i < _data->lineBuffers.size (); ++i)
+        {
+            LineBuffer* lineBuffer = _data->lineBuffers[i];
+
+            if (lineBuffer->compressor)
+            {
+                lineBuffer->compressor->setDecodedChannels (selected);
+                lineBuffer->number = -1;
+            }
+        }
+
+        _data->selectedChannels = selected;
+    }
+
     //
     // Store the new frame buffer.
     //
@@ -0,0 +1,277 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//	class TileCache
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfTileCache.h"
+
+#include "IlmThreadConfig.h"
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#if ILMTHREAD_THREADING_ENABLED
+#    include <mutex>
+#endif
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+using std::list;
+using std::shared_ptr;
+using std::unordered_map;
+
+namespace
+{
+
+struct KeyHash
+{
+    size_t operator() (const TileCache::Key& k) const
+    {
+        uint64_t h = k.file;
+        h = (h ^ uint32_t (k.part)) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ uint32_t (k.dx)) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ uint32_t (k.dy)) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ uint32_t (k.lx)) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ uint32_t (k.ly)) * 0x9E3779B97F4A7C15ULL;
+        return size_t (h ^ (h >> 32));
+    }
+};
+
+struct KeyEqual
+{
+    bool operator() (const TileCache::Key& a, const TileCache::Key& b) const
+    {
+        return a.file == b.file && a.part == b.part && a.dx == b.dx &&
+               a.dy == b.dy && a.lx == b.lx && a.ly == b.ly;
+    }
+};
+
+struct Entry
+{
+    TileCache::Key                    key;
+    shared_ptr<const TileCache::Tile> tile;
+};
+
+//
+// One independently locked part of the cache.  The list holds
+// the tiles from most to least recently used.
+//
+
+typedef unordered_map<TileCache::Key, list<Entry>::iterator, KeyHash, KeyEqual>
+    EntryIndex;
+
+struct Shard
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::mutex mutex;
+#endif
+    list<Entry> lru;
+    EntryIndex  index;
+    size_t      bytes = 0;
+};
+
+} // namespace
+
+struct TileCache::Data
+{
+    std::atomic<size_t> maxBytes;
+    int                 numShards;
+    Shard*              shards;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> insertions;
+    std::atomic<uint64_t> evictions;
+
+    Data (size_t maxBytes, int numShards);
+    ~Data ();
+
+    Shard& shardFor (const Key& key)
+    {
+        return shards[KeyHash () (key) & (numShards - 1)];
+    }
+
+    size_t shardBudget () const { return maxBytes / numShards; }
+
+    void trim (Shard& shard, size_t budget);
+};
+
+TileCache::Data::Data (size_t b, int n)
+    : maxBytes (b)
+    , numShards (1)
+    , shards (0)
+    , hits (0)
+    , misses (0)
+    , insertions (0)
+    , evictions (0)
+{
+    while (numShards < n && numShards < 1024)
+        numShards *= 2;
+    shards = new Shard[numShards];
+}
+
+TileCache::Data::~Data ()
+{
+    delete[] shards;
+}
+
+//
+// Evict least recently used tiles until the shard fits in budget.
+// Called with the shard locked.
+//
+
+void
+TileCache::Data::trim (Shard& shard, size_t budget)
+{
+    while (shard.bytes > budget && !shard.lru.empty ())
+    {
+        Entry& e = shard.lru.back ();
+        shard.bytes -= e.tile->data.size ();
+        shard.index.erase (e.key);
+        shard.lru.pop_back ();
+        ++evictions;
+    }
+}
+
+TileCache::TileCache (size_t maxBytes, int numShards)
+    : _data (new Data (maxBytes, numShards))
+{}
+
+TileCache::~TileCache ()
+{
+    delete _data;
+}
+
+TileCache&
+TileCache::globalCache ()
+{
+    static TileCache cache (0);
+    return cache;
+}
+
+void
+TileCache::setMaxBytes (size_t maxBytes)
+{
+    _data->maxBytes = maxBytes;
+    size_t budget   = _data->shardBudget ();
+
+    for (int i = 0; i < _data->numShards; ++i)
+    {
+        Shard& shard = _data->shards[i];
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (shard.mutex);
+#endif
+        _data->trim (shard, budget);
+    }
+}
+
+size_t
+TileCache::maxBytes () const
+{
+    return _data->maxBytes;
+}
+
+void
+TileCache::clear ()
+{
+    for (int i = 0; i < _data->numShards; ++i)
+    {
+        Shard& shard = _data->shards[i];
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (shard.mutex);
+#endif
+        shard.index.clear ();
+        shard.lru.clear ();
+        shard.bytes = 0;
+    }
+}
+
+TileCache::Statistics
+TileCache::statistics () const
+{
+    Statistics s;
+    s.hits       = _data->hits;
+    s.misses     = _data->misses;
+    s.insertions = _data->insertions;
+    s.evictions  = _data->evictions;
+    s.tiles      = 0;
+    s.bytes      = 0;
+
+    for (int i = 0; i < _data->numShards; ++i)
+    {
+        Shard& shard = _data->shards[i];
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (shard.mutex);
+#endif
+        s.tiles += shard.index.size ();
+        s.bytes += shard.bytes;
+    }
+    return s;
+}
+
+void
+TileCache::resetStatistics ()
+{
+    _data->hits       = 0;
+    _data->misses     = 0;
+    _data->insertions = 0;
+    _data->evictions  = 0;
+}
+
+shared_ptr<const TileCache::Tile>
+TileCache::find (const Key& key)
+{
+    if (_data->maxBytes == 0) return shared_ptr<const Tile> ();
+
+    Shard& shard = _data->shardFor (key);
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (shard.mutex);
+#endif
+    auto i = shard.index.find (key);
+
+    if (i == shard.index.end ())
+    {
+        ++_data->misses;
+        return shared_ptr<const Tile> ();
+    }
+
+    ++_data->hits;
+    shard.lru.splice (shard.lru.begin (), shard.lru, i->second);
+    return i->second->tile;
+}
+
+void
+TileCache::insert (const Key& key, const shared_ptr<const Tile>& tile)
+{
+    size_t budget = _data->shardBudget ();
+    if (!tile || tile->data.size () > budget) return;
+
+    Shard& shard = _data->shardFor (key);
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (shard.mutex);
+#endif
+    auto i = shard.index.find (key);
+
+    if (i != shard.index.end ())
+    {
+        shard.bytes -= i->second->tile->data.size ();
+        shard.lru.erase (i->second);
+        shard.index.erase (i);
+    }
+
+    shard.lru.push_front (Entry ());
+    shard.lru.front ().key  = key;
+    shard.lru.front ().tile = tile;
+    shard.index[key]        = shard.lru.begin ();
+    shard.bytes += tile->data.size ();
+    ++_data->insertions;
+
+    _data->trim (shard, budget);
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,145 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_TILE_CACHE_H
+#define INCLUDED_IMF_TILE_CACHE_H
+
+//-----------------------------------------------------------------------------
+//
+//	class TileCache -- a least recently used cache of decoded tiles,
+//	limited to a number of bytes, that can be shared by any number
+//	of TiledInputFile objects.
+//
+//	Tiles are kept after they have been uncompressed, but before
+//	they are converted into the layout of a frame buffer, so files
+//	that share a cache may read the same tiles into different frame
+//	buffers.  The cache is split into shards, each with its own lock,
+//	so that threads reading different tiles rarely wait on each other.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+class IMF_EXPORT_TYPE TileCache
+{
+public:
+    //---------------------------------------------------------------
+    // Constructor -- maxBytes is the most decoded pixel data that
+    // the cache will hold.  The budget is divided evenly between
+    // numShards independently locked shards (numShards is rounded
+    // up to a power of two); a tile that does not fit in the budget
+    // of one shard is never cached.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    TileCache (size_t maxBytes, int numShards = 16);
+
+    IMF_EXPORT
+    ~TileCache ();
+
+    TileCache (const TileCache& other) = delete;
+    TileCache& operator= (const TileCache& other) = delete;
+    TileCache (TileCache&& other)                 = delete;
+    TileCache& operator= (TileCache&& other) = delete;
+
+    //---------------------------------------------------------------
+    // The process-wide cache.  Its budget is initially zero, which
+    // means it holds nothing until setMaxBytes() is called.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    static TileCache& globalCache ();
+
+    //---------------------------------------------------------------
+    // Change the budget of the cache.  If the cache holds more than
+    // the new budget, the least recently used tiles are evicted.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void setMaxBytes (size_t maxBytes);
+
+    IMF_EXPORT
+    size_t maxBytes () const;
+
+    //---------------------------------------------------------------
+    // Remove all tiles from the cache.  Tiles that a file is
+    // currently reading from remain valid until it is done with them.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void clear ();
+
+    //---------------------------------------------------------------
+    // Counters for lookups and evictions since the cache was created
+    // or resetStatistics() was called, and the current contents.
+    //---------------------------------------------------------------
+
+    struct Statistics
+    {
+        uint64_t hits;       // lookups that found a tile
+        uint64_t misses;     // lookups that did not
+        uint64_t insertions; // tiles added to the cache
+        uint64_t evictions;  // tiles removed to stay within the budget
+        size_t   tiles;      // number of tiles held now
+        size_t   bytes;      // size of the tiles held now
+    };
+
+    IMF_EXPORT
+    Statistics statistics () const;
+
+    IMF_EXPORT
+    void resetStatistics ();
+
+    //---------------------------------------------------------------
+    // Cache entries, as used by the file classes:
+    //
+    // A key names a tile by the identity of its file, the number
+    // of the part in the file, and its tile and level coordinates.
+    // A tile holds the uncompressed pixel data and the
+    // Compressor::Format that the data is stored in.
+    //
+    // find() returns the tile for a key, or a null pointer if the
+    // cache does not hold it; insert() adds a tile to the cache,
+    // replacing any tile with the same key.
+    //---------------------------------------------------------------
+
+    struct Key
+    {
+        uint64_t file;
+        int      part;
+        int      dx;
+        int      dy;
+        int      lx;
+        int      ly;
+    };
+
+    struct Tile
+    {
+        std::vector<char> data;
+        int               format;
+    };
+
+    IMF_EXPORT
+    std::shared_ptr<const Tile> find (const Key& key);
+
+    IMF_EXPORT
+    void insert (const Key& key, const std::shared_ptr<const Tile>& tile);
+
+private:
+    struct IMF_HIDDEN Data;
+
+    Data* _data;
+};
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
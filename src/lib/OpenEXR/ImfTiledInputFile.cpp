@@ -22,12 +22,13 @@
 #include "ImfHeader.h"
 #include "ImfInputPartData.h"
 #include "ImfInputStreamMutex.h"
+#include "ImfMMapIO.h"
 #include "ImfMisc.h"
 #include "ImfMultiPartInputFile.h"
 #include "ImfNamespace.h"
 #include "ImfPartType.h"
-#include "ImfStdIO.h"
 #include "ImfThreading.h"
+#include "ImfTileCache.h"
 #include "ImfTileDescriptionAttribute.h"
 #include "ImfTileOffsets.h"
 #include "ImfTiledMisc.h"
@@ -119,6 +120,9 @@ struct TileBuffer
     bool               hasException;
     string             exception;
 
+    std::shared_ptr<const TileCache::Tile> cachedTile; // tile found in the
+                                                       // tile cache, if any
+
     TileBuffer (Compressor* const comp);
     ~TileBuffer ();
 
@@ -216,6 +220,9 @@ struct TiledInputFile::Data
     InputStreamMutex* _streamData;
     bool              _deleteStream;
 
+    TileCache* tileCache;     // cache shared with other files, if any
+    uint64_t   tileCacheFile; // identity of this file in the cache
+
     Data (int numThreads);
     ~Data ();
 
@@ -232,6 +239,12 @@ struct TiledInputFile::Data
     inline TileBuffer* getTileBuffer (int number);
     // hash function from tile indices
     // into our vector of tile buffers
+
+    inline TileCache::Key tileCacheKey (int dx, int dy, int lx, int ly) const;
+
+    void selectDecodedChannels ();
+    // let the compressors skip the channels that
+    // are not in the frame buffer
 };
 
 TiledInputFile::Data::Data (int numThreads)
@@ -244,6 +257,8 @@ TiledInputFile::Data::Data (int numThreads)
     , memoryMapped (false)
     , _streamData (NULL)
     , _deleteStream (false)
+    , tileCache (0)
+    , tileCacheFile (0)
 {
     //
     // We need at least one tileBuffer, but if threading is used,
@@ -270,6 +285,43 @@ TiledInputFile::Data::getTileBuffer (int number)
     return tileBuffers[number % tileBuffers.size ()];
 }
 
+TileCache::Key
+TiledInputFile::Data::tileCacheKey (int dx, int dy, int lx, int ly) const
+{
+    //
+    // A single part file is part 0, whether it is read
+    // through a TiledInputFile or a MultiPartInputFile.
+    //
+
+    TileCache::Key key;
+    key.file = tileCacheFile;
+    key.part = max (partNumber, 0);
+    key.dx   = dx;
+    key.dy   = dy;
+    key.lx   = lx;
+    key.ly   = ly;
+    return key;
+}
+
+void
+TiledInputFile::Data::selectDecodedChannels ()
+{
+    //
+    // Tiles that go into the tile cache must be complete,
+    // so all channels are decoded when there is a cache.
+    //
+
+    vector<bool> selected;
+
+    if (!tileCache) selected = decodedChannels (header.channels (), frameBuffer);
+
+    for (size_t i = 0; i < tileBuffers.size (); ++i)
+    {
+        if (tileBuffers[i]->compressor)
+            tileBuffers[i]->compressor->setDecodedChannels (selected);
+    }
+}
+
 //
 // avoid allocating excessive memory due to large lineOffsets table size.
 // If the chunktablesize claims to be large,
@@ -493,7 +545,10 @@ readNextTileData (
     // Read the pixel data.
     //
 
-    streamData->is->read (buffer, dataSize);
+    if (streamData->is->isMemoryMapped ())
+        buffer = streamData->is->readMemoryMapped (dataSize);
+    else
+        streamData->is->read (buffer, dataSize);
 
     //
     // Keep track of which tile is the next one in
@@ -534,9 +589,11 @@ TileBufferTask::TileBufferTask (
 TileBufferTask::~TileBufferTask ()
 {
     //
-    // Signal that the tile buffer is now free
+    // Let go of the cached tile, if any, and
+    // signal that the tile buffer is now free
     //
 
+    _tileBuffer->cachedTile.reset ();
     _tileBuffer->post ();
 }
 
@@ -571,7 +628,17 @@ TileBufferTask::execute ()
         // Uncompress the data, if necessary
         //
 
-        if (_tileBuffer->compressor && _tileBuffer->dataSize < sizeOfTile)
+        if (_tileBuffer->cachedTile)
+        {
+            //
+            // The tile cache already holds the uncompressed data.
+            //
+
+            _tileBuffer->format =
+                Compressor::Format (_tileBuffer->cachedTile->format);
+            _tileBuffer->uncompressedData = &_tileBuffer->cachedTile->data[0];
+        }
+        else if (_tileBuffer->compressor && _tileBuffer->dataSize < sizeOfTile)
         {
             _tileBuffer->format = _tileBuffer->compressor->format ();
 
@@ -592,6 +659,29 @@ TileBufferTask::execute ()
             _tileBuffer->uncompressedData = _tileBuffer->buffer;
         }
 
+        //
+        // Share the uncompressed data with other readers of the file.
+        //
+
+        if (_ifd->tileCache && _ifd->tileCache->maxBytes () > 0 &&
+            !_tileBuffer->cachedTile && _tileBuffer->dataSize >= sizeOfTile)
+        {
+            std::shared_ptr<TileCache::Tile> tile (new TileCache::Tile);
+
+            tile->data.assign (
+                _tileBuffer->uncompressedData,
+                _tileBuffer->uncompressedData + sizeOfTile);
+            tile->format = _tileBuffer->format;
+
+            _ifd->tileCache->insert (
+                _ifd->tileCacheKey (
+                    _tileBuffer->dx,
+                    _tileBuffer->dy,
+                    _tileBuffer->lx,
+                    _tileBuffer->ly),
+                tile);
+        }
+
         //
         // Convert the tile of pixel data back from the machine-independent
         // representation, and store the result in the frame buffer.
@@ -716,6 +806,20 @@ newTileBufferTask (
 
         tileBuffer->uncompressedData = 0;
 
+        //
+        // If the tile cache holds the tile, there is
+        // nothing to read from the file.
+        //
+
+        if (ifd->tileCache)
+        {
+            tileBuffer->cachedTile =
+                ifd->tileCache->find (ifd->tileCacheKey (dx, dy, lx, ly));
+
+            if (tileBuffer->cachedTile)
+                return new TileBufferTask (group, ifd, tileBuffer);
+        }
+
         readTileData (
             streamData,
             ifd,
@@ -759,7 +863,7 @@ TiledInputFile::TiledInputFile (const char fileName[], int numThreads)
     {
         try
         {
-            is = new StdIFStream (fileName);
+            is = openInputFileStream (fileName);
             readMagicNumberAndVersionField (*is, _data->version);
 
             //
@@ -773,6 +877,7 @@ TiledInputFile::TiledInputFile (const char fileName[], int numThreads)
 
             _data->_streamData     = new InputStreamMutex ();
             _data->_streamData->is = is;
+            _data->memoryMapped    = is->isMemoryMapped ();
             _data->header.readFrom (*_data->_streamData->is, _data->version);
 
             initialize ();
@@ -1253,6 +1358,7 @@ TiledInputFile::setFrameBuffer (const FrameBuffer& frameBuffer)
 
     _data->frameBuffer = frameBuffer;
     _data->slices      = slices;
+    _data->selectDecodedChannels ();
 }
 
 const FrameBuffer&
@@ -1270,6 +1376,69 @@ TiledInputFile::isComplete () const
     return _data->fileIsComplete;
 }
 
+namespace
+{
+
+//
+// Identify a file in a tile cache by the name, size, modification
+// time, and device and inode numbers of the file on disk, so that
+// files which are opened more than once share cached tiles, but a
+// file that has been rewritten does not.  The offsets of the tiles
+// are included as an extra check.  Returns false for streams that
+// are not files on disk.
+//
+
+bool
+tileCacheFileIdentity (
+    OPENEXR_IMF_INTERNAL_NAMESPACE::IStream& is,
+    const TileOffsets&                       offsets,
+    uint64_t&                                h)
+{
+    std::string identity;
+    if (!fileIdentity (is, identity)) return false;
+
+    h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < identity.size (); ++i)
+        h = (h ^ uint8_t (identity[i])) * 0x100000001b3ULL;
+
+    const vector<vector<vector<uint64_t>>>& o = offsets.getOffsets ();
+
+    for (size_t l = 0; l < o.size (); ++l)
+        for (size_t dy = 0; dy < o[l].size (); ++dy)
+            for (size_t dx = 0; dx < o[l][dy].size (); ++dx)
+                h = (h ^ o[l][dy][dx]) * 0x100000001b3ULL;
+
+    return true;
+}
+
+} // namespace
+
+void
+TiledInputFile::setTileCache (TileCache* cache)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data->_streamData);
+#endif
+    if (cache && cache != _data->tileCache &&
+        !tileCacheFileIdentity (
+            *_data->_streamData->is,
+            _data->tileOffsets,
+            _data->tileCacheFile))
+    {
+        cache = 0;
+    }
+
+    _data->tileCache = cache;
+    _data->selectDecodedChannels ();
+}
+
+TileCache*
+TiledInputFile::tileCache () const
+{
+    return _data->tileCache;
+}
+
 void
 TiledInputFile::readTiles (int dx1, int dx2, int dy1, int dy2, int lx, int ly)
 {
@@ -119,6 +119,27 @@ public:
     IMF_EXPORT
     bool isComplete () const;
 
+    //------------------------------------------------------------
+    // Share decoded tiles with other files through a TileCache:
+    //
+    // After setTileCache(cache), readTile() and readTiles() look
+    // for each tile in the cache before reading it from the file,
+    // and add the tiles they uncompress to the cache.  A file is
+    // identified in the cache by its name, size, modification time,
+    // device and inode numbers, and the offsets of its tiles, so the
+    // same file opened more than once shares tiles, but a rewritten
+    // file does not.  Files that are not read from a file on disk
+    // never use a cache, and tileCache() returns 0 for them.
+    // The cache must outlive the TiledInputFile, or be detached
+    // with setTileCache(0) first.  By default no cache is used.
+    //------------------------------------------------------------
+
+    IMF_EXPORT
+    void setTileCache (TileCache* cache);
+
+    IMF_EXPORT
+    TileCache* tileCache () const;
+
     //--------------------------------------------------
     // Utility functions:
     //--------------------------------------------------
@@ -22,6 +22,7 @@
 #include <ImfHeader.h>
 #include <ImfInputFile.h>
 #include <ImfInputPart.h>
+#include <ImfLineOrderAttribute.h>
 #include <ImfMisc.h>
 #include <ImfPartType.h>
 #include <ImfPreviewImageAttribute.h>
@@ -37,8 +38,10 @@
 #include <ImfXdr.h>
 #include <algorithm>
 #include <assert.h>
+#include <cstring>
+#include <deque>
 #include <fstream>
-#include <map>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -56,7 +59,7 @@ using ILMTHREAD_NAMESPACE::TaskGroup;
 using ILMTHREAD_NAMESPACE::ThreadPool;
 using IMATH_NAMESPACE::Box2i;
 using IMATH_NAMESPACE::V2i;
-using std::map;
+using std::deque;
 using std::max;
 using std::min;
 using std::string;
@@ -126,27 +129,20 @@ struct TileCoord
     }
 };
 
+//
+// Tiles that are written before the tiles that precede them in the
+// file wait in a queue, indexed by their distance from the next tile
+// to be stored in the file.  Entries for tiles that have not been
+// written yet have no pixel data.
+//
+
 struct BufferedTile
 {
-    char* pixelData;
-    int   pixelDataSize;
-
-    BufferedTile (const char* data, int size)
-        : pixelData (0), pixelDataSize (size)
-    {
-        pixelData = new char[pixelDataSize];
-        memcpy (pixelData, data, pixelDataSize);
-    }
-
-    ~BufferedTile () { delete[] pixelData; }
-
-    BufferedTile (const BufferedTile& other) = delete;
-    BufferedTile& operator= (const BufferedTile& other) = delete;
-    BufferedTile (BufferedTile&& other)                 = delete;
-    BufferedTile& operator= (BufferedTile&& other) = delete;
+    TileCoord    tileCoord;
+    vector<char> pixelData;
 };
 
-typedef map<TileCoord, BufferedTile*> TileMap;
+typedef deque<BufferedTile> TileQueue;
 
 struct TileBuffer
 {
@@ -219,8 +215,14 @@ struct TiledOutputFile::Data
 
     uint64_t tileOffsetsPosition; // position of the tile index
 
-    TileMap   tileMap;
-    TileCoord nextTileToWrite;
+    TileQueue tileQueue;          // tiles waiting for earlier tiles
+    TileCoord nextTileToWrite;    // next tile to store in the file
+    uint64_t  nextTileNumber;     // tileNumber (nextTileToWrite)
+    size_t    bufferedBytes;      // pixel data size in tileQueue
+    size_t    reorderBufferLimit; // maximum for reorderBufferBytes()
+
+    vector<uint64_t> firstTileOfLevel; // tile numbers, by level
+    uint64_t         headerPosition;   // of the header in the file
 
     int partNumber; // the output part number
 
@@ -238,6 +240,10 @@ struct TiledOutputFile::Data
     // vector of tile buffers
 
     TileCoord nextTileCoord (const TileCoord& a);
+
+    uint64_t tileNumber (const TileCoord& a) const;
+    // position of a tile in the
+    // order of nextTileCoord()
 };
 
 TiledOutputFile::Data::Data (int numThreads)
@@ -245,6 +251,10 @@ TiledOutputFile::Data::Data (int numThreads)
     , numXTiles (0)
     , numYTiles (0)
     , tileOffsetsPosition (0)
+    , nextTileNumber (0)
+    , bufferedBytes (0)
+    , reorderBufferLimit (std::numeric_limits<size_t>::max ())
+    , headerPosition (0)
     , partNumber (-1)
 {
     //
@@ -260,13 +270,6 @@ TiledOutputFile::Data::~Data ()
     delete[] numXTiles;
     delete[] numYTiles;
 
-    //
-    // Delete all the tile buffers, if any still happen to exist
-    //
-
-    for (TileMap::iterator i = tileMap.begin (); i != tileMap.end (); ++i)
-        delete i->second;
-
     for (size_t i = 0; i < tileBuffers.size (); i++)
         delete tileBuffers[i];
 }
@@ -380,6 +383,15 @@ TiledOutputFile::Data::nextTileCoord (const TileCoord& a)
     return b;
 }
 
+uint64_t
+TiledOutputFile::Data::tileNumber (const TileCoord& a) const
+{
+    int row = (lineOrder == DECREASING_Y) ? numYTiles[a.ly] - 1 - a.dy : a.dy;
+
+    return firstTileOfLevel[a.lx + a.ly * numXLevels] +
+           uint64_t (row) * numXTiles[a.lx] + a.dx;
+}
+
 namespace
 {
 
@@ -438,6 +450,95 @@ writeTileData (
     if (ofd->multipart) { streamData->currentPosition += Xdr::size<int> (); }
 }
 
+//
+// Returns the offset of the value of attribute "lineOrder" from the
+// start of header hdr, as Header::writeTo() stores it in a file.
+//
+
+uint64_t
+lineOrderValueOffset (const Header& hdr)
+{
+    StdOSStream os;
+    hdr.writeTo (os, true);
+
+    string      s   = os.str ();
+    const char* p   = s.c_str ();
+    const char* end = p + s.size ();
+
+    while (p < end && *p)
+    {
+        string name (p);
+        p += name.size () + 1;
+        p += strlen (p) + 1;
+
+        int size;
+        Xdr::read<CharPtrIO> (p, size);
+
+        if (name == "lineOrder") return uint64_t (p - s.c_str ());
+
+        p += size;
+    }
+
+    throw IEX_NAMESPACE::ArgExc ("Header has no lineOrder attribute.");
+}
+
+//
+// Returns the memory used by the reorder buffer if tileQueue had
+// queueSize entries: the buffered pixel data, and the entries
+// themselves, including the empty ones for tiles not written yet.
+//
+
+size_t
+reorderBufferBytes (const TiledOutputFile::Data* ofd, size_t queueSize)
+{
+    return ofd->bufferedBytes + sizeof (BufferedTile) * queueSize;
+}
+
+void
+switchToRandomOrder (OutputStreamMutex* streamData, TiledOutputFile::Data* ofd)
+{
+    //
+    // Change the lineOrder attribute in the file's header to RANDOM_Y;
+    // the value has the same size for all line orders.  Then write all
+    // buffered tiles, in the order in which they would have been stored.
+    // This is rare, so the position of the value is only looked up here.
+    //
+
+    uint64_t lineOrderPosition =
+        ofd->headerPosition + lineOrderValueOffset (ofd->header);
+    uint64_t savedPosition = streamData->currentPosition;
+
+    if (savedPosition == 0) savedPosition = streamData->os->tellp ();
+
+    streamData->os->seekp (lineOrderPosition);
+    LineOrderAttribute (RANDOM_Y).writeValueTo (*streamData->os, ofd->version);
+    streamData->os->seekp (savedPosition);
+    streamData->currentPosition = savedPosition;
+
+    ofd->header.lineOrder () = RANDOM_Y;
+    ofd->lineOrder           = RANDOM_Y;
+
+    for (size_t i = 0; i < ofd->tileQueue.size (); ++i)
+    {
+        BufferedTile& tile = ofd->tileQueue[i];
+
+        if (tile.pixelData.empty ()) continue;
+
+        writeTileData (
+            streamData,
+            ofd,
+            tile.tileCoord.dx,
+            tile.tileCoord.dy,
+            tile.tileCoord.lx,
+            tile.tileCoord.ly,
+            tile.pixelData.data (),
+            int (tile.pixelData.size ()));
+    }
+
+    TileQueue ().swap (ofd->tileQueue);
+    ofd->bufferedBytes = 0;
+}
+
 void
 bufferedTileWrite (
     OutputStreamMutex*     streamData,
@@ -478,11 +579,15 @@ bufferedTileWrite (
     //
     // If the tiles cannot be written in random order, then check if a
     // tile with coordinates (dx,dy,lx,ly) has already been buffered.
+    // Tiles before nextTileToWrite have been written to the file, so
+    // their offsets are not zero.
     //
 
     TileCoord currentTile = TileCoord (dx, dy, lx, ly);
+    uint64_t  index = ofd->tileNumber (currentTile) - ofd->nextTileNumber;
 
-    if (ofd->tileMap.find (currentTile) != ofd->tileMap.end ())
+    if (index < ofd->tileQueue.size () &&
+        !ofd->tileQueue[index].pixelData.empty ())
     {
         THROW (
             IEX_NAMESPACE::ArgExc,
@@ -498,58 +603,68 @@ bufferedTileWrite (
     // then write this tile immediately and check if we have buffered tiles
     // that can be written after this tile.
     //
-    // Otherwise, buffer the tile so it can be written to file later.
+    // Otherwise, buffer the tile so it can be written to file later, unless
+    // that would exceed the reorder buffer limit.  In that case, give up on
+    // the file's line order.
     //
 
-    if (ofd->nextTileToWrite == currentTile)
+    if (index == 0)
     {
         writeTileData (
             streamData, ofd, dx, dy, lx, ly, pixelData, pixelDataSize);
-        ofd->nextTileToWrite = ofd->nextTileCoord (ofd->nextTileToWrite);
 
-        TileMap::iterator i = ofd->tileMap.find (ofd->nextTileToWrite);
+        if (!ofd->tileQueue.empty ()) ofd->tileQueue.pop_front ();
+
+        ofd->nextTileToWrite = ofd->nextTileCoord (ofd->nextTileToWrite);
+        ofd->nextTileNumber++;
 
         //
         // Step through the tiles and write all successive buffered tiles after
         // the current one.
         //
 
-        while (i != ofd->tileMap.end ())
+        while (!ofd->tileQueue.empty () &&
+               !ofd->tileQueue.front ().pixelData.empty ())
         {
-            //
-            // Write the tile, and then delete the tile's buffered data
-            //
+            BufferedTile& tile = ofd->tileQueue.front ();
 
             writeTileData (
                 streamData,
                 ofd,
-                i->first.dx,
-                i->first.dy,
-                i->first.lx,
-                i->first.ly,
-                i->second->pixelData,
-                i->second->pixelDataSize);
-
-            delete i->second;
-            ofd->tileMap.erase (i);
+                tile.tileCoord.dx,
+                tile.tileCoord.dy,
+                tile.tileCoord.lx,
+                tile.tileCoord.ly,
+                tile.pixelData.data (),
+                int (tile.pixelData.size ()));
 
-            //
-            // Proceed to the next tile
-            //
+            ofd->bufferedBytes -= tile.pixelData.size ();
+            ofd->tileQueue.pop_front ();
 
             ofd->nextTileToWrite = ofd->nextTileCoord (ofd->nextTileToWrite);
-            i                    = ofd->tileMap.find (ofd->nextTileToWrite);
+            ofd->nextTileNumber++;
         }
     }
+    else if (
+        size_t (pixelDataSize) > ofd->reorderBufferLimit ||
+        reorderBufferBytes (
+            ofd, std::max (ofd->tileQueue.size (), size_t (index + 1))) >
+            ofd->reorderBufferLimit - size_t (pixelDataSize))
+    {
+        switchToRandomOrder (streamData, ofd);
+
+        writeTileData (
+            streamData, ofd, dx, dy, lx, ly, pixelData, pixelDataSize);
+    }
     else
     {
-        //
-        // Create a new BufferedTile, copy the pixelData into it, and
-        // insert it into the tileMap.
-        //
+        if (ofd->tileQueue.size () <= index) ofd->tileQueue.resize (index + 1);
+
+        BufferedTile& tile = ofd->tileQueue[index];
+        tile.tileCoord     = currentTile;
+        tile.pixelData.assign (pixelData, pixelData + pixelDataSize);
 
-        ofd->tileMap[currentTile] =
-            new BufferedTile ((const char*) pixelData, pixelDataSize);
+        ofd->bufferedBytes += pixelDataSize;
     }
 }
 
@@ -835,6 +950,7 @@ TiledOutputFile::TiledOutputFile (
 
         // Write header and empty offset table to the file.
         writeMagicNumberAndVersionField (*_streamData->os, _data->header);
+        _data->headerPosition  = _streamData->os->tellp ();
         _data->previewPosition = _data->header.writeTo (*_streamData->os, true);
         _data->tileOffsetsPosition =
             _data->tileOffsets.writeTo (*_streamData->os);
@@ -882,6 +998,7 @@ TiledOutputFile::TiledOutputFile (
 
         // Write header and empty offset table to the file.
         writeMagicNumberAndVersionField (*_streamData->os, _data->header);
+        _data->headerPosition  = _streamData->os->tellp ();
         _data->previewPosition = _data->header.writeTo (*_streamData->os, true);
         _data->tileOffsetsPosition =
             _data->tileOffsets.writeTo (*_streamData->os);
@@ -922,6 +1039,7 @@ TiledOutputFile::TiledOutputFile (const OutputPartData* part)
         _data->partNumber          = part->partNumber;
         _data->tileOffsetsPosition = part->chunkOffsetTablePosition;
         _data->previewPosition     = part->previewPosition;
+        _data->headerPosition      = part->headerPosition;
     }
     catch (IEX_NAMESPACE::BaseExc& e)
     {
@@ -993,6 +1111,26 @@ TiledOutputFile::initialize (const Header& header)
                                  ? TileCoord (0, 0, 0, 0)
                                  : TileCoord (0, _data->numYTiles[0] - 1, 0, 0);
 
+    //
+    // Number the levels' tiles in the order nextTileCoord() visits them.
+    //
+
+    int      numXLevels = _data->numXLevels;
+    uint64_t numTiles   = 0;
+
+    _data->firstTileOfLevel.assign (numXLevels * _data->numYLevels, 0);
+
+    for (int ly = 0; ly < _data->numYLevels; ++ly)
+    {
+        for (int lx = 0; lx < numXLevels; ++lx)
+        {
+            if (_data->tileDesc.mode != RIPMAP_LEVELS && lx != ly) continue;
+
+            _data->firstTileOfLevel[lx + ly * numXLevels] = numTiles;
+            numTiles += uint64_t (_data->numXTiles[lx]) * _data->numYTiles[ly];
+        }
+    }
+
     _data->maxBytesPerTileLine =
         calculateBytesPerPixel (_data->header) * _data->tileDesc.xSize;
 
@@ -1871,6 +2009,36 @@ TiledOutputFile::updatePreviewImage (const PreviewRgba newPixels[])
     }
 }
 
+void
+TiledOutputFile::setReorderBufferLimit (size_t bytes)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_streamData);
+#endif
+    _data->reorderBufferLimit = bytes;
+
+    if (reorderBufferBytes (_data, _data->tileQueue.size ()) > bytes)
+        switchToRandomOrder (_streamData, _data);
+}
+
+size_t
+TiledOutputFile::reorderBufferLimit () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_streamData);
+#endif
+    return _data->reorderBufferLimit;
+}
+
+size_t
+TiledOutputFile::reorderBufferSize () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_streamData);
+#endif
+    return reorderBufferBytes (_data, _data->tileQueue.size ());
+}
+
 void
 TiledOutputFile::breakTile (
     int dx, int dy, int lx, int ly, int offset, int length, char c)
@@ -417,6 +417,41 @@ public:
     IMF_EXPORT
     void updatePreviewImage (const PreviewRgba newPixels[]);
 
+    //--------------------------------------------------------------
+    // Limiting the memory used for tiles written out of order:
+    //
+    // If the file's line order is INCREASING_Y or DECREASING_Y,
+    // tiles are stored in the file in that order, and tiles that
+    // are written before the tiles that precede them are kept in
+    // memory until they can be stored.  If tiles are written in an
+    // unrelated order, for example by a bucket renderer, nearly the
+    // whole compressed image may end up in memory.
+    //
+    // setReorderBufferLimit(n) limits the memory used for that,
+    // the compressed pixel data and the bookkeeping for the tiles
+    // still to be stored, to n bytes.  If buffering a tile would exceed
+    // the limit, the file switches to line order RANDOM_Y: the
+    // lineOrder attribute in the file's header is changed, the
+    // buffered tiles are stored, and from then on all tiles are
+    // stored as soon as they are written.  header().lineOrder()
+    // returns RANDOM_Y afterwards.  By default, there is no limit.
+    //
+    // reorderBufferSize() returns the number of bytes currently
+    // counted against the limit.
+    //
+    // Files created with line order RANDOM_Y never keep tiles in
+    // memory; applications that do not write tiles in order should
+    // prefer RANDOM_Y over a limit.
+    //
+    //--------------------------------------------------------------
+
+    IMF_EXPORT
+    void setReorderBufferLimit (size_t bytes);
+    IMF_EXPORT
+    size_t reorderBufferLimit () const;
+    IMF_EXPORT
+    size_t reorderBufferSize () const;
+
     //-------------------------------------------------------------
     // Break a tile -- for testing and debugging only:
     //
@@ -190,6 +190,24 @@ TiledOutputPart::updatePreviewImage (const PreviewRgba newPixels[])
     file->updatePreviewImage (newPixels);
 }
 
+void
+TiledOutputPart::setReorderBufferLimit (size_t bytes)
+{
+    file->setReorderBufferLimit (bytes);
+}
+
+size_t
+TiledOutputPart::reorderBufferLimit () const
+{
+    return file->reorderBufferLimit ();
+}
+
+size_t
+TiledOutputPart::reorderBufferSize () const
+{
+    return file->reorderBufferSize ();
+}
+
 void
 TiledOutputPart::breakTile (
     int dx, int dy, int lx, int ly, int offset, int length, char c)
@@ -86,6 +86,12 @@ public:
     IMF_EXPORT
     void updatePreviewImage (const PreviewRgba newPixels[]);
     IMF_EXPORT
+    void setReorderBufferLimit (size_t bytes);
+    IMF_EXPORT
+    size_t reorderBufferLimit () const;
+    IMF_EXPORT
+    size_t reorderBufferSize () const;
+    IMF_EXPORT
     void
     breakTile (int dx, int dy, int lx, int ly, int offset, int length, char c);
 
@@ -903,6 +903,18 @@ TiledRgbaInputFile::isComplete () const
     return _inputFile->isComplete ();
 }
 
+void
+TiledRgbaInputFile::setTileCache (TileCache* cache)
+{
+    _inputFile->setTileCache (cache);
+}
+
+TileCache*
+TiledRgbaInputFile::tileCache () const
+{
+    return _inputFile->tileCache ();
+}
+
 unsigned int
 TiledRgbaInputFile::tileXSize () const
 {
@@ -393,6 +393,16 @@ public:
     IMF_EXPORT
     bool isComplete () const;
 
+    //---------------------------------------------------------
+    // Share decoded tiles with other files through a TileCache
+    // (see TiledInputFile::setTileCache())
+    //---------------------------------------------------------
+
+    IMF_EXPORT
+    void setTileCache (TileCache* cache);
+    IMF_EXPORT
+    TileCache* tileCache () const;
+
     //----------------------------------
     // Access to the file format version
     //----------------------------------
@@ -6,11 +6,11 @@
 #include "ImfZip.h"
 #include "Iex.h"
 #include "ImfCheckedArithmetic.h"
+#include "ImfDeflate.h"
 #include "ImfNamespace.h"
 #include "ImfSimd.h"
 
 #include <math.h>
-#include <zlib.h>
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
@@ -93,14 +93,9 @@ Zip::compress (const char* raw, int rawSize, char* compressed)
     // Compress the data using zlib
     //
 
-    uLongf outSize = int (ceil (rawSize * 1.01)) + 100;
+    size_t outSize = int (ceil (rawSize * 1.01)) + 100;
 
-    if (Z_OK != ::compress2 (
-                    (Bytef*) compressed,
-                    &outSize,
-                    (const Bytef*) _tmpBuffer,
-                    rawSize,
-                    _zipLevel))
+    if (!zipDeflate (compressed, outSize, _tmpBuffer, rawSize, _zipLevel))
     {
         throw IEX_NAMESPACE::BaseExc ("Data compression (zlib) failed.");
     }
@@ -240,13 +235,9 @@ Zip::uncompress (const char* compressed, int compressedSize, char* raw)
     // Decompress the data using zlib
     //
 
-    uLongf outSize = _maxRawSize;
+    size_t outSize = _maxRawSize;
 
-    if (Z_OK != ::uncompress (
-                    (Bytef*) _tmpBuffer,
-                    &outSize,
-                    (const Bytef*) compressed,
-                    compressedSize))
+    if (!zipInflate (_tmpBuffer, outSize, compressed, compressedSize))
     {
         throw IEX_NAMESPACE::InputExc ("Data decompression (zlib) failed.");
     }
@@ -5,6 +5,7 @@
 
 #include "openexr_base.h"
 #include "openexr_errors.h"
+#include "internal_structs.h"
 
 /**************************************/
 
@@ -207,3 +208,45 @@ exr_get_default_dwa_compression_quality (float* q)
 {
     if (q) *q = sDefaultDwaLevel;
 }
+
+/**************************************/
+
+/* read by every thread compressing or decompressing zip data */
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+#    define DEFAULT_DEFLATE_BACKEND EXR_DEFLATE_BACKEND_LIBDEFLATE
+#else
+#    define DEFAULT_DEFLATE_BACKEND EXR_DEFLATE_BACKEND_ZLIB
+#endif
+
+#ifdef EXR_HAS_STD_ATOMICS
+static atomic_int sDefaultDeflateBackend = DEFAULT_DEFLATE_BACKEND;
+#    define store_deflate_backend(b) atomic_store (&sDefaultDeflateBackend, b)
+#    define load_deflate_backend() atomic_load (&sDefaultDeflateBackend)
+#else
+static volatile LONG sDefaultDeflateBackend = DEFAULT_DEFLATE_BACKEND;
+#    define store_deflate_backend(b)                                           \
+        InterlockedExchange (&sDefaultDeflateBackend, b)
+#    define load_deflate_backend()                                             \
+        InterlockedOr (&sDefaultDeflateBackend, 0)
+#endif
+
+void
+exr_set_default_deflate_backend (exr_deflate_backend_t b)
+{
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    if (b == EXR_DEFLATE_BACKEND_LIBDEFLATE)
+        store_deflate_backend (EXR_DEFLATE_BACKEND_LIBDEFLATE);
+    else
+        store_deflate_backend (EXR_DEFLATE_BACKEND_ZLIB);
+#else
+    (void) b;
+#endif
+}
+
+/**************************************/
+
+void
+exr_get_default_deflate_backend (exr_deflate_backend_t* b)
+{
+    if (b) *b = (exr_deflate_backend_t) load_deflate_backend ();
+}
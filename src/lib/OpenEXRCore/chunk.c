@@ -10,6 +10,7 @@
 #include "internal_xdr.h"
 
 #include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 /**************************************/
@@ -557,7 +558,7 @@ compute_tile_chunk_off (
 
             for (int ly = 0; ly < levely; ++ly)
             {
-                for (int lx = 0; lx < levelx; ++lx)
+                for (int lx = 0; lx < part->num_tile_levels_x; ++lx)
                 {
                     chunkoff +=
                         ((int64_t) part->tile_level_tile_count_x[lx] *
@@ -954,22 +955,13 @@ exr_read_tile_chunk_info (
     return EXR_ERR_SUCCESS;
 }
 
-exr_result_t
-exr_read_chunk (
-    exr_const_context_t     ctxt,
-    int                     part_index,
-    const exr_chunk_info_t* cinfo,
-    void*                   packed_data)
+static exr_result_t
+validate_read_chunk_info (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    const exr_chunk_info_t*             cinfo)
 {
-    exr_result_t                 rv;
-    uint64_t                     dataoffset, toread;
-    int64_t                      nread;
-    enum _INTERNAL_EXR_READ_MODE rmode = EXR_MUST_READ_ALL;
-    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
-
     if (!cinfo) return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
-    if (cinfo->packed_size > 0 && !packed_data)
-        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
 
     if (cinfo->idx < 0 || cinfo->idx >= part->chunk_count)
         return pctxt->print_error (
@@ -989,16 +981,41 @@ exr_read_chunk (
             EXR_ERR_INVALID_ARGUMENT,
             "mis-matched compression type for chunk block info");
 
-    dataoffset = cinfo->data_offset;
-    if (pctxt->file_size > 0 && dataoffset > (uint64_t) pctxt->file_size)
+    if (pctxt->file_size > 0 &&
+        cinfo->data_offset > (uint64_t) pctxt->file_size)
         return pctxt->print_error (
             pctxt,
             EXR_ERR_INVALID_ARGUMENT,
             "chunk block info data offset (%" PRIu64
             ") past end of file (%" PRId64 ")",
-            dataoffset,
+            cinfo->data_offset,
             pctxt->file_size);
 
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_read_chunk (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    void*                   packed_data)
+{
+    exr_result_t                 rv;
+    uint64_t                     dataoffset, toread;
+    int64_t                      nread;
+    enum _INTERNAL_EXR_READ_MODE rmode = EXR_MUST_READ_ALL;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    rv = validate_read_chunk_info (pctxt, part, cinfo);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+    if (cinfo->packed_size > 0 && !packed_data)
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    dataoffset = cinfo->data_offset;
+
     /* allow a short read if uncompressed */
     if (part->comp_type == EXR_COMPRESSION_NONE) rmode = EXR_ALLOW_SHORT_READ;
 
@@ -1023,6 +1040,235 @@ exr_read_chunk (
 
 /**************************************/
 
+/* neighbouring chunks are separated by their chunk headers (and
+ * possibly chunks the caller did not ask for), read through gaps up to
+ * this size rather than starting a new request */
+#define EXR_READ_COALESCE_MAX_GAP 4096
+/* keep a single request within the usual IOV_MAX */
+#define EXR_READ_COALESCE_MAX_VECS 1024
+
+struct _internal_exr_read_entry
+{
+    uint64_t offset;
+    uint64_t size;
+    void*    buffer;
+    int      run;
+};
+
+static int
+compare_read_entries (const void* a, const void* b)
+{
+    const struct _internal_exr_read_entry* ea = a;
+    const struct _internal_exr_read_entry* eb = b;
+    if (ea->offset < eb->offset) return -1;
+    if (ea->offset > eb->offset) return 1;
+    return 0;
+}
+
+exr_result_t
+exr_read_chunks (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    int                     nchunks,
+    const exr_chunk_info_t* cinfos,
+    void* const*            packed_data)
+{
+    exr_result_t                     rv;
+    struct _internal_exr_read_entry* entries;
+    exr_io_vec_t*                    vecs;
+    int*                             vec_counts;
+    uint64_t*                        offsets;
+    int64_t*                         nread;
+    uint8_t*                         gapbuf;
+    uint64_t                         runend = 0;
+    int                              nent = 0, nruns = 0, nvecs = 0;
+    size_t                           bytes;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (nchunks < 0 || (nchunks > 0 && (!cinfos || !packed_data)))
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    for (int c = 0; c < nchunks; ++c)
+    {
+        rv = validate_read_chunk_info (pctxt, part, cinfos + c);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+        if (cinfos[c].packed_size > 0 && !packed_data[c])
+            return pctxt->print_error (
+                pctxt,
+                EXR_ERR_INVALID_ARGUMENT,
+                "missing packed buffer for chunk %d",
+                c);
+    }
+
+    if (!pctxt->do_read_batch && !pctxt->read_vec_fn)
+    {
+        for (int c = 0; c < nchunks; ++c)
+        {
+            rv = exr_read_chunk (ctxt, part_index, cinfos + c, packed_data[c]);
+            if (rv != EXR_ERR_SUCCESS) return rv;
+        }
+        return EXR_ERR_SUCCESS;
+    }
+
+    if (nchunks == 0) return EXR_ERR_SUCCESS;
+
+    bytes = (sizeof (struct _internal_exr_read_entry) +
+             sizeof (exr_io_vec_t) * 2 + sizeof (int) + sizeof (uint64_t) +
+             sizeof (int64_t)) *
+                (size_t) nchunks +
+            EXR_READ_COALESCE_MAX_GAP;
+    entries = pctxt->alloc_fn (bytes);
+    if (!entries) return pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+    vecs       = (exr_io_vec_t*) (entries + nchunks);
+    offsets    = (uint64_t*) (vecs + 2 * nchunks);
+    nread      = (int64_t*) (offsets + nchunks);
+    vec_counts = (int*) (nread + nchunks);
+    gapbuf     = (uint8_t*) (vec_counts + nchunks);
+
+    for (int c = 0; c < nchunks; ++c)
+    {
+        if (cinfos[c].packed_size == 0) continue;
+        entries[nent].offset = cinfos[c].data_offset;
+        entries[nent].size   = cinfos[c].packed_size;
+        entries[nent].buffer = packed_data[c];
+        ++nent;
+    }
+    qsort (
+        entries,
+        (size_t) nent,
+        sizeof (struct _internal_exr_read_entry),
+        &compare_read_entries);
+
+    /* merge chunks in file order into runs of contiguous bytes, the
+     * bytes between chunks going to a scratch buffer */
+    for (int e = 0; e < nent; ++e)
+    {
+        struct _internal_exr_read_entry* cur = entries + e;
+
+        if (nruns == 0 || cur->offset < runend ||
+            cur->offset - runend > EXR_READ_COALESCE_MAX_GAP ||
+            vec_counts[nruns - 1] + 2 > EXR_READ_COALESCE_MAX_VECS)
+        {
+            offsets[nruns]    = cur->offset;
+            vec_counts[nruns] = 0;
+            nread[nruns]      = -1;
+            ++nruns;
+        }
+        else if (cur->offset > runend)
+        {
+            vecs[nvecs].buffer = gapbuf;
+            vecs[nvecs].size   = cur->offset - runend;
+            ++nvecs;
+            ++vec_counts[nruns - 1];
+        }
+
+        vecs[nvecs].buffer = cur->buffer;
+        vecs[nvecs].size   = cur->size;
+        ++nvecs;
+        ++vec_counts[nruns - 1];
+
+        cur->run = nruns - 1;
+        runend   = cur->offset + cur->size;
+    }
+
+    if (pctxt->do_read_batch)
+    {
+        rv = pctxt->do_read_batch (
+            pctxt, nruns, vecs, vec_counts, offsets, nread);
+    }
+    else
+    {
+        const exr_io_vec_t* runvecs = vecs;
+
+        rv = EXR_ERR_SUCCESS;
+        for (int r = 0; r < nruns; ++r)
+        {
+            nread[r] = pctxt->read_vec_fn (
+                ctxt,
+                pctxt->user_data,
+                runvecs,
+                vec_counts[r],
+                offsets[r],
+                (exr_stream_error_func_ptr_t) pctxt->print_error);
+            if (nread[r] < 0) break;
+            runvecs += vec_counts[r];
+        }
+    }
+
+    /* same short read policy as exr_read_chunk */
+    for (int e = 0; rv == EXR_ERR_SUCCESS && e < nent; ++e)
+    {
+        const struct _internal_exr_read_entry* cur = entries + e;
+        int64_t  got   = nread[cur->run];
+        uint64_t start = cur->offset - offsets[cur->run];
+        uint64_t have  = 0;
+
+        if (got > 0 && (uint64_t) got > start)
+        {
+            have = (uint64_t) got - start;
+            if (have > cur->size) have = cur->size;
+        }
+        if (have == cur->size) continue;
+
+        if (got >= 0 && part->comp_type == EXR_COMPRESSION_NONE)
+            memset (((uint8_t*) cur->buffer) + have, 0, cur->size - have);
+        else
+            rv = pctxt->print_error (
+                pctxt,
+                EXR_ERR_READ_IO,
+                "read of %" PRIu64 " bytes at offset %" PRIu64
+                " returned %" PRIu64 " bytes",
+                cur->size,
+                cur->offset,
+                have);
+    }
+
+    pctxt->free_fn (entries);
+    return rv;
+}
+
+/**************************************/
+
+exr_result_t
+exr_read_chunk_mapped (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    const void**            packed_data)
+{
+    exr_result_t rv;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (!packed_data)
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+    *packed_data = NULL;
+
+    rv = validate_read_chunk_info (pctxt, part, cinfo);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    if (!pctxt->mapped_data)
+        return pctxt->report_error (
+            pctxt,
+            EXR_ERR_FEATURE_NOT_IMPLEMENTED,
+            "context is not reading from a memory mapped file");
+
+    if (cinfo->data_offset > pctxt->mapped_size ||
+        cinfo->packed_size > pctxt->mapped_size - cinfo->data_offset)
+        return pctxt->print_error (
+            pctxt,
+            EXR_ERR_READ_IO,
+            "chunk of %" PRIu64 " bytes at offset %" PRIu64
+            " extends past end of file (%" PRIu64 ")",
+            cinfo->packed_size,
+            cinfo->data_offset,
+            pctxt->mapped_size);
+
+    *packed_data = pctxt->mapped_data + cinfo->data_offset;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
 exr_result_t
 exr_read_deep_chunk (
     exr_const_context_t     ctxt,
@@ -1103,25 +1349,166 @@ exr_read_deep_chunk (
 
 /**************************************/
 
-/* pull most of the logic to here to avoid having to unlock at every
- * error exit point and re-use mostly shared logic */
+/* writes the chunk header (already in file byte order) and data
+ * starting at the offset pointed to, advancing it */
 static exr_result_t
-write_scan_chunk (
+write_chunk_data (
     struct _internal_exr_context* pctxt,
-    int                           part_index,
-    struct _internal_exr_part*    part,
-    int                           y,
+    int                           isdeep,
+    const int32_t*                data,
+    int                           wrcnt,
     const void*                   packed_data,
     uint64_t                      packed_size,
     uint64_t                      unpacked_size,
     const void*                   sample_data,
-    uint64_t                      sample_data_size)
+    uint64_t                      sample_data_size,
+    uint64_t*                     offset)
 {
     exr_result_t rv;
-    int32_t      data[3];
-    int32_t      psize;
-    int          cidx, lpc, miny, wrcnt;
-    uint64_t*    ctable;
+
+    rv = pctxt->do_write (
+        pctxt, data, (uint64_t) (wrcnt) * sizeof (int32_t), offset);
+    if (rv == EXR_ERR_SUCCESS && isdeep)
+    {
+        int64_t ddata[3];
+        ddata[0] = (int64_t) sample_data_size;
+        ddata[1] = (int64_t) packed_size;
+        ddata[2] = (int64_t) unpacked_size;
+        rv       = pctxt->do_write (pctxt, ddata, 3 * sizeof (uint64_t), offset);
+
+        if (rv == EXR_ERR_SUCCESS)
+            rv = pctxt->do_write (pctxt, sample_data, sample_data_size, offset);
+    }
+    if (rv == EXR_ERR_SUCCESS && packed_size > 0)
+        rv = pctxt->do_write (pctxt, packed_data, packed_size, offset);
+    return rv;
+}
+
+/**************************************/
+
+/* records a chunk as output, writing the chunk table and moving to
+ * the next part once all the chunks of the part are done */
+static exr_result_t
+finish_output_chunk (
+    struct _internal_exr_context* pctxt,
+    struct _internal_exr_part*    part,
+    uint64_t*                     ctable,
+    int                           cidx)
+{
+    exr_result_t rv = EXR_ERR_SUCCESS;
+
+    ++(pctxt->output_chunk_count);
+    if (pctxt->output_chunk_count == part->chunk_count)
+    {
+        uint64_t chunkoff = part->chunk_table_offset;
+
+        ++(pctxt->cur_output_part);
+        if (pctxt->cur_output_part == pctxt->num_parts)
+            pctxt->mode = EXR_CONTEXT_WRITE_FINISHED;
+        pctxt->last_output_chunk  = -1;
+        pctxt->output_chunk_count = 0;
+
+        priv_from_native64 (ctable, part->chunk_count);
+        rv = pctxt->do_write (
+            pctxt,
+            ctable,
+            sizeof (uint64_t) * (uint64_t) (part->chunk_count),
+            &chunkoff);
+        /* just in case we look at it again? */
+        priv_to_native64 (ctable, part->chunk_count);
+    }
+    else
+    {
+        pctxt->last_output_chunk = cidx;
+    }
+    return rv;
+}
+
+/**************************************/
+
+/* shared tail of the scanline and tile chunk writes, once the chunk
+ * has been validated. When reserving, only the space is claimed and
+ * the chunk recorded as output, the data is written later, outside
+ * the lock, by internal_exr_write_reserved_chunk */
+static exr_result_t
+output_chunk (
+    struct _internal_exr_context*     pctxt,
+    struct _internal_exr_part*        part,
+    int                               cidx,
+    const int32_t*                    data,
+    int                               wrcnt,
+    const void*                       packed_data,
+    uint64_t                          packed_size,
+    uint64_t                          unpacked_size,
+    const void*                       sample_data,
+    uint64_t                          sample_data_size,
+    internal_exr_chunk_reservation_t* reserve)
+{
+    exr_result_t rv;
+    uint64_t*    ctable = NULL;
+    int          isdeep;
+
+    isdeep = (part->storage_mode == EXR_STORAGE_DEEP_SCANLINE ||
+              part->storage_mode == EXR_STORAGE_DEEP_TILED);
+
+    rv = alloc_chunk_table (pctxt, part, &ctable);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    ctable[cidx] = pctxt->output_file_offset;
+    if (reserve)
+    {
+        reserve->offset       = pctxt->output_file_offset;
+        reserve->chunk_index  = cidx;
+        reserve->header_count = wrcnt;
+        memcpy (reserve->header, data, (size_t) wrcnt * sizeof (int32_t));
+
+        pctxt->output_file_offset +=
+            (uint64_t) (wrcnt) * sizeof (int32_t) + packed_size;
+        if (isdeep)
+            pctxt->output_file_offset +=
+                3 * sizeof (uint64_t) + sample_data_size;
+    }
+    else
+    {
+        rv = write_chunk_data (
+            pctxt,
+            isdeep,
+            data,
+            wrcnt,
+            packed_data,
+            packed_size,
+            unpacked_size,
+            sample_data,
+            sample_data_size,
+            &(pctxt->output_file_offset));
+    }
+
+    if (rv == EXR_ERR_SUCCESS)
+        rv = finish_output_chunk (pctxt, part, ctable, cidx);
+
+    return rv;
+}
+
+/**************************************/
+
+/* pull most of the logic to here to avoid having to unlock at every
+ * error exit point and re-use mostly shared logic */
+static exr_result_t
+write_scan_chunk (
+    struct _internal_exr_context*     pctxt,
+    int                               part_index,
+    struct _internal_exr_part*        part,
+    int                               y,
+    const void*                       packed_data,
+    uint64_t                          packed_size,
+    uint64_t                          unpacked_size,
+    const void*                       sample_data,
+    uint64_t                          sample_data_size,
+    internal_exr_chunk_reservation_t* reserve)
+{
+    int32_t data[3];
+    int32_t psize;
+    int     cidx, lpc, miny, wrcnt;
 
     if (pctxt->mode != EXR_CONTEXT_WRITING_DATA)
     {
@@ -1239,65 +1626,18 @@ write_scan_chunk (
     }
     priv_from_native32 (data, wrcnt);
 
-    rv = alloc_chunk_table (pctxt, part, &ctable);
-    if (rv != EXR_ERR_SUCCESS) return rv;
-
-    ctable[cidx] = pctxt->output_file_offset;
-    rv           = pctxt->do_write (
+    return output_chunk (
         pctxt,
+        part,
+        cidx,
         data,
-        (uint64_t) (wrcnt) * sizeof (int32_t),
-        &(pctxt->output_file_offset));
-    if (rv == EXR_ERR_SUCCESS &&
-        part->storage_mode == EXR_STORAGE_DEEP_SCANLINE)
-    {
-        int64_t ddata[3];
-        ddata[0] = (int64_t) sample_data_size;
-        ddata[1] = (int64_t) packed_size;
-        ddata[2] = (int64_t) unpacked_size;
-        rv       = pctxt->do_write (
-            pctxt, ddata, 3 * sizeof (uint64_t), &(pctxt->output_file_offset));
-
-        if (rv == EXR_ERR_SUCCESS)
-            rv = pctxt->do_write (
-                pctxt,
-                sample_data,
-                sample_data_size,
-                &(pctxt->output_file_offset));
-    }
-    if (rv == EXR_ERR_SUCCESS && packed_size > 0)
-        rv = pctxt->do_write (
-            pctxt, packed_data, packed_size, &(pctxt->output_file_offset));
-
-    if (rv == EXR_ERR_SUCCESS)
-    {
-        ++(pctxt->output_chunk_count);
-        if (pctxt->output_chunk_count == part->chunk_count)
-        {
-            uint64_t chunkoff = part->chunk_table_offset;
-
-            ++(pctxt->cur_output_part);
-            if (pctxt->cur_output_part == pctxt->num_parts)
-                pctxt->mode = EXR_CONTEXT_WRITE_FINISHED;
-            pctxt->last_output_chunk  = -1;
-            pctxt->output_chunk_count = 0;
-
-            priv_from_native64 (ctable, part->chunk_count);
-            rv = pctxt->do_write (
-                pctxt,
-                ctable,
-                sizeof (uint64_t) * (uint64_t) (part->chunk_count),
-                &chunkoff);
-            /* just in case we look at it again? */
-            priv_to_native64 (ctable, part->chunk_count);
-        }
-        else
-        {
-            pctxt->last_output_chunk = cidx;
-        }
-    }
-
-    return rv;
+        wrcnt,
+        packed_data,
+        packed_size,
+        unpacked_size,
+        sample_data,
+        sample_data_size,
+        reserve);
 }
 
 /**************************************/
@@ -1529,7 +1869,7 @@ exr_write_scanline_chunk (
             pctxt->standard_error (pctxt, EXR_ERR_USE_SCAN_DEEP_WRITE));
 
     rv = write_scan_chunk (
-        pctxt, part_index, part, y, packed_data, packed_size, 0, NULL, 0);
+        pctxt, part_index, part, y, packed_data, packed_size, 0, NULL, 0, NULL);
     return EXR_UNLOCK_AND_RETURN_PCTXT (rv);
 }
 
@@ -1562,7 +1902,8 @@ exr_write_deep_scanline_chunk (
         packed_size,
         unpacked_size,
         sample_data,
-        sample_data_size);
+        sample_data_size,
+        NULL);
     return EXR_UNLOCK_AND_RETURN_PCTXT (rv);
 }
 
@@ -1572,24 +1913,24 @@ exr_write_deep_scanline_chunk (
  * error exit point and re-use mostly shared logic */
 static exr_result_t
 write_tile_chunk (
-    struct _internal_exr_context* pctxt,
-    int                           part_index,
-    struct _internal_exr_part*    part,
-    int                           tilex,
-    int                           tiley,
-    int                           levelx,
-    int                           levely,
-    const void*                   packed_data,
-    uint64_t                      packed_size,
-    uint64_t                      unpacked_size,
-    const void*                   sample_data,
-    uint64_t                      sample_data_size)
+    struct _internal_exr_context*     pctxt,
+    int                               part_index,
+    struct _internal_exr_part*        part,
+    int                               tilex,
+    int                               tiley,
+    int                               levelx,
+    int                               levely,
+    const void*                       packed_data,
+    uint64_t                          packed_size,
+    uint64_t                          unpacked_size,
+    const void*                       sample_data,
+    uint64_t                          sample_data_size,
+    internal_exr_chunk_reservation_t* reserve)
 {
     exr_result_t rv;
     int32_t      data[6];
     int32_t      psize;
     int          cidx, wrcnt;
-    uint64_t*    ctable;
 
     if (pctxt->mode != EXR_CONTEXT_WRITING_DATA)
     {
@@ -1684,64 +2025,18 @@ write_tile_chunk (
 
     priv_from_native32 (data, wrcnt);
 
-    rv = alloc_chunk_table (pctxt, part, &ctable);
-    if (rv != EXR_ERR_SUCCESS) return rv;
-
-    ctable[cidx] = pctxt->output_file_offset;
-    rv           = pctxt->do_write (
+    return output_chunk (
         pctxt,
+        part,
+        cidx,
         data,
-        (uint64_t) (wrcnt) * sizeof (int32_t),
-        &(pctxt->output_file_offset));
-    if (rv == EXR_ERR_SUCCESS && part->storage_mode == EXR_STORAGE_DEEP_TILED)
-    {
-        int64_t ddata[3];
-        ddata[0] = (int64_t) sample_data_size;
-        ddata[1] = (int64_t) packed_size;
-        ddata[2] = (int64_t) unpacked_size;
-        rv       = pctxt->do_write (
-            pctxt, ddata, 3 * sizeof (uint64_t), &(pctxt->output_file_offset));
-
-        if (rv == EXR_ERR_SUCCESS)
-            rv = pctxt->do_write (
-                pctxt,
-                sample_data,
-                sample_data_size,
-                &(pctxt->output_file_offset));
-    }
-    if (rv == EXR_ERR_SUCCESS)
-        rv = pctxt->do_write (
-            pctxt, packed_data, packed_size, &(pctxt->output_file_offset));
-
-    if (rv == EXR_ERR_SUCCESS)
-    {
-        ++(pctxt->output_chunk_count);
-        if (pctxt->output_chunk_count == part->chunk_count)
-        {
-            uint64_t chunkoff = part->chunk_table_offset;
-
-            ++(pctxt->cur_output_part);
-            if (pctxt->cur_output_part == pctxt->num_parts)
-                pctxt->mode = EXR_CONTEXT_WRITE_FINISHED;
-            pctxt->last_output_chunk  = -1;
-            pctxt->output_chunk_count = 0;
-
-            priv_from_native64 (ctable, part->chunk_count);
-            rv = pctxt->do_write (
-                pctxt,
-                ctable,
-                sizeof (uint64_t) * (uint64_t) (part->chunk_count),
-                &chunkoff);
-            /* just in case we look at it again? */
-            priv_to_native64 (ctable, part->chunk_count);
-        }
-        else
-        {
-            pctxt->last_output_chunk = cidx;
-        }
-    }
-
-    return rv;
+        wrcnt,
+        packed_data,
+        packed_size,
+        unpacked_size,
+        sample_data,
+        sample_data_size,
+        reserve);
 }
 
 /**************************************/
@@ -1776,7 +2071,8 @@ exr_write_tile_chunk (
         packed_size,
         0,
         NULL,
-        0);
+        0,
+        NULL);
     return EXR_UNLOCK_AND_RETURN_PCTXT (rv);
 }
 
@@ -1815,12 +2111,95 @@ exr_write_deep_tile_chunk (
         packed_size,
         unpacked_size,
         sample_data,
-        sample_data_size);
+        sample_data_size,
+        NULL);
     return EXR_UNLOCK_AND_RETURN_PCTXT (rv);
 }
 
 /**************************************/
 
+exr_result_t
+internal_exr_reserve_chunk (
+    exr_encode_pipeline_t* encode, internal_exr_chunk_reservation_t* reserve)
+{
+    exr_result_t rv;
+    EXR_PROMOTE_LOCKED_CONTEXT_AND_PART_OR_ERROR (
+        EXR_CONST_CAST (exr_context_t, encode->context), encode->part_index);
+
+    switch (encode->chunk.type)
+    {
+        case EXR_STORAGE_SCANLINE:
+        case EXR_STORAGE_DEEP_SCANLINE:
+            rv = write_scan_chunk (
+                pctxt,
+                encode->part_index,
+                part,
+                encode->chunk.start_y,
+                encode->compressed_buffer,
+                encode->compressed_bytes,
+                encode->packed_bytes,
+                encode->packed_sample_count_table,
+                encode->packed_sample_count_bytes,
+                reserve);
+            break;
+        case EXR_STORAGE_TILED:
+        case EXR_STORAGE_DEEP_TILED:
+            rv = write_tile_chunk (
+                pctxt,
+                encode->part_index,
+                part,
+                encode->chunk.start_x,
+                encode->chunk.start_y,
+                encode->chunk.level_x,
+                encode->chunk.level_y,
+                encode->compressed_buffer,
+                encode->compressed_bytes,
+                encode->packed_bytes,
+                encode->packed_sample_count_table,
+                encode->packed_sample_count_bytes,
+                reserve);
+            break;
+        case EXR_STORAGE_LAST_TYPE:
+        default:
+            rv = pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+            break;
+    }
+    return EXR_UNLOCK_AND_RETURN_PCTXT (rv);
+}
+
+/**************************************/
+
+exr_result_t
+internal_exr_write_reserved_chunk (
+    const exr_encode_pipeline_t*            encode,
+    const internal_exr_chunk_reservation_t* reserve)
+{
+    struct _internal_exr_context* pctxt;
+    uint64_t                      offset;
+    int                           isdeep;
+
+    if (!encode || !reserve) return EXR_ERR_INVALID_ARGUMENT;
+
+    pctxt  = EXR_CTXT (EXR_CONST_CAST (exr_context_t, encode->context));
+    isdeep = (encode->chunk.type == EXR_STORAGE_DEEP_SCANLINE ||
+              encode->chunk.type == EXR_STORAGE_DEEP_TILED);
+    offset = reserve->offset;
+
+    return write_chunk_data (
+        pctxt,
+        isdeep,
+        reserve->header,
+        reserve->header_count,
+        encode->compressed_buffer,
+        encode->compressed_bytes,
+        encode->packed_bytes,
+        encode->packed_sample_count_table,
+        encode->packed_sample_count_bytes,
+        &offset);
+}
+
+/**************************************/
+
 exr_result_t
 internal_validate_next_chunk (
     exr_encode_pipeline_t*              encode,
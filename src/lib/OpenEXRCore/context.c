@@ -248,6 +248,14 @@ exr_start_read (
                 {
                     inits.size_fn = &default_query_size_func;
                     rv            = default_init_read_file (ret);
+                    /* the alternate backends are an optimization, if
+                     * one can not be set up, keep the default reads */
+                    if (rv == EXR_ERR_SUCCESS &&
+                        inits.size >=
+                            (offsetof (exr_context_initializer_t, read_mode) +
+                             sizeof (inits.read_mode)) &&
+                        inits.read_mode != EXR_READ_FILE_DEFAULT)
+                        (void) default_init_read_backend (ret, inits.read_mode);
                 }
 
                 if (rv == EXR_ERR_SUCCESS)
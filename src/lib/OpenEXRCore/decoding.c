@@ -8,6 +8,7 @@
 #include "internal_coding.h"
 #include "internal_decompress.h"
 #include "internal_structs.h"
+#include "internal_workers.h"
 #include "internal_xdr.h"
 
 #include <stdio.h>
@@ -186,6 +187,26 @@ default_read_chunk (exr_decode_pipeline_t* decode)
     }
     else
     {
+        /* when the file is mapped, point the packed buffer straight at
+         * the file data (borrowed, so an alloc size of 0). B44 may
+         * decompress in place when the packed and unpacked sizes
+         * match, so it still needs a writable copy */
+        if (pctxt->mapped_data && part->comp_type != EXR_COMPRESSION_B44 &&
+            part->comp_type != EXR_COMPRESSION_B44A &&
+            decode->chunk.data_offset <= pctxt->mapped_size &&
+            decode->chunk.packed_size <=
+                pctxt->mapped_size - decode->chunk.data_offset)
+        {
+            internal_decode_free_buffer (
+                decode,
+                EXR_TRANSCODE_BUFFER_PACKED,
+                &(decode->packed_buffer),
+                &(decode->packed_alloc_size));
+            decode->packed_buffer = EXR_CONST_CAST (
+                void*, pctxt->mapped_data + decode->chunk.data_offset);
+            return EXR_ERR_SUCCESS;
+        }
+
         rv = internal_decode_alloc_buffer (
             decode,
             EXR_TRANSCODE_BUFFER_PACKED,
@@ -204,7 +225,7 @@ default_read_chunk (exr_decode_pipeline_t* decode)
 }
 
 static exr_result_t
-decompress_data (
+undo_compression (
     const struct _internal_exr_context* pctxt,
     const exr_compression_t             ctype,
     exr_decode_pipeline_t*              decode,
@@ -215,16 +236,6 @@ decompress_data (
 {
     exr_result_t rv;
 
-    if (packsz == 0) return EXR_ERR_SUCCESS;
-
-    if (packsz == unpacksz && ctype != EXR_COMPRESSION_B44 &&
-        ctype != EXR_COMPRESSION_B44A)
-    {
-        if (unpackbufptr != packbufptr)
-            memcpy (unpackbufptr, packbufptr, unpacksz);
-        return EXR_ERR_SUCCESS;
-    }
-
     switch (ctype)
     {
         case EXR_COMPRESSION_NONE:
@@ -278,6 +289,30 @@ decompress_data (
     return rv;
 }
 
+static exr_result_t
+decompress_data (
+    const struct _internal_exr_context* pctxt,
+    const exr_compression_t             ctype,
+    exr_decode_pipeline_t*              decode,
+    void*                               packbufptr,
+    size_t                              packsz,
+    void*                               unpackbufptr,
+    size_t                              unpacksz)
+{
+    if (packsz == 0) return EXR_ERR_SUCCESS;
+
+    if (packsz == unpacksz && ctype != EXR_COMPRESSION_B44 &&
+        ctype != EXR_COMPRESSION_B44A)
+    {
+        if (unpackbufptr != packbufptr)
+            memcpy (unpackbufptr, packbufptr, unpacksz);
+        return EXR_ERR_SUCCESS;
+    }
+
+    return undo_compression (
+        pctxt, ctype, decode, packbufptr, packsz, unpackbufptr, unpacksz);
+}
+
 static exr_result_t
 default_decompress_chunk (exr_decode_pipeline_t* decode)
 {
@@ -293,14 +328,51 @@ default_decompress_chunk (exr_decode_pipeline_t* decode)
              ((uint64_t) decode->chunk.height));
         sampsize *= sizeof (int32_t);
 
-        rv = decompress_data (
-            pctxt,
-            part->comp_type,
-            decode,
-            decode->packed_sample_count_table,
-            decode->chunk.sample_count_table_size,
-            decode->sample_count_table,
-            sampsize);
+        if (part->storage_mode == EXR_STORAGE_DEEP_TILED && part->tiles &&
+            decode->chunk.sample_count_table_size > 0)
+        {
+            /* tables which do not compress below the size of a full
+             * tile are stored as is, padded to that size for the tiles
+             * at the edge of the data window, so a smaller table is
+             * compressed even when it is the size of the edge tile's */
+            uint64_t fullsize = ((uint64_t) part->tiles->tiledesc->x_size) *
+                                ((uint64_t) part->tiles->tiledesc->y_size) *
+                                sizeof (int32_t);
+
+            if ((part->comp_type == EXR_COMPRESSION_NONE ||
+                 decode->chunk.sample_count_table_size >= fullsize) &&
+                decode->chunk.sample_count_table_size >= sampsize)
+            {
+                if (decode->sample_count_table !=
+                    decode->packed_sample_count_table)
+                    memcpy (
+                        decode->sample_count_table,
+                        decode->packed_sample_count_table,
+                        sampsize);
+            }
+            else
+            {
+                rv = undo_compression (
+                    pctxt,
+                    part->comp_type,
+                    decode,
+                    decode->packed_sample_count_table,
+                    decode->chunk.sample_count_table_size,
+                    decode->sample_count_table,
+                    sampsize);
+            }
+        }
+        else
+        {
+            rv = decompress_data (
+                pctxt,
+                part->comp_type,
+                decode,
+                decode->packed_sample_count_table,
+                decode->chunk.sample_count_table_size,
+                decode->sample_count_table,
+                sampsize);
+        }
 
         if (rv != EXR_ERR_SUCCESS)
         {
@@ -562,7 +634,9 @@ exr_decoding_choose_default_routines (
         return EXR_ERR_SUCCESS;
     }
     decode->read_fn = &default_read_chunk;
-    if (part->comp_type != EXR_COMPRESSION_NONE)
+    /* deep sample count tables may be padded, or need a separate
+     * buffer, even when the part is not compressed */
+    if (isdeep || part->comp_type != EXR_COMPRESSION_NONE)
         decode->decompress_fn = &default_decompress_chunk;
 
     decode->unpack_and_convert_fn = internal_exr_match_decode (
@@ -736,3 +810,389 @@ exr_decoding_destroy (exr_const_context_t ctxt, exr_decode_pipeline_t* decode)
     }
     return EXR_ERR_SUCCESS;
 }
+
+/**************************************/
+
+/*
+ * Maps a chunk index to the chunk it refers to, in chunk table
+ * order, and reads the chunk info for it.
+ */
+static exr_result_t
+read_chunk_info_by_index (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    int                                 part_index,
+    int                                 chunk_index,
+    exr_chunk_info_t*                   cinfo)
+{
+    const exr_attr_tiledesc_t* tiledesc;
+    int64_t                    remaining = chunk_index;
+
+    if (part->storage_mode == EXR_STORAGE_SCANLINE ||
+        part->storage_mode == EXR_STORAGE_DEEP_SCANLINE)
+    {
+        int64_t y = (int64_t) part->data_window.min.y +
+                    remaining * (int64_t) part->lines_per_chunk;
+        return exr_read_scanline_chunk_info (
+            (exr_const_context_t) pctxt, part_index, (int) y, cinfo);
+    }
+
+    if (!part->tiles || !part->tile_level_tile_count_x ||
+        !part->tile_level_tile_count_y)
+        return pctxt->print_error (
+            pctxt, EXR_ERR_MISSING_REQ_ATTR, "Tile data missing or corrupt");
+
+    tiledesc = part->tiles->tiledesc;
+    for (int ly = 0; ly < part->num_tile_levels_y; ++ly)
+    {
+        for (int lx = 0; lx < part->num_tile_levels_x; ++lx)
+        {
+            int64_t numx, numy;
+
+            if (EXR_GET_TILE_LEVEL_MODE ((*tiledesc)) !=
+                    EXR_TILE_RIPMAP_LEVELS &&
+                lx != ly)
+                continue;
+
+            numx = part->tile_level_tile_count_x[lx];
+            numy = part->tile_level_tile_count_y[ly];
+            if (remaining < numx * numy)
+            {
+                return exr_read_tile_chunk_info (
+                    (exr_const_context_t) pctxt,
+                    part_index,
+                    (int) (remaining % numx),
+                    (int) (remaining / numx),
+                    lx,
+                    ly,
+                    cinfo);
+            }
+            remaining -= numx * numy;
+        }
+    }
+
+    return pctxt->print_error (
+        pctxt,
+        EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+        "Chunk index %d past the tiles available",
+        chunk_index);
+}
+
+typedef struct
+{
+    const struct _internal_exr_context* pctxt;
+    const struct _internal_exr_part*    part;
+    int                                 part_index;
+    int                                 first_chunk;
+    int                                 num_chunks;
+    exr_decode_chunk_setup_func_t       setup_fn;
+    void*                               user_data;
+    int32_t* const*                     sample_counts;
+    uint16_t                            sample_count_flags;
+    exr_result_t*                       chunk_results;
+    exr_decode_pipeline_t*              pipelines;
+    atomic_uintptr_t                    next_chunk;
+} parallel_decode_t;
+
+/*
+ * Only reads the sample count table of the chunk, leaving the packed
+ * pixel data untouched, and copies the unpacked table out.
+ */
+static exr_result_t
+read_one_sample_count_table (
+    parallel_decode_t* pd, exr_decode_pipeline_t* decode, int32_t* counts)
+{
+    exr_result_t        rv;
+    exr_const_context_t ctxt = (exr_const_context_t) pd->pctxt;
+
+    if (!counts)
+        return pd->pctxt->report_error (
+            pd->pctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Missing destination for sample count table");
+
+    decode->decode_flags =
+        EXR_DECODE_SAMPLE_DATA_ONLY |
+        (pd->sample_count_flags & EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL);
+    decode->read_fn       = &default_read_chunk;
+    decode->decompress_fn = &default_decompress_chunk;
+
+    rv = exr_decoding_run (ctxt, pd->part_index, decode);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    memcpy (
+        counts,
+        decode->sample_count_table,
+        ((size_t) decode->chunk.width) * ((size_t) decode->chunk.height) *
+            sizeof (int32_t));
+    return EXR_ERR_SUCCESS;
+}
+
+/*
+ * Fills in the default routines for those the setup function did
+ * not provide. If it provided any, the chunk is always read into the
+ * packed buffer, as the custom routines expect.
+ */
+static exr_result_t
+choose_missing_routines (parallel_decode_t* pd, exr_decode_pipeline_t* decode)
+{
+    exr_result_t rv;
+    exr_result_t (*read_fn) (exr_decode_pipeline_t*) = decode->read_fn;
+    exr_result_t (*decompress_fn) (exr_decode_pipeline_t*) =
+        decode->decompress_fn;
+    exr_result_t (*unpack_and_convert_fn) (exr_decode_pipeline_t*) =
+        decode->unpack_and_convert_fn;
+
+    if (read_fn && decompress_fn && unpack_and_convert_fn)
+        return EXR_ERR_SUCCESS;
+
+    rv = exr_decoding_choose_default_routines (
+        (exr_const_context_t) pd->pctxt, pd->part_index, decode);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    if (!read_fn && !decompress_fn && !unpack_and_convert_fn)
+        return EXR_ERR_SUCCESS;
+
+    if (read_fn)
+        decode->read_fn = read_fn;
+    else if (decode->read_fn == &read_uncompressed_direct)
+        decode->read_fn = &default_read_chunk;
+
+    if (decompress_fn) decode->decompress_fn = decompress_fn;
+    if (unpack_and_convert_fn)
+        decode->unpack_and_convert_fn = unpack_and_convert_fn;
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+decode_one_chunk (
+    parallel_decode_t* pd, exr_decode_pipeline_t* decode, int chunk_index)
+{
+    exr_result_t        rv;
+    exr_chunk_info_t    cinfo;
+    exr_const_context_t ctxt = (exr_const_context_t) pd->pctxt;
+
+    rv = read_chunk_info_by_index (
+        pd->pctxt, pd->part, pd->part_index, chunk_index, &cinfo);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    /* the first chunk for this worker creates the pipeline, the rest
+     * re-use the buffers */
+    if (decode->context == NULL)
+        rv = exr_decoding_initialize (ctxt, pd->part_index, &cinfo, decode);
+    else
+        rv = exr_decoding_update (ctxt, pd->part_index, &cinfo, decode);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    if (pd->sample_counts)
+        return read_one_sample_count_table (
+            pd, decode, pd->sample_counts[chunk_index - pd->first_chunk]);
+
+    /* the pipeline still holds the routines of the previous chunk */
+    decode->read_fn               = NULL;
+    decode->decompress_fn         = NULL;
+    decode->unpack_and_convert_fn = NULL;
+
+    rv = pd->setup_fn (decode, chunk_index, pd->user_data);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = choose_missing_routines (pd, decode);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    return exr_decoding_run (ctxt, pd->part_index, decode);
+}
+
+static void
+parallel_decode_task (int task_index, void* task_data)
+{
+    parallel_decode_t*     pd     = (parallel_decode_t*) task_data;
+    exr_decode_pipeline_t* decode = pd->pipelines + task_index;
+
+    for (;;)
+    {
+        uint64_t idx = internal_exr_atomic_next (&(pd->next_chunk));
+
+        if (idx >= (uint64_t) pd->num_chunks) break;
+
+        pd->chunk_results[idx] =
+            decode_one_chunk (pd, decode, pd->first_chunk + (int) idx);
+    }
+}
+
+static exr_result_t
+run_chunks_parallel (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    int                                 part_index,
+    int                                 first_chunk,
+    int                                 num_chunks,
+    parallel_decode_t*                  pd,
+    const exr_worker_pool_t*            pool,
+    int                                 max_workers,
+    exr_result_t*                       chunk_results)
+{
+    exr_result_t             rv;
+    exr_const_context_t      ctxt = (exr_const_context_t) pctxt;
+    const exr_worker_pool_t* usepool;
+    int                      ntasks;
+    exr_result_t*            results;
+
+    if (first_chunk < 0 || num_chunks < 0 ||
+        (int64_t) first_chunk + (int64_t) num_chunks >
+            (int64_t) part->chunk_count)
+        return pctxt->print_error (
+            pctxt,
+            EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+            "Chunk range %d + %d out of range for part with %d chunks",
+            first_chunk,
+            num_chunks,
+            part->chunk_count);
+
+    if (num_chunks == 0) return EXR_ERR_SUCCESS;
+
+    rv = internal_exr_choose_workers (
+        pctxt, pool, max_workers, num_chunks, &usepool, &ntasks);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    results = chunk_results;
+    if (!results)
+    {
+        results = pctxt->alloc_fn (sizeof (exr_result_t) * (size_t) num_chunks);
+        if (!results) return pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+    }
+
+    pd->pipelines =
+        pctxt->alloc_fn (sizeof (exr_decode_pipeline_t) * (size_t) ntasks);
+    if (!pd->pipelines)
+    {
+        if (results != chunk_results) pctxt->free_fn (results);
+        return pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+    }
+    memset (pd->pipelines, 0, sizeof (exr_decode_pipeline_t) * (size_t) ntasks);
+
+    /* chunks a worker never gets to (i.e. the pool failing) are
+     * reported as such */
+    for (int c = 0; c < num_chunks; ++c)
+        results[c] = EXR_ERR_UNKNOWN;
+
+    pd->pctxt         = pctxt;
+    pd->part          = part;
+    pd->part_index    = part_index;
+    pd->first_chunk   = first_chunk;
+    pd->num_chunks    = num_chunks;
+    pd->chunk_results = results;
+#ifdef EXR_HAS_STD_ATOMICS
+    atomic_init (&(pd->next_chunk), 0);
+#else
+    pd->next_chunk = 0;
+#endif
+
+    rv = usepool->run_tasks (
+        usepool->pool_data, ntasks, &parallel_decode_task, pd);
+
+    for (int t = 0; t < ntasks; ++t)
+    {
+        if (pd->pipelines[t].context)
+            exr_decoding_destroy (ctxt, pd->pipelines + t);
+    }
+    pctxt->free_fn (pd->pipelines);
+
+    if (rv == EXR_ERR_SUCCESS)
+    {
+        for (int c = 0; c < num_chunks; ++c)
+        {
+            if (results[c] != EXR_ERR_SUCCESS)
+            {
+                rv = results[c];
+                break;
+            }
+        }
+    }
+    else
+        rv = pctxt->report_error (
+            pctxt, rv, "Worker pool unable to run decode tasks");
+
+    if (results != chunk_results) pctxt->free_fn (results);
+    return rv;
+}
+
+exr_result_t
+exr_decode_chunks_parallel (
+    exr_const_context_t           ctxt,
+    int                           part_index,
+    int                           first_chunk,
+    int                           num_chunks,
+    exr_decode_chunk_setup_func_t setup_fn,
+    void*                         user_data,
+    const exr_worker_pool_t*      pool,
+    int                           max_workers,
+    exr_result_t*                 chunk_results)
+{
+    parallel_decode_t pd;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (!setup_fn)
+        return pctxt->report_error (
+            pctxt, EXR_ERR_INVALID_ARGUMENT, "Missing chunk setup function");
+
+    pd.setup_fn           = setup_fn;
+    pd.user_data          = user_data;
+    pd.sample_counts      = NULL;
+    pd.sample_count_flags = 0;
+
+    return run_chunks_parallel (
+        pctxt,
+        part,
+        part_index,
+        first_chunk,
+        num_chunks,
+        &pd,
+        pool,
+        max_workers,
+        chunk_results);
+}
+
+exr_result_t
+exr_read_sample_counts_parallel (
+    exr_const_context_t      ctxt,
+    int                      part_index,
+    int                      first_chunk,
+    int                      num_chunks,
+    uint16_t                 flags,
+    int32_t* const*          sample_counts,
+    const exr_worker_pool_t* pool,
+    int                      max_workers,
+    exr_result_t*            chunk_results)
+{
+    parallel_decode_t pd;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (part->storage_mode != EXR_STORAGE_DEEP_SCANLINE &&
+        part->storage_mode != EXR_STORAGE_DEEP_TILED)
+        return pctxt->report_error (
+            pctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Sample counts requested from a part which is not deep");
+
+    if (!sample_counts && num_chunks > 0)
+        return pctxt->report_error (
+            pctxt,
+            EXR_ERR_INVALID_ARGUMENT,
+            "Missing destination for sample count tables");
+
+    pd.setup_fn           = NULL;
+    pd.user_data          = NULL;
+    pd.sample_counts      = sample_counts;
+    pd.sample_count_flags = flags;
+
+    return run_chunks_parallel (
+        pctxt,
+        part,
+        part_index,
+        first_chunk,
+        num_chunks,
+        &pd,
+        pool,
+        max_workers,
+        chunk_results);
+}
@@ -8,8 +8,11 @@
 #include "internal_coding.h"
 #include "internal_compress.h"
 #include "internal_structs.h"
+#include "internal_workers.h"
 #include "internal_xdr.h"
 
+#include <string.h>
+
 /**************************************/
 
 static exr_result_t
@@ -460,3 +463,385 @@ exr_encoding_destroy (exr_const_context_t ctxt, exr_encode_pipeline_t* encode)
     }
     return EXR_UNLOCK_WRITE_AND_RETURN_PCTXT (EXR_ERR_SUCCESS);
 }
+
+/**************************************/
+
+static exr_result_t
+write_chunk_info_by_index (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    int                                 part_index,
+    int                                 chunk_index,
+    exr_chunk_info_t*                   cinfo)
+{
+    const exr_attr_tiledesc_t* tiledesc;
+    int64_t                    remaining = chunk_index;
+    exr_context_t              ctxt = EXR_CONST_CAST (exr_context_t, pctxt);
+
+    if (part->storage_mode == EXR_STORAGE_SCANLINE ||
+        part->storage_mode == EXR_STORAGE_DEEP_SCANLINE)
+    {
+        int64_t y = (int64_t) part->data_window.min.y +
+                    remaining * (int64_t) part->lines_per_chunk;
+        return exr_write_scanline_chunk_info (ctxt, part_index, (int) y, cinfo);
+    }
+
+    if (!part->tiles || !part->tile_level_tile_count_x ||
+        !part->tile_level_tile_count_y)
+        return pctxt->print_error (
+            pctxt, EXR_ERR_MISSING_REQ_ATTR, "Tile data missing or corrupt");
+
+    tiledesc = part->tiles->tiledesc;
+    for (int ly = 0; ly < part->num_tile_levels_y; ++ly)
+    {
+        for (int lx = 0; lx < part->num_tile_levels_x; ++lx)
+        {
+            int64_t numx, numy;
+
+            if (EXR_GET_TILE_LEVEL_MODE ((*tiledesc)) !=
+                    EXR_TILE_RIPMAP_LEVELS &&
+                lx != ly)
+                continue;
+
+            numx = part->tile_level_tile_count_x[lx];
+            numy = part->tile_level_tile_count_y[ly];
+            if (remaining < numx * numy)
+            {
+                return exr_write_tile_chunk_info (
+                    ctxt,
+                    part_index,
+                    (int) (remaining % numx),
+                    (int) (remaining / numx),
+                    lx,
+                    ly,
+                    cinfo);
+            }
+            remaining -= numx * numy;
+        }
+    }
+
+    return pctxt->print_error (
+        pctxt,
+        EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+        "Chunk index %d past the tiles available",
+        chunk_index);
+}
+
+/*
+ * Chunks are handed out to the workers in increasing order, each
+ * worker compresses its chunk, then hands it to the commit step,
+ * which claims the space for the chunk in the file and fills in the
+ * chunk table under the context lock. The chunk data is then written
+ * outside the lock, so workers write to the file concurrently.
+ *
+ * For parts with a line order other than random, the commit step
+ * takes the chunks in chunk table order (a worker waits for the
+ * chunks before it to be committed, which only blocks on another
+ * worker actively processing an earlier chunk), otherwise chunks are
+ * committed in whatever order they finish.
+ */
+typedef struct
+{
+    const struct _internal_exr_context* pctxt;
+    const struct _internal_exr_part*    part;
+    int                                 part_index;
+    int                                 first_chunk;
+    int                                 num_chunks;
+    int                                 ordered;
+    exr_encode_chunk_setup_func_t       setup_fn;
+    void*                               user_data;
+    exr_result_t*                       chunk_results;
+    struct _parallel_encoder*           encoders;
+    atomic_uintptr_t                    next_chunk;
+
+    /* next chunk (relative to first_chunk) allowed to commit when
+     * ordered, protected by commit_mutex */
+    int next_commit;
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    CRITICAL_SECTION   commit_mutex;
+    CONDITION_VARIABLE commit_cond;
+#    else
+    pthread_mutex_t commit_mutex;
+    pthread_cond_t  commit_cond;
+#    endif
+#endif
+} parallel_encode_t;
+
+typedef struct _parallel_encoder
+{
+    /* first so the pipeline passed to write_fn can be cast back */
+    exr_encode_pipeline_t encode;
+    parallel_encode_t*    pd;
+    int                   idx;
+    int                   committed;
+} parallel_encoder_t;
+
+static void
+wait_for_commit_turn (parallel_encode_t* pd, int idx)
+{
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    EnterCriticalSection (&pd->commit_mutex);
+    while (pd->next_commit != idx)
+        SleepConditionVariableCS (
+            &pd->commit_cond, &pd->commit_mutex, INFINITE);
+    LeaveCriticalSection (&pd->commit_mutex);
+#    else
+    pthread_mutex_lock (&pd->commit_mutex);
+    while (pd->next_commit != idx)
+        pthread_cond_wait (&pd->commit_cond, &pd->commit_mutex);
+    pthread_mutex_unlock (&pd->commit_mutex);
+#    endif
+#else
+    /* a single task processes the chunks in order, see
+     * exr_encode_chunks_parallel */
+    (void) pd;
+    (void) idx;
+#endif
+}
+
+static void
+end_commit_turn (parallel_encode_t* pd, int idx)
+{
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    EnterCriticalSection (&pd->commit_mutex);
+    pd->next_commit = idx + 1;
+    LeaveCriticalSection (&pd->commit_mutex);
+    WakeAllConditionVariable (&pd->commit_cond);
+#    else
+    pthread_mutex_lock (&pd->commit_mutex);
+    pd->next_commit = idx + 1;
+    pthread_cond_broadcast (&pd->commit_cond);
+    pthread_mutex_unlock (&pd->commit_mutex);
+#    endif
+#else
+    pd->next_commit = idx + 1;
+#endif
+}
+
+static exr_result_t
+parallel_commit_chunk (exr_encode_pipeline_t* encode)
+{
+    exr_result_t                     rv;
+    internal_exr_chunk_reservation_t reserve;
+    parallel_encoder_t*              enc = (parallel_encoder_t*) encode;
+    parallel_encode_t*               pd  = enc->pd;
+
+    if (pd->ordered) wait_for_commit_turn (pd, enc->idx);
+
+    rv = internal_exr_reserve_chunk (encode, &reserve);
+
+    /* once the space is claimed, the next chunk can commit while this
+     * one is being written */
+    if (pd->ordered) end_commit_turn (pd, enc->idx);
+    enc->committed = 1;
+
+    if (rv == EXR_ERR_SUCCESS)
+        rv = internal_exr_write_reserved_chunk (encode, &reserve);
+    return rv;
+}
+
+static exr_result_t
+encode_one_chunk (parallel_encode_t* pd, parallel_encoder_t* enc)
+{
+    exr_result_t           rv;
+    exr_chunk_info_t       cinfo;
+    exr_encode_pipeline_t* encode = &(enc->encode);
+    exr_const_context_t    ctxt   = (exr_const_context_t) pd->pctxt;
+    int                    chunk_index = pd->first_chunk + enc->idx;
+
+    rv = write_chunk_info_by_index (
+        pd->pctxt, pd->part, pd->part_index, chunk_index, &cinfo);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    /* the first chunk for this worker creates the pipeline, the rest
+     * re-use the buffers */
+    if (encode->context == NULL)
+        rv = exr_encoding_initialize (ctxt, pd->part_index, &cinfo, encode);
+    else
+        rv = exr_encoding_update (ctxt, pd->part_index, &cinfo, encode);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = pd->setup_fn (encode, chunk_index, pd->user_data);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = exr_encoding_choose_default_routines (ctxt, pd->part_index, encode);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    /* ordering is handled by the commit step */
+    encode->yield_until_ready_fn = NULL;
+    encode->write_fn             = &parallel_commit_chunk;
+
+    return exr_encoding_run (ctxt, pd->part_index, encode);
+}
+
+static void
+parallel_encode_task (int task_index, void* task_data)
+{
+    parallel_encode_t*  pd  = (parallel_encode_t*) task_data;
+    parallel_encoder_t* enc = pd->encoders + task_index;
+
+    for (;;)
+    {
+        uint64_t idx = internal_exr_atomic_next (&(pd->next_chunk));
+
+        if (idx >= (uint64_t) pd->num_chunks) break;
+
+        enc->pd        = pd;
+        enc->idx       = (int) idx;
+        enc->committed = 0;
+
+        pd->chunk_results[idx] = encode_one_chunk (pd, enc);
+
+        /* a chunk which failed before being committed still has to
+         * give up its turn, the chunks after it then fail with an
+         * incorrect chunk error, as a serial write would */
+        if (pd->ordered && !enc->committed)
+        {
+            wait_for_commit_turn (pd, enc->idx);
+            end_commit_turn (pd, enc->idx);
+        }
+    }
+}
+
+exr_result_t
+exr_encode_chunks_parallel (
+    exr_context_t                 ctxt,
+    int                           part_index,
+    int                           first_chunk,
+    int                           num_chunks,
+    exr_encode_chunk_setup_func_t setup_fn,
+    void*                         user_data,
+    const exr_worker_pool_t*      pool,
+    int                           max_workers,
+    exr_result_t*                 chunk_results)
+{
+    exr_result_t             rv;
+    parallel_encode_t        pd;
+    const exr_worker_pool_t* usepool;
+    int                      ntasks;
+    exr_result_t*            results;
+    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    /* only locked (above) when the header has not been written yet */
+    if (pctxt->mode != EXR_CONTEXT_WRITING_DATA)
+        return EXR_UNLOCK_WRITE_AND_RETURN_PCTXT (pctxt->standard_error (
+            pctxt,
+            pctxt->mode == EXR_CONTEXT_WRITE ? EXR_ERR_HEADER_NOT_WRITTEN
+                                             : EXR_ERR_NOT_OPEN_WRITE));
+
+    if (!setup_fn)
+        return pctxt->report_error (
+            pctxt, EXR_ERR_INVALID_ARGUMENT, "Missing chunk setup function");
+
+    if (first_chunk < 0 || num_chunks < 0 ||
+        (int64_t) first_chunk + (int64_t) num_chunks >
+            (int64_t) part->chunk_count)
+        return pctxt->print_error (
+            pctxt,
+            EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+            "Chunk range %d + %d out of range for part with %d chunks",
+            first_chunk,
+            num_chunks,
+            part->chunk_count);
+
+    if (num_chunks == 0) return EXR_ERR_SUCCESS;
+
+    rv = internal_exr_choose_workers (
+        pctxt, pool, max_workers, num_chunks, &usepool, &ntasks);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+#ifndef ILMTHREAD_THREADING_ENABLED
+    /* without threading support, neither the commit queue nor the
+     * chunk table are locked, so a pool provided by the caller, which
+     * may still run tasks concurrently, is only given a single task,
+     * which encodes and writes the chunks in order */
+    ntasks = 1;
+#endif
+
+    results = chunk_results;
+    if (!results)
+    {
+        results = pctxt->alloc_fn (sizeof (exr_result_t) * (size_t) num_chunks);
+        if (!results) return pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+    }
+
+    pd.encoders =
+        pctxt->alloc_fn (sizeof (parallel_encoder_t) * (size_t) ntasks);
+    if (!pd.encoders)
+    {
+        if (results != chunk_results) pctxt->free_fn (results);
+        return pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+    }
+    memset (pd.encoders, 0, sizeof (parallel_encoder_t) * (size_t) ntasks);
+
+    /* chunks a worker never gets to (i.e. the pool failing) are
+     * reported as such */
+    for (int c = 0; c < num_chunks; ++c)
+        results[c] = EXR_ERR_UNKNOWN;
+
+    pd.pctxt         = pctxt;
+    pd.part          = part;
+    pd.part_index    = part_index;
+    pd.first_chunk   = first_chunk;
+    pd.num_chunks    = num_chunks;
+    pd.ordered       = (part->lineorder != EXR_LINEORDER_RANDOM_Y);
+    pd.setup_fn      = setup_fn;
+    pd.user_data     = user_data;
+    pd.chunk_results = results;
+    pd.next_commit   = 0;
+#ifdef EXR_HAS_STD_ATOMICS
+    atomic_init (&(pd.next_chunk), 0);
+#else
+    pd.next_chunk = 0;
+#endif
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    InitializeCriticalSection (&pd.commit_mutex);
+    InitializeConditionVariable (&pd.commit_cond);
+#    else
+    pthread_mutex_init (&pd.commit_mutex, NULL);
+    pthread_cond_init (&pd.commit_cond, NULL);
+#    endif
+#endif
+
+    rv = usepool->run_tasks (
+        usepool->pool_data, ntasks, &parallel_encode_task, &pd);
+
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    DeleteCriticalSection (&pd.commit_mutex);
+#    else
+    pthread_cond_destroy (&pd.commit_cond);
+    pthread_mutex_destroy (&pd.commit_mutex);
+#    endif
+#endif
+
+    for (int t = 0; t < ntasks; ++t)
+    {
+        if (pd.encoders[t].encode.context)
+            exr_encoding_destroy (
+                (exr_const_context_t) ctxt, &(pd.encoders[t].encode));
+    }
+    pctxt->free_fn (pd.encoders);
+
+    if (rv == EXR_ERR_SUCCESS)
+    {
+        for (int c = 0; c < num_chunks; ++c)
+        {
+            if (results[c] != EXR_ERR_SUCCESS)
+            {
+                rv = results[c];
+                break;
+            }
+        }
+    }
+    else
+        rv = pctxt->report_error (
+            pctxt, rv, "Worker pool unable to run encode tasks");
+
+    if (results != chunk_results) pctxt->free_fn (results);
+    return rv;
+}
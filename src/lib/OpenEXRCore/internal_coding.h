@@ -79,6 +79,29 @@ exr_result_t internal_validate_next_chunk (
     const struct _internal_exr_context* pctxt,
     const struct _internal_exr_part*    part);
 
+/* space claimed in the output file for a chunk, along with the chunk
+ * header (in file byte order), so the data can be written outside of
+ * the context lock */
+typedef struct
+{
+    uint64_t offset;
+    int32_t  header[6];
+    int      header_count;
+    int      chunk_index;
+} internal_exr_chunk_reservation_t;
+
+/* validates the chunk in the encode pipeline as the exr_write_*_chunk
+ * functions do, then (under the context lock) assigns its offset in
+ * the chunk table and records it as written */
+exr_result_t internal_exr_reserve_chunk (
+    exr_encode_pipeline_t* encode, internal_exr_chunk_reservation_t* reserve);
+
+/* writes the chunk data to the reserved space, and may be called
+ * concurrently for different chunks */
+exr_result_t internal_exr_write_reserved_chunk (
+    const exr_encode_pipeline_t*            encode,
+    const internal_exr_chunk_reservation_t* reserve);
+
 /**************************************/
 
 exr_result_t internal_encode_free_buffer (
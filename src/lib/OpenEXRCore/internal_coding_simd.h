@@ -0,0 +1,303 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_PRIVATE_CODING_SIMD_H
+#define OPENEXR_PRIVATE_CODING_SIMD_H
+
+/*
+ * Runtime selected SIMD helpers shared by the unpack (decode) and pack
+ * (encode) stages: the cpu feature check, and bulk half <-> float
+ * conversion of a run of values.
+ *
+ * The vector paths are only used on little endian hosts, where the
+ * file byte order matches memory. Conversions give the same bits as
+ * the scalar half_to_float / float_to_half, except that the hardware
+ * half -> float conversion returns signaling NaN as quiet NaN (as the
+ * F16C path always has). For float -> half, groups containing a NaN
+ * are converted with the scalar routine so the NaN payload is kept.
+ */
+
+#include "internal_coding.h"
+#include "internal_xdr.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !EXR_HOST_IS_NOT_LITTLE_ENDIAN
+#    define EXR_CODING_HAVE_SSE2 1
+#    include <emmintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define EXR_CODING_HAVE_AVX_TARGET 1
+#        define EXR_CODING_TARGET(t) __attribute__ ((target (t)))
+#        include <cpuid.h>
+#        include <immintrin.h>
+#    elif defined(_MSC_VER)
+#        define EXR_CODING_HAVE_AVX_TARGET 1
+#        define EXR_CODING_TARGET(t)
+#        include <immintrin.h>
+#        include <intrin.h>
+#    endif
+#endif
+
+#if (defined(__aarch64__) || defined(_M_ARM64)) && defined(__ARM_NEON) &&     \
+    !EXR_HOST_IS_NOT_LITTLE_ENDIAN
+#    define EXR_CODING_HAVE_NEON 1
+#    include <arm_neon.h>
+#endif
+
+enum _INTERNAL_EXR_CPU_FEATURES
+{
+    EXR_CPU_SSE2     = 1,
+    EXR_CPU_SSSE3    = 2,
+    EXR_CPU_AVX_F16C = 4,
+    EXR_CPU_AVX2     = 8,
+    EXR_CPU_AVX512   = 16,
+    EXR_CPU_NEON     = 32
+};
+
+/* query (once) the vector extensions both the cpu and os support */
+static int
+internal_exr_cpu_features (void)
+{
+    static int features = -1;
+    int        ret;
+
+    if (features >= 0) return features;
+
+    ret = 0;
+#if defined(EXR_CODING_HAVE_AVX_TARGET)
+    {
+        unsigned int regs[4] = {0, 0, 0, 0}, maxleaf = 0;
+        uint64_t     xcr0    = 0;
+
+#    ifdef _MSC_VER
+        int mregs[4];
+        __cpuid (mregs, 0);
+        maxleaf = (unsigned int) mregs[0];
+        if (maxleaf >= 1)
+        {
+            __cpuidex (mregs, 1, 0);
+            for (int i = 0; i < 4; ++i)
+                regs[i] = (unsigned int) mregs[i];
+        }
+#    else
+        if (__get_cpuid (0, &regs[0], &regs[1], &regs[2], &regs[3]))
+            maxleaf = regs[0];
+        if (maxleaf >= 1 &&
+            !__get_cpuid (1, &regs[0], &regs[1], &regs[2], &regs[3]))
+            maxleaf = 0;
+#    endif
+        if (maxleaf >= 1)
+        {
+            if (regs[3] & (1 << 26)) ret |= EXR_CPU_SSE2;
+            if (regs[2] & (1 << 9)) ret |= EXR_CPU_SSSE3;
+
+            /* OSXSAVE, then check the OS saves the vector state */
+            if (regs[2] & (1 << 27))
+            {
+#    ifdef _MSC_VER
+                xcr0 = _xgetbv (0);
+#    else
+                unsigned int lo, hi;
+                __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+                xcr0 = ((uint64_t) hi << 32) | lo;
+#    endif
+            }
+
+            /* AVX (bit 28) and F16C (bit 29), XMM and YMM state */
+            if ((regs[2] & (1 << 28)) && (regs[2] & (1 << 29)) &&
+                (xcr0 & 0x6) == 0x6)
+                ret |= EXR_CPU_AVX_F16C;
+        }
+
+        if (maxleaf >= 7 && (ret & EXR_CPU_AVX_F16C))
+        {
+#    ifdef _MSC_VER
+            __cpuidex (mregs, 7, 0);
+            for (int i = 0; i < 4; ++i)
+                regs[i] = (unsigned int) mregs[i];
+#    else
+            __cpuid_count (7, 0, regs[0], regs[1], regs[2], regs[3]);
+#    endif
+            if (regs[1] & (1 << 5)) ret |= EXR_CPU_AVX2;
+            /* AVX512F, and the opmask and upper ZMM state */
+            if ((regs[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+                ret |= EXR_CPU_AVX512;
+        }
+    }
+#elif defined(EXR_CODING_HAVE_NEON)
+    ret |= EXR_CPU_NEON;
+#endif
+
+    features = ret;
+    return ret;
+}
+
+/**************************************/
+
+static void
+half_to_float_buffer_scalar (float* out, const uint16_t* in, int w)
+{
+    for (int x = 0; x < w; ++x)
+        out[x] = half_to_float (one_to_native16 (in[x]));
+}
+
+static void
+float_to_half_buffer_scalar (uint16_t* out, const float* in, int w)
+{
+    const uint32_t* src = (const uint32_t*) in;
+    for (int x = 0; x < w; ++x)
+        out[x] = float_to_half_int (one_to_native32 (src[x]));
+}
+
+#ifdef EXR_CODING_HAVE_AVX_TARGET
+
+EXR_CODING_TARGET ("avx,f16c")
+static void
+half_to_float_buffer_f16c (float* out, const uint16_t* in, int w)
+{
+    while (w >= 8)
+    {
+        _mm256_storeu_ps (
+            out, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*) in)));
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    if (w >= 4)
+    {
+        _mm_storeu_ps (
+            out, _mm_cvtph_ps (_mm_loadl_epi64 ((const __m128i*) in)));
+        out += 4;
+        in += 4;
+        w -= 4;
+    }
+    while (w-- > 0)
+        *out++ = half_to_float (*in++);
+}
+
+EXR_CODING_TARGET ("avx,f16c")
+static void
+float_to_half_buffer_f16c (uint16_t* out, const float* in, int w)
+{
+    while (w >= 8)
+    {
+        __m256 v = _mm256_loadu_ps (in);
+        if (_mm256_movemask_ps (_mm256_cmp_ps (v, v, _CMP_UNORD_Q)) == 0)
+            _mm_storeu_si128 (
+                (__m128i*) out, _mm256_cvtps_ph (v, _MM_FROUND_TO_NEAREST_INT));
+        else
+            float_to_half_buffer_scalar (out, in, 8);
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    float_to_half_buffer_scalar (out, in, w);
+}
+
+EXR_CODING_TARGET ("avx512f,avx,f16c")
+static void
+half_to_float_buffer_avx512 (float* out, const uint16_t* in, int w)
+{
+    while (w >= 16)
+    {
+        _mm512_storeu_ps (
+            out,
+            _mm512_cvtph_ps (_mm256_loadu_si256 ((const __m256i*) in)));
+        out += 16;
+        in += 16;
+        w -= 16;
+    }
+    half_to_float_buffer_f16c (out, in, w);
+}
+
+EXR_CODING_TARGET ("avx512f,avx,f16c")
+static void
+float_to_half_buffer_avx512 (uint16_t* out, const float* in, int w)
+{
+    while (w >= 16)
+    {
+        __m512 v = _mm512_loadu_ps (in);
+        if (_mm512_cmp_ps_mask (v, v, _CMP_UNORD_Q) == 0)
+            _mm256_storeu_si256 (
+                (__m256i*) out, _mm512_cvtps_ph (v, _MM_FROUND_TO_NEAREST_INT));
+        else
+            float_to_half_buffer_f16c (out, in, 16);
+        out += 16;
+        in += 16;
+        w -= 16;
+    }
+    float_to_half_buffer_f16c (out, in, w);
+}
+
+#endif /* EXR_CODING_HAVE_AVX_TARGET */
+
+#ifdef EXR_CODING_HAVE_NEON
+
+static void
+half_to_float_buffer_neon (float* out, const uint16_t* in, int w)
+{
+    while (w >= 8)
+    {
+        float16x8_t h = vreinterpretq_f16_u16 (vld1q_u16 (in));
+        vst1q_f32 (out, vcvt_f32_f16 (vget_low_f16 (h)));
+        vst1q_f32 (out + 4, vcvt_high_f32_f16 (h));
+        out += 8;
+        in += 8;
+        w -= 8;
+    }
+    while (w-- > 0)
+        *out++ = half_to_float (*in++);
+}
+
+static void
+float_to_half_buffer_neon (uint16_t* out, const float* in, int w)
+{
+    while (w >= 4)
+    {
+        float32x4_t v = vld1q_f32 (in);
+        /* all lanes compare equal to themselves unless there is a NaN */
+        if (vminvq_u32 (vceqq_f32 (v, v)) != 0)
+            vst1_u16 (out, vreinterpret_u16_f16 (vcvt_f16_f32 (v)));
+        else
+            float_to_half_buffer_scalar (out, in, 4);
+        out += 4;
+        in += 4;
+        w -= 4;
+    }
+    float_to_half_buffer_scalar (out, in, w);
+}
+
+#endif /* EXR_CODING_HAVE_NEON */
+
+/**************************************/
+
+typedef void (*internal_exr_half_to_float_fn) (float*, const uint16_t*, int);
+typedef void (*internal_exr_float_to_half_fn) (uint16_t*, const float*, int);
+
+static inline internal_exr_half_to_float_fn
+internal_exr_choose_half_to_float (void)
+{
+#if defined(EXR_CODING_HAVE_AVX_TARGET)
+    int f = internal_exr_cpu_features ();
+    if (f & EXR_CPU_AVX512) return &half_to_float_buffer_avx512;
+    if (f & EXR_CPU_AVX_F16C) return &half_to_float_buffer_f16c;
+#elif defined(EXR_CODING_HAVE_NEON)
+    return &half_to_float_buffer_neon;
+#endif
+    return &half_to_float_buffer_scalar;
+}
+
+static inline internal_exr_float_to_half_fn
+internal_exr_choose_float_to_half (void)
+{
+#if defined(EXR_CODING_HAVE_AVX_TARGET)
+    int f = internal_exr_cpu_features ();
+    if (f & EXR_CPU_AVX512) return &float_to_half_buffer_avx512;
+    if (f & EXR_CPU_AVX_F16C) return &float_to_half_buffer_f16c;
+#elif defined(EXR_CODING_HAVE_NEON)
+    return &float_to_half_buffer_neon;
+#endif
+    return &float_to_half_buffer_scalar;
+}
+
+#endif /* OPENEXR_PRIVATE_CODING_SIMD_H */
@@ -11,6 +11,26 @@
 uint64_t internal_rle_compress (
     void* out, uint64_t outbytes, const void* src, uint64_t srcbytes);
 
+uint64_t internal_exr_deflate_bound (uint64_t srcbytes);
+
+exr_result_t internal_exr_deflate (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    int         level,
+    uint64_t*   compbytes);
+
+exr_result_t internal_zip_compress (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    void*       scratch,
+    uint64_t    scratchbytes,
+    int         level,
+    uint64_t*   compbytes);
+
 exr_result_t internal_exr_apply_rle (exr_encode_pipeline_t* encode);
 
 exr_result_t internal_exr_apply_zip (exr_encode_pipeline_t* encode);
@@ -17,6 +17,21 @@
 uint64_t internal_rle_decompress (
     uint8_t* out, uint64_t outbytes, const uint8_t* src, uint64_t srcbytes);
 
+exr_result_t internal_exr_inflate (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    uint64_t*   actual_out);
+
+exr_result_t internal_zip_decompress (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    void*       scratch,
+    uint64_t    scratchbytes);
+
 exr_result_t internal_exr_undo_rle (
     exr_decode_pipeline_t* decode,
     const void*            compressed_data,
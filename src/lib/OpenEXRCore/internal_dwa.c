@@ -3,14 +3,1925 @@
 ** Copyright Contributors to the OpenEXR Project.
 */
 
+/*
+ * DWAA / DWAB compression, ported from ImfDwaCompressor.cpp.
+ *
+ * A chunk consists of a header of NUM_SIZES_SINGLE 64-bit counters,
+ * optionally followed by the channel classification rules (version
+ * 2+), followed by up to four compressed blobs, in order:
+ *
+ *  - UNKNOWN: channels we do not know how to handle, deflated
+ *  - AC:      RLE'd AC coefficients of LOSSY_DCT channels, huffman
+ *             or deflate compressed
+ *  - DC:      DC coefficients of LOSSY_DCT channels, zip compressed
+ *  - RLE:     byte planes of RLE channels, RLE'd then deflated
+ *
+ * Channels are classified by the suffix of their name (after the
+ * last '.'), and sets of R, G, B channels sharing the same prefix
+ * are converted to Y'CbCr prior to the DCT.
+ */
+
 #include "internal_compress.h"
 #include "internal_decompress.h"
 
+#include "internal_coding.h"
+#include "internal_huf.h"
 #include "internal_structs.h"
 #include "internal_xdr.h"
 
+#include "internal_dwa_simd.h"
+
+#include <IlmThreadConfig.h>
+
+#include <stdint.h>
 #include <string.h>
 
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+#        include <synchapi.h>
+#        include <windows.h>
+#    else
+#        include <pthread.h>
+#    endif
+#endif
+
+/* tables live in internal_dwa_table.c */
+extern const uint16_t* exrcore_dwaToLinearTable;
+extern const uint16_t* exrcore_dwaToNonlinearTable;
+extern const uint32_t* exrcore_dwaClosestDataOffset;
+extern const uint16_t* exrcore_dwaClosestData;
+
+int exrcore_dwa_build_tables (void);
+
+/**************************************/
+
+typedef enum
+{
+    UNKNOWN   = 0,
+    LOSSY_DCT = 1,
+    RLE       = 2,
+
+    NUM_COMPRESSOR_SCHEMES
+} CompressorScheme;
+
+typedef enum
+{
+    STATIC_HUFFMAN = 0,
+    DEFLATE        = 1
+} AcCompression;
+
+/* Per-chunk data sizes, stored at the head of each chunk */
+enum
+{
+    VERSION = 0,
+    UNKNOWN_UNCOMPRESSED_SIZE,
+    UNKNOWN_COMPRESSED_SIZE,
+    AC_COMPRESSED_SIZE,
+    DC_COMPRESSED_SIZE,
+    RLE_COMPRESSED_SIZE,
+    RLE_UNCOMPRESSED_SIZE,
+    RLE_RAW_SIZE,
+
+    AC_UNCOMPRESSED_COUNT,
+    DC_UNCOMPRESSED_COUNT,
+
+    AC_COMPRESSION,
+
+    NUM_SIZES_SINGLE
+};
+
+#define DWA_HEADER_SIZE (NUM_SIZES_SINGLE * sizeof (uint64_t))
+
+/* maximum length of a rule suffix, matching the max attribute name */
+#define DWA_MAX_SUFFIX_LENGTH 255
+
+/**************************************/
+
+typedef struct
+{
+    const char*      suffix;
+    CompressorScheme scheme;
+    exr_pixel_type_t type;
+    int              cscIdx;
+    int              caseInsensitive;
+} Classifier;
+
+/* Channel classification rules to use when writing files */
+static const Classifier sDefaultChannelRules[] = {
+    {"R", LOSSY_DCT, EXR_PIXEL_HALF, 0, 0},
+    {"R", LOSSY_DCT, EXR_PIXEL_FLOAT, 0, 0},
+    {"G", LOSSY_DCT, EXR_PIXEL_HALF, 1, 0},
+    {"G", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 0},
+    {"B", LOSSY_DCT, EXR_PIXEL_HALF, 2, 0},
+    {"B", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 0},
+
+    {"Y", LOSSY_DCT, EXR_PIXEL_HALF, -1, 0},
+    {"Y", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 0},
+    {"BY", LOSSY_DCT, EXR_PIXEL_HALF, -1, 0},
+    {"BY", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 0},
+    {"RY", LOSSY_DCT, EXR_PIXEL_HALF, -1, 0},
+    {"RY", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 0},
+
+    {"A", RLE, EXR_PIXEL_UINT, -1, 0},
+    {"A", RLE, EXR_PIXEL_HALF, -1, 0},
+    {"A", RLE, EXR_PIXEL_FLOAT, -1, 0}};
+
+/* Channel classification rules when reading files with VERSION < 2 */
+static const Classifier sLegacyChannelRules[] = {
+    {"r", LOSSY_DCT, EXR_PIXEL_HALF, 0, 1},
+    {"r", LOSSY_DCT, EXR_PIXEL_FLOAT, 0, 1},
+    {"red", LOSSY_DCT, EXR_PIXEL_HALF, 0, 1},
+    {"red", LOSSY_DCT, EXR_PIXEL_FLOAT, 0, 1},
+    {"g", LOSSY_DCT, EXR_PIXEL_HALF, 1, 1},
+    {"g", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 1},
+    {"grn", LOSSY_DCT, EXR_PIXEL_HALF, 1, 1},
+    {"grn", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 1},
+    {"green", LOSSY_DCT, EXR_PIXEL_HALF, 1, 1},
+    {"green", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 1},
+    {"b", LOSSY_DCT, EXR_PIXEL_HALF, 2, 1},
+    {"b", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 1},
+    {"blu", LOSSY_DCT, EXR_PIXEL_HALF, 2, 1},
+    {"blu", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 1},
+    {"blue", LOSSY_DCT, EXR_PIXEL_HALF, 2, 1},
+    {"blue", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 1},
+
+    {"y", LOSSY_DCT, EXR_PIXEL_HALF, -1, 1},
+    {"y", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 1},
+    {"by", LOSSY_DCT, EXR_PIXEL_HALF, -1, 1},
+    {"by", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 1},
+    {"ry", LOSSY_DCT, EXR_PIXEL_HALF, -1, 1},
+    {"ry", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 1},
+    {"a", RLE, EXR_PIXEL_UINT, -1, 1},
+    {"a", RLE, EXR_PIXEL_HALF, -1, 1},
+    {"a", RLE, EXR_PIXEL_FLOAT, -1, 1}};
+
+#define NUM_DEFAULT_RULES                                                      \
+    (sizeof (sDefaultChannelRules) / sizeof (sDefaultChannelRules[0]))
+#define NUM_LEGACY_RULES                                                       \
+    (sizeof (sLegacyChannelRules) / sizeof (sLegacyChannelRules[0]))
+
+/**************************************/
+
+typedef struct
+{
+    const exr_coding_channel_info_t* chan;
+
+    const char*      suffix;
+    size_t           prefixLen;
+    CompressorScheme compression;
+    exr_pixel_type_t type;
+    int              pixelSize;
+    int              width;
+    int              height;
+
+    /* index of the first channel with the same prefix, which holds
+     * the R, G, B candidates for the prefix in cscIdx */
+    int cscPrefix;
+    int cscIdx[3];
+
+    uint8_t** rows;
+    uint8_t*  planarUncBufferEnd;
+    uint8_t*  planarUncRleEnd[4];
+    uint64_t  planarUncSize;
+} ChannelData;
+
+typedef struct
+{
+    ChannelData* channelData;
+    int          numChannels;
+    int*         cscSets;
+    int          numCscSets;
+
+    uint8_t* packedAcBuffer;
+    uint64_t packedAcBufferSize;
+    uint8_t* packedDcBuffer;
+    uint64_t packedDcBufferSize;
+    uint8_t* rleBuffer;
+    uint64_t rleBufferSize;
+    uint8_t* planarUncBuffer[NUM_COMPRESSOR_SCHEMES];
+    uint64_t planarUncBufferSize[NUM_COMPRESSOR_SCHEMES];
+
+    /* work areas for the lossy encoder / decoder */
+    uint16_t* rowBlock;
+    float*    dctData;
+    uint16_t* halfZigBlock;
+    uint16_t* halfBuffer;
+    uint8_t*  zipScratch;
+    void*     hufSpare;
+} DwaCompressor;
+
+/**************************************/
+
+static exr_result_t sDwaInitResult = EXR_ERR_UNKNOWN;
+
+static void
+dwa_initialize_once (void)
+{
+    choose_dwa_simd_impl ();
+    sDwaInitResult = exrcore_dwa_build_tables () ? EXR_ERR_SUCCESS
+                                                 : EXR_ERR_OUT_OF_MEMORY;
+}
+
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+static INIT_ONCE sDwaInitOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK
+dwa_initialize_cb (PINIT_ONCE once, PVOID param, PVOID* ctxt)
+{
+    (void) once;
+    (void) param;
+    (void) ctxt;
+    dwa_initialize_once ();
+    return TRUE;
+}
+#    else
+static pthread_once_t sDwaInitOnce = PTHREAD_ONCE_INIT;
+#    endif
+#endif
+
+/*
+ * Builds the lookup tables and picks the SIMD implementations the
+ * first time through, so concurrent decoders never race on either.
+ */
+static exr_result_t
+dwa_initialize (void)
+{
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    InitOnceExecuteOnce (&sDwaInitOnce, dwa_initialize_cb, NULL, NULL);
+#    else
+    pthread_once (&sDwaInitOnce, dwa_initialize_once);
+#    endif
+#else
+    static int sInitialized = 0;
+    if (!sInitialized)
+    {
+        dwa_initialize_once ();
+        sInitialized = 1;
+    }
+#endif
+    return sDwaInitResult;
+}
+
+/**************************************/
+
+static inline int
+numSamples (int s, int a, int b)
+{
+    int a1 = (a >= 0) ? (a / s) : -((-a + s - 1) / s);
+    int b1 = (b >= 0) ? (b / s) : -((-b + s - 1) / s);
+    return b1 - a1 + ((a1 * s < a) ? 0 : 1);
+}
+
+static inline int
+isSampled (int y, int s)
+{
+    return s <= 1 || (y % s) == 0;
+}
+
+static inline uint64_t
+alignSize (uint64_t sz)
+{
+    return (sz + (DWA_SIMD_ALIGNMENT - 1)) &
+           ~((uint64_t) (DWA_SIMD_ALIGNMENT - 1));
+}
+
+static inline char
+asciiToLower (char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char) (c - 'A' + 'a') : c;
+}
+
+/**************************************/
+
+static int
+classifierMatch (const Classifier* rule, const ChannelData* cd)
+{
+    const char* a = rule->suffix;
+    const char* b = cd->suffix;
+
+    if (rule->type != cd->type) return 0;
+
+    if (!rule->caseInsensitive) return strcmp (a, b) == 0;
+
+    while (*a && asciiToLower (*b) == *a)
+    {
+        ++a;
+        ++b;
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+/*
+ * Applies a rule to every channel it matches. Applying all the rules
+ * in order this way ends up with the same classification as the C++
+ * library, which walks the channels and applies all rules to each:
+ * the last matching rule picks the scheme, and the last matching
+ * channel fills the csc slot for its prefix.
+ */
+static void
+applyRule (DwaCompressor* me, const Classifier* rule)
+{
+    for (int c = 0; c < me->numChannels; ++c)
+    {
+        ChannelData* cd = me->channelData + c;
+
+        if (!classifierMatch (rule, cd)) continue;
+
+        cd->compression = rule->scheme;
+        if (rule->cscIdx >= 0)
+        {
+            int* slot = me->channelData[cd->cscPrefix].cscIdx + rule->cscIdx;
+            if (*slot < c) *slot = c;
+        }
+    }
+}
+
+static int
+relevantRule (const DwaCompressor* me, const Classifier* rule)
+{
+    for (int c = 0; c < me->numChannels; ++c)
+        if (classifierMatch (rule, me->channelData + c)) return 1;
+    return 0;
+}
+
+static int
+comparePrefix (const ChannelData* a, const ChannelData* b)
+{
+    size_t n = (a->prefixLen < b->prefixLen) ? a->prefixLen : b->prefixLen;
+    int    r = memcmp (a->chan->channel_name, b->chan->channel_name, n);
+    if (r != 0) return r;
+    if (a->prefixLen == b->prefixLen) return 0;
+    return (a->prefixLen < b->prefixLen) ? -1 : 1;
+}
+
+/*
+ * Caches the relevant channel info and sets up the prefix grouping,
+ * prior to any rules being applied.
+ */
+static void
+initializeChannelData (
+    DwaCompressor*                   me,
+    const exr_coding_channel_info_t* channels,
+    int                              numChannels,
+    const exr_chunk_info_t*          chunk)
+{
+    for (int c = 0; c < numChannels; ++c)
+    {
+        const exr_coding_channel_info_t* curc = channels + c;
+        ChannelData*                     cd   = me->channelData + c;
+        const char*                      lastDot;
+
+        memset (cd, 0, sizeof (ChannelData));
+        cd->chan        = curc;
+        cd->compression = UNKNOWN;
+        cd->type        = (exr_pixel_type_t) curc->data_type;
+        cd->pixelSize   = curc->bytes_per_element;
+
+        lastDot = strrchr (curc->channel_name, '.');
+        if (lastDot)
+        {
+            cd->prefixLen = (size_t) (lastDot - curc->channel_name);
+            cd->suffix    = lastDot + 1;
+        }
+        else
+        {
+            cd->prefixLen = 0;
+            cd->suffix    = curc->channel_name;
+        }
+
+        /* tiled parts have no sampling, and chunk.start_x / start_y
+         * are the tile indices there, so only use the coordinates
+         * when actually sampling */
+        if (curc->x_samples > 1)
+            cd->width = numSamples (
+                curc->x_samples,
+                chunk->start_x,
+                chunk->start_x + chunk->width - 1);
+        else
+            cd->width = chunk->width;
+
+        if (curc->y_samples > 1)
+            cd->height = numSamples (
+                curc->y_samples,
+                chunk->start_y,
+                chunk->start_y + chunk->height - 1);
+        else
+            cd->height = chunk->height;
+
+        cd->cscIdx[0] = cd->cscIdx[1] = cd->cscIdx[2] = -1;
+        cd->cscPrefix                                 = c;
+        for (int p = 0; p < c; ++p)
+        {
+            if (comparePrefix (me->channelData + p, cd) == 0)
+            {
+                cd->cscPrefix = me->channelData[p].cscPrefix;
+                break;
+            }
+        }
+    }
+    me->numChannels = numChannels;
+}
+
+/*
+ * Finds the RGB sets of channels which can be CSC'ed to a Y'CbCr
+ * space prior to loss, ordered by prefix.
+ */
+static void
+findCscSets (DwaCompressor* me)
+{
+    me->numCscSets = 0;
+    for (int c = 0; c < me->numChannels; ++c)
+    {
+        const ChannelData* cd = me->channelData + c;
+        const ChannelData *red, *grn, *blu;
+        int                ins;
+
+        if (cd->cscPrefix != c) continue;
+        if (cd->cscIdx[0] < 0 || cd->cscIdx[1] < 0 || cd->cscIdx[2] < 0)
+            continue;
+
+        red = me->channelData + cd->cscIdx[0];
+        grn = me->channelData + cd->cscIdx[1];
+        blu = me->channelData + cd->cscIdx[2];
+
+        if (red->chan->x_samples != grn->chan->x_samples ||
+            red->chan->x_samples != blu->chan->x_samples ||
+            red->chan->y_samples != grn->chan->y_samples ||
+            red->chan->y_samples != blu->chan->y_samples)
+            continue;
+
+        ins = me->numCscSets++;
+        while (ins > 0 &&
+               comparePrefix (cd, me->channelData + me->cscSets[ins - 1]) < 0)
+        {
+            me->cscSets[ins] = me->cscSets[ins - 1];
+            --ins;
+        }
+        me->cscSets[ins] = c;
+    }
+}
+
+/**************************************/
+
+/*
+ * Computes the size of, and when base is non-NULL, carves up, the
+ * scratch space needed for this chunk given the classification.
+ */
+static uint64_t
+initializeBuffers (DwaCompressor* me, uint8_t* base, uint64_t* maxOutSize)
+{
+    uint64_t acSize = 0, dcSize = 0, rleSize = 0, maxBlocksX = 0;
+    uint64_t maxPixels = 0, maxWidth = 0, outSize = 0, total = 0;
+    uint64_t planarSize[NUM_COMPRESSOR_SCHEMES] = {0};
+    uint64_t blockSz, halfSz, hufSz;
+    uint8_t* ptr;
+
+    for (int c = 0; c < me->numChannels; ++c)
+    {
+        const ChannelData* cd     = me->channelData + c;
+        uint64_t           w      = (uint64_t) cd->width;
+        uint64_t           h      = (uint64_t) cd->height;
+        uint64_t           pixels = w * h;
+
+        if (w > maxWidth) maxWidth = w;
+        if (pixels > maxPixels) maxPixels = pixels;
+
+        switch (cd->compression)
+        {
+            case LOSSY_DCT: {
+                uint64_t nbx = (w + 7) / 8;
+                uint64_t nby = (h + 7) / 8;
+                uint64_t ac  = nbx * nby * 63 * sizeof (uint16_t);
+
+                /* room for the packed components, plus the worst
+                 * case of huffman or deflate encoding them */
+                uint64_t hufBound = 2 * ac + 65536;
+                uint64_t zBound   = internal_exr_deflate_bound (ac);
+                outSize += (hufBound > zBound) ? hufBound : zBound;
+
+                acSize += ac;
+                dcSize += nbx * nby * sizeof (uint16_t);
+                if (nbx > maxBlocksX) maxBlocksX = nbx;
+            }
+            break;
+            case RLE:
+                /* RLE, if gone horribly wrong, could double the size */
+                rleSize += 2 * pixels * (uint64_t) cd->pixelSize;
+                planarSize[RLE] += pixels * (uint64_t) cd->pixelSize;
+                break;
+            case UNKNOWN:
+                planarSize[UNKNOWN] += pixels * (uint64_t) cd->pixelSize;
+                break;
+            case NUM_COMPRESSOR_SCHEMES:
+            default: break;
+        }
+    }
+
+    outSize += internal_exr_deflate_bound (rleSize);
+    outSize += internal_exr_deflate_bound (planarSize[UNKNOWN]);
+    outSize += internal_exr_deflate_bound (dcSize);
+    outSize += DWA_HEADER_SIZE;
+    if (maxOutSize) *maxOutSize = outSize;
+
+    /* UNKNOWN data is going to be zlib compressed, which needs a
+     * little extra headroom */
+    if (planarSize[UNKNOWN] > 0)
+        planarSize[UNKNOWN] = internal_exr_deflate_bound (planarSize[UNKNOWN]);
+
+    blockSz = 3 * 64;
+    /* encoding quantizes float channels of a csc set to a half
+     * buffer, decoding needs a row of halfs to expand floats */
+    halfSz = 3 * maxPixels * sizeof (uint16_t);
+    if (halfSz < maxWidth * sizeof (uint16_t))
+        halfSz = maxWidth * sizeof (uint16_t);
+    hufSz = internal_exr_huf_compress_spare_bytes ();
+    if (hufSz < internal_exr_huf_decompress_spare_bytes ())
+        hufSz = internal_exr_huf_decompress_spare_bytes ();
+    if (acSize == 0) hufSz = 0;
+
+    total = DWA_SIMD_ALIGNMENT;
+    total += alignSize (acSize);
+    total += alignSize (dcSize);
+    total += alignSize (rleSize);
+    total += alignSize (planarSize[RLE]);
+    total += alignSize (planarSize[UNKNOWN]);
+    total += alignSize (3 * maxBlocksX * 64 * sizeof (uint16_t));
+    total += alignSize (blockSz * sizeof (float));
+    total += alignSize (blockSz * sizeof (uint16_t));
+    total += alignSize (halfSz);
+    total += alignSize (dcSize);
+    total += alignSize (hufSz);
+
+    if (!base) return total;
+
+    ptr = base;
+    while (((uintptr_t) ptr) & (DWA_SIMD_ALIGNMENT - 1))
+        ++ptr;
+
+#define DWA_CARVE(dst, type, sz)                                               \
+    dst = (type) ptr;                                                          \
+    ptr += alignSize (sz)
+
+    DWA_CARVE (me->packedAcBuffer, uint8_t*, acSize);
+    me->packedAcBufferSize = acSize;
+    DWA_CARVE (me->packedDcBuffer, uint8_t*, dcSize);
+    me->packedDcBufferSize = dcSize;
+    DWA_CARVE (me->rleBuffer, uint8_t*, rleSize);
+    me->rleBufferSize = rleSize;
+    DWA_CARVE (me->planarUncBuffer[RLE], uint8_t*, planarSize[RLE]);
+    me->planarUncBufferSize[RLE] = planarSize[RLE];
+    DWA_CARVE (me->planarUncBuffer[UNKNOWN], uint8_t*, planarSize[UNKNOWN]);
+    me->planarUncBufferSize[UNKNOWN] = planarSize[UNKNOWN];
+    me->planarUncBuffer[LOSSY_DCT]     = NULL;
+    me->planarUncBufferSize[LOSSY_DCT] = 0;
+    DWA_CARVE (
+        me->rowBlock, uint16_t*, 3 * maxBlocksX * 64 * sizeof (uint16_t));
+    DWA_CARVE (me->dctData, float*, blockSz * sizeof (float));
+    DWA_CARVE (me->halfZigBlock, uint16_t*, blockSz * sizeof (uint16_t));
+    DWA_CARVE (me->halfBuffer, uint16_t*, halfSz);
+    DWA_CARVE (me->zipScratch, uint8_t*, dcSize);
+    DWA_CARVE (me->hufSpare, void*, hufSz);
+
+#undef DWA_CARVE
+
+    return total;
+}
+
+/*
+ * Assigns each channel its slice of the planar buffers.
+ */
+static void
+setupChannelData (DwaCompressor* me)
+{
+    uint8_t* planarUncBuffer[NUM_COMPRESSOR_SCHEMES];
+
+    for (int i = 0; i < NUM_COMPRESSOR_SCHEMES; ++i)
+        planarUncBuffer[i] = me->planarUncBuffer[i];
+
+    for (int c = 0; c < me->numChannels; ++c)
+    {
+        ChannelData* cd = me->channelData + c;
+        uint64_t     planeSize =
+            (uint64_t) cd->width * (uint64_t) cd->height;
+
+        cd->planarUncSize      = planeSize * (uint64_t) cd->pixelSize;
+        cd->planarUncBufferEnd = planarUncBuffer[cd->compression];
+
+        cd->planarUncRleEnd[0] = cd->planarUncBufferEnd;
+        for (int byte = 1; byte < cd->pixelSize; ++byte)
+            cd->planarUncRleEnd[byte] =
+                cd->planarUncRleEnd[byte - 1] + planeSize;
+
+        if (cd->compression != LOSSY_DCT)
+            planarUncBuffer[cd->compression] += cd->planarUncSize;
+    }
+}
+
+/*
+ * Determines the start of each row in the interleaved buffer, returns
+ * the number of bytes covered by all the rows.
+ */
+static uint64_t
+setupRowPointers (
+    DwaCompressor* me, uint8_t** rowStore, uint8_t* data, int startY, int h)
+{
+    uint8_t* ptr = data;
+
+    for (int c = 0; c < me->numChannels; ++c)
+    {
+        me->channelData[c].rows = rowStore;
+        rowStore += me->channelData[c].height;
+    }
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int c = 0; c < me->numChannels; ++c)
+        {
+            ChannelData* cd = me->channelData + c;
+
+            if (!isSampled (y + startY, cd->chan->y_samples)) continue;
+
+            /* recycle the count as the insertion point */
+            cd->rows[0] = ptr;
+            ptr += (uint64_t) cd->width * (uint64_t) cd->pixelSize;
+            cd->rows++;
+        }
+    }
+
+    for (int c = 0; c < me->numChannels; ++c)
+        me->channelData[c].rows -= me->channelData[c].height;
+
+    return (uint64_t) (ptr - data);
+}
+
+/**************************************/
+
+static const float sJpegQuantTableY[64] = {
+    16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+    14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+    18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+
+static const float sJpegQuantTableCbCr[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+#define JPEG_QUANT_TABLE_Y_MIN 10.f
+#define JPEG_QUANT_TABLE_CBCR_MIN 17.f
+
+/* position of each zig-zag coefficient in the normal 8x8 layout */
+static const uint8_t sToZigZag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+static inline int
+countSetBits (uint16_t src)
+{
+    int n = 0;
+    while (src)
+    {
+        src &= (uint16_t) (src - 1);
+        ++n;
+    }
+    return n;
+}
+
+/*
+ * Take a DCT coefficient, as well as an acceptable error. Search
+ * nearby values within the error tolerance, that have fewer bits
+ * set. The candidates are sorted by increasing numbers of bits set,
+ * so we can stop as soon as one is within tolerance.
+ */
+static inline uint16_t
+quantize (uint16_t src, float errorTolerance)
+{
+    float           srcFloat   = half_to_float (src);
+    int             numSetBits = countSetBits (src);
+    const uint16_t* closest =
+        exrcore_dwaClosestData + exrcore_dwaClosestDataOffset[src];
+
+    for (int targetNumSetBits = numSetBits - 1; targetNumSetBits >= 0;
+         --targetNumSetBits)
+    {
+        uint16_t tmp = *closest;
+
+        if (fabsf (half_to_float (tmp) - srcFloat) < errorTolerance)
+            return tmp;
+
+        closest++;
+    }
+
+    return src;
+}
+
+/*
+ * RLE the zig-zag of the AC components. NaN symbols, which shouldn't
+ * occur in DCT coefficients, encode runs of zeros: a high byte of
+ * 0xff is a run of 0's with the length in the low byte, 0xff00 is
+ * the end of the block.
+ */
+static inline uint16_t*
+rleAc (const uint16_t* block, uint16_t* acPtr)
+{
+    int dctComp = 1;
+
+    while (dctComp < 64)
+    {
+        int runLen = 1;
+
+        if (block[dctComp] != 0)
+        {
+            *acPtr++ = block[dctComp];
+            dctComp += runLen;
+            continue;
+        }
+
+        while ((dctComp + runLen < 64) && (block[dctComp + runLen] == 0))
+            runLen++;
+
+        if (runLen == 1)
+            *acPtr++ = block[dctComp];
+        else if (runLen + dctComp == 64)
+            *acPtr++ = 0xff00;
+        else
+            *acPtr++ = (uint16_t) (0xff00 | runLen);
+
+        dctComp += runLen;
+    }
+
+    return acPtr;
+}
+
+typedef struct
+{
+    float           quantBaseError;
+    int             numComp;
+    int             width;
+    int             height;
+    ChannelData*    cd[3];
+    const uint16_t* toNonlinear;
+
+    uint16_t* packedAc;
+    uint16_t* packedDc;
+    uint64_t  numAcComp;
+    uint64_t  numDcComp;
+} LossyDctEncoder;
+
+static void
+LossyDctEncoder_execute (LossyDctEncoder* e, DwaCompressor* me)
+{
+    int             numBlocksX = (e->width + 7) / 8;
+    int             numBlocksY = (e->height + 7) / 8;
+    uint64_t        planeSize  = (uint64_t) e->width * (uint64_t) e->height;
+    const uint8_t*  halfRows[3];
+    uint16_t*       currDcComp[3];
+    uint16_t*       currAcComp = e->packedAc;
+    uint16_t*       tmpHalf    = me->halfBuffer;
+    float           quantY[64], quantCbCr[64];
+    uint16_t        halfCoef[64], halfZigCoef[64];
+    float*          dctData[3];
+    const uint16_t* toNonlinear = e->toNonlinear;
+
+    e->numAcComp = 0;
+    e->numDcComp = 0;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        quantY[i] = e->quantBaseError *
+                    (sJpegQuantTableY[i] / JPEG_QUANT_TABLE_Y_MIN);
+        quantCbCr[i] = e->quantBaseError *
+                       (sJpegQuantTableCbCr[i] / JPEG_QUANT_TABLE_CBCR_MIN);
+    }
+
+    /* Quantize any FLOAT source channels to half. Clamp to the half
+     * range, instead of just casting, to avoid introducing Infs which
+     * end up getting zeroed later */
+    for (int comp = 0; comp < e->numComp; ++comp)
+    {
+        ChannelData* cd = e->cd[comp];
+
+        dctData[comp]    = me->dctData + comp * 64;
+        currDcComp[comp] = e->packedDc + (uint64_t) comp *
+                                             (uint64_t) numBlocksX *
+                                             (uint64_t) numBlocksY;
+        halfRows[comp]   = NULL;
+
+        if (cd->type != EXR_PIXEL_FLOAT) continue;
+
+        halfRows[comp] = (const uint8_t*) tmpHalf;
+        for (int y = 0; y < e->height; ++y)
+        {
+            const uint8_t* srcXdr = cd->rows[y];
+
+            for (int x = 0; x < e->width; ++x)
+            {
+                union
+                {
+                    uint32_t i;
+                    float    f;
+                } src;
+
+                memcpy (&src.i, srcXdr + x * 4, sizeof (uint32_t));
+                src.i = one_to_native32 (src.i);
+                if (!(src.f < 65504.f)) src.f = 65504.f;
+                if (src.f < -65504.f) src.f = -65504.f;
+
+                *tmpHalf++ = one_from_native16 (float_to_half (src.f));
+            }
+        }
+    }
+    (void) planeSize;
+
+    for (int blocky = 0; blocky < numBlocksY; ++blocky)
+    {
+        for (int blockx = 0; blockx < numBlocksX; ++blockx)
+        {
+            /* Break the source into 8x8 blocks, mirroring at the
+             * edges, and convert from linear to nonlinear */
+            for (int comp = 0; comp < e->numComp; ++comp)
+            {
+                const ChannelData* cd = e->cd[comp];
+
+                for (int y = 0; y < 8; ++y)
+                {
+                    const uint16_t* row;
+                    int             vy = 8 * blocky + y;
+
+                    if (vy >= e->height) vy = e->height - (vy - (e->height - 1));
+                    if (vy < 0) vy = e->height - 1;
+
+                    if (halfRows[comp])
+                        row = (const uint16_t*) (halfRows[comp] +
+                                                 (uint64_t) vy *
+                                                     (uint64_t) e->width * 2);
+                    else
+                        row = (const uint16_t*) cd->rows[vy];
+
+                    for (int x = 0; x < 8; ++x)
+                    {
+                        uint16_t h;
+                        int      vx = 8 * blockx + x;
+
+                        if (vx >= e->width) vx = e->width - (vx - (e->width - 1));
+                        if (vx < 0) vx = e->width - 1;
+
+                        h = one_to_native16 (row[vx]);
+                        if (toNonlinear) h = toNonlinear[h];
+
+                        dctData[comp][y * 8 + x] = half_to_float (h);
+                    }
+                }
+            }
+
+            if (e->numComp == 3)
+                csc709Forward64 (dctData[0], dctData[1], dctData[2]);
+
+            for (int comp = 0; comp < e->numComp; ++comp)
+            {
+                const float* quant = (comp == 0) ? quantY : quantCbCr;
+
+                dctForward8x8 (dctData[comp]);
+
+                for (int i = 0; i < 64; ++i)
+                    halfCoef[i] =
+                        quantize (float_to_half (dctData[comp][i]), quant[i]);
+
+                for (int i = 0; i < 64; ++i)
+                    halfZigCoef[i] = one_from_native16 (halfCoef[sToZigZag[i]]);
+
+                /* DC is compressed separately from the AC */
+                *currDcComp[comp]++ = halfZigCoef[0];
+                e->numDcComp++;
+
+                currAcComp = rleAc (halfZigCoef, currAcComp);
+            }
+        }
+    }
+
+    e->numAcComp = (uint64_t) (currAcComp - e->packedAc);
+}
+
+/**************************************/
+
+typedef struct
+{
+    int             numComp;
+    int             width;
+    int             height;
+    ChannelData*    cd[3];
+    const uint16_t* toLinear;
+
+    uint16_t* packedAc;
+    uint16_t* packedAcEnd;
+    uint16_t* packedDc;
+    uint16_t* packedDcEnd;
+    uint64_t  numAcComp;
+    uint64_t  numDcComp;
+} LossyDctDecoder;
+
+/*
+ * Un-RLE the packed AC components into a zeroed, zig-zag ordered
+ * block. Returns the zig-zag index of the last non-zero value (0
+ * meaning DC only data), or -1 when running out of data.
+ */
+static inline int
+unRleAc (uint16_t** currAcComp, const uint16_t* packedAcEnd, uint16_t* block)
+{
+    int       lastNonZero = 0;
+    int       dctComp     = 1;
+    uint16_t* acComp      = *currAcComp;
+
+    while (dctComp < 64)
+    {
+        uint16_t v;
+
+        if (acComp >= packedAcEnd) return -1;
+
+        v = *acComp++;
+        if (v == 0xff00) { dctComp = 64; }
+        else if ((v >> 8) == 0xff)
+        {
+            dctComp += v & 0xff;
+        }
+        else
+        {
+            lastNonZero    = dctComp;
+            block[dctComp] = v;
+            dctComp++;
+        }
+    }
+
+    *currAcComp = acComp;
+    return lastNonZero;
+}
+
+static exr_result_t
+LossyDctDecoder_execute (LossyDctDecoder* d, DwaCompressor* me)
+{
+    int       numBlocksX     = (d->width + 7) / 8;
+    int       numBlocksY     = (d->height + 7) / 8;
+    int       leftoverX      = d->width - (numBlocksX - 1) * 8;
+    int       leftoverY      = d->height - (numBlocksY - 1) * 8;
+    int       numFullBlocksX = d->width / 8;
+    uint16_t* currAcComp     = d->packedAc;
+    uint16_t* currDcComp[3];
+    uint16_t* rowBlock[3];
+    uint16_t* halfZigBlock[3];
+    float*    dctData[3];
+    uint64_t  dcPerComp = (uint64_t) numBlocksX * (uint64_t) numBlocksY;
+    const uint16_t* toLinear = d->toLinear;
+
+    d->numAcComp = 0;
+    d->numDcComp = 0;
+
+    if ((uint64_t) (d->packedDcEnd - d->packedDc) <
+        dcPerComp * (uint64_t) d->numComp)
+        return EXR_ERR_CORRUPT_CHUNK;
+
+    for (int comp = 0; comp < d->numComp; ++comp)
+    {
+        rowBlock[comp] = me->rowBlock + (uint64_t) comp *
+                                            (uint64_t) numBlocksX * 64;
+        halfZigBlock[comp] = me->halfZigBlock + comp * 64;
+        dctData[comp]      = me->dctData + comp * 64;
+        currDcComp[comp]   = d->packedDc + (uint64_t) comp * dcPerComp;
+    }
+
+    for (int blocky = 0; blocky < numBlocksY; ++blocky)
+    {
+        int maxY = 8;
+        int maxX = 8;
+
+        if (blocky == numBlocksY - 1) maxY = leftoverY;
+
+        for (int blockx = 0; blockx < numBlocksX; ++blockx)
+        {
+            /* If all components only have DC values, the whole block
+             * is constant and only one value needs converting */
+            int blockIsConstant = 1;
+
+            if (blockx == numBlocksX - 1) maxX = leftoverX;
+
+            for (int comp = 0; comp < d->numComp; ++comp)
+            {
+                uint16_t* block = halfZigBlock[comp];
+                int       lastNonZero;
+
+                memset (block, 0, 64 * sizeof (uint16_t));
+                block[0] = *currDcComp[comp]++;
+
+                lastNonZero = unRleAc (&currAcComp, d->packedAcEnd, block);
+                if (lastNonZero < 0) return EXR_ERR_CORRUPT_CHUNK;
+
+                priv_to_native16 (block, 64);
+
+                if (lastNonZero == 0)
+                {
+                    dctData[comp][0] = half_to_float (block[0]);
+                    dctInverse8x8DcOnly (dctData[comp]);
+                }
+                else
+                {
+                    blockIsConstant = 0;
+
+                    fromHalfZigZag (block, dctData[comp]);
+
+                    /*
+                     * If lastNonZero is less than the first zig-zag
+                     * index on a row, the whole row is zero and can be
+                     * skipped in the row pass of the iDCT. The first
+                     * indices of rows 1..7 are 2, 3, 9, 10, 20, 21, 35.
+                     */
+                    if (lastNonZero < 2)
+                        dctInverse8x8 (dctData[comp], 7);
+                    else if (lastNonZero < 3)
+                        dctInverse8x8 (dctData[comp], 6);
+                    else if (lastNonZero < 9)
+                        dctInverse8x8 (dctData[comp], 5);
+                    else if (lastNonZero < 10)
+                        dctInverse8x8 (dctData[comp], 4);
+                    else if (lastNonZero < 20)
+                        dctInverse8x8 (dctData[comp], 3);
+                    else if (lastNonZero < 21)
+                        dctInverse8x8 (dctData[comp], 2);
+                    else if (lastNonZero < 35)
+                        dctInverse8x8 (dctData[comp], 1);
+                    else
+                        dctInverse8x8 (dctData[comp], 0);
+                }
+            }
+
+            if (d->numComp == 3)
+            {
+                if (!blockIsConstant)
+                    csc709Inverse64 (dctData[0], dctData[1], dctData[2]);
+                else
+                    csc709Inverse (dctData[0], dctData[1], dctData[2]);
+            }
+
+            for (int comp = 0; comp < d->numComp; ++comp)
+            {
+                uint16_t* dst = rowBlock[comp] + blockx * 64;
+
+                if (!blockIsConstant)
+                    convertFloatToHalf64 (dst, dctData[comp]);
+                else
+                {
+                    dst[0] = float_to_half (dctData[comp][0]);
+                    for (int i = 1; i < 64; ++i)
+                        dst[i] = dst[0];
+                }
+            }
+        }
+
+        /* unblock the nonlinear halfs, converting back to linear */
+        for (int comp = 0; comp < d->numComp; ++comp)
+        {
+            ChannelData* cd = d->cd[comp];
+
+            for (int y = 8 * blocky; y < 8 * blocky + maxY; ++y)
+            {
+                uint16_t*       dst = (uint16_t*) cd->rows[y];
+                const uint16_t* src = rowBlock[comp] + (y & 0x7) * 8;
+
+                for (int blockx = 0; blockx < numFullBlocksX; ++blockx)
+                {
+                    if (toLinear)
+                    {
+                        for (int x = 0; x < 8; ++x)
+                            dst[x] = one_from_native16 (toLinear[src[x]]);
+                    }
+                    else
+                    {
+                        for (int x = 0; x < 8; ++x)
+                            dst[x] = one_from_native16 (src[x]);
+                    }
+                    src += 64;
+                    dst += 8;
+                }
+
+                if (numFullBlocksX != numBlocksX)
+                {
+                    for (int x = 0; x < maxX; ++x)
+                        dst[x] = one_from_native16 (
+                            toLinear ? toLinear[src[x]] : src[x]);
+                }
+            }
+        }
+    }
+
+    /* convert FLOAT channels from HALF XDR back to FLOAT XDR */
+    for (int comp = 0; comp < d->numComp; ++comp)
+    {
+        ChannelData* cd = d->cd[comp];
+
+        if (cd->type != EXR_PIXEL_FLOAT) continue;
+
+        for (int y = 0; y < d->height; ++y)
+        {
+            uint8_t* floatXdr = cd->rows[y];
+
+            memcpy (
+                me->halfBuffer, floatXdr, (size_t) d->width * sizeof (uint16_t));
+
+            for (int x = 0; x < d->width; ++x)
+            {
+                union
+                {
+                    uint32_t i;
+                    float    f;
+                } v;
+
+                v.f = half_to_float (one_to_native16 (me->halfBuffer[x]));
+                v.i = one_from_native32 (v.i);
+                memcpy (floatXdr + x * 4, &v.i, sizeof (uint32_t));
+            }
+        }
+    }
+
+    d->numAcComp = (uint64_t) (currAcComp - d->packedAc);
+    d->numDcComp = dcPerComp * (uint64_t) d->numComp;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static exr_result_t
+DwaCompressor_compress (
+    DwaCompressor* me, exr_encode_pipeline_t* encode, AcCompression acCompression)
+{
+    uint8_t*     outPtr;
+    uint8_t*     outDataPtr;
+    uint8_t*     outEnd;
+    uint64_t     counters[NUM_SIZES_SINGLE] = {0};
+    uint64_t     maxOutSize, scratchSize, nBytes;
+    uint16_t     channelRuleSize = sizeof (uint16_t);
+    uint16_t*    packedAcEnd;
+    uint16_t*    packedDcEnd;
+    float        dwaLevel;
+    int          zipLevel;
+    exr_result_t rv;
+
+    rv = exr_get_dwa_compression_level (
+        encode->context, encode->part_index, &dwaLevel);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+    rv = exr_get_zip_compression_level (
+        encode->context, encode->part_index, &zipLevel);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    /* Starting with version 2, the channel classification rules are
+     * written into each chunk */
+    for (size_t r = 0; r < NUM_DEFAULT_RULES; ++r)
+        applyRule (me, sDefaultChannelRules + r);
+    findCscSets (me);
+
+    for (size_t r = 0; r < NUM_DEFAULT_RULES; ++r)
+    {
+        if (relevantRule (me, sDefaultChannelRules + r))
+            channelRuleSize +=
+                (uint16_t) (strlen (sDefaultChannelRules[r].suffix) + 3);
+    }
+
+    scratchSize = initializeBuffers (me, NULL, &maxOutSize);
+    maxOutSize += channelRuleSize;
+
+    rv = internal_encode_alloc_buffer (
+        encode,
+        EXR_TRANSCODE_BUFFER_COMPRESSED,
+        &(encode->compressed_buffer),
+        &(encode->compressed_alloc_size),
+        maxOutSize);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = internal_encode_alloc_buffer (
+        encode,
+        EXR_TRANSCODE_BUFFER_SCRATCH1,
+        &(encode->scratch_buffer_1),
+        &(encode->scratch_alloc_size_1),
+        scratchSize);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    initializeBuffers (me, encode->scratch_buffer_1, NULL);
+    setupChannelData (me);
+
+    nBytes = setupRowPointers (
+        me,
+        (uint8_t**) (me->cscSets + me->numChannels),
+        EXR_CONST_CAST (uint8_t*, encode->packed_buffer),
+        encode->chunk.start_y,
+        encode->chunk.height);
+    if (nBytes != encode->packed_bytes) return EXR_ERR_INVALID_ARGUMENT;
+
+    outPtr     = encode->compressed_buffer;
+    outEnd     = outPtr + encode->compressed_alloc_size;
+    outDataPtr = outPtr + DWA_HEADER_SIZE;
+
+    counters[VERSION]        = 2;
+    counters[AC_COMPRESSION] = (uint64_t) acCompression;
+
+    /* write the relevant channel rules */
+    outDataPtr[0] = (uint8_t) (channelRuleSize & 0xff);
+    outDataPtr[1] = (uint8_t) (channelRuleSize >> 8);
+    outDataPtr += sizeof (uint16_t);
+    for (size_t r = 0; r < NUM_DEFAULT_RULES; ++r)
+    {
+        const Classifier* rule = sDefaultChannelRules + r;
+        size_t            len;
+
+        if (!relevantRule (me, rule)) continue;
+
+        len = strlen (rule->suffix) + 1;
+        memcpy (outDataPtr, rule->suffix, len);
+        outDataPtr += len;
+
+        /* cscIdx (-1..2) in the upper 4 bits, the scheme in the next
+         * 2 bits and the case sensitivity in the bottom bit */
+        *outDataPtr++ =
+            (uint8_t) ((((rule->cscIdx + 1) & 15) << 4) |
+                       ((rule->scheme & 3) << 2) |
+                       (rule->caseInsensitive & 1));
+        *outDataPtr++ = (uint8_t) rule->type;
+    }
+
+    packedAcEnd = (uint16_t*) me->packedAcBuffer;
+    packedDcEnd = (uint16_t*) me->packedDcBuffer;
+
+    /* Encode all the CSC sets first */
+    for (int csc = 0; csc < me->numCscSets; ++csc)
+    {
+        const ChannelData* prefix = me->channelData + me->cscSets[csc];
+        LossyDctEncoder    enc;
+
+        enc.quantBaseError = dwaLevel / 100000.f;
+        enc.numComp        = 3;
+        enc.cd[0]          = me->channelData + prefix->cscIdx[0];
+        enc.cd[1]          = me->channelData + prefix->cscIdx[1];
+        enc.cd[2]          = me->channelData + prefix->cscIdx[2];
+        enc.width          = enc.cd[0]->width;
+        enc.height         = enc.cd[0]->height;
+        enc.toNonlinear    = exrcore_dwaToNonlinearTable;
+        enc.packedAc       = packedAcEnd;
+        enc.packedDc       = packedDcEnd;
+
+        LossyDctEncoder_execute (&enc, me);
+
+        counters[AC_UNCOMPRESSED_COUNT] += enc.numAcComp;
+        counters[DC_UNCOMPRESSED_COUNT] += enc.numDcComp;
+        packedAcEnd += enc.numAcComp;
+        packedDcEnd += enc.numDcComp;
+    }
+
+    for (int c = 0; c < me->numChannels; ++c)
+    {
+        ChannelData* cd        = me->channelData + c;
+        int          isCscChan = 0;
+
+        for (int csc = 0; csc < me->numCscSets && !isCscChan; ++csc)
+        {
+            const ChannelData* prefix = me->channelData + me->cscSets[csc];
+            isCscChan = (prefix->cscIdx[0] == c || prefix->cscIdx[1] == c ||
+                         prefix->cscIdx[2] == c);
+        }
+        if (isCscChan) continue;
+
+        switch (cd->compression)
+        {
+            case LOSSY_DCT: {
+                LossyDctEncoder enc;
+
+                enc.quantBaseError = dwaLevel / 100000.f;
+                enc.numComp        = 1;
+                enc.cd[0]          = cd;
+                enc.width          = cd->width;
+                enc.height         = cd->height;
+                enc.toNonlinear =
+                    cd->chan->p_linear ? NULL : exrcore_dwaToNonlinearTable;
+                enc.packedAc = packedAcEnd;
+                enc.packedDc = packedDcEnd;
+
+                LossyDctEncoder_execute (&enc, me);
+
+                counters[AC_UNCOMPRESSED_COUNT] += enc.numAcComp;
+                counters[DC_UNCOMPRESSED_COUNT] += enc.numDcComp;
+                packedAcEnd += enc.numAcComp;
+                packedDcEnd += enc.numDcComp;
+            }
+            break;
+            case RLE:
+                /* split the bytes so that the first bytes of each pixel
+                 * are contiguous, as are the second bytes, and so on */
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    const uint8_t* row = cd->rows[y];
+
+                    for (int x = 0; x < cd->width; ++x)
+                    {
+                        for (int byte = 0; byte < cd->pixelSize; ++byte)
+                            *cd->planarUncRleEnd[byte]++ = *row++;
+                    }
+
+                    counters[RLE_RAW_SIZE] +=
+                        (uint64_t) cd->width * (uint64_t) cd->pixelSize;
+                }
+                break;
+            case UNKNOWN: {
+                uint64_t scanlineSize =
+                    (uint64_t) cd->width * (uint64_t) cd->pixelSize;
+
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    memcpy (cd->planarUncBufferEnd, cd->rows[y], scanlineSize);
+                    cd->planarUncBufferEnd += scanlineSize;
+                }
+
+                counters[UNKNOWN_UNCOMPRESSED_SIZE] += cd->planarUncSize;
+            }
+            break;
+            case NUM_COMPRESSOR_SCHEMES:
+            default: return EXR_ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    /* UNKNOWN data goes first, deflated */
+    if (counters[UNKNOWN_UNCOMPRESSED_SIZE] > 0)
+    {
+        rv = internal_exr_deflate (
+            outDataPtr,
+            (uint64_t) (outEnd - outDataPtr),
+            me->planarUncBuffer[UNKNOWN],
+            counters[UNKNOWN_UNCOMPRESSED_SIZE],
+            9,
+            &nBytes);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        outDataPtr += nBytes;
+        counters[UNKNOWN_COMPRESSED_SIZE] = nBytes;
+    }
+
+    /* then the AC coefficients */
+    if (counters[AC_UNCOMPRESSED_COUNT] > 0)
+    {
+        switch (acCompression)
+        {
+            case STATIC_HUFFMAN:
+                rv = internal_huf_compress (
+                    &nBytes,
+                    outDataPtr,
+                    (uint64_t) (outEnd - outDataPtr),
+                    (const uint16_t*) me->packedAcBuffer,
+                    counters[AC_UNCOMPRESSED_COUNT],
+                    me->hufSpare,
+                    internal_exr_huf_compress_spare_bytes ());
+                if (rv != EXR_ERR_SUCCESS) return rv;
+                counters[AC_COMPRESSED_SIZE] = nBytes;
+                break;
+            case DEFLATE:
+                rv = internal_exr_deflate (
+                    outDataPtr,
+                    (uint64_t) (outEnd - outDataPtr),
+                    me->packedAcBuffer,
+                    counters[AC_UNCOMPRESSED_COUNT] * sizeof (uint16_t),
+                    9,
+                    &nBytes);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+                counters[AC_COMPRESSED_SIZE] = nBytes;
+                break;
+            default: return EXR_ERR_INVALID_ARGUMENT;
+        }
+
+        outDataPtr += counters[AC_COMPRESSED_SIZE];
+    }
+
+    /* the DC components are zip'ed separately */
+    if (counters[DC_UNCOMPRESSED_COUNT] > 0)
+    {
+        rv = internal_zip_compress (
+            outDataPtr,
+            (uint64_t) (outEnd - outDataPtr),
+            me->packedDcBuffer,
+            counters[DC_UNCOMPRESSED_COUNT] * sizeof (uint16_t),
+            me->zipScratch,
+            me->packedDcBufferSize,
+            zipLevel,
+            &nBytes);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        counters[DC_COMPRESSED_SIZE] = nBytes;
+        outDataPtr += nBytes;
+    }
+
+    /* RLE data gets RLE'd, then deflated */
+    if (counters[RLE_RAW_SIZE] > 0)
+    {
+        counters[RLE_UNCOMPRESSED_SIZE] = internal_rle_compress (
+            me->rleBuffer,
+            me->rleBufferSize,
+            me->planarUncBuffer[RLE],
+            counters[RLE_RAW_SIZE]);
+
+        rv = internal_exr_deflate (
+            outDataPtr,
+            (uint64_t) (outEnd - outDataPtr),
+            me->rleBuffer,
+            counters[RLE_UNCOMPRESSED_SIZE],
+            9,
+            &nBytes);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        counters[RLE_COMPRESSED_SIZE] = nBytes;
+        outDataPtr += nBytes;
+    }
+
+    for (int i = 0; i < NUM_SIZES_SINGLE; ++i)
+    {
+        uint64_t v = one_from_native64 (counters[i]);
+        memcpy (outPtr + i * sizeof (uint64_t), &v, sizeof (uint64_t));
+    }
+
+    nBytes = (uint64_t) (outDataPtr - outPtr);
+    if (nBytes >= encode->packed_bytes)
+    {
+        memcpy (
+            encode->compressed_buffer,
+            encode->packed_buffer,
+            encode->packed_bytes);
+        nBytes = encode->packed_bytes;
+    }
+    encode->compressed_bytes = nBytes;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/*
+ * Parses one rule from the chunk, advancing the pointer. The suffix
+ * is left pointing in to the chunk data.
+ */
+static exr_result_t
+readRule (Classifier* rule, const uint8_t** ptr, uint64_t* size)
+{
+    const uint8_t* p   = *ptr;
+    uint64_t       max = *size;
+    size_t         len = 0;
+    uint8_t        value;
+
+    if (max > DWA_MAX_SUFFIX_LENGTH + 1) max = DWA_MAX_SUFFIX_LENGTH + 1;
+    while (len < max && p[len] != '\0')
+        ++len;
+    if (len >= max || *size < len + 3) return EXR_ERR_CORRUPT_CHUNK;
+
+    rule->suffix = (const char*) p;
+    p += len + 1;
+
+    value        = *p++;
+    rule->cscIdx = (int) (value >> 4) - 1;
+    if (rule->cscIdx < -1 || rule->cscIdx >= 3) return EXR_ERR_CORRUPT_CHUNK;
+
+    rule->scheme = (CompressorScheme) ((value >> 2) & 3);
+    if (rule->scheme >= NUM_COMPRESSOR_SCHEMES) return EXR_ERR_CORRUPT_CHUNK;
+
+    rule->caseInsensitive = (value & 1) ? 1 : 0;
+
+    value = *p++;
+    if (value >= EXR_PIXEL_LAST_TYPE) return EXR_ERR_CORRUPT_CHUNK;
+    rule->type = (exr_pixel_type_t) value;
+
+    *size -= len + 3;
+    *ptr = p;
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+DwaCompressor_uncompress (
+    DwaCompressor*         me,
+    exr_decode_pipeline_t* decode,
+    const uint8_t*         inPtr,
+    uint64_t               iSize,
+    uint8_t*               uncompressed_data,
+    uint64_t               uncompressed_size)
+{
+    uint64_t        counters[NUM_SIZES_SINGLE];
+    uint64_t        headerSize = DWA_HEADER_SIZE;
+    uint64_t        compressedSize, scratchSize, nBytes, dcNeeded = 0;
+    const uint8_t*  dataPtr;
+    const uint8_t*  compressedUnknownBuf;
+    const uint8_t*  compressedAcBuf;
+    const uint8_t*  compressedDcBuf;
+    const uint8_t*  compressedRleBuf;
+    uint16_t*       packedAcBufferEnd;
+    uint16_t*       packedDcBufferEnd;
+    const uint16_t* acEnd;
+    const uint16_t* dcEnd;
+    exr_result_t    rv;
+
+    if (iSize < headerSize) return EXR_ERR_CORRUPT_CHUNK;
+
+    for (int i = 0; i < NUM_SIZES_SINGLE; ++i)
+    {
+        memcpy (counters + i, inPtr + i * sizeof (uint64_t), sizeof (uint64_t));
+        counters[i] = one_to_native64 (counters[i]);
+    }
+
+    compressedSize = counters[UNKNOWN_COMPRESSED_SIZE] +
+                     counters[AC_COMPRESSED_SIZE] +
+                     counters[DC_COMPRESSED_SIZE] +
+                     counters[RLE_COMPRESSED_SIZE];
+
+    /* Both the sum and individual sizes are checked in case of overflow */
+    if (iSize < (headerSize + compressedSize) ||
+        iSize < counters[UNKNOWN_COMPRESSED_SIZE] ||
+        iSize < counters[AC_COMPRESSED_SIZE] ||
+        iSize < counters[DC_COMPRESSED_SIZE] ||
+        iSize < counters[RLE_COMPRESSED_SIZE])
+        return EXR_ERR_CORRUPT_CHUNK;
+
+    for (int i = UNKNOWN_UNCOMPRESSED_SIZE; i <= DC_UNCOMPRESSED_COUNT; ++i)
+        if ((int64_t) counters[i] < 0) return EXR_ERR_CORRUPT_CHUNK;
+
+    /* we can decode version 0, 1, and 2. v1 adds 'end of block'
+     * symbols to the AC RLE, v2 adds the channel rules */
+    if (counters[VERSION] > 2) return EXR_ERR_CORRUPT_CHUNK;
+
+    dataPtr = inPtr + headerSize;
+    if (counters[VERSION] < 2)
+    {
+        for (size_t r = 0; r < NUM_LEGACY_RULES; ++r)
+            applyRule (me, sLegacyChannelRules + r);
+    }
+    else
+    {
+        uint64_t ruleSize;
+
+        if (iSize < headerSize + sizeof (uint16_t))
+            return EXR_ERR_CORRUPT_CHUNK;
+
+        ruleSize = (uint64_t) dataPtr[0] | ((uint64_t) dataPtr[1] << 8);
+        if (ruleSize < sizeof (uint16_t)) return EXR_ERR_CORRUPT_CHUNK;
+
+        headerSize += ruleSize;
+        if (iSize < headerSize + compressedSize) return EXR_ERR_CORRUPT_CHUNK;
+
+        dataPtr += sizeof (uint16_t);
+        ruleSize -= sizeof (uint16_t);
+        while (ruleSize > 0)
+        {
+            Classifier rule;
+
+            rv = readRule (&rule, &dataPtr, &ruleSize);
+            if (rv != EXR_ERR_SUCCESS) return rv;
+
+            applyRule (me, &rule);
+        }
+    }
+    findCscSets (me);
+
+    scratchSize = initializeBuffers (me, NULL, NULL);
+    rv          = internal_decode_alloc_buffer (
+        decode,
+        EXR_TRANSCODE_BUFFER_SCRATCH1,
+        &(decode->scratch_buffer_1),
+        &(decode->scratch_alloc_size_1),
+        scratchSize);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    initializeBuffers (me, decode->scratch_buffer_1, NULL);
+    setupChannelData (me);
+
+    nBytes = setupRowPointers (
+        me,
+        (uint8_t**) (me->cscSets + me->numChannels),
+        uncompressed_data,
+        decode->chunk.start_y,
+        decode->chunk.height);
+    if (nBytes != uncompressed_size) return EXR_ERR_CORRUPT_CHUNK;
+
+    /* UNKNOWN data is packed first, followed by the AC, then the DC
+     * values, and then the zlib compressed RLE data */
+    compressedUnknownBuf = dataPtr;
+    compressedAcBuf = compressedUnknownBuf + counters[UNKNOWN_COMPRESSED_SIZE];
+    compressedDcBuf = compressedAcBuf + counters[AC_COMPRESSED_SIZE];
+    compressedRleBuf = compressedDcBuf + counters[DC_COMPRESSED_SIZE];
+
+    if (counters[UNKNOWN_COMPRESSED_SIZE] > 0)
+    {
+        uint64_t outSize = 0;
+
+        if (counters[UNKNOWN_UNCOMPRESSED_SIZE] >
+            me->planarUncBufferSize[UNKNOWN])
+            return EXR_ERR_CORRUPT_CHUNK;
+
+        if (EXR_ERR_SUCCESS != internal_exr_inflate (
+                                   me->planarUncBuffer[UNKNOWN],
+                                   counters[UNKNOWN_UNCOMPRESSED_SIZE],
+                                   compressedUnknownBuf,
+                                   counters[UNKNOWN_COMPRESSED_SIZE],
+                                   &outSize))
+            return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    if (counters[AC_COMPRESSED_SIZE] > 0)
+    {
+        uint64_t acBytes = counters[AC_UNCOMPRESSED_COUNT] * sizeof (uint16_t);
+
+        if (acBytes > me->packedAcBufferSize) return EXR_ERR_CORRUPT_CHUNK;
+
+        /* don't trust the part's compression type, look in the chunk */
+        switch (counters[AC_COMPRESSION])
+        {
+            case STATIC_HUFFMAN:
+                rv = internal_huf_decompress (
+                    compressedAcBuf,
+                    counters[AC_COMPRESSED_SIZE],
+                    (uint16_t*) me->packedAcBuffer,
+                    counters[AC_UNCOMPRESSED_COUNT],
+                    me->hufSpare,
+                    internal_exr_huf_decompress_spare_bytes ());
+                if (rv != EXR_ERR_SUCCESS) return EXR_ERR_CORRUPT_CHUNK;
+                break;
+            case DEFLATE: {
+                uint64_t destLen = 0;
+
+                if (EXR_ERR_SUCCESS != internal_exr_inflate (
+                                           me->packedAcBuffer,
+                                           acBytes,
+                                           compressedAcBuf,
+                                           counters[AC_COMPRESSED_SIZE],
+                                           &destLen))
+                    return EXR_ERR_CORRUPT_CHUNK;
+
+                if (acBytes != destLen) return EXR_ERR_CORRUPT_CHUNK;
+            }
+            break;
+            default: return EXR_ERR_CORRUPT_CHUNK;
+        }
+    }
+
+    if (counters[DC_COMPRESSED_SIZE] > 0)
+    {
+        uint64_t dcBytes = counters[DC_UNCOMPRESSED_COUNT] * sizeof (uint16_t);
+
+        if (dcBytes > me->packedDcBufferSize) return EXR_ERR_CORRUPT_CHUNK;
+
+        rv = internal_zip_decompress (
+            me->packedDcBuffer,
+            dcBytes,
+            compressedDcBuf,
+            counters[DC_COMPRESSED_SIZE],
+            me->zipScratch,
+            me->packedDcBufferSize);
+        if (rv != EXR_ERR_SUCCESS) return EXR_ERR_CORRUPT_CHUNK;
+    }
+    else if (counters[DC_UNCOMPRESSED_COUNT] != 0)
+    {
+        /* no compressed DC data, so there can't be any DC values */
+        return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    if (counters[RLE_RAW_SIZE] > 0)
+    {
+        uint64_t dstLen = 0;
+
+        if (counters[RLE_UNCOMPRESSED_SIZE] > me->rleBufferSize ||
+            counters[RLE_RAW_SIZE] > me->planarUncBufferSize[RLE])
+            return EXR_ERR_CORRUPT_CHUNK;
+
+        if (EXR_ERR_SUCCESS != internal_exr_inflate (
+                                   me->rleBuffer,
+                                   counters[RLE_UNCOMPRESSED_SIZE],
+                                   compressedRleBuf,
+                                   counters[RLE_COMPRESSED_SIZE],
+                                   &dstLen))
+            return EXR_ERR_CORRUPT_CHUNK;
+
+        if (dstLen != counters[RLE_UNCOMPRESSED_SIZE])
+            return EXR_ERR_CORRUPT_CHUNK;
+
+        if (internal_rle_decompress (
+                me->planarUncBuffer[RLE],
+                counters[RLE_RAW_SIZE],
+                me->rleBuffer,
+                counters[RLE_UNCOMPRESSED_SIZE]) != counters[RLE_RAW_SIZE])
+            return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    packedAcBufferEnd = (uint16_t*) me->packedAcBuffer;
+    packedDcBufferEnd = (uint16_t*) me->packedDcBuffer;
+    acEnd = packedAcBufferEnd + counters[AC_UNCOMPRESSED_COUNT];
+    dcEnd = packedDcBufferEnd + counters[DC_UNCOMPRESSED_COUNT];
+    (void) dcNeeded;
+
+    /* decode each set of 3 channels that needs to be handled together */
+    for (int csc = 0; csc < me->numCscSets; ++csc)
+    {
+        const ChannelData* prefix = me->channelData + me->cscSets[csc];
+        LossyDctDecoder    dec;
+
+        dec.numComp = 3;
+        dec.cd[0]   = me->channelData + prefix->cscIdx[0];
+        dec.cd[1]   = me->channelData + prefix->cscIdx[1];
+        dec.cd[2]   = me->channelData + prefix->cscIdx[2];
+
+        if (dec.cd[0]->compression != LOSSY_DCT ||
+            dec.cd[1]->compression != LOSSY_DCT ||
+            dec.cd[2]->compression != LOSSY_DCT)
+            return EXR_ERR_CORRUPT_CHUNK;
+
+        dec.width       = dec.cd[0]->width;
+        dec.height      = dec.cd[0]->height;
+        dec.toLinear    = exrcore_dwaToLinearTable;
+        dec.packedAc    = packedAcBufferEnd;
+        dec.packedAcEnd = EXR_CONST_CAST (uint16_t*, acEnd);
+        dec.packedDc    = packedDcBufferEnd;
+        dec.packedDcEnd = EXR_CONST_CAST (uint16_t*, dcEnd);
+
+        rv = LossyDctDecoder_execute (&dec, me);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        packedAcBufferEnd += dec.numAcComp;
+        packedDcBufferEnd += dec.numDcComp;
+    }
+
+    for (int c = 0; c < me->numChannels; ++c)
+    {
+        ChannelData* cd        = me->channelData + c;
+        int          isCscChan = 0;
+
+        for (int csc = 0; csc < me->numCscSets && !isCscChan; ++csc)
+        {
+            const ChannelData* prefix = me->channelData + me->cscSets[csc];
+            isCscChan = (prefix->cscIdx[0] == c || prefix->cscIdx[1] == c ||
+                         prefix->cscIdx[2] == c);
+        }
+        if (isCscChan) continue;
+
+        switch (cd->compression)
+        {
+            case LOSSY_DCT: {
+                LossyDctDecoder dec;
+
+                dec.numComp = 1;
+                dec.cd[0]   = cd;
+                dec.width   = cd->width;
+                dec.height  = cd->height;
+                dec.toLinear =
+                    cd->chan->p_linear ? NULL : exrcore_dwaToLinearTable;
+                dec.packedAc    = packedAcBufferEnd;
+                dec.packedAcEnd = EXR_CONST_CAST (uint16_t*, acEnd);
+                dec.packedDc    = packedDcBufferEnd;
+                dec.packedDcEnd = EXR_CONST_CAST (uint16_t*, dcEnd);
+
+                rv = LossyDctDecoder_execute (&dec, me);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+
+                packedAcBufferEnd += dec.numAcComp;
+                packedDcBufferEnd += dec.numDcComp;
+            }
+            break;
+            case RLE:
+                /* the byte planes need interleaving back in to pixels */
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    uint8_t* dst = cd->rows[y];
+
+                    for (int x = 0; x < cd->width; ++x)
+                    {
+                        for (int byte = 0; byte < cd->pixelSize; ++byte)
+                            *dst++ = *cd->planarUncRleEnd[byte]++;
+                    }
+                }
+                break;
+            case UNKNOWN: {
+                uint64_t dstScanlineSize =
+                    (uint64_t) cd->width * (uint64_t) cd->pixelSize;
+                const uint8_t* planarEnd = me->planarUncBuffer[UNKNOWN] +
+                                           me->planarUncBufferSize[UNKNOWN];
+
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    if (cd->planarUncBufferEnd + dstScanlineSize > planarEnd)
+                        return EXR_ERR_CORRUPT_CHUNK;
+
+                    memcpy (cd->rows[y], cd->planarUncBufferEnd, dstScanlineSize);
+                    cd->planarUncBufferEnd += dstScanlineSize;
+                }
+            }
+            break;
+            case NUM_COMPRESSOR_SCHEMES:
+            default: return EXR_ERR_CORRUPT_CHUNK;
+        }
+    }
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/*
+ * The channel data, the csc set list and the row pointers all live in
+ * the second scratch buffer, the classification decides how big the
+ * first one needs to be.
+ */
+static uint64_t
+channelScratchSize (const exr_coding_channel_info_t* channels, int nChans)
+{
+    uint64_t nRows = 0;
+
+    /* the chunk's own heights can be short by one row for sampled
+     * channels, so allow for the worst case */
+    for (int c = 0; c < nChans; ++c)
+        nRows += (uint64_t) channels[c].height + 1;
+
+    return (uint64_t) nChans * (sizeof (ChannelData) + sizeof (int)) +
+           sizeof (uint8_t*) + nRows * sizeof (uint8_t*);
+}
+
+static void
+initializeCompressor (DwaCompressor* me, void* scratch, int nChans)
+{
+    uint8_t* ptr = scratch;
+
+    memset (me, 0, sizeof (DwaCompressor));
+    me->channelData = (ChannelData*) ptr;
+    me->cscSets     = (int*) (ptr + (uint64_t) nChans * sizeof (ChannelData));
+
+    /* keep the row pointers aligned */
+    while (((uintptr_t) (me->cscSets + nChans)) & (sizeof (uint8_t*) - 1))
+        me->cscSets = (int*) (((uint8_t*) me->cscSets) + sizeof (int));
+}
+
+static exr_result_t
+apply_dwa_impl (exr_encode_pipeline_t* encode, AcCompression acCompression)
+{
+    DwaCompressor me;
+    exr_result_t  rv;
+    INTERN_EXR_PROMOTE_CONST_CONTEXT_OR_ERROR (encode->context);
+
+    rv = dwa_initialize ();
+    if (rv != EXR_ERR_SUCCESS)
+        return pctxt->report_error (
+            pctxt, rv, "Unable to initialize DWA lookup tables");
+
+    rv = internal_encode_alloc_buffer (
+        encode,
+        EXR_TRANSCODE_BUFFER_SCRATCH2,
+        &(encode->scratch_buffer_2),
+        &(encode->scratch_alloc_size_2),
+        channelScratchSize (encode->channels, encode->channel_count));
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    initializeCompressor (
+        &me, encode->scratch_buffer_2, encode->channel_count);
+    initializeChannelData (
+        &me, encode->channels, encode->channel_count, &(encode->chunk));
+
+    return DwaCompressor_compress (&me, encode, acCompression);
+}
+
+static exr_result_t
+undo_dwa_impl (
+    exr_decode_pipeline_t* decode,
+    const void*            compressed_data,
+    uint64_t               comp_buf_size,
+    void*                  uncompressed_data,
+    uint64_t               uncompressed_size)
+{
+    DwaCompressor me;
+    exr_result_t  rv;
+    INTERN_EXR_PROMOTE_CONST_CONTEXT_OR_ERROR (decode->context);
+
+    rv = dwa_initialize ();
+    if (rv != EXR_ERR_SUCCESS)
+        return pctxt->report_error (
+            pctxt, rv, "Unable to initialize DWA lookup tables");
+
+    rv = internal_decode_alloc_buffer (
+        decode,
+        EXR_TRANSCODE_BUFFER_SCRATCH2,
+        &(decode->scratch_buffer_2),
+        &(decode->scratch_alloc_size_2),
+        channelScratchSize (decode->channels, decode->channel_count));
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    initializeCompressor (
+        &me, decode->scratch_buffer_2, decode->channel_count);
+    initializeChannelData (
+        &me, decode->channels, decode->channel_count, &(decode->chunk));
+
+    return DwaCompressor_uncompress (
+        &me,
+        decode,
+        compressed_data,
+        comp_buf_size,
+        uncompressed_data,
+        uncompressed_size);
+}
+
 /**************************************/
 
 exr_result_t
@@ -18,10 +1929,11 @@ internal_exr_apply_dwaa (exr_encode_pipeline_t* encode)
 {
     EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
         encode->context, encode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/A compression not yet implemented in C");
+
+    /* tiled DWAA parts deflate the AC coefficients */
+    return apply_dwa_impl (
+        encode,
+        (part->storage_mode == EXR_STORAGE_TILED) ? DEFLATE : STATIC_HUFFMAN);
 }
 
 /**************************************/
@@ -29,12 +1941,7 @@ internal_exr_apply_dwaa (exr_encode_pipeline_t* encode)
 exr_result_t
 internal_exr_apply_dwab (exr_encode_pipeline_t* encode)
 {
-    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
-        encode->context, encode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/B compression not yet implemented in C");
+    return apply_dwa_impl (encode, STATIC_HUFFMAN);
 }
 
 exr_result_t
@@ -45,16 +1952,12 @@ internal_exr_undo_dwaa (
     void*                  uncompressed_data,
     uint64_t               uncompressed_size)
 {
-    (void) compressed_data;
-    (void) comp_buf_size;
-    (void) uncompressed_data;
-    (void) uncompressed_size;
-    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
-        decode->context, decode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/A decompression not yet implemented in C");
+    return undo_dwa_impl (
+        decode,
+        compressed_data,
+        comp_buf_size,
+        uncompressed_data,
+        uncompressed_size);
 }
 
 exr_result_t
@@ -65,14 +1968,10 @@ internal_exr_undo_dwab (
     void*                  uncompressed_data,
     uint64_t               uncompressed_size)
 {
-    (void) compressed_data;
-    (void) comp_buf_size;
-    (void) uncompressed_data;
-    (void) uncompressed_size;
-    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
-        decode->context, decode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/B decompression not yet implemented in C");
+    return undo_dwa_impl (
+        decode,
+        compressed_data,
+        comp_buf_size,
+        uncompressed_data,
+        uncompressed_size);
 }
@@ -0,0 +1,1062 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_PRIVATE_DWA_SIMD_H
+#define OPENEXR_PRIVATE_DWA_SIMD_H
+
+/*
+ * Various SSE / AVX accelerated functions used by the DWA compressor,
+ * ported from ImfDwaCompressorSimd.h in the C++ library. The
+ * arithmetic is kept in the same order as the C++ versions so that
+ * files written and read by either library are bit-identical.
+ *
+ * Unless otherwise noted, all pointers to 64 element blocks are
+ * assumed to be 32-byte aligned.
+ */
+
+#include "internal_coding.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined __SSE2__ || (_MSC_VER >= 1300 && (_M_IX86 || _M_X64))
+#    define IMF_HAVE_SSE2 1
+#    include <emmintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(_M_X64)) &&                                \
+    (defined(__GNUC__) || defined(__clang__))
+#    define DWA_HAVE_AVX_TARGET 1
+#    include <cpuid.h>
+#    include <immintrin.h>
+#endif
+
+#define DWA_SIMD_ALIGNMENT 32
+
+/**************************************/
+
+/*
+ * Color space conversion, Inverse 709 CSC, Y'CbCr -> R'G'B'
+ */
+
+static inline void
+csc709Inverse (float* comp0, float* comp1, float* comp2)
+{
+    float src[3];
+
+    src[0] = *comp0;
+    src[1] = *comp1;
+    src[2] = *comp2;
+
+    *comp0 = src[0] + 1.5747f * src[2];
+    *comp1 = src[0] - 0.1873f * src[1] - 0.4682f * src[2];
+    *comp2 = src[0] + 1.8556f * src[1];
+}
+
+#ifndef IMF_HAVE_SSE2
+
+static inline void
+csc709Inverse64 (float* comp0, float* comp1, float* comp2)
+{
+    for (int i = 0; i < 64; ++i)
+        csc709Inverse (comp0 + i, comp1 + i, comp2 + i);
+}
+
+#else /* IMF_HAVE_SSE2 */
+
+static inline void
+csc709Inverse64 (float* comp0, float* comp1, float* comp2)
+{
+    const __m128 c0 = _mm_set1_ps (1.5747f);
+    const __m128 c1 = _mm_set1_ps (1.8556f);
+    const __m128 c2 = _mm_set1_ps (-0.1873f);
+    const __m128 c3 = _mm_set1_ps (-0.4682f);
+
+    __m128* r = (__m128*) comp0;
+    __m128* g = (__m128*) comp1;
+    __m128* b = (__m128*) comp2;
+    __m128  src[3];
+
+    for (int i = 0; i < 16; ++i)
+    {
+        src[0] = r[i];
+        src[1] = g[i];
+        src[2] = b[i];
+
+        r[i] = _mm_add_ps (r[i], _mm_mul_ps (src[2], c0));
+
+        g[i]   = _mm_mul_ps (g[i], c2);
+        src[2] = _mm_mul_ps (src[2], c3);
+        g[i]   = _mm_add_ps (g[i], src[0]);
+        g[i]   = _mm_add_ps (g[i], src[2]);
+
+        b[i] = _mm_mul_ps (c1, src[1]);
+        b[i] = _mm_add_ps (b[i], src[0]);
+    }
+}
+
+#endif /* IMF_HAVE_SSE2 */
+
+/*
+ * Color space conversion, Forward 709 CSC, R'G'B' -> Y'CbCr
+ *
+ * Simple FPU color space conversion. Based on the 709 primary
+ * chromaticies, with no scaling or offsets.
+ */
+
+static inline void
+csc709Forward64 (float* comp0, float* comp1, float* comp2)
+{
+    float src[3];
+
+    for (int i = 0; i < 64; ++i)
+    {
+        src[0] = comp0[i];
+        src[1] = comp1[i];
+        src[2] = comp2[i];
+
+        comp0[i] = 0.2126f * src[0] + 0.7152f * src[1] + 0.0722f * src[2];
+        comp1[i] = -0.1146f * src[0] - 0.3854f * src[1] + 0.5000f * src[2];
+        comp2[i] = 0.5000f * src[0] - 0.4542f * src[1] - 0.0458f * src[2];
+    }
+}
+
+/**************************************/
+
+/*
+ * Float -> half conversion of a 64 element block
+ */
+
+static void
+convertFloatToHalf64_scalar (uint16_t* dst, const float* src)
+{
+    for (int i = 0; i < 64; ++i)
+        dst[i] = float_to_half (src[i]);
+}
+
+/*
+ * Convert an 8x8 block of HALF from zig-zag order to FLOAT in
+ * normal order. The order we want is:
+ *
+ *          src                           dst
+ *  0  1  2  3  4  5  6  7       0  1  5  6 14 15 27 28
+ *  8  9 10 11 12 13 14 15       2  4  7 13 16 26 29 42
+ * 16 17 18 19 20 21 22 23       3  8 12 17 25 30 41 43
+ * 24 25 26 27 28 29 30 31       9 11 18 24 31 40 44 53
+ * 32 33 34 35 36 37 38 39      10 19 23 32 39 45 52 54
+ * 40 41 42 43 44 45 46 47      20 22 33 38 46 51 55 60
+ * 48 49 50 51 52 53 54 55      21 34 37 47 50 56 59 61
+ * 56 57 58 59 60 61 62 63      35 36 48 49 57 58 62 63
+ */
+
+static const uint8_t dwaFromZigZag[64] = {
+    0,  1,  5,  6,  14, 15, 27, 28, 2,  4,  7,  13, 16, 26, 29, 42,
+    3,  8,  12, 17, 25, 30, 41, 43, 9,  11, 18, 24, 31, 40, 44, 53,
+    10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
+    21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63};
+
+static void
+fromHalfZigZag_scalar (const uint16_t* src, float* dst)
+{
+    for (int i = 0; i < 64; ++i)
+        dst[i] = half_to_float (src[dwaFromZigZag[i]]);
+}
+
+#ifdef DWA_HAVE_AVX_TARGET
+
+__attribute__ ((target ("avx,f16c"))) static void
+convertFloatToHalf64_f16c (uint16_t* dst, const float* src)
+{
+    for (int i = 0; i < 64; i += 8)
+    {
+        _mm_store_si128 (
+            (__m128i*) (dst + i), _mm256_cvtps_ph (_mm256_load_ps (src + i), 0));
+    }
+}
+
+__attribute__ ((target ("avx,f16c"))) static void
+fromHalfZigZag_f16c (const uint16_t* src, float* dst)
+{
+    uint16_t tmp[64] __attribute__ ((aligned (DWA_SIMD_ALIGNMENT)));
+
+    for (int i = 0; i < 64; ++i)
+        tmp[i] = src[dwaFromZigZag[i]];
+
+    for (int i = 0; i < 64; i += 8)
+    {
+        _mm256_store_ps (
+            dst + i, _mm256_cvtph_ps (_mm_load_si128 ((__m128i*) (tmp + i))));
+    }
+}
+
+#endif /* DWA_HAVE_AVX_TARGET */
+
+/**************************************/
+
+/*
+ * Inverse 8x8 DCT, only inverting the DC. This assumes that all AC
+ * frequencies are 0.
+ */
+
+static inline void
+dctInverse8x8DcOnly (float* data)
+{
+    float val = data[0] * 3.535536e-01f * 3.535536e-01f;
+
+#ifdef IMF_HAVE_SSE2
+    __m128  src = _mm_set1_ps (val);
+    __m128* dst = (__m128*) data;
+
+    for (int i = 0; i < 16; ++i)
+        dst[i] = src;
+#else
+    for (int i = 0; i < 64; ++i)
+        data[i] = val;
+#endif
+}
+
+/*
+ * Full 8x8 Inverse DCT:
+ *
+ * This is based on the iDCT formuation (y = frequency domain,
+ *                                       x = spatial domain)
+ *
+ *    [x0]    [        ][y0]    [        ][y1]
+ *    [x1] =  [  M1    ][y2]  + [  M2    ][y3]
+ *    [x2]    [        ][y4]    [        ][y5]
+ *    [x3]    [        ][y6]    [        ][y7]
+ *
+ *    [x7]    [        ][y0]    [        ][y1]
+ *    [x6] =  [  M1    ][y2]  - [  M2    ][y3]
+ *    [x5]    [        ][y4]    [        ][y5]
+ *    [x4]    [        ][y6]    [        ][y7]
+ *
+ * where M1:             M2:
+ *
+ *   [a  c  a   f]     [b  d  e  g]
+ *   [a  f -a  -c]     [d -g -b -e]
+ *   [a -f -a   c]     [e -b  g  d]
+ *   [a -c  a  -f]     [g -e  d -b]
+ *
+ * If you know how many of the lower rows are zero, that can be
+ * passed in to help speed things up. If you don't know, just set
+ * zeroedRows=0.
+ */
+
+static void
+dctInverse8x8_scalar (float* data, int zeroedRows)
+{
+    const float a = .5f * cosf (3.14159f / 4.0f);
+    const float b = .5f * cosf (3.14159f / 16.0f);
+    const float c = .5f * cosf (3.14159f / 8.0f);
+    const float d = .5f * cosf (3.f * 3.14159f / 16.0f);
+    const float e = .5f * cosf (5.f * 3.14159f / 16.0f);
+    const float f = .5f * cosf (3.f * 3.14159f / 8.0f);
+    const float g = .5f * cosf (7.f * 3.14159f / 16.0f);
+
+    float alpha[4], beta[4], theta[4], gamma[4];
+
+    float* rowPtr = NULL;
+
+    /* First pass - row wise. */
+
+    for (int row = 0; row < 8 - zeroedRows; ++row)
+    {
+        rowPtr = data + row * 8;
+
+        alpha[0] = c * rowPtr[2];
+        alpha[1] = f * rowPtr[2];
+        alpha[2] = c * rowPtr[6];
+        alpha[3] = f * rowPtr[6];
+
+        beta[0] = b * rowPtr[1] + d * rowPtr[3] + e * rowPtr[5] + g * rowPtr[7];
+        beta[1] = d * rowPtr[1] - g * rowPtr[3] - b * rowPtr[5] - e * rowPtr[7];
+        beta[2] = e * rowPtr[1] - b * rowPtr[3] + g * rowPtr[5] + d * rowPtr[7];
+        beta[3] = g * rowPtr[1] - e * rowPtr[3] + d * rowPtr[5] - b * rowPtr[7];
+
+        theta[0] = a * (rowPtr[0] + rowPtr[4]);
+        theta[3] = a * (rowPtr[0] - rowPtr[4]);
+
+        theta[1] = alpha[0] + alpha[3];
+        theta[2] = alpha[1] - alpha[2];
+
+        gamma[0] = theta[0] + theta[1];
+        gamma[1] = theta[3] + theta[2];
+        gamma[2] = theta[3] - theta[2];
+        gamma[3] = theta[0] - theta[1];
+
+        rowPtr[0] = gamma[0] + beta[0];
+        rowPtr[1] = gamma[1] + beta[1];
+        rowPtr[2] = gamma[2] + beta[2];
+        rowPtr[3] = gamma[3] + beta[3];
+
+        rowPtr[4] = gamma[3] - beta[3];
+        rowPtr[5] = gamma[2] - beta[2];
+        rowPtr[6] = gamma[1] - beta[1];
+        rowPtr[7] = gamma[0] - beta[0];
+    }
+
+    /* Second pass - column wise. */
+
+    for (int column = 0; column < 8; ++column)
+    {
+        alpha[0] = c * data[16 + column];
+        alpha[1] = f * data[16 + column];
+        alpha[2] = c * data[48 + column];
+        alpha[3] = f * data[48 + column];
+
+        beta[0] = b * data[8 + column] + d * data[24 + column] +
+                  e * data[40 + column] + g * data[56 + column];
+
+        beta[1] = d * data[8 + column] - g * data[24 + column] -
+                  b * data[40 + column] - e * data[56 + column];
+
+        beta[2] = e * data[8 + column] - b * data[24 + column] +
+                  g * data[40 + column] + d * data[56 + column];
+
+        beta[3] = g * data[8 + column] - e * data[24 + column] +
+                  d * data[40 + column] - b * data[56 + column];
+
+        theta[0] = a * (data[column] + data[32 + column]);
+        theta[3] = a * (data[column] - data[32 + column]);
+
+        theta[1] = alpha[0] + alpha[3];
+        theta[2] = alpha[1] - alpha[2];
+
+        gamma[0] = theta[0] + theta[1];
+        gamma[1] = theta[3] + theta[2];
+        gamma[2] = theta[3] - theta[2];
+        gamma[3] = theta[0] - theta[1];
+
+        data[column]      = gamma[0] + beta[0];
+        data[8 + column]  = gamma[1] + beta[1];
+        data[16 + column] = gamma[2] + beta[2];
+        data[24 + column] = gamma[3] + beta[3];
+
+        data[32 + column] = gamma[3] - beta[3];
+        data[40 + column] = gamma[2] - beta[2];
+        data[48 + column] = gamma[1] - beta[1];
+        data[56 + column] = gamma[0] - beta[0];
+    }
+}
+
+#ifdef IMF_HAVE_SSE2
+
+/*
+ * SSE2 Implementation
+ *
+ * Rows are treated as a matrix-vector multiplication, broadcasting
+ * each component of the row and accumulating against the columns of
+ * M1 (c0-c3) and M2 (c4-c7). Columns are then done 4 at a time, in
+ * two batches.
+ */
+
+static void
+dctInverse8x8_sse2 (float* data, int zeroedRows)
+{
+    const __m128 a = _mm_set1_ps (3.535536e-01f);
+    const __m128 b = _mm_set1_ps (4.903927e-01f);
+    const __m128 c = _mm_set1_ps (4.619398e-01f);
+    const __m128 d = _mm_set1_ps (4.157349e-01f);
+    const __m128 e = _mm_set1_ps (2.777855e-01f);
+    const __m128 f = _mm_set1_ps (1.913422e-01f);
+    const __m128 g = _mm_set1_ps (9.754573e-02f);
+
+    const __m128 c0 = _mm_setr_ps (
+        3.535536e-01f, 3.535536e-01f, 3.535536e-01f, 3.535536e-01f);
+    const __m128 c1 = _mm_setr_ps (
+        4.619398e-01f, 1.913422e-01f, -1.913422e-01f, -4.619398e-01f);
+    const __m128 c2 = _mm_setr_ps (
+        3.535536e-01f, -3.535536e-01f, -3.535536e-01f, 3.535536e-01f);
+    const __m128 c3 = _mm_setr_ps (
+        1.913422e-01f, -4.619398e-01f, 4.619398e-01f, -1.913422e-01f);
+
+    const __m128 c4 = _mm_setr_ps (
+        4.903927e-01f, 4.157349e-01f, 2.777855e-01f, 9.754573e-02f);
+    const __m128 c5 = _mm_setr_ps (
+        4.157349e-01f, -9.754573e-02f, -4.903927e-01f, -2.777855e-01f);
+    const __m128 c6 = _mm_setr_ps (
+        2.777855e-01f, -4.903927e-01f, 9.754573e-02f, 4.157349e-01f);
+    const __m128 c7 = _mm_setr_ps (
+        9.754573e-02f, -2.777855e-01f, 4.157349e-01f, -4.903927e-01f);
+
+    __m128* srcVec = (__m128*) data;
+    __m128  x[8], evenSum, oddSum;
+    __m128  in[8], alpha[4], beta[4], theta[4], gamma[4];
+
+    /* Rows */
+    for (int i = 0; i < 8 - zeroedRows; ++i)
+    {
+        x[0] = _mm_shuffle_ps (
+            srcVec[2 * i], srcVec[2 * i], _MM_SHUFFLE (0, 0, 0, 0));
+        x[1] = _mm_shuffle_ps (
+            srcVec[2 * i], srcVec[2 * i], _MM_SHUFFLE (1, 1, 1, 1));
+        x[2] = _mm_shuffle_ps (
+            srcVec[2 * i], srcVec[2 * i], _MM_SHUFFLE (2, 2, 2, 2));
+        x[3] = _mm_shuffle_ps (
+            srcVec[2 * i], srcVec[2 * i], _MM_SHUFFLE (3, 3, 3, 3));
+        x[4] = _mm_shuffle_ps (
+            srcVec[2 * i + 1], srcVec[2 * i + 1], _MM_SHUFFLE (0, 0, 0, 0));
+        x[5] = _mm_shuffle_ps (
+            srcVec[2 * i + 1], srcVec[2 * i + 1], _MM_SHUFFLE (1, 1, 1, 1));
+        x[6] = _mm_shuffle_ps (
+            srcVec[2 * i + 1], srcVec[2 * i + 1], _MM_SHUFFLE (2, 2, 2, 2));
+        x[7] = _mm_shuffle_ps (
+            srcVec[2 * i + 1], srcVec[2 * i + 1], _MM_SHUFFLE (3, 3, 3, 3));
+
+        x[0] = _mm_mul_ps (x[0], c0);
+        x[2] = _mm_mul_ps (x[2], c1);
+        x[4] = _mm_mul_ps (x[4], c2);
+        x[6] = _mm_mul_ps (x[6], c3);
+
+        x[1] = _mm_mul_ps (x[1], c4);
+        x[3] = _mm_mul_ps (x[3], c5);
+        x[5] = _mm_mul_ps (x[5], c6);
+        x[7] = _mm_mul_ps (x[7], c7);
+
+        evenSum = _mm_setzero_ps ();
+        evenSum = _mm_add_ps (evenSum, x[0]);
+        evenSum = _mm_add_ps (evenSum, x[2]);
+        evenSum = _mm_add_ps (evenSum, x[4]);
+        evenSum = _mm_add_ps (evenSum, x[6]);
+
+        oddSum = _mm_setzero_ps ();
+        oddSum = _mm_add_ps (oddSum, x[1]);
+        oddSum = _mm_add_ps (oddSum, x[3]);
+        oddSum = _mm_add_ps (oddSum, x[5]);
+        oddSum = _mm_add_ps (oddSum, x[7]);
+
+        /*
+         *    out [0, 1, 2, 3] = evenSum + oddSum
+         *    out [7, 6, 5, 4] = evenSum - oddSum
+         */
+        srcVec[2 * i]     = _mm_add_ps (evenSum, oddSum);
+        srcVec[2 * i + 1] = _mm_sub_ps (evenSum, oddSum);
+        srcVec[2 * i + 1] = _mm_shuffle_ps (
+            srcVec[2 * i + 1], srcVec[2 * i + 1], _MM_SHUFFLE (0, 1, 2, 3));
+    }
+
+    /* Columns */
+    for (int col = 0; col < 2; ++col)
+    {
+        for (int i = 0; i < 8; ++i)
+            in[i] = srcVec[2 * i + col];
+
+        alpha[0] = _mm_mul_ps (c, in[2]);
+        alpha[1] = _mm_mul_ps (f, in[2]);
+        alpha[2] = _mm_mul_ps (c, in[6]);
+        alpha[3] = _mm_mul_ps (f, in[6]);
+
+        beta[0] = _mm_add_ps (
+            _mm_add_ps (_mm_mul_ps (in[1], b), _mm_mul_ps (in[3], d)),
+            _mm_add_ps (_mm_mul_ps (in[5], e), _mm_mul_ps (in[7], g)));
+
+        beta[1] = _mm_sub_ps (
+            _mm_sub_ps (_mm_mul_ps (in[1], d), _mm_mul_ps (in[3], g)),
+            _mm_add_ps (_mm_mul_ps (in[5], b), _mm_mul_ps (in[7], e)));
+
+        beta[2] = _mm_add_ps (
+            _mm_sub_ps (_mm_mul_ps (in[1], e), _mm_mul_ps (in[3], b)),
+            _mm_add_ps (_mm_mul_ps (in[5], g), _mm_mul_ps (in[7], d)));
+
+        beta[3] = _mm_add_ps (
+            _mm_sub_ps (_mm_mul_ps (in[1], g), _mm_mul_ps (in[3], e)),
+            _mm_sub_ps (_mm_mul_ps (in[5], d), _mm_mul_ps (in[7], b)));
+
+        theta[0] = _mm_mul_ps (a, _mm_add_ps (in[0], in[4]));
+        theta[3] = _mm_mul_ps (a, _mm_sub_ps (in[0], in[4]));
+
+        theta[1] = _mm_add_ps (alpha[0], alpha[3]);
+        theta[2] = _mm_sub_ps (alpha[1], alpha[2]);
+
+        gamma[0] = _mm_add_ps (theta[0], theta[1]);
+        gamma[1] = _mm_add_ps (theta[3], theta[2]);
+        gamma[2] = _mm_sub_ps (theta[3], theta[2]);
+        gamma[3] = _mm_sub_ps (theta[0], theta[1]);
+
+        srcVec[col]     = _mm_add_ps (gamma[0], beta[0]);
+        srcVec[2 + col] = _mm_add_ps (gamma[1], beta[1]);
+        srcVec[4 + col] = _mm_add_ps (gamma[2], beta[2]);
+        srcVec[6 + col] = _mm_add_ps (gamma[3], beta[3]);
+
+        srcVec[8 + col]  = _mm_sub_ps (gamma[3], beta[3]);
+        srcVec[10 + col] = _mm_sub_ps (gamma[2], beta[2]);
+        srcVec[12 + col] = _mm_sub_ps (gamma[1], beta[1]);
+        srcVec[14 + col] = _mm_sub_ps (gamma[0], beta[0]);
+    }
+}
+
+#endif /* IMF_HAVE_SSE2 */
+
+#ifdef DWA_HAVE_AVX_TARGET
+
+/*
+ * AVX Implementation
+ *
+ * The row pass handles 2 rows per register, with the even columns
+ * of both rows in one register and the odd columns in another. The
+ * column pass then works on full 8-wide rows. Terms depending on
+ * rows known to be zero are skipped entirely, which is both where the
+ * speed comes from, and why the expressions are grouped differently
+ * than the SSE2 version.
+ */
+
+/* The column-major version of M1, followed by the column-major
+ * version of M2 */
+static const float dwaAvxCoef[32] __attribute__ ((aligned (32))) = {
+    3.535536e-01f,  3.535536e-01f,  3.535536e-01f,  3.535536e-01f,
+    4.619398e-01f,  1.913422e-01f,  -1.913422e-01f, -4.619398e-01f,
+    3.535536e-01f,  -3.535536e-01f, -3.535536e-01f, 3.535536e-01f,
+    1.913422e-01f,  -4.619398e-01f, 4.619398e-01f,  -1.913422e-01f,
+
+    4.903927e-01f,  4.157349e-01f,  2.777855e-01f,  9.754573e-02f,
+    4.157349e-01f,  -9.754573e-02f, -4.903927e-01f, -2.777855e-01f,
+    2.777855e-01f,  -4.903927e-01f, 9.754573e-02f,  4.157349e-01f,
+    9.754573e-02f,  -2.777855e-01f, 4.157349e-01f,  -4.903927e-01f};
+
+/* 1D iDCT on rows 2*pair and 2*pair+1, leaving the results in
+ * row0 and row1 */
+__attribute__ ((target ("avx"))) static inline void
+dctInverse8x8_avx_rows (const float* data, __m256* row0, __m256* row1)
+{
+    __m256 t0, t1, d0, d1, even, odd, front, back;
+    __m256 m0, m1, m2, m3, s0, s1, s2, s3;
+
+    /* a0 a2 a4 a6 | b0 b2 b4 b6  and  a1 a3 a5 a7 | b1 b3 b5 b7 */
+    t0 = _mm256_insertf128_ps (
+        _mm256_castps128_ps256 (_mm_load_ps (data)), _mm_load_ps (data + 8), 1);
+    t1 = _mm256_insertf128_ps (
+        _mm256_castps128_ps256 (_mm_load_ps (data + 4)),
+        _mm_load_ps (data + 12),
+        1);
+    d0 = _mm256_castpd_ps (
+        _mm256_unpacklo_pd (_mm256_castps_pd (t0), _mm256_castps_pd (t1)));
+    d1 = _mm256_castpd_ps (
+        _mm256_unpackhi_pd (_mm256_castps_pd (t0), _mm256_castps_pd (t1)));
+    t0   = _mm256_unpacklo_ps (d0, d1);
+    t1   = _mm256_unpackhi_ps (d0, d1);
+    even = _mm256_castpd_ps (
+        _mm256_unpacklo_pd (_mm256_castps_pd (t0), _mm256_castps_pd (t1)));
+    odd = _mm256_castpd_ps (
+        _mm256_unpackhi_pd (_mm256_castps_pd (t0), _mm256_castps_pd (t1)));
+
+    m0 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef));
+    m1 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef + 4));
+    m2 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef + 8));
+    m3 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef + 12));
+
+    s0   = _mm256_mul_ps (_mm256_permute_ps (even, 0x00), m0);
+    s1   = _mm256_mul_ps (_mm256_permute_ps (even, 0x55), m1);
+    s2   = _mm256_mul_ps (_mm256_permute_ps (even, 0xaa), m2);
+    s3   = _mm256_mul_ps (_mm256_permute_ps (even, 0xff), m3);
+    even = _mm256_add_ps (_mm256_add_ps (s0, s1), _mm256_add_ps (s2, s3));
+
+    m0 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef + 16));
+    m1 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef + 20));
+    m2 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef + 24));
+    m3 = _mm256_broadcast_ps ((const __m128*) (dwaAvxCoef + 28));
+
+    s0  = _mm256_mul_ps (_mm256_permute_ps (odd, 0x00), m0);
+    s1  = _mm256_mul_ps (_mm256_permute_ps (odd, 0x55), m1);
+    s2  = _mm256_mul_ps (_mm256_permute_ps (odd, 0xaa), m2);
+    s3  = _mm256_mul_ps (_mm256_permute_ps (odd, 0xff), m3);
+    odd = _mm256_add_ps (_mm256_add_ps (s0, s1), _mm256_add_ps (s2, s3));
+
+    back  = _mm256_permute_ps (_mm256_sub_ps (even, odd), 0x1b);
+    front = _mm256_add_ps (even, odd);
+
+    *row0 = _mm256_permute2f128_ps (back, front, 0x02);
+    *row1 = _mm256_permute2f128_ps (back, front, 0x13);
+}
+
+__attribute__ ((target ("avx"))) static void
+dctInverse8x8_avx (float* data, int zeroedRows)
+{
+    const int nRows = 8 - zeroedRows;
+    __m256    r[8];
+    __m256    a, b, c, d, e, f, g;
+    __m256    odd0, odd1, odd2, odd3, t1, t7, t11, t, e0, e1, e2, e3;
+
+    a = _mm256_set1_ps (dwaAvxCoef[0]);
+
+    if (zeroedRows == 7)
+    {
+        /* DC only in the columns, so multiply the first row by a
+         * and we're done */
+        dctInverse8x8_avx_rows (data, r, r + 1);
+        r[0] = _mm256_mul_ps (r[0], a);
+        for (int i = 0; i < 8; ++i)
+            _mm256_store_ps (data + 8 * i, r[0]);
+        return;
+    }
+
+    /* Row 1D DCT, two rows at a time. The rows past nRows are never
+     * read, but the compiler can not tell */
+    for (int i = nRows; i < 8; ++i)
+        r[i] = _mm256_setzero_ps ();
+    for (int i = 0; i < nRows; i += 2)
+        dctInverse8x8_avx_rows (data + 8 * i, r + i, r + i + 1);
+
+    /* Column 1D DCT */
+    b = _mm256_set1_ps (dwaAvxCoef[16]);
+    d = _mm256_set1_ps (dwaAvxCoef[17]);
+    e = _mm256_set1_ps (dwaAvxCoef[18]);
+    g = _mm256_set1_ps (dwaAvxCoef[19]);
+    c = _mm256_set1_ps (dwaAvxCoef[4]);
+    f = _mm256_set1_ps (dwaAvxCoef[5]);
+
+    /* odd0 = b r1 + d r3 + e r5 + g r7 */
+    odd0 = _mm256_mul_ps (r[1], b);
+    if (nRows > 3) odd0 = _mm256_add_ps (_mm256_mul_ps (r[3], d), odd0);
+    if (nRows > 5)
+    {
+        t = _mm256_mul_ps (r[5], e);
+        if (nRows > 7) t = _mm256_add_ps (_mm256_mul_ps (r[7], g), t);
+        odd0 = _mm256_add_ps (t, odd0);
+    }
+
+    /* odd1 = d r1 - g r3 - b r5 - e r7 */
+    odd1 = _mm256_mul_ps (r[1], d);
+    if (nRows > 3)
+    {
+        t = _mm256_mul_ps (r[3], g);
+        if (nRows > 5) t = _mm256_add_ps (_mm256_mul_ps (r[5], b), t);
+        odd1 = _mm256_sub_ps (odd1, t);
+    }
+    if (nRows > 7) odd1 = _mm256_sub_ps (odd1, _mm256_mul_ps (r[7], e));
+
+    /* odd2 = e r1 - b r3 + g r5 + d r7 */
+    odd2 = _mm256_mul_ps (r[1], e);
+    if (nRows > 3) odd2 = _mm256_sub_ps (odd2, _mm256_mul_ps (r[3], b));
+    if (nRows > 5) odd2 = _mm256_add_ps (odd2, _mm256_mul_ps (r[5], g));
+    if (nRows > 7) odd2 = _mm256_add_ps (odd2, _mm256_mul_ps (r[7], d));
+
+    /* odd3 = g r1 - e r3 + d r5 - b r7 */
+    odd3 = _mm256_mul_ps (r[1], g);
+    if (nRows > 5) odd3 = _mm256_add_ps (_mm256_mul_ps (r[5], d), odd3);
+    if (nRows > 3)
+    {
+        t = _mm256_mul_ps (r[3], e);
+        if (nRows > 7) t = _mm256_add_ps (_mm256_mul_ps (r[7], b), t);
+        odd3 = _mm256_sub_ps (odd3, t);
+    }
+
+    /* t11 = (a r0 + a r4), t1 = (a r0 - a r4) */
+    t11 = _mm256_mul_ps (a, r[0]);
+    t1  = t11;
+    if (nRows > 4)
+    {
+        t   = _mm256_mul_ps (a, r[4]);
+        t11 = _mm256_add_ps (t11, t);
+        t1  = _mm256_sub_ps (t1, t);
+    }
+
+    /* E_0 = t11 + (c r2 + f r6), E_3 = t11 - (c r2 + f r6) */
+    /* E_1 = t1 + (f r2 - c r6),  E_2 = t1 - (f r2 - c r6) */
+    e0 = e3 = t11;
+    e1 = e2 = t1;
+    if (nRows > 2)
+    {
+        t7 = _mm256_mul_ps (c, r[2]);
+        if (nRows > 6) t7 = _mm256_add_ps (t7, _mm256_mul_ps (f, r[6]));
+        e0 = _mm256_add_ps (e0, t7);
+        e3 = _mm256_sub_ps (e3, t7);
+
+        t7 = _mm256_mul_ps (f, r[2]);
+        if (nRows > 6) t7 = _mm256_sub_ps (t7, _mm256_mul_ps (c, r[6]));
+        e1 = _mm256_add_ps (t1, t7);
+        e2 = _mm256_sub_ps (t1, t7);
+    }
+
+    _mm256_store_ps (data, _mm256_add_ps (e0, odd0));
+    _mm256_store_ps (data + 8, _mm256_add_ps (e1, odd1));
+    _mm256_store_ps (data + 16, _mm256_add_ps (e2, odd2));
+    _mm256_store_ps (data + 24, _mm256_add_ps (e3, odd3));
+    _mm256_store_ps (data + 32, _mm256_sub_ps (e3, odd3));
+    _mm256_store_ps (data + 40, _mm256_sub_ps (e2, odd2));
+    _mm256_store_ps (data + 48, _mm256_sub_ps (e1, odd1));
+    _mm256_store_ps (data + 56, _mm256_sub_ps (e0, odd0));
+}
+
+#endif /* DWA_HAVE_AVX_TARGET */
+
+/**************************************/
+
+/*
+ * Full 8x8 Forward DCT:
+ *
+ * Base forward 8x8 DCT implementation. Works on the data in-place
+ *
+ * The implementation described in Pennebaker + Mitchell,
+ *  section 4.3.2, and illustrated in figure 4-7
+ *
+ * The basic idea is that the 1D DCT math reduces to:
+ *
+ *   2*out_0            = c_4 [(s_07 + s_34) + (s_12 + s_56)]
+ *   2*out_4            = c_4 [(s_07 + s_34) - (s_12 + s_56)]
+ *
+ *   {2*out_2, 2*out_6} = rot_6 ((d_12 - d_56), (s_07 - s_34))
+ *
+ *   {2*out_3, 2*out_5} = rot_-3 (d_07 - c_4 (s_12 - s_56),
+ *                                d_34 - c_4 (d_12 + d_56))
+ *
+ *   {2*out_1, 2*out_7} = rot_-1 (d_07 + c_4 (s_12 - s_56),
+ *                               -d_34 - c_4 (d_12 + d_56))
+ *
+ * where:
+ *
+ *    c_i  = cos(i*pi/16)
+ *    s_i  = sin(i*pi/16)
+ *
+ *    s_ij = in_i + in_j
+ *    d_ij = in_i - in_j
+ *
+ *    rot_i(x, y) = {c_i*x + s_i*y, -s_i*x + c_i*y}
+ */
+
+#ifndef IMF_HAVE_SSE2
+
+static void
+dctForward8x8 (float* data)
+{
+    float A0, A1, A2, A3, A4, A5, A6, A7;
+    float K0, K1, rot_x, rot_y;
+
+    float* srcPtr = data;
+    float* dstPtr = data;
+
+    const float c1 = cosf (3.14159f * 1.0f / 16.0f);
+    const float c2 = cosf (3.14159f * 2.0f / 16.0f);
+    const float c3 = cosf (3.14159f * 3.0f / 16.0f);
+    const float c4 = cosf (3.14159f * 4.0f / 16.0f);
+    const float c5 = cosf (3.14159f * 5.0f / 16.0f);
+    const float c6 = cosf (3.14159f * 6.0f / 16.0f);
+    const float c7 = cosf (3.14159f * 7.0f / 16.0f);
+
+    const float c1Half = .5f * c1;
+    const float c2Half = .5f * c2;
+    const float c3Half = .5f * c3;
+    const float c5Half = .5f * c5;
+    const float c6Half = .5f * c6;
+    const float c7Half = .5f * c7;
+
+    /* First pass - do a 1D DCT over the rows, in place */
+
+    for (int row = 0; row < 8; ++row)
+    {
+        float* srcRowPtr = srcPtr + 8 * row;
+        float* dstRowPtr = dstPtr + 8 * row;
+
+        A0 = srcRowPtr[0] + srcRowPtr[7];
+        A1 = srcRowPtr[1] + srcRowPtr[2];
+        A2 = srcRowPtr[1] - srcRowPtr[2];
+        A3 = srcRowPtr[3] + srcRowPtr[4];
+        A4 = srcRowPtr[3] - srcRowPtr[4];
+        A5 = srcRowPtr[5] + srcRowPtr[6];
+        A6 = srcRowPtr[5] - srcRowPtr[6];
+        A7 = srcRowPtr[0] - srcRowPtr[7];
+
+        K0 = c4 * (A0 + A3);
+        K1 = c4 * (A1 + A5);
+
+        dstRowPtr[0] = .5f * (K0 + K1);
+        dstRowPtr[4] = .5f * (K0 - K1);
+
+        /* (2*dst2, 2*dst6) = rot 6 (d12 - d56,  s07 - s34) */
+
+        rot_x = A2 - A6;
+        rot_y = A0 - A3;
+
+        dstRowPtr[2] = c6Half * rot_x + c2Half * rot_y;
+        dstRowPtr[6] = c6Half * rot_y - c2Half * rot_x;
+
+        K0 = c4 * (A1 - A5);
+        K1 = -1 * c4 * (A2 + A6);
+
+        /* (2*dst3, 2*dst5) = rot -3 ( d07 - K0,  d34 + K1 ) */
+
+        rot_x = A7 - K0;
+        rot_y = A4 + K1;
+
+        dstRowPtr[3] = c3Half * rot_x - c5Half * rot_y;
+        dstRowPtr[5] = c5Half * rot_x + c3Half * rot_y;
+
+        /* (2*dst1, 2*dst7) = rot -1 ( d07 + K0,  K1  - d34 ) */
+
+        rot_x = A7 + K0;
+        rot_y = K1 - A4;
+
+        dstRowPtr[1] = c1Half * rot_x - c7Half * rot_y;
+        dstRowPtr[7] = c7Half * rot_x + c1Half * rot_y;
+    }
+
+    /* Second pass - do the same, but on the columns */
+
+    for (int column = 0; column < 8; ++column)
+    {
+        A0 = srcPtr[column] + srcPtr[56 + column];
+        A7 = srcPtr[column] - srcPtr[56 + column];
+
+        A1 = srcPtr[8 + column] + srcPtr[16 + column];
+        A2 = srcPtr[8 + column] - srcPtr[16 + column];
+
+        A3 = srcPtr[24 + column] + srcPtr[32 + column];
+        A4 = srcPtr[24 + column] - srcPtr[32 + column];
+
+        A5 = srcPtr[40 + column] + srcPtr[48 + column];
+        A6 = srcPtr[40 + column] - srcPtr[48 + column];
+
+        K0 = c4 * (A0 + A3);
+        K1 = c4 * (A1 + A5);
+
+        dstPtr[column]      = .5f * (K0 + K1);
+        dstPtr[32 + column] = .5f * (K0 - K1);
+
+        rot_x = A2 - A6;
+        rot_y = A0 - A3;
+
+        dstPtr[16 + column] = .5f * (c6 * rot_x + c2 * rot_y);
+        dstPtr[48 + column] = .5f * (c6 * rot_y - c2 * rot_x);
+
+        K0 = c4 * (A1 - A5);
+        K1 = -1 * c4 * (A2 + A6);
+
+        rot_x = A7 - K0;
+        rot_y = A4 + K1;
+
+        dstPtr[24 + column] = .5f * (c3 * rot_x - c5 * rot_y);
+        dstPtr[40 + column] = .5f * (c5 * rot_x + c3 * rot_y);
+
+        rot_x = A7 + K0;
+        rot_y = K1 - A4;
+
+        dstPtr[8 + column]  = .5f * (c1 * rot_x - c7 * rot_y);
+        dstPtr[56 + column] = .5f * (c7 * rot_x + c1 * rot_y);
+    }
+}
+
+#else /* IMF_HAVE_SSE2 */
+
+/*
+ * SSE2 implementation
+ *
+ * Here, we're always doing a column-wise operation plus transposes.
+ */
+
+static void
+dctForward8x8 (float* data)
+{
+    __m128* srcVec = (__m128*) data;
+    __m128  a0Vec, a1Vec, a2Vec, a3Vec, a4Vec, a5Vec, a6Vec, a7Vec;
+    __m128  k0Vec, k1Vec, rotXVec, rotYVec;
+    __m128  transTmp[4], transTmp2[4];
+
+    const __m128 c4Vec    = _mm_set1_ps (.70710678f);
+    const __m128 c4NegVec = _mm_set1_ps (-.70710678f);
+
+    const __m128 c1HalfVec = _mm_set1_ps (.490392640f);
+    const __m128 c2HalfVec = _mm_set1_ps (.461939770f);
+    const __m128 c3HalfVec = _mm_set1_ps (.415734810f);
+    const __m128 c5HalfVec = _mm_set1_ps (.277785120f);
+    const __m128 c6HalfVec = _mm_set1_ps (.191341720f);
+    const __m128 c7HalfVec = _mm_set1_ps (.097545161f);
+
+    const __m128 halfVec = _mm_set1_ps (.5f);
+
+    for (int iter = 0; iter < 2; ++iter)
+    {
+        /*
+         *  Operate on 4 columns at a time. The offsets into our
+         *  row-major array are:
+         *                  0:  0      1
+         *                  1:  2      3
+         *                  2:  4      5
+         *                  3:  6      7
+         *                  4:  8      9
+         *                  5: 10     11
+         *                  6: 12     13
+         *                  7: 14     15
+         */
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            a0Vec = _mm_add_ps (srcVec[0 + pass], srcVec[14 + pass]);
+            a1Vec = _mm_add_ps (srcVec[2 + pass], srcVec[4 + pass]);
+            a3Vec = _mm_add_ps (srcVec[6 + pass], srcVec[8 + pass]);
+            a5Vec = _mm_add_ps (srcVec[10 + pass], srcVec[12 + pass]);
+
+            a7Vec = _mm_sub_ps (srcVec[0 + pass], srcVec[14 + pass]);
+            a2Vec = _mm_sub_ps (srcVec[2 + pass], srcVec[4 + pass]);
+            a4Vec = _mm_sub_ps (srcVec[6 + pass], srcVec[8 + pass]);
+            a6Vec = _mm_sub_ps (srcVec[10 + pass], srcVec[12 + pass]);
+
+            /* First stage; Compute out_0 and out_4 */
+
+            k0Vec = _mm_add_ps (a0Vec, a3Vec);
+            k1Vec = _mm_add_ps (a1Vec, a5Vec);
+
+            k0Vec = _mm_mul_ps (c4Vec, k0Vec);
+            k1Vec = _mm_mul_ps (c4Vec, k1Vec);
+
+            srcVec[0 + pass] = _mm_add_ps (k0Vec, k1Vec);
+            srcVec[8 + pass] = _mm_sub_ps (k0Vec, k1Vec);
+
+            srcVec[0 + pass] = _mm_mul_ps (srcVec[0 + pass], halfVec);
+            srcVec[8 + pass] = _mm_mul_ps (srcVec[8 + pass], halfVec);
+
+            /* Second stage; Compute out_2 and out_6 */
+
+            k0Vec = _mm_sub_ps (a2Vec, a6Vec);
+            k1Vec = _mm_sub_ps (a0Vec, a3Vec);
+
+            srcVec[4 + pass] = _mm_add_ps (
+                _mm_mul_ps (c6HalfVec, k0Vec), _mm_mul_ps (c2HalfVec, k1Vec));
+
+            srcVec[12 + pass] = _mm_sub_ps (
+                _mm_mul_ps (c6HalfVec, k1Vec), _mm_mul_ps (c2HalfVec, k0Vec));
+
+            /* Precompute K0 and K1 for the remaining stages */
+
+            k0Vec = _mm_mul_ps (_mm_sub_ps (a1Vec, a5Vec), c4Vec);
+            k1Vec = _mm_mul_ps (_mm_add_ps (a2Vec, a6Vec), c4NegVec);
+
+            /* Third Stage, compute out_3 and out_5 */
+
+            rotXVec = _mm_sub_ps (a7Vec, k0Vec);
+            rotYVec = _mm_add_ps (a4Vec, k1Vec);
+
+            srcVec[6 + pass] = _mm_sub_ps (
+                _mm_mul_ps (c3HalfVec, rotXVec),
+                _mm_mul_ps (c5HalfVec, rotYVec));
+
+            srcVec[10 + pass] = _mm_add_ps (
+                _mm_mul_ps (c5HalfVec, rotXVec),
+                _mm_mul_ps (c3HalfVec, rotYVec));
+
+            /* Fourth Stage, compute out_1 and out_7 */
+
+            rotXVec = _mm_add_ps (a7Vec, k0Vec);
+            rotYVec = _mm_sub_ps (k1Vec, a4Vec);
+
+            srcVec[2 + pass] = _mm_sub_ps (
+                _mm_mul_ps (c1HalfVec, rotXVec),
+                _mm_mul_ps (c7HalfVec, rotYVec));
+
+            srcVec[14 + pass] = _mm_add_ps (
+                _mm_mul_ps (c7HalfVec, rotXVec),
+                _mm_mul_ps (c1HalfVec, rotYVec));
+        }
+
+        /*
+         * Transpose the matrix, in 4x4 blocks. So, if we have our
+         * 8x8 matrix divied into 4x4 blocks:
+         *
+         *         M0 | M1         M0t | M2t
+         *        ----+---   -->  -----+------
+         *         M2 | M3         M1t | M3t
+         */
+
+        transTmp[0] = _mm_shuffle_ps (srcVec[0], srcVec[2], 0x44);
+        transTmp[1] = _mm_shuffle_ps (srcVec[4], srcVec[6], 0x44);
+        transTmp[3] = _mm_shuffle_ps (srcVec[4], srcVec[6], 0xEE);
+        transTmp[2] = _mm_shuffle_ps (srcVec[0], srcVec[2], 0xEE);
+
+        transTmp2[0] = _mm_shuffle_ps (srcVec[9], srcVec[11], 0x44);
+        transTmp2[1] = _mm_shuffle_ps (srcVec[13], srcVec[15], 0x44);
+        transTmp2[2] = _mm_shuffle_ps (srcVec[9], srcVec[11], 0xEE);
+        transTmp2[3] = _mm_shuffle_ps (srcVec[13], srcVec[15], 0xEE);
+
+        srcVec[0] = _mm_shuffle_ps (transTmp[0], transTmp[1], 0x88);
+        srcVec[4] = _mm_shuffle_ps (transTmp[2], transTmp[3], 0x88);
+        srcVec[2] = _mm_shuffle_ps (transTmp[0], transTmp[1], 0xDD);
+        srcVec[6] = _mm_shuffle_ps (transTmp[2], transTmp[3], 0xDD);
+
+        srcVec[9]  = _mm_shuffle_ps (transTmp2[0], transTmp2[1], 0x88);
+        srcVec[13] = _mm_shuffle_ps (transTmp2[2], transTmp2[3], 0x88);
+        srcVec[11] = _mm_shuffle_ps (transTmp2[0], transTmp2[1], 0xDD);
+        srcVec[15] = _mm_shuffle_ps (transTmp2[2], transTmp2[3], 0xDD);
+
+        /* M1 and M2 need to be done at the same time, because we're
+         * swapping. */
+
+        transTmp[0] = _mm_shuffle_ps (srcVec[1], srcVec[3], 0x44);
+        transTmp[1] = _mm_shuffle_ps (srcVec[5], srcVec[7], 0x44);
+        transTmp[2] = _mm_shuffle_ps (srcVec[1], srcVec[3], 0xEE);
+        transTmp[3] = _mm_shuffle_ps (srcVec[5], srcVec[7], 0xEE);
+
+        transTmp2[0] = _mm_shuffle_ps (srcVec[8], srcVec[10], 0x44);
+        transTmp2[1] = _mm_shuffle_ps (srcVec[12], srcVec[14], 0x44);
+        transTmp2[2] = _mm_shuffle_ps (srcVec[8], srcVec[10], 0xEE);
+        transTmp2[3] = _mm_shuffle_ps (srcVec[12], srcVec[14], 0xEE);
+
+        srcVec[8]  = _mm_shuffle_ps (transTmp[0], transTmp[1], 0x88);
+        srcVec[12] = _mm_shuffle_ps (transTmp[2], transTmp[3], 0x88);
+        srcVec[10] = _mm_shuffle_ps (transTmp[0], transTmp[1], 0xDD);
+        srcVec[14] = _mm_shuffle_ps (transTmp[2], transTmp[3], 0xDD);
+
+        srcVec[1] = _mm_shuffle_ps (transTmp2[0], transTmp2[1], 0x88);
+        srcVec[5] = _mm_shuffle_ps (transTmp2[2], transTmp2[3], 0x88);
+        srcVec[3] = _mm_shuffle_ps (transTmp2[0], transTmp2[1], 0xDD);
+        srcVec[7] = _mm_shuffle_ps (transTmp2[2], transTmp2[3], 0xDD);
+    }
+}
+
+#endif /* IMF_HAVE_SSE2 */
+
+/**************************************/
+
+/*
+ * Runtime selection of the implementations, matching the choices
+ * made by the C++ library so both produce identical pixels.
+ */
+
+static void (*convertFloatToHalf64) (uint16_t*, const float*) =
+    &convertFloatToHalf64_scalar;
+static void (*fromHalfZigZag) (const uint16_t*, float*) =
+    &fromHalfZigZag_scalar;
+static void (*dctInverse8x8) (float*, int) = &dctInverse8x8_scalar;
+
+static void
+choose_dwa_simd_impl (void)
+{
+#ifdef DWA_HAVE_AVX_TARGET
+    unsigned int regs[4] = {0, 0, 0, 0};
+    int          avx = 0, f16c = 0, sse2 = 0;
+
+    if (__get_cpuid (0, &regs[0], &regs[1], &regs[2], &regs[3]) &&
+        regs[0] >= 1 &&
+        __get_cpuid (1, &regs[0], &regs[1], &regs[2], &regs[3]))
+    {
+        sse2 = (regs[3] & (1 << 26)) != 0;
+        avx  = (regs[2] & (1 << 28)) != 0;
+        f16c = (regs[2] & (1 << 29)) != 0;
+
+        /* OSXSAVE, and the OS saving the SSE and AVX state */
+        if (!(regs[2] & (1 << 27)))
+            avx = f16c = 0;
+        else
+        {
+            unsigned int xcr0;
+            __asm__ ("xgetbv" : "=a"(xcr0) : "c"(0) : "%edx");
+            if ((xcr0 & 6) != 6) avx = f16c = 0;
+        }
+    }
+
+    if (avx && f16c)
+    {
+        convertFloatToHalf64 = &convertFloatToHalf64_f16c;
+        fromHalfZigZag       = &fromHalfZigZag_f16c;
+    }
+
+    if (avx)
+        dctInverse8x8 = &dctInverse8x8_avx;
+    else if (sse2)
+        dctInverse8x8 = &dctInverse8x8_sse2;
+#elif defined(IMF_HAVE_SSE2)
+    dctInverse8x8 = &dctInverse8x8_sse2;
+#endif
+}
+
+#endif /* OPENEXR_PRIVATE_DWA_SIMD_H */
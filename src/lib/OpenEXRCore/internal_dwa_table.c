@@ -0,0 +1,250 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+/*
+ * Lookup tables used by the DWA compressor.
+ *
+ * The C++ library generates these at build time (see dwaLookups.cpp)
+ * and compiles in ~1.5MB of source. Here we build the identical
+ * tables once, on first use, which takes a few milliseconds and keeps
+ * the source tree small.
+ *
+ *  - exrcore_dwaToLinearTable: nonlinear half -> linear half
+ *  - exrcore_dwaToNonlinearTable: linear half -> nonlinear half
+ *  - exrcore_dwaClosestData[exrcore_dwaClosestDataOffset[h]]: for a
+ *    half h with n bits set, the n closest values to h having
+ *    0, 1, ..., n-1 bits set, used when quantizing DCT coefficients.
+ *
+ * All tables are indexed by and produce native (not xdr) halfs.
+ */
+
+#include "internal_coding.h"
+#include "internal_memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DWA_NUM_HALF_VALUES 65536
+#define DWA_NUM_CLOSEST_VALUES (DWA_NUM_HALF_VALUES * 16 / 2)
+
+extern const uint16_t* exrcore_dwaToLinearTable;
+extern const uint16_t* exrcore_dwaToNonlinearTable;
+extern const uint32_t* exrcore_dwaClosestDataOffset;
+extern const uint16_t* exrcore_dwaClosestData;
+
+int exrcore_dwa_build_tables (void);
+
+static uint16_t s_toLinear[DWA_NUM_HALF_VALUES];
+static uint16_t s_toNonlinear[DWA_NUM_HALF_VALUES];
+static uint32_t s_closestDataOffset[DWA_NUM_HALF_VALUES];
+static uint16_t s_closestData[DWA_NUM_CLOSEST_VALUES];
+
+const uint16_t* exrcore_dwaToLinearTable     = s_toLinear;
+const uint16_t* exrcore_dwaToNonlinearTable  = s_toNonlinear;
+const uint32_t* exrcore_dwaClosestDataOffset = s_closestDataOffset;
+const uint16_t* exrcore_dwaClosestData       = s_closestData;
+
+/**************************************/
+
+static inline int
+count_set_bits (uint16_t v)
+{
+    int n = 0;
+    while (v)
+    {
+        v &= (uint16_t) (v - 1);
+        ++n;
+    }
+    return n;
+}
+
+static inline int
+is_nan_or_inf (uint16_t h)
+{
+    return (h & 0x7c00) == 0x7c00;
+}
+
+/**************************************/
+
+static void
+build_linear_tables (void)
+{
+    /* matches the float / double mixing of the generator in the C++
+     * library, so the tables come out bit-identical */
+    float logBase = (float) pow (2.7182818, 2.2);
+
+    s_toLinear[0]    = 0;
+    s_toNonlinear[0] = 0;
+    for (int i = 1; i < DWA_NUM_HALF_VALUES; ++i)
+    {
+        uint16_t h = (uint16_t) i;
+        float    f, sign;
+
+        if (is_nan_or_inf (h))
+        {
+            s_toLinear[i]    = 0;
+            s_toNonlinear[i] = 0;
+            continue;
+        }
+
+        f    = half_to_float (h);
+        sign = (f < 0) ? -1.f : 1.f;
+
+        if (fabsf (f) <= 1.0f)
+        {
+            s_toLinear[i] = float_to_half (sign * powf (fabsf (f), 2.2f));
+            s_toNonlinear[i] =
+                float_to_half (sign * powf (fabsf (f), 1.f / 2.2f));
+        }
+        else
+        {
+            s_toLinear[i] = float_to_half (
+                sign * powf (logBase, (float) (fabsf (f) - 1.0)));
+            s_toNonlinear[i] = float_to_half ((float) (
+                sign *
+                ((double) (logf (fabsf (f)) / logf (logBase)) + 1.0)));
+        }
+    }
+}
+
+/**************************************/
+
+/*
+ * For each bit count, the list of all non-NaN, finite halfs with that
+ * many bits set, sorted by value. The closest value to x with k bits
+ * set is then found with a binary search, taking care to break ties
+ * (including those introduced by rounding the difference to float)
+ * towards the smallest bit pattern, as the brute force search in the
+ * original generator does.
+ */
+typedef struct
+{
+    uint16_t* vals;
+    float*    fvals;
+    int       count;
+} ClosestList;
+
+static uint16_t
+closest_with_bits (const ClosestList* l, float x, int k)
+{
+    const float* fv = l->fvals;
+    int          lo = 0, hi = l->count, best, i;
+    float        bestd, d;
+
+    /* the original search starts from the first pattern with k bits,
+     * which wins whenever x is not finite */
+    if (!isfinite (x)) return (uint16_t) ((1 << k) - 1);
+
+    /* first index with fv >= x */
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (fv[mid] < x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    bestd = INFINITY;
+    if (lo < l->count) bestd = fabsf (x - fv[lo]);
+    if (lo > 0)
+    {
+        d = fabsf (x - fv[lo - 1]);
+        if (d < bestd) bestd = d;
+    }
+
+    /* distances are monotonic away from x, so walk the plateau of
+     * candidates with the minimal distance in both directions */
+    best = -1;
+    for (i = lo; i < l->count; ++i)
+    {
+        if (fabsf (x - fv[i]) != bestd) break;
+        if (best < 0 || l->vals[i] < l->vals[best]) best = i;
+    }
+    for (i = lo - 1; i >= 0; --i)
+    {
+        if (fabsf (x - fv[i]) != bestd) break;
+        if (best < 0 || l->vals[i] < l->vals[best]) best = i;
+    }
+
+    return l->vals[best];
+}
+
+static int
+build_closest_table (void)
+{
+    ClosestList lists[16];
+    uint16_t*   valstore;
+    float*      fvalstore;
+    int         counts[17] = {0};
+    uint32_t    offset     = 0;
+
+    valstore  = internal_exr_alloc (DWA_NUM_HALF_VALUES * sizeof (uint16_t));
+    fvalstore = internal_exr_alloc (DWA_NUM_HALF_VALUES * sizeof (float));
+    if (!valstore || !fvalstore)
+    {
+        internal_exr_free (valstore);
+        internal_exr_free (fvalstore);
+        return 0;
+    }
+
+    for (int i = 0; i < DWA_NUM_HALF_VALUES; ++i)
+    {
+        if (is_nan_or_inf ((uint16_t) i)) continue;
+        counts[count_set_bits ((uint16_t) i)]++;
+    }
+
+    for (int k = 0, start = 0; k < 16; ++k)
+    {
+        lists[k].vals  = valstore + start;
+        lists[k].fvals = fvalstore + start;
+        lists[k].count = 0;
+        start += counts[k];
+    }
+
+    /* walk the finite halfs in increasing value order: -max .. -0,
+     * then +0 .. +max */
+    for (int i = 0xfbff; i >= 0x8000; --i)
+    {
+        ClosestList* l = lists + count_set_bits ((uint16_t) i);
+        l->vals[l->count]  = (uint16_t) i;
+        l->fvals[l->count] = half_to_float ((uint16_t) i);
+        l->count++;
+    }
+    for (int i = 0; i < 0x7c00; ++i)
+    {
+        ClosestList* l = lists + count_set_bits ((uint16_t) i);
+        l->vals[l->count]  = (uint16_t) i;
+        l->fvals[l->count] = half_to_float ((uint16_t) i);
+        l->count++;
+    }
+
+    for (int i = 0; i < DWA_NUM_HALF_VALUES; ++i)
+    {
+        int   n = count_set_bits ((uint16_t) i);
+        float x = half_to_float ((uint16_t) i);
+
+        s_closestDataOffset[i] = offset;
+        for (int k = 0; k < n; ++k)
+            s_closestData[offset++] = closest_with_bits (lists + k, x, k);
+    }
+
+    internal_exr_free (valstore);
+    internal_exr_free (fvalstore);
+    return 1;
+}
+
+/**************************************/
+
+/*
+ * Fills in the tables, returning non-zero on success. Not thread safe,
+ * the caller is responsible for making sure this only runs once.
+ */
+int
+exrcore_dwa_build_tables (void)
+{
+    build_linear_tables ();
+    return build_closest_table ();
+}
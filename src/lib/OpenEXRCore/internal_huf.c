@@ -88,20 +88,22 @@ getBits (uint32_t nBits, uint64_t* c, uint32_t* lc, const uint8_t** inptr)
 //
 
 static void
-hufCanonicalCodeTable (uint64_t* hcode)
+hufCanonicalCodeTable (uint64_t* hcode, uint32_t im, uint32_t iM)
 {
     uint64_t n[59];
 
     //
     // For each i from 0 through 58, count the
     // number of different codes of length i, and
-    // store the count in n[i].
+    // store the count in n[i]. Only symbols im
+    // through iM can have a code, the rest of
+    // hcode is neither read nor written.
     //
 
     for (int i = 0; i <= 58; ++i)
         n[i] = 0;
 
-    for (int i = 0; i < HUF_ENCSIZE; ++i)
+    for (uint32_t i = im; i <= iM; ++i)
         n[hcode[i]] += 1;
 
     //
@@ -126,7 +128,7 @@ hufCanonicalCodeTable (uint64_t* hcode)
     // l and the code in hcode[i].
     //
 
-    for (int i = 0; i < HUF_ENCSIZE; ++i)
+    for (uint32_t i = im; i <= iM; ++i)
     {
         uint64_t l = hcode[i];
 
@@ -142,127 +144,82 @@ hufCanonicalCodeTable (uint64_t* hcode)
 //	- original frequencies are destroyed;
 //	- encoding tables are used by hufEncode() and hufBuildDecTable();
 //
-// NB: The following code "(*a == *b) && (a > b))" was added to ensure
-//     elements in the heap with the same value are sorted by index.
-//     This is to ensure, the STL make_heap()/pop_heap()/push_heap() methods
-//     produced a resultant sorted heap that is identical across OSes.
+// The heap holds the frequency and the symbol index packed into one
+// integer (frequency in the upper bits), so that nodes with the same
+// frequency are ordered by index. That is the same ordering the
+// pointer based heap of the C++ library uses, so the resulting code
+// lengths (and the encoded bits) are identical, but the heap never has
+// to chase pointers into frq.
 //
 
-static inline int
-FHeapCompare (uint64_t* a, uint64_t* b)
-{
-    return ((*a > *b) || ((*a == *b) && (a > b)));
-}
+#define HUF_HEAP_SHIFT 17
+#define HUF_HEAP_MASK ((((uint64_t) 1) << HUF_HEAP_SHIFT) - 1)
+#define HUF_HEAP_MAX_COUNT (((uint64_t) 1) << (63 - HUF_HEAP_SHIFT))
 
-static inline void
-intern_push_heap (
-    uint64_t** first, size_t holeIndex, size_t topIndex, uint64_t* value)
-{
-    size_t parent = (holeIndex - 1) / 2;
-    while (holeIndex > topIndex && FHeapCompare (*(first + parent), value))
-    {
-        *(first + holeIndex) = *(first + parent);
-        holeIndex            = parent;
-        parent               = (holeIndex - 1) / 2;
-    }
-    *(first + holeIndex) = value;
-}
+//
+// Put value at the root of the heap and restore the heap order. The
+// hole is first moved all the way down along the smaller children (one
+// compare per level), then value goes back up from there, which is
+// usually only a step or two for values that were near the bottom.
+//
 
 static inline void
-adjust_heap (uint64_t** first, size_t holeIndex, size_t len, uint64_t* value)
+heap_replace_top (uint64_t* heap, uint32_t len, uint64_t value)
 {
-    const size_t topIndex    = holeIndex;
-    size_t       secondChild = holeIndex;
+    uint32_t idx = 0;
 
-    while (secondChild < (len - 1) / 2)
+    for (;;)
     {
-        secondChild = 2 * (secondChild + 1);
-        if (FHeapCompare (*(first + secondChild), *(first + (secondChild - 1))))
-            --secondChild;
-        *(first + holeIndex) = *(first + secondChild);
-        holeIndex            = secondChild;
+        uint32_t child = 2 * idx + 1;
+        if (child + 1 < len)
+            child += (heap[child + 1] < heap[child]);
+        else if (child >= len)
+            break;
+        heap[idx] = heap[child];
+        idx       = child;
     }
 
-    if ((len & 1) == 0 && secondChild == (len - 2) / 2)
+    while (idx > 0)
     {
-        secondChild          = 2 * (secondChild + 1);
-        *(first + holeIndex) = *(first + (secondChild - 1));
-        holeIndex            = secondChild - 1;
+        uint32_t parent = (idx - 1) / 2;
+        if (heap[parent] < value) break;
+        heap[idx] = heap[parent];
+        idx       = parent;
     }
-
-    intern_push_heap (first, holeIndex, topIndex, value);
+    heap[idx] = value;
 }
 
 static inline void
-push_heap (uint64_t** first, uint64_t** last)
-{
-    uint64_t* value = *(last - 1);
-    intern_push_heap (first, (size_t) (last - first) - 1, 0, value);
-}
-
-static inline void
-intern_pop_heap (uint64_t** first, uint64_t** last, uint64_t** result)
-{
-    uint64_t* value = *result;
-    *result         = *first;
-    adjust_heap (first, 0, (size_t) (last - first), value);
-}
-
-static inline void
-pop_heap (uint64_t** first, uint64_t** last)
-{
-    if (last - first > 1)
-    {
-        --last;
-        intern_pop_heap (first, last, last);
-    }
-}
-
-static void
-make_heap (uint64_t** first, uint64_t len)
+heap_sift_down (uint64_t* heap, uint32_t len, uint32_t idx)
 {
-    size_t parent;
+    uint64_t value = heap[idx];
 
-    if (len < 2) return;
-    parent = (len - 2) / 2;
-
-    while (1)
+    for (;;)
     {
-        uint64_t* value = *(first + parent);
-        adjust_heap (first, parent, len, value);
-        if (parent == 0) return;
-        --parent;
+        uint32_t child = 2 * idx + 1;
+        if (child >= len) break;
+        if (child + 1 < len && heap[child + 1] < heap[child]) ++child;
+        if (value < heap[child]) break;
+        heap[idx] = heap[child];
+        idx       = child;
     }
+    heap[idx] = value;
 }
 
 static void
 hufBuildEncTable (
-    uint64_t*  frq,
-    uint32_t*  im,
-    uint32_t*  iM,
-    uint32_t*  hlink,
-    uint64_t** fHeap,
-    uint64_t*  scode)
+    uint64_t* frq, uint32_t* im, uint32_t* iM, uint64_t* heap, uint64_t* scode)
 {
+    uint32_t nf, nmerge;
+
     //
     // This function assumes that when it is called, array frq
     // indicates the frequency of all possible symbols in the data
     // that are to be Huffman-encoded.  (frq[i] contains the number
     // of occurrences of symbol i in the data.)
     //
-    // The loop below does three things:
-    //
-    // 1) Finds the minimum and maximum indices that point
-    //    to non-zero entries in frq:
-    //
-    //     frq[im] != 0, and frq[i] == 0 for all i < im
-    //     frq[iM] != 0, and frq[i] == 0 for all i > iM
-    //
-    // 2) Fills array fHeap with pointers to all non-zero
-    //    entries in frq.
-    //
-    // 3) Initializes array hlink such that hlink[i] == i
-    //    for all array entries.
+    // Find the minimum and maximum indices that point to non-zero
+    // entries in frq, and fill the heap with all non-zero entries.
     //
 
     *im = 0;
@@ -270,125 +227,78 @@ hufBuildEncTable (
     while (!frq[*im])
         (*im)++;
 
-    uint32_t nf = 0;
+    nf = 0;
 
     for (uint32_t i = *im; i < HUF_ENCSIZE; i++)
     {
-        hlink[i] = i;
-
         if (frq[i])
         {
-            fHeap[nf] = &frq[i];
-            ++nf;
-            *iM = i;
+            heap[nf++] = (frq[i] << HUF_HEAP_SHIFT) | i;
+            *iM        = i;
         }
     }
 
     //
     // Add a pseudo-symbol, with a frequency count of 1, to frq;
-    // adjust the fHeap and hlink array accordingly.  Function
-    // hufEncode() uses the pseudo-symbol for run-length encoding.
+    // adjust the heap accordingly.  Function hufEncode() uses the
+    // pseudo-symbol for run-length encoding.
     //
 
     (*iM)++;
-    frq[*iM]  = 1;
-    fHeap[nf] = &frq[*iM];
-    ++nf;
+    frq[*iM]   = 1;
+    heap[nf++] = (((uint64_t) 1) << HUF_HEAP_SHIFT) | *iM;
 
     //
-    // Build an array, scode, such that scode[i] contains the number
-    // of bits assigned to symbol i.  Conceptually this is done by
-    // constructing a tree whose leaves are the symbols with non-zero
-    // frequency:
+    // Build the Huffman tree: repeatedly take the two least frequent
+    // nodes off the heap and put back a node with the sum of their
+    // frequencies, keeping the index of the second one (mm is merged
+    // into m).
     //
-    //     Make a heap that contains all symbols with a non-zero frequency,
-    //     with the least frequent symbol on top.
+    // Rather than walking the list of leaves under each node to add
+    // a bit to their lengths at every merge, record the merges in
+    // the slots freed at the end of the heap, then replay them from
+    // the root down: the children of a node are one bit longer than
+    // the node itself.
     //
-    //     Repeat until only one symbol is left on the heap:
-    //
-    //         Take the two least frequent symbols off the top of the heap.
-    //         Create a new node that has first two nodes as children, and
-    //         whose frequency is the sum of the frequencies of the first
-    //         two nodes.  Put the new node back into the heap.
-    //
-    // The last node left on the heap is the root of the tree.  For each
-    // leaf node, the distance between the root and the leaf is the length
-    // of the code for the corresponding symbol.
-    //
-    // The loop below doesn't actually build the tree; instead we compute
-    // the distances of the leaves from the root on the fly.  When a new
-    // node is added to the heap, then that node's descendants are linked
-    // into a single linear list that starts at the new node, and the code
-    // lengths of the descendants (that is, their distance from the root
-    // of the tree) are incremented by one.
-    //
-
-    make_heap (fHeap, nf);
 
-    memset (scode, 0, sizeof (uint64_t) * HUF_ENCSIZE);
+    for (uint32_t i = nf / 2; i > 0; --i)
+        heap_sift_down (heap, nf, i - 1);
 
+    nmerge = nf;
     while (nf > 1)
     {
-        //
-        // Find the indices, mm and m, of the two smallest non-zero frq
-        // values in fHeap, add the smallest frq to the second-smallest
-        // frq, and remove the smallest frq value from fHeap.
-        //
+        uint64_t a = heap[0];
+        uint64_t b;
 
-        uint32_t mm = (uint32_t) (fHeap[0] - frq);
-        pop_heap (&fHeap[0], &fHeap[nf]);
         --nf;
+        heap_replace_top (heap, nf, heap[nf]);
 
-        uint32_t m = (uint32_t) (fHeap[0] - frq);
-        pop_heap (&fHeap[0], &fHeap[nf]);
-
-        frq[m] += frq[mm];
-        push_heap (&fHeap[0], &fHeap[nf]);
-
-        //
-        // The entries in scode are linked into lists with the
-        // entries in hlink serving as "next" pointers and with
-        // the end of a list marked by hlink[j] == j.
-        //
-        // Traverse the lists that start at scode[m] and scode[mm].
-        // For each element visited, increment the length of the
-        // corresponding code by one bit. (If we visit scode[j]
-        // during the traversal, then the code for symbol j becomes
-        // one bit longer.)
-        //
-        // Merge the lists that start at scode[m] and scode[mm]
-        // into a single list that starts at scode[m].
-        //
-
-        //
-        // Add a bit to all codes in the first list.
-        //
-
-        for (uint32_t j = m;; j = hlink[j])
-        {
-            scode[j]++;
+        b = heap[0];
+        heap_replace_top (
+            heap,
+            nf,
+            (((a >> HUF_HEAP_SHIFT) + (b >> HUF_HEAP_SHIFT))
+             << HUF_HEAP_SHIFT) |
+                (b & HUF_HEAP_MASK));
 
-            if (hlink[j] == j)
-            {
-                //
-                // Merge the two lists.
-                //
+        heap[nf] = ((b & HUF_HEAP_MASK) << 32) | (a & HUF_HEAP_MASK);
+    }
 
-                hlink[j] = mm;
-                break;
-            }
-        }
+    //
+    // heap[1] now holds the last merge (into the root), heap[nmerge - 1]
+    // the first one, so walking forward replays them from the root down
+    //
 
-        //
-        // Add a bit to all codes in the second list
-        //
+    memset (scode + *im, 0, sizeof (uint64_t) * (*iM - *im + 1));
 
-        for (uint32_t j = mm;; j = hlink[j])
-        {
-            scode[j]++;
+    for (uint32_t i = 1; i < nmerge; ++i)
+    {
+        uint32_t m  = (uint32_t) (heap[i] >> 32);
+        uint32_t mm = (uint32_t) (heap[i] & 0xffffffff);
+        uint64_t l  = scode[m] + 1;
 
-            if (hlink[j] == j) break;
-        }
+        scode[m]  = l;
+        scode[mm] = l;
     }
 
     //
@@ -397,8 +307,8 @@ hufBuildEncTable (
     // code table from scode into frq.
     //
 
-    hufCanonicalCodeTable (scode);
-    memcpy (frq, scode, sizeof (uint64_t) * HUF_ENCSIZE);
+    hufCanonicalCodeTable (scode, *im, *iM);
+    memcpy (frq + *im, scode + *im, sizeof (uint64_t) * (*iM - *im + 1));
 }
 
 //
@@ -472,7 +382,10 @@ hufPackEncTable (
 }
 
 //
-// Unpack an encoding table packed by hufPackEncTable():
+// Unpack an encoding table packed by hufPackEncTable(). This leaves the
+// code lengths in hcode (only entries im through iM are written) and
+// the number of codes of each length in count,
+// hufCanonicalCodeTable() turns the lengths into codes.
 //
 
 static exr_result_t
@@ -481,16 +394,17 @@ hufUnpackEncTable (
     uint64_t*       nLeft, // io: input size (in bytes), bytes left
     uint32_t        im,    // i : min hcode index
     uint32_t        iM,    // i : max hcode index
-    uint64_t*       hcode)       // o : encoding table [HUF_ENCSIZE]
+    uint64_t*       hcode, // o : encoding table [HUF_ENCSIZE]
+    uint64_t*       count) // o : count of codes per length [59]
 {
-    memset (hcode, 0, sizeof (uint64_t) * HUF_ENCSIZE);
-
     const uint8_t* p  = *pcode;
     uint64_t       c  = 0;
     uint64_t       ni = *nLeft;
     uint64_t       nr;
     uint32_t       lc = 0;
 
+    memset (count, 0, sizeof (uint64_t) * 59);
+
     for (; im <= iM; im++)
     {
         nr = (((uintptr_t) p) - ((uintptr_t) *pcode));
@@ -523,13 +437,14 @@ hufUnpackEncTable (
 
             im--;
         }
+        else
+            ++count[l];
     }
 
     nr = (((uintptr_t) p) - ((uintptr_t) *pcode));
     *nLeft -= nr;
     *pcode = p;
 
-    hufCanonicalCodeTable (hcode);
     return EXR_ERR_SUCCESS;
 }
 
@@ -668,6 +583,276 @@ hufFreeDecTable (HufDec* hdecod) // io: Decoding table
     }
 }
 
+//
+// TABLE DRIVEN DECODING
+//
+// Canonical codes of the same length are consecutive integers, so the
+// symbol for a code can be found from the code length alone: codes of
+// length l, left aligned in a 64-bit word, are all >= ljBase[l] and
+// less than ljBase[l - 1], and the position of the symbol in idToSymbol
+// is ljOffset[l] + the code. Codes of up to HUF_FAST_BITS bits are
+// also resolved with a single table access.
+//
+// The bit buffer is refilled 64 bits at a time, so it always holds at
+// least HUF_FAST_MAXLEN bits when a code is decoded. Tables with longer
+// codes (which need very skewed data) use hufDecode() instead.
+//
+
+#define HUF_FAST_BITS 12
+#define HUF_FAST_SIZE (1 << HUF_FAST_BITS)
+#define HUF_FAST_MAXLEN 56
+
+typedef struct _FastHufDecoder
+{
+    uint64_t ljBase[64];
+    uint64_t ljOffset[64];
+    uint32_t table[HUF_FAST_SIZE]; // symbol << 8 | code length, or 0
+    int      maxCodeLength;
+    uint32_t numSymbols;
+    uint32_t idToSymbol[HUF_ENCSIZE];
+} FastHufDecoder;
+
+//
+// Build the decoder from the code lengths (and counts) unpacked by
+// hufUnpackEncTable(). Only fails for invalid tables; the caller checks
+// maxCodeLength to decide whether the decoder can be used (it is 0 for
+// an empty table).
+//
+
+static exr_result_t
+fasthufInitialize (
+    FastHufDecoder* fhd,   // o : decoder
+    const uint64_t* hcode, // i : code lengths [HUF_ENCSIZE]
+    const uint64_t* count, // i : count of codes per length [59]
+    uint32_t        im,    // i : min hcode index
+    uint32_t        iM)    // i : max hcode index
+{
+    uint64_t base[59];
+    uint64_t offset[59];
+    uint64_t next[59];
+    uint64_t c, total;
+    int      minL = 64, maxL = 0;
+
+    for (int l = 1; l <= 58; ++l)
+    {
+        if (count[l] == 0) continue;
+        if (l < minL) minL = l;
+        maxL = l;
+    }
+
+    fhd->maxCodeLength = maxL;
+    if (maxL == 0 || maxL > HUF_FAST_MAXLEN) return EXR_ERR_SUCCESS;
+
+    //
+    // Same recurrence as hufCanonicalCodeTable() for the first code of
+    // each length, and the position of the first symbol of each length
+    // in idToSymbol, longest codes first
+    //
+
+    c = 0;
+    for (int l = 58; l > 0; --l)
+    {
+        base[l] = c;
+        c       = (c + count[l]) >> 1;
+    }
+    base[0] = c;
+
+    total = 0;
+    for (int l = maxL; l >= minL; --l)
+    {
+        offset[l] = total;
+        next[l]   = total;
+        total += count[l];
+    }
+    fhd->numSymbols = (uint32_t) total;
+
+    //
+    // Symbols without a code are stored past the end of the real ones
+    // (there is room for all of im through iM), rather than taking a
+    // hard to predict branch on each symbol
+    //
+
+    next[0] = total;
+    for (uint32_t i = im; i <= iM; ++i)
+        fhd->idToSymbol[next[hcode[i]]++] = i;
+
+    //
+    // A base of ~0 skips lengths without codes in the search loop; a
+    // base of 0 past the longest length stops it
+    //
+
+    for (int l = 0; l < 64; ++l)
+    {
+        if (l > maxL)
+        {
+            fhd->ljBase[l]   = 0;
+            fhd->ljOffset[l] = 0;
+        }
+        else if (l < minL || count[l] == 0)
+        {
+            fhd->ljBase[l]   = ~((uint64_t) 0);
+            fhd->ljOffset[l] = 0;
+        }
+        else
+        {
+            // the codes must fit in l bits
+            if (base[l] + count[l] > (((uint64_t) 1) << l))
+                return EXR_ERR_CORRUPT_CHUNK;
+            fhd->ljBase[l]   = base[l] << (64 - l);
+            fhd->ljOffset[l] = offset[l] - base[l];
+        }
+    }
+
+    memset (fhd->table, 0, sizeof (fhd->table));
+
+    for (int l = minL; l <= maxL && l <= HUF_FAST_BITS; ++l)
+    {
+        uint64_t n = ((uint64_t) 1) << (HUF_FAST_BITS - l);
+
+        for (uint64_t k = 0; k < count[l]; ++k)
+        {
+            uint64_t start = (base[l] + k) << (HUF_FAST_BITS - l);
+            uint32_t sym   = fhd->idToSymbol[offset[l] + k];
+
+            for (uint64_t j = start; j < start + n; ++j)
+            {
+                if (fhd->table[j]) return EXR_ERR_CORRUPT_CHUNK;
+                fhd->table[j] = (sym << 8) | (uint32_t) l;
+            }
+        }
+    }
+
+    return EXR_ERR_SUCCESS;
+}
+
+static inline uint64_t
+fasthufRead64 (const uint8_t* in)
+{
+    return (
+        (((uint64_t) in[0]) << 56) | (((uint64_t) in[1]) << 48) |
+        (((uint64_t) in[2]) << 40) | (((uint64_t) in[3]) << 32) |
+        (((uint64_t) in[4]) << 24) | (((uint64_t) in[5]) << 16) |
+        (((uint64_t) in[6]) << 8) | ((uint64_t) in[7]));
+}
+
+//
+// Top up the bit buffer (bits are consumed from the msb) to at least
+// 57 bits. Past the end of the input the buffer is padded with zero
+// bits, the caller checks the count of bits used.
+//
+
+static inline void
+fasthufRefill (
+    uint64_t* buf, int* nb, const uint8_t** inptr, const uint8_t* ie)
+{
+    const uint8_t* in = *inptr;
+    int            n  = *nb;
+
+    if (ie - in >= 8)
+    {
+        *buf |= fasthufRead64 (in) >> n;
+        in += (63 - n) >> 3;
+        n |= 56;
+    }
+    else
+    {
+        while (n <= 56 && in < ie)
+        {
+            *buf |= ((uint64_t) *in++) << (56 - n);
+            n += 8;
+        }
+        if (in >= ie) n = 64;
+    }
+
+    *inptr = in;
+    *nb    = n;
+}
+
+//
+// Decode the symbols of a stream, stopping once the output is full: all
+// of the ni input bits must have been used by then. Reads past the end
+// of the input only see zero bits, so the count of bits used is only
+// checked when decoding a run (a run of length 0 does not fill the
+// output) and at the end.
+//
+
+static exr_result_t
+fasthufDecode (
+    const FastHufDecoder* fhd, // i : decoder
+    const uint8_t*        in,  // i : compressed input buffer
+    uint64_t              ni,  // i : input size (in bits)
+    uint32_t              rlc, // i : run-length code
+    uint64_t              no,  // i : expected output size (count of uint16)
+    uint16_t*             out)
+{
+    const uint8_t* ie   = in + (ni + 7) / 8;
+    uint16_t*      outb = out;
+    uint16_t*      oe   = out + no;
+    uint64_t       buf  = 0;
+    uint64_t       used = 0;
+    int            nb   = 0;
+    const int      maxL = fhd->maxCodeLength;
+
+    while (out < oe)
+    {
+        uint32_t sym;
+        int      len;
+        uint32_t entry;
+
+        if (nb < maxL) fasthufRefill (&buf, &nb, &in, ie);
+
+        entry = fhd->table[buf >> (64 - HUF_FAST_BITS)];
+        if (entry)
+        {
+            sym = entry >> 8;
+            len = (int) (entry & 0xff);
+        }
+        else
+        {
+            uint64_t id;
+
+            len = HUF_FAST_BITS + 1;
+            while (fhd->ljBase[len] > buf)
+                ++len;
+            if (len > maxL) return EXR_ERR_CORRUPT_CHUNK;
+
+            id = fhd->ljOffset[len] + (buf >> (64 - len));
+            if (id >= fhd->numSymbols) return EXR_ERR_CORRUPT_CHUNK;
+            sym = fhd->idToSymbol[id];
+        }
+
+        used += (uint64_t) len;
+        buf <<= len;
+        nb -= len;
+
+        if (sym == rlc)
+        {
+            uint16_t s;
+            uint8_t  cs;
+
+            if (nb < 8) fasthufRefill (&buf, &nb, &in, ie);
+
+            cs = (uint8_t) (buf >> 56);
+            buf <<= 8;
+            nb -= 8;
+            used += 8;
+
+            if (used > ni) return EXR_ERR_CORRUPT_CHUNK;
+            if ((uint64_t) (oe - out) < cs) return EXR_ERR_CORRUPT_CHUNK;
+            if (out == outb) return EXR_ERR_OUT_OF_MEMORY;
+
+            s = out[-1];
+            while (cs-- > 0)
+                *out++ = s;
+        }
+        else
+            *out++ = (uint16_t) sym;
+    }
+
+    if (used != ni) return EXR_ERR_CORRUPT_CHUNK;
+    return EXR_ERR_SUCCESS;
+}
+
 //
 // ENCODING
 //
@@ -946,10 +1131,9 @@ uint64_t
 internal_exr_huf_compress_spare_bytes (void)
 {
     uint64_t ret = 0;
-    ret += HUF_ENCSIZE * sizeof (uint64_t);  // freq
-    ret += HUF_ENCSIZE * sizeof (int);       // hlink
-    ret += HUF_ENCSIZE * sizeof (uint64_t*); // fheap
-    ret += HUF_ENCSIZE * sizeof (uint64_t);  // scode
+    ret += HUF_ENCSIZE * sizeof (uint64_t); // freq
+    ret += HUF_ENCSIZE * sizeof (uint64_t); // scode
+    ret += HUF_ENCSIZE * sizeof (uint64_t); // heap
     return ret;
 }
 
@@ -958,9 +1142,11 @@ internal_exr_huf_decompress_spare_bytes (void)
 {
     uint64_t ret = 0;
     ret += HUF_ENCSIZE * sizeof (uint64_t); // freq
-    ret += HUF_DECSIZE * sizeof (HufDec);   // hdec
-    //    ret += HUF_ENCSIZE * sizeof (uint64_t*); // fheap
-    //    ret += HUF_ENCSIZE * sizeof (uint64_t);  // scode
+    // hdec, or the table driven decoder, whichever is larger
+    if (sizeof (FastHufDecoder) > HUF_DECSIZE * sizeof (HufDec))
+        ret += sizeof (FastHufDecoder);
+    else
+        ret += HUF_DECSIZE * sizeof (HufDec);
     return ret;
 }
 
@@ -974,17 +1160,16 @@ internal_huf_compress (
     void*           spare,
     uint64_t        sparebytes)
 {
-    uint64_t*  freq;
-    uint32_t*  hlink;
-    uint64_t** fHeap;
-    uint64_t*  scode;
-    uint32_t   im = 0;
-    uint32_t   iM = 0;
-    uint32_t   tableLength, nBits, dataLength;
-    uint8_t*   dataStart;
-    uint8_t*   compressed = (uint8_t*) out;
-    uint8_t*   tableStart = compressed + 20;
-    uint8_t*   tableEnd   = tableStart;
+    uint64_t* freq;
+    uint64_t* scode;
+    uint64_t* heap;
+    uint32_t  im = 0;
+    uint32_t  iM = 0;
+    uint32_t  tableLength, nBits, dataLength;
+    uint8_t*  dataStart;
+    uint8_t*  compressed = (uint8_t*) out;
+    uint8_t*  tableStart = compressed + 20;
+    uint8_t*  tableEnd   = tableStart;
 
     if (nRaw == 0)
     {
@@ -996,14 +1181,16 @@ internal_huf_compress (
     if (sparebytes != internal_exr_huf_compress_spare_bytes ())
         return EXR_ERR_INVALID_ARGUMENT;
 
+    // the heap packs the counts in the bits above the symbol index
+    if (nRaw >= HUF_HEAP_MAX_COUNT) return EXR_ERR_ARGUMENT_OUT_OF_RANGE;
+
     freq  = (uint64_t*) spare;
     scode = freq + HUF_ENCSIZE;
-    fHeap = (uint64_t**) (scode + HUF_ENCSIZE);
-    hlink = (uint32_t*) (fHeap + HUF_ENCSIZE);
+    heap  = scode + HUF_ENCSIZE;
 
     countFrequencies (freq, raw, nRaw);
 
-    hufBuildEncTable (freq, &im, &iM, hlink, fHeap, scode);
+    hufBuildEncTable (freq, &im, &iM, heap, scode);
 
     hufPackEncTable (freq, im, iM, &tableEnd);
 
@@ -1065,43 +1252,39 @@ internal_huf_decompress (
     nBytes = (((uint64_t) (nBits) + 7)) / 8;
     if (ptr + nBytes > compressed + nCompressed) return EXR_ERR_OUT_OF_MEMORY;
 
-        //
-        // Fast decoder needs at least 2x64-bits of compressed data, and
-        // needs to be run-able on this platform. Otherwise, fall back
-        // to the original decoder
-        //
-#if 0
-    if (FastHufDecoder::enabled () && nBits > 128)
     {
-        FastHufDecoder fhd (ptr, nCompressed - (ptr - compressed), im, iM, iM);
+        uint64_t*       freq  = (uint64_t*) spare;
+        FastHufDecoder* fhd   = (FastHufDecoder*) (freq + HUF_ENCSIZE);
+        uint64_t        nLeft = nCompressed - 20;
+        uint64_t        count[59];
 
-        // must be nBytes remaining in buffer
-        if (ptr - compressed + nBytes > static_cast<uint64_t> (nCompressed))
-        {
-            notEnoughData ();
-            return;
-        }
+        rv = hufUnpackEncTable (&ptr, &nLeft, im, iM, freq, count);
+        if (rv != EXR_ERR_SUCCESS) return rv;
 
-        rv = fhd.decode (ptr, nBits, raw, nRaw);
-    }
-    else
-#endif
-    {
-        uint64_t* freq     = (uint64_t*) spare;
-        HufDec*   hdec     = (HufDec*) (freq + HUF_ENCSIZE);
-        uint64_t  nLeft    = nCompressed - 20;
-        uint64_t  nTableSz = 0;
+        if (nBits > 8 * nLeft) return EXR_ERR_CORRUPT_CHUNK;
 
-        hufClearDecTable (hdec);
-        hufUnpackEncTable (&ptr, &nLeft, im, iM, freq);
+        rv = fasthufInitialize (fhd, freq, count, im, iM);
+        if (rv != EXR_ERR_SUCCESS) return rv;
 
-        if (nBits > 8 * nLeft) return EXR_ERR_CORRUPT_CHUNK;
+        if (fhd->maxCodeLength > 0 && fhd->maxCodeLength <= HUF_FAST_MAXLEN)
+            return fasthufDecode (fhd, ptr, nBits, iM, nRaw, raw);
+
+        //
+        // Codes too long for the bit buffer (or no codes at all), fall
+        // back to the original decoder, its table shares the spare
+        // memory with fhd
+        //
+        {
+            HufDec* hdec = (HufDec*) (freq + HUF_ENCSIZE);
 
-        rv = hufBuildDecTable (freq, im, iM, hdec);
-        if (rv == EXR_ERR_SUCCESS)
-            rv = hufDecode (freq, hdec, ptr, nBits, iM, nRaw, raw);
+            hufCanonicalCodeTable (freq, im, iM);
+            hufClearDecTable (hdec);
+            rv = hufBuildDecTable (freq, im, iM, hdec);
+            if (rv == EXR_ERR_SUCCESS)
+                rv = hufDecode (freq, hdec, ptr, nBits, iM, nRaw, raw);
 
-        hufFreeDecTable (hdec);
+            hufFreeDecTable (hdec);
+        }
     }
     return rv;
 }
@@ -9,10 +9,22 @@
 #include <errno.h>
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#if defined(__linux__) && defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#        include <linux/io_uring.h>
+#        include <sys/syscall.h>
+#        include <sys/uio.h>
+#        if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#            define EXR_HAS_IO_URING 1
+#        endif
+#    endif
+#endif
+
 #ifdef ILMTHREAD_THREADING_ENABLED
 #    include <pthread.h>
 #endif
@@ -28,10 +40,20 @@
 #    define CAN_USE_PREAD 0
 #endif
 
+#ifdef EXR_HAS_IO_URING
+struct _internal_exr_uring;
+#endif
+
 #if CAN_USE_PREAD
 struct _internal_exr_filehandle
 {
     int fd;
+
+    void*    map_base;
+    uint64_t map_size;
+#    ifdef EXR_HAS_IO_URING
+    struct _internal_exr_uring* uring;
+#    endif
 };
 #else
 struct _internal_exr_filehandle
@@ -40,9 +62,31 @@ struct _internal_exr_filehandle
 #    ifdef ILMTHREAD_THREADING_ENABLED
     pthread_mutex_t mutex;
 #    endif
+
+    void*    map_base;
+    uint64_t map_size;
+#    ifdef EXR_HAS_IO_URING
+    struct _internal_exr_uring* uring;
+#    endif
 };
 #endif
 
+static void
+init_filehandle (struct _internal_exr_filehandle* fh)
+{
+    fh->fd       = -1;
+    fh->map_base = NULL;
+    fh->map_size = 0;
+#ifdef EXR_HAS_IO_URING
+    fh->uring = NULL;
+#endif
+}
+
+#ifdef EXR_HAS_IO_URING
+static void uring_destroy (
+    exr_const_context_t c, struct _internal_exr_uring* ur);
+#endif
+
 /**************************************/
 
 static void
@@ -52,6 +96,10 @@ default_shutdown (exr_const_context_t c, void* userdata, int failed)
     struct _internal_exr_filehandle* fh = userdata;
     if (fh)
     {
+#ifdef EXR_HAS_IO_URING
+        if (fh->uring) uring_destroy (c, fh->uring);
+#endif
+        if (fh->map_base) munmap (fh->map_base, (size_t) fh->map_size);
         if (fh->fd >= 0) close (fh->fd);
 #if !CAN_USE_PREAD
 #    ifdef ILMTHREAD_THREADING_ENABLED
@@ -324,13 +372,149 @@ default_write_func (
 
 /**************************************/
 
+#if CAN_USE_PREAD && (defined(__linux__) || defined(__FreeBSD__) ||            \
+                      defined(__NetBSD__) || defined(__OpenBSD__))
+#    include <limits.h>
+#    include <sys/uio.h>
+#    ifndef IOV_MAX
+#        define IOV_MAX 1024
+#    endif
+#    define EXR_HAS_DEFAULT_READ_VEC 1
+#endif
+
+#if defined(EXR_HAS_DEFAULT_READ_VEC) || defined(EXR_HAS_IO_URING)
+/* continue a vectored read which returned `done` bytes so far, until
+ * all the buffers are full or the end of file is reached */
+static int64_t
+finish_vec_read (
+    int                 fd,
+    const exr_io_vec_t* vecs,
+    int                 count,
+    uint64_t            offset,
+    uint64_t            done)
+{
+    uint64_t pos = 0;
+
+    for (int v = 0; v < count; ++v)
+    {
+        uint64_t vend = pos + vecs[v].size;
+
+        while (done < vend)
+        {
+            uint64_t skip = done - pos;
+            ssize_t  rv   = pread (
+                fd,
+                ((uint8_t*) vecs[v].buffer) + skip,
+                (size_t) (vecs[v].size - skip),
+                (off_t) (offset + done));
+            if (rv < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                return -1;
+            }
+            if (rv == 0) return (int64_t) done;
+            done += (uint64_t) rv;
+        }
+        pos = vend;
+    }
+    return (int64_t) done;
+}
+#endif
+
+#ifdef EXR_HAS_DEFAULT_READ_VEC
+static int64_t
+default_read_vec_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    const exr_io_vec_t*         vecs,
+    int                         count,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    struct _internal_exr_filehandle* fh = userdata;
+    struct iovec                     iov[64];
+    uint64_t                         done = 0, total = 0;
+    int                              v    = 0;
+
+    if (!fh || count < 0 || (count > 0 && !vecs))
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid vectored read");
+        return -1;
+    }
+
+    /* hand the vectors to the kernel in fixed size groups, stopping
+     * at the first short read, which is the end of the file */
+    while (v < count)
+    {
+        int      n = 0;
+        uint64_t want = 0;
+        ssize_t  rv;
+
+        while (v + n < count && n < (int) (sizeof (iov) / sizeof (iov[0])) &&
+               n < IOV_MAX)
+        {
+            iov[n].iov_base = vecs[v + n].buffer;
+            iov[n].iov_len  = (size_t) vecs[v + n].size;
+            want += vecs[v + n].size;
+            ++n;
+        }
+
+        do
+        {
+            rv = preadv (fh->fd, iov, n, (off_t) (offset + done));
+        } while (rv < 0 && (errno == EINTR || errno == EAGAIN));
+
+        if (rv < 0)
+        {
+            if (error_cb)
+                error_cb (
+                    ctxt,
+                    EXR_ERR_READ_IO,
+                    "Unable to read requested data: %s",
+                    strerror (errno));
+            return -1;
+        }
+
+        total += want;
+        if ((uint64_t) rv < want)
+        {
+            /* the kernel may return short before the end of file for
+             * very large requests, finish with plain reads */
+            int64_t frv = finish_vec_read (
+                fh->fd, vecs, v + n, offset, done + (uint64_t) rv);
+            if (frv < 0)
+            {
+                if (error_cb)
+                    error_cb (
+                        ctxt,
+                        EXR_ERR_READ_IO,
+                        "Unable to read requested data: %s",
+                        strerror (errno));
+                return -1;
+            }
+            if ((uint64_t) frv < total) return frv;
+            done = (uint64_t) frv;
+        }
+        else
+            done += (uint64_t) rv;
+        v += n;
+    }
+
+    return (int64_t) done;
+}
+#endif
+
+/**************************************/
+
 static exr_result_t
 default_init_read_file (struct _internal_exr_context* file)
 {
     int                              fd;
     struct _internal_exr_filehandle* fh = file->user_data;
 
-    fh->fd = -1;
+    init_filehandle (fh);
 #if !CAN_USE_PREAD
 #    ifdef ILMTHREAD_THREADING_ENABLED
     fd = pthread_mutex_init (&(fh->mutex), NULL);
@@ -345,6 +529,9 @@ default_init_read_file (struct _internal_exr_context* file)
 
     file->destroy_fn = &default_shutdown;
     file->read_fn    = &default_read_func;
+#ifdef EXR_HAS_DEFAULT_READ_VEC
+    file->read_vec_fn = &default_read_vec_func;
+#endif
 
     fd = open (file->filename.str, O_RDONLY | O_CLOEXEC);
     if (fd < 0)
@@ -380,7 +567,7 @@ default_init_write_file (struct _internal_exr_context* file)
 #    endif
 #endif
 
-    fh->fd           = -1;
+    init_filehandle (fh);
     file->destroy_fn = &default_shutdown;
     file->write_fn   = &default_write_func;
 
@@ -401,6 +588,431 @@ default_init_write_file (struct _internal_exr_context* file)
 
 /**************************************/
 
+static int64_t
+mmap_read_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    struct _internal_exr_filehandle* fh = userdata;
+
+    if (!fh || !fh->map_base)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid file handle pointer");
+        return -1;
+    }
+
+    /* behave as pread would at the end of the file */
+    if (offset >= fh->map_size) return 0;
+    if (sz > fh->map_size - offset) sz = fh->map_size - offset;
+
+    memcpy (buffer, ((const uint8_t*) fh->map_base) + offset, (size_t) sz);
+    return (int64_t) sz;
+}
+
+/**************************************/
+
+static exr_result_t
+init_mmap_backend (struct _internal_exr_context* file)
+{
+    struct _internal_exr_filehandle* fh = file->user_data;
+    struct stat                      sbuf;
+    void*                            base;
+
+    if (fstat (fh->fd, &sbuf) != 0 || !S_ISREG (sbuf.st_mode) ||
+        sbuf.st_size <= 0)
+        return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+
+    if ((uint64_t) sbuf.st_size > (uint64_t) SIZE_MAX)
+        return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+
+    base =
+        mmap (NULL, (size_t) sbuf.st_size, PROT_READ, MAP_SHARED, fh->fd, 0);
+    if (base == MAP_FAILED) return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+
+    fh->map_base      = base;
+    fh->map_size      = (uint64_t) sbuf.st_size;
+    file->read_fn     = &mmap_read_func;
+    file->read_vec_fn = NULL;
+    file->mapped_data = (const uint8_t*) base;
+    file->mapped_size = fh->map_size;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+#ifdef EXR_HAS_IO_URING
+
+/* Minimal io_uring driver using the raw system calls, so there is no
+ * dependency on liburing. Only used to submit batches of positioned
+ * reads, under a lock, so there is a single submitter at a time. */
+
+#    define EXR_URING_ENTRIES 64
+
+struct _internal_exr_uring
+{
+    int ring_fd;
+
+    void*  sq_ring;
+    size_t sq_ring_size;
+    void*  cq_ring;
+    size_t cq_ring_size;
+
+    struct io_uring_sqe* sqes;
+    size_t               sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned  sq_entries;
+
+    unsigned*            cq_head;
+    unsigned*            cq_tail;
+    unsigned*            cq_mask;
+    struct io_uring_cqe* cqes;
+
+#    ifdef ILMTHREAD_THREADING_ENABLED
+    pthread_mutex_t mutex;
+#    endif
+};
+
+static void
+uring_destroy (exr_const_context_t c, struct _internal_exr_uring* ur)
+{
+    const struct _internal_exr_context* pctxt = EXR_CCTXT (c);
+
+    if (ur->sqes) munmap (ur->sqes, ur->sqes_size);
+    if (ur->cq_ring && ur->cq_ring != ur->sq_ring)
+        munmap (ur->cq_ring, ur->cq_ring_size);
+    if (ur->sq_ring) munmap (ur->sq_ring, ur->sq_ring_size);
+    if (ur->ring_fd >= 0) close (ur->ring_fd);
+#    ifdef ILMTHREAD_THREADING_ENABLED
+    pthread_mutex_destroy (&(ur->mutex));
+#    endif
+    pctxt->free_fn (ur);
+}
+
+static struct _internal_exr_uring*
+uring_create (struct _internal_exr_context* file)
+{
+    struct io_uring_params      p;
+    struct _internal_exr_uring* ur;
+    uint8_t*                    sq;
+    uint8_t*                    cq;
+
+    ur = file->alloc_fn (sizeof (struct _internal_exr_uring));
+    if (!ur) return NULL;
+    memset (ur, 0, sizeof (struct _internal_exr_uring));
+    ur->ring_fd = -1;
+
+#    ifdef ILMTHREAD_THREADING_ENABLED
+    if (pthread_mutex_init (&(ur->mutex), NULL) != 0)
+    {
+        file->free_fn (ur);
+        return NULL;
+    }
+#    endif
+
+    memset (&p, 0, sizeof (p));
+    ur->ring_fd =
+        (int) syscall (__NR_io_uring_setup, EXR_URING_ENTRIES, &p);
+    /* not available: old kernel, or disabled by policy / seccomp */
+    if (ur->ring_fd < 0) goto fail;
+
+    ur->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    ur->cq_ring_size =
+        p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+#    ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ur->cq_ring_size > ur->sq_ring_size)
+            ur->sq_ring_size = ur->cq_ring_size;
+        ur->cq_ring_size = ur->sq_ring_size;
+    }
+#    endif
+
+    ur->sq_ring = mmap (
+        NULL,
+        ur->sq_ring_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ur->ring_fd,
+        IORING_OFF_SQ_RING);
+    if (ur->sq_ring == MAP_FAILED)
+    {
+        ur->sq_ring = NULL;
+        goto fail;
+    }
+
+#    ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        ur->cq_ring = ur->sq_ring;
+    else
+#    endif
+    {
+        ur->cq_ring = mmap (
+            NULL,
+            ur->cq_ring_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            ur->ring_fd,
+            IORING_OFF_CQ_RING);
+        if (ur->cq_ring == MAP_FAILED)
+        {
+            ur->cq_ring = NULL;
+            goto fail;
+        }
+    }
+
+    ur->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+    ur->sqes      = mmap (
+        NULL,
+        ur->sqes_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ur->ring_fd,
+        IORING_OFF_SQES);
+    if (ur->sqes == MAP_FAILED)
+    {
+        ur->sqes = NULL;
+        goto fail;
+    }
+
+    sq             = ur->sq_ring;
+    cq             = ur->cq_ring;
+    ur->sq_head    = (unsigned*) (sq + p.sq_off.head);
+    ur->sq_tail    = (unsigned*) (sq + p.sq_off.tail);
+    ur->sq_mask    = (unsigned*) (sq + p.sq_off.ring_mask);
+    ur->sq_array   = (unsigned*) (sq + p.sq_off.array);
+    ur->sq_entries = p.sq_entries;
+    ur->cq_head    = (unsigned*) (cq + p.cq_off.head);
+    ur->cq_tail    = (unsigned*) (cq + p.cq_off.tail);
+    ur->cq_mask    = (unsigned*) (cq + p.cq_off.ring_mask);
+    ur->cqes       = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    return ur;
+
+fail:
+    uring_destroy ((exr_const_context_t) file, ur);
+    return NULL;
+}
+
+static exr_result_t
+uring_read_batch (
+    const struct _internal_exr_context* ctxt,
+    int                                 count,
+    const exr_io_vec_t*                 vecs,
+    const int*                          vec_counts,
+    const uint64_t*                     offsets,
+    int64_t*                            nread)
+{
+    struct _internal_exr_filehandle* fh = ctxt->user_data;
+    struct _internal_exr_uring*      ur = fh->uring;
+    struct iovec*                    iov;
+    int*                             firstvec;
+    int*                             retry;
+    int                              nretry    = 0;
+    int                              submitted = 0, completed = 0;
+    int                              nvecs     = 0;
+    int                              fallback  = 0;
+    unsigned                         inflight  = 0;
+
+    if (count <= 0) return EXR_ERR_SUCCESS;
+
+    for (int r = 0; r < count; ++r)
+        nvecs += vec_counts[r];
+
+    iov = ctxt->alloc_fn (
+        sizeof (struct iovec) * (size_t) nvecs +
+        2 * sizeof (int) * (size_t) count);
+    if (!iov) return ctxt->standard_error (ctxt, EXR_ERR_OUT_OF_MEMORY);
+    firstvec = (int*) (iov + nvecs);
+    retry    = firstvec + count;
+
+    nvecs = 0;
+    for (int r = 0; r < count; ++r)
+    {
+        firstvec[r] = nvecs;
+        for (int v = 0; v < vec_counts[r]; ++v, ++nvecs)
+        {
+            iov[nvecs].iov_base = vecs[nvecs].buffer;
+            iov[nvecs].iov_len  = (size_t) vecs[nvecs].size;
+        }
+    }
+
+#    ifdef ILMTHREAD_THREADING_ENABLED
+    pthread_mutex_lock (&(ur->mutex));
+#    endif
+
+    /* once the kernel refuses a submission, nothing more is queued:
+     * the reads it did not take, and the ones not yet queued, are
+     * done with regular reads once the queued ones have completed */
+    while (completed < count && (!fallback || inflight > 0))
+    {
+        unsigned first    = *(ur->sq_tail);
+        unsigned tail     = first;
+        unsigned mask     = *(ur->sq_mask);
+        unsigned tosubmit = 0;
+        unsigned consumed;
+        unsigned head;
+        long     erv;
+
+        while (!fallback && submitted < count &&
+               inflight + tosubmit < ur->sq_entries)
+        {
+            struct io_uring_sqe* sqe;
+            unsigned             idx = tail & mask;
+
+            if (vec_counts[submitted] == 0)
+            {
+                nread[submitted] = 0;
+                ++submitted;
+                ++completed;
+                continue;
+            }
+
+            sqe = ur->sqes + idx;
+            memset (sqe, 0, sizeof (struct io_uring_sqe));
+            sqe->opcode = IORING_OP_READV;
+            sqe->fd     = fh->fd;
+            sqe->addr   = (uint64_t) (uintptr_t) (iov + firstvec[submitted]);
+            sqe->len    = (unsigned) vec_counts[submitted];
+            sqe->off    = offsets[submitted];
+            sqe->user_data = (uint64_t) submitted;
+
+            ur->sq_array[idx] = idx;
+            ++tail;
+            ++submitted;
+            ++tosubmit;
+        }
+
+        if (inflight == 0 && tosubmit == 0) break;
+
+        if (tosubmit > 0)
+            __atomic_store_n (ur->sq_tail, tail, __ATOMIC_RELEASE);
+
+        /* the kernel does not wait for completions when it takes
+         * fewer entries than asked, so this can not block on reads
+         * which were never submitted */
+        do
+        {
+            erv = syscall (
+                __NR_io_uring_enter,
+                ur->ring_fd,
+                tosubmit,
+                1,
+                IORING_ENTER_GETEVENTS,
+                NULL,
+                0);
+        } while (erv < 0 && errno == EINTR);
+
+        consumed = (erv < 0) ? 0 : (unsigned) erv;
+        if (consumed > tosubmit) consumed = tosubmit;
+        inflight += consumed;
+
+        if (consumed < tosubmit)
+        {
+            /* take back the entries the kernel left in the ring, so
+             * they can not be submitted later, pointing at buffers
+             * which are gone by then */
+            for (unsigned t = first + consumed; t != tail; ++t)
+                retry[nretry++] = (int) ur->sqes[t & mask].user_data;
+            __atomic_store_n (
+                ur->sq_tail, first + consumed, __ATOMIC_RELEASE);
+            fallback = 1;
+        }
+
+        head = *(ur->cq_head);
+        while (head != __atomic_load_n (ur->cq_tail, __ATOMIC_ACQUIRE))
+        {
+            const struct io_uring_cqe* cqe = ur->cqes + (head & *(ur->cq_mask));
+            int                        r   = (int) cqe->user_data;
+            int64_t                    res = cqe->res;
+
+            /* a regular file only returns short at the end of the
+             * file, but make sure by asking for the rest */
+            if (res >= 0)
+                res = finish_vec_read (
+                    fh->fd,
+                    vecs + firstvec[r],
+                    vec_counts[r],
+                    offsets[r],
+                    (uint64_t) res);
+            nread[r] = res;
+
+            ++head;
+            ++completed;
+            --inflight;
+        }
+        __atomic_store_n (ur->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+#    ifdef ILMTHREAD_THREADING_ENABLED
+    pthread_mutex_unlock (&(ur->mutex));
+#    endif
+
+    for (int r = submitted; r < count; ++r)
+        retry[nretry++] = r;
+
+    for (int i = 0; i < nretry; ++i)
+    {
+        int r = retry[i];
+
+        if (vec_counts[r] == 0)
+            nread[r] = 0;
+        else if (ctxt->read_vec_fn)
+            nread[r] = ctxt->read_vec_fn (
+                (exr_const_context_t) ctxt,
+                ctxt->user_data,
+                vecs + firstvec[r],
+                vec_counts[r],
+                offsets[r],
+                (exr_stream_error_func_ptr_t) ctxt->print_error);
+        else
+            nread[r] = finish_vec_read (
+                fh->fd, vecs + firstvec[r], vec_counts[r], offsets[r], 0);
+    }
+
+    ctxt->free_fn (iov);
+    return EXR_ERR_SUCCESS;
+}
+
+#endif /* EXR_HAS_IO_URING */
+
+/**************************************/
+
+static exr_result_t
+default_init_read_backend (
+    struct _internal_exr_context* file, exr_default_read_mode_t mode)
+{
+    switch (mode)
+    {
+        case EXR_READ_FILE_MMAP: return init_mmap_backend (file);
+        case EXR_READ_FILE_IO_URING:
+#ifdef EXR_HAS_IO_URING
+        {
+            struct _internal_exr_filehandle* fh = file->user_data;
+            fh->uring                           = uring_create (file);
+            if (!fh->uring) return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+            file->do_read_batch = &uring_read_batch;
+            return EXR_ERR_SUCCESS;
+        }
+#else
+            return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+#endif
+        case EXR_READ_FILE_DEFAULT:
+        default: break;
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
 static int64_t
 default_query_size_func (exr_const_context_t ctxt, void* userdata)
 {
@@ -10,7 +10,6 @@
 #include "internal_xdr.h"
 
 #include <string.h>
-#include <zlib.h>
 
 /**************************************/
 
@@ -92,7 +91,8 @@ apply_pxr24_impl (exr_encode_pipeline_t* encode)
     uint8_t*       out       = encode->scratch_buffer_1;
     uint64_t       nOut      = 0;
     const uint8_t* lastIn    = encode->packed_buffer;
-    uLongf         compbufsz = encode->compressed_alloc_size;
+    uint64_t       compbufsz = 0;
+    exr_result_t   rv;
 
     for (int y = 0; y < encode->chunk.height; ++y)
     {
@@ -215,14 +215,14 @@ apply_pxr24_impl (exr_encode_pipeline_t* encode)
         }
     }
 
-    if (Z_OK != compress (
-                    (Bytef*) encode->compressed_buffer,
-                    &compbufsz,
-                    (const Bytef*) encode->scratch_buffer_1,
-                    nOut))
-    {
-        return EXR_ERR_CORRUPT_CHUNK;
-    }
+    rv = internal_exr_deflate (
+        encode->compressed_buffer,
+        encode->compressed_alloc_size,
+        encode->scratch_buffer_1,
+        nOut,
+        -1,
+        &compbufsz);
+    if (rv != EXR_ERR_SUCCESS) return rv;
     if (compbufsz > encode->packed_bytes)
     {
         memcpy (
@@ -262,8 +262,8 @@ undo_pxr24_impl (
     void*                  scratch_data,
     uint64_t               scratch_size)
 {
-    uLongf         outSize = (uLongf) uncompressed_size;
-    int            rstat;
+    uint64_t       outSize = 0;
+    exr_result_t   rstat;
     uint8_t*       out    = uncompressed_data;
     uint64_t       nOut   = 0;
     uint64_t       nDec   = 0;
@@ -271,13 +271,14 @@ undo_pxr24_impl (
 
     if (scratch_size < uncompressed_size) return EXR_ERR_INVALID_ARGUMENT;
 
-    rstat = uncompress (
-        (Bytef*) scratch_data,
-        &outSize,
-        (const Bytef*) compressed_data,
-        (uLong) comp_buf_size);
+    rstat = internal_exr_inflate (
+        scratch_data,
+        uncompressed_size,
+        compressed_data,
+        comp_buf_size,
+        &outSize);
 
-    if (rstat != Z_OK) return EXR_ERR_CORRUPT_CHUNK;
+    if (rstat != EXR_ERR_SUCCESS) return EXR_ERR_CORRUPT_CHUNK;
 
     for (int y = 0; y < decode->chunk.height; ++y)
     {
@@ -12,6 +12,7 @@
 #include <IlmThreadConfig.h>
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -407,6 +408,11 @@ internal_exr_alloc_context (
         ret->destroy_fn = initializers->destroy_fn;
         ret->read_fn    = initializers->read_fn;
         ret->write_fn   = initializers->write_fn;
+        if (initializers->read_fn &&
+            initializers->size >=
+                (offsetof (exr_context_initializer_t, read_vec_fn) +
+                 sizeof (initializers->read_vec_fn)))
+            ret->read_vec_fn = initializers->read_vec_fn;
 
 #ifdef ILMTHREAD_THREADING_ENABLED
 #    ifdef _WIN32
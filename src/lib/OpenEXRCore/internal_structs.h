@@ -178,7 +178,22 @@ struct _internal_exr_context
     exr_destroy_stream_func_ptr_t destroy_fn;
 
     int64_t             file_size;
-    exr_read_func_ptr_t read_fn;
+    exr_read_func_ptr_t     read_fn;
+    exr_read_vec_func_ptr_t read_vec_fn;
+
+    /* set by the built-in read backends (see exr_default_read_mode_t),
+     * the whole file when it is memory mapped, and a routine to issue
+     * many vectored reads at once, request i scattering into the
+     * vec_counts[i] entries of vecs following those of request i - 1 */
+    const uint8_t* mapped_data;
+    uint64_t       mapped_size;
+    exr_result_t (*do_read_batch) (
+        const struct _internal_exr_context* file,
+        int                                 count,
+        const exr_io_vec_t*                 vecs,
+        const int*                          vec_counts,
+        const uint64_t*                     offsets,
+        int64_t*                            nread);
 
     exr_write_func_ptr_t write_fn;
     /* used when writing under a mutex, is there a better way? */
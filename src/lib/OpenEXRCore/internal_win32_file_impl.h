@@ -111,6 +111,10 @@ widen_filename (struct _internal_exr_context* file, const char* fn)
 struct _internal_exr_filehandle
 {
     HANDLE fd;
+
+    HANDLE   map_handle;
+    void*    map_base;
+    uint64_t map_size;
 };
 
 /**************************************/
@@ -122,6 +126,10 @@ default_shutdown (exr_const_context_t c, void* userdata, int failed)
     struct _internal_exr_filehandle* fh = userdata;
     if (fh)
     {
+        if (fh->map_base) UnmapViewOfFile (fh->map_base);
+        if (fh->map_handle) CloseHandle (fh->map_handle);
+        fh->map_base   = NULL;
+        fh->map_handle = NULL;
         if (fh->fd != INVALID_HANDLE_VALUE) CloseHandle (fh->fd);
         fh->fd = INVALID_HANDLE_VALUE;
     }
@@ -313,6 +321,9 @@ default_init_read_file (struct _internal_exr_context* file)
     struct _internal_exr_filehandle* fh = file->user_data;
 
     fh->fd           = INVALID_HANDLE_VALUE;
+    fh->map_handle   = NULL;
+    fh->map_base     = NULL;
+    fh->map_size     = 0;
     file->destroy_fn = &default_shutdown;
     file->read_fn    = &default_read_func;
 
@@ -360,6 +371,9 @@ default_init_write_file (struct _internal_exr_context* file)
     if (outfn == NULL) outfn = file->filename.str;
 
     fh->fd           = INVALID_HANDLE_VALUE;
+    fh->map_handle   = NULL;
+    fh->map_base     = NULL;
+    fh->map_size     = 0;
     file->destroy_fn = &default_shutdown;
     file->write_fn   = &default_write_func;
 
@@ -399,6 +413,71 @@ default_init_write_file (struct _internal_exr_context* file)
 
 /**************************************/
 
+static int64_t
+mmap_read_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    struct _internal_exr_filehandle* fh = userdata;
+
+    if (!fh || !fh->map_base)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid file handle pointer");
+        return -1;
+    }
+
+    if (offset >= fh->map_size) return 0;
+    if (sz > fh->map_size - offset) sz = fh->map_size - offset;
+
+    memcpy (buffer, ((const uint8_t*) fh->map_base) + offset, (size_t) sz);
+    return (int64_t) sz;
+}
+
+/**************************************/
+
+static exr_result_t
+default_init_read_backend (
+    struct _internal_exr_context* file, exr_default_read_mode_t mode)
+{
+    struct _internal_exr_filehandle* fh   = file->user_data;
+    LARGE_INTEGER                    lint = {0};
+    HANDLE                           mh;
+    void*                            base;
+
+    /* io_uring is linux only, the default reads are used instead */
+    if (mode != EXR_READ_FILE_MMAP) return EXR_ERR_SUCCESS;
+
+    if (!GetFileSizeEx (fh->fd, &lint) || lint.QuadPart <= 0 ||
+        (uint64_t) lint.QuadPart > (uint64_t) SIZE_MAX)
+        return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+
+    mh = CreateFileMapping (fh->fd, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mh) return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+
+    base = MapViewOfFile (mh, FILE_MAP_READ, 0, 0, 0);
+    if (!base)
+    {
+        CloseHandle (mh);
+        return EXR_ERR_FEATURE_NOT_IMPLEMENTED;
+    }
+
+    fh->map_handle    = mh;
+    fh->map_base      = base;
+    fh->map_size      = (uint64_t) lint.QuadPart;
+    file->read_fn     = &mmap_read_func;
+    file->mapped_data = (const uint8_t*) base;
+    file->mapped_size = fh->map_size;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
 static int64_t
 default_query_size_func (exr_const_context_t ctxt, void* userdata)
 {
@@ -0,0 +1,43 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_PRIVATE_WORKERS_H
+#define OPENEXR_PRIVATE_WORKERS_H
+
+#include "openexr_workers.h"
+
+#include "internal_structs.h"
+
+/** Hands out the next index from a counter shared by worker tasks */
+static inline uint64_t
+internal_exr_atomic_next (atomic_uintptr_t* counter)
+{
+#if defined(__cplusplus)
+    return (uint64_t) counter->fetch_add (1);
+#elif defined(EXR_HAS_STD_ATOMICS)
+    return (uint64_t) atomic_fetch_add (counter, 1);
+#else
+    /* the interlocked call must match the size of the counter, which
+     * need not be that of a pointer */
+    if (sizeof (*counter) == sizeof (LONG64))
+        return (uint64_t) InterlockedIncrement64 (
+                   (LONG64 volatile*) counter) -
+               1;
+    return (uint64_t) InterlockedIncrement ((LONG volatile*) counter) - 1;
+#endif
+}
+
+/** Picks the pool to use (the default if @p pool is NULL) and how
+ * many tasks to run, never more than there are items to process.
+ */
+exr_result_t internal_exr_choose_workers (
+    const struct _internal_exr_context* pctxt,
+    const exr_worker_pool_t*            pool,
+    int                                 max_workers,
+    int                                 nitems,
+    const exr_worker_pool_t**           outpool,
+    int*                                ntasks);
+
+#endif /* OPENEXR_PRIVATE_WORKERS_H */
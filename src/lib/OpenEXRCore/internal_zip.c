@@ -15,6 +15,18 @@
 #include <string.h>
 #include <zlib.h>
 
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+#    include <IlmThreadConfig.h>
+#    include <libdeflate.h>
+#    ifdef ILMTHREAD_THREADING_ENABLED
+#        ifdef _WIN32
+#            include <windows.h>
+#        else
+#            include <pthread.h>
+#        endif
+#    endif
+#endif
+
 #if defined __SSE2__ || (_MSC_VER >= 1300 && (_M_IX86 || _M_X64))
 #    define IMF_HAVE_SSE2 1
 #    include <emmintrin.h>
@@ -149,44 +161,302 @@ interleave (uint8_t* out, const uint8_t* source, uint64_t outSize)
 
 /**************************************/
 
-static exr_result_t
-undo_zip_impl (
-    const void* compressed_data,
-    uint64_t    comp_buf_size,
-    void*       uncompressed_data,
-    uint64_t    uncompressed_size,
-    void*       scratch_data,
-    uint64_t    scratch_size)
+/*
+ * The zip, pxr24 and dwa compressors all store standard zlib streams,
+ * so the deflate step can be done by either zlib or libdeflate
+ * (which is quite a bit faster, but does not produce the same bytes)
+ * and read back by the other.
+ */
+
+uint64_t
+internal_exr_deflate_bound (uint64_t srcbytes)
+{
+    uint64_t bound = (uint64_t) compressBound ((uLong) srcbytes);
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    /* libdeflate wants 5 bytes per (at least 10000 byte) block, and
+     * some end padding, before it guarantees the output fits */
+    uint64_t ldbound = srcbytes + 5 * (srcbytes / 10000 + 1) + 8 + 1 + 6;
+    if (ldbound > bound) bound = ldbound;
+#endif
+    return bound;
+}
+
+/**************************************/
+
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+
+/* Allocating a libdeflate (de)compressor costs more than compressing
+ * a small chunk, so each thread keeps one of each around. They are
+ * freed when the thread exits. */
+
+typedef struct
 {
-    uLongf outSize = (uLongf) uncompressed_size;
-    int    rstat;
+    struct libdeflate_compressor*   comp;
+    int                             comp_level;
+    struct libdeflate_decompressor* decomp;
+} deflate_cache_t;
+
+#    ifdef ILMTHREAD_THREADING_ENABLED
+
+#        ifdef _WIN32
+#            define DEFLATE_CACHE_DTOR_CALL NTAPI
+#        else
+#            define DEFLATE_CACHE_DTOR_CALL
+#        endif
+
+static void DEFLATE_CACHE_DTOR_CALL
+free_deflate_cache (void* p)
+{
+    deflate_cache_t* cache = (deflate_cache_t*) p;
+
+    if (!cache) return;
+    if (cache->comp) libdeflate_free_compressor (cache->comp);
+    if (cache->decomp) libdeflate_free_decompressor (cache->decomp);
+    free (cache);
+}
 
-    if (scratch_size < uncompressed_size) return EXR_ERR_INVALID_ARGUMENT;
+#        ifdef _WIN32
+static INIT_ONCE sDeflateCacheOnce = INIT_ONCE_STATIC_INIT;
+static DWORD     sDeflateCacheKey  = FLS_OUT_OF_INDEXES;
 
-    rstat = uncompress (
-        (Bytef*) scratch_data,
-        &outSize,
-        (const Bytef*) compressed_data,
-        (uLong) comp_buf_size);
-    if (rstat == Z_OK)
+static BOOL CALLBACK
+make_deflate_cache_key (PINIT_ONCE once, PVOID param, PVOID* ctxt)
+{
+    (void) once;
+    (void) param;
+    (void) ctxt;
+    sDeflateCacheKey = FlsAlloc (&free_deflate_cache);
+    return TRUE;
+}
+
+static deflate_cache_t*
+get_deflate_cache (void)
+{
+    deflate_cache_t* cache;
+
+    InitOnceExecuteOnce (
+        &sDeflateCacheOnce, &make_deflate_cache_key, NULL, NULL);
+    if (sDeflateCacheKey == FLS_OUT_OF_INDEXES) return NULL;
+
+    cache = (deflate_cache_t*) FlsGetValue (sDeflateCacheKey);
+    if (!cache)
     {
-        if (outSize == uncompressed_size)
+        cache = (deflate_cache_t*) calloc (1, sizeof (deflate_cache_t));
+        if (cache && !FlsSetValue (sDeflateCacheKey, cache))
         {
-            reconstruct (scratch_data, outSize);
-            interleave (uncompressed_data, scratch_data, outSize);
-            rstat = EXR_ERR_SUCCESS;
+            free (cache);
+            cache = NULL;
         }
-        else
+    }
+    return cache;
+}
+#        else
+static pthread_once_t sDeflateCacheOnce  = PTHREAD_ONCE_INIT;
+static pthread_key_t  sDeflateCacheKey;
+static int            sDeflateCacheKeyOk = 0;
+
+static void
+make_deflate_cache_key (void)
+{
+    sDeflateCacheKeyOk =
+        (0 == pthread_key_create (&sDeflateCacheKey, &free_deflate_cache));
+}
+
+static deflate_cache_t*
+get_deflate_cache (void)
+{
+    deflate_cache_t* cache;
+
+    pthread_once (&sDeflateCacheOnce, &make_deflate_cache_key);
+    if (!sDeflateCacheKeyOk) return NULL;
+
+    cache = (deflate_cache_t*) pthread_getspecific (sDeflateCacheKey);
+    if (!cache)
+    {
+        cache = (deflate_cache_t*) calloc (1, sizeof (deflate_cache_t));
+        if (cache && 0 != pthread_setspecific (sDeflateCacheKey, cache))
         {
-            rstat = EXR_ERR_CORRUPT_CHUNK;
+            free (cache);
+            cache = NULL;
         }
     }
-    else
+    return cache;
+}
+#        endif
+
+#    else /* ILMTHREAD_THREADING_ENABLED */
+
+static deflate_cache_t sDeflateCache;
+
+static deflate_cache_t*
+get_deflate_cache (void)
+{
+    return &sDeflateCache;
+}
+
+#    endif /* ILMTHREAD_THREADING_ENABLED */
+
+/* the returned compressor is owned by the cache if there is one */
+static struct libdeflate_compressor*
+get_compressor (deflate_cache_t* cache, int level)
+{
+    if (!cache) return libdeflate_alloc_compressor (level);
+
+    if (cache->comp && cache->comp_level != level)
+    {
+        libdeflate_free_compressor (cache->comp);
+        cache->comp = NULL;
+    }
+    if (!cache->comp)
     {
-        rstat = EXR_ERR_CORRUPT_CHUNK;
+        cache->comp       = libdeflate_alloc_compressor (level);
+        cache->comp_level = level;
     }
+    return cache->comp;
+}
+
+static struct libdeflate_decompressor*
+get_decompressor (deflate_cache_t* cache)
+{
+    if (!cache) return libdeflate_alloc_decompressor ();
 
-    return (exr_result_t) rstat;
+    if (!cache->decomp) cache->decomp = libdeflate_alloc_decompressor ();
+    return cache->decomp;
+}
+
+#endif /* OPENEXR_HAVE_LIBDEFLATE */
+
+/**************************************/
+
+exr_result_t
+internal_exr_deflate (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    int         level,
+    uint64_t*   compbytes)
+{
+    uLongf compbufsz = (uLongf) outbytes;
+
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    exr_deflate_backend_t backend;
+
+    exr_get_default_deflate_backend (&backend);
+    if (backend == EXR_DEFLATE_BACKEND_LIBDEFLATE)
+    {
+        deflate_cache_t*              cache = get_deflate_cache ();
+        struct libdeflate_compressor* comp;
+        size_t                        nout = 0;
+
+        /* zlib and libdeflate share the same meaning for 1 - 9 */
+        if (level < 0) level = 6;
+        if (level > 12) level = 12;
+        comp = get_compressor (cache, level);
+        if (!comp) return EXR_ERR_OUT_OF_MEMORY;
+        nout = libdeflate_zlib_compress (
+            comp, src, (size_t) srcbytes, out, (size_t) outbytes);
+        if (!cache) libdeflate_free_compressor (comp);
+
+        /* 0 means it did not fit, let zlib have a go in the space
+         * given, since it has a (slightly) smaller worst case */
+        if (nout > 0)
+        {
+            *compbytes = nout;
+            return EXR_ERR_SUCCESS;
+        }
+    }
+#endif
+
+    if (Z_OK != compress2 (
+                    (Bytef*) out,
+                    &compbufsz,
+                    (const Bytef*) src,
+                    (uLong) srcbytes,
+                    level))
+    {
+        return EXR_ERR_CORRUPT_CHUNK;
+    }
+    *compbytes = compbufsz;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+internal_exr_inflate (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    uint64_t*   actual_out)
+{
+    uLongf outSize = (uLongf) outbytes;
+
+#ifdef OPENEXR_HAVE_LIBDEFLATE
+    exr_deflate_backend_t backend;
+
+    exr_get_default_deflate_backend (&backend);
+    if (backend == EXR_DEFLATE_BACKEND_LIBDEFLATE)
+    {
+        deflate_cache_t*                cache = get_deflate_cache ();
+        struct libdeflate_decompressor* decomp;
+        enum libdeflate_result          res;
+        size_t                          nout = 0;
+
+        decomp = get_decompressor (cache);
+        if (!decomp) return EXR_ERR_OUT_OF_MEMORY;
+        res = libdeflate_zlib_decompress (
+            decomp, src, (size_t) srcbytes, out, (size_t) outbytes, &nout);
+        if (!cache) libdeflate_free_decompressor (decomp);
+
+        if (res != LIBDEFLATE_SUCCESS) return EXR_ERR_CORRUPT_CHUNK;
+        *actual_out = nout;
+        return EXR_ERR_SUCCESS;
+    }
+#endif
+
+    if (Z_OK != uncompress (
+                    (Bytef*) out, &outSize, (const Bytef*) src, (uLong) srcbytes))
+        return EXR_ERR_CORRUPT_CHUNK;
+    *actual_out = outSize;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+internal_zip_decompress (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    void*       scratch,
+    uint64_t    scratchbytes)
+{
+    uint64_t     outSize = 0;
+    exr_result_t rstat;
+
+    if (scratchbytes < outbytes) return EXR_ERR_INVALID_ARGUMENT;
+
+    rstat = internal_exr_inflate (scratch, outbytes, src, srcbytes, &outSize);
+    if (rstat == EXR_ERR_SUCCESS)
+    {
+        if (outSize == outbytes)
+        {
+            if (outSize > 0)
+            {
+                reconstruct (scratch, outSize);
+                interleave (out, scratch, outSize);
+            }
+        }
+        else
+        {
+            rstat = EXR_ERR_CORRUPT_CHUNK;
+        }
+    }
+
+    return rstat;
 }
 
 /**************************************/
@@ -207,31 +477,35 @@ internal_exr_undo_zip (
         &(decode->scratch_alloc_size_1),
         uncompressed_size);
     if (rv != EXR_ERR_SUCCESS) return rv;
-    return undo_zip_impl (
-        compressed_data,
-        comp_buf_size,
+    return internal_zip_decompress (
         uncompressed_data,
         uncompressed_size,
+        compressed_data,
+        comp_buf_size,
         decode->scratch_buffer_1,
         decode->scratch_alloc_size_1);
 }
 
 /**************************************/
 
-static exr_result_t
-apply_zip_impl (exr_encode_pipeline_t* encode)
+exr_result_t
+internal_zip_compress (
+    void*       out,
+    uint64_t    outbytes,
+    const void* src,
+    uint64_t    srcbytes,
+    void*       scratch,
+    uint64_t    scratchbytes,
+    int         level,
+    uint64_t*   compbytes)
 {
-    uint8_t*       t1   = encode->scratch_buffer_1;
-    uint8_t*       t2   = t1 + (encode->packed_bytes + 1) / 2;
-    const uint8_t* raw  = encode->packed_buffer;
-    const uint8_t* stop = raw + encode->packed_bytes;
-    int            p, level;
-    uLongf         compbufsz = encode->compressed_alloc_size;
-    exr_result_t   rv        = EXR_ERR_SUCCESS;
+    uint8_t*       t1   = scratch;
+    uint8_t*       t2   = t1 + (srcbytes + 1) / 2;
+    const uint8_t* raw  = src;
+    const uint8_t* stop = raw + srcbytes;
+    int            p;
 
-    rv = exr_get_zip_compression_level (
-        encode->context, encode->part_index, &level);
-    if (rv != EXR_ERR_SUCCESS) return rv;
+    if (scratchbytes < srcbytes) return EXR_ERR_INVALID_ARGUMENT;
 
     /* reorder */
     while (raw < stop)
@@ -240,9 +514,9 @@ apply_zip_impl (exr_encode_pipeline_t* encode)
         if (raw < stop) *(t2++) = *(raw++);
     }
 
-    /* reorder */
-    t1 = encode->scratch_buffer_1;
-    t2 = t1 + encode->packed_bytes;
+    /* predictor */
+    t1 = scratch;
+    t2 = t1 + srcbytes;
     t1++;
     p = (int) t1[-1];
     while (t1 < t2)
@@ -253,15 +527,34 @@ apply_zip_impl (exr_encode_pipeline_t* encode)
         ++t1;
     }
 
-    if (Z_OK != compress2 (
-                    (Bytef*) encode->compressed_buffer,
-                    &compbufsz,
-                    (const Bytef*) encode->scratch_buffer_1,
-                    encode->packed_bytes,
-                    level))
-    {
-        return EXR_ERR_CORRUPT_CHUNK;
-    }
+    return internal_exr_deflate (
+        out, outbytes, scratch, srcbytes, level, compbytes);
+}
+
+/**************************************/
+
+static exr_result_t
+apply_zip_impl (exr_encode_pipeline_t* encode)
+{
+    int          level;
+    uint64_t     compbufsz;
+    exr_result_t rv;
+
+    rv = exr_get_zip_compression_level (
+        encode->context, encode->part_index, &level);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = internal_zip_compress (
+        encode->compressed_buffer,
+        encode->compressed_alloc_size,
+        encode->packed_buffer,
+        encode->packed_bytes,
+        encode->scratch_buffer_1,
+        encode->scratch_alloc_size_1,
+        level,
+        &compbufsz);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
     if (compbufsz > encode->packed_bytes)
     {
         memcpy (
@@ -136,6 +136,31 @@ EXR_EXPORT void exr_set_default_dwa_compression_quality (float q);
  */
 EXR_EXPORT void exr_get_default_dwa_compression_quality (float* q);
 
+/** @brief Library used for the deflate step of the zip based
+ * compression types (ZIP, ZIPS, PXR24 and parts of DWAA / DWAB).
+ *
+ * Both produce standard zlib streams, so files written with one are
+ * read by the other, although the compressed bytes may differ.
+ */
+typedef enum exr_deflate_backend
+{
+    EXR_DEFLATE_BACKEND_ZLIB       = 0,
+    EXR_DEFLATE_BACKEND_LIBDEFLATE = 1
+} exr_deflate_backend_t;
+
+/** @brief Assigns the library used to deflate / inflate zip data.
+ *
+ * libdeflate is only available if the library was built with it
+ * (OPENEXR_USE_LIBDEFLATE), and is then the default. Otherwise, this
+ * stays as zlib, which can be checked with
+ * exr_get_default_deflate_backend().
+ */
+EXR_EXPORT void exr_set_default_deflate_backend (exr_deflate_backend_t b);
+
+/** @brief Retrieve the library used to deflate / inflate zip data
+ */
+EXR_EXPORT void exr_get_default_deflate_backend (exr_deflate_backend_t* b);
+
 /** @} */
 
 /**
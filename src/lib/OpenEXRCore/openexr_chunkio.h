@@ -74,6 +74,39 @@ exr_result_t exr_read_chunk (
     const exr_chunk_info_t* cinfo,
     void*                   packed_data);
 
+/** Read the packed data for several chunks of a part in one call.
+ *
+ * \p packed_data is an array of \p nchunks buffers, each at least
+ * as large as the matching \p cinfos entry packed_size. The result
+ * is the same as calling exr_read_chunk() for each entry, but chunks
+ * which are close together in the file, in any order in \p cinfos,
+ * are fetched with a single vectored read (preadv, or the custom
+ * \c read_vec_fn of the initializer) scattering directly into the
+ * buffers. When the context was started with the io_uring read mode,
+ * all those reads are also handed to the kernel as one batch.
+ */
+EXR_EXPORT
+exr_result_t exr_read_chunks (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    int                     nchunks,
+    const exr_chunk_info_t* cinfos,
+    void* const*            packed_data);
+
+/** Retrieve a pointer to the packed data of a chunk without copying.
+ *
+ * Only available when the context was started with the mmap read
+ * mode, otherwise returns \c EXR_ERR_FEATURE_NOT_IMPLEMENTED, and the
+ * caller should use exr_read_chunk() instead. The pointer stays valid
+ * until the context is finished.
+ */
+EXR_EXPORT
+exr_result_t exr_read_chunk_mapped (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    const void**            packed_data);
+
 /**
  * Read chunk for deep data.
  *
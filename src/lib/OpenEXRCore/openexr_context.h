@@ -132,6 +132,33 @@ typedef int64_t (*exr_read_func_ptr_t) (
     uint64_t                    offset,
     exr_stream_error_func_ptr_t error_cb);
 
+/** @brief One destination range of a vectored read. */
+typedef struct _exr_io_vec
+{
+    void*    buffer; /**< Destination for the bytes. */
+    uint64_t size;   /**< Number of bytes to place in \c buffer. */
+} exr_io_vec_t;
+
+/** @brief Vectored read custom function pointer
+ *
+ * Optional companion to \c exr_read_func_ptr_t, with similar semantics
+ * to preadv: read the contiguous file range starting at \p offset,
+ * scattering it into the \p count buffers of \p vecs in order. Returns
+ * the total number of bytes read, which may be short at the end of
+ * the file, or -1 on error.
+ *
+ * It carries the same thread-safety requirements as the read
+ * function. exr_read_chunks() uses it to turn reads of neighbouring
+ * chunks into one request.
+ */
+typedef int64_t (*exr_read_vec_func_ptr_t) (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    const exr_io_vec_t*         vecs,
+    int                         count,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb);
+
 /** Write custom function pointer
  *
  *  Used to write data to a custom output. Expects similar semantics to
@@ -164,6 +191,24 @@ typedef int64_t (*exr_write_func_ptr_t) (
     uint64_t                    offset,
     exr_stream_error_func_ptr_t error_cb);
 
+/** @brief Enum describing the built-in backends used to read files.
+ *
+ * These only apply when the context opens the file itself, that is,
+ * when no custom \c read_fn is provided in the initializer.
+ */
+typedef enum exr_default_read_mode
+{
+    EXR_READ_FILE_DEFAULT =
+        0, /**< One positioned read (pread / ReadFile) per request. */
+    EXR_READ_FILE_MMAP =
+        1, /**< Map the file into memory. Reads are copies out of the
+            * mapping, and exr_read_chunk_mapped() and the decode
+            * pipeline use the mapped bytes without copying. */
+    EXR_READ_FILE_IO_URING =
+        2 /**< Linux io_uring. Multi-chunk reads (exr_read_chunks())
+           * are submitted to the kernel as one batch. */
+} exr_default_read_mode_t;
+
 /** @brief Struct used to pass function pointers into the context
  * initialization routines.
  *
@@ -313,13 +358,33 @@ typedef struct _exr_context_initializer_v2
      * for all contexts.
      */
     float dwa_quality;
+
+    /** Select the built-in file reading backend used when no custom
+     * \c read_fn is provided. Ignored otherwise. Backends which are not
+     * available on the current platform, or can not be used for the
+     * file, silently fall back to \c EXR_READ_FILE_DEFAULT.
+     *
+     * @sa exr_default_read_mode_t
+     */
+    exr_default_read_mode_t read_mode;
+
+    /** @brief Custom vectored read routine.
+     *
+     * Optional, only used along with a custom \c read_fn. When `NULL`,
+     * the internal file implementation provides one where the
+     * platform allows (preadv), otherwise batched chunk reads are
+     * issued one chunk at a time.
+     *
+     * @sa exr_read_vec_func_ptr_t
+     */
+    exr_read_vec_func_ptr_t read_vec_fn;
 } exr_context_initializer_t;
 
 /** @brief Simple macro to initialize the context initializer with default values. */
 #define EXR_DEFAULT_CONTEXT_INITIALIZER                                        \
     {                                                                          \
         sizeof (exr_context_initializer_t), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   \
-            0, -2, -1.f                                                        \
+            0, -2, -1.f, EXR_READ_FILE_DEFAULT, 0                              \
     }
 
 /** @} */ /* context function pointer declarations */
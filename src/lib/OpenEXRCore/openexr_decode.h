@@ -8,6 +8,7 @@
 
 #include "openexr_chunkio.h"
 #include "openexr_coding.h"
+#include "openexr_workers.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -307,6 +308,90 @@ EXR_EXPORT
 exr_result_t
 exr_decoding_destroy (exr_const_context_t ctxt, exr_decode_pipeline_t* decode);
 
+/** Function called by exr_decode_chunks_parallel() to set up the
+ * destination of each chunk.
+ *
+ * Called once the decode pipeline has been initialized / updated for
+ * the chunk, this should fill in the channel output information
+ * (decode_to_ptr, user_pixel_stride, etc.) and may adjust the
+ * decode_flags or provide custom read_fn, decompress_fn or
+ * unpack_and_convert_fn routines. The routines are reset to `NULL`
+ * before each call, and once this returns, those still `NULL` are
+ * filled in with the defaults (see
+ * exr_decoding_choose_default_routines()) prior to the pipeline being
+ * run.
+ *
+ * The @p chunk_index is the index of the chunk within the part (in
+ * chunk table order), and the chunk information is available in
+ * decode->chunk. This will be called concurrently from multiple
+ * threads, for different chunks.
+ */
+typedef exr_result_t (*exr_decode_chunk_setup_func_t) (
+    exr_decode_pipeline_t* decode, int chunk_index, void* user_data);
+
+/** Decodes a range of chunks of a part using a pool of workers.
+ *
+ * Decodes the chunks [first_chunk, first_chunk + num_chunks) of the
+ * specified part, as indexed in the chunk table (for scanline parts,
+ * this is in increasing y order, for tiled parts, tiles within a
+ * level in increasing y, then x order, followed by the next level).
+ * Each worker re-uses a single decode pipeline for all the chunks it
+ * decodes, so intermediate buffers are only allocated once per
+ * worker.
+ *
+ * If @p pool is `NULL`, the default pool from
+ * exr_get_default_worker_pool() is used. If @p max_workers is greater
+ * than zero, no more than that many workers are used.
+ *
+ * All chunks are attempted even if some fail. If @p chunk_results is
+ * not `NULL`, it must have room for num_chunks entries, and receives
+ * the result of each chunk. The returned value is the error from the
+ * first (lowest index) chunk which failed, or EXR_ERR_SUCCESS.
+ */
+EXR_EXPORT
+exr_result_t exr_decode_chunks_parallel (
+    exr_const_context_t           ctxt,
+    int                           part_index,
+    int                           first_chunk,
+    int                           num_chunks,
+    exr_decode_chunk_setup_func_t setup_fn,
+    void*                         user_data,
+    const exr_worker_pool_t*      pool,
+    int                           max_workers,
+    exr_result_t*                 chunk_results);
+
+/** Reads only the sample count tables of a range of chunks of a deep
+ * part, using a pool of workers.
+ *
+ * For each chunk in [first_chunk, first_chunk + num_chunks) of the
+ * specified part, in the same order as exr_decode_chunks_parallel(),
+ * the sample count table is read and decompressed, and the packed
+ * pixel data of the chunk is not read at all. This is much cheaper
+ * than decoding the chunks when only the number of samples is needed,
+ * for example to size allocations prior to decoding.
+ *
+ * @p sample_counts must have num_chunks entries, entry i receiving
+ * the table of chunk first_chunk + i, as chunk width times height
+ * native int32_t values in scanline order. If @p flags contains
+ * EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL, each value is the count
+ * for that pixel, otherwise it is the running total along the line,
+ * as stored in the file. Other bits in @p flags are ignored.
+ *
+ * @p pool, @p max_workers and @p chunk_results behave as for
+ * exr_decode_chunks_parallel().
+ */
+EXR_EXPORT
+exr_result_t exr_read_sample_counts_parallel (
+    exr_const_context_t      ctxt,
+    int                      part_index,
+    int                      first_chunk,
+    int                      num_chunks,
+    uint16_t                 flags,
+    int32_t* const*          sample_counts,
+    const exr_worker_pool_t* pool,
+    int                      max_workers,
+    exr_result_t*            chunk_results);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -8,6 +8,7 @@
 
 #include "openexr_chunkio.h"
 #include "openexr_coding.h"
+#include "openexr_workers.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -337,6 +338,70 @@ EXR_EXPORT
 exr_result_t exr_encoding_destroy (
     exr_const_context_t ctxt, exr_encode_pipeline_t* encode_pipe);
 
+/** Function called by exr_encode_chunks_parallel() to set up the
+ * source of each chunk.
+ *
+ * Called once the encode pipeline has been initialized / updated for
+ * the chunk, this should fill in the channel input information
+ * (encode_from_ptr, user_pixel_stride, etc.), and for deep parts,
+ * the sample count table. The default routines are chosen once this
+ * returns, prior to the pipeline being run.
+ *
+ * The @p chunk_index is the index of the chunk within the part (in
+ * chunk table order), and the chunk information is available in
+ * encode->chunk. This will be called concurrently from multiple
+ * threads, for different chunks.
+ */
+typedef exr_result_t (*exr_encode_chunk_setup_func_t) (
+    exr_encode_pipeline_t* encode, int chunk_index, void* user_data);
+
+/** Encodes and writes a range of chunks of a part using a pool of
+ * workers.
+ *
+ * Encodes the chunks [first_chunk, first_chunk + num_chunks) of the
+ * specified part, which must be the part currently being written, as
+ * indexed in the chunk table (see exr_decode_chunks_parallel()). The
+ * workers pack and compress chunks concurrently, each re-using a
+ * single encode pipeline. Once a chunk is compressed, its space in
+ * the file is claimed and its chunk table entry filled in under the
+ * context lock, and the data is then written outside of the lock.
+ *
+ * For parts with a line order of ::EXR_LINEORDER_RANDOM_Y, chunks
+ * are placed in the file in the order they finish compressing,
+ * otherwise they are placed in chunk table order, so the same rules
+ * apply as when calling exr_write_scanline_chunk() and friends
+ * serially: the first chunk in the range must be the next chunk to
+ * be written.
+ *
+ * The write function of the context (see
+ * exr_context_initializer_t) is called concurrently from multiple
+ * threads, for non-overlapping ranges of the file. The default file
+ * implementations are safe for this.
+ *
+ * If @p pool is `NULL`, the default pool from
+ * exr_get_default_worker_pool() is used. If @p max_workers is greater
+ * than zero, no more than that many workers are used. When the
+ * library is compiled without threading support, there is nothing to
+ * keep concurrent workers in order, so only one task is run, even
+ * for a pool provided by the caller.
+ *
+ * All chunks are attempted even if some fail. If @p chunk_results is
+ * not `NULL`, it must have room for num_chunks entries, and receives
+ * the result of each chunk. The returned value is the error from the
+ * first (lowest index) chunk which failed, or EXR_ERR_SUCCESS.
+ */
+EXR_EXPORT
+exr_result_t exr_encode_chunks_parallel (
+    exr_context_t                 ctxt,
+    int                           part_index,
+    int                           first_chunk,
+    int                           num_chunks,
+    exr_encode_chunk_setup_func_t setup_fn,
+    void*                         user_data,
+    const exr_worker_pool_t*      pool,
+    int                           max_workers,
+    exr_result_t*                 chunk_results);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
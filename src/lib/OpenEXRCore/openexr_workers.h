@@ -0,0 +1,99 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_WORKERS_H
+#define OPENEXR_CORE_WORKERS_H
+
+#include "openexr_errors.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @file */
+
+/** Function run by each task of a worker pool.
+ *
+ * The @p task_index is in the range [0, ntasks) given to
+ * exr_worker_pool_t::run_tasks, so can be used to index per-task
+ * state.
+ */
+typedef void (*exr_worker_task_func_t) (int task_index, void* task_data);
+
+/** @brief Interface to a pool of worker threads.
+ *
+ * The library does not manage threads itself, routines which can
+ * make use of multiple threads (i.e. exr_decode_chunks_parallel())
+ * ask a pool to run a small number of long lived tasks, each of
+ * which then pulls work until none remains. This allows the caller
+ * to provide an existing thread pool (IlmThread, TBB, etc.) instead
+ * of having threads spawned behind their back.
+ *
+ * A default implementation is provided by
+ * exr_get_default_worker_pool().
+ */
+typedef struct _exr_worker_pool
+{
+    /** Size of this struct, for future expansion. */
+    size_t size;
+
+    /** Passed as the first argument to the functions below. */
+    void* pool_data;
+
+    /** Returns the number of tasks the pool is able to run
+     * concurrently, used as the upper limit on the number of tasks
+     * requested.
+     */
+    int (*get_worker_count) (void* pool_data);
+
+    /** Runs @p task once for each task index in [0, ntasks), returning
+     * only once all tasks have completed.
+     *
+     * The tasks may be run in any order, and any number of them may
+     * be run by the calling thread. If the pool cannot start a task
+     * it must still run it (i.e. on the calling thread), returning an
+     * error only if a task could not be run at all.
+     */
+    exr_result_t (*run_tasks) (
+        void* pool_data, int ntasks, exr_worker_task_func_t task, void* task_data);
+} exr_worker_pool_t;
+
+/** Retrieve the default worker pool.
+ *
+ * This keeps a set of threads, started on first use and reused by
+ * later calls to run_tasks, with the calling thread running tasks as
+ * well, and reports one worker per available processor. The threads
+ * belong to the library: they are joined by
+ * exr_shutdown_default_worker_pool(), or when the library is unloaded
+ * on platforms where that can be done safely (not Windows), and
+ * otherwise live until the process exits.
+ *
+ * Only one call to run_tasks uses the threads at a time. A call made
+ * while another call is using them, for example from a second thread
+ * decoding another file, does not wait for them, but runs all of its
+ * tasks serially on the calling thread. Applications which decode
+ * from several threads at once should provide their own pool.
+ *
+ * When the library is compiled without threading support, this
+ * reports a single worker and runs the tasks serially on the calling
+ * thread.
+ */
+EXR_EXPORT const exr_worker_pool_t* exr_get_default_worker_pool (void);
+
+/** Stop and join the threads of the default worker pool.
+ *
+ * Waits for a call using the threads to finish first. Later calls
+ * start new threads as needed. This must not be called from a task
+ * run by the default pool.
+ */
+EXR_EXPORT void exr_shutdown_default_worker_pool (void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* OPENEXR_CORE_WORKERS_H */
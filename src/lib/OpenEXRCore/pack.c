@@ -6,8 +6,11 @@
 #include "openexr_encode.h"
 
 #include "internal_coding.h"
+#include "internal_coding_simd.h"
 #include "internal_xdr.h"
 
+#include <string.h>
+
 /**************************************/
 
 static exr_result_t
@@ -190,11 +193,844 @@ default_pack (exr_encode_pipeline_t* encode)
     return EXR_ERR_SUCCESS;
 }
 
+/**************************************/
+
+/* A deinterleave kernel reads w pixels of channel count values each
+ * from in, writing component c as a run of w little endian values to
+ * out[c]. Like the unpack side, the drivers arrange the out pointers
+ * for the forward and reversed channel orders. */
+typedef void (*deinterleave_row_fn) (
+    uint8_t* const* out, const uint8_t* in, int w);
+
+/* how many pixels per channel the converting kernels stage on the
+ * stack before converting */
+#define PACK_CONVERT_BLOCK 64
+
+static internal_exr_float_to_half_fn pack_float_to_half_buffer =
+    &float_to_half_buffer_scalar;
+
+static void
+deinterleave_16_3_scalar (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint16_t* i    = (const uint16_t*) in;
+    uint16_t*       out0 = (uint16_t*) out[0];
+    uint16_t*       out1 = (uint16_t*) out[1];
+    uint16_t*       out2 = (uint16_t*) out[2];
+
+    for (int x = 0; x < w; ++x)
+    {
+        out0[x] = one_from_native16 (i[0]);
+        out1[x] = one_from_native16 (i[1]);
+        out2[x] = one_from_native16 (i[2]);
+        i += 3;
+    }
+}
+
+static void
+deinterleave_16_4_scalar (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint16_t* i    = (const uint16_t*) in;
+    uint16_t*       out0 = (uint16_t*) out[0];
+    uint16_t*       out1 = (uint16_t*) out[1];
+    uint16_t*       out2 = (uint16_t*) out[2];
+    uint16_t*       out3 = (uint16_t*) out[3];
+
+    for (int x = 0; x < w; ++x)
+    {
+        out0[x] = one_from_native16 (i[0]);
+        out1[x] = one_from_native16 (i[1]);
+        out2[x] = one_from_native16 (i[2]);
+        out3[x] = one_from_native16 (i[3]);
+        i += 4;
+    }
+}
+
+static void
+deinterleave_32_3_scalar (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint32_t* i    = (const uint32_t*) in;
+    uint32_t*       out0 = (uint32_t*) out[0];
+    uint32_t*       out1 = (uint32_t*) out[1];
+    uint32_t*       out2 = (uint32_t*) out[2];
+
+    for (int x = 0; x < w; ++x)
+    {
+        out0[x] = one_from_native32 (i[0]);
+        out1[x] = one_from_native32 (i[1]);
+        out2[x] = one_from_native32 (i[2]);
+        i += 3;
+    }
+}
+
+static void
+deinterleave_32_4_scalar (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint32_t* i    = (const uint32_t*) in;
+    uint32_t*       out0 = (uint32_t*) out[0];
+    uint32_t*       out1 = (uint32_t*) out[1];
+    uint32_t*       out2 = (uint32_t*) out[2];
+    uint32_t*       out3 = (uint32_t*) out[3];
+
+    for (int x = 0; x < w; ++x)
+    {
+        out0[x] = one_from_native32 (i[0]);
+        out1[x] = one_from_native32 (i[1]);
+        out2[x] = one_from_native32 (i[2]);
+        out3[x] = one_from_native32 (i[3]);
+        i += 4;
+    }
+}
+
+#ifdef EXR_CODING_HAVE_SSE2
+
+/* transpose 8 pixels of 4 x 16 bit values, 2 pixels per input */
+static inline void
+transpose_16_4_sse2 (
+    __m128i  v0,
+    __m128i  v1,
+    __m128i  v2,
+    __m128i  v3,
+    __m128i* a,
+    __m128i* b,
+    __m128i* c,
+    __m128i* d)
+{
+    __m128i t0 = _mm_unpacklo_epi16 (v0, v1);
+    __m128i t1 = _mm_unpackhi_epi16 (v0, v1);
+    __m128i t2 = _mm_unpacklo_epi16 (v2, v3);
+    __m128i t3 = _mm_unpackhi_epi16 (v2, v3);
+    __m128i u0 = _mm_unpacklo_epi16 (t0, t1);
+    __m128i u1 = _mm_unpackhi_epi16 (t0, t1);
+    __m128i u2 = _mm_unpacklo_epi16 (t2, t3);
+    __m128i u3 = _mm_unpackhi_epi16 (t2, t3);
+
+    *a = _mm_unpacklo_epi64 (u0, u2);
+    *b = _mm_unpackhi_epi64 (u0, u2);
+    *c = _mm_unpacklo_epi64 (u1, u3);
+    *d = _mm_unpackhi_epi64 (u1, u3);
+}
+
+/* transpose 4 pixels of 4 x 32 bit values, 1 pixel per input */
+static inline void
+transpose_32_4_sse2 (
+    __m128i  v0,
+    __m128i  v1,
+    __m128i  v2,
+    __m128i  v3,
+    __m128i* a,
+    __m128i* b,
+    __m128i* c,
+    __m128i* d)
+{
+    __m128i t0 = _mm_unpacklo_epi32 (v0, v1);
+    __m128i t1 = _mm_unpacklo_epi32 (v2, v3);
+    __m128i t2 = _mm_unpackhi_epi32 (v0, v1);
+    __m128i t3 = _mm_unpackhi_epi32 (v2, v3);
+
+    *a = _mm_unpacklo_epi64 (t0, t1);
+    *b = _mm_unpackhi_epi64 (t0, t1);
+    *c = _mm_unpacklo_epi64 (t2, t3);
+    *d = _mm_unpackhi_epi64 (t2, t3);
+}
+
+/* The 3 channel kernels load each pixel along with the first value of
+ * the next one and transpose as 4 channels, dropping the 4th. That
+ * reads one value past the pixels handled, so they only run while
+ * there is at least one more pixel in the row. */
+
+static void
+deinterleave_16_3_sse2 (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint16_t* i    = (const uint16_t*) in;
+    uint16_t*       out0 = (uint16_t*) out[0];
+    uint16_t*       out1 = (uint16_t*) out[1];
+    uint16_t*       out2 = (uint16_t*) out[2];
+    int             x    = 0;
+
+    for (; x + 8 < w; x += 8)
+    {
+        __m128i a, b, c, d;
+        __m128i v0 = _mm_unpacklo_epi64 (
+            _mm_loadl_epi64 ((const __m128i*) (i + 0)),
+            _mm_loadl_epi64 ((const __m128i*) (i + 3)));
+        __m128i v1 = _mm_unpacklo_epi64 (
+            _mm_loadl_epi64 ((const __m128i*) (i + 6)),
+            _mm_loadl_epi64 ((const __m128i*) (i + 9)));
+        __m128i v2 = _mm_unpacklo_epi64 (
+            _mm_loadl_epi64 ((const __m128i*) (i + 12)),
+            _mm_loadl_epi64 ((const __m128i*) (i + 15)));
+        __m128i v3 = _mm_unpacklo_epi64 (
+            _mm_loadl_epi64 ((const __m128i*) (i + 18)),
+            _mm_loadl_epi64 ((const __m128i*) (i + 21)));
+
+        transpose_16_4_sse2 (v0, v1, v2, v3, &a, &b, &c, &d);
+        _mm_storeu_si128 ((__m128i*) (out0 + x), a);
+        _mm_storeu_si128 ((__m128i*) (out1 + x), b);
+        _mm_storeu_si128 ((__m128i*) (out2 + x), c);
+        i += 24;
+    }
+    if (x < w)
+    {
+        uint8_t* rest[3] = {
+            (uint8_t*) (out0 + x), (uint8_t*) (out1 + x), (uint8_t*) (out2 + x)};
+        deinterleave_16_3_scalar (rest, (const uint8_t*) i, w - x);
+    }
+}
+
+static void
+deinterleave_16_4_sse2 (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint16_t* i    = (const uint16_t*) in;
+    uint16_t*       out0 = (uint16_t*) out[0];
+    uint16_t*       out1 = (uint16_t*) out[1];
+    uint16_t*       out2 = (uint16_t*) out[2];
+    uint16_t*       out3 = (uint16_t*) out[3];
+    int             x    = 0;
+
+    for (; x + 8 <= w; x += 8)
+    {
+        __m128i a, b, c, d;
+
+        transpose_16_4_sse2 (
+            _mm_loadu_si128 ((const __m128i*) (i + 0)),
+            _mm_loadu_si128 ((const __m128i*) (i + 8)),
+            _mm_loadu_si128 ((const __m128i*) (i + 16)),
+            _mm_loadu_si128 ((const __m128i*) (i + 24)),
+            &a,
+            &b,
+            &c,
+            &d);
+        _mm_storeu_si128 ((__m128i*) (out0 + x), a);
+        _mm_storeu_si128 ((__m128i*) (out1 + x), b);
+        _mm_storeu_si128 ((__m128i*) (out2 + x), c);
+        _mm_storeu_si128 ((__m128i*) (out3 + x), d);
+        i += 32;
+    }
+    if (x < w)
+    {
+        uint8_t* rest[4] = {
+            (uint8_t*) (out0 + x),
+            (uint8_t*) (out1 + x),
+            (uint8_t*) (out2 + x),
+            (uint8_t*) (out3 + x)};
+        deinterleave_16_4_scalar (rest, (const uint8_t*) i, w - x);
+    }
+}
+
+static void
+deinterleave_32_3_sse2 (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint32_t* i    = (const uint32_t*) in;
+    uint32_t*       out0 = (uint32_t*) out[0];
+    uint32_t*       out1 = (uint32_t*) out[1];
+    uint32_t*       out2 = (uint32_t*) out[2];
+    int             x    = 0;
+
+    for (; x + 4 < w; x += 4)
+    {
+        __m128i a, b, c, d;
+
+        transpose_32_4_sse2 (
+            _mm_loadu_si128 ((const __m128i*) (i + 0)),
+            _mm_loadu_si128 ((const __m128i*) (i + 3)),
+            _mm_loadu_si128 ((const __m128i*) (i + 6)),
+            _mm_loadu_si128 ((const __m128i*) (i + 9)),
+            &a,
+            &b,
+            &c,
+            &d);
+        _mm_storeu_si128 ((__m128i*) (out0 + x), a);
+        _mm_storeu_si128 ((__m128i*) (out1 + x), b);
+        _mm_storeu_si128 ((__m128i*) (out2 + x), c);
+        i += 12;
+    }
+    if (x < w)
+    {
+        uint8_t* rest[3] = {
+            (uint8_t*) (out0 + x), (uint8_t*) (out1 + x), (uint8_t*) (out2 + x)};
+        deinterleave_32_3_scalar (rest, (const uint8_t*) i, w - x);
+    }
+}
+
+static void
+deinterleave_32_4_sse2 (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint32_t* i    = (const uint32_t*) in;
+    uint32_t*       out0 = (uint32_t*) out[0];
+    uint32_t*       out1 = (uint32_t*) out[1];
+    uint32_t*       out2 = (uint32_t*) out[2];
+    uint32_t*       out3 = (uint32_t*) out[3];
+    int             x    = 0;
+
+    for (; x + 4 <= w; x += 4)
+    {
+        __m128i a, b, c, d;
+
+        transpose_32_4_sse2 (
+            _mm_loadu_si128 ((const __m128i*) (i + 0)),
+            _mm_loadu_si128 ((const __m128i*) (i + 4)),
+            _mm_loadu_si128 ((const __m128i*) (i + 8)),
+            _mm_loadu_si128 ((const __m128i*) (i + 12)),
+            &a,
+            &b,
+            &c,
+            &d);
+        _mm_storeu_si128 ((__m128i*) (out0 + x), a);
+        _mm_storeu_si128 ((__m128i*) (out1 + x), b);
+        _mm_storeu_si128 ((__m128i*) (out2 + x), c);
+        _mm_storeu_si128 ((__m128i*) (out3 + x), d);
+        i += 16;
+    }
+    if (x < w)
+    {
+        uint8_t* rest[4] = {
+            (uint8_t*) (out0 + x),
+            (uint8_t*) (out1 + x),
+            (uint8_t*) (out2 + x),
+            (uint8_t*) (out3 + x)};
+        deinterleave_32_4_scalar (rest, (const uint8_t*) i, w - x);
+    }
+}
+
+#endif /* EXR_CODING_HAVE_SSE2 */
+
+#ifdef EXR_CODING_HAVE_AVX_TARGET
+
+EXR_CODING_TARGET ("avx2")
+static void
+deinterleave_16_4_avx2 (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint16_t* i    = (const uint16_t*) in;
+    uint16_t*       out0 = (uint16_t*) out[0];
+    uint16_t*       out1 = (uint16_t*) out[1];
+    uint16_t*       out2 = (uint16_t*) out[2];
+    uint16_t*       out3 = (uint16_t*) out[3];
+    int             x    = 0;
+    /* the in lane transpose leaves pairs of pixels from the low lane,
+     * then the high lane, so this puts them back in order */
+    const __m256i fix = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7);
+
+    for (; x + 16 <= w; x += 16)
+    {
+        __m256i v0 = _mm256_loadu_si256 ((const __m256i*) (i + 0));
+        __m256i v1 = _mm256_loadu_si256 ((const __m256i*) (i + 16));
+        __m256i v2 = _mm256_loadu_si256 ((const __m256i*) (i + 32));
+        __m256i v3 = _mm256_loadu_si256 ((const __m256i*) (i + 48));
+        __m256i t0 = _mm256_unpacklo_epi16 (v0, v1);
+        __m256i t1 = _mm256_unpackhi_epi16 (v0, v1);
+        __m256i t2 = _mm256_unpacklo_epi16 (v2, v3);
+        __m256i t3 = _mm256_unpackhi_epi16 (v2, v3);
+        __m256i u0 = _mm256_unpacklo_epi16 (t0, t1);
+        __m256i u1 = _mm256_unpackhi_epi16 (t0, t1);
+        __m256i u2 = _mm256_unpacklo_epi16 (t2, t3);
+        __m256i u3 = _mm256_unpackhi_epi16 (t2, t3);
+
+        _mm256_storeu_si256 (
+            (__m256i*) (out0 + x),
+            _mm256_permutevar8x32_epi32 (_mm256_unpacklo_epi64 (u0, u2), fix));
+        _mm256_storeu_si256 (
+            (__m256i*) (out1 + x),
+            _mm256_permutevar8x32_epi32 (_mm256_unpackhi_epi64 (u0, u2), fix));
+        _mm256_storeu_si256 (
+            (__m256i*) (out2 + x),
+            _mm256_permutevar8x32_epi32 (_mm256_unpacklo_epi64 (u1, u3), fix));
+        _mm256_storeu_si256 (
+            (__m256i*) (out3 + x),
+            _mm256_permutevar8x32_epi32 (_mm256_unpackhi_epi64 (u1, u3), fix));
+        i += 64;
+    }
+    if (x < w)
+    {
+        uint8_t* rest[4] = {
+            (uint8_t*) (out0 + x),
+            (uint8_t*) (out1 + x),
+            (uint8_t*) (out2 + x),
+            (uint8_t*) (out3 + x)};
+        deinterleave_16_4_sse2 (rest, (const uint8_t*) i, w - x);
+    }
+}
+
+EXR_CODING_TARGET ("avx")
+static void
+deinterleave_32_4_avx (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const float* i    = (const float*) in;
+    float*       out0 = (float*) out[0];
+    float*       out1 = (float*) out[1];
+    float*       out2 = (float*) out[2];
+    float*       out3 = (float*) out[3];
+    int          x    = 0;
+
+    /* pixels 0-3 go in the low lanes, 4-7 in the high lanes, then it
+     * is a 4x4 transpose per lane. The float shuffles only move bits,
+     * so this is fine for uint and for any NaN payload */
+    for (; x + 8 <= w; x += 8)
+    {
+        __m256 v0 = _mm256_insertf128_ps (
+            _mm256_castps128_ps256 (_mm_loadu_ps (i + 0)),
+            _mm_loadu_ps (i + 16),
+            1);
+        __m256 v1 = _mm256_insertf128_ps (
+            _mm256_castps128_ps256 (_mm_loadu_ps (i + 4)),
+            _mm_loadu_ps (i + 20),
+            1);
+        __m256 v2 = _mm256_insertf128_ps (
+            _mm256_castps128_ps256 (_mm_loadu_ps (i + 8)),
+            _mm_loadu_ps (i + 24),
+            1);
+        __m256 v3 = _mm256_insertf128_ps (
+            _mm256_castps128_ps256 (_mm_loadu_ps (i + 12)),
+            _mm_loadu_ps (i + 28),
+            1);
+        __m256 t0 = _mm256_unpacklo_ps (v0, v1);
+        __m256 t1 = _mm256_unpacklo_ps (v2, v3);
+        __m256 t2 = _mm256_unpackhi_ps (v0, v1);
+        __m256 t3 = _mm256_unpackhi_ps (v2, v3);
+
+        _mm256_storeu_ps (
+            out0 + x,
+            _mm256_castpd_ps (_mm256_unpacklo_pd (
+                _mm256_castps_pd (t0), _mm256_castps_pd (t1))));
+        _mm256_storeu_ps (
+            out1 + x,
+            _mm256_castpd_ps (_mm256_unpackhi_pd (
+                _mm256_castps_pd (t0), _mm256_castps_pd (t1))));
+        _mm256_storeu_ps (
+            out2 + x,
+            _mm256_castpd_ps (_mm256_unpacklo_pd (
+                _mm256_castps_pd (t2), _mm256_castps_pd (t3))));
+        _mm256_storeu_ps (
+            out3 + x,
+            _mm256_castpd_ps (_mm256_unpackhi_pd (
+                _mm256_castps_pd (t2), _mm256_castps_pd (t3))));
+        i += 32;
+    }
+    if (x < w)
+    {
+        uint8_t* rest[4] = {
+            (uint8_t*) (out0 + x),
+            (uint8_t*) (out1 + x),
+            (uint8_t*) (out2 + x),
+            (uint8_t*) (out3 + x)};
+        deinterleave_32_4_sse2 (rest, (const uint8_t*) i, w - x);
+    }
+}
+
+#endif /* EXR_CODING_HAVE_AVX_TARGET */
+
+#ifdef EXR_CODING_HAVE_NEON
+
+static void
+deinterleave_16_3_neon (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint16_t* i    = (const uint16_t*) in;
+    uint16_t*       out0 = (uint16_t*) out[0];
+    uint16_t*       out1 = (uint16_t*) out[1];
+    uint16_t*       out2 = (uint16_t*) out[2];
+    int             x    = 0;
+
+    for (; x + 8 <= w; x += 8)
+    {
+        uint16x8x3_t v = vld3q_u16 (i);
+        vst1q_u16 (out0 + x, v.val[0]);
+        vst1q_u16 (out1 + x, v.val[1]);
+        vst1q_u16 (out2 + x, v.val[2]);
+        i += 24;
+    }
+    for (; x < w; ++x)
+    {
+        out0[x] = i[0];
+        out1[x] = i[1];
+        out2[x] = i[2];
+        i += 3;
+    }
+}
+
+static void
+deinterleave_16_4_neon (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint16_t* i    = (const uint16_t*) in;
+    uint16_t*       out0 = (uint16_t*) out[0];
+    uint16_t*       out1 = (uint16_t*) out[1];
+    uint16_t*       out2 = (uint16_t*) out[2];
+    uint16_t*       out3 = (uint16_t*) out[3];
+    int             x    = 0;
+
+    for (; x + 8 <= w; x += 8)
+    {
+        uint16x8x4_t v = vld4q_u16 (i);
+        vst1q_u16 (out0 + x, v.val[0]);
+        vst1q_u16 (out1 + x, v.val[1]);
+        vst1q_u16 (out2 + x, v.val[2]);
+        vst1q_u16 (out3 + x, v.val[3]);
+        i += 32;
+    }
+    for (; x < w; ++x)
+    {
+        out0[x] = i[0];
+        out1[x] = i[1];
+        out2[x] = i[2];
+        out3[x] = i[3];
+        i += 4;
+    }
+}
+
+static void
+deinterleave_32_3_neon (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint32_t* i    = (const uint32_t*) in;
+    uint32_t*       out0 = (uint32_t*) out[0];
+    uint32_t*       out1 = (uint32_t*) out[1];
+    uint32_t*       out2 = (uint32_t*) out[2];
+    int             x    = 0;
+
+    for (; x + 4 <= w; x += 4)
+    {
+        uint32x4x3_t v = vld3q_u32 (i);
+        vst1q_u32 (out0 + x, v.val[0]);
+        vst1q_u32 (out1 + x, v.val[1]);
+        vst1q_u32 (out2 + x, v.val[2]);
+        i += 12;
+    }
+    for (; x < w; ++x)
+    {
+        out0[x] = i[0];
+        out1[x] = i[1];
+        out2[x] = i[2];
+        i += 3;
+    }
+}
+
+static void
+deinterleave_32_4_neon (uint8_t* const* out, const uint8_t* in, int w)
+{
+    const uint32_t* i    = (const uint32_t*) in;
+    uint32_t*       out0 = (uint32_t*) out[0];
+    uint32_t*       out1 = (uint32_t*) out[1];
+    uint32_t*       out2 = (uint32_t*) out[2];
+    uint32_t*       out3 = (uint32_t*) out[3];
+    int             x    = 0;
+
+    for (; x + 4 <= w; x += 4)
+    {
+        uint32x4x4_t v = vld4q_u32 (i);
+        vst1q_u32 (out0 + x, v.val[0]);
+        vst1q_u32 (out1 + x, v.val[1]);
+        vst1q_u32 (out2 + x, v.val[2]);
+        vst1q_u32 (out3 + x, v.val[3]);
+        i += 16;
+    }
+    for (; x < w; ++x)
+    {
+        out0[x] = i[0];
+        out1[x] = i[1];
+        out2[x] = i[2];
+        out3[x] = i[3];
+        i += 4;
+    }
+}
+
+#endif /* EXR_CODING_HAVE_NEON */
+
+static deinterleave_row_fn deinterleave_16_3 = &deinterleave_16_3_scalar;
+static deinterleave_row_fn deinterleave_16_4 = &deinterleave_16_4_scalar;
+static deinterleave_row_fn deinterleave_32_3 = &deinterleave_32_3_scalar;
+static deinterleave_row_fn deinterleave_32_4 = &deinterleave_32_4_scalar;
+
+static void
+choose_pack_simd_impl (void)
+{
+    pack_float_to_half_buffer = internal_exr_choose_float_to_half ();
+
+#if defined(EXR_CODING_HAVE_SSE2)
+    deinterleave_16_3 = &deinterleave_16_3_sse2;
+    deinterleave_16_4 = &deinterleave_16_4_sse2;
+    deinterleave_32_3 = &deinterleave_32_3_sse2;
+    deinterleave_32_4 = &deinterleave_32_4_sse2;
+#    ifdef EXR_CODING_HAVE_AVX_TARGET
+    {
+        int f = internal_exr_cpu_features ();
+        if (f & EXR_CPU_AVX2) deinterleave_16_4 = &deinterleave_16_4_avx2;
+        if (f & EXR_CPU_AVX_F16C) deinterleave_32_4 = &deinterleave_32_4_avx;
+    }
+#    endif
+#elif defined(EXR_CODING_HAVE_NEON)
+    deinterleave_16_3 = &deinterleave_16_3_neon;
+    deinterleave_16_4 = &deinterleave_16_4_neon;
+    deinterleave_32_3 = &deinterleave_32_3_neon;
+    deinterleave_32_4 = &deinterleave_32_4_neon;
+#endif
+}
+
+/**************************************/
+
+/* float -> half conversion of user floats: split a block of pixels
+ * into per channel floats on the stack, then convert each run. The
+ * converters produce native halves, so this is little endian only */
+
+static void
+deinterleave_float_to_half (
+    uint8_t* const* out, const uint8_t* in, int nc, int w)
+{
+    float    tmp[4][PACK_CONVERT_BLOCK];
+    uint8_t* tout[4] = {
+        (uint8_t*) tmp[0],
+        (uint8_t*) tmp[1],
+        (uint8_t*) tmp[2],
+        (uint8_t*) tmp[3]};
+    deinterleave_row_fn rowfn =
+        (nc == 4) ? deinterleave_32_4 : deinterleave_32_3;
+
+    for (int x = 0; x < w; x += PACK_CONVERT_BLOCK)
+    {
+        int n = w - x;
+        if (n > PACK_CONVERT_BLOCK) n = PACK_CONVERT_BLOCK;
+
+        rowfn (tout, in, n);
+        for (int c = 0; c < nc; ++c)
+            pack_float_to_half_buffer (((uint16_t*) out[c]) + x, tmp[c], n);
+        in += (size_t) n * (size_t) nc * sizeof (float);
+    }
+}
+
+static void
+deinterleave_float_to_half_3 (uint8_t* const* out, const uint8_t* in, int w)
+{
+    deinterleave_float_to_half (out, in, 3, w);
+}
+
+static void
+deinterleave_float_to_half_4 (uint8_t* const* out, const uint8_t* in, int w)
+{
+    deinterleave_float_to_half (out, in, 4, w);
+}
+
+/**************************************/
+
+enum _INTERNAL_EXR_PACK_LAYOUT
+{
+    PACK_LAYOUT_OTHER = 0,
+    PACK_LAYOUT_INTERLEAVE,
+    PACK_LAYOUT_INTERLEAVE_REV,
+    PACK_LAYOUT_PLANAR
+};
+
+/* Encode pipelines usually choose their routines once, then update the
+ * channel pointers for each chunk, so the specialized routines check
+ * the layout is still one they handle each time they run. */
+static int
+pack_layout (
+    const exr_encode_pipeline_t* encode,
+    exr_pixel_type_t             filetype,
+    exr_pixel_type_t             usertype)
+{
+    const exr_coding_channel_info_t* c0 = encode->channels;
+    int                              nc = encode->channel_count;
+    int                              ubpe, fwd = 1, rev = 1, planar = 1;
+
+    if (nc < 1) return PACK_LAYOUT_OTHER;
+
+    ubpe = (usertype == EXR_PIXEL_HALF) ? 2 : 4;
+    for (int c = 0; c < nc; ++c)
+    {
+        const exr_coding_channel_info_t* encc = encode->channels + c;
+        ptrdiff_t                        off;
+
+        if (encc->data_type != (uint16_t) filetype ||
+            encc->user_data_type != (uint16_t) usertype ||
+            encc->user_bytes_per_element != ubpe || encc->x_samples != 1 ||
+            encc->y_samples != 1 || encc->height != encode->chunk.height ||
+            encc->width != c0->width || !encc->encode_from_ptr)
+            return PACK_LAYOUT_OTHER;
+
+        if (encc->user_pixel_stride != ubpe) planar = 0;
+        if (encc->user_pixel_stride != nc * ubpe ||
+            encc->user_line_stride != c0->user_line_stride)
+        {
+            fwd = 0;
+            rev = 0;
+        }
+        off = encc->encode_from_ptr - c0->encode_from_ptr;
+        if (off != (ptrdiff_t) c * ubpe) fwd = 0;
+        if (off != -((ptrdiff_t) c * ubpe)) rev = 0;
+    }
+
+    if (nc == 3 || nc == 4)
+    {
+        if (fwd) return PACK_LAYOUT_INTERLEAVE;
+        if (rev) return PACK_LAYOUT_INTERLEAVE_REV;
+    }
+    if (planar) return PACK_LAYOUT_PLANAR;
+    return PACK_LAYOUT_OTHER;
+}
+
+static exr_result_t
+pack_interleaved (
+    exr_encode_pipeline_t* encode, int rev, deinterleave_row_fn rowfn)
+{
+    uint8_t*       dstbuffer = encode->packed_buffer;
+    uint8_t*       out[4];
+    const uint8_t* in0;
+    int            nc = encode->channel_count;
+    int            w, h;
+    size_t         planebytes;
+    int64_t        linc0;
+
+    w          = encode->channels[0].width;
+    h          = encode->chunk.height;
+    linc0      = encode->channels[0].user_line_stride;
+    planebytes = (size_t) w * (size_t) encode->channels[0].bytes_per_element;
+
+    /* for the reversed case (i.e. BGR in memory for RGB in the file),
+     * the last channel has the lowest address */
+    in0 = encode->channels[rev ? (nc - 1) : 0].encode_from_ptr;
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int c = 0; c < nc; ++c)
+            out[c] = dstbuffer + (size_t) (rev ? (nc - 1 - c) : c) * planebytes;
+
+        rowfn (out, in0, w);
+
+        dstbuffer += (size_t) nc * planebytes;
+        in0 += linc0;
+    }
+
+    encode->packed_bytes = (uint64_t) h * (uint64_t) nc * planebytes;
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+pack_planar (exr_encode_pipeline_t* encode, int tohalf)
+{
+    uint8_t* dstbuffer = encode->packed_buffer;
+    int      h         = encode->chunk.height;
+    int      nc        = encode->channel_count;
+    uint64_t packed_bytes = 0;
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int c = 0; c < nc; ++c)
+        {
+            const exr_coding_channel_info_t* encc = encode->channels + c;
+            const uint8_t*                   cdata;
+            int                              w = encc->width;
+            size_t chan_bytes = (size_t) w * (size_t) encc->bytes_per_element;
+
+            cdata = encc->encode_from_ptr +
+                    (int64_t) y * (int64_t) encc->user_line_stride;
+            if (tohalf)
+            {
+                pack_float_to_half_buffer (
+                    (uint16_t*) dstbuffer, (const float*) cdata, w);
+            }
+            else
+            {
+                /* specialize to memcpy if we can */
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+                if (encc->bytes_per_element == 2)
+                {
+                    for (int x = 0; x < w; ++x)
+                        unaligned_store16 (
+                            dstbuffer + x * 2, ((const uint16_t*) cdata)[x]);
+                }
+                else
+                {
+                    for (int x = 0; x < w; ++x)
+                        unaligned_store32 (
+                            dstbuffer + x * 4, ((const uint32_t*) cdata)[x]);
+                }
+#else
+                memcpy (dstbuffer, cdata, chan_bytes);
+#endif
+            }
+            dstbuffer += chan_bytes;
+            packed_bytes += chan_bytes;
+        }
+    }
+
+    encode->packed_bytes = packed_bytes;
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+pack_same_type (exr_encode_pipeline_t* encode)
+{
+    exr_pixel_type_t t  = (exr_pixel_type_t) encode->channels[0].data_type;
+    int              nc = encode->channel_count;
+    int              is16 = (t == EXR_PIXEL_HALF);
+
+    switch (pack_layout (encode, t, t))
+    {
+        case PACK_LAYOUT_INTERLEAVE:
+            if (is16)
+                return pack_interleaved (
+                    encode, 0, nc == 4 ? deinterleave_16_4 : deinterleave_16_3);
+            return pack_interleaved (
+                encode, 0, nc == 4 ? deinterleave_32_4 : deinterleave_32_3);
+        case PACK_LAYOUT_INTERLEAVE_REV:
+            if (is16)
+                return pack_interleaved (
+                    encode, 1, nc == 4 ? deinterleave_16_4 : deinterleave_16_3);
+            return pack_interleaved (
+                encode, 1, nc == 4 ? deinterleave_32_4 : deinterleave_32_3);
+        case PACK_LAYOUT_PLANAR: return pack_planar (encode, 0);
+        default: break;
+    }
+    return default_pack (encode);
+}
+
+static exr_result_t
+pack_float_to_half (exr_encode_pipeline_t* encode)
+{
+    int nc = encode->channel_count;
+
+    switch (pack_layout (encode, EXR_PIXEL_HALF, EXR_PIXEL_FLOAT))
+    {
+        case PACK_LAYOUT_INTERLEAVE:
+            return pack_interleaved (
+                encode,
+                0,
+                nc == 4 ? &deinterleave_float_to_half_4
+                        : &deinterleave_float_to_half_3);
+        case PACK_LAYOUT_INTERLEAVE_REV:
+            return pack_interleaved (
+                encode,
+                1,
+                nc == 4 ? &deinterleave_float_to_half_4
+                        : &deinterleave_float_to_half_3);
+        case PACK_LAYOUT_PLANAR: return pack_planar (encode, 1);
+        default: break;
+    }
+    return default_pack (encode);
+}
+
+/**************************************/
+
 internal_exr_pack_fn
 internal_exr_match_encode (exr_encode_pipeline_t* encode, int isdeep)
 {
-    (void) encode;
+    static int init_cpu_check = 1;
+    int        t;
+
+    if (init_cpu_check)
+    {
+        choose_pack_simd_impl ();
+        init_cpu_check = 0;
+    }
+
     if (isdeep) return &default_pack_deep;
+    if (encode->channel_count < 1) return &default_pack;
+
+    t = encode->channels[0].data_type;
+    if (pack_layout (encode, t, t) != PACK_LAYOUT_OTHER)
+        return &pack_same_type;
+
+#if !EXR_HOST_IS_NOT_LITTLE_ENDIAN
+    if (pack_layout (encode, EXR_PIXEL_HALF, EXR_PIXEL_FLOAT) !=
+        PACK_LAYOUT_OTHER)
+        return &pack_float_to_half;
+#endif
 
     return &default_pack;
 }
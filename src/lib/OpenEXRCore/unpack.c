@@ -4,6 +4,7 @@
 */
 
 #include "internal_coding.h"
+#include "internal_coding_simd.h"
 #include "internal_xdr.h"
 
 #include "openexr_attr.h"
@@ -11,378 +12,795 @@
 #include <stdbool.h>
 #include <string.h>
 
-#if defined(__x86_64__) || defined(_M_X64)
-#    ifndef _WIN32
-#        include <cpuid.h>
-#    endif
-#endif
-
 /**************************************/
 
-#ifndef __F16C__
-static inline void
-half_to_float4 (float* out, const uint16_t* src)
+/* An interleave kernel writes w pixels of channel count values each,
+ * taking output component c from the file ordered run of w values in
+ * in[c]. The drivers below arrange the in pointers for the forward and
+ * reversed (BGR / ABGR in memory) layouts, so each kernel only needs
+ * the one ordering. */
+typedef void (*interleave_row_fn) (
+    uint8_t* out, const uint8_t* const* in, int w);
+
+/* how many pixels per channel the converting kernels stage on the
+ * stack before interleaving */
+#define UNPACK_CONVERT_BLOCK 64
+
+static internal_exr_half_to_float_fn half_to_float_buffer =
+    &half_to_float_buffer_scalar;
+static internal_exr_float_to_half_fn float_to_half_buffer =
+    &float_to_half_buffer_scalar;
+
+static void
+interleave_16_3_scalar (uint8_t* out, const uint8_t* const* in, int w)
+{
+    uint16_t*       o   = (uint16_t*) out;
+    const uint16_t* in0 = (const uint16_t*) in[0];
+    const uint16_t* in1 = (const uint16_t*) in[1];
+    const uint16_t* in2 = (const uint16_t*) in[2];
+
+    for (int x = 0; x < w; ++x)
+    {
+        o[0] = one_to_native16 (in0[x]);
+        o[1] = one_to_native16 (in1[x]);
+        o[2] = one_to_native16 (in2[x]);
+        o += 3;
+    }
+}
+
+static void
+interleave_16_4_scalar (uint8_t* out, const uint8_t* const* in, int w)
 {
-    out[0] = half_to_float (src[0]);
-    out[1] = half_to_float (src[1]);
-    out[2] = half_to_float (src[2]);
-    out[3] = half_to_float (src[3]);
+    uint16_t*       o   = (uint16_t*) out;
+    const uint16_t* in0 = (const uint16_t*) in[0];
+    const uint16_t* in1 = (const uint16_t*) in[1];
+    const uint16_t* in2 = (const uint16_t*) in[2];
+    const uint16_t* in3 = (const uint16_t*) in[3];
+
+    for (int x = 0; x < w; ++x)
+    {
+        o[0] = one_to_native16 (in0[x]);
+        o[1] = one_to_native16 (in1[x]);
+        o[2] = one_to_native16 (in2[x]);
+        o[3] = one_to_native16 (in3[x]);
+        o += 4;
+    }
 }
 
-static inline void
-half_to_float8 (float* out, const uint16_t* src)
+static void
+interleave_32_3_scalar (uint8_t* out, const uint8_t* const* in, int w)
 {
-    half_to_float4 (out, src);
-    half_to_float4 (out + 4, src + 4);
+    uint32_t*       o   = (uint32_t*) out;
+    const uint32_t* in0 = (const uint32_t*) in[0];
+    const uint32_t* in1 = (const uint32_t*) in[1];
+    const uint32_t* in2 = (const uint32_t*) in[2];
+
+    for (int x = 0; x < w; ++x)
+    {
+        o[0] = le32toh (in0[x]);
+        o[1] = le32toh (in1[x]);
+        o[2] = le32toh (in2[x]);
+        o += 3;
+    }
 }
-#endif
 
-#if (defined(__x86_64__) || defined(_M_X64)) &&                                \
-    (defined(__F16C__) || defined(__GNUC__) || defined(__clang__))
+static void
+interleave_32_4_scalar (uint8_t* out, const uint8_t* const* in, int w)
+{
+    uint32_t*       o   = (uint32_t*) out;
+    const uint32_t* in0 = (const uint32_t*) in[0];
+    const uint32_t* in1 = (const uint32_t*) in[1];
+    const uint32_t* in2 = (const uint32_t*) in[2];
+    const uint32_t* in3 = (const uint32_t*) in[3];
 
-#    if defined(__F16C__)
-static inline void
-half_to_float_buffer (float* out, const uint16_t* in, int w)
-#    elif defined(__GNUC__) || defined(__clang__)
-__attribute__ ((target ("f16c"))) static void
-half_to_float_buffer_f16c (float* out, const uint16_t* in, int w)
-#    endif
+    for (int x = 0; x < w; ++x)
+    {
+        o[0] = le32toh (in0[x]);
+        o[1] = le32toh (in1[x]);
+        o[2] = le32toh (in2[x]);
+        o[3] = le32toh (in3[x]);
+        o += 4;
+    }
+}
+
+#ifdef EXR_CODING_HAVE_SSE2
+
+/* The 3 channel kernels transpose as if there were a 4th channel, then
+ * store each pixel so it overlaps the next one, which overwrites the
+ * junk 4th value. That writes one value past the pixels handled, so
+ * they only run while there is at least one more pixel in the row. */
+
+static void
+interleave_16_3_sse2 (uint8_t* out, const uint8_t* const* in, int w)
 {
-    while (w >= 8)
+    uint16_t*       o   = (uint16_t*) out;
+    const uint16_t* in0 = (const uint16_t*) in[0];
+    const uint16_t* in1 = (const uint16_t*) in[1];
+    const uint16_t* in2 = (const uint16_t*) in[2];
+    int             x   = 0;
+
+    for (; x + 8 < w; x += 8)
+    {
+        __m128i a  = _mm_loadu_si128 ((const __m128i*) (in0 + x));
+        __m128i b  = _mm_loadu_si128 ((const __m128i*) (in1 + x));
+        __m128i c  = _mm_loadu_si128 ((const __m128i*) (in2 + x));
+        __m128i ab = _mm_unpacklo_epi16 (a, b);
+        __m128i cc = _mm_unpacklo_epi16 (c, c);
+        __m128i p0 = _mm_unpacklo_epi32 (ab, cc);
+        __m128i p1 = _mm_unpackhi_epi32 (ab, cc);
+
+        _mm_storel_epi64 ((__m128i*) (o + 0), p0);
+        _mm_storel_epi64 ((__m128i*) (o + 3), _mm_srli_si128 (p0, 8));
+        _mm_storel_epi64 ((__m128i*) (o + 6), p1);
+        _mm_storel_epi64 ((__m128i*) (o + 9), _mm_srli_si128 (p1, 8));
+
+        ab = _mm_unpackhi_epi16 (a, b);
+        cc = _mm_unpackhi_epi16 (c, c);
+        p0 = _mm_unpacklo_epi32 (ab, cc);
+        p1 = _mm_unpackhi_epi32 (ab, cc);
+
+        _mm_storel_epi64 ((__m128i*) (o + 12), p0);
+        _mm_storel_epi64 ((__m128i*) (o + 15), _mm_srli_si128 (p0, 8));
+        _mm_storel_epi64 ((__m128i*) (o + 18), p1);
+        _mm_storel_epi64 ((__m128i*) (o + 21), _mm_srli_si128 (p1, 8));
+        o += 24;
+    }
+    if (x < w)
     {
-        _mm256_storeu_ps (
-            out, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*) in)));
-        out += 8;
-        in += 8;
-        w -= 8;
+        const uint8_t* rest[3] = {
+            (const uint8_t*) (in0 + x),
+            (const uint8_t*) (in1 + x),
+            (const uint8_t*) (in2 + x)};
+        interleave_16_3_scalar ((uint8_t*) o, rest, w - x);
     }
-    // gcc < 9 does not have loadu_si64
-#    if defined(__clang__) || (__GNUC__ >= 9)
-    switch (w)
+}
+
+static void
+interleave_16_4_sse2 (uint8_t* out, const uint8_t* const* in, int w)
+{
+    uint16_t*       o   = (uint16_t*) out;
+    const uint16_t* in0 = (const uint16_t*) in[0];
+    const uint16_t* in1 = (const uint16_t*) in[1];
+    const uint16_t* in2 = (const uint16_t*) in[2];
+    const uint16_t* in3 = (const uint16_t*) in[3];
+    int             x   = 0;
+
+    for (; x + 8 <= w; x += 8)
     {
-        case 7:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in))); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
+        __m128i a    = _mm_loadu_si128 ((const __m128i*) (in0 + x));
+        __m128i b    = _mm_loadu_si128 ((const __m128i*) (in1 + x));
+        __m128i c    = _mm_loadu_si128 ((const __m128i*) (in2 + x));
+        __m128i d    = _mm_loadu_si128 ((const __m128i*) (in3 + x));
+        __m128i ablo = _mm_unpacklo_epi16 (a, b);
+        __m128i abhi = _mm_unpackhi_epi16 (a, b);
+        __m128i cdlo = _mm_unpacklo_epi16 (c, d);
+        __m128i cdhi = _mm_unpackhi_epi16 (c, d);
+
+        _mm_storeu_si128 ((__m128i*) (o + 0), _mm_unpacklo_epi32 (ablo, cdlo));
+        _mm_storeu_si128 ((__m128i*) (o + 8), _mm_unpackhi_epi32 (ablo, cdlo));
+        _mm_storeu_si128 (
+            (__m128i*) (o + 16), _mm_unpacklo_epi32 (abhi, cdhi));
+        _mm_storeu_si128 (
+            (__m128i*) (o + 24), _mm_unpackhi_epi32 (abhi, cdhi));
+        o += 32;
     }
-#    else
-    while (w > 0)
+    if (x < w)
     {
-        *out++ = half_to_float (*in++);
-        --w;
+        const uint8_t* rest[4] = {
+            (const uint8_t*) (in0 + x),
+            (const uint8_t*) (in1 + x),
+            (const uint8_t*) (in2 + x),
+            (const uint8_t*) (in3 + x)};
+        interleave_16_4_scalar ((uint8_t*) o, rest, w - x);
+    }
+}
+
+static void
+interleave_32_3_sse2 (uint8_t* out, const uint8_t* const* in, int w)
+{
+    uint32_t*       o   = (uint32_t*) out;
+    const uint32_t* in0 = (const uint32_t*) in[0];
+    const uint32_t* in1 = (const uint32_t*) in[1];
+    const uint32_t* in2 = (const uint32_t*) in[2];
+    int             x   = 0;
+
+    for (; x + 4 < w; x += 4)
+    {
+        __m128i a    = _mm_loadu_si128 ((const __m128i*) (in0 + x));
+        __m128i b    = _mm_loadu_si128 ((const __m128i*) (in1 + x));
+        __m128i c    = _mm_loadu_si128 ((const __m128i*) (in2 + x));
+        __m128i ablo = _mm_unpacklo_epi32 (a, b);
+        __m128i abhi = _mm_unpackhi_epi32 (a, b);
+        __m128i cclo = _mm_unpacklo_epi32 (c, c);
+        __m128i cchi = _mm_unpackhi_epi32 (c, c);
+
+        _mm_storeu_si128 ((__m128i*) (o + 0), _mm_unpacklo_epi64 (ablo, cclo));
+        _mm_storeu_si128 ((__m128i*) (o + 3), _mm_unpackhi_epi64 (ablo, cclo));
+        _mm_storeu_si128 ((__m128i*) (o + 6), _mm_unpacklo_epi64 (abhi, cchi));
+        _mm_storeu_si128 ((__m128i*) (o + 9), _mm_unpackhi_epi64 (abhi, cchi));
+        o += 12;
+    }
+    if (x < w)
+    {
+        const uint8_t* rest[3] = {
+            (const uint8_t*) (in0 + x),
+            (const uint8_t*) (in1 + x),
+            (const uint8_t*) (in2 + x)};
+        interleave_32_3_scalar ((uint8_t*) o, rest, w - x);
     }
-#    endif
 }
 
-#    ifndef __F16C__
 static void
-half_to_float_buffer_impl (float* out, const uint16_t* in, int w)
+interleave_32_4_sse2 (uint8_t* out, const uint8_t* const* in, int w)
 {
-    while (w >= 8)
+    uint32_t*       o   = (uint32_t*) out;
+    const uint32_t* in0 = (const uint32_t*) in[0];
+    const uint32_t* in1 = (const uint32_t*) in[1];
+    const uint32_t* in2 = (const uint32_t*) in[2];
+    const uint32_t* in3 = (const uint32_t*) in[3];
+    int             x   = 0;
+
+    for (; x + 4 <= w; x += 4)
     {
-        half_to_float8 (out, in);
-        out += 8;
-        in += 8;
-        w -= 8;
+        __m128i a    = _mm_loadu_si128 ((const __m128i*) (in0 + x));
+        __m128i b    = _mm_loadu_si128 ((const __m128i*) (in1 + x));
+        __m128i c    = _mm_loadu_si128 ((const __m128i*) (in2 + x));
+        __m128i d    = _mm_loadu_si128 ((const __m128i*) (in3 + x));
+        __m128i ablo = _mm_unpacklo_epi32 (a, b);
+        __m128i abhi = _mm_unpackhi_epi32 (a, b);
+        __m128i cdlo = _mm_unpacklo_epi32 (c, d);
+        __m128i cdhi = _mm_unpackhi_epi32 (c, d);
+
+        _mm_storeu_si128 ((__m128i*) (o + 0), _mm_unpacklo_epi64 (ablo, cdlo));
+        _mm_storeu_si128 ((__m128i*) (o + 4), _mm_unpackhi_epi64 (ablo, cdlo));
+        _mm_storeu_si128 ((__m128i*) (o + 8), _mm_unpacklo_epi64 (abhi, cdhi));
+        _mm_storeu_si128 (
+            (__m128i*) (o + 12), _mm_unpackhi_epi64 (abhi, cdhi));
+        o += 16;
     }
-    switch (w)
+    if (x < w)
     {
-        case 7:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: half_to_float4 (out, in); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
+        const uint8_t* rest[4] = {
+            (const uint8_t*) (in0 + x),
+            (const uint8_t*) (in1 + x),
+            (const uint8_t*) (in2 + x),
+            (const uint8_t*) (in3 + x)};
+        interleave_32_4_scalar ((uint8_t*) o, rest, w - x);
     }
 }
 
-static void (*half_to_float_buffer) (float*, const uint16_t*, int) =
-    &half_to_float_buffer_impl;
+#endif /* EXR_CODING_HAVE_SSE2 */
+
+#ifdef EXR_CODING_HAVE_AVX_TARGET
 
+EXR_CODING_TARGET ("avx2")
 static void
-choose_half_to_float_impl ()
+interleave_16_4_avx2 (uint8_t* out, const uint8_t* const* in, int w)
 {
-    // regs[2] in the extended block is ECX, where f16c indicator lives
-#        ifdef _WIN32
-    int regs[4];
-
-    __cpuid (regs, 0);
-    if (regs[0] >= 1) { __cpuidex (regs, 1, 0); }
-    else
-        regs[2] = 0;
-#        else
-    unsigned int regs[4];
-    __get_cpuid (0, &regs[0], &regs[1], &regs[2], &regs[3]);
-    if (regs[0] >= 1)
+    uint16_t*       o   = (uint16_t*) out;
+    const uint16_t* in0 = (const uint16_t*) in[0];
+    const uint16_t* in1 = (const uint16_t*) in[1];
+    const uint16_t* in2 = (const uint16_t*) in[2];
+    const uint16_t* in3 = (const uint16_t*) in[3];
+    int             x   = 0;
+
+    for (; x + 16 <= w; x += 16)
+    {
+        __m256i a    = _mm256_loadu_si256 ((const __m256i*) (in0 + x));
+        __m256i b    = _mm256_loadu_si256 ((const __m256i*) (in1 + x));
+        __m256i c    = _mm256_loadu_si256 ((const __m256i*) (in2 + x));
+        __m256i d    = _mm256_loadu_si256 ((const __m256i*) (in3 + x));
+        __m256i ablo = _mm256_unpacklo_epi16 (a, b);
+        __m256i abhi = _mm256_unpackhi_epi16 (a, b);
+        __m256i cdlo = _mm256_unpacklo_epi16 (c, d);
+        __m256i cdhi = _mm256_unpackhi_epi16 (c, d);
+        /* the unpacks work within each 128 bit lane, so these hold
+         * pixels { 0-1, 8-9 }, { 2-3, 10-11 }, { 4-5, 12-13 } and
+         * { 6-7, 14-15 } */
+        __m256i p0 = _mm256_unpacklo_epi32 (ablo, cdlo);
+        __m256i p1 = _mm256_unpackhi_epi32 (ablo, cdlo);
+        __m256i p2 = _mm256_unpacklo_epi32 (abhi, cdhi);
+        __m256i p3 = _mm256_unpackhi_epi32 (abhi, cdhi);
+
+        _mm256_storeu_si256 (
+            (__m256i*) (o + 0), _mm256_permute2x128_si256 (p0, p1, 0x20));
+        _mm256_storeu_si256 (
+            (__m256i*) (o + 16), _mm256_permute2x128_si256 (p2, p3, 0x20));
+        _mm256_storeu_si256 (
+            (__m256i*) (o + 32), _mm256_permute2x128_si256 (p0, p1, 0x31));
+        _mm256_storeu_si256 (
+            (__m256i*) (o + 48), _mm256_permute2x128_si256 (p2, p3, 0x31));
+        o += 64;
+    }
+    if (x < w)
     {
-        __get_cpuid (1, &regs[0], &regs[1], &regs[2], &regs[3]);
+        const uint8_t* rest[4] = {
+            (const uint8_t*) (in0 + x),
+            (const uint8_t*) (in1 + x),
+            (const uint8_t*) (in2 + x),
+            (const uint8_t*) (in3 + x)};
+        interleave_16_4_sse2 ((uint8_t*) o, rest, w - x);
     }
-    else
-        regs[2] = 0;
-#        endif
-    /* F16C is indicated by bit 29 */
-    if (regs[2] & (1 << 29)) half_to_float_buffer = &half_to_float_buffer_f16c;
 }
-#    else
-/* when we explicitly compile against f16, force it in */
+
+EXR_CODING_TARGET ("avx")
 static void
-choose_half_to_float_impl ()
-{}
+interleave_32_4_avx (uint8_t* out, const uint8_t* const* in, int w)
+{
+    float*       o   = (float*) out;
+    const float* in0 = (const float*) in[0];
+    const float* in1 = (const float*) in[1];
+    const float* in2 = (const float*) in[2];
+    const float* in3 = (const float*) in[3];
+    int          x   = 0;
+
+    /* the float shuffles only move bits, so this is fine for uint and
+     * for any NaN payload */
+    for (; x + 8 <= w; x += 8)
+    {
+        __m256 a    = _mm256_loadu_ps (in0 + x);
+        __m256 b    = _mm256_loadu_ps (in1 + x);
+        __m256 c    = _mm256_loadu_ps (in2 + x);
+        __m256 d    = _mm256_loadu_ps (in3 + x);
+        __m256 ablo = _mm256_unpacklo_ps (a, b);
+        __m256 abhi = _mm256_unpackhi_ps (a, b);
+        __m256 cdlo = _mm256_unpacklo_ps (c, d);
+        __m256 cdhi = _mm256_unpackhi_ps (c, d);
+        /* pixels { 0, 4 }, { 1, 5 }, { 2, 6 } and { 3, 7 } */
+        __m256 p0 = _mm256_castpd_ps (_mm256_unpacklo_pd (
+            _mm256_castps_pd (ablo), _mm256_castps_pd (cdlo)));
+        __m256 p1 = _mm256_castpd_ps (_mm256_unpackhi_pd (
+            _mm256_castps_pd (ablo), _mm256_castps_pd (cdlo)));
+        __m256 p2 = _mm256_castpd_ps (_mm256_unpacklo_pd (
+            _mm256_castps_pd (abhi), _mm256_castps_pd (cdhi)));
+        __m256 p3 = _mm256_castpd_ps (_mm256_unpackhi_pd (
+            _mm256_castps_pd (abhi), _mm256_castps_pd (cdhi)));
+
+        _mm256_storeu_ps (o + 0, _mm256_permute2f128_ps (p0, p1, 0x20));
+        _mm256_storeu_ps (o + 8, _mm256_permute2f128_ps (p2, p3, 0x20));
+        _mm256_storeu_ps (o + 16, _mm256_permute2f128_ps (p0, p1, 0x31));
+        _mm256_storeu_ps (o + 24, _mm256_permute2f128_ps (p2, p3, 0x31));
+        o += 32;
+    }
+    if (x < w)
+    {
+        const uint8_t* rest[4] = {
+            (const uint8_t*) (in0 + x),
+            (const uint8_t*) (in1 + x),
+            (const uint8_t*) (in2 + x),
+            (const uint8_t*) (in3 + x)};
+        interleave_32_4_sse2 ((uint8_t*) o, rest, w - x);
+    }
+}
 
-#    endif /* F16C */
+#endif /* EXR_CODING_HAVE_AVX_TARGET */
 
-#else
+#ifdef EXR_CODING_HAVE_NEON
 
-static inline void
-half_to_float_buffer (float* out, const uint16_t* in, int w)
+static void
+interleave_16_3_neon (uint8_t* out, const uint8_t* const* in, int w)
 {
-#    if EXR_HOST_IS_NOT_LITTLE_ENDIAN
-    for (int x = 0; x < w; ++x)
-        out[x] = half_to_float (one_to_native16 (in[x]));
-#    else
-    while (w >= 8)
+    uint16_t*       o   = (uint16_t*) out;
+    const uint16_t* in0 = (const uint16_t*) in[0];
+    const uint16_t* in1 = (const uint16_t*) in[1];
+    const uint16_t* in2 = (const uint16_t*) in[2];
+    int             x   = 0;
+
+    for (; x + 8 <= w; x += 8)
+    {
+        uint16x8x3_t v;
+        v.val[0] = vld1q_u16 (in0 + x);
+        v.val[1] = vld1q_u16 (in1 + x);
+        v.val[2] = vld1q_u16 (in2 + x);
+        vst3q_u16 (o, v);
+        o += 24;
+    }
+    for (; x < w; ++x)
+    {
+        o[0] = in0[x];
+        o[1] = in1[x];
+        o[2] = in2[x];
+        o += 3;
+    }
+}
+
+static void
+interleave_16_4_neon (uint8_t* out, const uint8_t* const* in, int w)
+{
+    uint16_t*       o   = (uint16_t*) out;
+    const uint16_t* in0 = (const uint16_t*) in[0];
+    const uint16_t* in1 = (const uint16_t*) in[1];
+    const uint16_t* in2 = (const uint16_t*) in[2];
+    const uint16_t* in3 = (const uint16_t*) in[3];
+    int             x   = 0;
+
+    for (; x + 8 <= w; x += 8)
+    {
+        uint16x8x4_t v;
+        v.val[0] = vld1q_u16 (in0 + x);
+        v.val[1] = vld1q_u16 (in1 + x);
+        v.val[2] = vld1q_u16 (in2 + x);
+        v.val[3] = vld1q_u16 (in3 + x);
+        vst4q_u16 (o, v);
+        o += 32;
+    }
+    for (; x < w; ++x)
+    {
+        o[0] = in0[x];
+        o[1] = in1[x];
+        o[2] = in2[x];
+        o[3] = in3[x];
+        o += 4;
+    }
+}
+
+static void
+interleave_32_3_neon (uint8_t* out, const uint8_t* const* in, int w)
+{
+    uint32_t*       o   = (uint32_t*) out;
+    const uint32_t* in0 = (const uint32_t*) in[0];
+    const uint32_t* in1 = (const uint32_t*) in[1];
+    const uint32_t* in2 = (const uint32_t*) in[2];
+    int             x   = 0;
+
+    for (; x + 4 <= w; x += 4)
+    {
+        uint32x4x3_t v;
+        v.val[0] = vld1q_u32 (in0 + x);
+        v.val[1] = vld1q_u32 (in1 + x);
+        v.val[2] = vld1q_u32 (in2 + x);
+        vst3q_u32 (o, v);
+        o += 12;
+    }
+    for (; x < w; ++x)
+    {
+        o[0] = in0[x];
+        o[1] = in1[x];
+        o[2] = in2[x];
+        o += 3;
+    }
+}
+
+static void
+interleave_32_4_neon (uint8_t* out, const uint8_t* const* in, int w)
+{
+    uint32_t*       o   = (uint32_t*) out;
+    const uint32_t* in0 = (const uint32_t*) in[0];
+    const uint32_t* in1 = (const uint32_t*) in[1];
+    const uint32_t* in2 = (const uint32_t*) in[2];
+    const uint32_t* in3 = (const uint32_t*) in[3];
+    int             x   = 0;
+
+    for (; x + 4 <= w; x += 4)
     {
-        half_to_float8 (out, in);
-        out += 8;
-        in += 8;
-        w -= 8;
+        uint32x4x4_t v;
+        v.val[0] = vld1q_u32 (in0 + x);
+        v.val[1] = vld1q_u32 (in1 + x);
+        v.val[2] = vld1q_u32 (in2 + x);
+        v.val[3] = vld1q_u32 (in3 + x);
+        vst4q_u32 (o, v);
+        o += 16;
     }
-    switch (w)
+    for (; x < w; ++x)
+    {
+        o[0] = in0[x];
+        o[1] = in1[x];
+        o[2] = in2[x];
+        o[3] = in3[x];
+        o += 4;
+    }
+}
+
+#endif /* EXR_CODING_HAVE_NEON */
+
+static interleave_row_fn interleave_16_3 = &interleave_16_3_scalar;
+static interleave_row_fn interleave_16_4 = &interleave_16_4_scalar;
+static interleave_row_fn interleave_32_3 = &interleave_32_3_scalar;
+static interleave_row_fn interleave_32_4 = &interleave_32_4_scalar;
+
+static void
+choose_unpack_simd_impl (void)
+{
+    half_to_float_buffer = internal_exr_choose_half_to_float ();
+    float_to_half_buffer = internal_exr_choose_float_to_half ();
+
+#if defined(EXR_CODING_HAVE_SSE2)
+    interleave_16_3 = &interleave_16_3_sse2;
+    interleave_16_4 = &interleave_16_4_sse2;
+    interleave_32_3 = &interleave_32_3_sse2;
+    interleave_32_4 = &interleave_32_4_sse2;
+#    ifdef EXR_CODING_HAVE_AVX_TARGET
     {
-        case 7:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: half_to_float4 (out, in); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
+        int f = internal_exr_cpu_features ();
+        if (f & EXR_CPU_AVX2) interleave_16_4 = &interleave_16_4_avx2;
+        if (f & EXR_CPU_AVX_F16C) interleave_32_4 = &interleave_32_4_avx;
     }
 #    endif
+#elif defined(EXR_CODING_HAVE_NEON)
+    interleave_16_3 = &interleave_16_3_neon;
+    interleave_16_4 = &interleave_16_4_neon;
+    interleave_32_3 = &interleave_32_3_neon;
+    interleave_32_4 = &interleave_32_4_neon;
+#endif
+}
+
+/**************************************/
+
+/* The type changing kernels convert a block of each channel into
+ * values on the stack, then interleave those. The interleave kernels
+ * expect file (little endian) order, so big endian hosts take the
+ * per pixel path instead */
+
+static void
+interleave_half_to_float (
+    uint8_t* out, const uint8_t* const* in, int nc, int w)
+{
+    float          tmp[4][UNPACK_CONVERT_BLOCK];
+    const uint8_t* tin[4] = {
+        (const uint8_t*) tmp[0],
+        (const uint8_t*) tmp[1],
+        (const uint8_t*) tmp[2],
+        (const uint8_t*) tmp[3]};
+    interleave_row_fn rowfn = (nc == 4) ? interleave_32_4 : interleave_32_3;
+
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+    for (int x = 0; x < w; ++x)
+    {
+        for (int c = 0; c < nc; ++c)
+            ((float*) out)[x * nc + c] = half_to_float (
+                one_to_native16 (((const uint16_t*) in[c])[x]));
+    }
+    return;
+#endif
+    for (int x = 0; x < w; x += UNPACK_CONVERT_BLOCK)
+    {
+        int n = w - x;
+        if (n > UNPACK_CONVERT_BLOCK) n = UNPACK_CONVERT_BLOCK;
+
+        for (int c = 0; c < nc; ++c)
+            half_to_float_buffer (
+                tmp[c], ((const uint16_t*) in[c]) + x, n);
+        rowfn (out, tin, n);
+        out += (size_t) n * (size_t) nc * sizeof (float);
+    }
 }
 
 static void
-choose_half_to_float_impl ()
-{}
+interleave_float_to_half (
+    uint8_t* out, const uint8_t* const* in, int nc, int w)
+{
+    uint16_t       tmp[4][UNPACK_CONVERT_BLOCK];
+    const uint8_t* tin[4] = {
+        (const uint8_t*) tmp[0],
+        (const uint8_t*) tmp[1],
+        (const uint8_t*) tmp[2],
+        (const uint8_t*) tmp[3]};
+    interleave_row_fn rowfn = (nc == 4) ? interleave_16_4 : interleave_16_3;
 
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+    for (int x = 0; x < w; ++x)
+    {
+        for (int c = 0; c < nc; ++c)
+            ((uint16_t*) out)[x * nc + c] = float_to_half_int (
+                one_to_native32 (((const uint32_t*) in[c])[x]));
+    }
+    return;
 #endif
+    for (int x = 0; x < w; x += UNPACK_CONVERT_BLOCK)
+    {
+        int n = w - x;
+        if (n > UNPACK_CONVERT_BLOCK) n = UNPACK_CONVERT_BLOCK;
+
+        for (int c = 0; c < nc; ++c)
+            float_to_half_buffer (tmp[c], ((const float*) in[c]) + x, n);
+        rowfn (out, tin, n);
+        out += (size_t) n * (size_t) nc * sizeof (uint16_t);
+    }
+}
+
+static void
+interleave_half_to_float_3 (uint8_t* out, const uint8_t* const* in, int w)
+{
+    interleave_half_to_float (out, in, 3, w);
+}
+
+static void
+interleave_half_to_float_4 (uint8_t* out, const uint8_t* const* in, int w)
+{
+    interleave_half_to_float (out, in, 4, w);
+}
+
+static void
+interleave_float_to_half_3 (uint8_t* out, const uint8_t* const* in, int w)
+{
+    interleave_float_to_half (out, in, 3, w);
+}
+
+static void
+interleave_float_to_half_4 (uint8_t* out, const uint8_t* const* in, int w)
+{
+    interleave_float_to_half (out, in, 4, w);
+}
 
 /**************************************/
 
 static exr_result_t
-unpack_16bit_3chan_interleave (exr_decode_pipeline_t* decode)
+unpack_interleaved (
+    exr_decode_pipeline_t* decode, int rev, interleave_row_fn rowfn)
 {
     /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
-
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
-
-    out0 = decode->channels[0].decode_to_ptr;
+    const uint8_t* srcbuffer = decode->unpacked_buffer;
+    const uint8_t* in[4];
+    uint8_t*       out0;
+    int            nc = decode->channel_count;
+    int            w, h;
+    size_t         planebytes;
+    int64_t        linc0;
+
+    w          = decode->channels[0].width;
+    h          = decode->chunk.height;
+    linc0      = decode->channels[0].user_line_stride;
+    planebytes = (size_t) w * (size_t) decode->channels[0].bytes_per_element;
+
+    /* for the reversed case (i.e. BGR in memory for RGB in the file),
+     * the last channel has the lowest address */
+    out0 = decode->channels[rev ? (nc - 1) : 0].decode_to_ptr;
 
-    /* interleaving case, we can do this! */
     for (int y = 0; y < h; ++y)
     {
-        uint16_t* out = (uint16_t*) out0;
+        for (int c = 0; c < nc; ++c)
+            in[c] = srcbuffer + (size_t) (rev ? (nc - 1 - c) : c) * planebytes;
 
-        in0 = (const uint16_t*) srcbuffer;
-        in1 = in0 + w;
-        in2 = in1 + w;
+        rowfn (out0, in, w);
 
-        srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
-        {
-            out[0] = one_to_native16 (in0[x]);
-            out[1] = one_to_native16 (in1[x]);
-            out[2] = one_to_native16 (in2[x]);
-            out += 3;
-        }
+        srcbuffer += (size_t) nc * planebytes;
         out0 += linc0;
     }
     return EXR_ERR_SUCCESS;
 }
 
-/**************************************/
+static exr_result_t
+unpack_16bit_3chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 0, interleave_16_3);
+}
 
 static exr_result_t
 unpack_16bit_3chan_interleave_rev (exr_decode_pipeline_t* decode)
 {
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
+    return unpack_interleaved (decode, 1, interleave_16_3);
+}
 
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
+static exr_result_t
+unpack_16bit_4chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 0, interleave_16_4);
+}
 
-    out0 = decode->channels[2].decode_to_ptr;
+static exr_result_t
+unpack_16bit_4chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 1, interleave_16_4);
+}
 
-    /* interleaving case, we can do this! */
-    for (int y = 0; y < h; ++y)
-    {
-        uint16_t* out = (uint16_t*) out0;
+static exr_result_t
+unpack_32bit_3chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 0, interleave_32_3);
+}
 
-        in0 = (const uint16_t*) srcbuffer; // B
-        in1 = in0 + w;                     // G
-        in2 = in1 + w;                     // R
+static exr_result_t
+unpack_32bit_3chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 1, interleave_32_3);
+}
 
-        srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
-        {
-            out[0] = one_to_native16 (in2[x]);
-            out[1] = one_to_native16 (in1[x]);
-            out[2] = one_to_native16 (in0[x]);
-            out += 3;
-        }
-        out0 += linc0;
-    }
-    return EXR_ERR_SUCCESS;
+static exr_result_t
+unpack_32bit_4chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 0, interleave_32_4);
 }
 
-/**************************************/
+static exr_result_t
+unpack_32bit_4chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 1, interleave_32_4);
+}
 
 static exr_result_t
 unpack_half_to_float_3chan_interleave (exr_decode_pipeline_t* decode)
 {
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
+    return unpack_interleaved (decode, 0, &interleave_half_to_float_3);
+}
 
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
+static exr_result_t
+unpack_half_to_float_3chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 1, &interleave_half_to_float_3);
+}
 
-    out0 = decode->channels[0].decode_to_ptr;
+static exr_result_t
+unpack_half_to_float_4chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 0, &interleave_half_to_float_4);
+}
 
-    /* interleaving case, we can do this! */
-    for (int y = 0; y < h; ++y)
-    {
-        float* out = (float*) out0;
+static exr_result_t
+unpack_half_to_float_4chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 1, &interleave_half_to_float_4);
+}
 
-        in0 = (const uint16_t*) srcbuffer;
-        in1 = in0 + w;
-        in2 = in1 + w;
+static exr_result_t
+unpack_float_to_half_3chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 0, &interleave_float_to_half_3);
+}
 
-        srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
-        {
-            out[0] = half_to_float (one_to_native16 (in0[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in2[x]));
-            out += 3;
-        }
-        out0 += linc0;
-    }
-    return EXR_ERR_SUCCESS;
+static exr_result_t
+unpack_float_to_half_3chan_interleave_rev (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 1, &interleave_float_to_half_3);
 }
 
-/**************************************/
+static exr_result_t
+unpack_float_to_half_4chan_interleave (exr_decode_pipeline_t* decode)
+{
+    return unpack_interleaved (decode, 0, &interleave_float_to_half_4);
+}
 
 static exr_result_t
-unpack_half_to_float_3chan_interleave_rev (exr_decode_pipeline_t* decode)
+unpack_float_to_half_4chan_interleave_rev (exr_decode_pipeline_t* decode)
 {
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
+    return unpack_interleaved (decode, 1, &interleave_float_to_half_4);
+}
 
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
+/**************************************/
 
-    out0 = decode->channels[2].decode_to_ptr;
+static exr_result_t
+unpack_half_to_float_planar (exr_decode_pipeline_t* decode)
+{
+    /* we know we're unpacking all the channels and there is no subsampling */
+    const uint8_t* srcbuffer = decode->unpacked_buffer;
+    int            h         = decode->chunk.height;
 
-    /* interleaving case, we can do this! */
     for (int y = 0; y < h; ++y)
     {
-        float* out = (float*) out0;
+        for (int c = 0; c < decode->channel_count; ++c)
+        {
+            exr_coding_channel_info_t* decc = (decode->channels + c);
+            uint8_t*                   cdata;
 
-        in0 = (const uint16_t*) srcbuffer;
-        in1 = in0 + w;
-        in2 = in1 + w;
+            cdata = decc->decode_to_ptr +
+                    (int64_t) y * (int64_t) decc->user_line_stride;
+            half_to_float_buffer (
+                (float*) cdata, (const uint16_t*) srcbuffer, decc->width);
+            srcbuffer += (size_t) decc->width * 2;
+        }
+    }
+    return EXR_ERR_SUCCESS;
+}
 
-        srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
+static exr_result_t
+unpack_float_to_half_planar (exr_decode_pipeline_t* decode)
+{
+    /* we know we're unpacking all the channels and there is no subsampling */
+    const uint8_t* srcbuffer = decode->unpacked_buffer;
+    int            h         = decode->chunk.height;
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int c = 0; c < decode->channel_count; ++c)
         {
-            out[0] = half_to_float (one_to_native16 (in2[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in0[x]));
-            out += 3;
+            exr_coding_channel_info_t* decc = (decode->channels + c);
+            uint8_t*                   cdata;
+
+            cdata = decc->decode_to_ptr +
+                    (int64_t) y * (int64_t) decc->user_line_stride;
+            float_to_half_buffer (
+                (uint16_t*) cdata, (const float*) srcbuffer, decc->width);
+            srcbuffer += (size_t) decc->width * 4;
         }
-        out0 += linc0;
     }
     return EXR_ERR_SUCCESS;
 }
@@ -443,52 +861,6 @@ unpack_16bit_3chan_planar (exr_decode_pipeline_t* decode)
 
 /**************************************/
 
-static exr_result_t
-unpack_half_to_float_3chan_planar (exr_decode_pipeline_t* decode)
-{
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2;
-    uint8_t *       out0, *out1, *out2;
-    int             w, h;
-    int             inc0, inc1, inc2;
-    int             linc0, linc1, linc2;
-
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    inc0  = decode->channels[0].user_pixel_stride;
-    inc1  = decode->channels[1].user_pixel_stride;
-    inc2  = decode->channels[2].user_pixel_stride;
-    linc0 = decode->channels[0].user_line_stride;
-    linc1 = decode->channels[1].user_line_stride;
-    linc2 = decode->channels[2].user_line_stride;
-
-    out0 = decode->channels[0].decode_to_ptr;
-    out1 = decode->channels[1].decode_to_ptr;
-    out2 = decode->channels[2].decode_to_ptr;
-
-    // planar output
-    for (int y = 0; y < h; ++y)
-    {
-        in0 = (const uint16_t*) srcbuffer;
-        in1 = in0 + w;
-        in2 = in1 + w;
-        srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-                            /* specialise to memcpy if we can */
-        half_to_float_buffer ((float*) out0, in0, w);
-        half_to_float_buffer ((float*) out1, in1, w);
-        half_to_float_buffer ((float*) out2, in2, w);
-
-        out0 += linc0;
-        out1 += linc1;
-        out2 += linc2;
-    }
-
-    return EXR_ERR_SUCCESS;
-}
-
-/**************************************/
-
 static exr_result_t
 unpack_16bit_3chan (exr_decode_pipeline_t* decode)
 {
@@ -535,194 +907,6 @@ unpack_16bit_3chan (exr_decode_pipeline_t* decode)
 
 /**************************************/
 
-static exr_result_t
-unpack_16bit_4chan_interleave (exr_decode_pipeline_t* decode)
-{
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2, *in3;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
-    /* TODO: can do this with sse and do 2 outpixels at once */
-    union
-    {
-        struct
-        {
-            uint16_t a;
-            uint16_t b;
-            uint16_t g;
-            uint16_t r;
-        };
-        uint64_t allc;
-    } combined;
-
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
-
-    out0 = decode->channels[0].decode_to_ptr;
-
-    /* interleaving case, we can do this! */
-    for (int y = 0; y < h; ++y)
-    {
-        uint64_t* outall = (uint64_t*) out0;
-        in0              = (const uint16_t*) srcbuffer;
-        in1              = in0 + w;
-        in2              = in1 + w;
-        in3              = in2 + w;
-
-        srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
-        {
-            combined.a = one_to_native16 (in0[x]);
-            combined.b = one_to_native16 (in1[x]);
-            combined.g = one_to_native16 (in2[x]);
-            combined.r = one_to_native16 (in3[x]);
-            outall[x]  = combined.allc;
-        }
-        out0 += linc0;
-    }
-    return EXR_ERR_SUCCESS;
-}
-
-/**************************************/
-
-static exr_result_t
-unpack_16bit_4chan_interleave_rev (exr_decode_pipeline_t* decode)
-{
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2, *in3;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
-    /* TODO: can do this with sse and do 2 outpixels at once */
-    union
-    {
-        struct
-        {
-            uint16_t r;
-            uint16_t g;
-            uint16_t b;
-            uint16_t a;
-        };
-        uint64_t allc;
-    } combined;
-
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
-
-    out0 = decode->channels[3].decode_to_ptr;
-
-    /* interleaving case, we can do this! */
-    for (int y = 0; y < h; ++y)
-    {
-        uint64_t* outall = (uint64_t*) out0;
-        in0              = (const uint16_t*) srcbuffer;
-        in1              = in0 + w;
-        in2              = in1 + w;
-        in3              = in2 + w;
-
-        srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
-        {
-            combined.a = one_to_native16 (in0[x]);
-            combined.b = one_to_native16 (in1[x]);
-            combined.g = one_to_native16 (in2[x]);
-            combined.r = one_to_native16 (in3[x]);
-            outall[x]  = combined.allc;
-        }
-        out0 += linc0;
-    }
-    return EXR_ERR_SUCCESS;
-}
-
-/**************************************/
-
-static exr_result_t
-unpack_half_to_float_4chan_interleave (exr_decode_pipeline_t* decode)
-{
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2, *in3;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
-
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
-
-    out0 = decode->channels[0].decode_to_ptr;
-
-    /* interleaving case, we can do this! */
-    for (int y = 0; y < h; ++y)
-    {
-        float* out = (float*) out0;
-        in0        = (const uint16_t*) srcbuffer;
-        in1        = in0 + w;
-        in2        = in1 + w;
-        in3        = in2 + w;
-
-        srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
-        {
-            out[0] = half_to_float (one_to_native16 (in3[x]));
-            out[1] = half_to_float (one_to_native16 (in2[x]));
-            out[2] = half_to_float (one_to_native16 (in1[x]));
-            out[3] = half_to_float (one_to_native16 (in0[x]));
-            out += 4;
-        }
-        out0 += linc0;
-    }
-    return EXR_ERR_SUCCESS;
-}
-
-/**************************************/
-
-static exr_result_t
-unpack_half_to_float_4chan_interleave_rev (exr_decode_pipeline_t* decode)
-{
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2, *in3;
-    uint8_t*        out0;
-    int             w, h;
-    int             linc0;
-
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
-
-    out0 = decode->channels[3].decode_to_ptr;
-
-    /* interleaving case, we can do this! */
-    for (int y = 0; y < h; ++y)
-    {
-        float* out = (float*) out0;
-        in0        = (const uint16_t*) srcbuffer;
-        in1        = in0 + w;
-        in2        = in1 + w;
-        in3        = in2 + w;
-
-        srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
-        {
-            out[0] = half_to_float (one_to_native16 (in0[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in2[x]));
-            out[3] = half_to_float (one_to_native16 (in3[x]));
-            out += 4;
-        }
-        out0 += linc0;
-    }
-    return EXR_ERR_SUCCESS;
-}
-
-/**************************************/
-
 static exr_result_t
 unpack_16bit_4chan_planar (exr_decode_pipeline_t* decode)
 {
@@ -779,52 +963,6 @@ unpack_16bit_4chan_planar (exr_decode_pipeline_t* decode)
 
 /**************************************/
 
-static exr_result_t
-unpack_half_to_float_4chan_planar (exr_decode_pipeline_t* decode)
-{
-    /* we know we're unpacking all the channels and there is no subsampling */
-    const uint8_t*  srcbuffer = decode->unpacked_buffer;
-    const uint16_t *in0, *in1, *in2, *in3;
-    uint8_t *       out0, *out1, *out2, *out3;
-    int             w, h;
-    int             linc0, linc1, linc2, linc3;
-
-    w     = decode->channels[0].width;
-    h     = decode->chunk.height;
-    linc0 = decode->channels[0].user_line_stride;
-    linc1 = decode->channels[1].user_line_stride;
-    linc2 = decode->channels[2].user_line_stride;
-    linc3 = decode->channels[3].user_line_stride;
-
-    out0 = decode->channels[0].decode_to_ptr;
-    out1 = decode->channels[1].decode_to_ptr;
-    out2 = decode->channels[2].decode_to_ptr;
-    out3 = decode->channels[3].decode_to_ptr;
-
-    // planar output
-    for (int y = 0; y < h; ++y)
-    {
-        in0 = (const uint16_t*) srcbuffer;
-        in1 = in0 + w;
-        in2 = in1 + w;
-        in3 = in2 + w;
-        srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-
-        half_to_float_buffer ((float*) out0, in0, w);
-        half_to_float_buffer ((float*) out1, in1, w);
-        half_to_float_buffer ((float*) out2, in2, w);
-        half_to_float_buffer ((float*) out3, in3, w);
-
-        out0 += linc0;
-        out1 += linc1;
-        out2 += linc2;
-        out3 += linc3;
-    }
-    return EXR_ERR_SUCCESS;
-}
-
-/**************************************/
-
 static exr_result_t
 unpack_16bit_4chan (exr_decode_pipeline_t* decode)
 {
@@ -937,8 +1075,7 @@ unpack_16bit (exr_decode_pipeline_t* decode)
     return EXR_ERR_SUCCESS;
 }
 
-//static exr_result_t unpack_32bit_3chan (exr_decode_pipeline_t* decode);
-//static exr_result_t unpack_32bit_4chan (exr_decode_pipeline_t* decode);
+/**************************************/
 
 static exr_result_t
 unpack_32bit (exr_decode_pipeline_t* decode)
@@ -1328,7 +1465,7 @@ internal_exr_match_decode (
     static int init_cpu_check = 1;
     if (init_cpu_check)
     {
-        choose_half_to_float_impl ();
+        choose_unpack_simd_impl ();
         init_cpu_check = 0;
     }
 
@@ -1339,11 +1476,16 @@ internal_exr_match_decode (
         return &generic_unpack_deep;
     }
 
+    if (hassampling || chanstofill != decode->channel_count)
+        return &generic_unpack;
+
+    (void) chanstounpack;
+    (void) simplineoff;
+
     if (hastypechange > 0)
     {
-        /* other optimizations would not be difficult, but this will
-         * be the common one (where on encode / pack we want to do the
-         * opposite) */
+        /* these are the common ones (where on encode / pack we want to
+         * do the opposite), the rest go through the generic path */
         if (sametype == (int) EXR_PIXEL_HALF &&
             sameouttype == (int) EXR_PIXEL_FLOAT)
         {
@@ -1363,24 +1505,35 @@ internal_exr_match_decode (
                     return &unpack_half_to_float_3chan_interleave_rev;
             }
 
-            if (sameoutinc == 4)
+            if (sameoutinc == 4) return &unpack_half_to_float_planar;
+        }
+
+        if (sametype == (int) EXR_PIXEL_FLOAT &&
+            sameouttype == (int) EXR_PIXEL_HALF)
+        {
+            if (simpinterleave > 0)
+            {
+                if (decode->channel_count == 4)
+                    return &unpack_float_to_half_4chan_interleave;
+                if (decode->channel_count == 3)
+                    return &unpack_float_to_half_3chan_interleave;
+            }
+
+            if (simpinterleaverev > 0)
             {
                 if (decode->channel_count == 4)
-                    return &unpack_half_to_float_4chan_planar;
+                    return &unpack_float_to_half_4chan_interleave_rev;
                 if (decode->channel_count == 3)
-                    return &unpack_half_to_float_3chan_planar;
+                    return &unpack_float_to_half_3chan_interleave_rev;
             }
+
+            if (sameoutinc == 2) return &unpack_float_to_half_planar;
         }
 
         return &generic_unpack;
     }
 
-    if (hassampling || chanstofill != decode->channel_count || samebpc <= 0 ||
-        sameoutbpc <= 0)
-        return &generic_unpack;
-
-    (void) chanstounpack;
-    (void) simplineoff;
+    if (samebpc <= 0 || sameoutbpc <= 0) return &generic_unpack;
 
     if (samebpc == 2)
     {
@@ -1414,8 +1567,23 @@ internal_exr_match_decode (
 
     if (samebpc == 4)
     {
-        //if (decode->channel_count == 4) return &unpack_32bit_4chan;
-        //if (decode->channel_count == 3) return &unpack_32bit_3chan;
+        /* float and uint are both plain 32 bit copies here */
+        if (simpinterleave > 0)
+        {
+            if (decode->channel_count == 4)
+                return &unpack_32bit_4chan_interleave;
+            if (decode->channel_count == 3)
+                return &unpack_32bit_3chan_interleave;
+        }
+
+        if (simpinterleaverev > 0)
+        {
+            if (decode->channel_count == 4)
+                return &unpack_32bit_4chan_interleave_rev;
+            if (decode->channel_count == 3)
+                return &unpack_32bit_3chan_interleave_rev;
+        }
+
         return &unpack_32bit;
     }
 
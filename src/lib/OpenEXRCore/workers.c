@@ -0,0 +1,332 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "internal_workers.h"
+
+#include <IlmThreadConfig.h>
+
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+#        include <windows.h>
+#    else
+#        include <pthread.h>
+#        include <unistd.h>
+#    endif
+#endif
+
+/**************************************/
+
+static int
+default_worker_count (void* pool_data)
+{
+    (void) pool_data;
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    {
+        SYSTEM_INFO si;
+        GetSystemInfo (&si);
+        return (si.dwNumberOfProcessors > 0) ? (int) si.dwNumberOfProcessors
+                                             : 1;
+    }
+#    else
+    {
+        long n = sysconf (_SC_NPROCESSORS_ONLN);
+        return (n > 0) ? (int) n : 1;
+    }
+#    endif
+#else
+    return 1;
+#endif
+}
+
+/**************************************/
+
+#ifdef ILMTHREAD_THREADING_ENABLED
+
+/* The default pool keeps its threads between calls: they are started
+ * on first use, as many as a call asks for up to the number of
+ * processors, and wait for the next call once the tasks of a call have
+ * all been handed out.  They are joined by
+ * exr_shutdown_default_worker_pool(), which also runs when the library
+ * is unloaded where the compiler supports it, and otherwise live until
+ * the process exits.  Only one call uses the threads at a time; a call
+ * made while they are busy, for example from another thread, runs its
+ * tasks itself, which is fine for the pull based tasks the library
+ * uses. */
+
+#    define DEFAULT_MAX_THREADS 256
+
+#    ifdef _WIN32
+typedef SRWLOCK            default_mutex_t;
+typedef CONDITION_VARIABLE default_cond_t;
+typedef HANDLE             default_thread_t;
+#        define DEFAULT_MUTEX_INIT SRWLOCK_INIT
+#        define DEFAULT_COND_INIT CONDITION_VARIABLE_INIT
+#        define default_lock(m) AcquireSRWLockExclusive (m)
+#        define default_trylock(m) TryAcquireSRWLockExclusive (m)
+#        define default_unlock(m) ReleaseSRWLockExclusive (m)
+#        define default_wait(c, m)                                            \
+            SleepConditionVariableSRW (c, m, INFINITE, 0)
+#        define default_signal(c) WakeConditionVariable (c)
+#        define default_broadcast(c) WakeAllConditionVariable (c)
+#    else
+typedef pthread_mutex_t default_mutex_t;
+typedef pthread_cond_t  default_cond_t;
+typedef pthread_t       default_thread_t;
+#        define DEFAULT_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#        define DEFAULT_COND_INIT PTHREAD_COND_INITIALIZER
+#        define default_lock(m) pthread_mutex_lock (m)
+#        define default_trylock(m) (0 == pthread_mutex_trylock (m))
+#        define default_unlock(m) pthread_mutex_unlock (m)
+#        define default_wait(c, m) pthread_cond_wait (c, m)
+#        define default_signal(c) pthread_cond_signal (c)
+#        define default_broadcast(c) pthread_cond_broadcast (c)
+#    endif
+
+typedef struct
+{
+    /* held by the call that is using the threads */
+    default_mutex_t call_mutex;
+
+    /* protects the rest */
+    default_mutex_t mutex;
+    default_cond_t  work_cond;
+    default_cond_t  done_cond;
+    int             nthreads;
+    int             stop;
+
+    default_thread_t threads[DEFAULT_MAX_THREADS];
+
+    exr_worker_task_func_t task;
+    void*                  task_data;
+    int                    ntasks;
+    int                    next_task;
+    int                    running;
+} default_pool_t;
+
+static default_pool_t sDefaultPool = {
+    DEFAULT_MUTEX_INIT,
+    DEFAULT_MUTEX_INIT,
+    DEFAULT_COND_INIT,
+    DEFAULT_COND_INIT,
+    0,
+    0,
+    {0},
+    NULL,
+    NULL,
+    0,
+    0,
+    0};
+
+/* runs the tasks of the current call not yet handed out, called and
+ * returns with the mutex held */
+static void
+default_pull_tasks (default_pool_t* p)
+{
+    while (p->next_task < p->ntasks)
+    {
+        exr_worker_task_func_t task      = p->task;
+        void*                  task_data = p->task_data;
+        int                    idx       = p->next_task++;
+
+        ++p->running;
+        default_unlock (&(p->mutex));
+        task (idx, task_data);
+        default_lock (&(p->mutex));
+        if (--p->running == 0 && p->next_task >= p->ntasks)
+            default_signal (&(p->done_cond));
+    }
+}
+
+#    ifdef _WIN32
+static DWORD WINAPI
+default_thread_main (LPVOID arg)
+#    else
+static void*
+default_thread_main (void* arg)
+#    endif
+{
+    default_pool_t* p = (default_pool_t*) arg;
+
+    default_lock (&(p->mutex));
+    for (;;)
+    {
+        while (!p->stop && p->next_task >= p->ntasks)
+            default_wait (&(p->work_cond), &(p->mutex));
+        if (p->stop) break;
+        default_pull_tasks (p);
+    }
+    default_unlock (&(p->mutex));
+#    ifdef _WIN32
+    return 0;
+#    else
+    return NULL;
+#    endif
+}
+
+/* starts threads until there are nthreads, called with the mutex held */
+static void
+default_start_threads (default_pool_t* p, int nthreads)
+{
+    if (nthreads > DEFAULT_MAX_THREADS) nthreads = DEFAULT_MAX_THREADS;
+
+    while (p->nthreads < nthreads)
+    {
+#    ifdef _WIN32
+        HANDLE thread =
+            CreateThread (NULL, 0, &default_thread_main, p, 0, NULL);
+        if (thread == NULL) break;
+#    else
+        pthread_t thread;
+        if (0 != pthread_create (&thread, NULL, &default_thread_main, p))
+            break;
+#    endif
+        p->threads[p->nthreads++] = thread;
+    }
+}
+
+static int
+default_run_threaded (
+    int ntasks, exr_worker_task_func_t task, void* task_data)
+{
+    default_pool_t* p = &sDefaultPool;
+
+    if (!default_trylock (&(p->call_mutex))) return 0;
+
+    default_lock (&(p->mutex));
+    default_start_threads (p, ntasks - 1);
+
+    p->task      = task;
+    p->task_data = task_data;
+    p->next_task = 0;
+    p->ntasks    = ntasks;
+    default_broadcast (&(p->work_cond));
+
+    /* any task no thread has picked up, for example when threads
+     * could not be started, is run here */
+    default_pull_tasks (p);
+    while (p->running > 0)
+        default_wait (&(p->done_cond), &(p->mutex));
+
+    p->task      = NULL;
+    p->task_data = NULL;
+    default_unlock (&(p->mutex));
+
+    default_unlock (&(p->call_mutex));
+    return 1;
+}
+
+/* stops and joins the threads, called with the call mutex held */
+static void
+default_join_threads (default_pool_t* p)
+{
+    default_lock (&(p->mutex));
+    p->stop = 1;
+    default_broadcast (&(p->work_cond));
+    default_unlock (&(p->mutex));
+
+    for (int t = 0; t < p->nthreads; ++t)
+    {
+#    ifdef _WIN32
+        WaitForSingleObject (p->threads[t], INFINITE);
+        CloseHandle (p->threads[t]);
+#    else
+        pthread_join (p->threads[t], NULL);
+#    endif
+    }
+
+    default_lock (&(p->mutex));
+    p->nthreads = 0;
+    p->stop     = 0;
+    default_unlock (&(p->mutex));
+}
+
+#    if defined(__GNUC__) && !defined(_WIN32)
+/* joins the threads before the code they run is unmapped, unless a
+ * call is still using them while the process exits */
+__attribute__ ((destructor)) static void
+default_pool_unload (void)
+{
+    default_pool_t* p = &sDefaultPool;
+
+    if (!default_trylock (&(p->call_mutex))) return;
+    default_join_threads (p);
+    default_unlock (&(p->call_mutex));
+}
+#    endif
+
+#endif /* ILMTHREAD_THREADING_ENABLED */
+
+static exr_result_t
+default_run_tasks (
+    void* pool_data, int ntasks, exr_worker_task_func_t task, void* task_data)
+{
+    (void) pool_data;
+    if (ntasks <= 0) return EXR_ERR_SUCCESS;
+    if (!task) return EXR_ERR_INVALID_ARGUMENT;
+
+#ifdef ILMTHREAD_THREADING_ENABLED
+    if (ntasks > 1 && default_run_threaded (ntasks, task, task_data))
+        return EXR_ERR_SUCCESS;
+#endif /* ILMTHREAD_THREADING_ENABLED */
+
+    for (int t = 0; t < ntasks; ++t)
+        task (t, task_data);
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static const exr_worker_pool_t sDefaultWorkerPool = {
+    sizeof (exr_worker_pool_t), NULL, &default_worker_count, &default_run_tasks};
+
+const exr_worker_pool_t*
+exr_get_default_worker_pool (void)
+{
+    return &sDefaultWorkerPool;
+}
+
+void
+exr_shutdown_default_worker_pool (void)
+{
+#ifdef ILMTHREAD_THREADING_ENABLED
+    default_pool_t* p = &sDefaultPool;
+
+    default_lock (&(p->call_mutex));
+    default_join_threads (p);
+    default_unlock (&(p->call_mutex));
+#endif /* ILMTHREAD_THREADING_ENABLED */
+}
+
+/**************************************/
+
+exr_result_t
+internal_exr_choose_workers (
+    const struct _internal_exr_context* pctxt,
+    const exr_worker_pool_t*            pool,
+    int                                 max_workers,
+    int                                 nitems,
+    const exr_worker_pool_t**           outpool,
+    int*                                ntasks)
+{
+    int nworkers;
+
+    if (!pool) pool = &sDefaultWorkerPool;
+
+    if (pool->size < sizeof (exr_worker_pool_t) || !pool->run_tasks)
+        return pctxt->report_error (
+            pctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid worker pool provided");
+
+    nworkers = pool->get_worker_count
+                   ? pool->get_worker_count (pool->pool_data)
+                   : 1;
+    if (nworkers < 1) nworkers = 1;
+    if (max_workers > 0 && nworkers > max_workers) nworkers = max_workers;
+    if (nworkers > nitems) nworkers = nitems;
+
+    *outpool = pool;
+    *ntasks  = nworkers;
+    return EXR_ERR_SUCCESS;
+}
@@ -36,6 +36,7 @@ namespace
 
 using IMATH_NAMESPACE::Box2i;
 using std::max;
+using std::min;
 using std::vector;
 
 //
@@ -1602,6 +1603,219 @@ runCoreChecks (
     return hadfail;
 }
 
+////////////////////////////////////////
+
+//
+// The bytes of the file that a chunk's sample count table
+// and pixel data occupy
+//
+
+struct ChunkExtent
+{
+    uint64_t begin;
+    uint64_t end;
+
+    bool operator< (const ChunkExtent& other) const
+    {
+        return begin < other.begin;
+    }
+};
+
+void
+addChunkExtent (const exr_chunk_info_t& cinfo, vector<ChunkExtent>& extents)
+{
+    ChunkExtent e;
+    e.begin = cinfo.data_offset;
+    e.end   = cinfo.data_offset + cinfo.packed_size;
+
+    if (cinfo.sample_count_table_size > 0)
+    {
+        e.begin = min (e.begin, cinfo.sample_count_data_offset);
+        e.end   = max (
+            e.end,
+            cinfo.sample_count_data_offset + cinfo.sample_count_table_size);
+    }
+
+    extents.push_back (e);
+}
+
+bool
+checkCoreScanlineStructure (
+    exr_context_t f, int part, vector<ChunkExtent>& extents)
+{
+    exr_result_t     rv;
+    exr_attr_box2i_t datawin;
+    rv = exr_get_data_window (f, part, &datawin);
+    if (rv != EXR_ERR_SUCCESS) return true;
+
+    int32_t lines_per_chunk;
+    rv = exr_get_scanlines_per_chunk (f, part, &lines_per_chunk);
+    if (rv != EXR_ERR_SUCCESS || lines_per_chunk <= 0) return true;
+
+    for (int64_t y = datawin.min.y; y <= datawin.max.y; y += lines_per_chunk)
+    {
+        exr_chunk_info_t cinfo;
+
+        rv = exr_read_scanline_chunk_info (f, part, (int) y, &cinfo);
+        if (rv != EXR_ERR_SUCCESS) return true;
+
+        addChunkExtent (cinfo, extents);
+    }
+
+    return false;
+}
+
+bool
+checkCoreTiledStructure (
+    exr_context_t f, int part, vector<ChunkExtent>& extents)
+{
+    exr_result_t          rv;
+    uint32_t              txsz, tysz;
+    exr_tile_level_mode_t levelmode;
+    exr_tile_round_mode_t roundingmode;
+
+    rv = exr_get_tile_descriptor (
+        f, part, &txsz, &tysz, &levelmode, &roundingmode);
+    if (rv != EXR_ERR_SUCCESS) return true;
+
+    int32_t levelsx, levelsy;
+    rv = exr_get_tile_levels (f, part, &levelsx, &levelsy);
+    if (rv != EXR_ERR_SUCCESS) return true;
+
+    for (int32_t ylevel = 0; ylevel < levelsy; ++ylevel)
+    {
+        for (int32_t xlevel = 0; xlevel < levelsx; ++xlevel)
+        {
+            if (levelmode == EXR_TILE_MIPMAP_LEVELS && xlevel != ylevel)
+                continue;
+
+            int32_t levw, levh;
+            rv = exr_get_level_sizes (f, part, xlevel, ylevel, &levw, &levh);
+            if (rv != EXR_ERR_SUCCESS) return true;
+
+            int32_t curtw, curth;
+            rv = exr_get_tile_sizes (f, part, xlevel, ylevel, &curtw, &curth);
+            if (rv != EXR_ERR_SUCCESS || curtw <= 0 || curth <= 0)
+                return true;
+
+            int ty = 0;
+            for (int64_t cury = 0; cury < levh; cury += curth, ++ty)
+            {
+                int tx = 0;
+                for (int64_t curx = 0; curx < levw; curx += curtw, ++tx)
+                {
+                    exr_chunk_info_t cinfo;
+
+                    rv = exr_read_tile_chunk_info (
+                        f, part, tx, ty, xlevel, ylevel, &cinfo);
+                    if (rv != EXR_ERR_SUCCESS) return true;
+
+                    addChunkExtent (cinfo, extents);
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+//
+// Check the structure of a file without reading any pixel data:
+// the header of every chunk of every part must be valid, every
+// chunk's data must lie within the file, which the core library
+// checks as it reads the chunk headers, and no two chunks may
+// overlap.
+//
+
+bool
+checkCoreStructure (exr_context_t f)
+{
+    exr_result_t rv;
+    int          numparts;
+
+    rv = exr_get_count (f, &numparts);
+    if (rv != EXR_ERR_SUCCESS) return true;
+
+    vector<ChunkExtent> extents;
+
+    for (int p = 0; p < numparts; ++p)
+    {
+        exr_storage_t store;
+        rv = exr_get_storage (f, p, &store);
+        if (rv != EXR_ERR_SUCCESS) return true;
+
+        int32_t chunks;
+        rv = exr_get_chunk_count (f, p, &chunks);
+        if (rv != EXR_ERR_SUCCESS) return true;
+
+        size_t first = extents.size ();
+        bool   bad;
+
+        if (store == EXR_STORAGE_SCANLINE || store == EXR_STORAGE_DEEP_SCANLINE)
+            bad = checkCoreScanlineStructure (f, p, extents);
+        else
+            bad = checkCoreTiledStructure (f, p, extents);
+
+        if (bad || extents.size () - first != (size_t) chunks) return true;
+    }
+
+    std::sort (extents.begin (), extents.end ());
+
+    for (size_t i = 1; i < extents.size (); ++i)
+    {
+        if (extents[i].begin < extents[i - 1].end) return true;
+    }
+
+    return false;
+}
+
+bool
+runCoreStructureChecks (const char* filename)
+{
+    bool                      hadfail = false;
+    exr_result_t              rv;
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+
+    cinit.error_handler_fn = &core_error_handler_cb;
+
+    rv = exr_start_read (&f, filename, &cinit);
+    if (rv != EXR_ERR_SUCCESS) return true;
+
+    hadfail = checkCoreStructure (f);
+
+    exr_finish (&f);
+
+    return hadfail;
+}
+
+bool
+runCoreStructureChecks (const char* data, size_t numBytes)
+{
+    bool                      hadfail = false;
+    exr_result_t              rv;
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    memdata                   md;
+
+    md.data  = data;
+    md.bytes = numBytes;
+
+    cinit.user_data        = &md;
+    cinit.read_fn          = &memstream_read;
+    cinit.size_fn          = &memstream_size;
+    cinit.error_handler_fn = &core_error_handler_cb;
+
+    rv = exr_start_read (&f, "<memstream>", &cinit);
+    if (rv != EXR_ERR_SUCCESS) return true;
+
+    hadfail = checkCoreStructure (f);
+
+    exr_finish (&f);
+
+    return hadfail;
+}
+
 } // namespace
 
 bool
@@ -1637,4 +1851,16 @@ checkOpenEXRFile (
     return threw;
 }
 
+bool
+checkOpenEXRFileStructure (const char* fileName)
+{
+    return runCoreStructureChecks (fileName);
+}
+
+bool
+checkOpenEXRFileStructure (const char* data, size_t numBytes)
+{
+    return runCoreStructureChecks (data, numBytes);
+}
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
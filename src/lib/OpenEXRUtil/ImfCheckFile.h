@@ -16,7 +16,7 @@ OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 // This can be used to validate correctness of the library, when running the library
 // with a sanitizer or memory checker, as well as checking that a file is a correct OpenEXR
 //
-// returns true if the file reads correctly using expected API calls, or false
+// returns false if the file reads correctly using expected API calls, or true
 // if an exception was thrown that indicates the file is invalid
 //
 // if reduceMemory is true, will avoid tests or inputs that are known to
@@ -44,6 +44,21 @@ IMFUTIL_EXPORT bool checkOpenEXRFile (
     bool        reduceTime      = false,
     bool        enableCoreCheck = false);
 
+//
+// check only the structure of the given file, using the core library:
+// the headers, the chunk offset tables, and the header of every chunk,
+// whose data must lie within the file without overlapping other chunks.
+// No pixel data is read or uncompressed, so this is much faster than
+// checkOpenEXRFile, but it finds fewer problems.
+//
+// returns true if a problem was found, like checkOpenEXRFile
+//
+
+IMFUTIL_EXPORT bool checkOpenEXRFileStructure (const char* fileName);
+
+IMFUTIL_EXPORT bool
+checkOpenEXRFileStructure (const char* data, size_t numBytes);
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
 
 #endif
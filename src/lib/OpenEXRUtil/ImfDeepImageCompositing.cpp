@@ -0,0 +1,1089 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//----------------------------------------------------------------------------
+//
+//      Tidying and flattening of deep images
+//
+//----------------------------------------------------------------------------
+
+#include "ImfDeepImageCompositing.h"
+#include <Iex.h>
+#include <IlmThreadPool.h>
+#include <ImfThreading.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+using namespace IMATH_NAMESPACE;
+using namespace IEX_NAMESPACE;
+using namespace std;
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+namespace
+{
+
+//
+// The roles of the channels of a level.  Half and float channels are
+// processed as floats, in the order of floatNames; UINT channels are
+// only copied.
+//
+
+struct ChannelRoles
+{
+    vector<string>    floatNames;
+    vector<PixelType> floatTypes;
+    vector<string>    uintNames;
+
+    //
+    // For each float channel, the float channel it is composited with:
+    // its alpha channel, the channel itself for alpha channels, or
+    // noAlpha for Z, ZBack and channels that are not premultiplied.
+    //
+
+    vector<int> alphaOf;
+    vector<int> alphas;
+
+    int z;
+    int zBack; // -1 if the level has no ZBack channel
+    int noAlpha;
+};
+
+int
+findName (const vector<string>& names, const string& name)
+{
+    for (size_t i = 0; i < names.size (); ++i)
+        if (names[i] == name) return int (i);
+
+    return -1;
+}
+
+bool
+isAlphaName (const string& base)
+{
+    return base == "A" || base == "AR" || base == "AG" || base == "AB";
+}
+
+ChannelRoles
+channelRoles (const DeepImageLevel& level)
+{
+    ChannelRoles r;
+
+    for (DeepImageLevel::ConstIterator i = level.begin (); i != level.end ();
+         ++i)
+    {
+        PixelType type = i.channel ().pixelType ();
+
+        if (type == UINT)
+        {
+            r.uintNames.push_back (i.name ());
+        }
+        else
+        {
+            r.floatNames.push_back (i.name ());
+            r.floatTypes.push_back (type);
+        }
+    }
+
+    int n     = int (r.floatNames.size ());
+    r.noAlpha = n;
+    r.z       = findName (r.floatNames, "Z");
+    r.zBack   = findName (r.floatNames, "ZBack");
+
+    if (r.z < 0)
+    {
+        THROW (
+            ArgExc,
+            "Cannot tidy or flatten a deep image level "
+            "without a half or float Z channel.");
+    }
+
+    r.alphaOf.assign (n, n);
+
+    for (int k = 0; k < n; ++k)
+    {
+        if (k == r.z || k == r.zBack) continue;
+
+        const string& name = r.floatNames[k];
+        size_t        dot  = name.rfind ('.');
+
+        string prefix = (dot == string::npos) ? string ()
+                                              : name.substr (0, dot + 1);
+        string base   = name.substr (prefix.size ());
+        int    a      = -1;
+
+        if (isAlphaName (base))
+        {
+            a = k;
+            r.alphas.push_back (k);
+        }
+        else
+        {
+            if (base == "R" || base == "G" || base == "B")
+                a = findName (r.floatNames, prefix + "A" + base);
+
+            if (a < 0) a = findName (r.floatNames, prefix + "A");
+        }
+
+        if (a >= 0) r.alphaOf[k] = a;
+    }
+
+    return r;
+}
+
+//
+// Typed pointers to the channels of a level, in the order of the
+// channel roles.  Of halfs[k] and floats[k], the one that does not
+// match the type of float channel k is null.
+//
+
+template <class Half, class Float, class UInt> struct LevelChannels
+{
+    vector<Half*>  halfs;
+    vector<Float*> floats;
+    vector<UInt*>  uints;
+
+    template <class Level>
+    LevelChannels (Level& level, const ChannelRoles& r)
+    {
+        for (size_t k = 0; k < r.floatNames.size (); ++k)
+        {
+            halfs.push_back (
+                level.template findTypedChannel<half> (r.floatNames[k]));
+
+            floats.push_back (
+                level.template findTypedChannel<float> (r.floatNames[k]));
+        }
+
+        for (size_t k = 0; k < r.uintNames.size (); ++k)
+        {
+            uints.push_back (level.template findTypedChannel<unsigned int> (
+                r.uintNames[k]));
+        }
+    }
+};
+
+typedef LevelChannels<
+    const DeepHalfChannel,
+    const DeepFloatChannel,
+    const DeepUIntChannel>
+    DeepInputChannels;
+
+typedef LevelChannels<DeepHalfChannel, DeepFloatChannel, DeepUIntChannel>
+    DeepOutputChannels;
+
+typedef LevelChannels<FlatHalfChannel, FlatFloatChannel, FlatUIntChannel>
+    FlatOutputChannels;
+
+//
+// A PixelTidier holds the samples of one pixel, sample after sample,
+// and tidies them.  A tidier is reused for all pixels of a band of
+// scan lines, so its buffers are allocated only a few times.
+//
+
+class PixelTidier
+{
+public:
+    PixelTidier (const ChannelRoles& roles);
+
+    void load (const DeepInputChannels& in, int x, int y, size_t n);
+
+    //
+    // Sorts, splits and merges the samples; returns false if they
+    // were tidy when they were loaded.
+    //
+
+    bool tidy ();
+
+    size_t numSamples () const { return _n; }
+
+    const float* floatSample (size_t i) const
+    {
+        return _f.data () + i * _nf;
+    }
+
+    const unsigned int* uintSample (size_t i) const
+    {
+        return _u.data () + i * _nu;
+    }
+
+private:
+    struct SampleLess
+    {
+        const PixelTidier& tidier;
+
+        bool operator() (size_t a, size_t b) const
+        {
+            float za = tidier.z (a);
+            float zb = tidier.z (b);
+
+            if (za != zb) return za < zb;
+
+            return tidier.zBack (a) < tidier.zBack (b);
+        }
+    };
+
+    float z (size_t i) const { return _f[i * _nf + _r.z]; }
+
+    float zBack (size_t i) const
+    {
+        return _f[i * _nf + (_r.zBack >= 0 ? _r.zBack : _r.z)];
+    }
+
+    bool sort ();
+    void split ();
+    void merge ();
+    void appendSample (size_t i);
+    void appendPiece (size_t i, float front, float back);
+    void mergeRun (size_t i, size_t j, float out[]);
+    void swapBuffers ();
+
+    const ChannelRoles&  _r;
+    size_t               _nf;
+    size_t               _nu;
+    size_t               _n;
+    bool                 _normalized;
+    vector<float>        _f;
+    vector<unsigned int> _u;
+    vector<float>        _f2;
+    vector<unsigned int> _u2;
+    vector<size_t>       _order;
+    vector<float>        _bounds;
+    vector<double>       _ratio;
+    vector<int>          _opaque;
+};
+
+PixelTidier::PixelTidier (const ChannelRoles& roles)
+    : _r (roles)
+    , _nf (roles.floatNames.size ())
+    , _nu (roles.uintNames.size ())
+    , _n (0)
+    , _normalized (false)
+    , _ratio (_nf)
+    , _opaque (_nf)
+{
+    // empty
+}
+
+void
+PixelTidier::load (const DeepInputChannels& in, int x, int y, size_t n)
+{
+    _n = n;
+    _f.resize (n * _nf);
+    _u.resize (n * _nu);
+
+    for (size_t k = 0; k < _nf; ++k)
+    {
+        if (in.halfs[k])
+        {
+            const half* s = (*in.halfs[k]) (x, y);
+
+            for (size_t i = 0; i < n; ++i)
+                _f[i * _nf + k] = s[i];
+        }
+        else
+        {
+            const float* s = (*in.floats[k]) (x, y);
+
+            for (size_t i = 0; i < n; ++i)
+                _f[i * _nf + k] = s[i];
+        }
+    }
+
+    for (size_t k = 0; k < _nu; ++k)
+    {
+        const unsigned int* s = (*in.uints[k]) (x, y);
+
+        for (size_t i = 0; i < n; ++i)
+            _u[i * _nu + k] = s[i];
+    }
+
+    //
+    // A ZBack in front of Z means ZBack == Z.
+    //
+
+    _normalized = false;
+
+    if (_r.zBack >= 0)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            float* s = &_f[i * _nf];
+
+            if (s[_r.zBack] < s[_r.z])
+            {
+                s[_r.zBack] = s[_r.z];
+                _normalized = true;
+            }
+        }
+    }
+}
+
+bool
+PixelTidier::tidy ()
+{
+    if (_n < 2) return _normalized;
+
+    bool reordered = sort ();
+
+    //
+    // Samples with the same depths must be merged; samples that start
+    // in front of the back of an earlier sample overlap it.
+    //
+
+    bool  overlap   = false;
+    bool  duplicate = false;
+    float back      = zBack (0);
+
+    for (size_t i = 1; i < _n; ++i)
+    {
+        if (z (i) == z (i - 1) && zBack (i) == zBack (i - 1))
+            duplicate = true;
+        else if (z (i) < back)
+            overlap = true;
+
+        back = std::max (back, zBack (i));
+    }
+
+    if (overlap)
+    {
+        split ();
+        sort ();
+    }
+
+    if (overlap || duplicate) merge ();
+
+    return _normalized || reordered || overlap || duplicate;
+}
+
+bool
+PixelTidier::sort ()
+{
+    SampleLess less = {*this};
+    size_t     i    = 1;
+
+    while (i < _n && !less (i, i - 1))
+        ++i;
+
+    if (i == _n) return false;
+
+    //
+    // A stable sort keeps samples with equal depths in file order,
+    // which makes the front sample of a merged run well defined.
+    //
+
+    _order.resize (_n);
+
+    for (size_t j = 0; j < _n; ++j)
+        _order[j] = j;
+
+    std::stable_sort (_order.begin (), _order.end (), less);
+
+    _f2.clear ();
+    _u2.clear ();
+
+    for (size_t j = 0; j < _n; ++j)
+        appendSample (_order[j]);
+
+    swapBuffers ();
+    return true;
+}
+
+void
+PixelTidier::split ()
+{
+    _bounds.clear ();
+
+    for (size_t i = 0; i < _n; ++i)
+    {
+        _bounds.push_back (z (i));
+        _bounds.push_back (zBack (i));
+    }
+
+    std::sort (_bounds.begin (), _bounds.end ());
+    _bounds.erase (unique (_bounds.begin (), _bounds.end ()), _bounds.end ());
+
+    _f2.clear ();
+    _u2.clear ();
+
+    for (size_t i = 0; i < _n; ++i)
+    {
+        float front = z (i);
+        float back  = zBack (i);
+
+        vector<float>::const_iterator b =
+            upper_bound (_bounds.begin (), _bounds.end (), front);
+
+        if (b == _bounds.end () || *b >= back)
+        {
+            appendSample (i);
+            continue;
+        }
+
+        for (; b != _bounds.end () && *b < back; ++b)
+        {
+            appendPiece (i, front, *b);
+            front = *b;
+        }
+
+        appendPiece (i, front, back);
+    }
+
+    swapBuffers ();
+}
+
+void
+PixelTidier::merge ()
+{
+    _f2.clear ();
+    _u2.clear ();
+
+    size_t i = 0;
+
+    while (i < _n)
+    {
+        size_t j = i + 1;
+
+        while (j < _n && z (j) == z (i) && zBack (j) == zBack (i))
+            ++j;
+
+        appendSample (i);
+
+        if (j > i + 1) mergeRun (i, j, &_f2[_f2.size () - _nf]);
+
+        i = j;
+    }
+
+    swapBuffers ();
+}
+
+void
+PixelTidier::appendSample (size_t i)
+{
+    _f2.insert (_f2.end (), _f.begin () + i * _nf, _f.begin () + (i + 1) * _nf);
+    _u2.insert (_u2.end (), _u.begin () + i * _nu, _u.begin () + (i + 1) * _nu);
+}
+
+void
+PixelTidier::appendPiece (size_t i, float front, float back)
+{
+    appendSample (i);
+
+    float* s = &_f2[_f2.size () - _nf];
+
+    //
+    // The piece covers fraction x of the sample's depth range.  Its
+    // alpha is 1 - (1 - alpha)^x, and its premultiplied channels are
+    // scaled by the ratio of the piece's alpha to the sample's.
+    //
+
+    double x = (double (back) - front) / (double (zBack (i)) - z (i));
+
+    for (size_t j = 0; j < _r.alphas.size (); ++j)
+    {
+        int    a     = _r.alphas[j];
+        double alpha = s[a];
+
+        if (alpha >= 1)
+        {
+            _ratio[a] = 1;
+        }
+        else if (alpha <= 0)
+        {
+            _ratio[a] = x;
+            s[a]      = float (alpha * x);
+        }
+        else
+        {
+            double piece = -expm1 (x * log1p (-alpha));
+            _ratio[a]    = piece / alpha;
+            s[a]         = float (piece);
+        }
+    }
+
+    for (size_t k = 0; k < _nf; ++k)
+    {
+        int a = _r.alphaOf[k];
+
+        if (a != _r.noAlpha && a != int (k)) s[k] = float (s[k] * _ratio[a]);
+    }
+
+    s[_r.z] = front;
+    if (_r.zBack >= 0) s[_r.zBack] = back;
+}
+
+void
+PixelTidier::mergeRun (size_t i, size_t j, float out[])
+{
+    //
+    // Merged alpha is 1 - product (1 - alpha).  Merged premultiplied
+    // values are the sum of c * u / alpha, scaled by alpha / u, where
+    // u = -log (1 - alpha) is the optical depth of a sample, or, if any
+    // sample is opaque, the average of the opaque samples.
+    //
+
+    for (size_t m = 0; m < _r.alphas.size (); ++m)
+    {
+        int    a      = _r.alphas[m];
+        int    opaque = 0;
+        double u      = 0;
+
+        for (size_t s = i; s < j; ++s)
+        {
+            double alpha = _f[s * _nf + a];
+
+            if (alpha >= 1)
+                ++opaque;
+            else if (alpha > 0)
+                u -= log1p (-alpha);
+        }
+
+        _opaque[a] = opaque;
+
+        if (opaque)
+        {
+            out[a]    = 1;
+            _ratio[a] = 1.0 / opaque;
+        }
+        else
+        {
+            double alpha = -expm1 (-u);
+            out[a]       = float (alpha);
+            _ratio[a]    = (u > 0) ? alpha / u : 1;
+        }
+    }
+
+    for (size_t k = 0; k < _nf; ++k)
+    {
+        int a = _r.alphaOf[k];
+
+        if (a == _r.noAlpha || a == int (k)) continue;
+
+        double sum = 0;
+
+        for (size_t s = i; s < j; ++s)
+        {
+            double v     = _f[s * _nf + k];
+            double alpha = _f[s * _nf + a];
+
+            if (_opaque[a])
+            {
+                if (alpha >= 1) sum += v;
+            }
+            else if (alpha > 0)
+            {
+                sum += v * (-log1p (-alpha) / alpha);
+            }
+            else
+            {
+                sum += v;
+            }
+        }
+
+        out[k] = float (sum * _ratio[a]);
+    }
+}
+
+void
+PixelTidier::swapBuffers ()
+{
+    _f.swap (_f2);
+    _u.swap (_u2);
+    _n = _f.size () / _nf;
+}
+
+//
+// A BandJob processes the scan lines of a level in bands, one band per
+// task, on the global thread pool.  Errors are rethrown in band order
+// after all tasks have finished.
+//
+
+class BandJob
+{
+public:
+    BandJob (const Box2i& dataWindow, int numBands);
+    virtual ~BandJob () {}
+
+    virtual void processBand (int band, int y1, int y2) = 0;
+
+    void run ();
+
+    const Box2i& dataWindow () const { return _dataWindow; }
+    int          numBands () const { return _numBands; }
+
+    size_t pixelIndex (int x, int y) const
+    {
+        return size_t (y - _dataWindow.min.y) *
+                   size_t (_dataWindow.max.x - _dataWindow.min.x + 1) +
+               size_t (x - _dataWindow.min.x);
+    }
+
+private:
+    Box2i _dataWindow;
+    int   _numBands;
+};
+
+int
+defaultNumBands (const Box2i& dataWindow)
+{
+    return std::min (
+        dataWindow.max.y - dataWindow.min.y + 1,
+        std::max (1, globalThreadCount ()));
+}
+
+class BandTask : public Task
+{
+public:
+    BandTask (
+        TaskGroup*          group,
+        BandJob&            job,
+        int                 band,
+        int                 y1,
+        int                 y2,
+        std::exception_ptr& error)
+        : Task (group)
+        , _job (job)
+        , _band (band)
+        , _y1 (y1)
+        , _y2 (y2)
+        , _error (error)
+    {}
+
+    virtual void execute ()
+    {
+        try
+        {
+            _job.processBand (_band, _y1, _y2);
+        }
+        catch (...)
+        {
+            _error = std::current_exception ();
+        }
+    }
+
+private:
+    BandJob&            _job;
+    int                 _band;
+    int                 _y1;
+    int                 _y2;
+    std::exception_ptr& _error;
+};
+
+BandJob::BandJob (const Box2i& dataWindow, int numBands)
+    : _dataWindow (dataWindow), _numBands (numBands)
+{
+    // empty
+}
+
+void
+BandJob::run ()
+{
+    int64_t height = int64_t (_dataWindow.max.y) - _dataWindow.min.y + 1;
+
+    vector<std::exception_ptr> errors (_numBands);
+
+    {
+        TaskGroup taskGroup;
+
+        for (int b = 0; b < _numBands; ++b)
+        {
+            ThreadPool::addGlobalTask (new BandTask (
+                &taskGroup,
+                *this,
+                b,
+                int (_dataWindow.min.y + height * b / _numBands),
+                int (_dataWindow.min.y + height * (b + 1) / _numBands - 1),
+                errors[b]));
+        }
+    }
+
+    for (int b = 0; b < _numBands; ++b)
+        if (errors[b]) std::rethrow_exception (errors[b]);
+}
+
+//
+// Tidying a level takes two passes.  The first pass tidies the samples
+// of every pixel into a buffer per band and records the new sample
+// counts; the second, after the sample counts of the level have been
+// replaced, copies the buffers into the level.
+//
+
+class TidyJob : public BandJob
+{
+public:
+    struct Band
+    {
+        vector<float>        floats;
+        vector<unsigned int> uints;
+        bool                 changed;
+    };
+
+    TidyJob (const DeepImageLevel& level, const ChannelRoles& roles)
+        : BandJob (level.dataWindow (), defaultNumBands (level.dataWindow ()))
+        , _roles (roles)
+        , _in (level, roles)
+        , _sampleCounts (level.sampleCounts ())
+        , counts (level.sampleCounts ().numPixels ())
+        , bands (numBands ())
+    {}
+
+    virtual void processBand (int band, int y1, int y2);
+
+    bool changed () const
+    {
+        for (size_t b = 0; b < bands.size (); ++b)
+            if (bands[b].changed) return true;
+
+        return false;
+    }
+
+private:
+    const ChannelRoles&       _roles;
+    DeepInputChannels         _in;
+    const SampleCountChannel& _sampleCounts;
+
+public:
+    vector<unsigned int> counts;
+    vector<Band>         bands;
+};
+
+void
+TidyJob::processBand (int band, int y1, int y2)
+{
+    PixelTidier tidier (_roles);
+    Band&       out = bands[band];
+    out.changed     = false;
+
+    for (int y = y1; y <= y2; ++y)
+    {
+        for (int x = dataWindow ().min.x; x <= dataWindow ().max.x; ++x)
+        {
+            tidier.load (_in, x, y, _sampleCounts (x, y));
+
+            if (tidier.tidy ()) out.changed = true;
+
+            size_t n = tidier.numSamples ();
+
+            if (n > 0)
+            {
+                const float*        f = tidier.floatSample (0);
+                const unsigned int* u = tidier.uintSample (0);
+
+                out.floats.insert (
+                    out.floats.end (), f, f + n * _roles.floatNames.size ());
+
+                out.uints.insert (
+                    out.uints.end (), u, u + n * _roles.uintNames.size ());
+            }
+
+            counts[pixelIndex (x, y)] = static_cast<unsigned int> (n);
+        }
+    }
+}
+
+class TidyWriteJob : public BandJob
+{
+public:
+    TidyWriteJob (
+        DeepImageLevel& level, const ChannelRoles& roles, const TidyJob& tidy)
+        : BandJob (tidy.dataWindow (), tidy.numBands ())
+        , _roles (roles)
+        , _out (level, roles)
+        , _tidy (tidy)
+    {}
+
+    virtual void processBand (int band, int y1, int y2);
+
+private:
+    const ChannelRoles& _roles;
+    DeepOutputChannels  _out;
+    const TidyJob&      _tidy;
+};
+
+void
+TidyWriteJob::processBand (int band, int y1, int y2)
+{
+    const TidyJob::Band& in = _tidy.bands[band];
+    size_t               nf = _roles.floatNames.size ();
+    size_t               nu = _roles.uintNames.size ();
+    size_t               i  = 0;
+
+    for (int y = y1; y <= y2; ++y)
+    {
+        for (int x = dataWindow ().min.x; x <= dataWindow ().max.x; ++x)
+        {
+            size_t n = _tidy.counts[pixelIndex (x, y)];
+
+            const float*        f = in.floats.data () + i * nf;
+            const unsigned int* u = in.uints.data () + i * nu;
+
+            for (size_t k = 0; k < nf; ++k)
+            {
+                if (_out.halfs[k])
+                {
+                    half* s = (*_out.halfs[k]) (x, y);
+
+                    for (size_t j = 0; j < n; ++j)
+                        s[j] = f[j * nf + k];
+                }
+                else
+                {
+                    float* s = (*_out.floats[k]) (x, y);
+
+                    for (size_t j = 0; j < n; ++j)
+                        s[j] = f[j * nf + k];
+                }
+            }
+
+            for (size_t k = 0; k < nu; ++k)
+            {
+                unsigned int* s = (*_out.uints[k]) (x, y);
+
+                for (size_t j = 0; j < n; ++j)
+                    s[j] = u[j * nu + k];
+            }
+
+            i += n;
+        }
+    }
+}
+
+class FlattenJob : public BandJob
+{
+public:
+    FlattenJob (
+        const DeepImageLevel& in,
+        FlatImageLevel&       out,
+        const ChannelRoles&   roles)
+        : BandJob (in.dataWindow (), defaultNumBands (in.dataWindow ()))
+        , _roles (roles)
+        , _in (in, roles)
+        , _out (out, roles)
+        , _sampleCounts (in.sampleCounts ())
+    {}
+
+    virtual void processBand (int band, int y1, int y2);
+
+private:
+    const ChannelRoles&       _roles;
+    DeepInputChannels         _in;
+    FlatOutputChannels        _out;
+    const SampleCountChannel& _sampleCounts;
+};
+
+void
+FlattenJob::processBand (int, int y1, int y2)
+{
+    PixelTidier tidier (_roles);
+    size_t      nf = _roles.floatNames.size ();
+    size_t      nu = _roles.uintNames.size ();
+
+    //
+    // acc[noAlpha] stays 1, so that the transparency of the channels
+    // that are not composited is zero, and the compositing loops below
+    // run over all channels without branches.
+    //
+
+    vector<float> acc (nf + 1);
+    vector<float> trans (nf);
+
+    for (int y = y1; y <= y2; ++y)
+    {
+        for (int x = dataWindow ().min.x; x <= dataWindow ().max.x; ++x)
+        {
+            tidier.load (_in, x, y, _sampleCounts (x, y));
+            tidier.tidy ();
+
+            size_t n = tidier.numSamples ();
+
+            std::fill (acc.begin (), acc.end (), 0.0f);
+            acc[nf] = 1;
+
+            size_t last = 0;
+
+            for (size_t s = 0; s < n; ++s)
+            {
+                const float* v = tidier.floatSample (s);
+
+                for (size_t k = 0; k < nf; ++k)
+                    trans[k] = 1 - acc[_roles.alphaOf[k]];
+
+                for (size_t k = 0; k < nf; ++k)
+                    acc[k] += trans[k] * v[k];
+
+                last = s;
+
+                bool opaque = !_roles.alphas.empty ();
+
+                for (size_t j = 0; j < _roles.alphas.size (); ++j)
+                    if (acc[_roles.alphas[j]] < 1) opaque = false;
+
+                if (opaque) break;
+            }
+
+            if (n > 0)
+            {
+                const float* front = tidier.floatSample (0);
+
+                for (size_t k = 0; k < nf; ++k)
+                    if (_roles.alphaOf[k] == _roles.noAlpha) acc[k] = front[k];
+
+                if (_roles.zBack >= 0)
+                    acc[_roles.zBack] = tidier.floatSample (last)[_roles.zBack];
+            }
+
+            for (size_t k = 0; k < nf; ++k)
+            {
+                if (_out.halfs[k])
+                    (*_out.halfs[k]) (x, y) = acc[k];
+                else if (_out.floats[k])
+                    (*_out.floats[k]) (x, y) = acc[k];
+            }
+
+            for (size_t k = 0; k < nu; ++k)
+            {
+                if (_out.uints[k])
+                    (*_out.uints[k]) (x, y) =
+                        n > 0 ? tidier.uintSample (0)[k] : 0;
+            }
+        }
+    }
+}
+
+} // namespace
+
+void
+tidyDeepImageLevel (DeepImageLevel& level)
+{
+    ChannelRoles roles = channelRoles (level);
+
+    TidyJob tidy (level, roles);
+    tidy.run ();
+
+    if (!tidy.changed ()) return;
+
+    {
+        SampleCountChannel::Edit edit (level.sampleCounts ());
+
+        memcpy (
+            edit.sampleCounts (),
+            tidy.counts.data (),
+            tidy.counts.size () * sizeof (unsigned int));
+    }
+
+    TidyWriteJob write (level, roles, tidy);
+    write.run ();
+}
+
+void
+tidyDeepImage (DeepImage& img)
+{
+    switch (img.levelMode ())
+    {
+        case ONE_LEVEL: tidyDeepImageLevel (img.level ()); break;
+
+        case MIPMAP_LEVELS:
+
+            for (int x = 0; x < img.numLevels (); ++x)
+                tidyDeepImageLevel (img.level (x, x));
+
+            break;
+
+        case RIPMAP_LEVELS:
+
+            for (int y = 0; y < img.numYLevels (); ++y)
+                for (int x = 0; x < img.numXLevels (); ++x)
+                    tidyDeepImageLevel (img.level (x, y));
+
+            break;
+
+        default: throw ArgExc ("Unknown level mode.");
+    }
+}
+
+void
+flattenDeepImageLevel (const DeepImageLevel& in, FlatImageLevel& out)
+{
+    if (in.dataWindow () != out.dataWindow ())
+    {
+        THROW (
+            ArgExc,
+            "Cannot flatten a deep image level into a flat image level "
+            "with a different data window.");
+    }
+
+    for (DeepImageLevel::ConstIterator i = in.begin (); i != in.end (); ++i)
+    {
+        const FlatImageChannel* c = out.findChannel (i.name ());
+
+        if (!c) continue;
+
+        if (c->pixelType () != i.channel ().pixelType () ||
+            c->xSampling () != 1 || c->ySampling () != 1)
+        {
+            THROW (
+                ArgExc,
+                "Cannot flatten deep image channel \""
+                    << i.name ()
+                    << "\" into a flat image channel with a different "
+                       "pixel type or with subsampling.");
+        }
+    }
+
+    ChannelRoles roles = channelRoles (in);
+
+    FlattenJob flatten (in, out, roles);
+    flatten.run ();
+}
+
+void
+flattenDeepImage (const DeepImage& in, FlatImage& out)
+{
+    out.clearChannels ();
+    out.resize (in.dataWindow (), in.levelMode (), in.levelRoundingMode ());
+
+    const DeepImageLevel& level = in.level ();
+
+    for (DeepImageLevel::ConstIterator i = level.begin (); i != level.end ();
+         ++i)
+    {
+        out.insertChannel (
+            i.name (),
+            i.channel ().pixelType (),
+            1,
+            1,
+            i.channel ().pLinear ());
+    }
+
+    switch (in.levelMode ())
+    {
+        case ONE_LEVEL: flattenDeepImageLevel (level, out.level ()); break;
+
+        case MIPMAP_LEVELS:
+
+            for (int x = 0; x < in.numLevels (); ++x)
+                flattenDeepImageLevel (in.level (x, x), out.level (x, x));
+
+            break;
+
+        case RIPMAP_LEVELS:
+
+            for (int y = 0; y < in.numYLevels (); ++y)
+                for (int x = 0; x < in.numXLevels (); ++x)
+                    flattenDeepImageLevel (in.level (x, y), out.level (x, y));
+
+            break;
+
+        default: throw ArgExc ("Unknown level mode.");
+    }
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,103 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_DEEP_IMAGE_COMPOSITING_H
+#define INCLUDED_IMF_DEEP_IMAGE_COMPOSITING_H
+
+//----------------------------------------------------------------------------
+//
+//      Functions to tidy deep images, and to flatten deep images into
+//      flat images, as described in "Interpreting OpenEXR Deep Pixels".
+//
+//      Channel roles are derived from the channel names:
+//
+//      Z, ZBack        the front and back depth of each sample.  Z is
+//                      required; without ZBack, all samples are point
+//                      samples.  A ZBack smaller than Z is treated as
+//                      if it were equal to Z.
+//
+//      A, AR, AG, AB   alpha channels.  The alpha channels of a layer
+//                      have the same prefix as the layer's other
+//                      channels, for example, "diffuse.A".
+//
+//      R, G, B         associated with AR, AG and AB respectively, if
+//                      the layer has those; otherwise with A.
+//
+//      other           half and float channels are associated with
+//                      the layer's A channel, if it has one.  Channels
+//                      without an alpha channel, and all UINT channels,
+//                      are not premultiplied; where samples are merged
+//                      or flattened they take the value of the front
+//                      sample.
+//
+//      Levels are split into bands of scan lines that are processed in
+//      parallel on the global thread pool.
+//
+//----------------------------------------------------------------------------
+
+#include "ImfNamespace.h"
+#include "ImfUtilExport.h"
+
+#include "ImfDeepImage.h"
+#include "ImfFlatImage.h"
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+//
+// tidyDeepImage (i) or
+// tidyDeepImageLevel (l)
+//
+//      Tidies all levels of deep image i, or level l.  In each pixel,
+//      the samples are sorted by Z and ZBack, volumetric samples are
+//      split where they overlap other samples, and samples with the
+//      same Z and ZBack are merged.  Afterwards, the samples of every
+//      pixel are sorted front to back and do not overlap.
+//
+//      If the level is tidy already, its samples are not changed.
+//      An Iex::ArgExc exception is thrown if the level has no Z
+//      channel; the level is left unchanged if an exception is thrown
+//      before the new sample counts are set.
+//
+
+IMFUTIL_EXPORT
+void tidyDeepImage (DeepImage& img);
+
+IMFUTIL_EXPORT
+void tidyDeepImageLevel (DeepImageLevel& level);
+
+//
+// flattenDeepImage (i, f) or
+// flattenDeepImageLevel (l, k)
+//
+//      Composites the samples of each pixel front to back, after
+//      tidying them, without changing the deep image.
+//
+//      flattenDeepImage() resizes flat image f to the data window and
+//      level modes of deep image i, replaces its channels with ones
+//      of the same names, types and linearity as those of i, and
+//      flattens every level.
+//
+//      flattenDeepImageLevel() writes the channels of flat level k that
+//      have the same names as channels of deep level l.  The data
+//      windows must be equal, and the channels of k must have the same
+//      types as those of l, and no subsampling, or an Iex::ArgExc
+//      exception is thrown.
+//
+//      In the flat image, premultiplied channels and alpha channels
+//      hold the composited values; Z is the depth of the front sample,
+//      and ZBack the back depth of the last sample that was composited.
+//      Compositing stops once all alpha channels reach 1.  Pixels with
+//      no samples are zero in all channels.
+//
+
+IMFUTIL_EXPORT
+void flattenDeepImage (const DeepImage& in, FlatImage& out);
+
+IMFUTIL_EXPORT
+void flattenDeepImageLevel (const DeepImageLevel& in, FlatImageLevel& out);
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
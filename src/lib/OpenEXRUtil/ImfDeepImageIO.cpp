@@ -17,9 +17,11 @@
 #include <ImfDeepTiledInputFile.h>
 #include <ImfDeepTiledOutputFile.h>
 #include <ImfHeader.h>
+#include <ImfMisc.h>
 #include <ImfMultiPartInputFile.h>
 #include <ImfPartType.h>
 #include <ImfTestFile.h>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -50,8 +52,16 @@ saveDeepImage (const string& fileName, const DeepImage& img)
     saveDeepImage (fileName, hdr, img);
 }
 
-void
-loadDeepImage (const string& fileName, Header& hdr, DeepImage& img)
+namespace
+{
+
+//
+// Check that a file can be loaded as a deep image, and return true if
+// it is tiled
+//
+
+bool
+isTiledDeepFile (const string& fileName)
 {
     bool tiled, deep, multiPart;
 
@@ -95,7 +105,15 @@ loadDeepImage (const string& fileName, Header& hdr, DeepImage& img)
              isTiled (mpi.header (0).type ()));
     }
 
-    if (tiled)
+    return tiled;
+}
+
+} // namespace
+
+void
+loadDeepImage (const string& fileName, Header& hdr, DeepImage& img)
+{
+    if (isTiledDeepFile (fileName))
         loadDeepTiledImage (fileName, hdr, img);
     else
         loadDeepScanLineImage (fileName, hdr, img);
@@ -395,4 +413,323 @@ loadDeepTiledImage (const string& fileName, DeepImage& img)
     loadDeepTiledImage (fileName, hdr, img);
 }
 
+namespace
+{
+
+//
+// Helpers for packed deep images
+//
+
+Header
+packedFileHeader (
+    const Header& hdr, const PackedDeepImage& img, DataWindowSource dws)
+{
+    Header newHdr;
+
+    for (Header::ConstIterator i = hdr.begin (); i != hdr.end (); ++i)
+    {
+        if (strcmp (i.name (), "dataWindow") && strcmp (i.name (), "tiles") &&
+            strcmp (i.name (), "channels"))
+        {
+            newHdr.insert (i.name (), i.attribute ());
+        }
+    }
+
+    const Box2i& idw = img.dataWindow ();
+
+    switch (dws)
+    {
+        case USE_IMAGE_DATA_WINDOW: newHdr.dataWindow () = idw; break;
+
+        case USE_HEADER_DATA_WINDOW:
+
+        {
+            const Box2i& hdw = hdr.dataWindow ();
+
+            newHdr.dataWindow () = Box2i (
+                V2i (max (hdw.min.x, idw.min.x), max (hdw.min.y, idw.min.y)),
+                V2i (min (hdw.max.x, idw.max.x), min (hdw.max.y, idw.max.y)));
+        }
+        break;
+
+        default: throw ArgExc ("Unsupported DataWindowSource.");
+    }
+
+    //XXX TODO: as for DeepImage, ZIP_COMPRESSION cannot be used here.
+
+    newHdr.compression () = ZIPS_COMPRESSION;
+    newHdr.channels ()    = img.channels ();
+
+    return newHdr;
+}
+
+//
+// Insert the sample count slice and the channel slices of the pixels in
+// rows into a frame buffer.  The counts and the sample pointers are
+// stored in counts and pointers, which must stay alive while the frame
+// buffer is used.
+//
+
+void
+insertPackedSlices (
+    DeepFrameBuffer&       fb,
+    const PackedDeepImage& img,
+    const Box2i&           rows,
+    vector<unsigned int>&  counts,
+    vector<vector<char*>>& pointers)
+{
+    int       width     = rows.max.x - rows.min.x + 1;
+    size_t    numPixels = size_t (width) * size_t (rows.max.y - rows.min.y + 1);
+    ptrdiff_t origin = ptrdiff_t (rows.min.y) * width + rows.min.x;
+
+    counts.resize (numPixels);
+
+    for (int y = rows.min.y, i = 0; y <= rows.max.y; ++y)
+        for (int x = rows.min.x; x <= rows.max.x; ++x, ++i)
+            counts[i] = img.sampleCount (x, y);
+
+    fb.insertSampleCountSlice (Slice (
+        UINT,
+        (char*) (counts.data () - origin),
+        sizeof (unsigned int),
+        sizeof (unsigned int) * width));
+
+    const DeepSampleArena& arena = img.arena ();
+    pointers.resize (arena.numChannels ());
+
+    for (int c = 0; c < arena.numChannels (); ++c)
+    {
+        PixelType type = arena.channelType (c);
+        size_t    size = pixelTypeSize (type);
+        char*     base = const_cast<char*> (arena.samples (c));
+
+        pointers[c].resize (numPixels);
+
+        for (int y = rows.min.y, i = 0; y <= rows.max.y; ++y)
+            for (int x = rows.min.x; x <= rows.max.x; ++x, ++i)
+                pointers[c][i] = base + img.sampleOffset (x, y) * size;
+
+        fb.insert (
+            arena.channelName (c),
+            DeepSlice (
+                type,
+                (char*) (pointers[c].data () - origin),
+                sizeof (char*),
+                sizeof (char*) * width,
+                size));
+    }
+}
+
+//
+// Number of scan lines saved with one frame buffer
+//
+
+const int packedRowsPerWrite = 64;
+
+void
+savePackedScanLineImage (
+    const string& fileName, const Header& newHdr, const PackedDeepImage& img)
+{
+    DeepScanLineOutputFile out (fileName.c_str (), newHdr);
+
+    const Box2i& dw         = newHdr.dataWindow ();
+    bool         increasing = newHdr.lineOrder () != DECREASING_Y;
+
+    vector<unsigned int>  counts;
+    vector<vector<char*>> pointers;
+
+    for (int n = 0; n < dw.max.y - dw.min.y + 1; n += packedRowsPerWrite)
+    {
+        int numRows = min (packedRowsPerWrite, dw.max.y - dw.min.y + 1 - n);
+        int y0      = increasing ? dw.min.y + n : dw.max.y - n - numRows + 1;
+
+        DeepFrameBuffer fb;
+        insertPackedSlices (
+            fb,
+            img,
+            Box2i (V2i (dw.min.x, y0), V2i (dw.max.x, y0 + numRows - 1)),
+            counts,
+            pointers);
+
+        out.setFrameBuffer (fb);
+        out.writePixels (numRows);
+    }
+}
+
+void
+savePackedTiledImage (
+    const string& fileName, const Header& newHdr, const PackedDeepImage& img)
+{
+    DeepTiledOutputFile out (fileName.c_str (), newHdr);
+
+    vector<unsigned int>  counts;
+    vector<vector<char*>> pointers;
+
+    for (int ty = 0; ty < out.numYTiles (); ++ty)
+    {
+        Box2i rows = out.dataWindowForTile (0, ty);
+        rows.max.x = newHdr.dataWindow ().max.x;
+
+        DeepFrameBuffer fb;
+        insertPackedSlices (fb, img, rows, counts, pointers);
+
+        out.setFrameBuffer (fb);
+        out.writeTiles (0, out.numXTiles () - 1, ty, ty);
+    }
+}
+
+void
+insertPackedChannels (PackedDeepImage& img, const Header& hdr)
+{
+    const ChannelList& cl = hdr.channels ();
+
+    img.clearChannels ();
+    img.resize (hdr.dataWindow ());
+
+    for (ChannelList::ConstIterator i = cl.begin (); i != cl.end (); ++i)
+        img.insertChannel (i.name (), i.channel ().type, i.channel ().pLinear);
+}
+
+void
+loadPackedTiledImage (const string& fileName, Header& hdr, PackedDeepImage& img)
+{
+    DeepTiledInputFile in (fileName.c_str ());
+
+    if (in.header ().tileDescription ().mode != ONE_LEVEL)
+    {
+        THROW (
+            ArgExc,
+            "Cannot load image file "
+                << fileName
+                << " as a packed deep image.  "
+                   "Multi-resolution files are not supported.");
+    }
+
+    insertPackedChannels (img, in.header ());
+
+    //
+    // Read all the sample counts, allocate the samples, and then read
+    // one row of tiles at a time.
+    //
+
+    const Box2i& dw    = in.header ().dataWindow ();
+    int          width = dw.max.x - dw.min.x + 1;
+
+    vector<unsigned int> allCounts (
+        size_t (width) * size_t (dw.max.y - dw.min.y + 1));
+
+    in.readPixelSampleCounts (
+        Slice (
+            UINT,
+            (char*) (allCounts.data () -
+                     (ptrdiff_t (dw.min.y) * width + dw.min.x)),
+            sizeof (unsigned int),
+            sizeof (unsigned int) * width),
+        0,
+        in.numXTiles () - 1,
+        0,
+        in.numYTiles () - 1,
+        0,
+        0);
+
+    img.arena ().resize (dw, allCounts.data ());
+
+    vector<unsigned int>  counts;
+    vector<vector<char*>> pointers;
+
+    for (int ty = 0; ty < in.numYTiles (); ++ty)
+    {
+        Box2i rows = in.dataWindowForTile (0, ty);
+        rows.max.x = dw.max.x;
+
+        DeepFrameBuffer fb;
+        insertPackedSlices (fb, img, rows, counts, pointers);
+
+        in.setFrameBuffer (fb);
+        in.readTiles (0, in.numXTiles () - 1, ty, ty);
+    }
+
+    for (Header::ConstIterator i = in.header ().begin ();
+         i != in.header ().end ();
+         ++i)
+    {
+        hdr.insert (i.name (), i.attribute ());
+    }
+}
+
+void
+loadPackedScanLineImage (
+    const string& fileName, Header& hdr, PackedDeepImage& img)
+{
+    DeepScanLineInputFile in (fileName.c_str ());
+
+    insertPackedChannels (img, in.header ());
+
+    //
+    // The samples are read directly into the arrays of the image
+    //
+
+    in.readPixels (
+        img.arena (),
+        in.header ().dataWindow ().min.y,
+        in.header ().dataWindow ().max.y);
+
+    for (Header::ConstIterator i = in.header ().begin ();
+         i != in.header ().end ();
+         ++i)
+    {
+        if (strcmp (i.name (), "tiles")) hdr.insert (i.name (), i.attribute ());
+    }
+}
+
+} // namespace
+
+void
+saveDeepImage (
+    const string&          fileName,
+    const Header&          hdr,
+    const PackedDeepImage& img,
+    DataWindowSource       dws)
+{
+    Header newHdr = packedFileHeader (hdr, img, dws);
+
+    if (hdr.hasTileDescription ())
+    {
+        newHdr.setTileDescription (TileDescription (
+            hdr.tileDescription ().xSize,
+            hdr.tileDescription ().ySize,
+            ONE_LEVEL));
+
+        savePackedTiledImage (fileName, newHdr, img);
+    }
+    else
+    {
+        savePackedScanLineImage (fileName, newHdr, img);
+    }
+}
+
+void
+saveDeepImage (const string& fileName, const PackedDeepImage& img)
+{
+    Header hdr;
+    hdr.displayWindow () = img.dataWindow ();
+    saveDeepImage (fileName, hdr, img);
+}
+
+void
+loadDeepImage (const string& fileName, Header& hdr, PackedDeepImage& img)
+{
+    if (isTiledDeepFile (fileName))
+        loadPackedTiledImage (fileName, hdr, img);
+    else
+        loadPackedScanLineImage (fileName, hdr, img);
+}
+
+void
+loadDeepImage (const string& fileName, PackedDeepImage& img)
+{
+    Header hdr;
+    loadDeepImage (fileName, hdr, img);
+}
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -18,6 +18,7 @@
 
 #include "ImfDeepImage.h"
 #include "ImfImageDataWindow.h"
+#include "ImfPackedDeepImage.h"
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
@@ -67,6 +68,48 @@ void loadDeepImage (const std::string& fileName, Header& hdr, DeepImage& img);
 IMFUTIL_EXPORT
 void loadDeepImage (const std::string& fileName, DeepImage& img);
 
+//
+// saveDeepImage (n, h, i, d) or
+// saveDeepImage (n, i)
+//
+//      Saves packed deep image i in an OpenEXR file with name n.  The
+//      file will be tiled, with one level, if a header, h, is given and
+//      contains a tile description attribute; otherwise the file will be
+//      scan-line based.  Header h and data window source flag d are used
+//      as for a DeepImage.
+//
+//      Sample pointers into the arrays of i are created for a few scan
+//      lines or one row of tiles at a time.
+//
+
+IMFUTIL_EXPORT
+void saveDeepImage (
+    const std::string&     fileName,
+    const Header&          hdr,
+    const PackedDeepImage& img,
+    DataWindowSource       dws = USE_IMAGE_DATA_WINDOW);
+
+IMFUTIL_EXPORT
+void saveDeepImage (const std::string& fileName, const PackedDeepImage& img);
+
+//
+// loadDeepImage (n, h, i) or
+// loadDeepImage (n, i)
+//
+//      Loads packed deep image i from the OpenEXR file with name n, which
+//      must be scan-line based, or tiled with one level.  Scan-line files
+//      are read directly into the sample arrays of i.
+//
+//      If header h is given, then the header of the file is copied into h.
+//
+
+IMFUTIL_EXPORT
+void
+loadDeepImage (const std::string& fileName, Header& hdr, PackedDeepImage& img);
+
+IMFUTIL_EXPORT
+void loadDeepImage (const std::string& fileName, PackedDeepImage& img);
+
 //
 // saveDeepScanLineImage (n, h, i, d) or
 // saveDeepScanLineImage (n, i)
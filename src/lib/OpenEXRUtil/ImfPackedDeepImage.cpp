@@ -0,0 +1,316 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//----------------------------------------------------------------------------
+//
+//      class PackedDeepImage
+//
+//----------------------------------------------------------------------------
+
+#include "ImfPackedDeepImage.h"
+#include <Iex.h>
+#include <ImfMisc.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace IMATH_NAMESPACE;
+using namespace IEX_NAMESPACE;
+using namespace std;
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+namespace
+{
+
+size_t
+numPixels (const Box2i& dataWindow)
+{
+    if (dataWindow.isEmpty ()) return 0;
+
+    return size_t (dataWindow.max.x - dataWindow.min.x + 1) *
+           size_t (dataWindow.max.y - dataWindow.min.y + 1);
+}
+
+} // namespace
+
+PackedDeepImage::PackedDeepImage () : _editing (false)
+{
+    // empty
+}
+
+PackedDeepImage::PackedDeepImage (const Box2i& dataWindow) : _editing (false)
+{
+    resize (dataWindow);
+}
+
+PackedDeepImage::~PackedDeepImage ()
+{
+    // empty
+}
+
+PackedDeepImage::PackedDeepImage (PackedDeepImage&& other) = default;
+
+PackedDeepImage&
+PackedDeepImage::operator= (PackedDeepImage&& other) = default;
+
+const Box2i&
+PackedDeepImage::dataWindow () const
+{
+    return _dataWindow;
+}
+
+void
+PackedDeepImage::resize (const Box2i& dataWindow)
+{
+    checkNotEditing ("resize");
+
+    vector<unsigned int> counts (numPixels (dataWindow), 0);
+
+    _arena.resize (dataWindow, counts.data ());
+    _dataWindow = dataWindow;
+}
+
+void
+PackedDeepImage::insertChannel (
+    const string& name, PixelType type, bool pLinear)
+{
+    checkNotEditing ("insert a channel");
+
+    _arena.insert (name, type);
+    _channels.insert (name, Channel (type, 1, 1, pLinear));
+
+    if (_arena.totalSamples () > 0)
+    {
+        memset (
+            _arena.samples (_arena.findChannel (name)),
+            0,
+            _arena.totalSamples () * pixelTypeSize (type));
+    }
+}
+
+void
+PackedDeepImage::eraseChannel (const string& name)
+{
+    checkNotEditing ("erase a channel");
+
+    _arena.erase (name);
+
+    ChannelList channels;
+
+    for (ChannelList::ConstIterator i = _channels.begin ();
+         i != _channels.end ();
+         ++i)
+    {
+        if (name != i.name ()) channels.insert (i.name (), i.channel ());
+    }
+
+    _channels = channels;
+}
+
+void
+PackedDeepImage::clearChannels ()
+{
+    checkNotEditing ("clear the channels");
+
+    for (ChannelList::ConstIterator i = _channels.begin ();
+         i != _channels.end ();
+         ++i)
+    {
+        _arena.erase (i.name ());
+    }
+
+    _channels = ChannelList ();
+}
+
+const ChannelList&
+PackedDeepImage::channels () const
+{
+    return _channels;
+}
+
+uint64_t
+PackedDeepImage::totalSamples () const
+{
+    return _arena.totalSamples ();
+}
+
+uint64_t
+PackedDeepImage::sampleOffset (int x, int y) const
+{
+    return _arena.sampleOffset (x, y);
+}
+
+unsigned int
+PackedDeepImage::sampleCount (int x, int y) const
+{
+    return _arena.sampleCount (x, y);
+}
+
+const uint64_t*
+PackedDeepImage::sampleOffsets () const
+{
+    return _arena.sampleOffsets ();
+}
+
+unsigned int*
+PackedDeepImage::beginEdit ()
+{
+    checkNotEditing ("begin an edit");
+
+    size_t          n       = numPixels (_dataWindow);
+    const uint64_t* offsets = _arena.sampleOffsets ();
+
+    _editCounts.resize (n);
+
+    for (size_t i = 0; i < n; ++i)
+        _editCounts[i] = unsigned (offsets[i + 1] - offsets[i]);
+
+    _editing = true;
+    return _editCounts.data ();
+}
+
+void
+PackedDeepImage::endEdit ()
+{
+    if (!_editing) throw ArgExc ("No sample count edit to end.");
+
+    //
+    // Nothing is changed until the new arena has been filled, so if
+    // an allocation fails, the image is still being edited.
+    //
+
+    DeepSampleArena newArena;
+
+    for (int c = 0; c < _arena.numChannels (); ++c)
+        newArena.insert (_arena.channelName (c), _arena.channelType (c));
+
+    newArena.resize (_dataWindow, _editCounts.data ());
+
+    //
+    // Copy the samples in runs of pixels whose counts did not
+    // change; those are contiguous in both arrays.
+    //
+
+    const uint64_t* oldOffsets = _arena.sampleOffsets ();
+    const uint64_t* newOffsets = newArena.sampleOffsets ();
+    size_t          n          = _editCounts.size ();
+
+    for (int c = 0; c < _arena.numChannels (); ++c)
+    {
+        size_t      size = pixelTypeSize (_arena.channelType (c));
+        const char* in   = _arena.samples (c);
+        char*       out  = newArena.samples (c);
+        size_t      i    = 0;
+
+        while (i < n)
+        {
+            size_t j = i;
+
+            while (j < n && oldOffsets[j + 1] - oldOffsets[j] ==
+                                newOffsets[j + 1] - newOffsets[j])
+            {
+                ++j;
+            }
+
+            if (j > i)
+            {
+                memcpy (
+                    out + newOffsets[i] * size,
+                    in + oldOffsets[i] * size,
+                    (newOffsets[j] - newOffsets[i]) * size);
+
+                i = j;
+                continue;
+            }
+
+            uint64_t oldCount = oldOffsets[i + 1] - oldOffsets[i];
+            uint64_t newCount = newOffsets[i + 1] - newOffsets[i];
+            uint64_t kept     = min (oldCount, newCount);
+
+            memcpy (
+                out + newOffsets[i] * size,
+                in + oldOffsets[i] * size,
+                kept * size);
+
+            memset (
+                out + (newOffsets[i] + kept) * size,
+                0,
+                (newCount - kept) * size);
+
+            ++i;
+        }
+    }
+
+    _arena = std::move (newArena);
+    _editCounts.clear ();
+    _editing = false;
+}
+
+void
+PackedDeepImage::cancelEdit ()
+{
+    if (!_editing) throw ArgExc ("No sample count edit to cancel.");
+
+    _editing = false;
+    _editCounts.clear ();
+}
+
+DeepSampleArena&
+PackedDeepImage::arena ()
+{
+    return _arena;
+}
+
+const DeepSampleArena&
+PackedDeepImage::arena () const
+{
+    return _arena;
+}
+
+char*
+PackedDeepImage::channelSamples (const string& name, PixelType type)
+{
+    const PackedDeepImage* self = this;
+    return const_cast<char*> (self->channelSamples (name, type));
+}
+
+const char*
+PackedDeepImage::channelSamples (const string& name, PixelType type) const
+{
+    const Channel* channel = _channels.findChannel (name);
+
+    if (!channel)
+    {
+        THROW (
+            ArgExc,
+            "Cannot access samples of image channel \""
+                << name << "\".  No such channel.");
+    }
+
+    if (channel->type != type)
+    {
+        THROW (
+            ArgExc,
+            "Cannot access samples of image channel \""
+                << name << "\" with the wrong pixel type.");
+    }
+
+    return _arena.samples (_arena.findChannel (name));
+}
+
+void
+PackedDeepImage::checkNotEditing (const char* operation) const
+{
+    if (_editing)
+    {
+        THROW (
+            ArgExc,
+            "Cannot " << operation
+                      << " while the sample counts of a deep image "
+                         "are being edited.");
+    }
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,275 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_PACKED_DEEP_IMAGE_H
+#define INCLUDED_IMF_PACKED_DEEP_IMAGE_H
+
+//----------------------------------------------------------------------------
+//
+//      class PackedDeepImage
+//
+//      A single-level deep image whose samples are stored in one
+//      contiguous array per channel.  The samples of each pixel follow
+//      those of the pixel before it in scan line order, and a table of
+//      offsets, one per pixel, locates them:
+//
+//          the samples of pixel (x, y) in channel c are the elements
+//
+//          samples<T>(c)[sampleOffset (x, y) + i],
+//          0 <= i < sampleCount (x, y)
+//
+//      Unlike a DeepImage, a PackedDeepImage keeps no per-pixel sample
+//      pointers, and its samples are never fragmented: changing sample
+//      counts is done in bulk, with an edit transaction that moves the
+//      samples of all pixels into new arrays at once.
+//
+//      The storage is a DeepSampleArena, so loadDeepImage() reads
+//      scan-line files directly into it.
+//
+//----------------------------------------------------------------------------
+
+#include "ImfNamespace.h"
+#include "ImfUtilExport.h"
+
+#include "ImfChannelList.h"
+#include "ImfDeepSampleArena.h"
+
+#include <ImathBox.h>
+#include <half.h>
+
+#include <string>
+#include <vector>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+class IMFUTIL_EXPORT_TYPE PackedDeepImage
+{
+public:
+    //
+    // Constructors and destructor.  The default constructor constructs
+    // an image with an empty data window.  All pixels of a new image
+    // have no samples.  Images can be moved but not copied.
+    //
+
+    IMFUTIL_EXPORT PackedDeepImage ();
+    IMFUTIL_EXPORT PackedDeepImage (const IMATH_NAMESPACE::Box2i& dataWindow);
+    IMFUTIL_EXPORT ~PackedDeepImage ();
+
+    IMFUTIL_EXPORT PackedDeepImage (PackedDeepImage&& other);
+    IMFUTIL_EXPORT PackedDeepImage& operator= (PackedDeepImage&& other);
+
+    PackedDeepImage (const PackedDeepImage& other) = delete;
+    PackedDeepImage& operator= (const PackedDeepImage& other) = delete;
+
+    //
+    // The data window of the image.  resize() changes the data window,
+    // and removes all samples; the channels are kept.
+    //
+
+    IMFUTIL_EXPORT const IMATH_NAMESPACE::Box2i& dataWindow () const;
+    IMFUTIL_EXPORT void resize (const IMATH_NAMESPACE::Box2i& dataWindow);
+
+    //
+    // Channels:
+    //
+    // insertChannel(n,t,l) adds a channel with name n, pixel type t,
+    // and perceptual linearity l.  The samples of the new channel are
+    // zero.  If a channel with name n exists already, it is replaced.
+    // Deep channels are not subsampled.
+    //
+    // eraseChannel(n) removes channel n; clearChannels() removes all
+    // channels.
+    //
+
+    IMFUTIL_EXPORT
+    void insertChannel (
+        const std::string& name, PixelType type, bool pLinear = false);
+
+    IMFUTIL_EXPORT void eraseChannel (const std::string& name);
+    IMFUTIL_EXPORT void clearChannels ();
+
+    IMFUTIL_EXPORT const ChannelList& channels () const;
+
+    //
+    // Sample layout: sampleOffset(x,y) and sampleCount(x,y) are not
+    // bounds checked.  sampleOffsets() has one entry per pixel in the
+    // data window, in scan line order, plus one for the end of the
+    // last pixel.
+    //
+
+    IMFUTIL_EXPORT uint64_t totalSamples () const;
+
+    IMFUTIL_EXPORT uint64_t     sampleOffset (int x, int y) const;
+    IMFUTIL_EXPORT unsigned int sampleCount (int x, int y) const;
+
+    IMFUTIL_EXPORT const uint64_t* sampleOffsets () const;
+
+    //
+    // The samples of channel n, all pixels, in native byte order.  T
+    // must be half, float or unsigned int, and match the pixel type of
+    // the channel.  If the image has no channel n, or if the types do
+    // not match, an Iex::ArgExc exception is thrown.
+    //
+
+    template <class T> T*       samples (const std::string& name);
+    template <class T> const T* samples (const std::string& name) const;
+
+    //
+    // Bulk editing of the sample counts:
+    //
+    //  beginEdit()     returns a pointer to an array with the sample
+    //                  counts of all pixels in the data window, in scan
+    //                  line order.  The application can change any of
+    //                  the counts, or fill the array from scratch.  The
+    //                  samples remain accessible, and unchanged, until
+    //                  the edit ends.
+    //
+    //  endEdit()       moves the samples into new arrays laid out for
+    //                  the new counts, one allocation per channel.  In
+    //                  each pixel, the first min (old, new) samples are
+    //                  kept, and new samples are set to zero.  If the
+    //                  allocation fails, endEdit() throws, and the
+    //                  image is unchanged and still being edited.
+    //
+    //  cancelEdit()    ends the edit without changing the image.
+    //
+    // An Edit object calls beginEdit() when it is constructed.  Its
+    // commit() function calls endEdit().  An edit that has not been
+    // committed when the Edit object is destroyed, for example because
+    // an exception is thrown, is cancelled.
+    //
+
+    IMFUTIL_EXPORT unsigned int* beginEdit ();
+    IMFUTIL_EXPORT void          endEdit ();
+    IMFUTIL_EXPORT void          cancelEdit ();
+
+    class Edit
+    {
+    public:
+        IMFUTIL_EXPORT Edit (PackedDeepImage& image);
+        IMFUTIL_EXPORT ~Edit () noexcept;
+
+        Edit (const Edit& other) = delete;
+        Edit& operator= (const Edit& other) = delete;
+        Edit (Edit&& other)                 = delete;
+        Edit& operator= (Edit&& other) = delete;
+
+        IMFUTIL_EXPORT unsigned int* sampleCounts () const;
+        IMFUTIL_EXPORT void          commit ();
+        IMFUTIL_EXPORT void          cancel ();
+
+    private:
+        PackedDeepImage& _image;
+        unsigned int*    _sampleCounts;
+        bool             _active;
+    };
+
+    //
+    // Direct access to the storage, for file I/O.  The window of the
+    // arena is the data window of the image, and the arena has one
+    // channel of the same name and type for each image channel.
+    //
+
+    IMFUTIL_EXPORT DeepSampleArena&       arena ();
+    IMFUTIL_EXPORT const DeepSampleArena& arena () const;
+
+private:
+    IMFUTIL_EXPORT char*
+    channelSamples (const std::string& name, PixelType type);
+    IMFUTIL_EXPORT const char*
+    channelSamples (const std::string& name, PixelType type) const;
+
+    IMFUTIL_HIDDEN void checkNotEditing (const char* operation) const;
+
+    IMATH_NAMESPACE::Box2i    _dataWindow;
+    ChannelList               _channels;
+    DeepSampleArena           _arena;
+    std::vector<unsigned int> _editCounts;
+    bool                      _editing;
+};
+
+//-----------------------------------------------------------------------------
+// Implementation of templates and inline functions
+//-----------------------------------------------------------------------------
+
+template <class T> struct PackedDeepPixelType;
+
+template <> struct PackedDeepPixelType<half>
+{
+    static const PixelType type = HALF;
+};
+
+template <> struct PackedDeepPixelType<float>
+{
+    static const PixelType type = FLOAT;
+};
+
+template <> struct PackedDeepPixelType<unsigned int>
+{
+    static const PixelType type = UINT;
+};
+
+template <class T>
+inline T*
+PackedDeepImage::samples (const std::string& name)
+{
+    return reinterpret_cast<T*> (
+        channelSamples (name, PackedDeepPixelType<T>::type));
+}
+
+template <class T>
+inline const T*
+PackedDeepImage::samples (const std::string& name) const
+{
+    return reinterpret_cast<const T*> (
+        channelSamples (name, PackedDeepPixelType<T>::type));
+}
+
+inline PackedDeepImage::Edit::Edit (PackedDeepImage& image)
+    : _image (image), _sampleCounts (image.beginEdit ()), _active (true)
+{
+    // empty
+}
+
+inline PackedDeepImage::Edit::~Edit () noexcept
+{
+    if (_active)
+    {
+        try
+        {
+            _image.cancelEdit ();
+        }
+        catch (...)
+        {
+            //
+            // The edit was already ended through the image
+            //
+        }
+    }
+}
+
+inline unsigned int*
+PackedDeepImage::Edit::sampleCounts () const
+{
+    return _sampleCounts;
+}
+
+inline void
+PackedDeepImage::Edit::commit ()
+{
+    if (_active) _image.endEdit ();
+    _active = false;
+}
+
+inline void
+PackedDeepImage::Edit::cancel ()
+{
+    if (_active) _image.cancelEdit ();
+    _active = false;
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
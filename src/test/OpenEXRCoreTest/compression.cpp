@@ -18,6 +18,7 @@
 #include <ImathRandom.h>
 #include <ImfArray.h>
 #include <ImfChannelList.h>
+#include <ImfCompression.h>
 #include <ImfCompressor.h>
 #include <ImfFrameBuffer.h>
 #include <ImfHeader.h>
@@ -508,6 +509,21 @@ struct pixels
                 }
             }
         }
+        else if (comp == EXR_COMPRESSION_DWAA || comp == EXR_COMPRESSION_DWAB)
+        {
+            // only R, G, B are lossy by the default channel rules,
+            // H is unknown and A is RLE'd so are exact
+            for (int y = 0; y < _h; ++y)
+            {
+                for (int x = 0; x < _w; ++x)
+                {
+                    size_t idx = y * _stride_x + x;
+                    compareExact (o.h[idx], h[idx], x, y, otag, selftag, "H");
+                    compareExact (
+                        o.rgba[3][idx], rgba[3][idx], x, y, otag, selftag, "A");
+                }
+            }
+        }
         else if (comp == EXR_COMPRESSION_PXR24)
         {
             for (int y = 0; y < _h; ++y)
@@ -1134,7 +1150,8 @@ doWriteRead (
     int                xs,
     int                ys,
     exr_compression_t  comp,
-    const char*        pattern)
+    const char*        pattern,
+    int                readBackend = -1)
 {
     exr_context_t             f;
     int                       partidx;
@@ -1225,6 +1242,13 @@ doWriteRead (
         EXRCORE_TEST_FAIL (saveCPP);
     }
 
+    /* read back with a different deflate library than was written */
+    if (readBackend >= 0)
+    {
+        exr_set_default_deflate_backend ((exr_deflate_backend_t) readBackend);
+        setDefaultDeflateBackend ((DeflateBackend) readBackend);
+    }
+
     pixels restore    = p;
     pixels cpprestore = p;
     pixels cpploadc   = p;
@@ -1354,9 +1378,14 @@ testHUF (const std::string& tempdir)
 {
     uint64_t esize = internal_exr_huf_compress_spare_bytes ();
     uint64_t dsize = internal_exr_huf_decompress_spare_bytes ();
-    EXRCORE_TEST (esize == 65537 * (8 + 8 + sizeof (uint64_t*) + 4));
+    EXRCORE_TEST (esize == 65537 * (8 + 8 + 8));
+    // freq, then the table driven decoder, which is larger than the
+    // (1 << 14) entry hdec table: ljBase, ljOffset, a (1 << 12) entry
+    // table, maxCodeLength, numSymbols, idToSymbol, padded to 8 bytes
     EXRCORE_TEST (
-        dsize == (65537 * 8 + (1 << 14) * (sizeof (uint32_t*) + 4 + 4)));
+        dsize ==
+        (65537 * 8 +
+         ((64 * 8 * 2 + (1 << 12) * 4 + 4 + 4 + 65537 * 4 + 7) & ~7)));
 
     std::vector<uint8_t> hspare;
 
@@ -1475,6 +1504,164 @@ testHUF (const std::string& tempdir)
     }
 }
 
+static void
+hufRoundTrip (const std::vector<uint16_t>& raw)
+{
+    uint64_t              esize = internal_exr_huf_compress_spare_bytes ();
+    uint64_t              dsize = internal_exr_huf_decompress_spare_bytes ();
+    std::vector<uint8_t>  hspare (std::max (esize, dsize));
+    std::vector<uint8_t>  encoded (raw.size () * 3 + 65536);
+    std::vector<uint8_t>  cppencoded (encoded.size ());
+    std::vector<uint16_t> decoded (raw.size () + 1, 0xdead);
+    uint64_t              ebytes;
+
+    EXRCORE_TEST_RVAL (internal_huf_compress (
+        &ebytes,
+        encoded.data (),
+        encoded.size (),
+        raw.data (),
+        raw.size (),
+        hspare.data (),
+        esize));
+
+    uint64_t cppebytes =
+        hufCompress (raw.data (), (int) raw.size (), (char*) &cppencoded[0]);
+    EXRCORE_TEST (ebytes == cppebytes);
+    EXRCORE_TEST (memcmp (encoded.data (), cppencoded.data (), ebytes) == 0);
+
+    EXRCORE_TEST_RVAL (internal_huf_decompress (
+        encoded.data (),
+        ebytes,
+        decoded.data (),
+        raw.size (),
+        hspare.data (),
+        dsize));
+    for (size_t i = 0; i < raw.size (); ++i)
+        EXRCORE_TEST (decoded[i] == raw[i]);
+    // must not write past the expected size
+    EXRCORE_TEST (decoded[raw.size ()] == 0xdead);
+
+    hufUncompress (
+        (const char*) encoded.data (),
+        (int) ebytes,
+        decoded.data (),
+        (int) raw.size ());
+    for (size_t i = 0; i < raw.size (); ++i)
+        EXRCORE_TEST (decoded[i] == raw[i]);
+
+    // damaged streams must fail cleanly, or at worst decode garbage
+    encoded.resize (ebytes);
+    if (ebytes > 20)
+    {
+        EXRCORE_TEST (
+            internal_huf_decompress (
+                encoded.data (),
+                ebytes - 1,
+                decoded.data (),
+                raw.size (),
+                hspare.data (),
+                dsize) != EXR_ERR_SUCCESS);
+
+        std::vector<uint8_t> damaged = encoded;
+        uint32_t             nBits   = (uint32_t) damaged[12] |
+                           ((uint32_t) damaged[13] << 8) |
+                           ((uint32_t) damaged[14] << 16) |
+                           ((uint32_t) damaged[15] << 24);
+        nBits += 1;
+        damaged[12] = (uint8_t) (nBits);
+        damaged[13] = (uint8_t) (nBits >> 8);
+        damaged[14] = (uint8_t) (nBits >> 16);
+        damaged[15] = (uint8_t) (nBits >> 24);
+        EXRCORE_TEST (
+            internal_huf_decompress (
+                damaged.data (),
+                ebytes,
+                decoded.data (),
+                raw.size (),
+                hspare.data (),
+                dsize) != EXR_ERR_SUCCESS);
+
+        EXRCORE_TEST (
+            internal_huf_decompress (
+                encoded.data (),
+                ebytes,
+                decoded.data (),
+                raw.size () - 1,
+                hspare.data (),
+                dsize) != EXR_ERR_SUCCESS);
+
+        Rand48 r (raw.size ());
+        for (int i = 0; i < 64; ++i)
+        {
+            damaged = encoded;
+            size_t pos =
+                20 + (size_t) (r.nexti () % (uint64_t) (ebytes - 20));
+            damaged[pos] ^= (uint8_t) (1 + r.nexti () % 255);
+            (void) internal_huf_decompress (
+                damaged.data (),
+                ebytes,
+                decoded.data (),
+                raw.size (),
+                hspare.data (),
+                dsize);
+        }
+    }
+}
+
+void
+testHUFDecoding (const std::string& tempdir)
+{
+    std::vector<uint16_t> raw;
+
+    // tiny inputs
+    raw.assign (1, 42);
+    hufRoundTrip (raw);
+    raw.assign ({1, 65535});
+    hufRoundTrip (raw);
+    raw.assign (3, 0xffff);
+    hufRoundTrip (raw);
+
+    // fibonacci frequencies give codes well past the table lookup width
+    raw.clear ();
+    {
+        uint64_t a = 1, b = 1;
+        for (uint16_t s = 0; s < 26; ++s)
+        {
+            for (uint64_t i = 0; i < a; ++i)
+                raw.push_back ((uint16_t) (s * 2503));
+            uint64_t t = a + b;
+            a          = b;
+            b          = t;
+        }
+        Rand48 r (7);
+        for (size_t i = raw.size (); i > 1; --i)
+            std::swap (raw[i - 1], raw[r.nexti () % i]);
+    }
+    hufRoundTrip (raw);
+
+    // long runs mixed with noise, and runs at the very start and end
+    raw.clear ();
+    {
+        Rand48 r (11);
+        while (raw.size () < 200000)
+        {
+            uint16_t v   = (uint16_t) (r.nexti () & 0xfff);
+            size_t   run = (r.nexti () & 3) == 0 ? (r.nexti () % 1000) : 1;
+            raw.insert (raw.end (), run, v);
+        }
+    }
+    hufRoundTrip (raw);
+
+    // every symbol, uniformly
+    raw.resize (65536 * 3);
+    {
+        Rand48 r (13);
+        for (size_t i = 0; i < raw.size (); ++i)
+            raw[i] = (uint16_t) r.nexti ();
+    }
+    hufRoundTrip (raw);
+}
+
 ////////////////////////////////////////
 
 void
@@ -1528,13 +1715,13 @@ testB44ACompression (const std::string& tempdir)
 void
 testDWAACompression (const std::string& tempdir)
 {
-    //testComp (tempdir, EXR_COMPRESSION_DWAA);
+    testComp (tempdir, EXR_COMPRESSION_DWAA);
 }
 
 void
 testDWABCompression (const std::string& tempdir)
 {
-    //testComp (tempdir, EXR_COMPRESSION_DWAB);
+    testComp (tempdir, EXR_COMPRESSION_DWAB);
 }
 
 void
@@ -1548,3 +1735,75 @@ testDeepZIPCompression (const std::string& tempdir)
 void
 testDeepZIPSCompression (const std::string& tempdir)
 {}
+
+void
+testDeflateBackends (const std::string& tempdir)
+{
+    const exr_compression_t comps[] = {
+        EXR_COMPRESSION_ZIPS,
+        EXR_COMPRESSION_ZIP,
+        EXR_COMPRESSION_PXR24,
+        EXR_COMPRESSION_DWAA};
+    exr_deflate_backend_t orig, cur;
+    DeflateBackend        origcpp = defaultDeflateBackend ();
+    std::vector<int>      backends;
+    pixels                p{IMG_WIDTH, IMG_HEIGHT, IMG_STRIDE_X};
+
+    exr_get_default_deflate_backend (&orig);
+    EXRCORE_TEST ((int) orig == (int) origcpp);
+
+    /* zlib is always there, libdeflate only when built with it, in
+     * which case both libraries should agree */
+    exr_set_default_deflate_backend (EXR_DEFLATE_BACKEND_ZLIB);
+    exr_get_default_deflate_backend (&cur);
+    EXRCORE_TEST (cur == EXR_DEFLATE_BACKEND_ZLIB);
+    backends.push_back (EXR_DEFLATE_BACKEND_ZLIB);
+
+    exr_set_default_deflate_backend (EXR_DEFLATE_BACKEND_LIBDEFLATE);
+    setDefaultDeflateBackend (LIBDEFLATE_DEFLATE_BACKEND);
+    exr_get_default_deflate_backend (&cur);
+    EXRCORE_TEST ((int) cur == (int) defaultDeflateBackend ());
+    if (cur == EXR_DEFLATE_BACKEND_LIBDEFLATE)
+        backends.push_back (EXR_DEFLATE_BACKEND_LIBDEFLATE);
+    else
+        EXRCORE_TEST (cur == EXR_DEFLATE_BACKEND_ZLIB);
+
+    std::cout << "  " << backends.size () << " deflate backend(s)"
+              << std::endl;
+
+    std::string filename = tempdir + std::string ("imf_test_deflate.exr");
+    std::string cppfilename =
+        tempdir + std::string ("imf_test_deflate_cpp.exr");
+
+    p.fillRandom ();
+    for (exr_compression_t comp: comps)
+    {
+        for (int wr: backends)
+        {
+            for (int rd: backends)
+            {
+                std::cout << "  write backend " << wr << " read backend "
+                          << rd << std::endl;
+                for (int tiled = 0; tiled < 2; ++tiled)
+                {
+                    exr_set_default_deflate_backend (
+                        (exr_deflate_backend_t) wr);
+                    setDefaultDeflateBackend ((DeflateBackend) wr);
+                    doWriteRead (
+                        p,
+                        filename,
+                        cppfilename,
+                        tiled != 0,
+                        1,
+                        1,
+                        comp,
+                        "random",
+                        rd);
+                }
+            }
+        }
+    }
+
+    exr_set_default_deflate_backend (orig);
+    setDefaultDeflateBackend (origcpp);
+}
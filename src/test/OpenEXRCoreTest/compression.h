@@ -7,6 +7,7 @@
 #include <string>
 
 void testHUF (const std::string& tempdir);
+void testHUFDecoding (const std::string& tempdir);
 
 void testNoCompression (const std::string& tempdir);
 void testRLECompression (const std::string& tempdir);
@@ -18,6 +19,7 @@ void testB44Compression (const std::string& tempdir);
 void testB44ACompression (const std::string& tempdir);
 void testDWAACompression (const std::string& tempdir);
 void testDWABCompression (const std::string& tempdir);
+void testDeflateBackends (const std::string& tempdir);
 
 void testDeepNoCompression (const std::string& tempdir);
 void testDeepZIPCompression (const std::string& tempdir);
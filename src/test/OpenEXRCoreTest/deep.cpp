@@ -487,6 +487,302 @@ testReadDeep (const std::string& tempdir)
     remove (fn.c_str ());
 }
 
+static void
+checkSampleCountTables (
+    exr_context_t f, const std::vector<exr_chunk_info_t>& chunks, bool tiled)
+{
+    int32_t                       ccount = (int32_t) chunks.size ();
+    std::vector<std::vector<int>> individual (ccount), cumulative (ccount);
+    std::vector<int32_t*>         iptrs (ccount), cptrs (ccount);
+    std::vector<exr_result_t>     results (ccount);
+    uint32_t                      tilew = 0, tileh = 0;
+
+    if (tiled)
+        EXRCORE_TEST_RVAL (
+            exr_get_tile_descriptor (f, 0, &tilew, &tileh, NULL, NULL));
+
+    for (int32_t c = 0; c < ccount; ++c)
+    {
+        size_t n = (size_t) chunks[c].width * (size_t) chunks[c].height;
+        individual[c].assign (n, -1);
+        cumulative[c].assign (n, -1);
+        iptrs[c] = individual[c].data ();
+        cptrs[c] = cumulative[c].data ();
+    }
+
+    EXRCORE_TEST_RVAL (exr_read_sample_counts_parallel (
+        f,
+        0,
+        0,
+        ccount,
+        EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL,
+        iptrs.data (),
+        NULL,
+        4,
+        results.data ()));
+    for (int32_t c = 0; c < ccount; ++c)
+        EXRCORE_TEST (results[c] == EXR_ERR_SUCCESS);
+
+    // one worker, and the counts as stored in the file
+    EXRCORE_TEST_RVAL (exr_read_sample_counts_parallel (
+        f, 0, 0, ccount, 0, cptrs.data (), NULL, 1, NULL));
+
+    for (int32_t c = 0; c < ccount; ++c)
+    {
+        const exr_chunk_info_t& cinfo = chunks[c];
+
+        for (int y = 0; y < cinfo.height; ++y)
+        {
+            int total = 0;
+            for (int x = 0; x < cinfo.width; ++x)
+            {
+                int          i = y * cinfo.width + x;
+                unsigned int expected;
+
+                if (tiled)
+                    expected = sampleCountTiles[cinfo.level_y][cinfo.level_x]
+                                               [cinfo.start_y * tileh + y]
+                                               [cinfo.start_x * tilew + x];
+                else
+                    expected = sampleCountScans[cinfo.start_y - minY + y][x];
+
+                total += individual[c][i];
+                EXRCORE_TEST (individual[c][i] == (int) expected);
+                EXRCORE_TEST (cumulative[c][i] == total);
+            }
+        }
+    }
+
+    // a sub range leaves the other tables alone
+    for (int32_t c = 0; c < ccount; ++c)
+        std::fill (individual[c].begin (), individual[c].end (), -1);
+    EXRCORE_TEST_RVAL (exr_read_sample_counts_parallel (
+        f,
+        0,
+        1,
+        ccount - 1,
+        EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL,
+        iptrs.data () + 1,
+        NULL,
+        0,
+        NULL));
+    EXRCORE_TEST (individual[0][0] == -1);
+    EXRCORE_TEST (individual[ccount - 1][0] > 0);
+
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_read_sample_counts_parallel (
+            f, 0, 0, ccount, 0, NULL, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+        exr_read_sample_counts_parallel (
+            f, 0, 1, ccount, 0, cptrs.data (), NULL, 0, NULL));
+}
+
+void
+testReadDeepSampleCounts (const std::string& tempdir)
+{
+    std::string fn = tempdir;
+
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    fn += "randomtempdeepcounts.exr";
+
+    Compression comps[] = {NO_COMPRESSION, RLE_COMPRESSION, ZIPS_COMPRESSION};
+
+    for (int cp = 0; cp < 3; ++cp)
+    {
+        std::vector<exr_chunk_info_t> chunks;
+        int32_t                       ccount;
+
+        generateRandomScanFile (fn, 3, comps[cp]);
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+        for (int32_t y = minY; y < minY + height;)
+        {
+            exr_chunk_info_t cinfo;
+            EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+            chunks.push_back (cinfo);
+            y = cinfo.start_y + cinfo.height;
+        }
+        EXRCORE_TEST (ccount == (int32_t) chunks.size ());
+        checkSampleCountTables (f, chunks, false);
+        exr_finish (&f);
+
+        // chunk table order is levels, then tiles in increasing y, x
+        generateRandomTileFile (fn, 3, comps[cp]);
+        chunks.clear ();
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+
+        int32_t  levelsx, levelsy;
+        uint32_t tilew, tileh;
+        EXRCORE_TEST_RVAL (exr_get_tile_levels (f, 0, &levelsx, &levelsy));
+        EXRCORE_TEST_RVAL (
+            exr_get_tile_descriptor (f, 0, &tilew, &tileh, NULL, NULL));
+        for (int ly = 0; ly < levelsy; ++ly)
+            for (int lx = 0; lx < levelsx; ++lx)
+            {
+                int32_t levw, levh;
+                EXRCORE_TEST_RVAL (
+                    exr_get_level_sizes (f, 0, lx, ly, &levw, &levh));
+                for (int ty = 0; ty < (levh + (int) tileh - 1) / (int) tileh;
+                     ++ty)
+                    for (int tx = 0;
+                         tx < (levw + (int) tilew - 1) / (int) tilew;
+                         ++tx)
+                    {
+                        exr_chunk_info_t cinfo;
+                        EXRCORE_TEST_RVAL (exr_read_tile_chunk_info (
+                            f, 0, tx, ty, lx, ly, &cinfo));
+                        EXRCORE_TEST (cinfo.idx == (int) chunks.size ());
+                        chunks.push_back (cinfo);
+                    }
+            }
+        EXRCORE_TEST (ccount == (int32_t) chunks.size ());
+        checkSampleCountTables (f, chunks, true);
+        exr_finish (&f);
+    }
+
+    // not a deep part
+    std::string flat = ILM_IMF_TEST_IMAGEDIR;
+    flat += "comp_zip.exr";
+    int32_t buf[1];
+    int32_t* ptrs[1] = {buf};
+    EXRCORE_TEST_RVAL (exr_start_read (&f, flat.c_str (), &cinit));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_read_sample_counts_parallel (f, 0, 0, 1, 0, ptrs, NULL, 0, NULL));
+    exr_finish (&f);
+
+    remove (fn.c_str ());
+}
+
+void
+testReadDeepRawSampleCountTables (const std::string& tempdir)
+{
+    std::string fn = tempdir + "deeprawcounttables.exr";
+
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    // DeepTiledOutputFile stores a sample count table as is when it
+    // does not compress below the size of a full tile's table, and
+    // then pads it to that size, also for the (smaller) tiles at the
+    // edge of the data window. The tables of tiny tiles do not
+    // compress, except for some at the edge, which may then be just
+    // as large as the table they hold
+    const int   w = 37, h = 13;
+    const Box2i dw (V2i (0, 0), V2i (w - 1, h - 1));
+
+    Compression comps[]      = {NO_COMPRESSION, RLE_COMPRESSION};
+    int         tilesizes[2] = {16, 2};
+
+    for (int cp = 0; cp < 2; ++cp)
+    {
+        const int    tw = tilesizes[cp], th = tilesizes[cp];
+        const size_t fullsize = tw * th * sizeof (int32_t);
+
+        // random counts, so that the tables do not compress either
+        std::default_random_engine         generator;
+        std::uniform_int_distribution<int> distribution (0, 255);
+
+        Array2D<unsigned int> counts (h, w);
+        Array2D<float*>       samples (h, w);
+        std::vector<float>    storage;
+        size_t                total = 0;
+
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            {
+                counts[y][x] = distribution (generator);
+                total += counts[y][x];
+            }
+        storage.assign (total, 0.5f);
+        total = 0;
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            {
+                samples[y][x] = storage.data () + total;
+                total += counts[y][x];
+            }
+
+        {
+            Header hdr (dw, dw, 1, V2f (0, 0), 1, INCREASING_Y, comps[cp]);
+            hdr.channels ().insert ("Z", Channel (IMF::FLOAT));
+            hdr.setType (DEEPTILE);
+            hdr.setTileDescription (TileDescription (tw, th, ONE_LEVEL));
+
+            DeepFrameBuffer fb;
+            fb.insertSampleCountSlice (Slice (
+                IMF::UINT,
+                (char*) &counts[0][0],
+                sizeof (unsigned int),
+                sizeof (unsigned int) * w));
+            fb.insert (
+                "Z",
+                DeepSlice (
+                    IMF::FLOAT,
+                    (char*) &samples[0][0],
+                    sizeof (float*),
+                    sizeof (float*) * w,
+                    sizeof (float)));
+
+            remove (fn.c_str ());
+            DeepTiledOutputFile out (fn.c_str (), hdr);
+            out.setFrameBuffer (fb);
+            out.writeTiles (0, out.numXTiles () - 1, 0, out.numYTiles () - 1);
+        }
+
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+        int nraw = 0, nedge = 0;
+        for (int ty = 0; ty < (h + th - 1) / th; ++ty)
+            for (int tx = 0; tx < (w + tw - 1) / tw; ++tx)
+            {
+                exr_chunk_info_t cinfo;
+                EXRCORE_TEST_RVAL (
+                    exr_read_tile_chunk_info (f, 0, tx, ty, 0, 0, &cinfo));
+                if (cinfo.sample_count_table_size == fullsize)
+                {
+                    ++nraw;
+                    if (cinfo.width < tw || cinfo.height < th) ++nedge;
+                }
+
+                // only the sample count table, through the default
+                // decompression routine
+                exr_decode_pipeline_t decoder =
+                    EXR_DECODE_PIPELINE_INITIALIZER;
+                EXRCORE_TEST_RVAL (
+                    exr_decoding_initialize (f, 0, &cinfo, &decoder));
+                decoder.decode_flags |= EXR_DECODE_SAMPLE_DATA_ONLY |
+                                        EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL;
+                EXRCORE_TEST_RVAL (
+                    exr_decoding_choose_default_routines (f, 0, &decoder));
+                EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+
+                for (int y = 0; y < cinfo.height; ++y)
+                    for (int x = 0; x < cinfo.width; ++x)
+                        EXRCORE_TEST (
+                            decoder.sample_count_table[y * cinfo.width + x] ==
+                            (int32_t) counts[cinfo.start_y * th + y]
+                                            [cinfo.start_x * tw + x]);
+
+                EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+            }
+        // make sure the file has the tables this is about
+        EXRCORE_TEST (nraw > 0);
+        if (comps[cp] == NO_COMPRESSION) EXRCORE_TEST (nedge > 0);
+
+        exr_finish (&f);
+    }
+
+    remove (fn.c_str ());
+}
+
 void
 testWriteDeep (const std::string& tempdir)
 {}
@@ -9,6 +9,8 @@
 void testOpenDeep (const std::string& tempdir);
 
 void testReadDeep (const std::string& tempdir);
+void testReadDeepSampleCounts (const std::string& tempdir);
+void testReadDeepRawSampleCountTables (const std::string& tempdir);
 void testWriteDeep (const std::string& tempdir);
 
 #endif // OPENEXR_CORE_TEST_READ_H
@@ -169,9 +169,16 @@ main (int argc, char* argv[])
     TEST (testOpenDeep, "core_read");
     TEST (testReadScans, "core_read");
     TEST (testReadTiles, "core_read");
+    TEST (testReadRipMapTiles, "core_read");
     TEST (testReadMultiPart, "core_read");
     TEST (testReadDeep, "core_read");
+    TEST (testReadDeepSampleCounts, "core_read");
+    TEST (testReadDeepRawSampleCountTables, "core_read");
     TEST (testReadUnpack, "core_read");
+    TEST (testReadParallel, "core_read");
+    TEST (testReadBackends, "core_read");
+    TEST (testReadChunksVectored, "core_read");
+    TEST (testReadUnpackLayouts, "core_read");
 
     TEST (testWriteBadArgs, "core_write");
     TEST (testWriteBadFiles, "core_write");
@@ -186,8 +193,11 @@ main (int argc, char* argv[])
     TEST (testWriteTiles, "core_write");
     TEST (testWriteMultiPart, "core_write");
     TEST (testWriteDeep, "core_write");
+    TEST (testWritePackLayouts, "core_write");
+    TEST (testWriteParallelChunks, "core_write");
 
     TEST (testHUF, "core_compression");
+    TEST (testHUFDecoding, "core_compression");
     TEST (testNoCompression, "core_compression");
     TEST (testRLECompression, "core_compression");
     TEST (testZIPCompression, "core_compression");
@@ -198,6 +208,7 @@ main (int argc, char* argv[])
     TEST (testB44ACompression, "core_compression");
     TEST (testDWAACompression, "core_compression");
     TEST (testDWABCompression, "core_compression");
+    TEST (testDeflateBackends, "core_compression");
 
     TEST (testDeepNoCompression, "core_compression");
     TEST (testDeepZIPCompression, "core_compression");
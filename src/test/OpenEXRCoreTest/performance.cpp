@@ -18,11 +18,31 @@
 #include <ImfCompressor.h>
 #include <ImfFrameBuffer.h>
 #include <ImfHeader.h>
+#include <ImfHuf.h>
 #include <ImfInputPart.h>
 #include <ImfMultiPartInputFile.h>
 #include <ImfThreading.h>
+#include <ImfWav.h>
 #include <openexr.h>
 
+#if defined(OPENEXR_ENABLE_API_VISIBILITY)
+#    include "../../lib/OpenEXRCore/internal_huf.c"
+
+void*
+internal_exr_alloc (size_t bytes)
+{
+    return malloc (bytes);
+}
+void
+internal_exr_free (void* p)
+{
+    if (p) free (p);
+}
+
+#else
+#    include "../../lib/OpenEXRCore/internal_huf.h"
+#endif
+
 using namespace OPENEXR_IMF_NAMESPACE;
 using namespace ILMTHREAD_NAMESPACE;
 
@@ -394,11 +414,222 @@ readImf (
     }
 }
 
+// reads the files through the core library with each deflate backend
+// that was compiled in, to compare them on the zip based compressions
+static int
+compareDeflateBackends (const std::vector<std::string>& files, int count)
+{
+    const exr_deflate_backend_t backends[] = {
+        EXR_DEFLATE_BACKEND_ZLIB, EXR_DEFLATE_BACKEND_LIBDEFLATE};
+    const char* names[] = {"zlib", "libdeflate"};
+    exr_deflate_backend_t orig;
+
+    exr_get_default_deflate_backend (&orig);
+
+    std::cout << "Stats for reading: " << files.size () << " files " << count
+              << " times\n\n"
+              << " Backend    " << std::setw (15) << std::left
+              << std::setfill (' ') << "Data" << " Ave\n";
+    for (int b = 0; b < 2; ++b)
+    {
+        exr_deflate_backend_t cur;
+        uint64_t headerNanos = 0, dataNanos = 0, closeNanos = 0, pixCount = 0;
+
+        exr_set_default_deflate_backend (backends[b]);
+        exr_get_default_deflate_backend (&cur);
+        if (cur != backends[b])
+        {
+            std::cout << " " << std::setw (10) << std::left
+                      << std::setfill (' ') << names[b]
+                      << " not available\n";
+            continue;
+        }
+
+        for (int c = 0; c < count; ++c)
+        {
+            for (auto& f: files)
+            {
+                try
+                {
+                    readCore (f, headerNanos, dataNanos, closeNanos, pixCount);
+                }
+                catch (std::exception& e)
+                {
+                    std::cerr << "ERROR: " << e.what () << std::endl;
+                    exr_set_default_deflate_backend (orig);
+                    return 1;
+                }
+            }
+        }
+
+        std::cout << " " << std::setw (10) << std::left << std::setfill (' ')
+                  << names[b] << " " << std::setw (15) << std::left
+                  << std::setfill (' ') << dataNanos << " "
+                  << double (dataNanos) / double (count * files.size ())
+                  << " ns\n";
+    }
+
+    exr_set_default_deflate_backend (orig);
+    return 0;
+}
+
+// builds PIZ style blocks (32 scanlines of all channels, wavelet
+// transformed) from the first part of each file as 16 bit values, and
+// times the core huffman coder against the one in the C++ library
+static int
+compareHuffman (const std::vector<std::string>& files, int count)
+{
+    std::vector<std::vector<uint16_t>> blocks;
+
+    for (auto& fn: files)
+    {
+        try
+        {
+            MultiPartInputFile            f (fn.c_str ());
+            InputPart                     part (f, 0);
+            const Header&                 hdr = part.header ();
+            const IMATH_NAMESPACE::Box2i& dw  = hdr.dataWindow ();
+            int                           w   = dw.max.x - dw.min.x + 1;
+            int                           h   = dw.max.y - dw.min.y + 1;
+            int                           nc  = 0;
+            FrameBuffer                   fb;
+            std::vector<uint16_t>         pix;
+
+            if (hdr.hasTileDescription ()) continue;
+            for (auto c = hdr.channels ().begin ();
+                 c != hdr.channels ().end ();
+                 ++c)
+                ++nc;
+            pix.resize (size_t (w) * size_t (h) * size_t (nc));
+
+            nc = 0;
+            for (auto c = hdr.channels ().begin ();
+                 c != hdr.channels ().end ();
+                 ++c, ++nc)
+            {
+                uint16_t* base = pix.data () + size_t (nc) * w * h;
+                fb.insert (
+                    c.name (),
+                    Slice (
+                        HALF,
+                        (char*) (base - dw.min.x - size_t (dw.min.y) * w),
+                        sizeof (uint16_t),
+                        sizeof (uint16_t) * w));
+            }
+            part.setFrameBuffer (fb);
+            part.readPixels (dw.min.y, dw.max.y);
+
+            for (int y = 0; y < h; y += 32)
+            {
+                int                   ny = std::min (32, h - y);
+                std::vector<uint16_t> blk;
+
+                for (int c = 0; c < nc; ++c)
+                {
+                    const uint16_t* src =
+                        pix.data () + size_t (c) * w * h + size_t (y) * w;
+                    size_t off = blk.size ();
+                    blk.insert (blk.end (), src, src + size_t (w) * ny);
+                    wav2Encode (blk.data () + off, w, 1, ny, w, 0xffff);
+                }
+                blocks.push_back (std::move (blk));
+            }
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "ERROR: " << e.what () << std::endl;
+            return 1;
+        }
+    }
+
+    uint64_t esize = internal_exr_huf_compress_spare_bytes ();
+    uint64_t dsize = internal_exr_huf_decompress_spare_bytes ();
+    std::vector<uint8_t>              spare (std::max (esize, dsize));
+    std::vector<std::vector<uint8_t>> encoded (blocks.size ());
+    std::vector<uint16_t>             decoded;
+    uint64_t coreEnc = 0, coreDec = 0, imfEnc = 0, imfDec = 0, nvals = 0;
+
+    for (int c = 0; c < count; ++c)
+    {
+        for (size_t b = 0; b < blocks.size (); ++b)
+        {
+            const std::vector<uint16_t>& raw = blocks[b];
+            std::vector<uint8_t>&        enc = encoded[b];
+            uint64_t                     nbytes;
+
+            enc.resize (raw.size () * 3 + 65536);
+            decoded.resize (raw.size ());
+            nvals += raw.size ();
+
+            auto t0 = std::chrono::steady_clock::now ();
+            if (EXR_ERR_SUCCESS != internal_huf_compress (
+                                       &nbytes,
+                                       enc.data (),
+                                       enc.size (),
+                                       raw.data (),
+                                       raw.size (),
+                                       spare.data (),
+                                       esize))
+            {
+                std::cerr << "ERROR: core huffman encode failed" << std::endl;
+                return 1;
+            }
+            auto t1 = std::chrono::steady_clock::now ();
+            if (EXR_ERR_SUCCESS != internal_huf_decompress (
+                                       enc.data (),
+                                       nbytes,
+                                       decoded.data (),
+                                       decoded.size (),
+                                       spare.data (),
+                                       dsize) ||
+                decoded != raw)
+            {
+                std::cerr << "ERROR: core huffman decode failed" << std::endl;
+                return 1;
+            }
+            auto t2 = std::chrono::steady_clock::now ();
+            int  cppbytes =
+                hufCompress (raw.data (), (int) raw.size (), (char*) enc.data ());
+            auto t3 = std::chrono::steady_clock::now ();
+            hufUncompress (
+                (const char*) enc.data (),
+                cppbytes,
+                decoded.data (),
+                (int) decoded.size ());
+            auto t4 = std::chrono::steady_clock::now ();
+
+            coreEnc += std::chrono::duration_cast<std::chrono::nanoseconds> (
+                           t1 - t0)
+                           .count ();
+            coreDec += std::chrono::duration_cast<std::chrono::nanoseconds> (
+                           t2 - t1)
+                           .count ();
+            imfEnc += std::chrono::duration_cast<std::chrono::nanoseconds> (
+                          t3 - t2)
+                          .count ();
+            imfDec += std::chrono::duration_cast<std::chrono::nanoseconds> (
+                          t4 - t3)
+                          .count ();
+        }
+    }
+
+    std::cout << "Stats for huffman coding " << blocks.size () << " blocks "
+              << count << " times (" << nvals << " values)\n\n"
+              << " Coder " << std::setw (15) << std::left
+              << std::setfill (' ') << "Encode" << " " << std::setw (15)
+              << "Decode" << "\n"
+              << " Core  " << std::setw (15) << coreEnc << " " << std::setw (15)
+              << coreDec << "\n"
+              << " Imf   " << std::setw (15) << imfEnc << " " << std::setw (15)
+              << imfDec << "\n";
+    return 0;
+}
+
 static int
 usageAndExit (const char* argv0, int ec)
 {
-    std::cerr << "Usage: " << argv0 << "[--imf|--core] <file1> [<file2>...]"
-              << std::endl;
+    std::cerr << "Usage: " << argv0
+              << "[--imf|--core|--deflate|--huf] <file1> [<file2>...]" << std::endl;
     return ec;
 }
 
@@ -406,7 +637,8 @@ int
 main (int argc, char* argv[])
 {
     std::vector<std::string> files;
-    bool                     coreOnly = false, imfOnly = false;
+    bool coreOnly = false, imfOnly = false, deflateBackends = false,
+         huffman = false;
     for (int a = 1; a < argc; ++a)
     {
         if (!strcmp (argv[a], "-h") || !strcmp (argv[a], "--help") ||
@@ -434,6 +666,14 @@ main (int argc, char* argv[])
                 return usageAndExit (argv[0], 1);
             }
         }
+        else if (!strcmp (argv[a], "--deflate"))
+        {
+            deflateBackends = true;
+        }
+        else if (!strcmp (argv[a], "--huf"))
+        {
+            huffman = true;
+        }
         else
             files.push_back (argv[a]);
     }
@@ -441,6 +681,8 @@ main (int argc, char* argv[])
     if (files.empty ()) return usageAndExit (argv[0], 1);
 
     setGlobalThreadCount (THREADS);
+    if (deflateBackends) return compareDeflateBackends (files, 20);
+    if (huffman) return compareHuffman (files, 20);
     bool     odd          = false;
     uint64_t headerNanosN = 0, dataNanosN = 0, closeNanosN = 0, pixCountN = 0,
              fileCount    = 0;
@@ -12,9 +12,19 @@
 #include <math.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <vector>
+
+#include <half.h>
+
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfTiledOutputFile.h>
 
 static void
 err_cb (exr_const_context_t f, int code, const char* msg)
@@ -541,6 +551,139 @@ testReadTiles (const std::string& tempdir)
     exr_finish (&f);
 }
 
+static float
+ripMapValue (int lx, int ly, int x, int y)
+{
+    return (float) (lx * 1000000 + ly * 10000 + y * 100 + x);
+}
+
+void
+testReadRipMapTiles (const std::string& tempdir)
+{
+    namespace IMF = OPENEXR_IMF_NAMESPACE;
+
+    std::string fn = tempdir + "ripmaptiles.exr";
+
+    // written by the C++ library, so the chunk order does not depend
+    // on the way the core computes it
+    {
+        IMF::Header hdr (
+            IMATH_NAMESPACE::Box2i (
+                IMATH_NAMESPACE::V2i (0, 0), IMATH_NAMESPACE::V2i (34, 20)),
+            IMATH_NAMESPACE::Box2i (
+                IMATH_NAMESPACE::V2i (0, 0), IMATH_NAMESPACE::V2i (34, 20)));
+        hdr.compression () = IMF::NO_COMPRESSION;
+        hdr.channels ().insert ("Z", IMF::Channel (IMF::FLOAT));
+        hdr.setTileDescription (
+            IMF::TileDescription (8, 4, IMF::RIPMAP_LEVELS, IMF::ROUND_DOWN));
+
+        IMF::TiledOutputFile out (fn.c_str (), hdr);
+        for (int ly = 0; ly < out.numYLevels (); ++ly)
+        {
+            for (int lx = 0; lx < out.numXLevels (); ++lx)
+            {
+                int                w = out.levelWidth (lx);
+                int                h = out.levelHeight (ly);
+                std::vector<float> pix ((size_t) w * (size_t) h);
+
+                for (int y = 0; y < h; ++y)
+                    for (int x = 0; x < w; ++x)
+                        pix[(size_t) y * w + x] = ripMapValue (lx, ly, x, y);
+
+                IMF::FrameBuffer fb;
+                fb.insert (
+                    "Z",
+                    IMF::Slice (
+                        IMF::FLOAT,
+                        (char*) pix.data (),
+                        sizeof (float),
+                        sizeof (float) * w));
+                out.setFrameBuffer (fb);
+                out.writeTiles (
+                    0,
+                    out.numXTiles (lx) - 1,
+                    0,
+                    out.numYTiles (ly) - 1,
+                    lx,
+                    ly);
+            }
+        }
+    }
+
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+    int32_t  levelsx, levelsy;
+    uint32_t tilew, tileh;
+    EXRCORE_TEST_RVAL (exr_get_tile_levels (f, 0, &levelsx, &levelsy));
+    EXRCORE_TEST (levelsx == 6);
+    EXRCORE_TEST (levelsy == 5);
+    EXRCORE_TEST_RVAL (
+        exr_get_tile_descriptor (f, 0, &tilew, &tileh, NULL, NULL));
+
+    // the levels with both lx > 0 and ly > 0 are the ones that used
+    // to get the chunks of another level
+    int32_t idx = 0;
+    for (int32_t ly = 0; ly < levelsy; ++ly)
+    {
+        for (int32_t lx = 0; lx < levelsx; ++lx)
+        {
+            int32_t levw, levh;
+            EXRCORE_TEST_RVAL (
+                exr_get_level_sizes (f, 0, lx, ly, &levw, &levh));
+
+            int32_t ntx = (levw + (int32_t) tilew - 1) / (int32_t) tilew;
+            int32_t nty = (levh + (int32_t) tileh - 1) / (int32_t) tileh;
+            for (int32_t ty = 0; ty < nty; ++ty)
+            {
+                for (int32_t tx = 0; tx < ntx; ++tx, ++idx)
+                {
+                    exr_chunk_info_t cinfo;
+                    EXRCORE_TEST_RVAL (exr_read_tile_chunk_info (
+                        f, 0, tx, ty, lx, ly, &cinfo));
+                    EXRCORE_TEST (cinfo.idx == idx);
+                    EXRCORE_TEST (cinfo.level_x == lx);
+                    EXRCORE_TEST (cinfo.level_y == ly);
+
+                    std::vector<float> pix (
+                        (size_t) cinfo.width * (size_t) cinfo.height, -1.f);
+
+                    exr_decode_pipeline_t decoder;
+                    EXRCORE_TEST_RVAL (
+                        exr_decoding_initialize (f, 0, &cinfo, &decoder));
+                    decoder.channels[0].decode_to_ptr =
+                        (uint8_t*) pix.data ();
+                    decoder.channels[0].user_pixel_stride = sizeof (float);
+                    decoder.channels[0].user_line_stride =
+                        sizeof (float) * cinfo.width;
+                    decoder.channels[0].user_bytes_per_element =
+                        sizeof (float);
+                    EXRCORE_TEST_RVAL (
+                        exr_decoding_choose_default_routines (f, 0, &decoder));
+                    EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+                    EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+
+                    for (int y = 0; y < cinfo.height; ++y)
+                        for (int x = 0; x < cinfo.width; ++x)
+                            EXRCORE_TEST (
+                                pix[(size_t) y * cinfo.width + x] ==
+                                ripMapValue (
+                                    lx,
+                                    ly,
+                                    tx * (int) tilew + x,
+                                    ty * (int) tileh + y));
+                }
+            }
+        }
+    }
+
+    exr_finish (&f);
+    remove (fn.c_str ());
+}
+
 void
 testReadMultiPart (const std::string& tempdir)
 {}
@@ -590,3 +733,730 @@ testReadUnpack (const std::string& tempdir)
 
     exr_finish (&f);
 }
+
+////////////////////////////////////////
+
+struct ParallelDest
+{
+    uint8_t* base;
+    uint64_t chunkSize;
+};
+
+static exr_result_t
+parallel_setup (exr_decode_pipeline_t* decode, int chunk_index, void* ud)
+{
+    ParallelDest* dest       = static_cast<ParallelDest*> (ud);
+    uint8_t*      curchanptr = dest->base + dest->chunkSize * chunk_index;
+    int           bytesperpixel = 0;
+    for (int c = 0; c < decode->channel_count; ++c)
+        bytesperpixel += decode->channels[c].bytes_per_element;
+    for (int c = 0; c < decode->channel_count; ++c)
+    {
+        exr_coding_channel_info_t& outc = decode->channels[c];
+        outc.decode_to_ptr              = curchanptr;
+        outc.user_pixel_stride          = bytesperpixel;
+        outc.user_line_stride           = outc.width * bytesperpixel;
+        outc.user_bytes_per_element     = outc.bytes_per_element;
+        outc.user_data_type             = outc.data_type;
+        curchanptr += outc.bytes_per_element;
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+parallel_fail_setup (exr_decode_pipeline_t* decode, int chunk_index, void* ud)
+{
+    if (chunk_index == 3) return EXR_ERR_CORRUPT_CHUNK;
+    return parallel_setup (decode, chunk_index, ud);
+}
+
+static std::atomic<int> s_custom_unpack_calls (0);
+
+static exr_result_t
+custom_unpack (exr_decode_pipeline_t* decode)
+{
+    if (!decode->unpacked_buffer) return EXR_ERR_CORRUPT_CHUNK;
+    ++s_custom_unpack_calls;
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+parallel_custom_setup (
+    exr_decode_pipeline_t* decode, int chunk_index, void* ud)
+{
+    exr_result_t rv = parallel_setup (decode, chunk_index, ud);
+    decode->unpack_and_convert_fn = &custom_unpack;
+    return rv;
+}
+
+static int s_serial_pool_runs = 0;
+
+static int
+serial_pool_count (void*)
+{
+    return 3;
+}
+
+static exr_result_t
+serial_pool_run (void*, int ntasks, exr_worker_task_func_t task, void* data)
+{
+    ++s_serial_pool_runs;
+    for (int t = ntasks - 1; t >= 0; --t)
+        task (t, data);
+    return EXR_ERR_SUCCESS;
+}
+
+static int
+four_worker_count (void*)
+{
+    return 4;
+}
+
+static void
+testParallelFile (const std::string& fn)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+    int32_t  ccount;
+    uint64_t csize;
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST_RVAL (exr_get_chunk_unpacked_size (f, 0, &csize));
+    EXRCORE_TEST (ccount > 4);
+
+    std::vector<uint8_t> serial (csize * ccount, 0);
+    std::vector<uint8_t> parallel (csize * ccount, 0);
+    ParallelDest         sdest = {serial.data (), csize};
+    ParallelDest         pdest = {parallel.data (), csize};
+
+    // one worker is the serial reference
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 0, ccount, &parallel_setup, &sdest, NULL, 1, NULL));
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 0, ccount, &parallel_setup, &pdest, NULL, 4, NULL));
+    EXRCORE_TEST (parallel == serial);
+
+    // the default pool's threads, whatever the number of processors,
+    // also once they have been shut down
+    const exr_worker_pool_t* dflt     = exr_get_default_worker_pool ();
+    exr_worker_pool_t        threaded = {
+        sizeof (exr_worker_pool_t),
+        dflt->pool_data,
+        &four_worker_count,
+        dflt->run_tasks};
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        std::fill (parallel.begin (), parallel.end (), 0);
+        EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+            f, 0, 0, ccount, &parallel_setup, &pdest, &threaded, 0, NULL));
+        EXRCORE_TEST (parallel == serial);
+        exr_shutdown_default_worker_pool ();
+    }
+
+    std::vector<exr_result_t> results (ccount);
+    std::vector<uint8_t>      custom (csize * ccount, 0);
+    ParallelDest              cdest = {custom.data (), csize};
+    exr_worker_pool_t         pool  = {
+        sizeof (exr_worker_pool_t),
+        NULL,
+        &serial_pool_count,
+        &serial_pool_run};
+    s_serial_pool_runs = 0;
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 0, ccount, &parallel_setup, &cdest, &pool, 0, results.data ()));
+    EXRCORE_TEST (s_serial_pool_runs == 1);
+    for (int32_t c = 0; c < ccount; ++c)
+        EXRCORE_TEST (results[c] == EXR_ERR_SUCCESS);
+    EXRCORE_TEST (custom == serial);
+
+    // routines provided by the setup function are used, not replaced
+    // by the defaults, which still fill in the rest
+    std::fill (custom.begin (), custom.end (), 0);
+    s_custom_unpack_calls = 0;
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 0, ccount, &parallel_custom_setup, &cdest, NULL, 2, NULL));
+    EXRCORE_TEST (s_custom_unpack_calls == ccount);
+    EXRCORE_TEST (
+        std::count (custom.begin (), custom.end (), 0) == (long) custom.size ());
+
+    // a sub range only touches those chunks
+    std::vector<uint8_t> sub (csize * ccount, 0);
+    ParallelDest         subdest = {sub.data (), csize};
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 2, ccount - 2, &parallel_setup, &subdest, NULL, 0, NULL));
+    EXRCORE_TEST (
+        std::equal (sub.begin () + 2 * csize, sub.end (), serial.begin () + 2 * csize));
+
+    // errors are reported per chunk, the rest still get decoded
+    std::fill (custom.begin (), custom.end (), 0);
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_CORRUPT_CHUNK,
+        exr_decode_chunks_parallel (
+            f,
+            0,
+            0,
+            ccount,
+            &parallel_fail_setup,
+            &cdest,
+            NULL,
+            2,
+            results.data ()));
+    for (int32_t c = 0; c < ccount; ++c)
+        EXRCORE_TEST (
+            results[c] ==
+            ((c == 3) ? EXR_ERR_CORRUPT_CHUNK : EXR_ERR_SUCCESS));
+    EXRCORE_TEST (std::equal (
+        custom.begin () + 4 * csize,
+        custom.end (),
+        serial.begin () + 4 * csize));
+
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_decode_chunks_parallel (
+            f, 0, 0, ccount, NULL, &pdest, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+        exr_decode_chunks_parallel (
+            f, 0, 1, ccount, &parallel_setup, &pdest, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+        exr_decode_chunks_parallel (
+            f, 0, -1, 1, &parallel_setup, &pdest, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+        exr_decode_chunks_parallel (
+            f, 1, 0, 1, &parallel_setup, &pdest, NULL, 0, NULL));
+    pool.run_tasks = NULL;
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_decode_chunks_parallel (
+            f, 0, 0, ccount, &parallel_setup, &pdest, &pool, 0, NULL));
+
+    exr_finish (&f);
+}
+
+void
+testReadParallel (const std::string& tempdir)
+{
+    std::string fn = ILM_IMF_TEST_IMAGEDIR;
+    testParallelFile (fn + "comp_zip.exr");
+    testParallelFile (fn + "comp_dwaa_v2.exr");
+    testParallelFile (fn + "v1.7.test.tiled.exr");
+}
+
+static void
+readAllPacked (
+    exr_context_t                  f,
+    std::vector<exr_chunk_info_t>& cinfos,
+    std::vector<uint8_t>&          packed)
+{
+    exr_attr_box2i_t dw;
+    int32_t          ccount, lpc;
+    uint64_t         total = 0;
+
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST_RVAL (exr_get_data_window (f, 0, &dw));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+
+    cinfos.resize (ccount);
+    for (int32_t c = 0; c < ccount; ++c)
+    {
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (
+            f, 0, dw.min.y + c * lpc, &(cinfos[c])));
+        total += cinfos[c].packed_size;
+    }
+
+    packed.assign (total, 0);
+    total = 0;
+    for (int32_t c = 0; c < ccount; ++c)
+    {
+        EXRCORE_TEST_RVAL (
+            exr_read_chunk (f, 0, &(cinfos[c]), packed.data () + total));
+        total += cinfos[c].packed_size;
+    }
+}
+
+static void
+testReadBackendFile (const std::string& fn)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    std::vector<exr_chunk_info_t> cinfos;
+    std::vector<uint8_t>          refpacked;
+    int32_t                       ccount;
+    uint64_t                      csize;
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    readAllPacked (f, cinfos, refpacked);
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST_RVAL (exr_get_chunk_unpacked_size (f, 0, &csize));
+    std::vector<uint8_t> refpix (csize * ccount, 0);
+    ParallelDest         refdest = {refpix.data (), csize};
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 0, ccount, &parallel_setup, &refdest, NULL, 1, NULL));
+
+    // not mapped, the caller is told to copy instead
+    const void* mapped = NULL;
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
+        exr_read_chunk_mapped (f, 0, &(cinfos[0]), &mapped));
+    EXRCORE_TEST (mapped == NULL);
+    exr_finish (&f);
+
+    const exr_default_read_mode_t modes[] = {
+        EXR_READ_FILE_DEFAULT, EXR_READ_FILE_MMAP, EXR_READ_FILE_IO_URING};
+    for (exr_default_read_mode_t mode: modes)
+    {
+        cinit.read_mode = mode;
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+        std::vector<exr_chunk_info_t> mcinfos;
+        std::vector<uint8_t>          packed;
+        readAllPacked (f, mcinfos, packed);
+        EXRCORE_TEST (packed == refpacked);
+
+        // all the chunks in one batch
+        std::vector<uint8_t> batch (refpacked.size (), 0);
+        std::vector<void*>   bufs (ccount);
+        uint64_t             off = 0;
+        for (int32_t c = 0; c < ccount; ++c)
+        {
+            bufs[c] = batch.data () + off;
+            off += mcinfos[c].packed_size;
+        }
+        EXRCORE_TEST_RVAL (
+            exr_read_chunks (f, 0, ccount, mcinfos.data (), bufs.data ()));
+        EXRCORE_TEST (batch == refpacked);
+        EXRCORE_TEST_RVAL (exr_read_chunks (f, 0, 0, NULL, NULL));
+        EXRCORE_TEST_RVAL_FAIL (
+            EXR_ERR_INVALID_ARGUMENT,
+            exr_read_chunks (f, 0, ccount, mcinfos.data (), NULL));
+
+        if (mode == EXR_READ_FILE_MMAP)
+        {
+            off = 0;
+            for (int32_t c = 0; c < ccount; ++c)
+            {
+                EXRCORE_TEST_RVAL (
+                    exr_read_chunk_mapped (f, 0, &(mcinfos[c]), &mapped));
+                EXRCORE_TEST (
+                    memcmp (
+                        mapped,
+                        refpacked.data () + off,
+                        mcinfos[c].packed_size) == 0);
+                off += mcinfos[c].packed_size;
+            }
+        }
+
+        std::vector<uint8_t> pix (csize * ccount, 0);
+        ParallelDest         dest = {pix.data (), csize};
+        EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+            f, 0, 0, ccount, &parallel_setup, &dest, NULL, 2, NULL));
+        EXRCORE_TEST (pix == refpix);
+
+        exr_finish (&f);
+    }
+}
+
+void
+testReadBackends (const std::string& tempdir)
+{
+    std::string fn = ILM_IMF_TEST_IMAGEDIR;
+    testReadBackendFile (fn + "comp_none.exr");
+    testReadBackendFile (fn + "comp_zip.exr");
+    testReadBackendFile (fn + "comp_b44.exr");
+    testReadBackendFile (fn + "comp_dwab_v2.exr");
+}
+
+struct MemStream
+{
+    std::vector<uint8_t> bytes;
+    int                  reads;
+    int                  vecreads;
+};
+
+static int64_t
+mem_read (
+    exr_const_context_t,
+    void*    ud,
+    void*    buf,
+    uint64_t sz,
+    uint64_t offset,
+    exr_stream_error_func_ptr_t)
+{
+    MemStream* ms = static_cast<MemStream*> (ud);
+    ++ms->reads;
+    if (offset >= ms->bytes.size ()) return 0;
+    sz = std::min (sz, (uint64_t) ms->bytes.size () - offset);
+    memcpy (buf, ms->bytes.data () + offset, sz);
+    return (int64_t) sz;
+}
+
+static int64_t
+mem_read_vec (
+    exr_const_context_t,
+    void*               ud,
+    const exr_io_vec_t* vecs,
+    int                 count,
+    uint64_t            offset,
+    exr_stream_error_func_ptr_t)
+{
+    MemStream* ms   = static_cast<MemStream*> (ud);
+    uint64_t   done = 0;
+    ++ms->vecreads;
+    for (int v = 0; v < count; ++v)
+    {
+        uint64_t pos = offset + done;
+        uint64_t sz  = vecs[v].size;
+        if (pos >= ms->bytes.size ()) break;
+        sz = std::min (sz, (uint64_t) ms->bytes.size () - pos);
+        memcpy (vecs[v].buffer, ms->bytes.data () + pos, sz);
+        done += sz;
+        if (sz < vecs[v].size) break;
+    }
+    return (int64_t) done;
+}
+
+static int64_t
+mem_size (exr_const_context_t, void* ud)
+{
+    return (int64_t) static_cast<MemStream*> (ud)->bytes.size ();
+}
+
+void
+testReadChunksVectored (const std::string& tempdir)
+{
+    std::string fn = ILM_IMF_TEST_IMAGEDIR;
+    fn += "comp_zip.exr";
+
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    std::vector<exr_chunk_info_t> cinfos;
+    std::vector<uint8_t>          refpacked;
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    readAllPacked (f, cinfos, refpacked);
+    exr_finish (&f);
+
+    MemStream ms;
+    {
+        FILE* fp = fopen (fn.c_str (), "rb");
+        EXRCORE_TEST (fp != NULL);
+        uint8_t buf[4096];
+        size_t  n;
+        while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+            ms.bytes.insert (ms.bytes.end (), buf, buf + n);
+        fclose (fp);
+    }
+    ms.reads    = 0;
+    ms.vecreads = 0;
+
+    cinit.user_data   = &ms;
+    cinit.read_fn     = &mem_read;
+    cinit.size_fn     = &mem_size;
+    cinit.read_vec_fn = &mem_read_vec;
+    EXRCORE_TEST_RVAL (exr_start_read (&f, "<memory>", &cinit));
+
+    // ask for the chunks backwards, they still make one request
+    int32_t                       ccount = (int32_t) cinfos.size ();
+    std::vector<uint8_t>          batch (refpacked.size (), 0);
+    std::vector<exr_chunk_info_t> rcinfos (ccount);
+    std::vector<void*>            bufs (ccount);
+    uint64_t                      off = 0;
+    for (int32_t c = 0; c < ccount; ++c)
+    {
+        rcinfos[ccount - 1 - c] = cinfos[c];
+        bufs[ccount - 1 - c]    = batch.data () + off;
+        off += cinfos[c].packed_size;
+    }
+    ms.reads = 0;
+    EXRCORE_TEST_RVAL (
+        exr_read_chunks (f, 0, ccount, rcinfos.data (), bufs.data ()));
+    EXRCORE_TEST (batch == refpacked);
+    EXRCORE_TEST (ms.vecreads == 1);
+    EXRCORE_TEST (ms.reads == 0);
+
+    // chunks far apart are separate requests
+    std::fill (batch.begin (), batch.end (), 0);
+    exr_chunk_info_t ends[2] = {cinfos[0], cinfos[ccount - 1]};
+    void*            endbufs[2] = {
+        batch.data (),
+        batch.data () + refpacked.size () - cinfos[ccount - 1].packed_size};
+    ms.vecreads = 0;
+    EXRCORE_TEST_RVAL (exr_read_chunks (f, 0, 2, ends, endbufs));
+    EXRCORE_TEST (ms.vecreads == (ccount > 2 ? 2 : 1));
+    EXRCORE_TEST (
+        memcmp (batch.data (), refpacked.data (), cinfos[0].packed_size) == 0);
+
+    // a truncated file is an error for compressed data
+    ms.bytes.resize (cinfos[ccount - 1].data_offset + 1);
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_READ_IO,
+        exr_read_chunks (f, 0, ccount, rcinfos.data (), bufs.data ()));
+
+    exr_finish (&f);
+}
+
+////////////////////////////////////////
+
+static const int kUnpackW = 37;
+static const int kUnpackH = 16;
+
+static uint32_t
+unpackTestBits (uint32_t& state, exr_pixel_type_t t)
+{
+    state      = state * 1664525u + 1013904223u;
+    uint32_t r = state;
+    state      = state * 1664525u + 1013904223u;
+    uint32_t m = state;
+
+    switch (t)
+    {
+        case EXR_PIXEL_HALF: return m >> 16;
+        case EXR_PIXEL_FLOAT:
+            // mostly around the half range (including its denormals and
+            // overflow), but any bit pattern now and then
+            if ((r & 0x7) == 0) return m;
+            return (m & 0x807fffff) | ((100 + (r >> 8) % 45) << 23);
+        default: return m;
+    }
+}
+
+static void
+writeUnpackFile (
+    const std::string&           fn,
+    int                          nc,
+    exr_pixel_type_t             t,
+    const std::vector<uint32_t>& vals)
+{
+    static const char* names[] = {"A", "B", "C", "D"};
+    exr_context_t             f;
+    int                       partidx;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    size_t               bpe   = (t == EXR_PIXEL_HALF) ? 2 : 4;
+    size_t               plane = (size_t) kUnpackW * kUnpackH;
+    std::vector<uint8_t> src (plane * nc * bpe);
+    for (size_t i = 0; i < plane * nc; ++i)
+    {
+        if (bpe == 2)
+        {
+            uint16_t v = (uint16_t) vals[i];
+            memcpy (src.data () + i * 2, &v, 2);
+        }
+        else
+            memcpy (src.data () + i * 4, &vals[i], 4);
+    }
+
+    EXRCORE_TEST_RVAL (exr_start_write (
+        &f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "scan", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, kUnpackW, kUnpackH, EXR_COMPRESSION_ZIP));
+    for (int c = 0; c < nc; ++c)
+    {
+        EXRCORE_TEST_RVAL (exr_add_channel (
+            f, partidx, names[c], t, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    }
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+
+    exr_chunk_info_t      cinfo;
+    exr_encode_pipeline_t encoder;
+    EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, partidx, 0, &cinfo));
+    EXRCORE_TEST_RVAL (exr_encoding_initialize (f, partidx, &cinfo, &encoder));
+    EXRCORE_TEST (encoder.channel_count == nc);
+    for (int c = 0; c < nc; ++c)
+    {
+        encoder.channels[c].encode_from_ptr   = src.data () + c * plane * bpe;
+        encoder.channels[c].user_pixel_stride = (int32_t) bpe;
+        encoder.channels[c].user_line_stride  = (int32_t) (kUnpackW * bpe);
+    }
+    EXRCORE_TEST_RVAL (exr_encoding_choose_default_routines (f, 0, &encoder));
+    EXRCORE_TEST_RVAL (exr_encoding_run (f, 0, &encoder));
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+static bool
+unpackValueMatches (
+    exr_pixel_type_t ft, exr_pixel_type_t ot, uint32_t bits, const uint8_t* p)
+{
+    if (ft == ot)
+    {
+        if (ot == EXR_PIXEL_HALF)
+        {
+            uint16_t v;
+            memcpy (&v, p, 2);
+            return v == (uint16_t) bits;
+        }
+        uint32_t v;
+        memcpy (&v, p, 4);
+        return v == bits;
+    }
+
+    if (ft == EXR_PIXEL_HALF && ot == EXR_PIXEL_FLOAT)
+    {
+        half h;
+        h.setBits ((uint16_t) bits);
+        float v;
+        memcpy (&v, p, 4);
+        // the hardware conversions quiet signaling NaN
+        if (h.isNan ()) return isnan (v);
+        float e = h;
+        return memcmp (&e, &v, 4) == 0;
+    }
+
+    if (ft == EXR_PIXEL_FLOAT && ot == EXR_PIXEL_HALF)
+    {
+        float fv;
+        memcpy (&fv, &bits, 4);
+        half v;
+        uint16_t hb;
+        memcpy (&hb, p, 2);
+        v.setBits (hb);
+        if (isnan (fv)) return v.isNan ();
+        return half (fv).bits () == hb;
+    }
+    return false;
+}
+
+static void
+testUnpackLayout (
+    exr_context_t                f,
+    const exr_chunk_info_t&      cinfo,
+    int                          nc,
+    exr_pixel_type_t             ft,
+    exr_pixel_type_t             ot,
+    int                          layout,
+    const std::vector<uint32_t>& vals)
+{
+    static const char* layoutnames[] = {
+        "interleaved", "reversed", "planar", "padded"};
+    const int  guard = 64;
+    const bool planar = (layout == 2);
+    size_t     obpe   = (ot == EXR_PIXEL_HALF) ? 2 : 4;
+    size_t     plane  = (size_t) kUnpackW * kUnpackH;
+    size_t     pixstride, linestride, total;
+
+    if (planar)
+    {
+        pixstride  = obpe;
+        linestride = kUnpackW * obpe;
+        total      = plane * nc * obpe;
+    }
+    else
+    {
+        pixstride  = nc * obpe + (layout == 3 ? 4 : 0);
+        linestride = kUnpackW * pixstride;
+        total      = kUnpackH * linestride;
+    }
+
+    std::vector<uint8_t> buf (total + guard, 0xEE);
+
+    exr_decode_pipeline_t decoder;
+    EXRCORE_TEST_RVAL (exr_decoding_initialize (f, 0, &cinfo, &decoder));
+    EXRCORE_TEST (decoder.channel_count == nc);
+    for (int c = 0; c < nc; ++c)
+    {
+        exr_coding_channel_info_t& outc = decoder.channels[c];
+        int slot = (layout == 1) ? (nc - 1 - c) : c;
+
+        if (planar)
+            outc.decode_to_ptr = buf.data () + c * plane * obpe;
+        else
+            outc.decode_to_ptr = buf.data () + slot * obpe;
+        outc.user_pixel_stride      = (int32_t) pixstride;
+        outc.user_line_stride       = (int32_t) linestride;
+        outc.user_bytes_per_element = (int16_t) obpe;
+        outc.user_data_type         = (uint16_t) ot;
+    }
+    EXRCORE_TEST_RVAL (exr_decoding_choose_default_routines (f, 0, &decoder));
+    EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+
+    int bad = 0;
+    for (int c = 0; c < nc; ++c)
+    {
+        const uint8_t* base = decoder.channels[c].decode_to_ptr;
+        for (int y = 0; y < kUnpackH; ++y)
+        {
+            for (int x = 0; x < kUnpackW; ++x)
+            {
+                uint32_t       bits = vals[c * plane + y * kUnpackW + x];
+                const uint8_t* p    = base + y * linestride + x * pixstride;
+                if (!unpackValueMatches (ft, ot, bits, p))
+                {
+                    if (bad++ < 4)
+                        std::cerr << "  unpack " << layoutnames[layout]
+                                  << " nc " << nc << " type " << (int) ft
+                                  << " -> " << (int) ot << " mismatch ch "
+                                  << c << " at " << x << ", " << y
+                                  << " file bits 0x" << std::hex << bits
+                                  << std::dec << std::endl;
+                }
+            }
+        }
+    }
+    EXRCORE_TEST (bad == 0);
+
+    // nothing outside the requested values is written
+    for (int g = 0; g < guard; ++g)
+        EXRCORE_TEST (buf[total + g] == 0xEE);
+    if (layout == 3)
+    {
+        for (int y = 0; y < kUnpackH; ++y)
+            for (int x = 0; x < kUnpackW; ++x)
+                for (size_t b = nc * obpe; b < pixstride; ++b)
+                    EXRCORE_TEST (
+                        buf[y * linestride + x * pixstride + b] == 0xEE);
+    }
+
+    EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+}
+
+void
+testReadUnpackLayouts (const std::string& tempdir)
+{
+    std::string fn = tempdir + "core_unpack_layouts.exr";
+
+    for (int nc = 3; nc <= 4; ++nc)
+    {
+        for (int ti = 0; ti < 3; ++ti)
+        {
+            exr_pixel_type_t ft    = (exr_pixel_type_t) ti;
+            uint32_t         state = 0x1234567u + (uint32_t) (nc * 3 + ti);
+            std::vector<uint32_t> vals ((size_t) kUnpackW * kUnpackH * nc);
+            for (auto& v: vals)
+                v = unpackTestBits (state, ft);
+
+            writeUnpackFile (fn, nc, ft, vals);
+
+            exr_context_t             f;
+            exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+            cinit.error_handler_fn          = &err_cb;
+            EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+            exr_chunk_info_t cinfo;
+            EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, 0, &cinfo));
+
+            exr_pixel_type_t outtypes[2] = {ft, ft};
+            if (ft == EXR_PIXEL_HALF) outtypes[1] = EXR_PIXEL_FLOAT;
+            if (ft == EXR_PIXEL_FLOAT) outtypes[1] = EXR_PIXEL_HALF;
+
+            for (int o = 0; o < (ft == EXR_PIXEL_UINT ? 1 : 2); ++o)
+                for (int layout = 0; layout < 4; ++layout)
+                    testUnpackLayout (
+                        f, cinfo, nc, ft, outtypes[o], layout, vals);
+
+            exr_finish (&f);
+        }
+    }
+    remove (fn.c_str ());
+}
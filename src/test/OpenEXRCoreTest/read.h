@@ -18,8 +18,14 @@ void testOpenDeep (const std::string& tempdir);
 
 void testReadScans (const std::string& tempdir);
 void testReadTiles (const std::string& tempdir);
+void testReadRipMapTiles (const std::string& tempdir);
 void testReadMultiPart (const std::string& tempdir);
 
 void testReadUnpack (const std::string& tempdir);
 
+void testReadParallel (const std::string& tempdir);
+void testReadBackends (const std::string& tempdir);
+void testReadChunksVectored (const std::string& tempdir);
+void testReadUnpackLayouts (const std::string& tempdir);
+
 #endif // OPENEXR_CORE_TEST_READ_H
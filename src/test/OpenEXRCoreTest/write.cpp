@@ -15,6 +15,9 @@
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <vector>
+
+#include <half.h>
 
 static void
 err_cb (exr_const_context_t f, exr_result_t code, const char* msg)
@@ -1370,3 +1373,485 @@ testWriteMultiPart (const std::string& tempdir)
     EXRCORE_TEST_RVAL (exr_finish (&outf));
     remove (outfn.c_str ());
 }
+
+////////////////////////////////////////
+
+static const int kPackW = 41;
+static const int kPackH = 40;
+
+static uint32_t
+packTestBits (uint32_t& state, exr_pixel_type_t t)
+{
+    state      = state * 1664525u + 1013904223u;
+    uint32_t r = state;
+    state      = state * 1664525u + 1013904223u;
+    uint32_t m = state;
+
+    switch (t)
+    {
+        case EXR_PIXEL_HALF: return m >> 16;
+        case EXR_PIXEL_FLOAT:
+            // mostly around the half range (including its denormals and
+            // overflow), but any bit pattern now and then
+            if ((r & 0x7) == 0) return m;
+            return (m & 0x807fffff) | ((100 + (r >> 8) % 45) << 23);
+        default: return m;
+    }
+}
+
+static bool
+packValueMatches (
+    exr_pixel_type_t ft, exr_pixel_type_t ut, uint32_t bits, uint32_t filev)
+{
+    if (ft == ut)
+        return (ft == EXR_PIXEL_HALF) ? (filev == (bits & 0xffff))
+                                      : (filev == bits);
+
+    // float -> half
+    float fv;
+    memcpy (&fv, &bits, 4);
+    half v;
+    v.setBits ((uint16_t) filev);
+    if (isnan (fv)) return v.isNan ();
+    return half (fv).bits () == (uint16_t) filev;
+}
+
+// layouts: 0 interleaved, 1 reversed, 2 planar, 3 padded
+static void
+testPackLayout (
+    const std::string&           fn,
+    int                          nc,
+    exr_pixel_type_t             ft,
+    exr_pixel_type_t             ut,
+    int                          layout,
+    const std::vector<uint32_t>& vals)
+{
+    static const char* names[]       = {"A", "B", "C", "D"};
+    static const char* layoutnames[] = {
+        "interleaved", "reversed", "planar", "padded"};
+    exr_context_t             f;
+    int                       partidx;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    size_t ubpe  = (ut == EXR_PIXEL_HALF) ? 2 : 4;
+    size_t plane = (size_t) kPackW * kPackH;
+    size_t pixstride, linestride;
+    if (layout == 2)
+    {
+        pixstride  = ubpe;
+        linestride = kPackW * ubpe;
+    }
+    else
+    {
+        pixstride  = nc * ubpe + (layout == 3 ? 4 : 0);
+        linestride = kPackW * pixstride;
+    }
+
+    std::vector<uint8_t> src (layout == 2 ? plane * nc * ubpe
+                                          : kPackH * linestride);
+    std::vector<uint8_t*> chanptr (nc);
+    for (int c = 0; c < nc; ++c)
+    {
+        int slot = (layout == 1) ? (nc - 1 - c) : c;
+        if (layout == 2)
+            chanptr[c] = src.data () + c * plane * ubpe;
+        else
+            chanptr[c] = src.data () + slot * ubpe;
+
+        for (int y = 0; y < kPackH; ++y)
+        {
+            for (int x = 0; x < kPackW; ++x)
+            {
+                uint32_t bits = vals[c * plane + y * kPackW + x];
+                uint8_t* p    = chanptr[c] + y * linestride + x * pixstride;
+                if (ubpe == 2)
+                {
+                    uint16_t v = (uint16_t) bits;
+                    memcpy (p, &v, 2);
+                }
+                else
+                    memcpy (p, &bits, 4);
+            }
+        }
+    }
+
+    EXRCORE_TEST_RVAL (exr_start_write (
+        &f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "scan", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        f, partidx, kPackW, kPackH, EXR_COMPRESSION_ZIP));
+    for (int c = 0; c < nc; ++c)
+    {
+        EXRCORE_TEST_RVAL (exr_add_channel (
+            f, partidx, names[c], ft, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    }
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+
+    // as usual, choose the routines once then update the pointers for
+    // each chunk (the last of which is short)
+    int32_t               scansperchunk;
+    exr_chunk_info_t      cinfo;
+    exr_encode_pipeline_t encoder;
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &scansperchunk));
+    for (int y = 0; y < kPackH; y += scansperchunk)
+    {
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, 0, y, &cinfo));
+        if (y == 0)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_encoding_initialize (f, 0, &cinfo, &encoder));
+        }
+        else
+        {
+            EXRCORE_TEST_RVAL (exr_encoding_update (f, 0, &cinfo, &encoder));
+        }
+
+        for (int c = 0; c < nc; ++c)
+        {
+            exr_coding_channel_info_t& encc = encoder.channels[c];
+            encc.encode_from_ptr            = chanptr[c] + y * linestride;
+            encc.user_pixel_stride          = (int32_t) pixstride;
+            encc.user_line_stride           = (int32_t) linestride;
+            encc.user_bytes_per_element     = (int16_t) ubpe;
+            encc.user_data_type             = (uint16_t) ut;
+        }
+        if (y == 0)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_encoding_choose_default_routines (f, 0, &encoder));
+        }
+        EXRCORE_TEST_RVAL (exr_encoding_run (f, 0, &encoder));
+    }
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+
+    // read back as stored
+    size_t               fbpe = (ft == EXR_PIXEL_HALF) ? 2 : 4;
+    std::vector<uint8_t> restore (plane * nc * fbpe);
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    for (int y = 0; y < kPackH; y += scansperchunk)
+    {
+        exr_decode_pipeline_t decoder;
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        EXRCORE_TEST_RVAL (exr_decoding_initialize (f, 0, &cinfo, &decoder));
+        for (int c = 0; c < nc; ++c)
+        {
+            exr_coding_channel_info_t& outc = decoder.channels[c];
+            outc.decode_to_ptr =
+                restore.data () + (c * plane + y * kPackW) * fbpe;
+            outc.user_pixel_stride      = (int32_t) fbpe;
+            outc.user_line_stride       = (int32_t) (kPackW * fbpe);
+            outc.user_bytes_per_element = (int16_t) fbpe;
+            outc.user_data_type         = (uint16_t) ft;
+        }
+        EXRCORE_TEST_RVAL (
+            exr_decoding_choose_default_routines (f, 0, &decoder));
+        EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+        EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+    }
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+
+    int bad = 0;
+    for (size_t i = 0; i < plane * nc; ++i)
+    {
+        uint32_t filev = 0;
+        if (fbpe == 2)
+        {
+            uint16_t v;
+            memcpy (&v, restore.data () + i * 2, 2);
+            filev = v;
+        }
+        else
+            memcpy (&filev, restore.data () + i * 4, 4);
+
+        if (!packValueMatches (ft, ut, vals[i], filev))
+        {
+            if (bad++ < 4)
+                std::cerr << "  pack " << layoutnames[layout] << " nc " << nc
+                          << " type " << (int) ut << " -> " << (int) ft
+                          << " mismatch at " << i << " user bits 0x"
+                          << std::hex << vals[i] << " file 0x" << filev
+                          << std::dec << std::endl;
+        }
+    }
+    EXRCORE_TEST (bad == 0);
+}
+
+void
+testWritePackLayouts (const std::string& tempdir)
+{
+    std::string fn = tempdir + "core_pack_layouts.exr";
+    // file type, user type
+    const exr_pixel_type_t combos[4][2] = {
+        {EXR_PIXEL_HALF, EXR_PIXEL_HALF},
+        {EXR_PIXEL_FLOAT, EXR_PIXEL_FLOAT},
+        {EXR_PIXEL_UINT, EXR_PIXEL_UINT},
+        {EXR_PIXEL_HALF, EXR_PIXEL_FLOAT}};
+
+    for (int nc = 3; nc <= 4; ++nc)
+    {
+        for (int t = 0; t < 4; ++t)
+        {
+            uint32_t state = 0x7654321u + (uint32_t) (nc * 4 + t);
+            std::vector<uint32_t> vals ((size_t) kPackW * kPackH * nc);
+            for (auto& v: vals)
+                v = packTestBits (state, combos[t][1]);
+
+            for (int layout = 0; layout < 4; ++layout)
+                testPackLayout (
+                    fn, nc, combos[t][0], combos[t][1], layout, vals);
+        }
+    }
+    remove (fn.c_str ());
+}
+
+////////////////////////////////////////
+
+static const int kParW = 77;
+static const int kParH = 131;
+
+struct ParallelSource
+{
+    // channel A is half, B is float, both planar over the full image
+    uint8_t* planes[2];
+    int      fail_chunk;
+};
+
+// the chunk start is in tiles for tiled parts (16x16, one level)
+static size_t
+parallelChunkOffset (const exr_chunk_info_t& chunk)
+{
+    int scale = (chunk.type == EXR_STORAGE_TILED) ? 16 : 1;
+    return (size_t) chunk.start_y * scale * kParW +
+           (size_t) chunk.start_x * scale;
+}
+
+static exr_result_t
+parallel_encode_setup (
+    exr_encode_pipeline_t* encode, int chunk_index, void* ud)
+{
+    ParallelSource* src = static_cast<ParallelSource*> (ud);
+
+    if (chunk_index == src->fail_chunk) return EXR_ERR_INVALID_ARGUMENT;
+
+    for (int c = 0; c < encode->channel_count; ++c)
+    {
+        exr_coding_channel_info_t& encc = encode->channels[c];
+        size_t bpe = (c == 0) ? 2 : 4;
+
+        encc.encode_from_ptr =
+            src->planes[c] + parallelChunkOffset (encode->chunk) * bpe;
+        encc.user_pixel_stride      = (int32_t) bpe;
+        encc.user_line_stride       = (int32_t) (kParW * bpe);
+        encc.user_bytes_per_element = (int16_t) bpe;
+        encc.user_data_type =
+            (uint16_t) ((c == 0) ? EXR_PIXEL_HALF : EXR_PIXEL_FLOAT);
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+parallel_decode_setup (
+    exr_decode_pipeline_t* decode, int chunk_index, void* ud)
+{
+    ParallelSource* dst = static_cast<ParallelSource*> (ud);
+
+    for (int c = 0; c < decode->channel_count; ++c)
+    {
+        exr_coding_channel_info_t& outc = decode->channels[c];
+        size_t bpe = (c == 0) ? 2 : 4;
+
+        outc.decode_to_ptr =
+            dst->planes[c] + parallelChunkOffset (decode->chunk) * bpe;
+        outc.user_pixel_stride      = (int32_t) bpe;
+        outc.user_line_stride       = (int32_t) (kParW * bpe);
+        outc.user_bytes_per_element = (int16_t) bpe;
+        outc.user_data_type =
+            (uint16_t) ((c == 0) ? EXR_PIXEL_HALF : EXR_PIXEL_FLOAT);
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+static void
+startParallelFile (
+    exr_context_t*                   f,
+    const std::string&               fn,
+    const exr_context_initializer_t& cinit,
+    bool                             tiled,
+    exr_lineorder_t                  lo,
+    exr_compression_t                comp)
+{
+    int partidx;
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (exr_add_part (
+        *f,
+        "par",
+        tiled ? EXR_STORAGE_TILED : EXR_STORAGE_SCANLINE,
+        &partidx));
+    EXRCORE_TEST_RVAL (exr_initialize_required_attr_simple (
+        *f, partidx, kParW, kParH, comp));
+    EXRCORE_TEST_RVAL (exr_set_lineorder (*f, partidx, lo));
+    if (tiled)
+    {
+        EXRCORE_TEST_RVAL (exr_set_tile_descriptor (
+            *f, partidx, 16, 16, EXR_TILE_ONE_LEVEL, EXR_TILE_ROUND_DOWN));
+    }
+    EXRCORE_TEST_RVAL (exr_add_channel (
+        *f, partidx, "A", EXR_PIXEL_HALF, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    EXRCORE_TEST_RVAL (exr_add_channel (
+        *f, partidx, "B", EXR_PIXEL_FLOAT, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    EXRCORE_TEST_RVAL (exr_write_header (*f));
+}
+
+static void
+testParallelWrite (
+    const std::string&    fn,
+    bool                  tiled,
+    exr_lineorder_t       lo,
+    exr_compression_t     comp,
+    int                   max_workers,
+    std::vector<uint8_t>& a,
+    std::vector<uint8_t>& b)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+    int32_t        ccount;
+    ParallelSource src = {{a.data (), b.data ()}, -1};
+
+    startParallelFile (&f, fn, cinit, tiled, lo, comp);
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST (ccount > 4);
+
+    std::vector<exr_result_t> results (ccount);
+    EXRCORE_TEST_RVAL (exr_encode_chunks_parallel (
+        f,
+        0,
+        0,
+        ccount,
+        &parallel_encode_setup,
+        &src,
+        NULL,
+        max_workers,
+        results.data ()));
+    for (int c = 0; c < ccount; ++c)
+        EXRCORE_TEST (results[c] == EXR_ERR_SUCCESS);
+    // all chunks are out, nothing more to write
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_NOT_OPEN_WRITE,
+        exr_encode_chunks_parallel (
+            f, 0, 0, 1, &parallel_encode_setup, &src, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+
+    std::vector<uint8_t> ra (a.size (), 0), rb (b.size (), 0);
+    ParallelSource       dst = {{ra.data (), rb.data ()}, -1};
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 0, ccount, &parallel_decode_setup, &dst, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+
+    EXRCORE_TEST (ra == a);
+    EXRCORE_TEST (rb == b);
+}
+
+void
+testWriteParallelChunks (const std::string& tempdir)
+{
+    std::string fn    = tempdir + "core_parallel_write.exr";
+    size_t      npix  = (size_t) kParW * kParH;
+    uint32_t    state = 0x1234567u;
+
+    std::vector<uint8_t> a (npix * 2), b (npix * 4);
+    for (size_t i = 0; i < npix; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        // smooth enough to compress, with some noise
+        half  hv ((float) (i % kParW) * 0.125f + (float) (state >> 29));
+        float fv = (float) (i / kParW) * 0.5f + (float) (state >> 24);
+        uint16_t hb = hv.bits ();
+        memcpy (a.data () + i * 2, &hb, 2);
+        memcpy (b.data () + i * 4, &fv, 4);
+    }
+
+    const exr_lineorder_t orders[2] = {
+        EXR_LINEORDER_INCREASING_Y, EXR_LINEORDER_RANDOM_Y};
+    for (int tiled = 0; tiled < 2; ++tiled)
+    {
+        for (int o = 0; o < 2; ++o)
+        {
+            // default worker count, then a single (serial) worker
+            testParallelWrite (
+                fn, tiled != 0, orders[o], EXR_COMPRESSION_ZIPS, 0, a, b);
+            testParallelWrite (
+                fn, tiled != 0, orders[o], EXR_COMPRESSION_PIZ, 1, a, b);
+            testParallelWrite (
+                fn, tiled != 0, orders[o], EXR_COMPRESSION_NONE, 3, a, b);
+        }
+    }
+
+    // when ordered, the range has to start with the next chunk to
+    // write, and a failing chunk fails the ones after it rather than
+    // leaving them waiting
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+    int32_t        ccount;
+    ParallelSource src = {{a.data (), b.data ()}, -1};
+
+    startParallelFile (
+        &f, fn, cinit, false, EXR_LINEORDER_INCREASING_Y, EXR_COMPRESSION_ZIP);
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_ARGUMENT_OUT_OF_RANGE,
+        exr_encode_chunks_parallel (
+            f, 0, 1, ccount, &parallel_encode_setup, &src, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_encode_chunks_parallel (
+            f, 0, 0, ccount, NULL, &src, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INCORRECT_CHUNK,
+        exr_encode_chunks_parallel (
+            f, 0, 1, 3, &parallel_encode_setup, &src, NULL, 0, NULL));
+
+    std::vector<exr_result_t> results (ccount);
+    src.fail_chunk = 2;
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_encode_chunks_parallel (
+            f,
+            0,
+            0,
+            ccount,
+            &parallel_encode_setup,
+            &src,
+            NULL,
+            4,
+            results.data ()));
+    EXRCORE_TEST (results[0] == EXR_ERR_SUCCESS);
+    EXRCORE_TEST (results[1] == EXR_ERR_SUCCESS);
+    EXRCORE_TEST (results[2] == EXR_ERR_INVALID_ARGUMENT);
+    for (int c = 3; c < ccount; ++c)
+        EXRCORE_TEST (results[c] == EXR_ERR_INCORRECT_CHUNK);
+
+    // and carries on from the failed chunk
+    src.fail_chunk = -1;
+    EXRCORE_TEST_RVAL (exr_encode_chunks_parallel (
+        f, 0, 2, ccount - 2, &parallel_encode_setup, &src, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+
+    std::vector<uint8_t> ra (a.size (), 0), rb (b.size (), 0);
+    ParallelSource       dst = {{ra.data (), rb.data ()}, -1};
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_decode_chunks_parallel (
+        f, 0, 0, ccount, &parallel_decode_setup, &dst, NULL, 0, NULL));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+    EXRCORE_TEST (ra == a);
+    EXRCORE_TEST (rb == b);
+
+    remove (fn.c_str ());
+}
@@ -23,4 +23,7 @@ void testWriteScans (const std::string& tempdir);
 void testWriteTiles (const std::string& tempdir);
 void testWriteMultiPart (const std::string& tempdir);
 
+void testWritePackLayouts (const std::string& tempdir);
+void testWriteParallelChunks (const std::string& tempdir);
+
 #endif // OPENEXR_CORE_TEST_WRITE_H
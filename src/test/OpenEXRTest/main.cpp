@@ -10,11 +10,13 @@
 #include "ImfNamespace.h"
 #include "OpenEXRConfigInternal.h"
 
+#include "testAsyncReader.h"
 #include "testAttributes.h"
 #include "testB44ExpLogTable.h"
 #include "testBackwardCompatibility.h"
 #include "testBadTypeAttributes.h"
 #include "testChannels.h"
+#include "testChunkOffsetCache.h"
 #include "testCompositeDeepScanLine.h"
 #include "testCompression.h"
 #include "testConversion.h"
@@ -23,6 +25,9 @@
 #include "testCopyMultiPartFile.h"
 #include "testCopyPixels.h"
 #include "testCustomAttributes.h"
+#include "testDecodedChannels.h"
+#include "testDeepSampleArena.h"
+#include "testDeepSampleCounts.h"
 #include "testDeepScanLineBasic.h"
 #include "testDeepScanLineHuge.h"
 #include "testDeepScanLineMultipleRead.h"
@@ -58,14 +63,20 @@
 #include "testScanLineApi.h"
 #include "testSharedFrameBuffer.h"
 #include "testStandardAttributes.h"
+#include "testTileCache.h"
 #include "testTiledCompression.h"
 #include "testTiledCopyPixels.h"
 #include "testTiledLineOrder.h"
+#include "testTiledReorderBuffer.h"
 #include "testTiledRgba.h"
+#include "testTiledWindow.h"
 #include "testTiledYa.h"
 #include "testWav.h"
+#include "testWritePipeline.h"
+#include "testWorkStealingThreadPool.h"
 #include "testXdr.h"
 #include "testYca.h"
+#include "testYcaStrips.h"
 
 #include "ImathRandom.h"
 #include "tmpDir.h"
@@ -197,22 +208,32 @@ main (int argc, char* argv[])
     TEST (testTiledCopyPixels, "basic");
     TEST (testTiledCompression, "basic");
     TEST (testTiledLineOrder, "basic");
+    TEST (testTiledReorderBuffer, "basic");
+    TEST (testTileCache, "basic");
+    TEST (testTiledWindow, "basic");
+    TEST (testAsyncReader, "basic");
+    TEST (testDecodedChannels, "basic");
     TEST (testScanLineApi, "basic");
+    TEST (testWritePipeline, "basic");
     TEST (testExistingStreams, "core");
     TEST (testStandardAttributes, "core");
     TEST (testOptimized, "basic");
     TEST (testOptimizedInterleavePatterns, "basic");
     TEST (testYca, "basic");
+    TEST (testYcaStrips, "basic");
     TEST (testTiledYa, "basic");
     TEST (testNativeFormat, "basic");
     TEST (testMultiView, "basic");
     TEST (testIsComplete, "basic");
+    TEST (testChunkOffsetCache, "basic");
     TEST (testDeepScanLineBasic, "deep");
     TEST (testCopyDeepScanLine, "deep");
     TEST (testDeepScanLineMultipleRead, "deep");
     TEST (testDeepTiledBasic, "deep");
     TEST (testCopyDeepTiled, "deep");
     TEST (testCompositeDeepScanLine, "deep");
+    TEST (testDeepSampleArena, "deep");
+    TEST (testDeepSampleCounts, "deep");
     TEST (testMultiPartFileMixingBasic, "multi");
     TEST (testInputPart, "multi");
     TEST (testPartHelper, "multi");
@@ -230,6 +251,7 @@ main (int argc, char* argv[])
     TEST (testB44ExpLogTable, "core");
     TEST (testDwaLookups, "core");
     TEST (testIDManifest, "core");
+    TEST (testWorkStealingThreadPool, "core");
 
     // NB: If you add a test here, make sure to enumerate it in the
     // CMakeLists.txt so it runs as part of the test suite
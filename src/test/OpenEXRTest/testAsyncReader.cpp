@@ -0,0 +1,492 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <Iex.h>
+#include <IlmThread.h>
+#include <ImfAsyncReader.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfMMapIO.h>
+#include <ImfMisc.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfOutputPart.h>
+#include <ImfPartType.h>
+#include <ImfThreading.h>
+#include <ImfTiledOutputFile.h>
+#include <ImfTiledOutputPart.h>
+
+#include <assert.h>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+const int numFrames = 6;
+
+float
+pixelValue (int frame, int part, int x, int y)
+{
+    return frame * 1000000.f + part * 100000.f + y * 500.f + x;
+}
+
+//
+// Each frame has a different data window, so that a reader must
+// look at the header to allocate its frame buffer.
+//
+
+Box2i
+frameDataWindow (int frame)
+{
+    return Box2i (V2i (-3 + frame, 2 - frame), V2i (80 + 7 * frame, 40 + frame));
+}
+
+string
+frameName (const string& tempDir, const char kind[], int frame)
+{
+    stringstream s;
+    s << tempDir << "imf_test_async_reader_" << kind << "_" << frame << ".exr";
+    return s.str ();
+}
+
+Header
+frameHeader (int frame)
+{
+    Header header;
+    header.dataWindow ()    = frameDataWindow (frame);
+    header.displayWindow () = header.dataWindow ();
+    header.channels ().insert ("Y", Channel (FLOAT));
+    header.compression () = ZIP_COMPRESSION;
+    return header;
+}
+
+struct Pixels
+{
+    Box2i         dataWindow;
+    vector<float> y;
+
+    void allocate (const Box2i& dw)
+    {
+        dataWindow = dw;
+        y.assign (
+            size_t (dw.max.x - dw.min.x + 1) * (dw.max.y - dw.min.y + 1), -1.f);
+    }
+
+    int width () const { return dataWindow.max.x - dataWindow.min.x + 1; }
+
+    FrameBuffer frameBuffer ()
+    {
+        intptr_t o = dataWindow.min.x + intptr_t (dataWindow.min.y) * width ();
+
+        FrameBuffer fb;
+        fb.insert (
+            "Y",
+            Slice (
+                FLOAT,
+                (char*) (&y[0] - o),
+                sizeof (float),
+                sizeof (float) * width ()));
+        return fb;
+    }
+
+    void fill (int frame, int part)
+    {
+        for (int j = dataWindow.min.y; j <= dataWindow.max.y; ++j)
+            for (int i = dataWindow.min.x; i <= dataWindow.max.x; ++i)
+                y[(j - dataWindow.min.y) * width () + i - dataWindow.min.x] =
+                    pixelValue (frame, part, i, j);
+    }
+
+    void check (int frame, int part) const
+    {
+        assert (dataWindow == frameDataWindow (frame));
+
+        for (int j = dataWindow.min.y; j <= dataWindow.max.y; ++j)
+            for (int i = dataWindow.min.x; i <= dataWindow.max.x; ++i)
+                assert (
+                    y[(j - dataWindow.min.y) * width () + i - dataWindow.min.x] ==
+                    pixelValue (frame, part, i, j));
+    }
+};
+
+void
+writeFrames (const string& tempDir)
+{
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        Pixels pixels;
+        pixels.allocate (frameDataWindow (frame));
+        pixels.fill (frame, 0);
+
+        {
+            OutputFile out (
+                frameName (tempDir, "scanline", frame).c_str (),
+                frameHeader (frame));
+            out.setFrameBuffer (pixels.frameBuffer ());
+            out.writePixels (
+                pixels.dataWindow.max.y - pixels.dataWindow.min.y + 1);
+        }
+
+        {
+            Header header = frameHeader (frame);
+            header.setTileDescription (TileDescription (16, 8));
+
+            TiledOutputFile out (
+                frameName (tempDir, "tiled", frame).c_str (), header);
+            out.setFrameBuffer (pixels.frameBuffer ());
+            out.writeTiles (0, out.numXTiles () - 1, 0, out.numYTiles () - 1);
+        }
+
+        //
+        // a scan line part and a tiled part, with different pixels
+        //
+
+        Header headers[2] = {frameHeader (frame), frameHeader (frame)};
+        headers[0].setName ("scanline");
+        headers[0].setType (SCANLINEIMAGE);
+        headers[1].setName ("tiled");
+        headers[1].setType (TILEDIMAGE);
+        headers[1].setTileDescription (TileDescription (8, 8));
+
+        MultiPartOutputFile out (
+            frameName (tempDir, "multipart", frame).c_str (), headers, 2);
+
+        OutputPart part0 (out, 0);
+        part0.setFrameBuffer (pixels.frameBuffer ());
+        part0.writePixels (
+            pixels.dataWindow.max.y - pixels.dataWindow.min.y + 1);
+
+        pixels.fill (frame, 1);
+
+        TiledOutputPart part1 (out, 1);
+        part1.setFrameBuffer (pixels.frameBuffer ());
+        part1.writeTiles (0, part1.numXTiles () - 1, 0, part1.numYTiles () - 1);
+    }
+}
+
+void
+removeFrames (const string& tempDir)
+{
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        remove (frameName (tempDir, "scanline", frame).c_str ());
+        remove (frameName (tempDir, "tiled", frame).c_str ());
+        remove (frameName (tempDir, "multipart", frame).c_str ());
+    }
+}
+
+//
+// Read all frames of a sequence, allocating each frame buffer
+// from the header, and check that the requests complete in order.
+//
+
+void
+readSequence (
+    const string& tempDir,
+    const char    kind[],
+    int           partNumber,
+    int           maxFramesAhead,
+    size_t        maxBytesAhead)
+{
+    cout << kind << " part " << partNumber << ", " << maxFramesAhead
+         << " frames / " << maxBytesAhead << " bytes ahead" << endl;
+
+    vector<Pixels>         pixels (numFrames);
+    vector<future<void>>   results;
+    vector<int>            order;
+    std::mutex             orderMutex;
+
+    {
+        AsyncReader reader (maxFramesAhead, maxBytesAhead);
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            Pixels& p = pixels[frame];
+
+            AsyncReader::Request request;
+            request.fileName   = frameName (tempDir, kind, frame);
+            request.partNumber = partNumber;
+
+            request.prepare = [&p] (const Header& header, FrameBuffer& fb) {
+                p.allocate (header.dataWindow ());
+                fb = p.frameBuffer ();
+            };
+
+            request.done = [frame, &order, &orderMutex] (exception_ptr e) {
+                assert (!e);
+                std::lock_guard<std::mutex> lock (orderMutex);
+                order.push_back (frame);
+            };
+
+            results.push_back (reader.read (request));
+        }
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            results[frame].get ();
+            pixels[frame].check (frame, partNumber);
+        }
+
+        reader.wait ();
+        assert (reader.pending () == 0);
+    }
+
+    assert (order.size () == numFrames);
+
+    for (int frame = 0; frame < numFrames; ++frame)
+        assert (order[frame] == frame);
+}
+
+//
+// Requests that fail do not affect the requests around them
+//
+
+void
+readErrors (const string& tempDir)
+{
+    cout << "errors" << endl;
+
+    AsyncReader reader (2);
+
+    Pixels pixels;
+    pixels.allocate (frameDataWindow (1));
+
+    future<void> missing = reader.read (
+        tempDir + "imf_test_async_reader_missing.exr", pixels.frameBuffer ());
+
+    future<void> badPart = reader.read (
+        frameName (tempDir, "multipart", 1), pixels.frameBuffer (), 2);
+
+    future<void> good = reader.read (
+        frameName (tempDir, "multipart", 1), pixels.frameBuffer (), 1);
+
+    try
+    {
+        missing.get ();
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::BaseExc&)
+    {}
+
+    try
+    {
+        badPart.get ();
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+
+    good.get ();
+    pixels.check (1, 1);
+}
+
+//
+// A file with a missing chunk offset, which the file readers must
+// reconstruct by scanning the whole file, reads the same as the
+// original.
+//
+
+void
+readBrokenOffsets (const string& tempDir)
+{
+    cout << "missing chunk offset" << endl;
+
+    string fileName   = frameName (tempDir, "multipart", 1);
+    string brokenName = frameName (tempDir, "broken", 1);
+
+    size_t numChunks = 0;
+
+    {
+        MultiPartInputFile in (fileName.c_str ());
+
+        for (int i = 0; i < in.parts (); ++i)
+            numChunks += getChunkOffsetTableSize (in.header (i));
+    }
+
+    vector<char> bytes;
+
+    {
+        ifstream in (fileName.c_str (), ios_base::binary);
+        bytes.assign (
+            istreambuf_iterator<char> (in), istreambuf_iterator<char> ());
+    }
+
+    //
+    // The offset tables are followed by the first chunk, so the
+    // first offset is the position just past the tables.
+    //
+
+    size_t tables = 0;
+
+    for (size_t p = 0; p + 8 <= bytes.size () && tables == 0; ++p)
+    {
+        uint64_t offset = 0;
+
+        for (int i = 7; i >= 0; --i)
+            offset = (offset << 8) | (unsigned char) bytes[p + i];
+
+        if (offset == p + 8 * numChunks) tables = p;
+    }
+
+    assert (tables != 0);
+    memset (&bytes[tables], 0, 8);
+
+    {
+        ofstream out (brokenName.c_str (), ios_base::binary);
+        out.write (bytes.data (), bytes.size ());
+    }
+
+    AsyncReader reader;
+
+    for (int part = 0; part < 2; ++part)
+    {
+        Pixels pixels;
+        pixels.allocate (frameDataWindow (1));
+
+        reader.read (brokenName, pixels.frameBuffer (), part).get ();
+        pixels.check (1, part);
+    }
+
+    remove (brokenName.c_str ());
+}
+
+//
+// Cancelled requests fail, the others succeed; every request is
+// completed exactly once, including those left when the reader
+// is destroyed.
+//
+
+void
+cancelRequests (const string& tempDir, bool destroy)
+{
+    cout << (destroy ? "destroy" : "cancel") << " with requests pending"
+         << endl;
+
+    vector<Pixels>       pixels (numFrames);
+    vector<future<void>> results;
+    int                  doneCount = 0;
+    std::mutex           doneMutex;
+
+    {
+        AsyncReader reader (1, 1);
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            Pixels& p = pixels[frame];
+            p.allocate (frameDataWindow (frame));
+
+            AsyncReader::Request request;
+            request.fileName    = frameName (tempDir, "tiled", frame);
+            request.frameBuffer = p.frameBuffer ();
+
+            request.done = [&doneCount, &doneMutex] (exception_ptr) {
+                std::lock_guard<std::mutex> lock (doneMutex);
+                ++doneCount;
+            };
+
+            results.push_back (reader.read (request));
+        }
+
+        if (!destroy)
+        {
+            reader.cancel ();
+            reader.wait ();
+            assert (reader.pending () == 0);
+            assert (doneCount == numFrames);
+        }
+    }
+
+    assert (doneCount == numFrames);
+
+    int numRead = 0;
+
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        try
+        {
+            results[frame].get ();
+            pixels[frame].check (frame, 0);
+            ++numRead;
+        }
+        catch (const IEX_NAMESPACE::BaseExc&)
+        {}
+    }
+
+    cout << numRead << " of " << numFrames << " frames read" << endl;
+}
+
+} // namespace
+
+void
+testAsyncReader (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing AsyncReader" << endl;
+
+        writeFrames (tempDir);
+
+        int maxThreads = ILMTHREAD_NAMESPACE::supportsThreads () ? 3 : 0;
+
+        for (int n = 0; n <= maxThreads; n += 3)
+        {
+            if (ILMTHREAD_NAMESPACE::supportsThreads ())
+            {
+                setGlobalThreadCount (n);
+                cout << "\nnumber of threads: " << globalThreadCount () << endl;
+            }
+
+            readSequence (tempDir, "scanline", 0, 4, 1 << 30);
+            readSequence (tempDir, "tiled", 0, 4, 1 << 30);
+            readSequence (tempDir, "multipart", 0, 2, 1 << 30);
+            readSequence (tempDir, "multipart", 1, 1, 1);
+            readSequence (tempDir, "tiled", 0, 100, 1);
+            readErrors (tempDir);
+            readBrokenOffsets (tempDir);
+            cancelRequests (tempDir, false);
+            cancelRequests (tempDir, true);
+        }
+
+        if (MMapIFStream::isSupported ())
+        {
+            cout << "\nmemory-mapped file input" << endl;
+
+            bool mapped = memoryMappedFileInput ();
+            setMemoryMappedFileInput (true);
+
+            readSequence (tempDir, "scanline", 0, 4, 1 << 30);
+            readSequence (tempDir, "multipart", 0, 2, 1 << 30);
+            readSequence (tempDir, "multipart", 1, 1, 1);
+            readErrors (tempDir);
+            readBrokenOffsets (tempDir);
+
+            setMemoryMappedFileInput (mapped);
+        }
+
+        removeFrames (tempDir);
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
@@ -0,0 +1,384 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfChunkOffsetCache.h>
+#include <ImfDeepFrameBuffer.h>
+#include <ImfDeepScanLineInputFile.h>
+#include <ImfDeepScanLineOutputFile.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfMMapIO.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfOutputPart.h>
+#include <ImfPartType.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+Header
+makeHeader (int width, int height)
+{
+    Header hdr (width, height);
+    hdr.compression () = ZIPS_COMPRESSION;
+    hdr.channels ().insert ("Y", Channel (FLOAT));
+    return hdr;
+}
+
+FrameBuffer
+makeFrameBuffer (Array2D<float>& pixels, int width)
+{
+    FrameBuffer fb;
+
+    fb.insert (
+        "Y",
+        Slice (
+            FLOAT,
+            (char*) &pixels[0][0],
+            sizeof (float),
+            sizeof (float) * width));
+
+    return fb;
+}
+
+//
+// Write a scan line file, leaving out the last numMissing scan
+// lines, so that its line offset table is incomplete.
+//
+
+void
+writeScanLineFile (
+    const string& fileName, int width, int height, int numMissing)
+{
+    Array2D<float> pixels (height, width);
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            pixels[y][x] = x + 1000 * y;
+
+    OutputFile out (fileName.c_str (), makeHeader (width, height));
+    out.setFrameBuffer (makeFrameBuffer (pixels, width));
+    out.writePixels (height - numMissing);
+}
+
+void
+readScanLineFile (
+    const string& fileName, int width, int height, int numMissing)
+{
+    InputFile in (fileName.c_str ());
+    assert (in.isComplete () == (numMissing == 0));
+
+    Array2D<float> pixels (height, width);
+    in.setFrameBuffer (makeFrameBuffer (pixels, width));
+    in.readPixels (0, height - numMissing - 1);
+
+    for (int y = 0; y < height - numMissing; ++y)
+        for (int x = 0; x < width; ++x)
+            assert (pixels[y][x] == x + 1000 * y);
+}
+
+void
+writeMultiPartFile (const string& fileName, int width, int height)
+{
+    vector<Header> headers (2, makeHeader (width, height));
+
+    for (int i = 0; i < 2; ++i)
+    {
+        headers[i].setName (i ? "right" : "left");
+        headers[i].setType (SCANLINEIMAGE);
+    }
+
+    Array2D<float> pixels (height, width);
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            pixels[y][x] = x + 1000 * y;
+
+    MultiPartOutputFile out (fileName.c_str (), &headers[0], 2);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        //
+        // Leave out the last scan line of the second part
+        //
+
+        OutputPart part (out, i);
+        part.setFrameBuffer (makeFrameBuffer (pixels, width));
+        part.writePixels (height - i);
+    }
+}
+
+void
+writeDeepFile (const string& fileName, int width, int height)
+{
+    Header hdr (width, height);
+    hdr.compression () = ZIPS_COMPRESSION;
+    hdr.channels ().insert ("Z", Channel (FLOAT));
+    hdr.setType (DEEPSCANLINE);
+
+    DeepScanLineOutputFile out (fileName.c_str (), hdr);
+
+    unsigned int    sampleCount;
+    float           sample;
+    float*          samplePtr = &sample;
+    DeepFrameBuffer fb;
+
+    fb.insertSampleCountSlice (Slice (UINT, (char*) &sampleCount));
+    fb.insert ("Z", DeepSlice (FLOAT, (char*) &samplePtr));
+    out.setFrameBuffer (fb);
+
+    for (int y = 0; y < height; ++y)
+    {
+        sampleCount = y % 3;
+        sample      = y;
+        out.writePixels (1);
+    }
+}
+
+void
+testScanLineFiles (const string& tempDir, ChunkOffsetCache& cache)
+{
+    cout << "    scan line files" << endl;
+
+    string completeName   = tempDir + "imf_test_chunk_offsets_c.exr";
+    string incompleteName = tempDir + "imf_test_chunk_offsets_ic.exr";
+
+    writeScanLineFile (completeName, 37, 41, 0);
+    writeScanLineFile (incompleteName, 37, 41, 5);
+
+    cache.resetStatistics ();
+
+    readScanLineFile (completeName, 37, 41, 0);
+    readScanLineFile (incompleteName, 37, 41, 5);
+
+    ChunkOffsetCache::Statistics s = cache.statistics ();
+    assert (s.hits == 0);
+    assert (s.misses == 2);
+    assert (s.insertions == 2);
+    assert (s.tables == 2);
+
+    //
+    // Opening the files again takes their tables, including the
+    // reconstructed one, from the cache
+    //
+
+    readScanLineFile (completeName, 37, 41, 0);
+    readScanLineFile (incompleteName, 37, 41, 5);
+
+    s = cache.statistics ();
+    assert (s.hits == 2);
+    assert (s.insertions == 2);
+
+    //
+    // A file that has been rewritten is not found in the cache
+    //
+
+    writeScanLineFile (incompleteName, 37, 43, 2);
+    readScanLineFile (incompleteName, 37, 43, 2);
+
+    s = cache.statistics ();
+    assert (s.hits == 2);
+    assert (s.misses == 3);
+    assert (s.insertions == 3);
+    assert (s.tables == 3);
+
+    remove (completeName.c_str ());
+    remove (incompleteName.c_str ());
+}
+
+void
+testMemoryMappedFiles (const string& tempDir, ChunkOffsetCache& cache)
+{
+    if (!MMapIFStream::isSupported ()) return;
+
+    cout << "    memory-mapped files" << endl;
+
+    string fileName = tempDir + "imf_test_chunk_offsets_mm.exr";
+    writeScanLineFile (fileName, 19, 23, 3);
+
+    cache.clear ();
+    cache.resetStatistics ();
+    setMemoryMappedFileInput (true);
+
+    //
+    // The key of a memory-mapped file is taken from the descriptor
+    // that the file was mapped through
+    //
+
+    readScanLineFile (fileName, 19, 23, 3);
+    readScanLineFile (fileName, 19, 23, 3);
+
+    ChunkOffsetCache::Statistics s = cache.statistics ();
+    assert (s.hits == 1);
+    assert (s.misses == 1);
+    assert (s.insertions == 1);
+
+    writeScanLineFile (fileName, 19, 25, 4);
+    readScanLineFile (fileName, 19, 25, 4);
+
+    s = cache.statistics ();
+    assert (s.hits == 1);
+    assert (s.misses == 2);
+    assert (s.tables == 2);
+
+    setMemoryMappedFileInput (false);
+    remove (fileName.c_str ());
+}
+
+void
+testMultiPartFile (const string& tempDir, ChunkOffsetCache& cache)
+{
+    cout << "    multi-part file" << endl;
+
+    string fileName = tempDir + "imf_test_chunk_offsets_mp.exr";
+    writeMultiPartFile (fileName, 23, 19);
+
+    cache.clear ();
+    cache.resetStatistics ();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        MultiPartInputFile in (fileName.c_str ());
+        assert (in.partComplete (0));
+        assert (!in.partComplete (1));
+
+        ChunkOffsetCache::Statistics s = cache.statistics ();
+        assert (s.hits == (i ? 2 : 0));
+        assert (s.insertions == 2);
+        assert (s.tables == 2);
+    }
+
+    remove (fileName.c_str ());
+}
+
+void
+testDeepFile (const string& tempDir, ChunkOffsetCache& cache)
+{
+    cout << "    deep scan line file" << endl;
+
+    string fileName = tempDir + "imf_test_chunk_offsets_deep.exr";
+    writeDeepFile (fileName, 11, 29);
+
+    cache.clear ();
+    cache.resetStatistics ();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        DeepScanLineInputFile in (fileName.c_str ());
+        assert (in.isComplete ());
+
+        vector<unsigned int> counts (11);
+        DeepFrameBuffer      fb;
+
+        fb.insertSampleCountSlice (Slice (
+            UINT, (char*) &counts[0], sizeof (unsigned int), 0));
+
+        in.setFrameBuffer (fb);
+        in.readPixelSampleCounts (28);
+        assert (counts[10] == 28 % 3);
+
+        ChunkOffsetCache::Statistics s = cache.statistics ();
+        assert (s.hits == uint64_t (i));
+        assert (s.insertions == 1);
+    }
+
+    remove (fileName.c_str ());
+}
+
+void
+testEviction (const string& tempDir, ChunkOffsetCache& cache)
+{
+    cout << "    eviction" << endl;
+
+    string fileName[3];
+
+    cache.clear ();
+    cache.resetStatistics ();
+    cache.setMaxTables (2);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        fileName[i] = tempDir + "imf_test_chunk_offsets_" + char ('a' + i) +
+                      ".exr";
+
+        writeScanLineFile (fileName[i], 5, 7 + i, 0);
+        readScanLineFile (fileName[i], 5, 7 + i, 0);
+    }
+
+    ChunkOffsetCache::Statistics s = cache.statistics ();
+    assert (s.insertions == 3);
+    assert (s.evictions == 1);
+    assert (s.tables == 2);
+
+    //
+    // The least recently used table, that of the first file, is gone
+    //
+
+    readScanLineFile (fileName[2], 5, 9, 0);
+    readScanLineFile (fileName[0], 5, 7, 0);
+
+    s = cache.statistics ();
+    assert (s.hits == 1);
+    assert (s.misses == 4);
+    assert (s.evictions == 2);
+
+    cache.setMaxTables (0);
+    assert (cache.statistics ().tables == 0);
+
+    readScanLineFile (fileName[1], 5, 8, 0);
+    assert (cache.statistics ().insertions == 4);
+
+    for (int i = 0; i < 3; ++i)
+        remove (fileName[i].c_str ());
+}
+
+} // namespace
+
+void
+testChunkOffsetCache (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing the chunk offset table cache" << endl;
+
+        ChunkOffsetCache& cache = ChunkOffsetCache::globalCache ();
+        assert (cache.maxTables () == 0);
+
+        cache.setMaxTables (16);
+
+        testScanLineFiles (tempDir, cache);
+        testMemoryMappedFiles (tempDir, cache);
+        testMultiPartFile (tempDir, cache);
+        testDeepFile (tempDir, cache);
+        testEviction (tempDir, cache);
+
+        cache.setMaxTables (0);
+        cache.clear ();
+        cache.resetStatistics ();
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
@@ -11,11 +11,13 @@
 #include "random.h"
 
 #include <Iex.h>
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <ostream>
 #include <sstream>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <typeinfo>
 #include <vector>
@@ -24,6 +26,7 @@
 #include <ImfChannelList.h>
 #include <ImfCompositeDeepScanLine.h>
 #include <ImfCompression.h>
+#include <ImfDeepCompositing.h>
 #include <ImfDeepFrameBuffer.h>
 #include <ImfDeepScanLineInputPart.h>
 #include <ImfDeepScanLineOutputPart.h>
@@ -53,6 +56,7 @@ using OPENEXR_IMF_NAMESPACE::MultiPartInputFile;
 
 using IMATH_NAMESPACE::Box2i;
 using OPENEXR_IMF_NAMESPACE::CompositeDeepScanLine;
+using OPENEXR_IMF_NAMESPACE::DeepCompositing;
 using OPENEXR_IMF_NAMESPACE::DeepFrameBuffer;
 using OPENEXR_IMF_NAMESPACE::DEEPSCANLINE;
 using OPENEXR_IMF_NAMESPACE::DeepSlice;
@@ -646,6 +650,193 @@ test_parts (
     remove (fn.c_str ());
 }
 
+//
+// a derived class which changes nothing, so is composited one pixel at a time
+// through composite_pixel(): used as the reference for the block compositor
+//
+class PerPixelCompositing : public DeepCompositing
+{};
+
+void
+read_composite (
+    const std::string& fn,
+    int                number_of_parts,
+    DeepCompositing*   engine,
+    vector<float>&     data,
+    bool               zback)
+{
+    MultiPartInputFile             input (fn.c_str ());
+    CompositeDeepScanLine          comp;
+    vector<DeepScanLineInputPart*> parts (number_of_parts);
+    const char* names[] = {"Z", "ZBack", "A", "R", "G"};
+    int         number_of_channels = 5;
+
+    for (int i = 0; i < number_of_parts; i++)
+    {
+        parts[i] = new DeepScanLineInputPart (input, i);
+        comp.addSource (parts[i]);
+    }
+    if (engine) comp.setCompositing (engine);
+
+    const Box2i& dw     = comp.dataWindow ();
+    int          width  = dw.size ().x + 1;
+    int          height = dw.size ().y + 1;
+    data.assign (size_t (width) * height * number_of_channels, 0.f);
+
+    FrameBuffer fb;
+    for (int c = 0; c < number_of_channels; c++)
+    {
+        if (c == 1 && !zback) continue;
+        fb.insert (
+            names[c],
+            Slice (
+                FLOAT,
+                (char*) (&data[c] - (dw.min.x + dw.min.y * width) *
+                                        number_of_channels),
+                sizeof (float) * number_of_channels,
+                sizeof (float) * width * number_of_channels));
+    }
+    comp.setFrameBuffer (fb);
+    comp.readPixels (dw.min.y, dw.max.y);
+
+    for (int i = 0; i < number_of_parts; i++)
+    {
+        delete parts[i];
+    }
+}
+
+//
+// composite many parts with random sample counts, some sorted by depth and some
+// not, with equal depths, opaque samples and pixels with many samples, and
+// check the block compositor gives exactly what compositing pixel by pixel does
+//
+void
+test_block_compositing (
+    int number_of_parts, bool zback, const std::string& tempDir)
+{
+    cout << "comparing block compositing with " << number_of_parts
+         << " parts" << (zback ? " with ZBack" : "") << endl;
+
+    std::string fn = tempDir + "imf_test_composite_deep_scanline_block.exr";
+
+    const char* names[] = {"Z", "ZBack", "A", "R", "G"};
+
+    Box2i dw;
+    dw.min.x   = random_int (40) - 20;
+    dw.min.y   = random_int (40) - 20;
+    dw.max.x   = dw.min.x + 20 + random_int (60);
+    dw.max.y   = dw.min.y + 20 + random_int (60);
+    int width  = dw.size ().x + 1;
+    int height = dw.size ().y + 1;
+
+    vector<Header> headers (number_of_parts);
+    for (int i = 0; i < number_of_parts; i++)
+    {
+        headers[i].dataWindow ()    = dw;
+        headers[i].displayWindow () = dw;
+        headers[i].setType (DEEPSCANLINE);
+        headers[i].compression () = ZIPS_COMPRESSION;
+        ostringstream s;
+        s << "Part" << i;
+        headers[i].setName (s.str ());
+        for (int c = 0; c < 5; c++)
+        {
+            if (c == 1 && !zback) continue;
+            headers[i].channels ().insert (
+                names[c], OPENEXR_IMF_NAMESPACE::Channel (FLOAT));
+        }
+    }
+
+    {
+        MultiPartOutputFile f (fn.c_str (), &headers[0], headers.size ());
+        for (int i = 0; i < number_of_parts; i++)
+        {
+            // every third part is written in depth order
+            bool                 sorted = (i % 3 == 0);
+            vector<unsigned int> counts (size_t (width) * height);
+            vector<vector<float>> samples (5);
+            for (size_t p = 0; p < counts.size (); p++)
+            {
+                // mostly a few samples, sometimes enough to need a full sort
+                int count = random_int (10) == 0 ? random_int (40)
+                                                  : random_int (4);
+                counts[p] = count;
+                vector<float> z (count);
+                for (int s = 0; s < count; s++)
+                {
+                    // few distinct depths so that some are equal
+                    z[s] = float (random_int (16)) * 0.5f;
+                }
+                if (sorted) std::sort (z.begin (), z.end ());
+                for (int s = 0; s < count; s++)
+                {
+                    int   a     = random_int (8);
+                    float alpha = a == 0 ? 1.f : float (a) * 0.1f;
+                    samples[0].push_back (z[s]);
+                    samples[1].push_back (z[s] + float (random_int (3)));
+                    samples[2].push_back (alpha);
+                    samples[3].push_back (random_float (1.f) * alpha);
+                    samples[4].push_back (random_float (1.f) * alpha);
+                }
+            }
+
+            vector<vector<float*>> pointers (5);
+            for (int c = 0; c < 5; c++)
+            {
+                pointers[c].resize (counts.size ());
+                size_t sample = 0;
+                for (size_t p = 0; p < counts.size (); p++)
+                {
+                    pointers[c][p] =
+                        samples[c].empty () ? NULL : &samples[c][sample];
+                    sample += counts[p];
+                }
+            }
+
+            DeepFrameBuffer fb;
+            fb.insertSampleCountSlice (Slice (
+                UINT,
+                (char*) (&counts[0] - dw.min.x - width * dw.min.y),
+                sizeof (unsigned int),
+                sizeof (unsigned int) * width));
+            for (int c = 0; c < 5; c++)
+            {
+                if (c == 1 && !zback) continue;
+                fb.insert (
+                    names[c],
+                    DeepSlice (
+                        FLOAT,
+                        (char*) (&pointers[c][0] - dw.min.x - width * dw.min.y),
+                        sizeof (float*),
+                        sizeof (float*) * width,
+                        sizeof (float)));
+            }
+            DeepScanLineOutputPart part (f, i);
+            part.setFrameBuffer (fb);
+            part.writePixels (height);
+        }
+    }
+
+    vector<float>       block;
+    vector<float>       reference;
+    PerPixelCompositing per_pixel;
+    read_composite (fn, number_of_parts, NULL, block, zback);
+    read_composite (fn, number_of_parts, &per_pixel, reference, zback);
+
+    assert (block.size () == reference.size ());
+    for (size_t i = 0; i < block.size (); i++)
+    {
+        if (memcmp (&block[i], &reference[i], sizeof (float)) != 0)
+        {
+            cout << "block compositing differs at value " << i << ": "
+                 << block[i] << " != " << reference[i] << endl;
+            assert (false);
+        }
+    }
+
+    remove (fn.c_str ());
+}
+
 } // namespace
 
 void
@@ -694,6 +885,12 @@ testCompositeDeepScanLine (const std::string& tempDir)
         test_parts<half> (1, 4, true, false, tempDir);
         test_parts<half> (1, 4, false, true, tempDir);
 
+        cout << "Testing block compositing:\n" << endl;
+
+        test_block_compositing (2, false, tempDir);
+        test_block_compositing (12, true, tempDir);
+        test_block_compositing (30, false, tempDir);
+
         if (passes == 2 && pass == 0)
         {
             cout << " testing with multithreading...\n";
@@ -0,0 +1,338 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <IlmThread.h>
+#include <ImathRandom.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfThreading.h>
+#include <ImfTiledOutputFile.h>
+#include <half.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+const int W = 118;
+const int H = 62;
+
+//
+// The channel names are chosen so that DWA compresses R, G and B
+// together, Y on its own with the lossy DCT, A with RLE, and the
+// rest with zlib.
+//
+
+struct ChannelInfo
+{
+    const char* name;
+    PixelType   type;
+    int         sampling;
+};
+
+const ChannelInfo channelInfo[] = {
+    {"A", HALF, 1},
+    {"B", HALF, 1},
+    {"G", HALF, 1},
+    {"R", HALF, 1},
+    {"Y", HALF, 1},
+    {"Z", FLOAT, 1},
+    {"id", UINT, 1},
+    {"s", HALF, 2},
+};
+
+const int numChannels = sizeof (channelInfo) / sizeof (channelInfo[0]);
+
+//
+// All channels are read as FLOAT; the UINT values are small
+// enough to be represented exactly.
+//
+
+struct Image
+{
+    Array2D<float> pixels[numChannels];
+
+    Image ()
+    {
+        for (int c = 0; c < numChannels; ++c)
+        {
+            pixels[c].resizeErase (H, W);
+
+            for (int y = 0; y < H; ++y)
+                for (int x = 0; x < W; ++x)
+                    pixels[c][y][x] = -1.f;
+        }
+    }
+
+    void
+    insert (FrameBuffer& fb, int c, bool fill = false)
+    {
+        int s = channelInfo[c].sampling;
+
+        fb.insert (
+            channelInfo[c].name,
+            Slice (
+                FLOAT,
+                (char*) &pixels[c][0][0],
+                sizeof (float),
+                sizeof (float) * W,
+                s,
+                s,
+                fill ? 0.25 : 0.0));
+    }
+};
+
+bool
+skipChannel (int c, bool tiled)
+{
+    return tiled && channelInfo[c].sampling != 1;
+}
+
+void
+writeFile (
+    const string& fileName, Compression compression, bool tiled, Rand48& random)
+{
+    Header header (W, H);
+    header.compression () = compression;
+
+    if (tiled) header.setTileDescription (TileDescription (32, 16));
+
+    Array2D<half>         h[numChannels];
+    Array2D<float>        f[numChannels];
+    Array2D<unsigned int> u[numChannels];
+    FrameBuffer           fb;
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        if (skipChannel (c, tiled)) continue;
+
+        PixelType type = channelInfo[c].type;
+        int       s    = channelInfo[c].sampling;
+
+        header.channels ().insert (channelInfo[c].name, Channel (type, s, s));
+
+        h[c].resizeErase (H, W);
+        f[c].resizeErase (H, W);
+        u[c].resizeErase (H, W);
+
+        for (int y = 0; y < H; ++y)
+            for (int x = 0; x < W; ++x)
+            {
+                if (x < W / 2)
+                    f[c][y][x] = float (random.nextf (-4, 4));
+                else
+                    f[c][y][x] = float ((x / 8 + y / 5 + c) % 7);
+
+                h[c][y][x] = f[c][y][x];
+                u[c][y][x] = random.nexti () % 100000;
+            }
+
+        char*  base;
+        size_t size;
+
+        switch (type)
+        {
+            case HALF:
+                base = (char*) &h[c][0][0];
+                size = sizeof (half);
+                break;
+            case FLOAT:
+                base = (char*) &f[c][0][0];
+                size = sizeof (float);
+                break;
+            default:
+                base = (char*) &u[c][0][0];
+                size = sizeof (unsigned int);
+                break;
+        }
+
+        fb.insert (
+            channelInfo[c].name, Slice (type, base, size, size * W, s, s));
+    }
+
+    if (tiled)
+    {
+        TiledOutputFile out (fileName.c_str (), header);
+        out.setFrameBuffer (fb);
+        out.writeTiles (0, out.numXTiles () - 1, 0, out.numYTiles () - 1);
+    }
+    else
+    {
+        OutputFile out (fileName.c_str (), header);
+        out.setFrameBuffer (fb);
+        out.writePixels (H);
+    }
+}
+
+//
+// Read the channels in mask, one scan line at a time or all at once,
+// and compare them with the pixels read with all channels selected.
+//
+
+void
+readChannels (
+    InputFile&   in,
+    const Image& reference,
+    unsigned     mask,
+    bool         tiled,
+    bool         byScanLine)
+{
+    Image       image;
+    FrameBuffer fb;
+
+    for (int c = 0; c < numChannels; ++c)
+        if ((mask & (1 << c)) && !skipChannel (c, tiled)) image.insert (fb, c);
+
+    //
+    // a channel that is not in the file is filled
+    //
+
+    Array2D<float> fill (H, W);
+    fb.insert ("fill", Slice (FLOAT, (char*) &fill[0][0], 4, 4 * W, 1, 1, 0.5));
+
+    in.setFrameBuffer (fb);
+
+    if (byScanLine)
+    {
+        for (int y = 0; y < H; ++y)
+            in.readPixels (y);
+    }
+    else
+    {
+        in.readPixels (0, H - 1);
+    }
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        bool read = (mask & (1 << c)) && !skipChannel (c, tiled);
+        int  s    = channelInfo[c].sampling;
+
+        for (int y = 0; y < H / s; ++y)
+            for (int x = 0; x < W / s; ++x)
+            {
+                if (read)
+                    assert (image.pixels[c][y][x] == reference.pixels[c][y][x]);
+                else
+                    assert (image.pixels[c][y][x] == -1.f);
+            }
+    }
+
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+            assert (fill[y][x] == 0.5f);
+}
+
+void
+testFile (
+    const string& fileName, Compression compression, bool tiled, Rand48& random)
+{
+    cout << (tiled ? "tiled, " : "scan lines, ") << "compression "
+         << compression << endl;
+
+    writeFile (fileName, compression, tiled, random);
+
+    //
+    // The reference image is read with all channels, by a file
+    // that never had fewer channels selected
+    //
+
+    Image reference;
+
+    {
+        InputFile   in (fileName.c_str ());
+        FrameBuffer fb;
+
+        for (int c = 0; c < numChannels; ++c)
+            if (!skipChannel (c, tiled)) reference.insert (fb, c);
+
+        in.setFrameBuffer (fb);
+        in.readPixels (0, H - 1);
+    }
+
+    //
+    // Single channels, some groups of channels, no channels, and all
+    // channels, alternating between subsets on the same file so that
+    // buffers uncompressed for one set of channels are not used for
+    // another.
+    //
+
+    vector<unsigned> masks;
+
+    for (int c = 0; c < numChannels; ++c)
+        masks.push_back (1 << c);
+
+    masks.push_back (0);
+    masks.push_back ((1 << 1) | (1 << 2));             // B G
+    masks.push_back ((1 << 0) | (1 << 5) | (1 << 6));  // A Z id
+    masks.push_back ((1 << 3) | (1 << 4) | (1 << 7));  // R Y s
+    masks.push_back ((1 << numChannels) - 1);
+
+    for (int i = 0; i < 6; ++i)
+        masks.push_back (random.nexti () % (1 << numChannels));
+
+    InputFile in (fileName.c_str ());
+
+    for (size_t i = 0; i < masks.size (); ++i)
+    {
+        readChannels (in, reference, masks[i], tiled, i % 2 == 0);
+        readChannels (in, reference, (1 << numChannels) - 1, tiled, true);
+        readChannels (in, reference, masks[i], tiled, i % 3 == 0);
+    }
+
+    remove (fileName.c_str ());
+}
+
+} // namespace
+
+void
+testDecodedChannels (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing reading some of the channels of a file" << endl;
+
+        std::string fileName = tempDir + "imf_test_decoded_channels.exr";
+
+        Rand48 random (17);
+
+        int maxThreads = ILMTHREAD_NAMESPACE::supportsThreads () ? 3 : 0;
+
+        for (int n = 0; n <= maxThreads; n += 3)
+        {
+            if (ILMTHREAD_NAMESPACE::supportsThreads ())
+            {
+                setGlobalThreadCount (n);
+                cout << "\nnumber of threads: " << globalThreadCount () << endl;
+            }
+
+            for (int comp = 0; comp < NUM_COMPRESSION_METHODS; ++comp)
+            {
+                testFile (fileName, Compression (comp), false, random);
+                testFile (fileName, Compression (comp), true, random);
+            }
+        }
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
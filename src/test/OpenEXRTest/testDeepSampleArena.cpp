@@ -0,0 +1,383 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include "testDeepSampleArena.h"
+
+#include <Iex.h>
+#include <IlmThread.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfDeepFrameBuffer.h>
+#include <ImfDeepSampleArena.h>
+#include <ImfDeepScanLineInputFile.h>
+#include <ImfDeepScanLineInputPart.h>
+#include <ImfDeepScanLineOutputFile.h>
+#include <ImfHeader.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfPartType.h>
+#include <ImfThreading.h>
+#include <half.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace IMATH_NAMESPACE;
+using namespace std;
+
+namespace
+{
+
+const int width  = 71;
+const int height = 57;
+const int minX   = 5;
+const int minY   = -9;
+const Box2i
+    dataWindow (V2i (minX, minY), V2i (minX + width - 1, minY + height - 1));
+
+//
+// Some pixels have no samples
+//
+
+unsigned int
+expectedCount (int x, int y)
+{
+    return (x * 5 + y * 11 + 200) % 7;
+}
+
+//
+// Sample values that can be converted between the channel types
+// without loss, except for Z converted to HALF
+//
+
+float
+zValue (int x, int y, unsigned int s)
+{
+    return float (x) * 0.25f + float (y) * 1000.5f + float (s) * 0.125f;
+}
+
+half
+aValue (int x, int y, unsigned int s)
+{
+    return half (float ((x + y + s) % 16) / 16.f);
+}
+
+unsigned int
+idValue (int x, int y, unsigned int s)
+{
+    return unsigned (x * 10000 + (y + 100) * 10 + s);
+}
+
+void
+writeFile (const string& fileName, Compression compression)
+{
+    Header header (dataWindow, dataWindow);
+    header.compression () = compression;
+    header.channels ().insert ("A", Channel (HALF));
+    header.channels ().insert ("Z", Channel (FLOAT));
+    header.channels ().insert ("id", Channel (UINT));
+    header.setType (DEEPSCANLINE);
+
+    Array2D<unsigned int>  counts (height, width);
+    Array2D<half*>         a (height, width);
+    Array2D<float*>        z (height, width);
+    Array2D<unsigned int*> id (height, width);
+    vector<half>           aSamples;
+    vector<float>          zSamples;
+    vector<unsigned int>   idSamples;
+
+    size_t total = 0;
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            counts[y][x] = expectedCount (x + minX, y + minY);
+            total += counts[y][x];
+        }
+
+    aSamples.resize (total + 1);
+    zSamples.resize (total + 1);
+    idSamples.resize (total + 1);
+    total = 0;
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            a[y][x]  = &aSamples[total];
+            z[y][x]  = &zSamples[total];
+            id[y][x] = &idSamples[total];
+
+            for (unsigned int s = 0; s < counts[y][x]; ++s)
+            {
+                aSamples[total + s]  = aValue (x + minX, y + minY, s);
+                zSamples[total + s]  = zValue (x + minX, y + minY, s);
+                idSamples[total + s] = idValue (x + minX, y + minY, s);
+            }
+
+            total += counts[y][x];
+        }
+
+    DeepFrameBuffer fb;
+    fb.insertSampleCountSlice (Slice (
+        UINT,
+        (char*) (&counts[0][0] - minX - minY * width),
+        sizeof (unsigned int),
+        sizeof (unsigned int) * width));
+    fb.insert (
+        "A",
+        DeepSlice (
+            HALF,
+            (char*) (&a[0][0] - minX - minY * width),
+            sizeof (half*),
+            sizeof (half*) * width,
+            sizeof (half)));
+    fb.insert (
+        "Z",
+        DeepSlice (
+            FLOAT,
+            (char*) (&z[0][0] - minX - minY * width),
+            sizeof (float*),
+            sizeof (float*) * width,
+            sizeof (float)));
+    fb.insert (
+        "id",
+        DeepSlice (
+            UINT,
+            (char*) (&id[0][0] - minX - minY * width),
+            sizeof (unsigned int*),
+            sizeof (unsigned int*) * width,
+            sizeof (unsigned int)));
+
+    DeepScanLineOutputFile out (fileName.c_str (), header);
+    out.setFrameBuffer (fb);
+    out.writePixels (height);
+}
+
+//
+// Check the layout and the samples of an arena read with the
+// channels inserted by arenaChannels()
+//
+
+void
+arenaChannels (DeepSampleArena& arena)
+{
+    arena.insert ("Z", FLOAT);
+    arena.insert ("A", FLOAT);
+    arena.insert ("id", UINT);
+    arena.insert ("missing", HALF);
+}
+
+void
+checkArena (const DeepSampleArena& arena, int scanLine1, int scanLine2)
+{
+    const Box2i& window = arena.window ();
+
+    assert (window.min.x == minX);
+    assert (window.max.x == minX + width - 1);
+    assert (window.min.y == min (scanLine1, scanLine2));
+    assert (window.max.y == max (scanLine1, scanLine2));
+
+    const float*        z       = arena.typedSamples<float> (0);
+    const float*        a       = arena.typedSamples<float> (1);
+    const unsigned int* id      = arena.typedSamples<unsigned int> (2);
+    const half*         missing = arena.typedSamples<half> (3);
+
+    const uint64_t* offsets = arena.sampleOffsets ();
+    uint64_t        next    = 0;
+    size_t          i       = 0;
+
+    for (int y = window.min.y; y <= window.max.y; ++y)
+        for (int x = window.min.x; x <= window.max.x; ++x, ++i)
+        {
+            unsigned int n = expectedCount (x, y);
+
+            assert (offsets[i] == next);
+            assert (arena.sampleOffset (x, y) == next);
+            assert (arena.sampleCount (x, y) == n);
+
+            for (unsigned int s = 0; s < n; ++s)
+            {
+                assert (z[next + s] == zValue (x, y, s));
+                assert (a[next + s] == float (aValue (x, y, s)));
+                assert (id[next + s] == idValue (x, y, s));
+                assert (missing[next + s] == 0.f);
+            }
+
+            next += n;
+        }
+
+    assert (offsets[i] == next);
+    assert (arena.totalSamples () == next);
+}
+
+void
+readFile (const string& fileName)
+{
+    DeepScanLineInputFile in (fileName.c_str ());
+    DeepSampleArena       arena;
+    arenaChannels (arena);
+
+    //
+    // The whole file, with no frame buffer set
+    //
+
+    in.readPixels (arena, minY, minY + height - 1);
+    checkArena (arena, minY, minY + height - 1);
+
+    //
+    // A channel converted to a different type
+    //
+
+    DeepSampleArena halfArena;
+    halfArena.insert ("Z", HALF);
+    in.readPixels (halfArena, minY, minY + height - 1);
+
+    const float* z  = arena.typedSamples<float> (0);
+    const half*  zh = halfArena.typedSamples<half> (0);
+
+    assert (halfArena.totalSamples () == arena.totalSamples ());
+
+    for (uint64_t s = 0; s < arena.totalSamples (); ++s)
+        assert (zh[s] == half (z[s]));
+
+    //
+    // Ranges that start and end within chunks, reusing the arena
+    //
+
+    int ranges[][2] = {
+        {minY + 37, minY + 20},
+        {minY + 5, minY + 5},
+        {minY + height - 1, minY + height - 19}};
+
+    for (int r = 0; r < 3; ++r)
+    {
+        in.readPixels (arena, ranges[r][0], ranges[r][1]);
+        checkArena (arena, ranges[r][0], ranges[r][1]);
+    }
+
+    //
+    // An arena without channels only gets the layout
+    //
+
+    DeepSampleArena layout;
+    in.readPixels (layout, minY + 3, minY + 40);
+    assert (layout.numChannels () == 0);
+
+    for (int y = minY + 3; y <= minY + 40; ++y)
+        for (int x = minX; x < minX + width; ++x)
+            assert (layout.sampleCount (x, y) == expectedCount (x, y));
+
+    try
+    {
+        in.readPixels (arena, minY - 1, minY + 3);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+
+    //
+    // And through a part of a multi-part file
+    //
+
+    MultiPartInputFile    file (fileName.c_str ());
+    DeepScanLineInputPart part (file, 0);
+
+    part.readPixels (arena, minY + 9, minY + 50);
+    checkArena (arena, minY + 9, minY + 50);
+}
+
+void
+testArenaLayout ()
+{
+    DeepSampleArena arena;
+    arena.insert ("Z", FLOAT);
+    arena.insert ("A", HALF);
+    arena.insert ("Z", UINT);
+
+    assert (arena.numChannels () == 2);
+    assert (arena.findChannel ("Z") == 0);
+    assert (arena.findChannel ("A") == 1);
+    assert (arena.findChannel ("B") == -1);
+    assert (arena.channelType (0) == UINT);
+    assert (arena.totalSamples () == 0);
+    assert (arena.window ().isEmpty ());
+
+    unsigned int counts[] = {1, 0, 3, 2, 0, 4};
+    arena.resize (Box2i (V2i (-1, 3), V2i (1, 4)), counts);
+
+    assert (arena.totalSamples () == 10);
+    assert (arena.sampleOffset (1, 3) == 1);
+    assert (arena.sampleOffset (-1, 4) == 4);
+    assert (arena.sampleCount (1, 4) == 4);
+    assert (arena.samples (0) != 0);
+
+    DeepSampleArena moved (std::move (arena));
+    assert (moved.totalSamples () == 10);
+    assert (moved.numChannels () == 2);
+
+    moved.clear ();
+    assert (moved.totalSamples () == 0);
+    assert (moved.numChannels () == 2);
+    assert (moved.samples (1) == 0);
+
+    try
+    {
+        moved.insert ("", HALF);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+}
+
+} // namespace
+
+void
+testDeepSampleArena (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing reading deep pixels into a sample arena" << endl;
+
+        testArenaLayout ();
+
+        string fileName = tempDir + "imf_test_deep_sample_arena.exr";
+
+        Compression compressions[] = {
+            NO_COMPRESSION, RLE_COMPRESSION, ZIPS_COMPRESSION};
+
+        int maxThreads = ILMTHREAD_NAMESPACE::supportsThreads () ? 3 : 0;
+
+        for (int n = 0; n <= maxThreads; n += 3)
+        {
+            if (ILMTHREAD_NAMESPACE::supportsThreads ())
+            {
+                setGlobalThreadCount (n);
+                cout << "\nnumber of threads: " << globalThreadCount () << endl;
+            }
+
+            for (int c = 0; c < 3; ++c)
+            {
+                cout << "compression " << compressions[c] << endl;
+
+                writeFile (fileName, compressions[c]);
+                readFile (fileName);
+            }
+        }
+
+        remove (fileName.c_str ());
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
@@ -0,0 +1,392 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include "testDeepSampleCounts.h"
+
+#include <Iex.h>
+#include <IlmThread.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfDeepFrameBuffer.h>
+#include <ImfDeepScanLineInputFile.h>
+#include <ImfDeepScanLineInputPart.h>
+#include <ImfDeepScanLineOutputFile.h>
+#include <ImfDeepTiledInputFile.h>
+#include <ImfDeepTiledOutputFile.h>
+#include <ImfHeader.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfPartType.h>
+#include <ImfThreading.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace IMATH_NAMESPACE;
+using namespace std;
+
+namespace
+{
+
+const int width  = 107;
+const int height = 93;
+const int minX   = -3;
+const int minY   = 12;
+const Box2i
+    dataWindow (V2i (minX, minY), V2i (minX + width - 1, minY + height - 1));
+
+const unsigned int untouched = 0xffffffff;
+
+//
+// Some pixels have no samples
+//
+
+unsigned int
+expectedCount (int x, int y, int level)
+{
+    return (x * 7 + y * 3 + level * 5 + 100) % 6;
+}
+
+//
+// The counts and samples of one level, in a buffer covering the
+// data window
+//
+
+struct DeepPixels
+{
+    Array2D<unsigned int> counts;
+    Array2D<float*>       pointers;
+    vector<float>         samples;
+
+    DeepPixels (const Box2i& levelWindow, int level)
+        : counts (height, width), pointers (height, width)
+    {
+        size_t total = 0;
+
+        for (int y = levelWindow.min.y; y <= levelWindow.max.y; ++y)
+            for (int x = levelWindow.min.x; x <= levelWindow.max.x; ++x)
+            {
+                unsigned int n             = expectedCount (x, y, level);
+                counts[y - minY][x - minX] = n;
+                total += n;
+            }
+
+        samples.resize (total + 1);
+        total = 0;
+
+        for (int y = levelWindow.min.y; y <= levelWindow.max.y; ++y)
+            for (int x = levelWindow.min.x; x <= levelWindow.max.x; ++x)
+            {
+                unsigned int n = counts[y - minY][x - minX];
+                pointers[y - minY][x - minX] = &samples[total];
+
+                for (unsigned int s = 0; s < n; ++s)
+                    samples[total + s] = float (x + y + s);
+
+                total += n;
+            }
+    }
+
+    DeepFrameBuffer frameBuffer ()
+    {
+        DeepFrameBuffer fb;
+        fb.insertSampleCountSlice (Slice (
+            UINT,
+            (char*) (&counts[0][0] - minX - minY * width),
+            sizeof (unsigned int),
+            sizeof (unsigned int) * width));
+        fb.insert (
+            "Z",
+            DeepSlice (
+                FLOAT,
+                (char*) (&pointers[0][0] - minX - minY * width),
+                sizeof (float*),
+                sizeof (float*) * width,
+                sizeof (float)));
+        return fb;
+    }
+};
+
+Header
+deepHeader (Compression compression, const string& type)
+{
+    Header header (dataWindow, dataWindow);
+    header.compression () = compression;
+    header.channels ().insert ("Z", Channel (FLOAT));
+    header.setType (type);
+    return header;
+}
+
+void
+writeScanLineFile (const string& fileName, Compression compression)
+{
+    DeepPixels             pixels (dataWindow, 0);
+    DeepScanLineOutputFile out (
+        fileName.c_str (), deepHeader (compression, DEEPSCANLINE));
+    out.setFrameBuffer (pixels.frameBuffer ());
+    out.writePixels (height);
+}
+
+void
+writeTiledFile (const string& fileName, Compression compression)
+{
+    Header header = deepHeader (compression, DEEPTILE);
+    header.setTileDescription (TileDescription (16, 12, MIPMAP_LEVELS));
+
+    DeepTiledOutputFile out (fileName.c_str (), header);
+
+    for (int l = 0; l < out.numLevels (); ++l)
+    {
+        DeepPixels pixels (out.dataWindowForLevel (l), l);
+        out.setFrameBuffer (pixels.frameBuffer ());
+        out.writeTiles (0, out.numXTiles (l) - 1, 0, out.numYTiles (l) - 1, l);
+    }
+}
+
+Slice
+countSlice (Array2D<unsigned int>& counts)
+{
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            counts[y][x] = untouched;
+
+    return Slice (
+        UINT,
+        (char*) (&counts[0][0] - minX - minY * width),
+        sizeof (unsigned int),
+        sizeof (unsigned int) * width);
+}
+
+void
+checkCounts (
+    const Array2D<unsigned int>& counts, const Box2i& window, int level)
+{
+    for (int y = minY; y < minY + height; ++y)
+        for (int x = minX; x < minX + width; ++x)
+        {
+            if (window.intersects (V2i (x, y)))
+                assert (
+                    counts[y - minY][x - minX] == expectedCount (x, y, level));
+            else
+                assert (counts[y - minY][x - minX] == untouched);
+        }
+}
+
+void
+readScanLineFile (const string& fileName)
+{
+    Array2D<unsigned int> counts (height, width);
+
+    //
+    // No frame buffer is set
+    //
+
+    DeepScanLineInputFile in (fileName.c_str ());
+
+    in.readPixelSampleCounts (countSlice (counts), minY, minY + height - 1);
+    checkCounts (counts, dataWindow, 0);
+
+    //
+    // Ranges that start and end within chunks
+    //
+
+    int ranges[][2] = {
+        {minY + 37, minY + 20},
+        {minY + 5, minY + 5},
+        {minY + height - 1, minY + height - 19}};
+
+    for (int r = 0; r < 3; ++r)
+    {
+        in.readPixelSampleCounts (
+            countSlice (counts), ranges[r][0], ranges[r][1]);
+        checkCounts (
+            counts,
+            Box2i (
+                V2i (minX, min (ranges[r][0], ranges[r][1])),
+                V2i (minX + width - 1, max (ranges[r][0], ranges[r][1]))),
+            0);
+    }
+
+    //
+    // The old interface still works after the new one
+    //
+
+    DeepPixels reference (dataWindow, 0);
+    DeepPixels pixels (Box2i (), 0);
+    in.setFrameBuffer (pixels.frameBuffer ());
+    in.readPixelSampleCounts (minY, minY + height - 1);
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            assert (pixels.counts[y][x] == reference.counts[y][x]);
+
+    try
+    {
+        in.readPixelSampleCounts (countSlice (counts), minY - 1, minY + 3);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+
+    try
+    {
+        Slice wrongType = countSlice (counts);
+        wrongType.type  = FLOAT;
+        in.readPixelSampleCounts (wrongType, minY, minY + 3);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+
+    //
+    // And through a part of a multi-part file
+    //
+
+    MultiPartInputFile    file (fileName.c_str ());
+    DeepScanLineInputPart part (file, 0);
+
+    part.readPixelSampleCounts (countSlice (counts), minY + 9, minY + 50);
+    checkCounts (
+        counts,
+        Box2i (V2i (minX, minY + 9), V2i (minX + width - 1, minY + 50)),
+        0);
+}
+
+void
+readTiledFile (const string& fileName)
+{
+    Array2D<unsigned int> counts (height, width);
+    DeepTiledInputFile    in (fileName.c_str ());
+
+    for (int l = 0; l < in.numLevels (); ++l)
+    {
+        in.readPixelSampleCounts (
+            countSlice (counts),
+            0,
+            in.numXTiles (l) - 1,
+            0,
+            in.numYTiles (l) - 1,
+            l,
+            l);
+        checkCounts (counts, in.dataWindowForLevel (l), l);
+    }
+
+    //
+    // Some of the tiles, given in reverse order
+    //
+
+    in.readPixelSampleCounts (countSlice (counts), 3, 1, 2, 1, 0, 0);
+    checkCounts (
+        counts,
+        Box2i (
+            in.dataWindowForTile (1, 1, 0).min,
+            in.dataWindowForTile (3, 2, 0).max),
+        0);
+
+    //
+    // A slice in tile coordinates holds one tile
+    //
+
+    Box2i tile = in.dataWindowForTile (2, 3, 1);
+    countSlice (counts);
+
+    in.readPixelSampleCounts (
+        Slice (
+            UINT,
+            (char*) &counts[0][0],
+            sizeof (unsigned int),
+            sizeof (unsigned int) * width,
+            1,
+            1,
+            0,
+            true,
+            true),
+        2,
+        2,
+        3,
+        3,
+        1,
+        1);
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            if (x <= tile.max.x - tile.min.x && y <= tile.max.y - tile.min.y)
+                assert (
+                    counts[y][x] ==
+                    expectedCount (x + tile.min.x, y + tile.min.y, 1));
+            else
+                assert (counts[y][x] == untouched);
+        }
+
+    try
+    {
+        in.readPixelSampleCounts (countSlice (counts), 0, 0, 0, 0, 0, 1);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+
+    try
+    {
+        in.readPixelSampleCounts (
+            countSlice (counts), 0, in.numXTiles (1), 0, 0, 1, 1);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+}
+
+} // namespace
+
+void
+testDeepSampleCounts (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing reading deep sample counts into a slice" << endl;
+
+        string fileName = tempDir + "imf_test_deep_sample_counts.exr";
+
+        Compression compressions[] = {
+            NO_COMPRESSION, RLE_COMPRESSION, ZIPS_COMPRESSION};
+
+        int maxThreads = ILMTHREAD_NAMESPACE::supportsThreads () ? 3 : 0;
+
+        for (int n = 0; n <= maxThreads; n += 3)
+        {
+            if (ILMTHREAD_NAMESPACE::supportsThreads ())
+            {
+                setGlobalThreadCount (n);
+                cout << "\nnumber of threads: " << globalThreadCount () << endl;
+            }
+
+            for (int c = 0; c < 3; ++c)
+            {
+                cout << "compression " << compressions[c] << endl;
+
+                writeScanLineFile (fileName, compressions[c]);
+                readScanLineFile (fileName);
+
+                writeTiledFile (fileName, compressions[c]);
+                readTiledFile (fileName);
+            }
+        }
+
+        remove (fileName.c_str ());
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
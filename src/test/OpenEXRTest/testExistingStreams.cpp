@@ -9,6 +9,7 @@
 
 #include <ImfArray.h>
 #include <ImfInputPart.h>
+#include <ImfMMapIO.h>
 #include <ImfMultiPartInputFile.h>
 #include <ImfMultiPartOutputFile.h>
 #include <ImfOutputPart.h>
@@ -21,6 +22,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <ImfChannelList.h>
 #include <vector>
@@ -260,6 +262,34 @@ writeReadScanLines (
         }
     }
 
+    {
+        cout << ", reading (MMapIFStream)";
+        MMapIFStream  ifs (fileName);
+        RgbaInputFile in (ifs);
+
+        const Box2i& dw = in.dataWindow ();
+        int          w  = dw.max.x - dw.min.x + 1;
+        int          h  = dw.max.y - dw.min.y + 1;
+        int          dx = dw.min.x;
+        int          dy = dw.min.y;
+
+        Array2D<Rgba> p2 (h, w);
+        in.setFrameBuffer (&p2[-dy][-dx], 1, w);
+        in.readPixels (dw.min.y, dw.max.y);
+
+        cout << ", comparing";
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                assert (p2[y][x].r == p1[y][x].r);
+                assert (p2[y][x].g == p1[y][x].g);
+                assert (p2[y][x].b == p1[y][x].b);
+                assert (p2[y][x].a == p1[y][x].a);
+            }
+        }
+    }
+
     cout << endl;
 
     remove (fileName);
@@ -567,6 +597,34 @@ writeReadTiles (
         }
     }
 
+    {
+        cout << ", reading (MMapIFStream)";
+        MMapIFStream       ifs (fileName);
+        TiledRgbaInputFile in (ifs);
+
+        const Box2i& dw = in.dataWindow ();
+        int          w  = dw.max.x - dw.min.x + 1;
+        int          h  = dw.max.y - dw.min.y + 1;
+        int          dx = dw.min.x;
+        int          dy = dw.min.y;
+
+        Array2D<Rgba> p2 (h, w);
+        in.setFrameBuffer (&p2[-dy][-dx], 1, w);
+        in.readTiles (0, in.numXTiles () - 1, 0, in.numYTiles () - 1);
+
+        cout << ", comparing";
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                assert (p2[y][x].r == p1[y][x].r);
+                assert (p2[y][x].g == p1[y][x].g);
+                assert (p2[y][x].b == p1[y][x].b);
+                assert (p2[y][x].a == p1[y][x].a);
+            }
+        }
+    }
+
     cout << endl;
 
     remove (fileName);
@@ -843,6 +901,117 @@ writeReadTiles (int width, int height, const Array2D<Rgba>& p1)
     cout << endl;
 }
 
+void
+writeReadUncompressed (
+    const char fileName[], int width, int height, const Array2D<Rgba>& p1)
+{
+    //
+    // Save an uncompressed image and read it back by file name,
+    // with memory-mapped file input turned on, so the pixels are
+    // converted straight out of the mapping where possible.  Then
+    // check the MMapIFStream itself.
+    //
+
+    cout << "uncompressed file:" << endl;
+
+    {
+        cout << "writing";
+        remove (fileName);
+        Header header (width, height);
+        header.compression () = NO_COMPRESSION;
+        RgbaOutputFile out (fileName, header, WRITE_RGBA);
+        out.setFrameBuffer (&p1[0][0], 1, width);
+        out.writePixels (height);
+    }
+
+    assert (!memoryMappedFileInput ());
+    setMemoryMappedFileInput (true);
+
+    {
+        cout << ", reading";
+        RgbaInputFile in (fileName);
+
+        const Box2i& dw = in.dataWindow ();
+        int          w  = dw.max.x - dw.min.x + 1;
+        int          h  = dw.max.y - dw.min.y + 1;
+        int          dx = dw.min.x;
+        int          dy = dw.min.y;
+
+        Array2D<Rgba> p2 (h, w);
+        in.setFrameBuffer (&p2[-dy][-dx], 1, w);
+        in.readPixels (dw.min.y, dw.max.y);
+
+        cout << ", comparing";
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                assert (p2[y][x].r == p1[y][x].r);
+                assert (p2[y][x].g == p1[y][x].g);
+                assert (p2[y][x].b == p1[y][x].b);
+                assert (p2[y][x].a == p1[y][x].a);
+            }
+        }
+    }
+
+    if (MMapIFStream::isSupported ())
+    {
+        cout << ", checking stream";
+
+        IStream* is = openInputFileStream (fileName);
+        assert (is->isMemoryMapped ());
+        delete is;
+
+        setMemoryMappedFileInput (false);
+        is = openInputFileStream (fileName);
+        assert (!is->isMemoryMapped ());
+        delete is;
+
+        MMapIFStream ifs (fileName);
+        uint64_t     size = ifs.size ();
+        assert (size > 8);
+
+        char magic[4];
+        ifs.read (magic, 4);
+        assert (magic[0] == 0x76 && magic[1] == 0x2f);
+        assert (ifs.tellg () == 4);
+
+        const char* mm = ifs.readMemoryMapped (4);
+        assert (ifs.tellg () == 8);
+
+        char version[4];
+        ifs.seekg (4);
+        ifs.read (version, 4);
+        assert (memcmp (version, mm, 4) == 0);
+
+        //
+        // reading the last byte returns false, reading
+        // past the end throws
+        //
+
+        char tail[4];
+        ifs.seekg (size - 4);
+        assert (!ifs.read (tail, 4));
+
+        bool caught = false;
+        try
+        {
+            ifs.seekg (size - 2);
+            ifs.readMemoryMapped (4);
+        }
+        catch (const IEX_NAMESPACE::InputExc&)
+        {
+            caught = true;
+        }
+        assert (caught);
+    }
+
+    setMemoryMappedFileInput (false);
+    cout << endl;
+
+    remove (fileName);
+}
+
 } // namespace
 
 void
@@ -871,6 +1040,10 @@ testExistingStreams (const std::string& tempDir)
             (tempDir + "imf_test_streams3.exr").c_str (), W, H, p1);
         writeReadMultiPart (W, H, p1);
 
+        fillPixels2 (p1, W, H);
+        writeReadUncompressed (
+            (tempDir + "imf_test_streams4.exr").c_str (), W, H, p1);
+
         cout << "ok\n" << endl;
     }
     catch (const std::exception& e)
@@ -0,0 +1,501 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <IlmThread.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfStdIO.h>
+#include <ImfThreading.h>
+#include <ImfTileCache.h>
+#include <ImfTiledInputFile.h>
+#include <ImfTiledOutputFile.h>
+#include <ImfTiledRgbaFile.h>
+#include <half.h>
+
+#include <assert.h>
+#include <fstream>
+#include <math.h>
+#include <memory>
+#include <sstream>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+const int W     = 117;
+const int H     = 93;
+const int TILEX = 16;
+const int TILEY = 12;
+
+half
+pixelR (int x, int y, int level, int seed)
+{
+    return half (sin (x * 0.3 + seed) + cos (y * 0.2) + level);
+}
+
+half
+pixelG (int x, int y, int level, int seed)
+{
+    return half (x * 0.01 - y * 0.02 + level * seed);
+}
+
+float
+pixelZ (int x, int y, int level, int seed)
+{
+    return x * 1000.f + y + level * 0.5f + seed;
+}
+
+void
+writeFile (
+    const char fileName[], int seed, Compression compression = ZIP_COMPRESSION)
+{
+    Header header (W, H);
+    header.dataWindow ().min = V2i (-5, 7);
+    header.dataWindow ().max = V2i (-5 + W - 1, 7 + H - 1);
+    header.channels ().insert ("R", Channel (HALF));
+    header.channels ().insert ("G", Channel (HALF));
+    header.channels ().insert ("Z", Channel (FLOAT));
+    header.setTileDescription (
+        TileDescription (TILEX, TILEY, MIPMAP_LEVELS, ROUND_DOWN));
+    header.compression () = compression;
+
+    TiledOutputFile out (fileName, header);
+    const Box2i&    dw = header.dataWindow ();
+
+    for (int l = 0; l < out.numLevels (); ++l)
+    {
+        int            w = out.levelWidth (l);
+        int            h = out.levelHeight (l);
+        Array2D<half>  r (h, w);
+        Array2D<half>  g (h, w);
+        Array2D<float> z (h, w);
+
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            {
+                r[y][x] = pixelR (x, y, l, seed);
+                g[y][x] = pixelG (x, y, l, seed);
+                z[y][x] = pixelZ (x, y, l, seed);
+            }
+
+        size_t      xs = sizeof (half);
+        intptr_t    o  = dw.min.x + dw.min.y * w;
+        FrameBuffer fb;
+        fb.insert ("R", Slice (HALF, (char*) (&r[0][0] - o), xs, xs * w));
+        fb.insert ("G", Slice (HALF, (char*) (&g[0][0] - o), xs, xs * w));
+        fb.insert (
+            "Z",
+            Slice (
+                FLOAT,
+                (char*) (&z[0][0] - o),
+                sizeof (float),
+                sizeof (float) * w));
+        out.setFrameBuffer (fb);
+        out.writeTiles (0, out.numXTiles (l) - 1, 0, out.numYTiles (l) - 1, l);
+    }
+}
+
+int
+numTiles (TiledInputFile& in)
+{
+    int n = 0;
+    for (int l = 0; l < in.numLevels (); ++l)
+        n += in.numXTiles (l) * in.numYTiles (l);
+    return n;
+}
+
+//
+// Read all levels of the file, converting R to float and Z to half
+// so that the frame buffer differs from the file, and compare the
+// pixels with the ones that were written.
+//
+
+void
+readAndCheck (TiledInputFile& in, int seed)
+{
+    const Box2i& dw = in.header ().dataWindow ();
+
+    for (int l = 0; l < in.numLevels (); ++l)
+    {
+        int            w = in.levelWidth (l);
+        int            h = in.levelHeight (l);
+        Array2D<float> r (h, w);
+        Array2D<half>  z (h, w);
+        intptr_t       o = dw.min.x + dw.min.y * w;
+
+        FrameBuffer fb;
+        fb.insert (
+            "R",
+            Slice (
+                FLOAT,
+                (char*) (&r[0][0] - o),
+                sizeof (float),
+                sizeof (float) * w));
+        fb.insert (
+            "Z",
+            Slice (
+                HALF, (char*) (&z[0][0] - o), sizeof (half), sizeof (half) * w));
+        in.setFrameBuffer (fb);
+        in.readTiles (0, in.numXTiles (l) - 1, 0, in.numYTiles (l) - 1, l);
+
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            {
+                assert (r[y][x] == float (pixelR (x, y, l, seed)));
+                assert (z[y][x] == half (pixelZ (x, y, l, seed)));
+            }
+    }
+}
+
+void
+testCacheBasics ()
+{
+    cout << "basic cache operations" << endl;
+
+    assert (TileCache::globalCache ().maxBytes () == 0);
+
+    TileCache cache (4000, 4);
+    assert (cache.maxBytes () == 4000);
+
+    //
+    // the budget is split between the shards: 1000 bytes each
+    //
+
+    TileCache::Key key = {1, 0, 0, 0, 0, 0};
+    assert (!cache.find (key));
+
+    shared_ptr<TileCache::Tile> tile (new TileCache::Tile);
+    tile->data.assign (400, 'x');
+    tile->format = 1;
+    cache.insert (key, tile);
+
+    shared_ptr<const TileCache::Tile> found = cache.find (key);
+    assert (found && found->data.size () == 400 && found->format == 1);
+
+    TileCache::Statistics s = cache.statistics ();
+    assert (s.hits == 1 && s.misses == 1 && s.insertions == 1);
+    assert (s.tiles == 1 && s.bytes == 400);
+
+    //
+    // a tile larger than a shard is not cached
+    //
+
+    shared_ptr<TileCache::Tile> big (new TileCache::Tile);
+    big->data.assign (1001, 'y');
+    TileCache::Key bigKey = {1, 0, 1, 0, 0, 0};
+    cache.insert (bigKey, big);
+    assert (!cache.find (bigKey));
+
+    //
+    // filling the cache evicts the least recently used tiles
+    //
+
+    for (int i = 0; i < 100; ++i)
+    {
+        TileCache::Key k = {2, 1, i, 0, 0, 0};
+        cache.insert (k, tile);
+        assert (cache.statistics ().bytes <= 4000);
+    }
+
+    s = cache.statistics ();
+    assert (s.insertions == 101);
+    assert (s.evictions == s.insertions - s.tiles);
+    assert (s.tiles <= 8);
+
+    //
+    // a recently used tile survives an eviction in its shard
+    //
+
+    TileCache::Key last = {2, 1, 99, 0, 0, 0};
+    assert (cache.find (last));
+
+    //
+    // shrinking the budget evicts, clear() empties the cache
+    //
+
+    cache.setMaxBytes (1600);
+    s = cache.statistics ();
+    assert (s.bytes <= 1600 && s.tiles <= 4);
+
+    cache.clear ();
+    s = cache.statistics ();
+    assert (s.tiles == 0 && s.bytes == 0);
+    assert (!cache.find (last));
+
+    cache.resetStatistics ();
+    s = cache.statistics ();
+    assert (s.hits == 0 && s.misses == 0 && s.insertions == 0);
+    assert (s.evictions == 0);
+
+    //
+    // a cache without a budget holds nothing
+    //
+
+    cache.setMaxBytes (0);
+    cache.insert (key, tile);
+    assert (!cache.find (key));
+}
+
+void
+testSharedTiles (const std::string& fileName)
+{
+    cout << "sharing tiles between files" << endl;
+
+    writeFile (fileName.c_str (), 0);
+
+    TileCache cache (64 * 1024 * 1024);
+
+    int tiles;
+    {
+        TiledInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        assert (in.tileCache () == &cache);
+        tiles = numTiles (in);
+
+        readAndCheck (in, 0);
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.hits == 0);
+        assert (s.misses == uint64_t (tiles));
+        assert (s.insertions == uint64_t (tiles));
+        assert (s.tiles == size_t (tiles));
+    }
+
+    //
+    // a second file reads all of its tiles from the cache
+    //
+
+    {
+        TiledInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        readAndCheck (in, 0);
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.hits == uint64_t (tiles));
+        assert (s.misses == uint64_t (tiles));
+    }
+
+    //
+    // InputFile reads a tiled file through the cache as well
+    //
+
+    {
+        cache.resetStatistics ();
+
+        InputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        assert (in.tileCache () == &cache);
+
+        const Box2i&   dw = in.header ().dataWindow ();
+        Array2D<float> z (H, W);
+        FrameBuffer    fb;
+        fb.insert (
+            "Z",
+            Slice (
+                FLOAT,
+                (char*) (&z[0][0] - dw.min.x - dw.min.y * W),
+                sizeof (float),
+                sizeof (float) * W));
+        in.setFrameBuffer (fb);
+        in.readPixels (dw.min.y, dw.max.y);
+
+        for (int y = 0; y < H; ++y)
+            for (int x = 0; x < W; ++x)
+                assert (z[y][x] == pixelZ (x, y, 0, 0));
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.hits > 0 && s.misses == 0);
+    }
+
+    //
+    // and so does TiledRgbaInputFile
+    //
+
+    {
+        cache.resetStatistics ();
+
+        TiledRgbaInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        assert (in.tileCache () == &cache);
+
+        const Box2i&  dw = in.dataWindow ();
+        Array2D<Rgba> p (H, W);
+        in.setFrameBuffer (&p[0][0] - dw.min.x - dw.min.y * W, 1, W);
+        in.readTiles (0, in.numXTiles () - 1, 0, in.numYTiles () - 1);
+
+        for (int y = 0; y < H; ++y)
+            for (int x = 0; x < W; ++x)
+            {
+                assert (p[y][x].r == pixelR (x, y, 0, 0));
+                assert (p[y][x].g == pixelG (x, y, 0, 0));
+            }
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.hits > 0 && s.misses == 0);
+    }
+
+    //
+    // a rewritten file does not see the tiles of its old contents
+    //
+
+    writeFile (fileName.c_str (), 3);
+    {
+        cache.resetStatistics ();
+
+        TiledInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        readAndCheck (in, 3);
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.misses > 0);
+    }
+
+    remove (fileName.c_str ());
+}
+
+void
+testRewrittenFile (const std::string& fileName)
+{
+    cout << "rewriting a file with the same tile layout" << endl;
+
+    //
+    // Without compression, the tile offsets of the old and the new
+    // contents are the same
+    //
+
+    TileCache cache (64 * 1024 * 1024);
+
+    writeFile (fileName.c_str (), 1, NO_COMPRESSION);
+    {
+        TiledInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        readAndCheck (in, 1);
+    }
+
+    writeFile (fileName.c_str (), 2, NO_COMPRESSION);
+    {
+        cache.resetStatistics ();
+
+        TiledInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        readAndCheck (in, 2);
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.hits == 0);
+        assert (s.misses == uint64_t (numTiles (in)));
+    }
+
+    //
+    // A file that is not read from disk does not use the cache
+    //
+
+    {
+        ifstream     file (fileName.c_str (), ios::binary);
+        StdISStream  is;
+        stringstream data;
+        data << file.rdbuf ();
+        is.str (data.str ());
+
+        TiledInputFile in (is);
+        in.setTileCache (&cache);
+        assert (in.tileCache () == 0);
+        readAndCheck (in, 2);
+    }
+
+    remove (fileName.c_str ());
+}
+
+void
+testSmallBudget (const std::string& fileName)
+{
+    cout << "reading through a cache smaller than the file" << endl;
+
+    writeFile (fileName.c_str (), 1);
+
+    //
+    // a tile is at most 16 x 12 pixels of 8 bytes
+    //
+
+    TileCache cache (6 * TILEX * TILEY * 8, 2);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        TiledInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        readAndCheck (in, 1);
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.bytes <= cache.maxBytes ());
+        assert (s.evictions > 0);
+    }
+
+    //
+    // detaching the cache
+    //
+
+    {
+        cache.resetStatistics ();
+
+        TiledInputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+        in.setTileCache (0);
+        assert (in.tileCache () == 0);
+        readAndCheck (in, 1);
+
+        TileCache::Statistics s = cache.statistics ();
+        assert (s.hits == 0 && s.misses == 0 && s.insertions == 0);
+    }
+
+    remove (fileName.c_str ());
+}
+
+} // namespace
+
+void
+testTileCache (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing the tile cache" << endl;
+
+        std::string fileName = tempDir + "imf_test_tile_cache.exr";
+
+        testCacheBasics ();
+
+        int maxThreads = ILMTHREAD_NAMESPACE::supportsThreads () ? 3 : 0;
+
+        for (int n = 0; n <= maxThreads; n += 3)
+        {
+            if (ILMTHREAD_NAMESPACE::supportsThreads ())
+            {
+                setGlobalThreadCount (n);
+                cout << "\nnumber of threads: " << globalThreadCount () << endl;
+            }
+
+            testSharedTiles (fileName);
+            testRewrittenFile (fileName);
+            testSmallBudget (fileName);
+        }
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
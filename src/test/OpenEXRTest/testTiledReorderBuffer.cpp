@@ -0,0 +1,323 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <Iex.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfPartType.h>
+#include <ImfThreading.h>
+#include <ImfTiledInputFile.h>
+#include <ImfTiledInputPart.h>
+#include <ImfTiledOutputFile.h>
+#include <ImfTiledOutputPart.h>
+#include <half.h>
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+const int W  = 173;
+const int H  = 121;
+const int XS = 16;
+const int YS = 16;
+
+Header
+makeHeader (LineOrder lineOrder, LevelMode levelMode)
+{
+    Header hdr (W, H);
+    hdr.lineOrder () = lineOrder;
+    hdr.channels ().insert ("H", Channel (HALF));
+    hdr.setTileDescription (TileDescription (XS, YS, levelMode));
+    return hdr;
+}
+
+FrameBuffer
+frameBuffer (const Array2D<half>& ph)
+{
+    FrameBuffer fb;
+
+    fb.insert (
+        "H",
+        Slice (
+            HALF,
+            (char*) &ph[0][0],
+            sizeof (ph[0][0]),
+            sizeof (ph[0][0]) * W));
+
+    return fb;
+}
+
+void
+fillPixels (Array2D<half>& ph)
+{
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+            ph[y][x] = sin (double (x)) + sin (y * 0.5);
+}
+
+struct Tile
+{
+    int dx, dy, lx, ly;
+};
+
+//
+// All tiles of all levels, in an order that writes most tiles before
+// the tiles that precede them in the file: levels and rows back to
+// front, and every other row right to left.
+//
+
+template <class File> vector<Tile>
+scrambledTiles (const File& out)
+{
+    vector<Tile> tiles;
+
+    for (int ly = out.numYLevels () - 1; ly >= 0; --ly)
+    {
+        for (int lx = out.numXLevels () - 1; lx >= 0; --lx)
+        {
+            if (!out.isValidLevel (lx, ly)) continue;
+
+            for (int dy = out.numYTiles (ly) - 1; dy >= 0; --dy)
+            {
+                for (int i = 0; i < out.numXTiles (lx); ++i)
+                {
+                    int  dx = (dy & 1) ? i : out.numXTiles (lx) - 1 - i;
+                    Tile t  = {dx, dy, lx, ly};
+                    tiles.push_back (t);
+                }
+            }
+        }
+    }
+
+    return tiles;
+}
+
+//
+// Writes the tiles in scrambled order, all levels with the same
+// pixels, and returns the largest amount of buffered pixel data.
+//
+
+template <class File>
+size_t
+writeScrambled (File& out, const Array2D<half>& ph)
+{
+    out.setFrameBuffer (frameBuffer (ph));
+
+    vector<Tile> tiles     = scrambledTiles (out);
+    size_t       maxBuffer = 0;
+
+    for (size_t i = 0; i < tiles.size (); ++i)
+    {
+        out.writeTile (tiles[i].dx, tiles[i].dy, tiles[i].lx, tiles[i].ly);
+        maxBuffer = max (maxBuffer, out.reorderBufferSize ());
+    }
+
+    assert (out.reorderBufferSize () == 0);
+    return maxBuffer;
+}
+
+template <class File>
+void
+readAndCompare (File& in, const Array2D<half>& ph)
+{
+    Array2D<half> ph2 (H, W);
+
+    in.setFrameBuffer (frameBuffer (ph2));
+
+    for (int ly = 0; ly < in.numYLevels (); ++ly)
+    {
+        for (int lx = 0; lx < in.numXLevels (); ++lx)
+        {
+            if (!in.isValidLevel (lx, ly)) continue;
+
+            in.readTiles (
+                0, in.numXTiles (lx) - 1, 0, in.numYTiles (ly) - 1, lx, ly);
+
+            for (int y = 0; y < in.levelHeight (ly); ++y)
+                for (int x = 0; x < in.levelWidth (lx); ++x)
+                    assert (ph2[y][x] == ph[y][x]);
+        }
+    }
+}
+
+void
+testUnlimited (const string& fileName, const Array2D<half>& ph)
+{
+    for (int order = INCREASING_Y; order <= DECREASING_Y; ++order)
+    {
+        cout << "    no limit, line order " << order << endl;
+
+        size_t maxBuffer;
+
+        {
+            TiledOutputFile out (
+                fileName.c_str (),
+                makeHeader (LineOrder (order), RIPMAP_LEVELS));
+
+            maxBuffer = writeScrambled (out, ph);
+            assert (out.header ().lineOrder () == LineOrder (order));
+        }
+
+        assert (maxBuffer > 0);
+
+        TiledInputFile in (fileName.c_str ());
+        assert (in.header ().lineOrder () == LineOrder (order));
+        readAndCompare (in, ph);
+    }
+}
+
+void
+testLimit (const string& fileName, const Array2D<half>& ph)
+{
+    cout << "    limited" << endl;
+
+    const size_t limit = 4 * XS * YS * sizeof (half);
+
+    {
+        TiledOutputFile out (
+            fileName.c_str (), makeHeader (INCREASING_Y, MIPMAP_LEVELS));
+
+        out.setReorderBufferLimit (limit);
+        assert (out.reorderBufferLimit () == limit);
+
+        size_t maxBuffer = writeScrambled (out, ph);
+        assert (maxBuffer <= limit);
+        assert (out.header ().lineOrder () == RANDOM_Y);
+
+        //
+        // Tiles are still written only once
+        //
+
+        try
+        {
+            out.writeTile (0, 0, 0, 0);
+            assert (false);
+        }
+        catch (const IEX_NAMESPACE::ArgExc&)
+        {}
+    }
+
+    TiledInputFile in (fileName.c_str ());
+    assert (in.header ().lineOrder () == RANDOM_Y);
+    assert (in.isComplete ());
+    readAndCompare (in, ph);
+
+    //
+    // Lowering the limit below the buffered data stores it at once
+    //
+
+    {
+        TiledOutputFile out (
+            fileName.c_str (), makeHeader (DECREASING_Y, ONE_LEVEL));
+
+        out.setFrameBuffer (frameBuffer (ph));
+
+        out.writeTile (0, 0, 0, 0);
+        out.writeTile (1, 0, 0, 0);
+        assert (out.reorderBufferSize () > 0);
+
+        out.setReorderBufferLimit (0);
+        assert (out.reorderBufferSize () == 0);
+        assert (out.header ().lineOrder () == RANDOM_Y);
+
+        out.writeTiles (0, out.numXTiles () - 1, 1, out.numYTiles () - 1);
+        out.writeTiles (2, out.numXTiles () - 1, 0, 0);
+    }
+
+    TiledInputFile in2 (fileName.c_str ());
+    assert (in2.header ().lineOrder () == RANDOM_Y);
+    readAndCompare (in2, ph);
+}
+
+void
+testMultiPart (const string& fileName, const Array2D<half>& ph)
+{
+    cout << "    multi-part file" << endl;
+
+    vector<Header> headers;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        headers.push_back (makeHeader (INCREASING_Y, ONE_LEVEL));
+        headers.back ().setName (i ? "limited" : "unlimited");
+        headers.back ().setType (TILEDIMAGE);
+    }
+
+    {
+        MultiPartOutputFile out (fileName.c_str (), &headers[0], 2);
+
+        TiledOutputPart part0 (out, 0);
+        TiledOutputPart part1 (out, 1);
+        part1.setReorderBufferLimit (0);
+
+        writeScrambled (part0, ph);
+        assert (writeScrambled (part1, ph) == 0);
+    }
+
+    MultiPartInputFile in (fileName.c_str ());
+    assert (in.header (0).lineOrder () == INCREASING_Y);
+    assert (in.header (1).lineOrder () == RANDOM_Y);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        TiledInputPart part (in, i);
+        readAndCompare (part, ph);
+    }
+}
+
+} // namespace
+
+void
+testTiledReorderBuffer (const string& tempDir)
+{
+    try
+    {
+        cout << "Testing the reorder buffer of tiled output files" << endl;
+
+        string fileName = tempDir + "imf_test_tiled_reorder.exr";
+
+        Array2D<half> ph (H, W);
+        fillPixels (ph);
+
+        int threads = globalThreadCount ();
+
+        for (int n = 0; n <= 3; n += 3)
+        {
+            cout << "  " << n << " threads" << endl;
+            setGlobalThreadCount (n);
+
+            testUnlimited (fileName, ph);
+            testLimit (fileName, ph);
+            testMultiPart (fileName, ph);
+        }
+
+        setGlobalThreadCount (threads);
+
+        remove (fileName.c_str ());
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
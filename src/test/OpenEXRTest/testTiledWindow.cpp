@@ -0,0 +1,312 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <IlmThread.h>
+#include <ImathRandom.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfThreading.h>
+#include <ImfTileCache.h>
+#include <ImfTiledInputFile.h>
+#include <ImfTiledOutputFile.h>
+#include <half.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+const int TILEX = 16;
+const int TILEY = 12;
+
+const Box2i dataWindow (V2i (-13, 5), V2i (-13 + 150, 5 + 100));
+
+half
+pixelR (int x, int y)
+{
+    return half (x * 0.25f - y * 0.125f);
+}
+
+float
+pixelZ (int x, int y)
+{
+    return x * 1000.f + y;
+}
+
+void
+writeFile (const char fileName[], LineOrder lorder, bool tiled)
+{
+    int W = dataWindow.max.x - dataWindow.min.x + 1;
+    int H = dataWindow.max.y - dataWindow.min.y + 1;
+
+    Header header (W, H);
+    header.dataWindow () = dataWindow;
+    header.lineOrder ()  = lorder;
+    header.channels ().insert ("R", Channel (HALF));
+    header.channels ().insert ("Z", Channel (FLOAT));
+    header.compression () = ZIP_COMPRESSION;
+
+    Array2D<half>  r (H, W);
+    Array2D<float> z (H, W);
+
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+        {
+            r[y][x] = pixelR (x + dataWindow.min.x, y + dataWindow.min.y);
+            z[y][x] = pixelZ (x + dataWindow.min.x, y + dataWindow.min.y);
+        }
+
+    intptr_t    o = dataWindow.min.x + dataWindow.min.y * W;
+    FrameBuffer fb;
+    fb.insert (
+        "R",
+        Slice (
+            HALF, (char*) (&r[0][0] - o), sizeof (half), sizeof (half) * W));
+    fb.insert (
+        "Z",
+        Slice (
+            FLOAT,
+            (char*) (&z[0][0] - o),
+            sizeof (float),
+            sizeof (float) * W));
+
+    if (tiled)
+    {
+        header.setTileDescription (TileDescription (TILEX, TILEY, ONE_LEVEL));
+
+        TiledOutputFile out (fileName, header);
+        out.setFrameBuffer (fb);
+        out.writeTiles (0, out.numXTiles () - 1, 0, out.numYTiles () - 1);
+    }
+    else
+    {
+        OutputFile out (fileName, header);
+        out.setFrameBuffer (fb);
+        out.writePixels (H);
+    }
+}
+
+//
+// Read a window of the file into a buffer that covers the window and
+// a border of two pixels around it, reading Z as half, R as float,
+// and a channel "A" which is not in the file.  The pixels in the
+// window must match the file, the border must not be written.
+//
+
+void
+readWindow (InputFile& in, const Box2i& window, bool wholeScanLines)
+{
+    const float border = -1234.f;
+
+    int x0 = window.min.x - 2;
+    int y0 = window.min.y - 2;
+    int w  = window.max.x - window.min.x + 5;
+    int h  = window.max.y - window.min.y + 5;
+
+    if (wholeScanLines)
+    {
+        x0 = dataWindow.min.x;
+        w  = dataWindow.max.x - dataWindow.min.x + 1;
+    }
+
+    Array2D<float> r (h, w);
+    Array2D<half>  z (h, w);
+    Array2D<float> a (h, w);
+
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            r[y][x] = z[y][x] = a[y][x] = border;
+
+    intptr_t    o = x0 + intptr_t (y0) * w;
+    FrameBuffer fb;
+    fb.insert (
+        "R",
+        Slice (
+            FLOAT,
+            (char*) (&r[0][0] - o),
+            sizeof (float),
+            sizeof (float) * w));
+    fb.insert (
+        "Z",
+        Slice (HALF, (char*) (&z[0][0] - o), sizeof (half), sizeof (half) * w));
+    fb.insert (
+        "A",
+        Slice (
+            FLOAT,
+            (char*) (&a[0][0] - o),
+            sizeof (float),
+            sizeof (float) * w,
+            1,
+            1,
+            0.5));
+    in.setFrameBuffer (fb);
+    in.readPixels (window);
+
+    Box2i inside = window;
+    inside.min.x = max (inside.min.x, dataWindow.min.x);
+    inside.max.x = min (inside.max.x, dataWindow.max.x);
+
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+        {
+            int  px       = x + x0;
+            int  py       = y + y0;
+            bool inWindow = inside.intersects (V2i (px, py));
+
+            if (inWindow)
+            {
+                assert (r[y][x] == float (pixelR (px, py)));
+                assert (z[y][x] == half (pixelZ (px, py)));
+                assert (a[y][x] == 0.5f);
+            }
+            else if (!wholeScanLines || py < window.min.y || py > window.max.y)
+            {
+                assert (r[y][x] == border);
+                assert (z[y][x] == half (border));
+                assert (a[y][x] == border);
+            }
+        }
+}
+
+Box2i
+randomWindow (Rand48& random)
+{
+    int x1 = random.nexti () % 170 - 20 + dataWindow.min.x;
+    int x2 = x1 + random.nexti () % 40;
+    int y1 = random.nexti () % 100 + dataWindow.min.y;
+    int y2 = min (dataWindow.max.y, y1 + int (random.nexti () % 30));
+
+    if (x1 > dataWindow.max.x) x1 = dataWindow.max.x;
+    if (x2 < dataWindow.min.x) x2 = dataWindow.min.x;
+
+    return Box2i (V2i (x1, y1), V2i (x2, y2));
+}
+
+void
+testWindows (const std::string& fileName, LineOrder lorder)
+{
+    cout << "line order " << lorder << endl;
+
+    writeFile (fileName.c_str (), lorder, true);
+
+    Rand48 random (lorder);
+
+    {
+        InputFile in (fileName.c_str ());
+
+        for (int i = 0; i < 60; ++i)
+            readWindow (in, randomWindow (random), false);
+
+        //
+        // a window covering the whole data window, and one scan line
+        // at a time across the whole width, both ways
+        //
+
+        readWindow (in, dataWindow, false);
+
+        for (int y = dataWindow.min.y; y <= dataWindow.max.y; ++y)
+            readWindow (
+                in,
+                Box2i (V2i (dataWindow.min.x, y), V2i (dataWindow.max.x, y)),
+                false);
+
+        for (int y = dataWindow.max.y; y >= dataWindow.min.y; --y)
+            readWindow (in, Box2i (V2i (20, y), V2i (40, y)), false);
+    }
+
+    //
+    // only the tiles that intersect a window are read: a window in
+    // one column of tiles reads one tile per row of tiles (and, with
+    // threads, some following rows in the same column)
+    //
+
+    {
+        TileCache cache (64 * 1024 * 1024);
+        InputFile in (fileName.c_str ());
+        in.setTileCache (&cache);
+
+        int   x0 = dataWindow.min.x + 2 * TILEX;
+        Box2i window (
+            V2i (x0 + 3, dataWindow.min.y + TILEY + 1),
+            V2i (x0 + 7, dataWindow.min.y + 3 * TILEY - 2));
+        readWindow (in, window, false);
+
+        TileCache::Statistics s = cache.statistics ();
+        uint64_t rows = (dataWindow.max.y - dataWindow.min.y + TILEY) / TILEY;
+
+        assert (s.misses >= 2);
+        if (globalThreadCount () == 0)
+            assert (s.misses == 2);
+        else
+            assert (s.misses <= rows);
+    }
+}
+
+void
+testScanLineFile (const std::string& fileName)
+{
+    cout << "scan line file" << endl;
+
+    writeFile (fileName.c_str (), INCREASING_Y, false);
+
+    Rand48    random (7);
+    InputFile in (fileName.c_str ());
+
+    for (int i = 0; i < 10; ++i)
+        readWindow (in, randomWindow (random), true);
+
+    remove (fileName.c_str ());
+}
+
+} // namespace
+
+void
+testTiledWindow (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing reading windows of tiled files with InputFile"
+             << endl;
+
+        std::string fileName = tempDir + "imf_test_tiled_window.exr";
+
+        int maxThreads = ILMTHREAD_NAMESPACE::supportsThreads () ? 3 : 0;
+
+        for (int n = 0; n <= maxThreads; n += 3)
+        {
+            if (ILMTHREAD_NAMESPACE::supportsThreads ())
+            {
+                setGlobalThreadCount (n);
+                cout << "\nnumber of threads: " << globalThreadCount () << endl;
+            }
+
+            testWindows (fileName, INCREASING_Y);
+            testWindows (fileName, DECREASING_Y);
+            testWindows (fileName, RANDOM_Y);
+            testScanLineFile (fileName);
+        }
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
@@ -0,0 +1,223 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include "testWorkStealingThreadPool.h"
+
+#include <IlmThreadConfig.h>
+#include <IlmThreadPool.h>
+
+#include <assert.h>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+using namespace ILMTHREAD_NAMESPACE;
+
+namespace
+{
+
+class CountTask : public Task
+{
+public:
+    CountTask (TaskGroup* group, atomic<int>& count)
+        : Task (group), _count (count)
+    {}
+
+    void execute () { ++_count; }
+
+private:
+    atomic<int>& _count;
+};
+
+//
+// Spawns more tasks from inside a worker thread, and waits for
+// them there, as the library does for nested line buffers
+//
+
+class SpawnTask : public Task
+{
+public:
+    SpawnTask (TaskGroup* group, ThreadPool& pool, atomic<int>& count, int n)
+        : Task (group), _pool (pool), _count (count), _n (n)
+    {}
+
+    void execute ()
+    {
+        {
+            TaskGroup group;
+            for (int i = 0; i < _n; ++i)
+                _pool.addTask (new CountTask (&group, _count));
+        }
+
+        //
+        // The nested group must be complete once its destructor returns
+        //
+
+        assert (_count.load () >= _n);
+    }
+
+private:
+    ThreadPool&  _pool;
+    atomic<int>& _count;
+    int          _n;
+};
+
+//
+// Set while a task waits for a nested group, an unrelated task that
+// runs then on the same thread could need a lock the waiter holds
+//
+
+thread_local bool tlWaiting = false;
+
+class UnrelatedTask : public Task
+{
+public:
+    UnrelatedTask (TaskGroup* group, atomic<int>& violations)
+        : Task (group), _violations (violations)
+    {}
+
+    void execute ()
+    {
+        if (tlWaiting) ++_violations;
+    }
+
+private:
+    atomic<int>& _violations;
+};
+
+class WaitingTask : public Task
+{
+public:
+    WaitingTask (
+        TaskGroup*   group,
+        TaskGroup*   unrelated,
+        ThreadPool&  pool,
+        atomic<int>& count,
+        atomic<int>& violations)
+        : Task (group)
+        , _unrelated (unrelated)
+        , _pool (pool)
+        , _count (count)
+        , _violations (violations)
+    {}
+
+    void execute ()
+    {
+        TaskGroup* group = new TaskGroup;
+        _pool.addTask (new CountTask (group, _count));
+        _pool.addTask (new UnrelatedTask (_unrelated, _violations));
+
+        tlWaiting = true;
+        delete group;
+        tlWaiting = false;
+    }
+
+private:
+    TaskGroup*   _unrelated;
+    ThreadPool&  _pool;
+    atomic<int>& _count;
+    atomic<int>& _violations;
+};
+
+void
+runWaitingTasks (ThreadPool& pool, int numTasks)
+{
+    atomic<int> count (0);
+    atomic<int> violations (0);
+    {
+        TaskGroup unrelated;
+        TaskGroup group;
+        for (int i = 0; i < numTasks; ++i)
+            pool.addTask (new WaitingTask (
+                &group, &unrelated, pool, count, violations));
+    }
+    assert (count.load () == numTasks);
+    assert (violations.load () == 0);
+}
+
+void
+runTasks (ThreadPool& pool, int numTasks)
+{
+    atomic<int> count (0);
+    {
+        TaskGroup group;
+        for (int i = 0; i < numTasks; ++i)
+            pool.addTask (new CountTask (&group, count));
+    }
+    assert (count.load () == numTasks);
+}
+
+void
+runNestedTasks (ThreadPool& pool, int numOuter, int numInner)
+{
+    atomic<int> count (0);
+    {
+        TaskGroup group;
+        for (int i = 0; i < numOuter; ++i)
+            pool.addTask (new SpawnTask (&group, pool, count, numInner));
+    }
+    assert (count.load () == numOuter * numInner);
+}
+
+} // namespace
+
+void
+testWorkStealingThreadPool (const std::string&)
+{
+    cout << "Testing work stealing thread pool provider" << endl;
+
+#if ILMTHREAD_THREADING_ENABLED
+    ThreadPool pool (0);
+    pool.setThreadProvider (ThreadPool::createWorkStealingProvider (4));
+    assert (pool.numThreads () == 4);
+
+    cout << "  flat tasks" << endl;
+    runTasks (pool, 10000);
+
+    cout << "  nested tasks" << endl;
+    runNestedTasks (pool, 64, 200);
+
+    //
+    // Grow the workers' queues while the others steal from them, and
+    // drain them again, so the replaced arrays are freed
+    //
+
+    for (int i = 0; i < 20; ++i)
+        runNestedTasks (pool, 8, 2000);
+
+    //
+    // More outer tasks than threads, all blocking on nested groups
+    //
+
+    pool.setNumThreads (2);
+    assert (pool.numThreads () == 2);
+    runNestedTasks (pool, 32, 50);
+
+    cout << "  waiting runs only its own group" << endl;
+    pool.setNumThreads (1);
+    runWaitingTasks (pool, 100);
+    pool.setNumThreads (3);
+    runWaitingTasks (pool, 100);
+
+    cout << "  no threads" << endl;
+    pool.setNumThreads (0);
+    assert (pool.numThreads () == 0);
+    runTasks (pool, 100);
+    runNestedTasks (pool, 4, 10);
+
+    pool.setNumThreads (8);
+    assert (pool.numThreads () == 8);
+    runTasks (pool, 1000);
+
+    cout << "ok\n" << endl;
+#else
+    assert (ThreadPool::createWorkStealingProvider (4) == nullptr);
+    cout << "threading disabled, skipped\n" << endl;
+#endif
+}
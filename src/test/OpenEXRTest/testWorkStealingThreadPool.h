@@ -0,0 +1,13 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef TESTWORKSTEALINGTHREADPOOL_H_
+#define TESTWORKSTEALINGTHREADPOOL_H_
+
+#include <string>
+
+void testWorkStealingThreadPool (const std::string& tempDir);
+
+#endif /* TESTWORKSTEALINGTHREADPOOL_H_ */
@@ -0,0 +1,334 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <Iex.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfInputPart.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfOutputPart.h>
+#include <ImfPartType.h>
+#include <ImfThreading.h>
+#include <half.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+const int W = 117;
+const int H = 97;
+
+float
+pixelValue (int x, int y)
+{
+    return float (x % 13) + 16 * float (y % 23);
+}
+
+Header
+makeHeader (LineOrder lineOrder, Compression compression)
+{
+    Header hdr (W, H);
+    hdr.lineOrder ()   = lineOrder;
+    hdr.compression () = compression;
+    hdr.channels ().insert ("H", Channel (HALF));
+    hdr.channels ().insert ("F", Channel (FLOAT));
+    return hdr;
+}
+
+//
+// A frame buffer that holds a single scan line, which is
+// mapped to scan line y of the image.
+//
+
+struct LineBuffer
+{
+    vector<half>  h;
+    vector<float> f;
+
+    LineBuffer () : h (W), f (W) {}
+
+    FrameBuffer frameBuffer (int y)
+    {
+        FrameBuffer fb;
+
+        fb.insert (
+            "H",
+            Slice (
+                HALF,
+                (char*) (&h[0] - y * W),
+                sizeof (half),
+                sizeof (half) * W));
+
+        fb.insert (
+            "F",
+            Slice (
+                FLOAT,
+                (char*) (&f[0] - y * W),
+                sizeof (float),
+                sizeof (float) * W));
+
+        return fb;
+    }
+
+    void fill (int y)
+    {
+        for (int x = 0; x < W; ++x)
+            h[x] = f[x] = pixelValue (x, y);
+    }
+
+    void scribble ()
+    {
+        for (int x = 0; x < W; ++x)
+            h[x] = f[x] = -1;
+    }
+};
+
+//
+// Write the image one scan line at a time, from a frame buffer
+// that is overwritten as soon as writePixels() returns.
+//
+
+template <class File>
+void
+writeLines (File& out)
+{
+    LineBuffer line;
+    bool       increasing = out.header ().lineOrder () == INCREASING_Y;
+
+    for (int i = 0; i < H; ++i)
+    {
+        int y = increasing ? i : H - 1 - i;
+
+        line.fill (y);
+        out.setFrameBuffer (line.frameBuffer (y));
+        out.writePixels (1);
+        line.scribble ();
+
+        assert (out.currentScanLine () == (increasing ? y + 1 : y - 1));
+    }
+}
+
+template <class File>
+void
+readAndCompare (File& in)
+{
+    Array2D<half>  h (H, W);
+    Array2D<float> f (H, W);
+
+    FrameBuffer fb;
+
+    fb.insert (
+        "H",
+        Slice (HALF, (char*) &h[0][0], sizeof (half), sizeof (half) * W));
+
+    fb.insert (
+        "F",
+        Slice (FLOAT, (char*) &f[0][0], sizeof (float), sizeof (float) * W));
+
+    in.setFrameBuffer (fb);
+    in.readPixels (0, H - 1);
+
+    for (int y = 0; y < H; ++y)
+    {
+        for (int x = 0; x < W; ++x)
+        {
+            assert (h[y][x] == half (pixelValue (x, y)));
+            assert (f[y][x] == pixelValue (x, y));
+        }
+    }
+}
+
+void
+testDepths (const string& fileName)
+{
+    static const Compression compressions[] = {
+        NO_COMPRESSION, ZIPS_COMPRESSION, ZIP_COMPRESSION, PIZ_COMPRESSION};
+
+    static const int depths[] = {0, 1, 3, 8};
+
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int order = INCREASING_Y; order <= DECREASING_Y; ++order)
+        {
+            for (int d = 0; d < 4; ++d)
+            {
+                cout << "    compression " << compressions[c]
+                     << ", line order " << order << ", depth " << depths[d]
+                     << endl;
+
+                {
+                    OutputFile out (
+                        fileName.c_str (),
+                        makeHeader (LineOrder (order), compressions[c]));
+
+                    out.setWritePipelineDepth (depths[d]);
+                    assert (out.writePipelineDepth () == depths[d]);
+
+                    writeLines (out);
+
+                    //
+                    // Leave the last line buffers to the destructor
+                    // every other time.
+                    //
+
+                    if (d % 2) out.flush ();
+                }
+
+                InputFile in (fileName.c_str ());
+                assert (in.isComplete ());
+                readAndCompare (in);
+            }
+        }
+    }
+}
+
+void
+testErrors (const string& fileName)
+{
+    cout << "    errors" << endl;
+
+    OutputFile out (
+        fileName.c_str (), makeHeader (INCREASING_Y, ZIP_COMPRESSION));
+
+    try
+    {
+        out.setWritePipelineDepth (-1);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+
+    out.setWritePipelineDepth (2);
+
+    LineBuffer line;
+    line.fill (0);
+    out.setFrameBuffer (line.frameBuffer (0));
+    out.writePixels (1);
+
+    try
+    {
+        out.setWritePipelineDepth (4);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::LogicExc&)
+    {}
+
+    assert (out.writePipelineDepth () == 2);
+
+    try
+    {
+        out.writePixels (H);
+        assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc&)
+    {}
+
+    assert (out.currentScanLine () == 1);
+}
+
+void
+testMultiPart (const string& fileName)
+{
+    cout << "    multi-part file" << endl;
+
+    vector<Header> headers;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        headers.push_back (makeHeader (
+            i ? DECREASING_Y : INCREASING_Y, PIZ_COMPRESSION));
+
+        headers.back ().setName (i ? "decreasing" : "increasing");
+        headers.back ().setType (SCANLINEIMAGE);
+    }
+
+    {
+        MultiPartOutputFile out (fileName.c_str (), &headers[0], 2);
+
+        OutputPart part0 (out, 0);
+        OutputPart part1 (out, 1);
+        part0.setWritePipelineDepth (3);
+        part1.setWritePipelineDepth (2);
+
+        //
+        // Interleave the parts' scan lines
+        //
+
+        LineBuffer line;
+
+        for (int i = 0; i < H; ++i)
+        {
+            line.fill (i);
+            part0.setFrameBuffer (line.frameBuffer (i));
+            part0.writePixels (1);
+
+            line.fill (H - 1 - i);
+            part1.setFrameBuffer (line.frameBuffer (H - 1 - i));
+            part1.writePixels (1);
+        }
+
+        part0.flush ();
+    }
+
+    MultiPartInputFile in (fileName.c_str ());
+
+    for (int i = 0; i < 2; ++i)
+    {
+        InputPart part (in, i);
+        readAndCompare (part);
+    }
+}
+
+} // namespace
+
+void
+testWritePipeline (const string& tempDir)
+{
+    try
+    {
+        cout << "Testing pipelined scan line output" << endl;
+
+        string fileName = tempDir + "imf_test_write_pipeline.exr";
+
+        int threads = globalThreadCount ();
+
+        for (int n = 0; n <= 3; n += 3)
+        {
+            cout << "  " << n << " threads" << endl;
+            setGlobalThreadCount (n);
+
+            testDepths (fileName);
+            testErrors (fileName);
+            testMultiPart (fileName);
+        }
+
+        setGlobalThreadCount (threads);
+
+        remove (fileName.c_str ());
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
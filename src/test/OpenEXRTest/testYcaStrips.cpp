@@ -0,0 +1,338 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include "IlmThread.h"
+#include <ImfArray.h>
+#include <ImfRgbaFile.h>
+#include <ImfRgbaYca.h>
+#include <ImfSimd.h>
+#include <ImfThreading.h>
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+namespace
+{
+
+//
+// Fill the pixels with smooth color gradients, sprinkled with
+// highly saturated pixels and with values that are outside the
+// range of the luminance/chroma conversions: negative numbers,
+// very large numbers, infinities and NaNs.
+//
+
+void
+fillPixels (Array2D<Rgba>& pixels, int w, int h)
+{
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            Rgba& p = pixels[y][x];
+
+            p.r = 0.8 + 0.5 * sin (x * 0.05);
+            p.g = 0.8 + 0.5 * sin (x * 0.02 + y * 0.02);
+            p.b = 0.8 + 0.5 * sin (y * 0.03);
+            p.a = 0.5 + 0.5 * cos (x * 0.05 - y * 0.05);
+
+            switch ((x * 7 + y * 13) % 29)
+            {
+                case 0:
+                    p.r = 0;
+                    p.g = 0;
+                    break;
+                case 1: p.b = -0.25; break;
+                case 2: p.g = 60000; break;
+                case 3: p.r = half::posInf (); break;
+                case 4: p.b = half::qNan (); break;
+                case 5: p.g = 1e-6; break;
+            }
+        }
+    }
+}
+
+void
+writeFile (
+    const string&        fileName,
+    const Box2i&         dw,
+    RgbaChannels         channels,
+    LineOrder            lineOrder,
+    const Array2D<Rgba>& pixels,
+    bool                 lineByLine)
+{
+    int w = dw.max.x - dw.min.x + 1;
+    int h = dw.max.y - dw.min.y + 1;
+
+    RgbaOutputFile out (
+        fileName.c_str (),
+        dw,
+        dw, // display window, data window
+        channels,
+        1,          // pixelAspectRatio
+        V2f (0, 0), // screenWindowCenter
+        1,          // screenWindowWidth
+        lineOrder);
+
+    out.setFrameBuffer (&pixels[-dw.min.y][-dw.min.x], 1, w);
+
+    if (lineByLine)
+    {
+        for (int i = 0; i < h; ++i)
+            out.writePixels (1);
+    }
+    else
+    {
+        out.writePixels (h);
+    }
+}
+
+void
+readFile (
+    const string&  fileName,
+    const Box2i&   dw,
+    Array2D<Rgba>& pixels,
+    bool           lineByLine)
+{
+    int w = dw.max.x - dw.min.x + 1;
+
+    RgbaInputFile in (fileName.c_str ());
+    in.setFrameBuffer (&pixels[-dw.min.y][-dw.min.x], 1, w);
+
+    if (lineByLine)
+    {
+        for (int y = dw.min.y; y <= dw.max.y; ++y)
+            in.readPixels (y);
+    }
+    else
+    {
+        in.readPixels (dw.min.y, dw.max.y);
+    }
+}
+
+void
+readBytes (const string& fileName, vector<char>& bytes)
+{
+    FILE* f = fopen (fileName.c_str (), "rb");
+    assert (f != 0);
+
+    bytes.clear ();
+    char buf[4096];
+    size_t n;
+
+    while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+        bytes.insert (bytes.end (), buf, buf + n);
+
+    fclose (f);
+}
+
+bool
+samePixels (const Array2D<Rgba>& p1, const Array2D<Rgba>& p2, int w, int h)
+{
+    return memcmp (&p1[0][0], &p2[0][0], sizeof (Rgba) * w * h) == 0;
+}
+
+//
+// Writing an image all at once, in strips of scan lines, must
+// produce the same file as writing it one scan line at a time,
+// and reading the image all at once must produce the same pixels
+// as reading it one scan line at a time.
+//
+
+void
+writeReadStrips (
+    const string& fileName,
+    const Box2i&  dw,
+    RgbaChannels  channels,
+    LineOrder     lineOrder)
+{
+    int w = dw.max.x - dw.min.x + 1;
+    int h = dw.max.y - dw.min.y + 1;
+
+    cout << w << " by " << h << " pixels, channels " << channels
+         << ", line order " << lineOrder << endl;
+
+    Array2D<Rgba> pixels (h, w);
+    fillPixels (pixels, w, h);
+
+    string fileName2 = fileName + "2";
+
+    writeFile (fileName, dw, channels, lineOrder, pixels, false);
+    writeFile (fileName2, dw, channels, lineOrder, pixels, true);
+
+    vector<char> bytes1, bytes2;
+    readBytes (fileName, bytes1);
+    readBytes (fileName2, bytes2);
+    assert (bytes1 == bytes2);
+
+    Array2D<Rgba> pixels1 (h, w);
+    Array2D<Rgba> pixels2 (h, w);
+    memset (&pixels1[0][0], 0, sizeof (Rgba) * w * h);
+    memset (&pixels2[0][0], 0xff, sizeof (Rgba) * w * h);
+
+    readFile (fileName, dw, pixels1, false);
+    readFile (fileName, dw, pixels2, true);
+    assert (samePixels (pixels1, pixels2, w, h));
+
+    remove (fileName.c_str ());
+    remove (fileName2.c_str ());
+}
+
+//
+// Convert pixels that contain every possible half bit pattern, both
+// four at a time and one at a time, and with denormal floats flushed
+// to zero if the floating-point unit supports that.  The conversions
+// must not depend on how the floating-point unit treats denormals,
+// and converting a half to float must give the same result as
+// half::operator float(), also for half denormals.
+//
+
+void
+convertAllHalfs ()
+{
+    cout << "converting all half values" << endl;
+
+#ifdef IMF_HAVE_SSE2
+    const unsigned int csr = _mm_getcsr ();
+    _mm_setcsr (csr | 0x8040); // FTZ and DAZ
+#endif
+
+    const V3f yw = RgbaYca::computeYw (Chromaticities ());
+    const int n  = 1 << 16;
+
+    vector<Rgba> gray (n), yca (n), chroma (n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        half h;
+        h.setBits (i);
+
+        gray[i]   = Rgba (h, h, h, h);
+        yca[i]    = Rgba (1, h, 0, 1);
+        chroma[i] = Rgba (h, 1, h, 1);
+    }
+
+    vector<Rgba> out4 (n), out1 (n);
+
+    RgbaYca::RGBAtoYCA (yw, n, true, &gray[0], &out4[0]);
+
+    for (int i = 0; i < n; ++i)
+        RgbaYca::RGBAtoYCA (yw, 1, true, &gray[i], &out1[i]);
+
+    assert (memcmp (&out4[0], &out1[0], n * sizeof (Rgba)) == 0);
+
+    for (int i = 0; i < n; ++i)
+    {
+        //
+        // Equal R, G and B values are copied to Y, after negative
+        // numbers, infinities and NaNs have been replaced with zero.
+        //
+
+        half h = gray[i].g;
+
+        if (h.isFinite () && float (h) >= 0)
+            assert (out4[i].g.bits () == h.bits ());
+        else
+            assert (out4[i].g.bits () == 0);
+    }
+
+    RgbaYca::YCAtoRGBA (yw, n, &yca[0], &out4[0]);
+
+    for (int i = 0; i < n; ++i)
+        RgbaYca::YCAtoRGBA (yw, 1, &yca[i], &out1[i]);
+
+    assert (memcmp (&out4[0], &out1[0], n * sizeof (Rgba)) == 0);
+
+    for (int i = 0; i < n; ++i)
+    {
+        //
+        // With zero blue chroma, blue is equal to Y.
+        //
+
+        half h = yca[i].g;
+
+        if (h.isFinite ()) assert (out4[i].b.bits () == h.bits ());
+    }
+
+    RgbaYca::YCAtoRGBA (yw, n, &chroma[0], &out4[0]);
+
+    for (int i = 0; i < n; ++i)
+        RgbaYca::YCAtoRGBA (yw, 1, &chroma[i], &out1[i]);
+
+    assert (memcmp (&out4[0], &out1[0], n * sizeof (Rgba)) == 0);
+
+#ifdef IMF_HAVE_SSE2
+    _mm_setcsr (csr);
+#endif
+}
+
+} // namespace
+
+void
+testYcaStrips (const std::string& tempDir)
+{
+    try
+    {
+        cout << "Testing luminance/chroma strip input and output" << endl;
+
+        convertAllHalfs ();
+
+        std::string fileName = tempDir + "imf_test_yca_strips.exr";
+
+        Box2i dataWindow[4];
+        dataWindow[0] = Box2i (V2i (0, 0), V2i (1, 1));
+        dataWindow[1] = Box2i (V2i (0, 0), V2i (37, 69));
+        dataWindow[2] = Box2i (V2i (-18, -28), V2i (247, 255));
+        dataWindow[3] = Box2i (V2i (6, 10), V2i (9, 211));
+
+        RgbaChannels channels[4] = {WRITE_YCA, WRITE_YC, WRITE_YA, WRITE_Y};
+
+        int maxThreads = ILMTHREAD_NAMESPACE::supportsThreads () ? 3 : 0;
+        int threads    = globalThreadCount ();
+
+        for (int n = 0; n <= maxThreads; n += 3)
+        {
+            cout << "number of threads: " << n << endl;
+            setGlobalThreadCount (n);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                for (int j = 0; j < 4; ++j)
+                {
+                    //
+                    // Images with chroma must be more than
+                    // two scan lines high.
+                    //
+
+                    if (i == 0 && (channels[j] & WRITE_C)) continue;
+
+                    writeReadStrips (
+                        fileName, dataWindow[i], channels[j], INCREASING_Y);
+
+                    writeReadStrips (
+                        fileName, dataWindow[i], channels[j], DECREASING_Y);
+                }
+            }
+        }
+
+        setGlobalThreadCount (threads);
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
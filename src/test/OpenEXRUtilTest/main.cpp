@@ -10,9 +10,12 @@
 #include "ImfNamespace.h"
 #include "OpenEXRConfigInternal.h"
 
+#include "testCheckFile.h"
 #include "testDeepImage.h"
+#include "testDeepImageCompositing.h"
 #include "testFlatImage.h"
 #include "testIO.h"
+#include "testPackedDeepImage.h"
 #include "tmpDir.h"
 #include <ImathRandom.h>
 
@@ -88,7 +91,10 @@ main (int argc, char* argv[])
     // CMakeLists.txt so it runs as part of the test suite
     TEST (testFlatImage);
     TEST (testDeepImage);
+    TEST (testDeepImageCompositing);
     TEST (testIO);
+    TEST (testPackedDeepImage);
+    TEST (testCheckFile);
     // NB: If you add a test here, make sure to enumerate it in the
     // CMakeLists.txt so it runs as part of the test suite
 
@@ -0,0 +1,278 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfCheckFile.h>
+#include <ImfDeepImage.h>
+#include <ImfFlatImage.h>
+#include <ImfHeader.h>
+#include <ImfImageIO.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfOutputPart.h>
+#include <ImfPartType.h>
+#include <ImfTiledOutputPart.h>
+
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace IMATH_NAMESPACE;
+using namespace std;
+
+namespace
+{
+
+void
+readFile (const string& fileName, vector<char>& data)
+{
+    ifstream in (fileName.c_str (), ios::binary | ios::ate);
+    assert (in);
+
+    data.resize (in.tellg ());
+    in.seekg (0, ios::beg);
+    in.read (data.data (), data.size ());
+    assert (in);
+}
+
+void
+writeFile (const string& fileName, const vector<char>& data)
+{
+    ofstream out (fileName.c_str (), ios::binary | ios::trunc);
+    out.write (data.data (), data.size ());
+    assert (out);
+}
+
+//
+// Check a file both on disk and in memory, and make sure that
+// both structure checks agree.
+//
+
+bool
+checkStructure (const string& fileName)
+{
+    vector<char> data;
+    readFile (fileName, data);
+
+    bool bad = checkOpenEXRFileStructure (fileName.c_str ());
+    assert (checkOpenEXRFileStructure (data.data (), data.size ()) == bad);
+    return bad;
+}
+
+void
+checkGoodFile (const string& fileName)
+{
+    assert (!checkStructure (fileName));
+
+    //
+    // The full check must agree with the structure check
+    //
+
+    vector<char> data;
+    readFile (fileName, data);
+    assert (!checkOpenEXRFile (data.data (), data.size (), true, true));
+}
+
+//
+// Find the chunk offset table of a single part file with
+// numChunks chunks, which are stored in increasing y order:
+// the first entry in the table points just past the table.
+//
+
+size_t
+offsetTablePosition (const vector<char>& data, int numChunks)
+{
+    for (size_t p = 0; p + 8 <= data.size (); ++p)
+    {
+        uint64_t offset;
+        memcpy (&offset, &data[p], sizeof (offset));
+
+        if (offset == p + 8 * numChunks) return p;
+    }
+
+    assert (false);
+    return 0;
+}
+
+void
+setOffset (vector<char>& data, size_t tablePos, int chunk, uint64_t offset)
+{
+    memcpy (&data[tablePos + 8 * chunk], &offset, sizeof (offset));
+}
+
+uint64_t
+getOffset (const vector<char>& data, size_t tablePos, int chunk)
+{
+    uint64_t offset;
+    memcpy (&offset, &data[tablePos + 8 * chunk], sizeof (offset));
+    return offset;
+}
+
+void
+testGoodFiles (const string& tempDir)
+{
+    cout << "good files" << endl;
+
+    string fileName = tempDir + "checkFile.exr";
+
+    {
+        FlatImage img (Box2i (V2i (0, 0), V2i (63, 47)), ONE_LEVEL, ROUND_DOWN);
+        img.insertChannel ("R", HALF);
+        img.insertChannel ("G", FLOAT);
+        saveImage (fileName, img);
+        checkGoodFile (fileName);
+    }
+
+    {
+        FlatImage img (
+            Box2i (V2i (-5, 3), V2i (70, 40)), MIPMAP_LEVELS, ROUND_UP);
+        img.insertChannel ("Y", HALF);
+        saveImage (fileName, img);
+        checkGoodFile (fileName);
+    }
+
+    {
+        FlatImage img (
+            Box2i (V2i (0, 0), V2i (50, 20)), RIPMAP_LEVELS, ROUND_DOWN);
+        img.insertChannel ("A", UINT);
+        saveImage (fileName, img);
+        checkGoodFile (fileName);
+    }
+
+    {
+        DeepImage img (Box2i (V2i (0, 0), V2i (15, 15)), ONE_LEVEL, ROUND_DOWN);
+        img.insertChannel ("Z", FLOAT);
+        img.insertChannel ("A", HALF);
+        img.level ().sampleCounts ().set (3, 4, 2);
+        saveImage (fileName, img);
+        checkGoodFile (fileName);
+    }
+
+    {
+        DeepImage img (
+            Box2i (V2i (0, 0), V2i (15, 15)), MIPMAP_LEVELS, ROUND_DOWN);
+        img.insertChannel ("Z", FLOAT);
+        img.insertChannel ("A", HALF);
+        saveImage (fileName, img);
+        checkGoodFile (fileName);
+    }
+
+    {
+        Box2i dw (V2i (0, 0), V2i (31, 31));
+
+        vector<Header> headers (2, Header (dw, dw));
+        headers[0].setName ("scanlines");
+        headers[0].setType (SCANLINEIMAGE);
+        headers[0].channels ().insert ("R", Channel (HALF));
+        headers[1].setName ("tiles");
+        headers[1].setType (TILEDIMAGE);
+        headers[1].setTileDescription (TileDescription (8, 8, ONE_LEVEL));
+        headers[1].channels ().insert ("G", Channel (FLOAT));
+
+        {
+            MultiPartOutputFile out (
+                fileName.c_str (), headers.data (), headers.size ());
+
+            OutputPart part0 (out, 0);
+            part0.setFrameBuffer (FrameBuffer ());
+            part0.writePixels (32);
+
+            TiledOutputPart part1 (out, 1);
+            part1.setFrameBuffer (FrameBuffer ());
+            part1.writeTiles (0, 3, 0, 3);
+        }
+
+        checkGoodFile (fileName);
+    }
+
+    remove (fileName.c_str ());
+}
+
+void
+testBadFiles (const string& tempDir)
+{
+    cout << "bad files" << endl;
+
+    string fileName = tempDir + "checkFile.exr";
+
+    assert (checkOpenEXRFileStructure (fileName.c_str ()));
+
+    //
+    // An uncompressed scan-line file has one chunk per line
+    //
+
+    const int numChunks = 32;
+
+    Header hdr;
+    hdr.compression () = NO_COMPRESSION;
+
+    FlatImage img (
+        Box2i (V2i (0, 0), V2i (31, numChunks - 1)), ONE_LEVEL, ROUND_DOWN);
+    img.insertChannel ("R", HALF);
+    saveImage (fileName, hdr, img);
+
+    vector<char> good;
+    readFile (fileName, good);
+    size_t tablePos = offsetTablePosition (good, numChunks);
+
+    {
+        vector<char> data (good.begin (), good.begin () + good.size () / 2);
+        writeFile (fileName, data);
+        assert (checkStructure (fileName));
+    }
+
+    {
+        vector<char> data (good);
+        setOffset (data, tablePos, numChunks - 1, data.size () + 100);
+        writeFile (fileName, data);
+        assert (checkStructure (fileName));
+    }
+
+    {
+        vector<char> data (good);
+        setOffset (data, tablePos, 7, getOffset (data, tablePos, 6));
+        writeFile (fileName, data);
+        assert (checkStructure (fileName));
+    }
+
+    {
+        vector<char> data (good);
+        setOffset (data, tablePos, 3, getOffset (data, tablePos, 3) + 4);
+        writeFile (fileName, data);
+        assert (checkStructure (fileName));
+    }
+
+    writeFile (fileName, good);
+    checkGoodFile (fileName);
+
+    remove (fileName.c_str ());
+}
+
+} // namespace
+
+void
+testCheckFile (const string& tempDir)
+{
+    try
+    {
+        cout << "Testing file structure checks" << endl;
+
+        testGoodFiles (tempDir);
+        testBadFiles (tempDir);
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
@@ -0,0 +1,365 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <Iex.h>
+#include <ImathRandom.h>
+#include <ImfDeepImage.h>
+#include <ImfDeepImageCompositing.h>
+#include <ImfFlatImage.h>
+#include <ImfThreading.h>
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace IMATH_NAMESPACE;
+using namespace IEX_NAMESPACE;
+using namespace std;
+
+namespace
+{
+
+bool
+near (float a, float b)
+{
+    return fabs (a - b) <= 1e-5f * max (1.0f, fabs (b));
+}
+
+struct Sample
+{
+    float        z;
+    float        zBack;
+    float        a;
+    float        r;
+    unsigned int id;
+};
+
+void
+makeImage (DeepImage& img, const Box2i& dataWindow)
+{
+    img.resize (dataWindow, ONE_LEVEL, ROUND_DOWN);
+    img.clearChannels ();
+    img.insertChannel ("Z", FLOAT);
+    img.insertChannel ("ZBack", FLOAT);
+    img.insertChannel ("A", HALF);
+    img.insertChannel ("R", FLOAT);
+    img.insertChannel ("id", UINT);
+}
+
+void
+setPixel (DeepImage& img, int x, int y, const Sample samples[], int n)
+{
+    DeepImageLevel& level = img.level ();
+    level.sampleCounts ().set (x, y, n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        level.typedChannel<float> ("Z").at (x, y)[i]        = samples[i].z;
+        level.typedChannel<float> ("ZBack").at (x, y)[i]    = samples[i].zBack;
+        level.typedChannel<half> ("A").at (x, y)[i]         = samples[i].a;
+        level.typedChannel<float> ("R").at (x, y)[i]        = samples[i].r;
+        level.typedChannel<unsigned int> ("id").at (x, y)[i] = samples[i].id;
+    }
+}
+
+void
+verifyPixel (const DeepImage& img, int x, int y, const Sample samples[], int n)
+{
+    const DeepImageLevel& level = img.level ();
+    assert (level.sampleCounts ().at (x, y) == unsigned (n));
+
+    for (int i = 0; i < n; ++i)
+    {
+        assert (level.typedChannel<float> ("Z").at (x, y)[i] == samples[i].z);
+        assert (
+            level.typedChannel<float> ("ZBack").at (x, y)[i] ==
+            samples[i].zBack);
+        assert (near (
+            level.typedChannel<half> ("A").at (x, y)[i], samples[i].a));
+        assert (near (
+            level.typedChannel<float> ("R").at (x, y)[i], samples[i].r));
+        assert (
+            level.typedChannel<unsigned int> ("id").at (x, y)[i] ==
+            samples[i].id);
+    }
+}
+
+void
+testTidy ()
+{
+    cout << "    tidying" << endl;
+
+    DeepImage img;
+    makeImage (img, Box2i (V2i (0, 0), V2i (4, 0)));
+
+    //
+    // (0, 0) is tidy, (1, 0) is out of order, (2, 0) has two pairs of
+    // samples at the same depths, one of them opaque, and in (3, 0),
+    // a point sample lies inside a volumetric sample.  (4, 0) has no
+    // samples.
+    //
+
+    Sample p0[] = {{1, 1, 0.5f, 0.25f, 1}, {2, 3, 0.5f, 0.5f, 2}};
+    Sample p1[] = {{2, 3, 0.5f, 0.5f, 2}, {1, 1, 0.5f, 0.25f, 1}};
+
+    Sample p2[] = {
+        {3, 3, 1, 0.25f, 3},
+        {4, 4, 0.5f, 0.5f, 5},
+        {3, 3, 1, 0.75f, 4},
+        {4, 4, 0.5f, 0.25f, 6}};
+
+    Sample p3[] = {{0, 2, 0.75f, 0.75f, 7}, {1, 1, 0.5f, 0.5f, 8}};
+
+    setPixel (img, 0, 0, p0, 2);
+    setPixel (img, 1, 0, p1, 2);
+    setPixel (img, 2, 0, p2, 4);
+    setPixel (img, 3, 0, p3, 2);
+
+    tidyDeepImage (img);
+
+    verifyPixel (img, 0, 0, p0, 2);
+    verifyPixel (img, 1, 0, p0, 2);
+
+    //
+    // Opaque samples average; transparent samples combine their
+    // optical depths: alpha = 1 - 0.5 * 0.5, and the colors, weighted
+    // equally, are scaled by 0.75 / (2 * ln 2) * ln 2 / 0.5.
+    //
+
+    Sample t2[] = {{3, 3, 1, 0.5f, 3}, {4, 4, 0.75f, 0.5625f, 5}};
+    verifyPixel (img, 2, 0, t2, 2);
+
+    //
+    // The volume is split at the point sample into two halves, each
+    // with alpha 1 - sqrt (1 - 0.75) and 2/3 of the color.
+    //
+
+    Sample t3[] = {
+        {0, 1, 0.5f, 0.5f, 7}, {1, 1, 0.5f, 0.5f, 8}, {1, 2, 0.5f, 0.5f, 7}};
+
+    verifyPixel (img, 3, 0, t3, 3);
+    verifyPixel (img, 4, 0, 0, 0);
+
+    //
+    // Tidying tidy data changes nothing
+    //
+
+    const float* z = img.level ().typedChannel<float> ("Z").at (0, 0);
+    tidyDeepImage (img);
+    assert (img.level ().typedChannel<float> ("Z").at (0, 0) == z);
+    verifyPixel (img, 3, 0, t3, 3);
+
+    //
+    // Without a Z channel, nothing can be tidied
+    //
+
+    img.eraseChannel ("Z");
+
+    try
+    {
+        tidyDeepImage (img);
+        assert (false);
+    }
+    catch (const ArgExc&)
+    {}
+}
+
+void
+testFlatten ()
+{
+    cout << "    flattening" << endl;
+
+    DeepImage img;
+    makeImage (img, Box2i (V2i (-1, 2), V2i (1, 2)));
+
+    Sample p0[] = {{0, 2, 0.75f, 0.75f, 7}, {1, 1, 0.5f, 0.5f, 8}};
+    Sample p1[] = {{5, 6, 1, 0.25f, 9}, {7, 7, 0.5f, 0.5f, 10}};
+
+    setPixel (img, -1, 2, p0, 2);
+    setPixel (img, 0, 2, p1, 2);
+
+    FlatImage flat;
+    flattenDeepImage (img, flat);
+
+    const FlatImageLevel& level = flat.level ();
+    assert (level.dataWindow () == img.dataWindow ());
+    assert (level.findTypedChannel<half> ("A"));
+    assert (level.findTypedChannel<unsigned int> ("id"));
+
+    //
+    // The tidied samples of (-1, 2) composite to alpha 0.875 and
+    // color 0.5 + 0.5 * 0.5 + 0.25 * 0.5.
+    //
+
+    assert (near (level.typedChannel<half> ("A") (-1, 2), 0.875f));
+    assert (near (level.typedChannel<float> ("R") (-1, 2), 0.875f));
+    assert (level.typedChannel<float> ("Z") (-1, 2) == 0);
+    assert (level.typedChannel<float> ("ZBack") (-1, 2) == 2);
+    assert (level.typedChannel<unsigned int> ("id") (-1, 2) == 7);
+
+    //
+    // Compositing stops at the opaque sample of (0, 2)
+    //
+
+    assert (level.typedChannel<half> ("A") (0, 2) == 1);
+    assert (level.typedChannel<float> ("R") (0, 2) == 0.25f);
+    assert (level.typedChannel<float> ("Z") (0, 2) == 5);
+    assert (level.typedChannel<float> ("ZBack") (0, 2) == 6);
+
+    //
+    // Empty pixels are zero
+    //
+
+    assert (level.typedChannel<half> ("A") (1, 2) == 0);
+    assert (level.typedChannel<float> ("Z") (1, 2) == 0);
+    assert (level.typedChannel<unsigned int> ("id") (1, 2) == 0);
+
+    //
+    // Flat levels must match the deep level
+    //
+
+    FlatImage wrongType (img.dataWindow ());
+    wrongType.insertChannel ("R", HALF);
+
+    try
+    {
+        flattenDeepImageLevel (img.level (), wrongType.level ());
+        assert (false);
+    }
+    catch (const ArgExc&)
+    {}
+}
+
+void
+fillRandom (Rand48& random, DeepImage& img, int level)
+{
+    DeepImageLevel& l  = img.level (level, level);
+    const Box2i&    dw = l.dataWindow ();
+
+    {
+        SampleCountChannel::Edit edit (l.sampleCounts ());
+
+        for (size_t i = 0; i < l.sampleCounts ().numPixels (); ++i)
+            edit.sampleCounts ()[i] = random.nexti () % 8;
+    }
+
+    for (int y = dw.min.y; y <= dw.max.y; ++y)
+    {
+        for (int x = dw.min.x; x <= dw.max.x; ++x)
+        {
+            unsigned int n = l.sampleCounts () (x, y);
+
+            for (unsigned int i = 0; i < n; ++i)
+            {
+                float z = float (random.nexti () % 8);
+
+                l.typedChannel<float> ("Z") (x, y)[i] = z;
+                l.typedChannel<float> ("ZBack") (x, y)[i] =
+                    z + float (random.nexti () % 3);
+                l.typedChannel<half> ("A") (x, y)[i] =
+                    float (random.nextf (0, 1));
+                l.typedChannel<float> ("R") (x, y)[i] =
+                    float (random.nextf (0, 1));
+                l.typedChannel<unsigned int> ("id") (x, y)[i] =
+                    random.nexti () % 100;
+            }
+        }
+    }
+}
+
+void
+testThreads ()
+{
+    cout << "    multiple threads and levels" << endl;
+
+    Rand48    random (7);
+    DeepImage img;
+    makeImage (img, Box2i (V2i (-10, -20), V2i (60, 45)));
+    img.resize (img.dataWindow (), MIPMAP_LEVELS, ROUND_DOWN);
+
+    for (int l = 0; l < img.numLevels (); ++l)
+        fillRandom (random, img, l);
+
+    //
+    // Flatten with and without threads; the results must be the same,
+    // and flattening a tidied image must give the same result, too.
+    //
+
+    int threads = globalThreadCount ();
+
+    setGlobalThreadCount (0);
+    FlatImage flat1;
+    flattenDeepImage (img, flat1);
+
+    setGlobalThreadCount (4);
+    FlatImage flat2;
+    flattenDeepImage (img, flat2);
+
+    tidyDeepImage (img);
+    FlatImage flat3;
+    flattenDeepImage (img, flat3);
+
+    setGlobalThreadCount (threads);
+
+    for (int l = 0; l < img.numLevels (); ++l)
+    {
+        const DeepImageLevel& deep = img.level (l, l);
+        const Box2i&          dw   = deep.dataWindow ();
+
+        for (int y = dw.min.y; y <= dw.max.y; ++y)
+        {
+            for (int x = dw.min.x; x <= dw.max.x; ++x)
+            {
+                float r1 = flat1.level (l, l).typedChannel<float> ("R") (x, y);
+                float r2 = flat2.level (l, l).typedChannel<float> ("R") (x, y);
+                float r3 = flat3.level (l, l).typedChannel<float> ("R") (x, y);
+
+                assert (r1 == r2);
+                assert (near (r3, r1));
+
+                //
+                // Tidy samples are sorted and do not overlap
+                //
+
+                unsigned int n  = deep.sampleCounts () (x, y);
+                const float* z  = deep.typedChannel<float> ("Z") (x, y);
+                const float* zb = deep.typedChannel<float> ("ZBack") (x, y);
+
+                for (unsigned int i = 1; i < n; ++i)
+                {
+                    assert (z[i] >= zb[i - 1]);
+                    assert (z[i] > z[i - 1] || zb[i] > zb[i - 1]);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+void
+testDeepImageCompositing (const string&)
+{
+    try
+    {
+        cout << "Testing deep image tidying and flattening" << endl;
+
+        testTidy ();
+        testFlatten ();
+        testThreads ();
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}
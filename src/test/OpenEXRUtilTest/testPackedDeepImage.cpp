@@ -0,0 +1,422 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <Iex.h>
+#include <ImathRandom.h>
+#include <ImfDeepImage.h>
+#include <ImfDeepImageIO.h>
+#include <ImfHeader.h>
+#include <ImfPackedDeepImage.h>
+#include <ImfTileDescriptionAttribute.h>
+
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace IMATH_NAMESPACE;
+using namespace IEX_NAMESPACE;
+using namespace std;
+
+namespace
+{
+
+template <class T>
+void
+fillChannel (Rand48& random, PackedDeepImage& img, const char name[])
+{
+    T* samples = img.samples<T> (name);
+
+    for (uint64_t i = 0; i < img.totalSamples (); ++i)
+        samples[i] = T (random.nexti () % 1000);
+}
+
+void
+makeImage (Rand48& random, PackedDeepImage& img, const Box2i& dataWindow)
+{
+    img.clearChannels ();
+    img.resize (dataWindow);
+    img.insertChannel ("A", HALF);
+    img.insertChannel ("Z", FLOAT, true);
+    img.insertChannel ("id", UINT);
+
+    {
+        PackedDeepImage::Edit edit (img);
+
+        size_t numPixels = size_t (dataWindow.max.x - dataWindow.min.x + 1) *
+                           size_t (dataWindow.max.y - dataWindow.min.y + 1);
+
+        for (size_t i = 0; i < numPixels; ++i)
+            edit.sampleCounts ()[i] = random.nexti () % 10;
+
+        edit.commit ();
+    }
+
+    fillChannel<half> (random, img, "A");
+    fillChannel<float> (random, img, "Z");
+    fillChannel<unsigned int> (random, img, "id");
+}
+
+template <class T>
+void
+verifyChannel (
+    const PackedDeepImage& img,
+    const DeepImageLevel&  level,
+    const char             name[],
+    const Box2i&           window)
+{
+    const T*                        samples = img.samples<T> (name);
+    const TypedDeepImageChannel<T>& c       = level.typedChannel<T> (name);
+
+    for (int y = window.min.y; y <= window.max.y; ++y)
+        for (int x = window.min.x; x <= window.max.x; ++x)
+        {
+            unsigned int n = img.sampleCount (x, y);
+            assert (level.sampleCounts ().at (x, y) == n);
+
+            const T* s1 = samples + img.sampleOffset (x, y);
+            const T* s2 = c.at (x, y);
+
+            for (unsigned int i = 0; i < n; ++i)
+                assert (s1[i] == s2[i]);
+        }
+}
+
+void
+verifyImages (
+    const PackedDeepImage& img,
+    const DeepImage&       deepImg,
+    const Box2i&           window)
+{
+    const DeepImageLevel& level = deepImg.level ();
+
+    assert (level.dataWindow () == window);
+    assert (level.findChannel ("Z")->pLinear ());
+    assert (!level.findChannel ("A")->pLinear ());
+
+    verifyChannel<half> (img, level, "A", window);
+    verifyChannel<float> (img, level, "Z", window);
+    verifyChannel<unsigned int> (img, level, "id", window);
+}
+
+void
+verifyImages (const PackedDeepImage& img1, const PackedDeepImage& img2)
+{
+    assert (img1.dataWindow () == img2.dataWindow ());
+    assert (img1.totalSamples () == img2.totalSamples ());
+
+    const Box2i& dw = img1.dataWindow ();
+
+    for (int y = dw.min.y; y <= dw.max.y; ++y)
+        for (int x = dw.min.x; x <= dw.max.x; ++x)
+            assert (img1.sampleOffset (x, y) == img2.sampleOffset (x, y));
+
+    const half*         a1 = img1.samples<half> ("A");
+    const half*         a2 = img2.samples<half> ("A");
+    const float*        z1 = img1.samples<float> ("Z");
+    const float*        z2 = img2.samples<float> ("Z");
+    const unsigned int* i1 = img1.samples<unsigned int> ("id");
+    const unsigned int* i2 = img2.samples<unsigned int> ("id");
+
+    for (uint64_t i = 0; i < img1.totalSamples (); ++i)
+    {
+        assert (a1[i] == a2[i]);
+        assert (z1[i] == z2[i]);
+        assert (i1[i] == i2[i]);
+    }
+}
+
+void
+testEdits (Rand48& random)
+{
+    cout << "    editing sample counts" << endl;
+
+    Box2i           dw (V2i (-3, 4), V2i (40, 30));
+    PackedDeepImage img;
+    makeImage (random, img, dw);
+
+    //
+    // Keep a copy of the samples, then grow, shrink and keep the
+    // sample counts of different pixels in one edit.
+    //
+
+    vector<uint64_t> offsets (
+        img.sampleOffsets (),
+        img.sampleOffsets () + (dw.size ().x + 1) * (dw.size ().y + 1) + 1);
+    vector<float> z (
+        img.samples<float> ("Z"),
+        img.samples<float> ("Z") + img.totalSamples ());
+
+    {
+        PackedDeepImage::Edit edit (img);
+        unsigned int*         counts = edit.sampleCounts ();
+
+        for (size_t i = 0; i < offsets.size () - 1; ++i)
+        {
+            assert (counts[i] == offsets[i + 1] - offsets[i]);
+
+            if (i % 3 == 1)
+                counts[i] += 2;
+            else if (i % 3 == 2)
+                counts[i] /= 2;
+        }
+
+        //
+        // The samples are unchanged until the edit ends
+        //
+
+        for (uint64_t s = 0; s < z.size (); ++s)
+            assert (img.samples<float> ("Z")[s] == z[s]);
+
+        try
+        {
+            img.resize (dw);
+            assert (false);
+        }
+        catch (const ArgExc&)
+        {}
+
+        edit.commit ();
+    }
+
+    const float* newZ = img.samples<float> ("Z");
+    size_t       i    = 0;
+
+    for (int y = dw.min.y; y <= dw.max.y; ++y)
+        for (int x = dw.min.x; x <= dw.max.x; ++x, ++i)
+        {
+            unsigned int oldCount = unsigned (offsets[i + 1] - offsets[i]);
+            unsigned int newCount = img.sampleCount (x, y);
+
+            if (i % 3 == 1)
+                assert (newCount == oldCount + 2);
+            else if (i % 3 == 2)
+                assert (newCount == oldCount / 2);
+            else
+                assert (newCount == oldCount);
+
+            for (unsigned int s = 0; s < newCount; ++s)
+            {
+                float expected = s < oldCount ? z[offsets[i] + s] : 0.f;
+                assert (newZ[img.sampleOffset (x, y) + s] == expected);
+            }
+        }
+
+    //
+    // A cancelled edit changes nothing
+    //
+
+    uint64_t total = img.totalSamples ();
+
+    {
+        PackedDeepImage::Edit edit (img);
+        edit.sampleCounts ()[0] += 100;
+        edit.cancel ();
+    }
+
+    assert (img.totalSamples () == total);
+
+    //
+    // So does an edit that is not committed, whether the Edit object
+    // goes out of scope normally or because of an exception
+    //
+
+    {
+        PackedDeepImage::Edit edit (img);
+        edit.sampleCounts ()[0] += 100;
+    }
+
+    assert (img.totalSamples () == total);
+
+    try
+    {
+        PackedDeepImage::Edit edit (img);
+        edit.sampleCounts ()[0] += 100;
+        throw ArgExc ("abandoned edit");
+    }
+    catch (const ArgExc&)
+    {}
+
+    assert (img.totalSamples () == total);
+
+    {
+        PackedDeepImage::Edit edit (img);
+        edit.commit ();
+    }
+
+    assert (img.totalSamples () == total);
+
+    //
+    // Channels
+    //
+
+    img.insertChannel ("B", FLOAT);
+
+    for (uint64_t s = 0; s < img.totalSamples (); ++s)
+        assert (img.samples<float> ("B")[s] == 0.f);
+
+    img.eraseChannel ("B");
+    assert (img.channels ().findChannel ("B") == 0);
+    assert (img.arena ().numChannels () == 3);
+
+    try
+    {
+        img.samples<half> ("Z");
+        assert (false);
+    }
+    catch (const ArgExc&)
+    {}
+
+    try
+    {
+        img.samples<float> ("B");
+        assert (false);
+    }
+    catch (const ArgExc&)
+    {}
+}
+
+void
+testIO (Rand48& random, const string& fileName)
+{
+    Box2i           dw (V2i (5, -7), V2i (150, 90));
+    PackedDeepImage img;
+    makeImage (random, img, dw);
+
+    //
+    // Scan lines, in both line orders
+    //
+
+    for (int order = 0; order < 2; ++order)
+    {
+        cout << "    scan lines, "
+             << (order ? "decreasing y" : "increasing y") << endl;
+
+        Header hdr;
+        hdr.displayWindow () = dw;
+        hdr.lineOrder ()     = order ? DECREASING_Y : INCREASING_Y;
+
+        saveDeepImage (fileName, hdr, img);
+
+        DeepImage deepImg;
+        loadDeepImage (fileName, deepImg);
+        verifyImages (img, deepImg, dw);
+
+        PackedDeepImage img2;
+        Header          hdr2;
+        loadDeepImage (fileName, hdr2, img2);
+        verifyImages (img, img2);
+        assert (!hdr2.hasTileDescription ());
+        assert (img2.channels ().findChannel ("Z")->pLinear);
+    }
+
+    //
+    // Tiles, with edge tiles
+    //
+
+    {
+        cout << "    tiles" << endl;
+
+        Header hdr;
+        hdr.displayWindow () = dw;
+        hdr.setTileDescription (TileDescription (32, 20));
+
+        saveDeepImage (fileName, hdr, img);
+
+        DeepImage deepImg;
+        loadDeepImage (fileName, deepImg);
+        verifyImages (img, deepImg, dw);
+
+        PackedDeepImage img2;
+        Header          hdr2;
+        loadDeepImage (fileName, hdr2, img2);
+        verifyImages (img, img2);
+        assert (hdr2.hasTileDescription ());
+    }
+
+    //
+    // A cropped file
+    //
+
+    {
+        cout << "    cropped" << endl;
+
+        Box2i  crop (V2i (20, 0), V2i (300, 45));
+        Header hdr;
+        hdr.dataWindow () = crop;
+
+        saveDeepImage (fileName, hdr, img, USE_HEADER_DATA_WINDOW);
+
+        Box2i     window (V2i (20, 0), V2i (150, 45));
+        DeepImage deepImg;
+        loadDeepImage (fileName, deepImg);
+        verifyImages (img, deepImg, window);
+    }
+
+    //
+    // Packed images read files written from a DeepImage
+    //
+
+    {
+        cout << "    written from a DeepImage" << endl;
+
+        DeepImage deepImg;
+        loadDeepImage (fileName, deepImg);
+        saveDeepImage (fileName, deepImg);
+
+        PackedDeepImage img2;
+        loadDeepImage (fileName, img2);
+        verifyImages (img2, deepImg, img2.dataWindow ());
+    }
+
+    //
+    // Multi-resolution files are not supported
+    //
+
+    {
+        DeepImage deepImg (dw, MIPMAP_LEVELS);
+        deepImg.insertChannel ("Z", FLOAT);
+        saveDeepImage (fileName, deepImg);
+
+        PackedDeepImage img2;
+
+        try
+        {
+            loadDeepImage (fileName, img2);
+            assert (false);
+        }
+        catch (const ArgExc&)
+        {}
+    }
+
+    remove (fileName.c_str ());
+}
+
+} // namespace
+
+void
+testPackedDeepImage (const string& tempDir)
+{
+    try
+    {
+        cout << "Testing class PackedDeepImage" << endl;
+
+        Rand48 random (5);
+
+        testEdits (random);
+        testIO (random, tempDir + "packedDeepImage.exr");
+
+        cout << "ok\n" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "ERROR -- caught exception: " << e.what () << endl;
+        assert (false);
+    }
+}